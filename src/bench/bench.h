@@ -0,0 +1,87 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <filesystem>
+#include <functional>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace sol::bench {
+
+struct Corpus {
+    std::string name;
+    std::string text;
+};
+
+struct Result {
+    std::string name;
+    std::string corpus;
+    size_t ops;
+    double minNsPerOp;
+    double medianNsPerOp;
+    double allocationsPerOp;  // Fewest in a repeat, counted inside TimeNs
+    size_t bytes;             // Processed per repeat, 0 when throughput does not apply
+    double p90NsPerOp = 0.0;  // Latency results only
+    double p99NsPerOp = 0.0;
+};
+
+// Runs each benchmark a fixed number of times and keeps the fastest and the
+// median repeat, which are far less noisy than the mean on a shared machine
+class Runner {
+public:
+    Runner(std::string filter, int repeats) : m_Filter(std::move(filter)), m_Repeats(repeats) {}
+    
+    // f performs ops operations and returns the nanoseconds to count, so it
+    // can build its fixture outside the measured region. Given the bytes f
+    // processes, the result includes throughput.
+    void Run(const std::string& name, const std::string& corpus, size_t ops, const std::function<double()>& f,
+             size_t bytes = 0);
+    
+    // For benchmarks timing each operation themselves: samples holds every
+    // operation's nanoseconds over all repeats, ops of them per repeat, and
+    // the result is their spread rather than the fastest repeat
+    void AddLatencies(const std::string& name, const std::string& corpus, size_t ops, std::vector<double> samples,
+                      size_t allocations);
+    // Whether the filter lets that benchmark run
+    bool Wants(const std::string& name, const std::string& corpus) const;
+    int GetRepeats() const { return m_Repeats; }
+    
+    void WriteJson(std::ostream& out) const;
+    
+private:
+    std::string m_Filter;
+    int m_Repeats;
+    std::vector<Result> m_Results;
+};
+
+// Calls to operator new so far on any thread, which sol_bench replaces to count them
+size_t AllocationCount();
+// Allocations inside TimeNs, which the runner resets before each repeat
+inline size_t s_MeasuredAllocations = 0;
+
+template <typename F>
+double TimeNs(F&& f) {
+    const size_t allocations = AllocationCount();
+    auto start = std::chrono::steady_clock::now();
+    f();
+    const double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+    s_MeasuredAllocations += AllocationCount() - allocations;
+    return ns;
+}
+
+// Keeps results alive so the optimizer cannot drop the measured work
+void Consume(size_t value);
+
+void RunTextBenchmarks(Runner& runner, const std::vector<Corpus>& corpora);
+// Replays generated terminal output, then each recorded stream
+void RunTerminalBenchmarks(Runner& runner, const std::vector<Corpus>& recorded);
+// Launches the editor at app with --startup-trace for the time to its first
+// frame; nothing when app is empty
+void RunStartupBenchmarks(Runner& runner, const std::filesystem::path& app);
+// Replays each session recorded with --record-session for the latency of
+// its edits, reparses, highlights, completions and history steps
+void RunSessionBenchmarks(Runner& runner, const std::vector<std::filesystem::path>& sessions);
+
+} // namespace sol::bench
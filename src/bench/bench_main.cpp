@@ -0,0 +1,287 @@
+#include "bench.h"
+#include "core/job_system.h"
+#include "core/text/text_buffer.h"
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <new>
+#include <sstream>
+
+// Usage: sol_bench [--filter <substring>] [--repeat <n>] [--out <file.json>] [--corpus <file>]...
+//                  [--stream <file>]... [--app <sol executable>] [--session <file>]...
+//
+// Results are written as JSON (stdout unless --out is given); progress goes
+// to stderr. A benchmark runs when its "name/corpus" id contains the filter.
+// A stream is recorded terminal output, such as a typescript from script(1).
+// Given the editor itself, the time to its first frame is measured too,
+// which needs a display. A session is one recorded with --record-session.
+
+namespace {
+
+std::atomic<size_t> s_Allocations{0};
+
+} // namespace
+
+// Every allocation is counted; array and nothrow forms come through here too
+void* operator new(size_t size) {
+    s_Allocations.fetch_add(1, std::memory_order_relaxed);
+    if (void* p = std::malloc(size ? size : 1)) return p;
+    throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept {
+    std::free(p);
+}
+
+void operator delete(void* p, size_t) noexcept {
+    std::free(p);
+}
+
+namespace sol::bench {
+
+namespace {
+
+volatile size_t s_Sink = 0;
+
+std::string Escape(const std::string& s) {
+    std::string out;
+    out.reserve(s.size());
+    for (char c : s) {
+        if (c == '"' || c == '\\') out += '\\';
+        if (static_cast<unsigned char>(c) < 0x20) continue;
+        out += c;
+    }
+    return out;
+}
+
+// C-like source with nesting, comments, strings and numbers so the parser
+// and highlighter see realistic node density
+std::string SyntheticSource(size_t bytes, uint32_t seed) {
+    std::mt19937 rng(seed);
+    std::string out;
+    out.reserve(bytes + 256);
+    size_t fn = 0;
+    while (out.size() < bytes) {
+        out += "// Function " + std::to_string(fn) + " computes a value\n";
+        out += "static int compute_" + std::to_string(fn++) + "(int a, const char* name) {\n";
+        size_t statements = 4 + rng() % 12;
+        for (size_t i = 0; i < statements; ++i) {
+            switch (rng() % 4) {
+            case 0: out += "    int value_" + std::to_string(i) + " = a * " + std::to_string(rng() % 1000) + " + 7;\n"; break;
+            case 1: out += "    if (a > " + std::to_string(rng() % 100) + ") { a -= 3; } else { a += 1; }\n"; break;
+            case 2: out += "    printf(\"%s: %d\\n\", name, a);  /* trace */\n"; break;
+            default: out += "    for (int i = 0; i < a; ++i) { a ^= i << 1; }\n"; break;
+            }
+        }
+        out += "    return a;\n}\n\n";
+    }
+    return out;
+}
+
+// Minified-style content: few newlines, very long lines
+std::string LongLines(size_t bytes, size_t lineLength) {
+    std::string out;
+    out.reserve(bytes + lineLength);
+    const std::string item = "{\"id\":12345,\"name\":\"item\",\"tags\":[\"a\",\"b\"]},";
+    while (out.size() < bytes) {
+        size_t lineEnd = out.size() + lineLength;
+        while (out.size() < lineEnd) out += item;
+        out += '\n';
+    }
+    return out;
+}
+
+// The editor's own sources, concatenated in a stable order
+std::string RealSource(const std::filesystem::path& root) {
+    std::vector<std::filesystem::path> files;
+    std::error_code ec;
+    for (auto it = std::filesystem::recursive_directory_iterator(root, ec);
+         it != std::filesystem::recursive_directory_iterator(); it.increment(ec)) {
+        if (ec) break;
+        if (it->is_directory() && it->path().filename() == "vendors") {
+            it.disable_recursion_pending();
+            continue;
+        }
+        auto ext = it->path().extension();
+        if (ext == ".cpp" || ext == ".h") files.push_back(it->path());
+    }
+    std::sort(files.begin(), files.end());
+    
+    std::string out;
+    for (const auto& file : files) {
+        std::ifstream in(file, std::ios::binary);
+        std::stringstream ss;
+        ss << in.rdbuf();
+        out += ss.str();
+    }
+    return out;
+}
+
+// Appends the file as a corpus named after it
+bool ReadCorpus(const std::filesystem::path& path, std::vector<Corpus>& out) {
+    std::ifstream in(path, std::ios::binary);
+    if (!in) {
+        std::fprintf(stderr, "cannot read corpus %s\n", path.string().c_str());
+        return false;
+    }
+    std::stringstream ss;
+    ss << in.rdbuf();
+    out.push_back({path.filename().string(), ss.str()});
+    return true;
+}
+
+// At the fastest repeat
+double MegabytesPerSecond(const Result& r) {
+    return static_cast<double>(r.bytes) / (1024.0 * 1024.0) / (r.minNsPerOp * static_cast<double>(r.ops) * 1e-9);
+}
+
+} // namespace
+
+void Consume(size_t value) {
+    s_Sink = s_Sink + value;
+}
+
+size_t AllocationCount() {
+    return s_Allocations.load(std::memory_order_relaxed);
+}
+
+bool Runner::Wants(const std::string& name, const std::string& corpus) const {
+    return (name + "/" + corpus).find(m_Filter) != std::string::npos;
+}
+
+void Runner::Run(const std::string& name, const std::string& corpus, size_t ops, const std::function<double()>& f,
+                 size_t bytes) {
+    if (!Wants(name, corpus)) return;
+    std::string id = name + "/" + corpus;
+    
+    std::vector<double> samples;
+    samples.reserve(m_Repeats);
+    size_t allocations = SIZE_MAX;
+    for (int i = 0; i < m_Repeats; ++i) {
+        s_MeasuredAllocations = 0;
+        samples.push_back(f() / static_cast<double>(ops));
+        allocations = std::min(allocations, s_MeasuredAllocations);
+    }
+    std::sort(samples.begin(), samples.end());
+    
+    Result result{name, corpus, ops, samples.front(), samples[samples.size() / 2],
+                  static_cast<double>(allocations) / static_cast<double>(ops), bytes};
+    std::fprintf(stderr, "%-40s %14.1f ns/op (median %.1f) %10.1f allocs/op", id.c_str(), result.minNsPerOp,
+                 result.medianNsPerOp, result.allocationsPerOp);
+    if (bytes > 0) std::fprintf(stderr, " %8.1f MB/s", MegabytesPerSecond(result));
+    std::fprintf(stderr, "\n");
+    m_Results.push_back(std::move(result));
+}
+
+void Runner::AddLatencies(const std::string& name, const std::string& corpus, size_t ops, std::vector<double> samples,
+                          size_t allocations) {
+    if (!Wants(name, corpus) || samples.empty()) return;
+    std::sort(samples.begin(), samples.end());
+    auto percentile = [&samples](size_t p) { return samples[(samples.size() - 1) * p / 100]; };
+    
+    Result result{name, corpus, ops, samples.front(), percentile(50),
+                  static_cast<double>(allocations) / static_cast<double>(samples.size()), 0, percentile(90),
+                  percentile(99)};
+    std::fprintf(stderr, "%-40s %14.1f ns p50 %12.1f p90 %12.1f p99 %10.1f allocs/op\n", (name + "/" + corpus).c_str(),
+                 result.medianNsPerOp, result.p90NsPerOp, result.p99NsPerOp, result.allocationsPerOp);
+    m_Results.push_back(std::move(result));
+}
+
+void Runner::WriteJson(std::ostream& out) const {
+    out << "{\n  \"timestamp\": " << static_cast<long long>(std::time(nullptr))
+        << ",\n  \"repeats\": " << m_Repeats
+        << ",\n  \"results\": [";
+    for (size_t i = 0; i < m_Results.size(); ++i) {
+        const Result& r = m_Results[i];
+        char numbers[256];
+        int length = std::snprintf(numbers, sizeof(numbers),
+                                   "\"ops\": %zu, \"min_ns_per_op\": %.2f, \"median_ns_per_op\": %.2f, \"allocs_per_op\": %.2f",
+                                   r.ops, r.minNsPerOp, r.medianNsPerOp, r.allocationsPerOp);
+        if (r.bytes > 0) {
+            std::snprintf(numbers + length, sizeof(numbers) - length, ", \"bytes\": %zu, \"mb_per_s\": %.2f", r.bytes,
+                          MegabytesPerSecond(r));
+        } else if (r.p99NsPerOp > 0) {
+            std::snprintf(numbers + length, sizeof(numbers) - length, ", \"p90_ns\": %.2f, \"p99_ns\": %.2f",
+                          r.p90NsPerOp, r.p99NsPerOp);
+        }
+        out << (i ? ",\n" : "\n") << "    {\"name\": \"" << Escape(r.name) << "\", \"corpus\": \""
+            << Escape(r.corpus) << "\", " << numbers << "}";
+    }
+    out << "\n  ]\n}\n";
+}
+
+} // namespace sol::bench
+
+int main(int argc, char** argv) {
+    using namespace sol::bench;
+    
+    std::string filter;
+    std::string outPath;
+    int repeats = 5;
+    std::vector<std::filesystem::path> extraCorpora;
+    std::vector<std::filesystem::path> streamPaths;
+    std::filesystem::path appPath;
+    std::vector<std::filesystem::path> sessionPaths;
+    
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (arg == "--filter" && hasValue) {
+            filter = argv[++i];
+        } else if (arg == "--repeat" && hasValue) {
+            repeats = std::max(1, std::atoi(argv[++i]));
+        } else if (arg == "--out" && hasValue) {
+            outPath = argv[++i];
+        } else if (arg == "--corpus" && hasValue) {
+            extraCorpora.emplace_back(argv[++i]);
+        } else if (arg == "--stream" && hasValue) {
+            streamPaths.emplace_back(argv[++i]);
+        } else if (arg == "--app" && hasValue) {
+            appPath = argv[++i];
+        } else if (arg == "--session" && hasValue) {
+            sessionPaths.emplace_back(argv[++i]);
+        } else {
+            std::fprintf(stderr, "usage: %s [--filter <substring>] [--repeat <n>] [--out <file.json>] [--corpus <file>]... "
+                         "[--stream <file>]... [--app <sol executable>] [--session <file>]...\n", argv[0]);
+            return 1;
+        }
+    }
+    
+    sol::LanguageRegistry::GetInstance().InitializeBuiltins();
+    
+    std::vector<Corpus> corpora;
+    corpora.push_back({"small", SyntheticSource(64 * 1024, 1)});
+    corpora.push_back({"large", SyntheticSource(16 * 1024 * 1024, 2)});
+    corpora.push_back({"huge", SyntheticSource(256 * 1024 * 1024, 3)});
+    corpora.push_back({"long_lines", LongLines(8 * 1024 * 1024, 256 * 1024)});
+    std::string real = RealSource(SOL_BENCH_CORPUS_DIR);
+    if (!real.empty()) corpora.push_back({"real", std::move(real)});
+    for (const auto& path : extraCorpora) {
+        if (!ReadCorpus(path, corpora)) return 1;
+    }
+    std::vector<Corpus> streams;
+    for (const auto& path : streamPaths) {
+        if (!ReadCorpus(path, streams)) return 1;
+    }
+    
+    Runner runner(filter, repeats);
+    RunTextBenchmarks(runner, corpora);
+    RunTerminalBenchmarks(runner, streams);
+    RunStartupBenchmarks(runner, appPath);
+    RunSessionBenchmarks(runner, sessionPaths);
+    sol::JobSystem::Shutdown();
+    
+    if (outPath.empty()) {
+        runner.WriteJson(std::cout);
+    } else {
+        std::ofstream out(outPath);
+        runner.WriteJson(out);
+    }
+    return 0;
+}
@@ -0,0 +1,124 @@
+#include "bench.h"
+#include "core/text/edit_session.h"
+#include "core/text/text_buffer.h"
+#include <algorithm>
+#include <cstdio>
+#include <limits>
+
+namespace sol::bench {
+
+namespace {
+
+enum Measure { EDIT, REPARSE, TOKENS, COMPLETION, HISTORY, MEASURE_COUNT };
+
+constexpr const char* MEASURE_NAMES[MEASURE_COUNT] = {
+    "session/edit", "session/reparse", "session/tokens", "session/completion", "session/history",
+};
+
+struct Samples {
+    std::vector<double> ns;
+    size_t allocations = 0;
+    size_t perRepeat = 0;
+};
+
+template <typename F>
+void Time(Samples& samples, F&& f) {
+    const size_t allocations = s_MeasuredAllocations;
+    samples.ns.push_back(TimeNs(std::forward<F>(f)));
+    samples.allocations += s_MeasuredAllocations - allocations;
+}
+
+void ApplyEdits(TextBuffer& buffer, const std::vector<TextEdit>& edits) {
+    if (edits.size() != 1) {
+        std::vector<TextEdit> batch = edits;
+        Consume(buffer.ApplyEdits(batch));
+        return;
+    }
+    const TextEdit& edit = edits.front();
+    if (edit.len == 0) {
+        buffer.Insert(edit.pos, edit.text);
+    } else if (edit.text.empty()) {
+        buffer.Delete(edit.pos, edit.len);
+    } else {
+        buffer.Replace(edit.pos, edit.len, edit.text);
+    }
+}
+
+// Steps run back to back rather than at the recorded pace, so a history
+// push merges into the one before exactly when the recorded gap between
+// them was inside the merge window
+void Replay(const EditSession& session, const Language* language, Samples (&samples)[MEASURE_COUNT]) {
+    TextBuffer buffer(session.GetText());
+    buffer.SetLanguage(language);
+    buffer.FinishParsing();
+    UndoTree& undo = buffer.GetUndoTree();
+    const size_t window = undo.GetMergeWindow();
+    const uint64_t windowUs = static_cast<uint64_t>(window) * 1000;
+    uint64_t sincePush = std::numeric_limits<uint64_t>::max();
+
+    for (const EditSession::Step& step : session.GetSteps()) {
+        sincePush = std::min(sincePush, std::numeric_limits<uint64_t>::max() - step.delayUs) + step.delayUs;
+        switch (step.kind) {
+        case EditSession::Kind::Edit:
+            Time(samples[EDIT], [&] { ApplyEdits(buffer, step.edits); });
+            if (language) Time(samples[REPARSE], [&] { buffer.FinishParsing(); });
+            break;
+        case EditSession::Kind::Push:
+            undo.SetMergeWindow(sincePush < windowUs ? window : 0);
+            Time(samples[HISTORY], [&] { undo.Push(step.op); });
+            sincePush = 0;
+            break;
+        case EditSession::Kind::Undo:
+            Time(samples[HISTORY], [&] { Consume(undo.Undo().has_value()); });
+            break;
+        case EditSession::Kind::Redo:
+            Time(samples[HISTORY], [&] { Consume(undo.Redo().has_value()); });
+            break;
+        case EditSession::Kind::Highlight:
+            Time(samples[TOKENS], [&] {
+                buffer.UpdateHighlights(step.first, step.end);
+                size_t spans = 0;
+                for (size_t line = step.first; line < std::min(step.end, buffer.LineCount()); ++line) {
+                    spans += buffer.GetLineHighlights(line).size();
+                }
+                Consume(spans);
+            });
+            break;
+        case EditSession::Kind::Completion:
+            Time(samples[COMPLETION], [&] { Consume(buffer.GetWordCompletions(step.prefix, step.first).size()); });
+            break;
+        }
+    }
+}
+
+} // namespace
+
+void RunSessionBenchmarks(Runner& runner, const std::vector<std::filesystem::path>& sessions) {
+    for (const auto& path : sessions) {
+        const std::string corpus = path.filename().string();
+        if (std::none_of(std::begin(MEASURE_NAMES), std::end(MEASURE_NAMES),
+                         [&](const char* name) { return runner.Wants(name, corpus); })) {
+            continue;
+        }
+        const std::optional<EditSession> session = EditSession::Load(path);
+        if (!session) {
+            std::fprintf(stderr, "cannot read session %s\n", path.string().c_str());
+            continue;
+        }
+        const Language* language = LanguageRegistry::GetInstance().GetLanguageForFile(session->GetFileName());
+
+        Samples samples[MEASURE_COUNT];
+        for (int repeat = 0; repeat < runner.GetRepeats(); ++repeat) {
+            Replay(*session, language, samples);
+            if (repeat == 0) {
+                for (Samples& s : samples) s.perRepeat = s.ns.size();
+            }
+        }
+        for (int i = 0; i < MEASURE_COUNT; ++i) {
+            runner.AddLatencies(MEASURE_NAMES[i], corpus, samples[i].perRepeat, std::move(samples[i].ns),
+                                samples[i].allocations);
+        }
+    }
+}
+
+} // namespace sol::bench
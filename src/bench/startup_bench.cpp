@@ -0,0 +1,73 @@
+#include "bench.h"
+#include "core/platform/process.h"
+#include "core/startup_trace.h"
+#include "core/utils/json.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <optional>
+#include <sstream>
+
+namespace sol::bench {
+
+namespace {
+
+// Runs the editor until it has written its startup trace and quit, giving
+// the nanoseconds to its first frame; nullopt when it wrote none
+std::optional<double> Launch(const std::filesystem::path& app, const std::filesystem::path& tracePath,
+                             std::string* phases) {
+    std::error_code ec;
+    std::filesystem::remove(tracePath, ec);
+    Process process(app.string(), {"--startup-trace", tracePath.string()});
+    if (!process.Start()) return std::nullopt;
+    // stdout closes as the editor exits
+    char discard[4096];
+    while (process.Read(discard, sizeof(discard)) > 0) {}
+
+    std::ifstream in(tracePath, std::ios::binary);
+    std::stringstream ss;
+    ss << in.rdbuf();
+    JsonDocument document;
+    if (!in || !document.Parse(ss.str()) || !document.Root().Has("total_ns")) return std::nullopt;
+    const JsonNode& root = document.Root();
+    if (phases) {
+        phases->clear();
+        for (const JsonNode& phase : root["phases"].Items()) {
+            char line[96];
+            std::snprintf(line, sizeof(line), "  %-12.*s %8.1f ms\n", static_cast<int>(phase["name"].AsString().size()),
+                          phase["name"].AsString().data(), phase["ns"].AsNumber() * 1e-6);
+            *phases += line;
+        }
+    }
+    return root["total_ns"].AsNumber();
+}
+
+} // namespace
+
+void RunStartupBenchmarks(Runner& runner, const std::filesystem::path& app) {
+    if (app.empty()) return;
+    const std::filesystem::path tracePath = std::filesystem::temp_directory_path() / "sol_startup_trace.json";
+    std::string phases;
+    const std::optional<double> first = Launch(app, tracePath, &phases);
+    if (!first) {
+        std::fprintf(stderr, "%s wrote no startup trace\n", app.string().c_str());
+        return;
+    }
+
+    // A launch that fails counts as the first one did rather than as free
+    double slowest = 0.0;
+    runner.Run("startup/first_frame", app.filename().string(), 1, [&] {
+        std::optional<double> ns = Launch(app, tracePath, nullptr);
+        if (!ns) std::fprintf(stderr, "%s wrote no startup trace\n", app.string().c_str());
+        slowest = std::max(slowest, ns.value_or(*first));
+        return ns.value_or(*first);
+    });
+    std::fprintf(stderr, "%s", phases.c_str());
+    const double target = std::chrono::duration<double, std::nano>(StartupTrace::TARGET).count();
+    if (slowest > target) {
+        std::fprintf(stderr, "startup/first_frame over the %.0f ms target in a repeat\n", target * 1e-6);
+    }
+}
+
+} // namespace sol::bench
@@ -0,0 +1,134 @@
+#include "bench.h"
+#include "core/terminal/terminal_emulator.h"
+#include <iterator>
+#include <random>
+#include <string_view>
+
+namespace sol::bench {
+
+namespace {
+
+constexpr size_t STREAM_BYTES = 8 * 1024 * 1024;
+// What the reader thread hands the parser at a time
+constexpr size_t READ_SIZE = 64 * 1024;
+constexpr int ROWS = 50;
+constexpr int COLS = 200;
+// Replays with the history on see a small ring spill to disk
+constexpr size_t HISTORY_RING = 1000;
+constexpr size_t HISTORY_BYTES = 64 * 1024 * 1024;
+
+char Printable(std::mt19937& rng) {
+    return static_cast<char>('!' + rng() % 94);
+}
+
+// Full rows of printable ASCII, scrolling the screen into scrollback
+std::string DenseAscii(uint32_t seed) {
+    std::mt19937 rng(seed);
+    std::string out;
+    out.reserve(STREAM_BYTES + COLS);
+    while (out.size() < STREAM_BYTES) {
+        for (int col = 0; col < COLS; ++col) out += rng() % 8 ? Printable(rng) : ' ';
+        out += "\r\n";
+    }
+    return out;
+}
+
+// A new 256-colour or truecolour foreground, sometimes with a background
+// and bold, before nearly every character
+std::string SgrColor(uint32_t seed) {
+    std::mt19937 rng(seed);
+    std::string out;
+    out.reserve(STREAM_BYTES + COLS * 32);
+    while (out.size() < STREAM_BYTES) {
+        for (int col = 0; col < COLS; ++col) {
+            if (rng() % 2) {
+                out += "\x1b[38;5;" + std::to_string(rng() % 256) + "m";
+            } else {
+                out += "\x1b[38;2;" + std::to_string(rng() % 256) + ";" + std::to_string(rng() % 256) + ";" +
+                       std::to_string(rng() % 256) + "m";
+            }
+            if (rng() % 8 == 0) out += "\x1b[1;48;5;" + std::to_string(rng() % 256) + "m";
+            out += Printable(rng);
+        }
+        out += "\x1b[0m\r\n";
+    }
+    return out;
+}
+
+// Words written at random positions, erasing lines and now and then the
+// screen, as full-screen programs redraw
+std::string CursorMotion(uint32_t seed) {
+    std::mt19937 rng(seed);
+    std::string out;
+    out.reserve(STREAM_BYTES + 64);
+    for (size_t i = 0; out.size() < STREAM_BYTES; ++i) {
+        out += "\x1b[" + std::to_string(1 + rng() % ROWS) + ";" + std::to_string(1 + rng() % COLS) + "H";
+        if (i % 16 == 0) out += "\x1b[K";
+        if (i % 4096 == 0) out += "\x1b[2J";
+        for (size_t length = 1 + rng() % 12; length > 0; --length) out += Printable(rng);
+    }
+    return out;
+}
+
+// Full-screen programs entering the alternate screen, drawing every row
+// and leaving, between shell prompts
+std::string AltScreen(uint32_t seed) {
+    std::mt19937 rng(seed);
+    std::string out;
+    out.reserve(STREAM_BYTES + ROWS * (COLS + 16));
+    while (out.size() < STREAM_BYTES) {
+        out += "$ less build.log\r\n\x1b[?1049h\x1b[H";
+        for (int row = 1; row <= ROWS; ++row) {
+            out += "\x1b[" + std::to_string(row) + ";1H";
+            for (int col = 0; col < COLS; ++col) out += Printable(rng);
+        }
+        out += "\x1b[?1049l";
+    }
+    return out;
+}
+
+// Multi-byte UTF-8: accented Latin, Greek, Cyrillic, CJK, box drawing and emoji
+std::string Unicode(uint32_t seed) {
+    static constexpr std::string_view WORDS[] = {
+        "Ünïcödé ", "àçcéñts ", "Ελληνικά ", "кириллица ", "日本語のテキスト ", "中文字符 ", "┌──┬──┐ ", "│░▒▓│ ", "😀🚀✨ ",
+    };
+    std::mt19937 rng(seed);
+    std::string out;
+    out.reserve(STREAM_BYTES + COLS * 4);
+    while (out.size() < STREAM_BYTES) {
+        for (int word = 0; word < 12; ++word) out += WORDS[rng() % std::size(WORDS)];
+        out += "\r\n";
+    }
+    return out;
+}
+
+void Replay(TerminalEmulator& emulator, std::string_view stream) {
+    for (size_t pos = 0; pos < stream.size(); pos += READ_SIZE) emulator.ProcessOutput(stream.substr(pos, READ_SIZE));
+}
+
+} // namespace
+
+void RunTerminalBenchmarks(Runner& runner, const std::vector<Corpus>& recorded) {
+    std::vector<Corpus> streams;
+    streams.push_back({"dense_ascii", DenseAscii(21)});
+    streams.push_back({"sgr_color", SgrColor(22)});
+    streams.push_back({"cursor_motion", CursorMotion(23)});
+    streams.push_back({"alt_screen", AltScreen(24)});
+    streams.push_back({"unicode", Unicode(25)});
+    streams.insert(streams.end(), recorded.begin(), recorded.end());
+    
+    for (const Corpus& stream : streams) {
+        const std::string_view text = stream.text;
+        runner.Run("terminal/replay", stream.name, 1, [&] {
+            TerminalEmulator emulator(ROWS, COLS);
+            return TimeNs([&] { Replay(emulator, text); });
+        }, text.size());
+        
+        runner.Run("terminal/replay_history", stream.name, 1, [&] {
+            TerminalEmulator emulator(ROWS, COLS, HISTORY_RING, HISTORY_BYTES);
+            return TimeNs([&] { Replay(emulator, text); });
+        }, text.size());
+    }
+}
+
+} // namespace sol::bench
@@ -0,0 +1,173 @@
+#include "bench.h"
+#include "core/text/rope.h"
+#include "core/text/text_buffer.h"
+#include <algorithm>
+#include <random>
+
+namespace sol::bench {
+
+namespace {
+
+constexpr size_t ROPE_EDITS = 5000;
+constexpr size_t ROPE_LOOKUPS = 100000;
+constexpr size_t BUFFER_EDITS = 200;
+constexpr size_t HIGHLIGHT_QUERIES = 500;
+constexpr size_t VISIBLE_LINES = 60;
+
+std::vector<size_t> RandomPositions(size_t count, size_t limit, uint32_t seed) {
+    std::mt19937_64 rng(seed);
+    std::vector<size_t> out(count);
+    for (auto& pos : out) pos = limit ? rng() % limit : 0;
+    return out;
+}
+
+void RopeBenchmarks(Runner& runner, const Corpus& corpus) {
+    const std::string& text = corpus.text;
+    const auto positions = RandomPositions(ROPE_EDITS, text.size(), 11);
+    
+    runner.Run("rope/build", corpus.name, 1, [&] {
+        return TimeNs([&] {
+            Rope rope(text);
+            Consume(rope.Length());
+        });
+    });
+    
+    // Typing: each insert lands right after the previous one
+    runner.Run("rope/insert_sequential", corpus.name, ROPE_EDITS, [&] {
+        Rope rope(text);
+        size_t pos = rope.Length() / 2;
+        return TimeNs([&] {
+            for (size_t i = 0; i < ROPE_EDITS; ++i) rope.Insert(pos++, "x");
+        });
+    });
+    
+    runner.Run("rope/insert_random", corpus.name, ROPE_EDITS, [&] {
+        Rope rope(text);
+        return TimeNs([&] {
+            for (size_t pos : positions) rope.Insert(pos, "edit");
+        });
+    });
+    
+    // The same inserts as one batch
+    runner.Run("rope/apply_edits", corpus.name, ROPE_EDITS, [&] {
+        Rope rope(text);
+        std::vector<size_t> sorted = positions;
+        std::sort(sorted.begin(), sorted.end());
+        std::vector<Rope::Edit> edits;
+        edits.reserve(sorted.size());
+        for (size_t pos : sorted) edits.push_back({pos, 0, "edit"});
+        return TimeNs([&] { Consume(rope.ApplyEdits(edits).size()); });
+    });
+    
+    runner.Run("rope/delete_random", corpus.name, ROPE_EDITS, [&] {
+        Rope rope(text);
+        return TimeNs([&] {
+            for (size_t pos : positions) rope.Delete(pos % rope.Length(), 4);
+        });
+    });
+    
+    runner.Run("rope/line_start", corpus.name, ROPE_LOOKUPS, [&] {
+        Rope rope(text);
+        auto lines = RandomPositions(ROPE_LOOKUPS, rope.LineCount(), 12);
+        return TimeNs([&] {
+            size_t sum = 0;
+            for (size_t line : lines) sum += rope.LineStart(line);
+            Consume(sum);
+        });
+    });
+}
+
+// Tree-sitter only runs on buffers below the large-file threshold
+void BufferBenchmarks(Runner& runner, const Corpus& corpus, const Language* language) {
+    const std::string& text = corpus.text;
+    
+    runner.Run("buffer/parse_full", corpus.name, 1, [&] {
+        TextBuffer buffer(text);
+        buffer.SetLanguage(language);
+        return TimeNs([&] { buffer.Parse(); });
+    });
+    
+    // Edits reparse in the background; timings include catching the tree up
+    runner.Run("buffer/edit_sequential", corpus.name, BUFFER_EDITS, [&] {
+        TextBuffer buffer(text);
+        buffer.SetLanguage(language);
+        buffer.FinishParsing();
+        size_t pos = buffer.Length() / 2;
+        return TimeNs([&] {
+            for (size_t i = 0; i < BUFFER_EDITS; ++i) buffer.Insert(pos++, "x");
+            buffer.FinishParsing();
+        });
+    });
+    
+    runner.Run("buffer/edit_random", corpus.name, BUFFER_EDITS, [&] {
+        TextBuffer buffer(text);
+        buffer.SetLanguage(language);
+        buffer.FinishParsing();
+        auto positions = RandomPositions(BUFFER_EDITS, buffer.Length(), 13);
+        return TimeNs([&] {
+            for (size_t pos : positions) buffer.Insert(pos, " ");
+            buffer.FinishParsing();
+        });
+    });
+    
+    // The same edits as one batch with a single reparse
+    runner.Run("buffer/edit_batch", corpus.name, BUFFER_EDITS, [&] {
+        TextBuffer buffer(text);
+        buffer.SetLanguage(language);
+        buffer.FinishParsing();
+        std::vector<TextEdit> edits;
+        for (size_t pos : RandomPositions(BUFFER_EDITS, buffer.Length(), 13)) edits.push_back({pos, 0, " "});
+        return TimeNs([&] {
+            Consume(buffer.ApplyEdits(edits));
+            buffer.FinishParsing();
+        });
+    });
+    
+    // One screen of tokens at a random scroll position
+    runner.Run("highlight/syntax_tokens", corpus.name, HIGHLIGHT_QUERIES, [&] {
+        TextBuffer buffer(text);
+        buffer.SetLanguage(language);
+        buffer.FinishParsing();
+        auto lines = RandomPositions(HIGHLIGHT_QUERIES, buffer.LineCount(), 14);
+        return TimeNs([&] {
+            size_t tokens = 0;
+            for (size_t line : lines) {
+                tokens += buffer.GetSyntaxTokens(line, std::min(line + VISIBLE_LINES, buffer.LineCount() - 1)).size();
+            }
+            Consume(tokens);
+        });
+    });
+    
+    // The same screens from the line cache, warmed once as a static screen would be
+    runner.Run("highlight/cached_lines", corpus.name, HIGHLIGHT_QUERIES, [&] {
+        TextBuffer buffer(text);
+        buffer.SetLanguage(language);
+        buffer.FinishParsing();
+        auto lines = RandomPositions(HIGHLIGHT_QUERIES, buffer.LineCount(), 14);
+        for (size_t line : lines) buffer.UpdateHighlights(line, line + VISIBLE_LINES);
+        return TimeNs([&] {
+            size_t spans = 0;
+            for (size_t line : lines) {
+                buffer.UpdateHighlights(line, line + VISIBLE_LINES);
+                for (size_t i = line; i < std::min(line + VISIBLE_LINES, buffer.LineCount()); ++i) {
+                    spans += buffer.GetLineHighlights(i).size();
+                }
+            }
+            Consume(spans);
+        });
+    });
+}
+
+} // namespace
+
+void RunTextBenchmarks(Runner& runner, const std::vector<Corpus>& corpora) {
+    const Language* cpp = LanguageRegistry::GetInstance().GetLanguageByName("cpp");
+    for (const auto& corpus : corpora) {
+        RopeBenchmarks(runner, corpus);
+        if (cpp && !Rope(corpus.text).IsLargeFile()) {
+            BufferBenchmarks(runner, corpus, cpp);
+        }
+    }
+}
+
+} // namespace sol::bench
@@ -1,17 +1,26 @@
 #include "application.h"
 #include "core/event_system.h"
 #include "core/logger.h"
+#include "core/profiler.h"
 #include "core/resource_system.h"
 #include "core/file_dialog.h"
+#include "core/frame_scheduler.h"
 #include "core/text/text_buffer.h"
+#include "core/text/edit_session.h"
 #include "core/lsp/lsp_manager.h"
+#include "core/symbol_index.h"
+#include "core/file_watcher.h"
+#include "core/startup_trace.h"
 #include "ui/layers/workspace.h"
 #include "ui/layers/status_bar.h"
 #include "ui/layers/settings.h"
+#include "ui/layers/perf_hud.h"
 #include "ui/editor_settings.h"
 #include "ui/input/command.h"
 #include <imgui.h>
+#include <GLFW/glfw3.h>
 #include <cstring>
+#include <fstream>
 #include <unistd.h>
 #include <sys/wait.h>
 
@@ -26,59 +35,133 @@ Application::Application() {
 void Application::SetArgs(int argc, char* argv[]) {
     if (argc >= 1 && argv[0])
         m_ExecutablePath = argv[0];
-    if (argc >= 2 && argv[1])
-        m_InitialPath = argv[1];
+    for (int i = 1; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--startup-trace") == 0 && i + 1 < argc) {
+            m_StartupTracePath = argv[++i];
+        } else if (std::strcmp(argv[i], "--record-session") == 0 && i + 1 < argc) {
+            m_SessionPath = argv[++i];
+        } else if (m_InitialPath.empty()) {
+            m_InitialPath = argv[i];
+        }
+    }
 }
 
 Application::~Application() {
+    // The window is gone; threads still winding down have nothing to wake
+    FrameScheduler::GetInstance().SetWaker(nullptr);
+    EventBus::Unsubscribe<ToggleWindowEvent>(m_ToggleWindowSub);
+    EventBus::Unsubscribe<BufferOpenedEvent>(m_BufferOpenedSub);
+    if (m_Session) m_Session->Save(m_SessionPath);
+    EditorSettings::Get().SaveDirty();
     // Ensure proper cleanup of systems
+    if (m_Workspace) m_Workspace->SaveSession();
+    ResourceSystem::GetInstance().FinishSaves();
+    FileWatcher::GetInstance().Shutdown();
     LSPManager::GetInstance().Shutdown();
+    SymbolIndex::GetInstance().Shutdown();
     JobSystem::Shutdown();
 }
 
 void Application::OnStart() {
+    SOL_PROFILE_THREAD("Main");
+    auto& trace = StartupTrace::GetInstance();
+    trace.Mark("window");
     Logger::Info("Application starting...");
+    FrameScheduler::GetInstance().SetWaker([] { glfwPostEmptyEvent(); });
     
-    // Load user settings from config
+    // Load user settings from config, or their snapshot while it is current
     EditorSettings::Get().Load();
-    EditorSettings::Get().LoadKeybinds();
-    EditorSettings::Get().LoadBehavior();
     Logger::Info("User settings loaded");
+    trace.Mark("settings");
     
     // Initialize language registry for syntax highlighting
     LanguageRegistry::GetInstance().InitializeBuiltins();
     Logger::Info("Language registry initialized");
-    
-    // Initialize LSP
-    LSPManager::GetInstance().Initialize(std::filesystem::current_path().string());
+    trace.Mark("languages");
+    
+    // Initialize LSP for the folder opened, or the one holding the file
+    const std::filesystem::path initialPath = m_InitialPath;
+    const bool initialFolder = !initialPath.empty() && std::filesystem::is_directory(initialPath);
+    const std::filesystem::path projectRoot = initialPath.empty() ? std::filesystem::current_path()
+                                            : initialFolder       ? initialPath
+                                                                  : initialPath.parent_path();
+    LSPManager::GetInstance().Initialize(projectRoot.string());
     Logger::Info("LSP Manager initialized");
+    trace.Mark("lsp");
     
     SetupEvents();
+    trace.Mark("events");
     SetupUILayers();
+    trace.Mark("layers");
     SetupInputSystem();
+    trace.Mark("input");
 
     // Open path passed on command line (file or folder)
-    if (!m_InitialPath.empty()) {
-        std::filesystem::path p = m_InitialPath;
-        if (std::filesystem::is_directory(p)) {
-            ResourceSystem::GetInstance().SetWorkingDirectory(p);
-            LSPManager::GetInstance().Initialize(p.string());
-            if (m_Workspace) m_Workspace->GetExplorer().Refresh();
-            Logger::Info("Opened initial folder: " + p.string());
+    if (!initialPath.empty()) {
+        ResourceSystem::GetInstance().SetWorkingDirectory(projectRoot);
+        if (m_Workspace) m_Workspace->GetExplorer().Refresh();
+        if (initialFolder) {
+            if (m_Workspace) m_Workspace->RestoreSession(ResourceSystem::GetInstance().GetWorkingDirectory());
+            Logger::Info("Opened initial folder: ", initialPath);
         } else {
-            // Also set working directory to the file's parent for LSP context
-            ResourceSystem::GetInstance().SetWorkingDirectory(p.parent_path());
-            LSPManager::GetInstance().Initialize(p.parent_path().string());
-            if (m_Workspace) m_Workspace->GetExplorer().Refresh();
-            ResourceSystem::GetInstance().OpenFile(p);
-            Logger::Info("Opened initial file: " + p.string());
+            auto buffer = ResourceSystem::GetInstance().OpenFile(initialPath);
+            Logger::Info("Opened initial file: ", initialPath);
+            auto text = buffer ? std::dynamic_pointer_cast<TextResource>(buffer->GetResource()) : nullptr;
+            if (text && !m_SessionPath.empty()) m_Session = text->GetBuffer().StartRecording();
         }
+        trace.Mark("open");
     }
 
     Logger::Info("Application initialized successfully");
 }
 
 void Application::OnUpdate() {
+    // The frame before this one is on screen by now
+    if (m_FirstFrameBuilt && !StartupTrace::GetInstance().IsFinished()) FinishStartupTrace();
+    WaitForFrame();
+    SOL_PROFILE_ZONE("Application::OnUpdate");
+    FileWatcher::GetInstance().Poll();
+    auto& resources = ResourceSystem::GetInstance();
+    const BehaviorSettings& behavior = EditorSettings::Get().GetBehavior();
+    resources.SetMemoryBudget(static_cast<size_t>(behavior.bufferMemoryMB) * 1024 * 1024);
+    resources.SetSyntaxIdleTime(std::chrono::minutes(behavior.syntaxIdleMinutes));
+    resources.Update();
+    LSPManager::GetInstance().Update();
+    JobSystem::RunMainThreadJobs();
+}
+
+void Application::WaitForFrame() {
+    auto& scheduler = FrameScheduler::GetInstance();
+    // Input is followed by a few frames for ImGui to settle: hover delays,
+    // double clicks, windows laid out a frame late
+    if (FrameScheduler::Clock::now() - m_LastInput >= INPUT_SETTLE) {
+        const FrameScheduler::Clock::duration idle = scheduler.GetIdleTime();
+        if (idle == FrameScheduler::Clock::duration::max()) {
+            SOL_PROFILE_ZONE("Idle");
+            glfwWaitEvents();
+        } else if (idle > FrameScheduler::Clock::duration::zero()) {
+            SOL_PROFILE_ZONE("Idle");
+            glfwWaitEventsTimeout(std::chrono::duration<double>(idle).count());
+        }
+    }
+    scheduler.BeginFrame();
+}
+
+bool Application::ReceivedInput() {
+    const ImGuiIO& io = ImGui::GetIO();
+    const bool resized = io.DisplaySize.x != m_LastDisplaySize.x || io.DisplaySize.y != m_LastDisplaySize.y;
+    m_LastDisplaySize = io.DisplaySize;
+    if (resized || io.MouseDelta.x != 0.0f || io.MouseDelta.y != 0.0f || io.MouseWheel != 0.0f ||
+        io.MouseWheelH != 0.0f || !io.InputQueueCharacters.empty()) {
+        return true;
+    }
+    for (int button = 0; button < ImGuiMouseButton_COUNT; ++button) {
+        if (ImGui::IsMouseDown(button) || ImGui::IsMouseReleased(button)) return true;
+    }
+    for (int key = ImGuiKey_NamedKey_BEGIN; key < ImGuiKey_NamedKey_END; ++key) {
+        if (ImGui::IsKeyDown(static_cast<ImGuiKey>(key)) || ImGui::IsKeyReleased(static_cast<ImGuiKey>(key))) return true;
+    }
+    return false;
 }
 
 void Application::OnMenuBar() {
@@ -86,6 +169,9 @@ void Application::OnMenuBar() {
 }
 
 void Application::OnUI() {
+    SOL_PROFILE_ZONE("Application::OnUI");
+    if (ReceivedInput()) m_LastInput = FrameScheduler::Clock::now();
+    
     // Process input through the new InputSystem
     ProcessInput();
     
@@ -93,6 +179,22 @@ void Application::OnUI() {
     
     // Render SaveAs dialog if open
     RenderSaveAsDialog();
+    
+    if (!m_FirstFrameBuilt) {
+        m_FirstFrameBuilt = true;
+        StartupTrace::GetInstance().Mark("first frame");
+    }
+}
+
+void Application::FinishStartupTrace() {
+    auto& trace = StartupTrace::GetInstance();
+    trace.Finish("present");
+    if (m_StartupTracePath.empty()) return;
+    
+    std::ofstream out(m_StartupTracePath);
+    trace.WriteJson(out);
+    if (!out) Logger::Error("Failed to write startup trace: ", m_StartupTracePath);
+    Quit();
 }
 
 void Application::SetupEvents() {
@@ -108,30 +210,34 @@ void Application::SetupEvents() {
         Logger::Info("Exit event completed successfully");
     })
     .SetFailureCallback([](const std::string& error) {
-        Logger::Error("Exit event failed: " + error);
+        Logger::Error("Exit event failed: ", error);
     });
     EventSystem::Register(exitEvent);
     
+    m_ToggleWindowSub = EventBus::Subscribe<ToggleWindowEvent>([this](const ToggleWindowEvent& event) {
+        if (!m_UISystem.ToggleLayer(event.windowId)) {
+            Logger::Error("Window not found: ", event.windowId);
+            return;
+        }
+        Logger::Info("Toggled window: ", event.windowId, " to ", (m_UISystem.IsLayerEnabled(event.windowId) ? "enabled" : "disabled"));
+    });
+    // For bindings naming the command
     auto toggleWindowEvent = std::make_shared<Event>("toggle_window");
-    toggleWindowEvent->SetHandler([this](const EventData& data) {
-        auto it = data.find("window_id");
-        if (it == data.end()) {
-            Logger::Error("toggle_window event missing window_id");
+    toggleWindowEvent->SetHandler([](const EventData& data) {
+        if (data.windowId.empty()) {
+            Logger::Error("toggle_window event missing windowId");
             return false;
         }
-        
-        std::string windowId = std::any_cast<std::string>(it->second);
-        auto layer = m_UISystem.GetLayer(windowId);
-        if (layer) {
-            layer->SetEnabled(!layer->IsEnabled());
-            Logger::Info("Toggled window: " + windowId + " to " + (layer->IsEnabled() ? "enabled" : "disabled"));
-            return true;
-        }
-        
-        Logger::Error("Window not found: " + windowId);
-        return false;
+        EventBus::Publish(ToggleWindowEvent{data.windowId});
+        return true;
     });
     EventSystem::Register(toggleWindowEvent);
+    auto togglePerfHudEvent = std::make_shared<Event>("toggle_perf_hud");
+    togglePerfHudEvent->SetHandler([](const EventData& data) {
+        EventBus::Publish(ToggleWindowEvent{"PerfHud"});
+        return true;
+    });
+    EventSystem::Register(togglePerfHudEvent);
     
     // File events
     auto openFileEvent = std::make_shared<Event>("open_file_dialog");
@@ -139,7 +245,7 @@ void Application::SetupEvents() {
         auto path = FileDialog::OpenFile("Open File");
         if (path) {
             ResourceSystem::GetInstance().OpenFile(*path);
-            Logger::Info("Opened file: " + path->string());
+            Logger::Info("Opened file: ", *path);
         }
         return true; // Dialog opened successfully, user cancel is not a failure
     });
@@ -151,10 +257,13 @@ void Application::SetupEvents() {
         if (path) {
             ResourceSystem::GetInstance().SetWorkingDirectory(*path);
             LSPManager::GetInstance().Initialize(path->string());
-            Logger::Info("Opened folder: " + path->string());
+            Logger::Info("Opened folder: ", *path);
             
             // Refresh explorer
-            if (m_Workspace) m_Workspace->GetExplorer().Refresh();
+            if (m_Workspace) {
+                m_Workspace->GetExplorer().Refresh();
+                m_Workspace->RestoreSession(ResourceSystem::GetInstance().GetWorkingDirectory());
+            }
         }
         return true; // Dialog opened successfully, user cancel is not a failure
     });
@@ -437,6 +546,23 @@ void Application::SetupEvents() {
     });
     EventSystem::Register(navRightEvent);
     
+    // Macro events, acted on by the focused editor
+    auto macroRecordEvent = std::make_shared<Event>("macro_record");
+    macroRecordEvent->SetHandler([](const EventData& data) {
+        if (InputSystem::GetInstance().GetContext() != InputContext::Editor) return false;
+        InputSystem::GetInstance().SetPendingMacro(MacroAction::ToggleRecording);
+        return true;
+    });
+    EventSystem::Register(macroRecordEvent);
+    
+    auto macroReplayEvent = std::make_shared<Event>("macro_replay");
+    macroReplayEvent->SetHandler([](const EventData& data) {
+        if (InputSystem::GetInstance().GetContext() != InputContext::Editor) return false;
+        InputSystem::GetInstance().SetPendingMacro(MacroAction::Replay);
+        return true;
+    });
+    EventSystem::Register(macroReplayEvent);
+    
     // Undo/Redo events
     auto undoEvent = std::make_shared<Event>("undo");
     undoEvent->SetHandler([this](const EventData& data) {
@@ -488,8 +614,8 @@ void Application::SetupEvents() {
             int status;
             waitpid(pid, &status, 0);
         }
-        Logger::Info(fileArg ? std::string("Opened new instance for: ") + filePath
-                              : "Opened new empty instance");
+        if (fileArg) Logger::Info("Opened new instance for: ", filePath);
+        else Logger::Info("Opened new empty instance");
         return true;
     });
     EventSystem::Register(openInNewInstanceEvent);
@@ -531,11 +657,11 @@ void Application::SetupEvents() {
     EventSystem::Register(focusPrevWindowEvent);
 
     // Show buffer in active window when a file is opened
-    ResourceSystem::GetInstance().SetOnBufferOpened([this](std::shared_ptr<Buffer> buffer) {
-        if (m_Workspace && buffer) {
+    m_BufferOpenedSub = EventBus::Subscribe<BufferOpenedEvent>([this](const BufferOpenedEvent& event) {
+        if (m_Workspace && event.buffer) {
             auto* win = m_Workspace->GetWindowTree().GetActiveWindow();
             if (win)
-                win->ShowBuffer(buffer->GetId());
+                win->ShowBuffer(event.buffer->GetId());
         }
     });
 
@@ -549,6 +675,13 @@ void Application::SetupEvents() {
         return false;
     });
     EventSystem::Register(telescopeFindEvent);
+
+    // Chrome trace of the last seconds, for chrome://tracing or Perfetto
+    auto dumpTraceEvent = std::make_shared<Event>("dump_trace");
+    dumpTraceEvent->SetHandler([](const EventData& data) {
+        return Profiler::WriteTrace("sol_trace.json", 10.0);
+    });
+    EventSystem::Register(dumpTraceEvent);
 }
 
 void Application::SetupUILayers() {
@@ -566,9 +699,9 @@ void Application::SetupUILayers() {
     auto statusBar = std::make_shared<StatusBar>();
     m_UISystem.RegisterLayer(statusBar);
 
-    auto settings = std::make_shared<SettingsWindow>();
-    settings->SetEnabled(false);
-    m_UISystem.RegisterLayer(settings);
+    // Hidden until toggled, so built only then
+    m_UISystem.RegisterLazyLayer("Settings", [] { return std::make_shared<SettingsWindow>(); });
+    m_UISystem.RegisterLazyLayer("PerfHud", [] { return std::make_shared<PerfHud>(); });
 }
 
 int Application::GetDockspaceFlags() {
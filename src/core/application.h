@@ -3,12 +3,15 @@
 #include <tinyvk/tinyvk.h>
 #include "ui/ui_system.h"
 #include "ui/layers/menu_bar.h"
+#include "core/event_bus.h"
+#include <chrono>
 #include <memory>
 #include <string>
 
 namespace sol {
 
 class Buffer;
+class EditSession;
 class Workspace;
 
 class Application : public tvk::App {
@@ -30,10 +33,24 @@ private:
     UISystem m_UISystem;
     MenuBar m_MenuBar{&m_UISystem};
     std::shared_ptr<Workspace> m_Workspace;
+    EventBus::SubscriptionId m_ToggleWindowSub = 0;
+    EventBus::SubscriptionId m_BufferOpenedSub = 0;
+
+    static constexpr auto INPUT_SETTLE = std::chrono::milliseconds(500);
+    std::chrono::steady_clock::time_point m_LastInput;
+    ImVec2 m_LastDisplaySize;
 
     std::string m_ExecutablePath;
     std::string m_InitialPath;
     
+    // Where --startup-trace writes the trace; the editor quits once it has
+    std::string m_StartupTracePath;
+    bool m_FirstFrameBuilt = false;
+    
+    // Where --record-session saves the session on the file opened, on exit
+    std::string m_SessionPath;
+    std::shared_ptr<EditSession> m_Session;
+    
     // SaveAs dialog state
     bool m_ShowSaveAsDialog = false;
     std::shared_ptr<Buffer> m_SaveAsBuffer;
@@ -44,7 +61,13 @@ private:
     void SetupUILayers();
     void SetupInputSystem();
     void ProcessInput();
+    // Sleeps until the next frame is due: on input, at a requested deadline
+    // or when another thread asks for one
+    void WaitForFrame();
+    bool ReceivedInput();
     void RenderSaveAsDialog();
+    // Once the first frame is on screen
+    void FinishStartupTrace();
     void OpenSaveAsDialog(std::shared_ptr<Buffer> buffer);
 };
 
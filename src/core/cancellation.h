@@ -0,0 +1,48 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+
+namespace sol {
+
+// What background work checks to learn it is no longer wanted. Checking is
+// a relaxed load, cheap enough for inner loops. A default token is never
+// cancelled.
+class CancellationToken {
+public:
+    CancellationToken() = default;
+
+    bool IsCancelled() const {
+        return m_Flag && std::atomic_ref<size_t>(*m_Flag).load(std::memory_order_relaxed) != 0;
+    }
+    // Nonzero once cancelled, for code that polls a flag of its own like
+    // tree-sitter's parser; null for a default token
+    const size_t* Flag() const { return m_Flag.get(); }
+
+private:
+    friend class CancellationSource;
+    explicit CancellationToken(std::shared_ptr<size_t> flag) : m_Flag(std::move(flag)) {}
+
+    std::shared_ptr<size_t> m_Flag;
+};
+
+// Cancels the tokens taken from it, for good; work started after that
+// takes a new source
+class CancellationSource {
+public:
+    CancellationSource() : m_Flag(std::make_shared<size_t>(0)) {}
+    // Copies cancel together; declared so that moving copies too and no
+    // source is ever left without a flag
+    CancellationSource(const CancellationSource&) = default;
+    CancellationSource& operator=(const CancellationSource&) = default;
+
+    void Cancel() { std::atomic_ref<size_t>(*m_Flag).store(1, std::memory_order_relaxed); }
+    bool IsCancelled() const { return std::atomic_ref<size_t>(*m_Flag).load(std::memory_order_relaxed) != 0; }
+    CancellationToken Token() const { return CancellationToken(m_Flag); }
+
+private:
+    std::shared_ptr<size_t> m_Flag;
+};
+
+} // namespace sol
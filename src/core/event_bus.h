@@ -0,0 +1,115 @@
+#pragma once
+
+#include "job_system.h"
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace sol {
+
+// Typed publish/subscribe. An event is any copyable type, which is also its
+// id, so publishing resolves its subscribers at compile time. Publishing
+// calls every subscriber on the publishing thread, in subscription order,
+// without taking a lock: it walks an immutable list that subscribing
+// replaces. A subscriber removed while an event is being published may
+// still receive that one event. Post defers publishing to the main thread.
+//
+// Usage Example:
+//
+// struct BufferSaved { Buffer::Id id; };
+//
+// auto id = sol::EventBus::Subscribe<BufferSaved>([](const BufferSaved& event) {
+//     Logger::Info("Saved buffer ", event.id);
+// });
+// sol::EventBus::Publish(BufferSaved{buffer->GetId()});  // Now, on this thread
+// sol::EventBus::Post(BufferSaved{buffer->GetId()});     // Next frame, on the main thread
+// sol::EventBus::Unsubscribe<BufferSaved>(id);
+
+class EventBus {
+public:
+    using SubscriptionId = uint32_t;
+
+    template <typename E>
+    static SubscriptionId Subscribe(std::function<void(const E&)> handler) {
+        return Channel<E>::Get().Add(std::move(handler));
+    }
+    template <typename E>
+    static void Unsubscribe(SubscriptionId id) {
+        Channel<E>::Get().Remove(id);
+    }
+
+    template <typename E>
+    static void Publish(const E& event) {
+        Channel<E>::Get().Publish(event);
+    }
+    template <typename E>
+    static void Post(E event) {
+        JobSystem::DispatchToMain([event = std::move(event)] { Publish(event); });
+    }
+
+private:
+    template <typename E>
+    class Channel {
+    public:
+        static Channel& Get() {
+            static Channel channel;
+            return channel;
+        }
+
+        ~Channel() {
+            delete m_List.load();
+        }
+
+        SubscriptionId Add(std::function<void(const E&)> handler) {
+            std::lock_guard<std::mutex> lock(m_Mutex);
+            auto list = std::make_unique<List>(*m_List.load());
+            list->push_back({++m_NextId, std::move(handler)});
+            Replace(std::move(list));
+            return m_NextId;
+        }
+
+        void Remove(SubscriptionId id) {
+            std::lock_guard<std::mutex> lock(m_Mutex);
+            auto list = std::make_unique<List>(*m_List.load());
+            std::erase_if(*list, [id](const Subscriber& subscriber) { return subscriber.id == id; });
+            Replace(std::move(list));
+        }
+
+        void Publish(const E& event) {
+            ReadScope scope(m_Readers);
+            for (const Subscriber& subscriber : *m_List.load()) subscriber.handler(event);
+        }
+
+    private:
+        struct Subscriber {
+            SubscriptionId id;
+            std::function<void(const E&)> handler;
+        };
+        using List = std::vector<Subscriber>;
+
+        struct ReadScope {
+            explicit ReadScope(std::atomic<uint32_t>& readers) : readers(readers) { readers.fetch_add(1); }
+            ~ReadScope() { readers.fetch_sub(1); }
+            std::atomic<uint32_t>& readers;
+        };
+
+        // Replaced lists are freed once no publish is running. A publish
+        // counted after the check loads the new list, as both the swap and
+        // the count are sequentially consistent.
+        void Replace(std::unique_ptr<const List> list) {
+            m_Retired.emplace_back(m_List.exchange(list.release()));
+            if (m_Readers.load() == 0) m_Retired.clear();
+        }
+
+        std::mutex m_Mutex;  // Serializes changes to the list
+        std::atomic<const List*> m_List{new List()};
+        std::atomic<uint32_t> m_Readers{0};  // Publishes running
+        std::vector<std::unique_ptr<const List>> m_Retired;
+        SubscriptionId m_NextId = 0;
+    };
+};
+
+} // namespace sol
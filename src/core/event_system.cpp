@@ -34,25 +34,55 @@ void EventSystem::RegisterEvent(std::shared_ptr<Event> event) {
         return;
     }
 
+    const EventHandle handle = ResolveEvent(event->GetId());
     std::lock_guard<std::mutex> lock(m_Mutex);
-    m_Events[event->GetId()] = event;
+    m_Events[handle] = event;
 }
 
 void EventSystem::UnregisterEvent(const EventId& id) {
     std::lock_guard<std::mutex> lock(m_Mutex);
-    m_Events.erase(id);
+    auto it = m_Handles.find(id);
+    if (it != m_Handles.end()) {
+        m_Events[it->second].reset();
+    }
 }
 
-bool EventSystem::ExecuteEvent(const EventId& id, const EventData& data) {
+EventHandle EventSystem::ResolveEvent(const EventId& id) {
     std::lock_guard<std::mutex> lock(m_Mutex);
+    auto [it, added] = m_Handles.try_emplace(id, static_cast<EventHandle>(m_Events.size()));
+    if (added) {
+        m_Events.emplace_back();
+    }
+    return it->second;
+}
 
-    auto it = m_Events.find(id);
-    if (it == m_Events.end()) {
-        return false;
+bool EventSystem::ExecuteEvent(const EventId& id, const EventData& data) {
+    std::shared_ptr<Event> event;
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        auto it = m_Handles.find(id);
+        if (it == m_Handles.end()) {
+            return false;
+        }
+        event = m_Events[it->second];
+    }
+    return event && Run(*event, data);
+}
+
+bool EventSystem::ExecuteEvent(EventHandle handle, const EventData& data) {
+    std::shared_ptr<Event> event;
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        if (handle >= m_Events.size()) {
+            return false;
+        }
+        event = m_Events[handle];
     }
+    return event && Run(*event, data);
+}
 
-    auto event = it->second;
-    const auto& handler = event->GetHandler();
+bool EventSystem::Run(const Event& event, const EventData& data) {
+    const auto& handler = event.GetHandler();
 
     if (!handler) {
         return false;
@@ -62,12 +92,12 @@ bool EventSystem::ExecuteEvent(const EventId& id, const EventData& data) {
         bool success = handler(data);
 
         if (success) {
-            const auto& successCallback = event->GetSuccessCallback();
+            const auto& successCallback = event.GetSuccessCallback();
             if (successCallback) {
                 successCallback(data);
             }
         } else {
-            const auto& failureCallback = event->GetFailureCallback();
+            const auto& failureCallback = event.GetFailureCallback();
             if (failureCallback) {
                 failureCallback("Event handler returned false");
             }
@@ -75,7 +105,7 @@ bool EventSystem::ExecuteEvent(const EventId& id, const EventData& data) {
 
         return success;
     } catch (const std::exception& e) {
-        const auto& failureCallback = event->GetFailureCallback();
+        const auto& failureCallback = event.GetFailureCallback();
         if (failureCallback) {
             failureCallback(std::string("Exception: ") + e.what());
         }
@@ -1,21 +1,27 @@
 #pragma once
 
+#include <cstdint>
 #include <functional>
-#include <map>
 #include <memory>
 #include <mutex>
 #include <string>
-#include <any>
+#include <unordered_map>
+#include <vector>
 
 namespace sol {
 
+// Commands named by strings, for ids only known at run time such as those
+// of keybindings; one handler each. Events known at compile time go through
+// the EventBus instead. Handlers run without the registry locked, so they
+// may execute other events. Callers dispatching often resolve the id to a
+// handle once and execute that, which skips hashing the string.
+//
 // Usage Example:
 //
 // // Create an event with a handler
-// auto event = std::make_shared<sol::Event>("on_button_click");
+// auto event = std::make_shared<sol::Event>("toggle_window");
 // event->SetHandler([](const sol::EventData& data) {
-//     int button_id = std::any_cast<int>(data.at("button_id"));
-//     std::cout << "Button " << button_id << " clicked!" << std::endl;
+//     std::cout << "Toggling " << data.windowId << std::endl;
 //     return true; // true = success, false = failure
 // })
 // .SetSuccessCallback([](const sol::EventData& data) {
@@ -29,15 +35,20 @@ namespace sol {
 // sol::EventSystem::GetInstance().RegisterEvent(event);
 //
 // // Execute the event with parameters
-// sol::EventData data;
-// data["button_id"] = 42;
-// sol::EventSystem::GetInstance().Execute("on_button_click", data);
+// sol::EventSystem::Execute("toggle_window", {.windowId = "Explorer"});
 //
 // // Unregister when done
-// sol::EventSystem::GetInstance().UnregisterEvent("on_button_click");
+// sol::EventSystem::Unregister("toggle_window");
 
 using EventId = std::string;
-using EventData = std::map<std::string, std::any>;
+// An id resolved to its slot; stays valid while the event is registered
+// again or removed
+using EventHandle = uint32_t;
+
+// Arguments of the events that take any
+struct EventData {
+    std::string windowId;  // Layer toggle_window toggles
+};
 
 class Event {
 public:
@@ -77,6 +88,8 @@ public:
     static void Register(std::shared_ptr<Event> event) { GetInstance().RegisterEvent(event); }
     static void Unregister(const EventId& id) { GetInstance().UnregisterEvent(id); }
     static bool Execute(const EventId& id, const EventData& data = {}) { return GetInstance().ExecuteEvent(id, data); }
+    static EventHandle Resolve(const EventId& id) { return GetInstance().ResolveEvent(id); }
+    static bool Execute(EventHandle handle, const EventData& data = {}) { return GetInstance().ExecuteEvent(handle, data); }
 
 private:
     EventSystem() = default;
@@ -84,9 +97,13 @@ private:
 
     void RegisterEvent(std::shared_ptr<Event> event);
     void UnregisterEvent(const EventId& id);
-    bool ExecuteEvent(const EventId& id, const EventData& data = {});
+    EventHandle ResolveEvent(const EventId& id);
+    bool ExecuteEvent(const EventId& id, const EventData& data);
+    bool ExecuteEvent(EventHandle handle, const EventData& data);
+    static bool Run(const Event& event, const EventData& data);
 
-    std::map<EventId, std::shared_ptr<Event>> m_Events;
+    std::unordered_map<EventId, EventHandle> m_Handles;
+    std::vector<std::shared_ptr<Event>> m_Events;  // By handle, null while unregistered
     mutable std::mutex m_Mutex;
 };
 
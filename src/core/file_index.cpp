@@ -0,0 +1,271 @@
+#include "file_index.h"
+#include "frame_scheduler.h"
+#include "workspace_files.h"
+#include "fuzzy_match.h"
+#include "parallel.h"
+#include "text/text_scan.h"
+#include <algorithm>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+
+namespace sol {
+
+std::string_view FileList::Name(size_t index) const {
+    return Text(m_Files[index].name);
+}
+
+std::string_view FileList::Directory(size_t index) const {
+    return Text(m_Directories[m_Files[index].directory]);
+}
+
+std::string FileList::RelativePath(size_t index) const {
+    std::string path(Directory(index));
+    path += Name(index);
+    return path;
+}
+
+std::filesystem::path FileList::FullPath(size_t index) const {
+    return m_Root / RelativePath(index);
+}
+
+bool FileList::operator==(const FileList& other) const {
+    if (m_Root != other.m_Root || Size() != other.Size()) return false;
+    for (size_t i = 0; i < Size(); ++i) {
+        if (Name(i) != other.Name(i) || Directory(i) != other.Directory(i)) return false;
+    }
+    return true;
+}
+
+// Interns each directory once; consecutive files of one directory skip the lookup
+class FileIndex::Builder {
+public:
+    explicit Builder(const std::filesystem::path& root) : m_List(std::make_shared<FileList>()) {
+        m_List->m_Root = root;
+    }
+
+    void Add(std::string_view directory, std::string_view name) {
+        if (m_Last == UINT32_MAX || directory != m_LastDirectory) {
+            auto [it, inserted] = m_Index.try_emplace(std::string(directory), static_cast<uint32_t>(m_List->m_Directories.size()));
+            if (inserted) m_List->m_Directories.push_back(Intern(directory));
+            m_Last = it->second;
+            m_LastDirectory = it->first;
+        }
+        m_List->m_Files.push_back({m_Last, Intern(name)});
+    }
+
+    void Add(std::string_view relative) {
+        const size_t slash = relative.rfind('/');
+        const size_t split = slash == std::string_view::npos ? 0 : slash + 1;
+        Add(relative.substr(0, split), relative.substr(split));
+    }
+
+    std::shared_ptr<const FileList> Finish() {
+        const FileList& list = *m_List;
+        auto key = [&list](const FileList::File& file) {
+            return std::pair(list.Text(list.m_Directories[file.directory]), list.Text(file.name));
+        };
+        auto& files = m_List->m_Files;
+        ParallelSort(files.begin(), files.end(), [&](const auto& a, const auto& b) { return key(a) < key(b); },
+                     JobPriority::Background);
+        files.erase(std::unique(files.begin(), files.end(), [&](const auto& a, const auto& b) { return key(a) == key(b); }),
+                    files.end());
+        files.shrink_to_fit();
+        m_List->m_Pool.shrink_to_fit();
+
+        FileList& out = *m_List;
+        out.m_Folded.resize(out.m_Pool.size());
+        std::transform(out.m_Pool.begin(), out.m_Pool.end(), out.m_Folded.begin(), FoldAscii);
+        std::vector<uint64_t> directoryMasks(out.m_Directories.size());
+        for (size_t d = 0; d < out.m_Directories.size(); ++d) {
+            directoryMasks[d] = FuzzyMatcher::CharMask(out.FoldedText(out.m_Directories[d]));
+        }
+        out.m_Masks.resize(files.size());
+        for (size_t i = 0; i < files.size(); ++i) {
+            out.m_Masks[i] = directoryMasks[files[i].directory] | FuzzyMatcher::CharMask(out.FoldedText(files[i].name));
+        }
+        return std::move(m_List);
+    }
+
+private:
+    FileList::Span Intern(std::string_view text) {
+        FileList::Span span{static_cast<uint32_t>(m_List->m_Pool.size()), static_cast<uint32_t>(text.size())};
+        m_List->m_Pool.append(text);
+        return span;
+    }
+
+    std::shared_ptr<FileList> m_List;
+    std::unordered_map<std::string, uint32_t> m_Index;
+    uint32_t m_Last = UINT32_MAX;
+    std::string_view m_LastDirectory;
+};
+
+FileIndex::FileIndex() {
+    m_Thread = std::thread(&FileIndex::Run, this);
+    m_Subscription = FileWatcher::GetInstance().Subscribe([this](const FileChanges& changes) {
+        // Edited ignore rules can hide or reveal anything below them
+        const bool rulesChanged = std::any_of(changes.paths.begin(), changes.paths.end(), [](const auto& path) {
+            return path.filename() == ".gitignore" || path.filename() == ".ignore";
+        });
+        if (changes.rescan || rulesChanged) {
+            Refresh();
+        } else {
+            Update(changes.paths);
+        }
+    });
+}
+
+FileIndex::~FileIndex() {
+    FileWatcher::GetInstance().Unsubscribe(m_Subscription);
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        m_Stopped = true;
+        m_Generation.fetch_add(1, std::memory_order_relaxed);
+    }
+    m_Wake.notify_one();
+    m_Thread.join();
+}
+
+void FileIndex::SetRoot(const std::filesystem::path& root) {
+    std::error_code ec;
+    auto canonical = std::filesystem::weakly_canonical(root, ec);
+
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        const std::filesystem::path& target = ec ? root : canonical;
+        if (target == m_Root) return;
+        m_Root = target;
+        m_Files.reset();
+        m_Changed.clear();
+        m_RescanPending = true;
+        m_Generation.fetch_add(1, std::memory_order_relaxed);
+    }
+    m_Wake.notify_one();
+}
+
+void FileIndex::Refresh() {
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        if (m_Root.empty() || m_RescanPending) return;
+        m_RescanPending = true;
+    }
+    m_Wake.notify_one();
+}
+
+void FileIndex::Update(std::vector<std::filesystem::path> paths) {
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        if (m_Root.empty()) return;
+        m_Changed.insert(m_Changed.end(), std::make_move_iterator(paths.begin()), std::make_move_iterator(paths.end()));
+    }
+    m_Wake.notify_one();
+}
+
+bool FileIndex::IsScanning() const {
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    return m_Busy || m_RescanPending;
+}
+
+std::shared_ptr<const FileList> FileIndex::Files() const {
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    return m_Files;
+}
+
+void FileIndex::Run() {
+    std::unique_lock<std::mutex> lock(m_Mutex);
+    while (true) {
+        m_Wake.wait(lock, [this] { return m_Stopped || m_RescanPending || !m_Changed.empty(); });
+        if (m_Stopped) return;
+
+        const std::filesystem::path root = m_Root;
+        const uint64_t generation = m_Generation.load(std::memory_order_relaxed);
+        const bool rescan = std::exchange(m_RescanPending, false);
+        std::vector<std::filesystem::path> changed;
+        changed.swap(m_Changed);
+        const std::shared_ptr<const FileList> base = m_Files;
+        m_Busy = true;
+        lock.unlock();
+
+        std::shared_ptr<const FileList> files;
+        if (rescan) {
+            files = Scan(root, generation);
+        } else if (base) {
+            files = Apply(*base, changed);
+        }
+        // Keep the published pointer when nothing changed so readers skip refiltering
+        if (files && base && *files == *base) files.reset();
+
+        lock.lock();
+        m_Busy = false;
+        if (files && m_Generation.load(std::memory_order_relaxed) == generation) {
+            m_Files = std::move(files);
+            FrameScheduler::GetInstance().RequestFrame();
+        }
+    }
+}
+
+std::shared_ptr<const FileList> FileIndex::Scan(const std::filesystem::path& root, uint64_t generation) const {
+    auto cancelled = [this, generation] { return m_Generation.load(std::memory_order_relaxed) != generation; };
+    std::mutex mutex;
+    Builder builder(root);
+    const bool finished = WalkWorkspace(root, {}, cancelled, [&](std::string_view directory, const std::vector<std::string>& names) {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (const std::string& name : names) builder.Add(directory, name);
+    });
+    return finished ? builder.Finish() : nullptr;
+}
+
+// A changed path drops its file, or everything under it for a directory,
+// then whatever exists there now is added back
+std::shared_ptr<const FileList> FileIndex::Apply(const FileList& base, const std::vector<std::filesystem::path>& paths) const {
+    const std::filesystem::path& root = base.Root();
+    std::unordered_set<std::string> changed;
+    std::unordered_set<std::string> parents;
+    for (const std::filesystem::path& path : paths) {
+        std::string relative = (path.is_absolute() ? path.lexically_relative(root) : path).generic_string();
+        if (relative.empty() || relative == "." || relative.starts_with("..")) continue;
+        const size_t slash = relative.rfind('/');
+        parents.insert(relative.substr(0, slash == std::string::npos ? 0 : slash + 1));
+        changed.insert(std::move(relative));
+    }
+    if (changed.empty()) return nullptr;
+
+    std::vector<uint8_t> dropped(base.m_Directories.size(), 0);
+    std::vector<uint8_t> touched(base.m_Directories.size(), 0);
+    for (size_t d = 0; d < base.m_Directories.size(); ++d) {
+        const std::string_view directory = base.Text(base.m_Directories[d]);
+        touched[d] = parents.contains(std::string(directory));
+        for (size_t slash = directory.find('/'); slash != std::string_view::npos && !dropped[d];
+             slash = directory.find('/', slash + 1)) {
+            dropped[d] = changed.contains(std::string(directory.substr(0, slash)));
+        }
+    }
+
+    Builder builder(root);
+    for (size_t i = 0; i < base.Size(); ++i) {
+        const uint32_t directory = base.m_Files[i].directory;
+        if (dropped[directory] || (touched[directory] && changed.contains(base.RelativePath(i)))) continue;
+        builder.Add(base.Directory(i), base.Name(i));
+    }
+
+    WorkspaceIgnoreFilter ignores(root);
+    std::mutex mutex;
+    auto addFiles = [&](std::string_view directory, const std::vector<std::string>& names) {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (const std::string& name : names) builder.Add(directory, name);
+    };
+    for (const std::string& relative : changed) {
+        const std::filesystem::path path = root / relative;
+        std::error_code ec;
+        const auto status = std::filesystem::status(path, ec);
+        if (ec) continue;
+        if (std::filesystem::is_regular_file(status)) {
+            if (!ignores.IsIgnored(relative, false)) builder.Add(relative);
+        } else if (std::filesystem::is_directory(status) && !ignores.IsIgnored(relative, true)) {
+            WalkWorkspace(root, relative, [] { return false; }, addFiles);
+        }
+    }
+    return builder.Finish();
+}
+
+} // namespace sol
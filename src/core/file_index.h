@@ -0,0 +1,106 @@
+#pragma once
+
+#include "file_watcher.h"
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+namespace sol {
+
+// Immutable table of the files under a root. Each directory's relative path
+// is stored once and files keep only their name, so paths share their prefix.
+// Files are ordered by directory, then name. Folded copies of the names and a
+// FuzzyMatcher::CharMask per file are computed once when the list is built.
+class FileList {
+public:
+    size_t Size() const { return m_Files.size(); }
+    const std::filesystem::path& Root() const { return m_Root; }
+
+    std::string_view Name(size_t index) const;
+    // Relative to the root with '/' separators and a trailing '/', empty at the root
+    std::string_view Directory(size_t index) const;
+    std::string RelativePath(size_t index) const;
+    std::filesystem::path FullPath(size_t index) const;
+
+    std::string_view FoldedName(size_t index) const { return FoldedText(m_Files[index].name); }
+    std::string_view FoldedDirectory(size_t index) const { return FoldedText(m_Directories[m_Files[index].directory]); }
+    uint64_t Mask(size_t index) const { return m_Masks[index]; }
+
+    bool operator==(const FileList& other) const;
+
+private:
+    friend class FileIndex;
+
+    struct Span {
+        uint32_t offset;
+        uint32_t length;
+    };
+
+    struct File {
+        uint32_t directory;
+        Span name;
+    };
+
+    std::string_view Text(Span span) const { return std::string_view(m_Pool).substr(span.offset, span.length); }
+    std::string_view FoldedText(Span span) const { return std::string_view(m_Folded).substr(span.offset, span.length); }
+
+    std::filesystem::path m_Root;
+    std::string m_Pool;
+    std::string m_Folded;  // m_Pool with ASCII case folded
+    std::vector<Span> m_Directories;
+    std::vector<File> m_Files;
+    std::vector<uint64_t> m_Masks;
+};
+
+// Workspace file index that outlives any one picker session. A background
+// thread builds it when the root changes and patches it for the changes the
+// FileWatcher reports; readers take the published FileList without locking it.
+class FileIndex {
+public:
+    FileIndex();
+    ~FileIndex();
+
+    FileIndex(const FileIndex&) = delete;
+    FileIndex& operator=(const FileIndex&) = delete;
+
+    // Rescans only when root differs from the indexed one
+    void SetRoot(const std::filesystem::path& root);
+    void Refresh();
+    // Files or directories under the root that were created, changed or
+    // removed; each is checked on disk when the batch is applied
+    void Update(std::vector<std::filesystem::path> paths);
+
+    bool IsScanning() const;
+    // Null until the first scan of the root finishes
+    std::shared_ptr<const FileList> Files() const;
+
+private:
+    class Builder;
+
+    void Run();
+    std::shared_ptr<const FileList> Scan(const std::filesystem::path& root, uint64_t generation) const;
+    std::shared_ptr<const FileList> Apply(const FileList& base, const std::vector<std::filesystem::path>& paths) const;
+
+    mutable std::mutex m_Mutex;
+    std::condition_variable m_Wake;
+    std::filesystem::path m_Root;
+    bool m_RescanPending = false;
+    std::vector<std::filesystem::path> m_Changed;
+    std::shared_ptr<const FileList> m_Files;
+    bool m_Busy = false;
+    bool m_Stopped = false;
+
+    std::atomic<uint64_t> m_Generation{0};  // Bumped to abandon the running scan
+    std::thread m_Thread;
+    FileWatcher::SubscriptionId m_Subscription = 0;
+};
+
+} // namespace sol
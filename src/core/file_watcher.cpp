@@ -0,0 +1,94 @@
+#include "file_watcher.h"
+#include "frame_scheduler.h"
+#include "logger.h"
+#include <algorithm>
+
+namespace sol {
+
+FileWatcher& FileWatcher::GetInstance() {
+    static FileWatcher instance;
+    return instance;
+}
+
+void FileWatcher::SetRoot(const std::filesystem::path& root) {
+    std::error_code ec;
+    auto canonical = std::filesystem::weakly_canonical(root, ec);
+    const std::filesystem::path& target = ec ? root : canonical;
+    if (target == m_Root && m_Watch) return;
+
+    // Joining the old watch thread while holding m_Mutex could deadlock with its callback
+    m_Watch.reset();
+    m_Root = target;
+    uint64_t generation;
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        generation = ++m_Generation;
+        m_Pending.clear();
+        m_PendingRescan = false;
+    }
+    m_Watch = DirectoryWatch::Start(m_Root, [this, generation](std::vector<std::filesystem::path> paths, bool rescan) {
+        OnEvents(generation, std::move(paths), rescan);
+    });
+    if (!m_Watch) Logger::Warning("Cannot watch ", m_Root, " for changes");
+}
+
+void FileWatcher::Shutdown() {
+    m_Watch.reset();
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    ++m_Generation;
+    m_Pending.clear();
+    m_PendingRescan = false;
+}
+
+bool FileWatcher::IsWatching() const {
+    return m_Watch != nullptr;
+}
+
+FileWatcher::SubscriptionId FileWatcher::Subscribe(Callback callback) {
+    const SubscriptionId id = m_NextId++;
+    m_Subscribers.emplace_back(id, std::move(callback));
+    return id;
+}
+
+void FileWatcher::Unsubscribe(SubscriptionId id) {
+    std::erase_if(m_Subscribers, [id](const auto& subscriber) { return subscriber.first == id; });
+}
+
+void FileWatcher::OnEvents(uint64_t generation, std::vector<std::filesystem::path> paths, bool rescan) {
+    const Clock::time_point now = Clock::now();
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    if (generation != m_Generation) return;
+    if (m_Pending.empty() && !m_PendingRescan) m_FirstEvent = now;
+    m_LastEvent = now;
+    m_PendingRescan |= rescan;
+    // A rescan covers every path, so there is no point collecting them
+    if (m_PendingRescan) {
+        m_Pending.clear();
+        return;
+    }
+    for (std::filesystem::path& path : paths) m_Pending.insert(std::move(path));
+    FrameScheduler::GetInstance().RequestFrameAt(std::min(now + DEBOUNCE, m_FirstEvent + MAX_DELAY));
+}
+
+void FileWatcher::Poll() {
+    FileChanges changes;
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        if (m_Pending.empty() && !m_PendingRescan) return;
+        const Clock::time_point now = Clock::now();
+        if (now - m_LastEvent < DEBOUNCE && now - m_FirstEvent < MAX_DELAY) {
+            FrameScheduler::GetInstance().RequestFrameAt(std::min(m_LastEvent + DEBOUNCE, m_FirstEvent + MAX_DELAY));
+            return;
+        }
+        changes.paths.assign(std::make_move_iterator(m_Pending.begin()), std::make_move_iterator(m_Pending.end()));
+        changes.rescan = m_PendingRescan;
+        m_Pending.clear();
+        m_PendingRescan = false;
+    }
+
+    // A subscriber may subscribe or unsubscribe from its callback
+    const auto subscribers = m_Subscribers;
+    for (const auto& [id, callback] : subscribers) callback(changes);
+}
+
+} // namespace sol
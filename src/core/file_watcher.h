@@ -0,0 +1,68 @@
+#pragma once
+
+#include "platform/directory_watch.h"
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <vector>
+
+namespace sol {
+
+struct FileChanges {
+    std::vector<std::filesystem::path> paths;  // Absolute and each listed once; files or directories
+    bool rescan = false;                       // Events were lost, anything under the root may have changed
+};
+
+// Watches the working directory with the platform's change notifications and
+// hands subscribers coalesced batches on the main thread from Poll. A batch
+// goes out once events have paused for DEBOUNCE, or after MAX_DELAY while
+// they keep coming.
+class FileWatcher {
+public:
+    using Callback = std::function<void(const FileChanges&)>;
+    using SubscriptionId = uint32_t;
+
+    static FileWatcher& GetInstance();
+
+    FileWatcher(const FileWatcher&) = delete;
+    FileWatcher& operator=(const FileWatcher&) = delete;
+
+    void SetRoot(const std::filesystem::path& root);
+    void Shutdown();
+    // False when the root could not be watched and callers must rescan themselves
+    bool IsWatching() const;
+
+    SubscriptionId Subscribe(Callback callback);
+    void Unsubscribe(SubscriptionId id);
+
+    void Poll();
+
+private:
+    FileWatcher() = default;
+    ~FileWatcher() = default;
+
+    using Clock = std::chrono::steady_clock;
+    static constexpr auto DEBOUNCE = std::chrono::milliseconds(150);
+    static constexpr auto MAX_DELAY = std::chrono::milliseconds(1000);
+
+    void OnEvents(uint64_t generation, std::vector<std::filesystem::path> paths, bool rescan);
+
+    std::unique_ptr<DirectoryWatch> m_Watch;
+    std::filesystem::path m_Root;
+
+    mutable std::mutex m_Mutex;  // Guards the pending batch, filled from the watch thread
+    uint64_t m_Generation = 0;   // Of the current root; events of an old watch are dropped
+    std::set<std::filesystem::path> m_Pending;
+    bool m_PendingRescan = false;
+    Clock::time_point m_FirstEvent;
+    Clock::time_point m_LastEvent;
+
+    std::vector<std::pair<SubscriptionId, Callback>> m_Subscribers;
+    SubscriptionId m_NextId = 1;
+};
+
+} // namespace sol
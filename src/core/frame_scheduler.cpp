@@ -0,0 +1,54 @@
+#include "frame_scheduler.h"
+#include <algorithm>
+
+namespace sol {
+
+FrameScheduler& FrameScheduler::GetInstance() {
+    static FrameScheduler instance;
+    return instance;
+}
+
+void FrameScheduler::SetWaker(std::function<void()> waker) {
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    m_Waker = std::move(waker);
+    m_LoopThread = std::this_thread::get_id();
+}
+
+void FrameScheduler::RequestFrame() {
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    if (m_Pending) return;
+    m_Pending = true;
+    Wake();
+}
+
+void FrameScheduler::RequestFrameAt(Clock::time_point when) {
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    if (when >= m_Deadline) return;
+    m_Deadline = when;
+    // The loop may be asleep past the new deadline
+    if (!m_Pending) Wake();
+}
+
+void FrameScheduler::RequestFrameIn(double seconds) {
+    RequestFrameAt(Clock::now() + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(seconds)));
+}
+
+FrameScheduler::Clock::duration FrameScheduler::GetIdleTime() const {
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    if (m_Pending) return Clock::duration::zero();
+    if (m_Deadline == Clock::time_point::max()) return Clock::duration::max();
+    return std::max(m_Deadline - Clock::now(), Clock::duration::zero());
+}
+
+void FrameScheduler::BeginFrame() {
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    m_Pending = false;
+    if (m_Deadline <= Clock::now()) m_Deadline = Clock::time_point::max();
+}
+
+void FrameScheduler::Wake() {
+    // The loop looks at the requests again before it next sleeps
+    if (m_Waker && std::this_thread::get_id() != m_LoopThread) m_Waker();
+}
+
+} // namespace sol
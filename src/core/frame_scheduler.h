@@ -0,0 +1,53 @@
+#pragma once
+
+#include <chrono>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+namespace sol {
+
+// Decides when the UI draws. Whatever changes what is shown asks for a
+// frame, from any thread; with nothing asked for, the loop sleeps until the
+// earliest deadline or until woken. Requests coalesce, so asking again
+// before the frame is drawn costs a lock and nothing more.
+class FrameScheduler {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    static FrameScheduler& GetInstance();
+
+    FrameScheduler(const FrameScheduler&) = delete;
+    FrameScheduler& operator=(const FrameScheduler&) = delete;
+
+    // Called on the loop's thread with how to break its sleep from another
+    void SetWaker(std::function<void()> waker);
+
+    // Draws the next frame as soon as possible
+    void RequestFrame();
+    // Draws a frame no later than when, e.g. for the next cursor blink
+    void RequestFrameAt(Clock::time_point when);
+    void RequestFrameIn(double seconds);
+
+    // How long the loop may sleep before the next frame: zero when one is
+    // due, Clock::duration::max() for until woken
+    Clock::duration GetIdleTime() const;
+    // Called by the loop right before it draws; the frame answers every
+    // request made so far and every deadline passed
+    void BeginFrame();
+
+private:
+    FrameScheduler() = default;
+    ~FrameScheduler() = default;
+
+    // Called with the lock held
+    void Wake();
+
+    mutable std::mutex m_Mutex;
+    std::function<void()> m_Waker;
+    std::thread::id m_LoopThread;
+    bool m_Pending = true;  // The first frame always draws
+    Clock::time_point m_Deadline = Clock::time_point::max();
+};
+
+} // namespace sol
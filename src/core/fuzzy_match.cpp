@@ -0,0 +1,82 @@
+#include "fuzzy_match.h"
+#include "text/text_scan.h"
+#include <climits>
+#include <cstring>
+
+namespace sol {
+
+FuzzyMatcher::FuzzyMatcher(std::string_view query) {
+    m_Query.reserve(query.length());
+    for (char c : query) m_Query.push_back(FoldAscii(c));
+    m_Mask = CharMask(m_Query);
+}
+
+uint64_t FuzzyMatcher::CharMask(std::string_view folded) {
+    uint64_t mask = 0;
+    for (char ch : folded) {
+        const auto c = static_cast<unsigned char>(ch);
+        unsigned bit;
+        if (c >= 'a' && c <= 'z') {
+            bit = c - 'a';
+        } else if (c >= '0' && c <= '9') {
+            bit = 26 + (c - '0');
+        } else {
+            bit = 36 + c % 28;
+        }
+        mask |= uint64_t{1} << bit;
+    }
+    return mask;
+}
+
+int FuzzyMatcher::Score(std::string_view name, std::string_view directory, uint64_t mask) {
+    if (m_Query.empty()) return 0;
+    if ((m_Mask & ~mask) != 0) return INT_MAX;
+
+    const int score = Tiered(name);
+    if (score != INT_MAX) return score;
+
+    m_Path.assign(directory);
+    m_Path.append(name);
+    const int pathScore = Tiered(m_Path);
+    return pathScore == INT_MAX ? INT_MAX : 10000 + pathScore;
+}
+
+int FuzzyMatcher::Tiered(std::string_view text) const {
+    const int length = static_cast<int>(text.length());
+    if (text == m_Query) return 0;
+    if (m_Query.length() < text.length() && text.starts_with(m_Query)) return 1000 + length;
+
+    const size_t pos = FindFolded(text, m_Query);
+    if (pos != std::string_view::npos) return 2000 + static_cast<int>(pos) + length;
+
+    const int fuzzy = Fuzzy(text);
+    return fuzzy == INT_MAX ? INT_MAX : 3000 + fuzzy;
+}
+
+// Greedy in-order match jumping between query chars with memchr.
+// Rewards consecutive runs heavily, penalizes gaps.
+int FuzzyMatcher::Fuzzy(std::string_view text) const {
+    const char* data = text.data();
+    size_t from = 0;
+    size_t last = SIZE_MAX;
+    int gap = 0;
+    int consecutive = 0;
+    for (char c : m_Query) {
+        if (from >= text.length()) return INT_MAX;
+        const void* hit = std::memchr(data + from, c, text.length() - from);
+        if (!hit) return INT_MAX;
+        const size_t pos = static_cast<const char*>(hit) - data;
+        if (last != SIZE_MAX) {
+            if (pos == last + 1) {
+                ++consecutive;
+            } else {
+                gap += static_cast<int>(pos - last - 1);
+            }
+        }
+        last = pos;
+        from = pos + 1;
+    }
+    return gap * 8 - consecutive * 12 + static_cast<int>(text.length() - m_Query.length());
+}
+
+} // namespace sol
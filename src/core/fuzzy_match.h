@@ -0,0 +1,38 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+namespace sol {
+
+// Scores workspace paths against a query ignoring ASCII case. Texts passed in
+// must already be folded with FoldAscii. Lower is better, INT_MAX is no match.
+// Tiers for filename matches:
+//   0        : exact
+//   1000+    : prefix
+//   2000+    : substring (position + length)
+//   3000+    : fuzzy (all chars in order, scored by gap penalty & consecutive bonus)
+// Path-only matches start at 10000 with the same sub-tiers.
+class FuzzyMatcher {
+public:
+    explicit FuzzyMatcher(std::string_view query);
+
+    // Bloom-style set of the bytes in text; a path can only match when it
+    // holds every bit of the query's mask
+    static uint64_t CharMask(std::string_view folded);
+
+    // directory ends with '/' unless empty; mask covers directory and name.
+    // Reuses a scratch buffer, so one matcher per thread.
+    int Score(std::string_view name, std::string_view directory, uint64_t mask);
+
+private:
+    int Tiered(std::string_view text) const;
+    int Fuzzy(std::string_view text) const;
+
+    std::string m_Query;  // Folded
+    uint64_t m_Mask = 0;
+    std::string m_Path;
+};
+
+} // namespace sol
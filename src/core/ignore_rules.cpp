@@ -0,0 +1,198 @@
+#include "ignore_rules.h"
+#include <algorithm>
+#include <fstream>
+#include <iterator>
+
+namespace sol {
+
+std::shared_ptr<const IgnoreRules> IgnoreRules::Parse(std::string_view text, std::string base) {
+    auto rules = std::make_shared<IgnoreRules>();
+    rules->m_Base = std::move(base);
+    while (!text.empty()) {
+        const size_t newline = text.find('\n');
+        std::string_view line = text.substr(0, newline);
+        text.remove_prefix(newline == std::string_view::npos ? text.size() : newline + 1);
+        if (!line.empty() && line.back() == '\r') line.remove_suffix(1);
+        rules->Add(line);
+    }
+    return rules;
+}
+
+std::shared_ptr<const IgnoreRules> IgnoreRules::Load(const std::string& path, std::string base) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file) return nullptr;
+    const std::string text((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    auto rules = Parse(text, std::move(base));
+    return rules->Empty() ? nullptr : rules;
+}
+
+void IgnoreRules::Add(std::string_view pattern) {
+    if (pattern.empty() || pattern[0] == '#') return;
+    while (!pattern.empty() && pattern.back() == ' ' &&
+           (pattern.size() < 2 || pattern[pattern.size() - 2] != '\\')) {
+        pattern.remove_suffix(1);
+    }
+
+    Glob glob{};
+    glob.negated = !pattern.empty() && pattern[0] == '!';
+    if (glob.negated) pattern.remove_prefix(1);
+    glob.directoryOnly = !pattern.empty() && pattern.back() == '/';
+    if (glob.directoryOnly) pattern.remove_suffix(1);
+    if (pattern.starts_with("**/") && pattern.find('/', 3) == std::string_view::npos) pattern.remove_prefix(3);
+    glob.anchored = pattern.find('/') != std::string_view::npos;
+    if (pattern.starts_with('/')) pattern.remove_prefix(1);
+    if (pattern.empty()) return;
+
+    std::vector<Token>& tokens = glob.tokens;
+    for (size_t i = 0; i < pattern.size(); ++i) {
+        const char c = pattern[i];
+        if (c == '\\' && i + 1 < pattern.size()) {
+            tokens.push_back({Token::Char, pattern[++i]});
+        } else if (c == '?') {
+            tokens.push_back({Token::Any});
+        } else if (c == '*') {
+            size_t end = i;
+            while (end < pattern.size() && pattern[end] == '*') ++end;
+            const bool ownSegment = (i == 0 || pattern[i - 1] == '/') && (end == pattern.size() || pattern[end] == '/');
+            if (end - i >= 2 && ownSegment) {
+                // "**/" may match no directories at all; a trailing "/**" matches everything below
+                tokens.push_back({Token::GlobStar, 0, end < pattern.size()});
+            } else {
+                tokens.push_back({Token::Star});
+            }
+            i = end - 1;
+        } else if (c == '[' && pattern.find(']', i + 2) != std::string_view::npos) {
+            std::bitset<256> set;
+            size_t j = i + 1;
+            const bool negate = pattern[j] == '!' || pattern[j] == '^';
+            if (negate) ++j;
+            for (bool first = true; j < pattern.size() && (first || pattern[j] != ']'); first = false) {
+                if (pattern[j] == '\\' && j + 1 < pattern.size()) ++j;
+                unsigned char low = static_cast<unsigned char>(pattern[j++]);
+                unsigned char high = low;
+                if (j + 1 < pattern.size() && pattern[j] == '-' && pattern[j + 1] != ']') {
+                    high = static_cast<unsigned char>(pattern[j + 1]);
+                    j += 2;
+                }
+                for (unsigned v = low; v <= high; ++v) set.set(v);
+            }
+            if (j >= pattern.size()) {
+                tokens.push_back({Token::Char, c});
+                continue;
+            }
+            if (negate) set.flip();
+            set.reset('/');
+            tokens.push_back({Token::Class, 0, false, static_cast<uint16_t>(m_Sets.size())});
+            m_Sets.push_back(set);
+            i = j;
+        } else {
+            tokens.push_back({Token::Char, c});
+        }
+    }
+
+    glob.rule = m_Count++;
+    size_t literal = 0;
+    while (literal < tokens.size() && tokens[literal].kind == Token::Char) glob.prefix += tokens[literal++].c;
+    const Literal entry{glob.rule, glob.directoryOnly, glob.negated};
+    if (!glob.anchored && literal == tokens.size()) {
+        m_Names[glob.prefix].push_back(entry);
+        return;
+    }
+    if (!glob.anchored && tokens[0].kind == Token::Star) {
+        std::string suffix;
+        size_t i = 1;
+        for (; i < tokens.size() && tokens[i].kind == Token::Char; ++i) suffix += tokens[i].c;
+        if (i == tokens.size()) {
+            m_Suffixes.emplace_back(std::move(suffix), entry);
+            return;
+        }
+    }
+    tokens.erase(tokens.begin(), tokens.begin() + static_cast<ptrdiff_t>(literal));
+    m_Globs.push_back(std::move(glob));
+}
+
+IgnoreRules::Result IgnoreRules::Match(std::string_view relative, bool directory) const {
+    if (m_Count == 0) return Result::None;
+    const std::string_view path = relative.substr(m_Base.size());
+    const size_t slash = path.rfind('/');
+    const std::string_view name = slash == std::string_view::npos ? path : path.substr(slash + 1);
+
+    int64_t best = -1;
+    bool negated = false;
+    auto consider = [&](const Literal& literal) {
+        if (static_cast<int64_t>(literal.rule) > best && (directory || !literal.directoryOnly)) {
+            best = literal.rule;
+            negated = literal.negated;
+        }
+    };
+    if (auto it = m_Names.find(name); it != m_Names.end()) {
+        for (const Literal& literal : it->second) consider(literal);
+    }
+    for (const auto& [suffix, literal] : m_Suffixes) {
+        if (name.ends_with(suffix)) consider(literal);
+    }
+    for (auto it = m_Globs.rbegin(); it != m_Globs.rend() && static_cast<int64_t>(it->rule) > best; ++it) {
+        if (it->directoryOnly && !directory) continue;
+        if (Run(*it, it->anchored ? path : name)) {
+            best = it->rule;
+            negated = it->negated;
+            break;
+        }
+    }
+    if (best < 0) return Result::None;
+    return negated ? Result::Include : Result::Ignore;
+}
+
+// Simulates the glob as an NFA over token positions, one bit per position
+bool IgnoreRules::Run(const Glob& glob, std::string_view text) const {
+    if (!text.starts_with(glob.prefix)) return false;
+    text.remove_prefix(glob.prefix.size());
+
+    const std::vector<Token>& tokens = glob.tokens;
+    const size_t count = tokens.size();
+    const size_t words = (count + 64) / 64;
+    thread_local std::vector<uint64_t> scratch;
+    scratch.assign(words * 2, 0);
+    uint64_t* current = scratch.data();
+    uint64_t* next = current + words;
+
+    auto set = [](uint64_t* bits, size_t i) { bits[i / 64] |= uint64_t{1} << (i % 64); };
+    auto test = [](const uint64_t* bits, size_t i) { return (bits[i / 64] >> (i % 64)) & 1; };
+    auto close = [&](uint64_t* bits) {
+        for (size_t i = 0; i < count; ++i) {
+            if (!test(bits, i)) continue;
+            const Token& token = tokens[i];
+            if (token.kind == Token::Star || token.kind == Token::GlobStar) set(bits, i + 1);
+            if (token.skipSlash) set(bits, i + 2);
+        }
+    };
+
+    set(current, 0);
+    close(current);
+    for (char c : text) {
+        std::fill(next, next + words, 0);
+        bool alive = false;
+        for (size_t i = 0; i < count; ++i) {
+            if (!test(current, i)) continue;
+            const Token& token = tokens[i];
+            size_t to = SIZE_MAX;
+            switch (token.kind) {
+            case Token::Char: if (c == token.c) to = i + 1; break;
+            case Token::Any: if (c != '/') to = i + 1; break;
+            case Token::Class: if (m_Sets[token.set].test(static_cast<unsigned char>(c))) to = i + 1; break;
+            case Token::Star: if (c != '/') to = i; break;
+            case Token::GlobStar: to = i; break;
+            }
+            if (to != SIZE_MAX) {
+                set(next, to);
+                alive = true;
+            }
+        }
+        if (!alive) return false;
+        close(next);
+        std::swap(current, next);
+    }
+    return test(current, count);
+}
+
+} // namespace sol
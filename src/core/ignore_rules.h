@@ -0,0 +1,75 @@
+#pragma once
+
+#include <bitset>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace sol {
+
+// The patterns of one .gitignore-style file, compiled once. Plain names and
+// "*.ext" patterns are looked up directly; the rest run as small glob
+// programs whose cost is linear in the path. Supports comments, '!'
+// negation, trailing '/' for directories, anchoring, '*', '?', '[...]'
+// classes, '**' and backslash escapes.
+class IgnoreRules {
+public:
+    enum class Result { None, Ignore, Include };
+
+    // base is the directory the file applies to, relative to the walk root
+    // with a trailing '/', empty at the root
+    static std::shared_ptr<const IgnoreRules> Parse(std::string_view text, std::string base);
+    // Null when the file is missing or holds no patterns
+    static std::shared_ptr<const IgnoreRules> Load(const std::string& path, std::string base);
+
+    bool Empty() const { return m_Count == 0; }
+    const std::string& Base() const { return m_Base; }
+
+    // relative is from the walk root and must lie under Base(); the last
+    // matching pattern decides
+    Result Match(std::string_view relative, bool directory) const;
+
+private:
+    struct Token {
+        enum Kind : uint8_t { Char, Any, Class, Star, GlobStar } kind;
+        char c = 0;
+        bool skipSlash = false;  // GlobStar of "/**/", which may also match nothing
+        uint16_t set = 0;        // Index into m_Sets
+    };
+
+    struct Glob {
+        std::vector<Token> tokens;
+        std::string prefix;  // Literal text every match starts with
+        uint32_t rule;
+        bool anchored;       // Matched against the path, otherwise the name
+        bool directoryOnly;
+        bool negated;
+    };
+
+    struct NameHash {
+        using is_transparent = void;
+        size_t operator()(std::string_view name) const { return std::hash<std::string_view>{}(name); }
+    };
+
+    struct Literal {
+        uint32_t rule;
+        bool directoryOnly;
+        bool negated;
+    };
+
+    void Add(std::string_view pattern);
+    bool Run(const Glob& glob, std::string_view text) const;
+
+    std::string m_Base;
+    uint32_t m_Count = 0;
+    std::unordered_map<std::string, std::vector<Literal>, NameHash, std::equal_to<>> m_Names;
+    std::vector<std::pair<std::string, Literal>> m_Suffixes;
+    std::vector<Glob> m_Globs;  // In rule order
+    std::vector<std::bitset<256>> m_Sets;
+};
+
+} // namespace sol
@@ -1,96 +1,256 @@
 #include "job_system.h"
+#include "frame_scheduler.h"
+#include "logger.h"
+#include "profiler.h"
+#include <algorithm>
+#include <exception>
 #include <thread>
 
 namespace sol {
 
-Job::Job(Function function)
-    : m_Function(std::move(function)) {}
+namespace {
 
-Job& Job::SetSuccessCallback(SuccessCallback callback) {
-    m_SuccessCallback = std::move(callback);
-    return *this;
-}
+// Chase-Lev work-stealing deque, after Le et al., "Correct and Efficient
+// Work-Stealing for Weak Memory Models". The owning worker pushes and pops
+// at the bottom; other workers steal from the top. Arrays outgrown stay
+// alive until the deque goes, since a thief may still be reading one.
+template <typename T>
+class WorkStealingDeque {
+public:
+    WorkStealingDeque() {
+        m_Arrays.push_back(std::make_unique<Array>(INITIAL_CAPACITY));
+        m_Array.store(m_Arrays.back().get(), std::memory_order_relaxed);
+    }
 
-Job& Job::SetFailureCallback(FailureCallback callback) {
-    m_FailureCallback = std::move(callback);
-    return *this;
-}
+    // Owner only
+    void Push(T* item) {
+        const int64_t bottom = m_Bottom.load(std::memory_order_relaxed);
+        const int64_t top = m_Top.load(std::memory_order_acquire);
+        Array* array = m_Array.load(std::memory_order_relaxed);
+        if (bottom - top > array->capacity - 1) array = Grow(array, top, bottom);
+        array->Put(bottom, item);
+        // Publishes the item to thieves, which read the bottom with acquire
+        m_Bottom.store(bottom + 1, std::memory_order_release);
+    }
+
+    // Owner only; newest first
+    T* Pop() {
+        const int64_t bottom = m_Bottom.load(std::memory_order_relaxed) - 1;
+        Array* array = m_Array.load(std::memory_order_relaxed);
+        m_Bottom.store(bottom, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        int64_t top = m_Top.load(std::memory_order_relaxed);
+        
+        T* item = nullptr;
+        if (top <= bottom) {
+            item = array->Get(bottom);
+            if (top == bottom) {
+                // The last item; a thief may be taking it too
+                if (!m_Top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+                    item = nullptr;
+                }
+                m_Bottom.store(bottom + 1, std::memory_order_relaxed);
+            }
+        } else {
+            m_Bottom.store(bottom + 1, std::memory_order_relaxed);
+        }
+        return item;
+    }
+
+    // Any thread; a snapshot that may be off by the operations in flight
+    size_t Size() const {
+        const int64_t bottom = m_Bottom.load(std::memory_order_relaxed);
+        const int64_t top = m_Top.load(std::memory_order_relaxed);
+        return bottom > top ? static_cast<size_t>(bottom - top) : 0;
+    }
+
+    // Any thread; oldest first. Retries when another thief won the race, so
+    // null means the deque was seen empty.
+    T* Steal() {
+        while (true) {
+            int64_t top = m_Top.load(std::memory_order_acquire);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            const int64_t bottom = m_Bottom.load(std::memory_order_acquire);
+            if (top >= bottom) return nullptr;
+            
+            T* item = m_Array.load(std::memory_order_acquire)->Get(top);
+            if (m_Top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+                return item;
+            }
+        }
+    }
+
+private:
+    static constexpr int64_t INITIAL_CAPACITY = 256;
+
+    struct Array {
+        explicit Array(int64_t size) : capacity(size), slots(new std::atomic<T*>[size]) {}
+        
+        T* Get(int64_t index) const { return slots[index & (capacity - 1)].load(std::memory_order_relaxed); }
+        void Put(int64_t index, T* item) { slots[index & (capacity - 1)].store(item, std::memory_order_relaxed); }
+        
+        const int64_t capacity;  // Power of two
+        std::unique_ptr<std::atomic<T*>[]> slots;
+    };
+
+    Array* Grow(Array* array, int64_t top, int64_t bottom) {
+        auto grown = std::make_unique<Array>(array->capacity * 2);
+        for (int64_t i = top; i < bottom; ++i) grown->Put(i, array->Get(i));
+        m_Arrays.push_back(std::move(grown));
+        Array* result = m_Arrays.back().get();
+        m_Array.store(result, std::memory_order_release);
+        return result;
+    }
+
+    alignas(64) std::atomic<int64_t> m_Top{0};
+    alignas(64) std::atomic<int64_t> m_Bottom{0};
+    std::atomic<Array*> m_Array{nullptr};
+    std::vector<std::unique_ptr<Array>> m_Arrays;  // Owner only
+};
+
+} // namespace
+
+struct JobSystem::Worker {
+    WorkStealingDeque<Task> deques[PRIORITY_COUNT];
+};
+
+thread_local JobSystem::Worker* JobSystem::s_CurrentWorker = nullptr;
 
 JobSystem& JobSystem::GetInstance() {
     static JobSystem instance;
     return instance;
 }
 
-JobSystem::JobSystem() : m_Running(true) {
+JobSystem::JobSystem() {
     // Create n-1 worker threads where n is number of CPU cores
     uint32_t numThreads = std::max(1u, std::thread::hardware_concurrency() - 1);
 
+    // Every deque exists before any worker can steal from it
     for (uint32_t i = 0; i < numThreads; ++i) {
-        m_WorkerThreads.emplace_back(&JobSystem::WorkerThread, this);
+        m_Workers.push_back(std::make_unique<Worker>());
+    }
+    for (uint32_t i = 0; i < numThreads; ++i) {
+        m_WorkerThreads.emplace_back(&JobSystem::WorkerThread, this, i);
     }
 }
 
 JobSystem::~JobSystem() {
     ShutdownWorkers();
+    
+    // Submitted while shutting down, after the workers left
+    for (Injector& injector : m_Injected) {
+        for (Task* task : injector.tasks) delete task;
+    }
+    for (Task* task : m_MainQueue) delete task;
+    for (auto& worker : m_Workers) {
+        for (auto& deque : worker->deques) {
+            while (Task* task = deque.Pop()) delete task;
+        }
+    }
 }
 
-void JobSystem::SubmitJob(std::shared_ptr<Job> job, const JobData& data) {
+void JobSystem::Push(Task* task, JobPriority priority) {
+    if (!m_Running.load(std::memory_order_acquire)) {
+        delete task;
+        return;
+    }
+    
+    const size_t level = static_cast<size_t>(priority);
+    if (s_CurrentWorker) {
+        s_CurrentWorker->deques[level].Push(task);
+    } else {
+        Injector& injector = m_Injected[level];
+        std::lock_guard<std::mutex> lock(injector.mutex);
+        injector.tasks.push_back(task);
+        injector.size.fetch_add(1, std::memory_order_release);
+    }
+    m_Signal.fetch_add(1, std::memory_order_release);
+    m_Signal.notify_one();
+}
+
+void JobSystem::PushMain(Task* task) {
     {
-        std::lock_guard<std::mutex> lock(m_QueueMutex);
-        if (!m_Running) return;
-        m_JobQueue.push({job, data});
+        std::lock_guard<std::mutex> lock(m_MainMutex);
+        m_MainQueue.push_back(task);
     }
-    m_QueueCV.notify_one();
+    FrameScheduler::GetInstance().RequestFrame();
 }
 
-void JobSystem::WorkerThread() {
-    while (true) {
-        JobTask task;
-        {
-            std::unique_lock<std::mutex> lock(m_QueueMutex);
-            m_QueueCV.wait(lock, [this] { return !m_JobQueue.empty() || !m_Running; });
+void JobSystem::DrainMainThread() {
+    std::vector<Task*> tasks;
+    {
+        std::lock_guard<std::mutex> lock(m_MainMutex);
+        tasks.swap(m_MainQueue);
+    }
+    // Anything these dispatch runs next frame
+    for (Task* task : tasks) Execute(task);
+}
 
-            if (!m_Running && m_JobQueue.empty()) {
-                break;
-            }
+size_t JobSystem::QueuedTasks(JobPriority priority) const {
+    const size_t level = static_cast<size_t>(priority);
+    size_t count = m_Injected[level].size.load(std::memory_order_relaxed);
+    for (const auto& worker : m_Workers) count += worker->deques[level].Size();
+    return count;
+}
 
-            if (m_JobQueue.empty()) {
-                continue;
+JobSystem::Task* JobSystem::FindTask(size_t index) {
+    const size_t count = m_Workers.size();
+    for (size_t level = 0; level < PRIORITY_COUNT; ++level) {
+        if (Task* task = m_Workers[index]->deques[level].Pop()) return task;
+        
+        Injector& injector = m_Injected[level];
+        if (injector.size.load(std::memory_order_acquire) > 0) {
+            std::lock_guard<std::mutex> lock(injector.mutex);
+            if (!injector.tasks.empty()) {
+                Task* task = injector.tasks.front();
+                injector.tasks.pop_front();
+                injector.size.fetch_sub(1, std::memory_order_relaxed);
+                return task;
             }
-
-            task = m_JobQueue.front();
-            m_JobQueue.pop();
         }
+        
+        for (size_t offset = 1; offset < count; ++offset) {
+            if (Task* task = m_Workers[(index + offset) % count]->deques[level].Steal()) return task;
+        }
+    }
+    return nullptr;
+}
 
-        // Execute the job outside the lock
-        if (task.job) {
-            try {
-                bool success = task.job->GetFunction()(task.data);
-
-                if (success) {
-                    if (task.job->GetSuccessCallback()) {
-                        task.job->GetSuccessCallback()(task.data);
-                    }
-                } else {
-                    if (task.job->GetFailureCallback()) {
-                        task.job->GetFailureCallback()("Job execution returned false");
-                    }
-                }
-            } catch (const std::exception& e) {
-                if (task.job->GetFailureCallback()) {
-                    task.job->GetFailureCallback()(std::string("Job exception: ") + e.what());
-                }
-            }
+void JobSystem::Execute(Task* task) {
+    SOL_PROFILE_ZONE("Job");
+    try {
+        if (!task->cancel.IsCancelled()) task->Run();
+    } catch (const std::exception& e) {
+        Logger::Error("Job exception: ", e.what());
+    } catch (...) {
+        Logger::Error("Job exception: unknown");
+    }
+    delete task;
+}
+
+void JobSystem::WorkerThread(size_t index) {
+    s_CurrentWorker = m_Workers[index].get();
+    SOL_PROFILE_THREAD("Worker " + std::to_string(index));
+    while (true) {
+        // Read before looking, so a submission made meanwhile ends the wait
+        const uint32_t signal = m_Signal.load(std::memory_order_acquire);
+        if (Task* task = FindTask(index)) {
+            Execute(task);
+            // What the job finished may show
+            FrameScheduler::GetInstance().RequestFrame();
+            continue;
         }
+        if (!m_Running.load(std::memory_order_acquire)) break;
+        m_Signal.wait(signal, std::memory_order_acquire);
     }
+    s_CurrentWorker = nullptr;
 }
 
 void JobSystem::ShutdownWorkers() {
-    {
-        std::lock_guard<std::mutex> lock(m_QueueMutex);
-        m_Running = false;
-    }
-    m_QueueCV.notify_all();
+    // Workers finish what is queued, then leave
+    m_Running.store(false, std::memory_order_release);
+    m_Signal.fetch_add(1, std::memory_order_release);
+    m_Signal.notify_all();
 
     for (auto& thread : m_WorkerThreads) {
         if (thread.joinable()) {
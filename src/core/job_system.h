@@ -1,69 +1,66 @@
 #pragma once
 
+#include "cancellation.h"
+#include <atomic>
+#include <cstdint>
+#include <deque>
 #include <functional>
 #include <memory>
 #include <mutex>
-#include <queue>
+#include <optional>
 #include <thread>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <variant>
 #include <vector>
-#include <condition_variable>
-#include <any>
-#include <map>
 
 namespace sol {
 
 // Usage Example:
 //
-// // Create a job function that does work
-// auto job = std::make_shared<sol::Job>([](const sol::JobData& data) {
-//     int task_id = std::any_cast<int>(data.at("task_id"));
-//     std::cout << "Processing task " << task_id << std::endl;
-//     // Do some work...
-//     return true; // true = success, false = failure
-// });
+// // Run a function with its arguments on a worker; both are moved into the
+// // job, which is the only allocation
+// sol::JobSystem::Submit(sol::JobPriority::Background, [](std::string path, int line) {
+//     Process(path, line);
+// }, std::move(path), 42);
 //
-// // Configure success and failure callbacks
-// job->SetSuccessCallback([](const sol::JobData& data) {
-//     std::cout << "Job completed successfully" << std::endl;
-// })
-// .SetFailureCallback([](const std::string& error) {
-//     std::cout << "Job failed: " << error << std::endl;
-// });
+// // Chain on the result; the last step runs on the main thread
+// sol::JobSystem::Async(sol::JobPriority::Interactive, [] { return Search(); })
+//     .ThenOnMain([](std::vector<Match> matches) { Show(std::move(matches)); });
 //
-// // Submit the job with parameters
-// sol::JobData data;
-// data["task_id"] = 42;
-// sol::JobSystem::Submit(job, data);
+// // A job given a token never starts once it is cancelled; one already
+// // running checks the token itself
+// sol::CancellationSource cancel;
+// sol::JobSystem::Submit(sol::JobPriority::Interactive, cancel.Token(), [token = cancel.Token()] {
+//     while (!token.IsCancelled() && Step()) {}
+// });
+// cancel.Cancel();
 //
 // // Jobs run on n-1 worker threads automatically
 // // On application shutdown, call:
 // // sol::JobSystem::Shutdown();
 
-using JobData = std::map<std::string, std::any>;
-
-class Job {
-public:
-    using Function = std::function<bool(const JobData&)>;
-    using SuccessCallback = std::function<void(const JobData&)>;
-    using FailureCallback = std::function<void(const std::string&)>;
-
-    explicit Job(Function function);
-    ~Job() = default;
-
-    Job& SetSuccessCallback(SuccessCallback callback);
-    Job& SetFailureCallback(FailureCallback callback);
-
-    const Function& GetFunction() const { return m_Function; }
-    const SuccessCallback& GetSuccessCallback() const { return m_SuccessCallback; }
-    const FailureCallback& GetFailureCallback() const { return m_FailureCallback; }
-
-private:
-    Function m_Function;
-    SuccessCallback m_SuccessCallback;
-    FailureCallback m_FailureCallback;
+// Workers take interactive jobs before background ones and idle jobs only
+// when nothing else is queued
+enum class JobPriority : uint8_t {
+    Interactive,  // The user is waiting on it: highlighting, filtering, previews
+    Background,   // Indexing, saving, anything that can lag a little
+    Idle,         // Housekeeping
+    Count
 };
 
+template <typename T>
+class JobHandle;
+
+// Each worker keeps a lock-free deque per priority. Jobs submitted by a job
+// go to its worker's deque and idle workers steal from the others; jobs from
+// any other thread go through a locked queue per priority.
 class JobSystem {
+    // Keeps the overloads without a token from taking one as their function
+    template <typename F>
+    static constexpr bool NotToken = !std::is_same_v<std::decay_t<F>, CancellationToken>;
+
 public:
     static JobSystem& GetInstance();
 
@@ -72,33 +69,315 @@ public:
     JobSystem(JobSystem&&) = delete;
     JobSystem& operator=(JobSystem&&) = delete;
 
-    // Static convenience methods
-    static void Submit(std::shared_ptr<Job> job, const JobData& data = {}) {
-        GetInstance().SubmitJob(job, data);
+    // Static convenience methods. Each takes an optional CancellationToken
+    // first; the job is dropped instead of run once it is cancelled.
+    template <typename F, typename... Args> requires NotToken<F>
+    static void Submit(JobPriority priority, F&& function, Args&&... args) {
+        Submit(priority, CancellationToken(), std::forward<F>(function), std::forward<Args>(args)...);
+    }
+    template <typename F, typename... Args>
+    static void Submit(JobPriority priority, CancellationToken cancel, F&& function, Args&&... args) {
+        GetInstance().Push(Bind(std::move(cancel), std::forward<F>(function), std::forward<Args>(args)...), priority);
     }
+    // Like Submit, returning a handle to chain on what the function returns.
+    // Steps chained on it are dropped with it when the token is cancelled.
+    template <typename F, typename... Args> requires NotToken<F>
+    static auto Async(JobPriority priority, F&& function, Args&&... args) {
+        return Async(priority, CancellationToken(), std::forward<F>(function), std::forward<Args>(args)...);
+    }
+    template <typename F, typename... Args>
+    static auto Async(JobPriority priority, CancellationToken cancel, F&& function, Args&&... args)
+        -> JobHandle<std::invoke_result_t<std::decay_t<F>, std::decay_t<Args>...>>;
+    // Runs the function on the main thread, the next time it runs main thread jobs
+    template <typename F> requires NotToken<F>
+    static void DispatchToMain(F&& function) {
+        DispatchToMain(CancellationToken(), std::forward<F>(function));
+    }
+    template <typename F>
+    static void DispatchToMain(CancellationToken cancel, F&& function) {
+        GetInstance().PushMain(Bind(std::move(cancel), std::forward<F>(function)));
+    }
+    // Runs what was dispatched to the main thread so far; called once per frame
+    static void RunMainThreadJobs() { GetInstance().DrainMainThread(); }
+
     static void Shutdown() { GetInstance().ShutdownWorkers(); }
     static uint32_t GetWorkerCount() { return GetInstance().GetWorkerThreadCount(); }
+    // Jobs of the priority waiting for a worker, approximately
+    static size_t GetQueueDepth(JobPriority priority) { return GetInstance().QueuedTasks(priority); }
 
 private:
+    template <typename T>
+    friend class JobHandle;
+
     JobSystem();
     ~JobSystem();
 
-    void SubmitJob(std::shared_ptr<Job> job, const JobData& data);
+    struct Task {
+        virtual ~Task() = default;
+        virtual void Run() = 0;
+
+        CancellationToken cancel;
+    };
+
+    template <typename F, typename... Args>
+    struct BoundTask final : Task {
+        template <typename G, typename... A>
+        explicit BoundTask(G&& fn, A&&... values)
+            : function(std::forward<G>(fn)), args(std::forward<A>(values)...) {}
+        void Run() override { std::apply(std::move(function), std::move(args)); }
+
+        F function;
+        std::tuple<Args...> args;
+    };
+
+    template <typename F, typename... Args>
+    static Task* Bind(CancellationToken cancel, F&& function, Args&&... args) {
+        Task* task = new BoundTask<std::decay_t<F>, std::decay_t<Args>...>(std::forward<F>(function),
+                                                                            std::forward<Args>(args)...);
+        task->cancel = std::move(cancel);
+        return task;
+    }
+
+    struct Worker;
+    static constexpr size_t PRIORITY_COUNT = static_cast<size_t>(JobPriority::Count);
+
+    void Push(Task* task, JobPriority priority);
+    void PushMain(Task* task);
+    void DrainMainThread();
     void ShutdownWorkers();
-    uint32_t GetWorkerThreadCount() const { return m_WorkerThreads.size(); }
+    uint32_t GetWorkerThreadCount() const { return static_cast<uint32_t>(m_WorkerThreads.size()); }
+    size_t QueuedTasks(JobPriority priority) const;
 
-    void WorkerThread();
+    void WorkerThread(size_t index);
+    Task* FindTask(size_t index);
+    static void Execute(Task* task);
 
-    struct JobTask {
-        std::shared_ptr<Job> job;
-        JobData data;
+    // Jobs submitted from outside the workers, oldest first
+    struct Injector {
+        std::mutex mutex;
+        std::deque<Task*> tasks;
+        std::atomic<size_t> size{0};
     };
 
+    std::vector<std::unique_ptr<Worker>> m_Workers;
     std::vector<std::thread> m_WorkerThreads;
-    std::queue<JobTask> m_JobQueue;
-    mutable std::mutex m_QueueMutex;
-    std::condition_variable m_QueueCV;
-    bool m_Running;
+    Injector m_Injected[PRIORITY_COUNT];
+    std::atomic<uint32_t> m_Signal{0};  // Bumped by every submission; idle workers wait on it
+    std::atomic<bool> m_Running{true};
+
+    std::mutex m_MainMutex;
+    std::vector<Task*> m_MainQueue;
+
+    static thread_local Worker* s_CurrentWorker;
+};
+
+// The result of a job, to chain further work on. Each handle's result goes
+// to one continuation, so Then and ThenOnMain are called at most once per
+// handle. A job that throws fails its handle, and everything chained on it
+// fails without running.
+template <typename T>
+class JobHandle {
+public:
+    JobHandle() = default;
+
+    // Runs function(result), or function() for a void job, once this job
+    // has finished; on a worker at the priority, or on the main thread
+    template <typename F>
+    auto Then(JobPriority priority, F&& function) { return Chain(std::forward<F>(function), priority, Target::Worker); }
+    template <typename F>
+    auto ThenOnMain(F&& function) {
+        return Chain(std::forward<F>(function), JobPriority::Interactive, Target::Main);
+    }
+
+private:
+    friend class JobSystem;
+    template <typename U>
+    friend class JobHandle;
+    template <typename U>
+    friend auto WhenAll(std::vector<JobHandle<U>> jobs);
+
+    using Value = std::conditional_t<std::is_void_v<T>, std::monostate, T>;
+
+    enum class Target : uint8_t {
+        Worker,
+        Main,
+        Inline,  // On whichever thread finished the job
+    };
+
+    // Waits on the job for its result, which is empty if the job failed
+    struct Waiter : JobSystem::Task {
+        std::optional<Value> input;
+        JobPriority priority = JobPriority::Interactive;
+        Target target = Target::Worker;
+    };
+
+    struct State {
+        std::mutex mutex;
+        bool done = false;
+        std::optional<Value> value;  // Empty if the job failed
+        std::unique_ptr<Waiter> waiter;
+        CancellationToken cancel;  // Of the job, passed on to the steps chained on it
+
+        template <typename F, typename... A>
+        void Run(F& function, A&&... args) {
+            try {
+                if constexpr (std::is_void_v<T>) {
+                    std::invoke(function, std::forward<A>(args)...);
+                    value.emplace();
+                } else {
+                    value.emplace(std::invoke(function, std::forward<A>(args)...));
+                }
+            } catch (...) {
+                Finish();
+                throw;
+            }
+            Finish();
+        }
+
+        void Finish() {
+            std::unique_ptr<Waiter> next;
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                done = true;
+                if (!waiter) return;
+                next = std::move(waiter);
+                next->input = std::move(value);
+            }
+            Release(std::move(next));
+        }
+
+        void Wait(std::unique_ptr<Waiter> next) {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                if (!done) {
+                    waiter = std::move(next);
+                    return;
+                }
+                next->input = std::move(value);
+            }
+            Release(std::move(next));
+        }
+
+        static void Release(std::unique_ptr<Waiter> next) {
+            Waiter* task = next.release();
+            switch (task->target) {
+                case Target::Worker: JobSystem::GetInstance().Push(task, task->priority); break;
+                case Target::Main:   JobSystem::GetInstance().PushMain(task); break;
+                case Target::Inline: JobSystem::Execute(task); break;
+            }
+        }
+    };
+
+    template <typename F, typename R>
+    struct Step final : Waiter {
+        template <typename G>
+        Step(G&& fn, std::shared_ptr<typename JobHandle<R>::State> next)
+            : function(std::forward<G>(fn)), result(std::move(next)) {}
+
+        void Run() override {
+            if (!this->input) {
+                result->Finish();
+            } else if constexpr (std::is_void_v<T>) {
+                result->Run(function);
+            } else {
+                result->Run(function, std::move(*this->input));
+            }
+        }
+
+        F function;
+        std::shared_ptr<typename JobHandle<R>::State> result;
+    };
+
+    explicit JobHandle(std::shared_ptr<State> state) : m_State(std::move(state)) {}
+
+    template <typename F>
+    auto Chain(F&& function, JobPriority priority, Target target) {
+        using Fn = std::decay_t<F>;
+        using R = typename std::conditional_t<std::is_void_v<T>, std::invoke_result<Fn>, std::invoke_result<Fn, T>>::type;
+        auto result = std::make_shared<typename JobHandle<R>::State>();
+        result->cancel = m_State->cancel;
+        auto step = std::make_unique<Step<Fn, R>>(std::forward<F>(function), result);
+        step->priority = priority;
+        step->target = target;
+        step->cancel = m_State->cancel;
+        m_State->Wait(std::move(step));
+        return JobHandle<R>(std::move(result));
+    }
+
+    std::shared_ptr<State> m_State;
 };
 
+template <typename F, typename... Args>
+auto JobSystem::Async(JobPriority priority, CancellationToken cancel, F&& function, Args&&... args)
+    -> JobHandle<std::invoke_result_t<std::decay_t<F>, std::decay_t<Args>...>> {
+    using Handle = JobHandle<std::invoke_result_t<std::decay_t<F>, std::decay_t<Args>...>>;
+    auto state = std::make_shared<typename Handle::State>();
+    state->cancel = cancel;
+    Submit(priority, std::move(cancel),
+           [state](auto&& fn, auto&&... values) { state->Run(fn, std::forward<decltype(values)>(values)...); },
+           std::forward<F>(function), std::forward<Args>(args)...);
+    return Handle(std::move(state));
+}
+
+// Finishes once all the jobs have: with their results in order, or with
+// nothing for void jobs. Fails if any of them does.
+template <typename T>
+auto WhenAll(std::vector<JobHandle<T>> jobs) {
+    using Result = std::conditional_t<std::is_void_v<T>, void, std::vector<T>>;
+    using Value = typename JobHandle<T>::Value;
+    using Waiter = typename JobHandle<T>::Waiter;
+
+    struct Gather {
+        std::shared_ptr<typename JobHandle<Result>::State> result = std::make_shared<typename JobHandle<Result>::State>();
+        std::vector<std::optional<Value>> values;
+        std::atomic<size_t> remaining{0};
+        std::atomic<bool> failed{false};
+
+        void Finish() {
+            if (failed.load(std::memory_order_relaxed)) {
+                result->Finish();
+                return;
+            }
+            auto collect = [this] {
+                if constexpr (!std::is_void_v<T>) {
+                    std::vector<T> results;
+                    results.reserve(values.size());
+                    for (std::optional<Value>& value : values) results.push_back(std::move(*value));
+                    return results;
+                }
+            };
+            result->Run(collect);
+        }
+    };
+
+    struct Collect final : Waiter {
+        Collect(std::shared_ptr<Gather> all, size_t slot) : gather(std::move(all)), index(slot) {}
+
+        void Run() override {
+            if (this->input) {
+                gather->values[index] = std::move(this->input);
+            } else {
+                gather->failed.store(true, std::memory_order_relaxed);
+            }
+            if (gather->remaining.fetch_sub(1, std::memory_order_acq_rel) == 1) gather->Finish();
+        }
+
+        std::shared_ptr<Gather> gather;
+        size_t index;
+    };
+
+    auto gather = std::make_shared<Gather>();
+    gather->values.resize(jobs.size());
+    gather->remaining.store(jobs.size() + 1, std::memory_order_relaxed);
+    for (size_t i = 0; i < jobs.size(); ++i) {
+        auto collect = std::make_unique<Collect>(gather, i);
+        collect->target = JobHandle<T>::Target::Inline;
+        jobs[i].m_State->Wait(std::move(collect));
+    }
+    auto result = gather->result;
+    // The extra count keeps the last job from finishing while waiters are still being attached
+    if (gather->remaining.fetch_sub(1, std::memory_order_acq_rel) == 1) gather->Finish();
+    return JobHandle<Result>(std::move(result));
+}
+
 } // namespace sol
@@ -1,17 +1,47 @@
 #include "logger.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
 #include <iostream>
-#include <chrono>
-#include <iomanip>
-#include <sstream>
 
 namespace sol {
 
+namespace {
+
+constexpr size_t RING_SIZE = 4096;   // Entries; a power of two
+constexpr size_t MAX_MESSAGE = 480;  // Bytes kept of a message
+constexpr size_t STOP = size_t{1} << (sizeof(size_t) * 8 - 1);
+// The writer outputs at most this much per interval and waits out the rest
+constexpr size_t MAX_BYTES_PER_INTERVAL = 256 * 1024;
+constexpr auto WRITE_INTERVAL = std::chrono::milliseconds(50);
+
+} // namespace
+
+// An entry is free for the claim at position p while sequence == p and
+// ready to write once sequence == p + 1
+struct Logger::Entry {
+    std::atomic<size_t> sequence{0};
+    Level level = Level::Info;
+    Clock::time_point time;
+    size_t length = 0;
+    char text[MAX_MESSAGE];
+};
+
 Logger& Logger::GetInstance() {
     static Logger instance;
     return instance;
 }
 
+Logger::Logger() : m_Ring(std::make_unique<Entry[]>(RING_SIZE)) {
+    for (size_t i = 0; i < RING_SIZE; ++i) m_Ring[i].sequence.store(i, std::memory_order_relaxed);
+    m_Writer = std::thread([this] { RunWriter(); });
+}
+
 Logger::~Logger() {
+    m_Pending.fetch_or(STOP, std::memory_order_release);
+    m_Pending.notify_all();
+    m_Writer.join();
     if (m_FileStream && m_FileStream->is_open()) {
         m_FileStream->close();
     }
@@ -33,7 +63,7 @@ void Logger::SetLogFilePath(const std::string& filePath) {
     }
 }
 
-std::string Logger::LevelToString(Level level) const {
+const char* Logger::LevelToString(Level level) {
     switch (level) {
         case Level::Debug:   return "DEBUG";
         case Level::Info:    return "INFO";
@@ -43,37 +73,125 @@ std::string Logger::LevelToString(Level level) const {
     }
 }
 
-std::string Logger::FormatMessage(Level level, const std::string& message) const {
-    auto now = std::chrono::system_clock::now();
-    auto time = std::chrono::system_clock::to_time_t(now);
-    auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(
-        now.time_since_epoch()) % 1000;
-
-    std::ostringstream oss;
-    oss << "[" << std::put_time(std::localtime(&time), "%Y-%m-%d %H:%M:%S")
-        << "." << std::setfill('0') << std::setw(3) << ms.count() << "] "
-        << "[" << LevelToString(level) << "] "
-        << message;
-
-    return oss.str();
+void Logger::FormatEntry(const Entry& entry, std::string& out) {
+    const std::time_t time = Clock::to_time_t(entry.time);
+    const auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(entry.time.time_since_epoch()).count() % 1000;
+    std::tm local{};
+#ifdef _WIN32
+    localtime_s(&local, &time);
+#else
+    localtime_r(&time, &local);
+#endif
+    char stamp[64];
+    const size_t length = std::strftime(stamp, sizeof(stamp), "%Y-%m-%d %H:%M:%S", &local);
+    const int prefix = std::snprintf(stamp + length, sizeof(stamp) - length, ".%03d] [%s] ", static_cast<int>(ms),
+                                     LevelToString(entry.level));
+    out += '[';
+    out.append(stamp, length + static_cast<size_t>(std::max(prefix, 0)));
+    out.append(entry.text, entry.length);
+    out += '\n';
 }
 
-void Logger::Log(Level level, const std::string& message) {
-    std::lock_guard<std::mutex> lock(m_Mutex);
+// Claims the entry at the head; a full ring drops the message rather than wait
+void Logger::Log(Level level, const LogPiece* pieces, size_t count) {
+    size_t position = m_Head.load(std::memory_order_relaxed);
+    Entry* entry;
+    for (;;) {
+        entry = &m_Ring[position & (RING_SIZE - 1)];
+        const size_t sequence = entry->sequence.load(std::memory_order_acquire);
+        if (sequence == position) {
+            if (m_Head.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) break;
+        } else if (sequence < position) {
+            m_Dropped.fetch_add(1, std::memory_order_relaxed);
+            return;
+        } else {
+            position = m_Head.load(std::memory_order_relaxed);
+        }
+    }
 
-    std::string formattedMessage = FormatMessage(level, message);
+    entry->level = level;
+    entry->time = Clock::now();
+    size_t length = 0;
+    for (size_t i = 0; i < count && length < MAX_MESSAGE; ++i) {
+        const std::string_view text = pieces[i].Text();
+        const size_t take = std::min(text.length(), MAX_MESSAGE - length);
+        std::memcpy(entry->text + length, text.data(), take);
+        length += take;
+    }
+    entry->length = length;
 
-    // Log to terminal
-    if (level == Level::Error || level == Level::Warning) {
-        std::cerr << formattedMessage << std::endl;
-    } else {
-        std::cout << formattedMessage << std::endl;
+    // Counted before it is published, so the writer never drains more than
+    // the count holds and takes it into the STOP bit
+    const size_t pending = m_Pending.fetch_add(1, std::memory_order_release);
+    entry->sequence.store(position + 1, std::memory_order_release);
+    if ((pending & ~STOP) == 0) m_Pending.notify_all();
+}
+
+size_t Logger::Drain(std::string& all, std::string& out, std::string& err) {
+    size_t drained = 0;
+    for (;; ++m_Tail, ++drained) {
+        Entry& entry = m_Ring[m_Tail & (RING_SIZE - 1)];
+        if (entry.sequence.load(std::memory_order_acquire) != m_Tail + 1) break;
+        const size_t start = all.size();
+        FormatEntry(entry, all);
+        (entry.level >= Level::Warning ? err : out).append(all, start);
+        entry.sequence.store(m_Tail + RING_SIZE, std::memory_order_release);
     }
+    return drained;
+}
 
-    // Log to file if enabled
-    if (m_FileStream && m_FileStream->is_open()) {
-        *m_FileStream << formattedMessage << std::endl;
-        m_FileStream->flush();
+void Logger::RunWriter() {
+    std::string all;
+    std::string out;
+    std::string err;
+    auto windowStart = std::chrono::steady_clock::now();
+    size_t windowBytes = 0;
+
+    for (;;) {
+        const size_t pending = m_Pending.load(std::memory_order_acquire);
+        if ((pending & ~STOP) == 0) {
+            if (pending & STOP) break;
+            m_Pending.wait(pending, std::memory_order_acquire);
+            continue;
+        }
+
+        all.clear();
+        out.clear();
+        err.clear();
+        const size_t drained = Drain(all, out, err);
+        if (drained == 0) {
+            // Counted before an earlier claim finished filling its entry
+            std::this_thread::yield();
+            continue;
+        }
+        if (const size_t dropped = m_Dropped.exchange(0, std::memory_order_relaxed)) {
+            const std::string note = "[" + std::to_string(dropped) + " log messages dropped]\n";
+            all += note;
+            err += note;
+        }
+        if (!out.empty()) std::cout.write(out.data(), static_cast<std::streamsize>(out.size())).flush();
+        if (!err.empty()) std::cerr.write(err.data(), static_cast<std::streamsize>(err.size())).flush();
+        {
+            std::lock_guard<std::mutex> lock(m_Mutex);
+            if (m_FileStream && m_FileStream->is_open()) {
+                m_FileStream->write(all.data(), static_cast<std::streamsize>(all.size()));
+                m_FileStream->flush();
+            }
+        }
+        m_Pending.fetch_sub(drained, std::memory_order_acq_rel);
+
+        // Past the budget the writer sits out the interval while the ring
+        // absorbs, and past its size drops, what keeps coming
+        windowBytes += all.size();
+        const auto now = std::chrono::steady_clock::now();
+        if (now - windowStart >= WRITE_INTERVAL) {
+            windowStart = now;
+            windowBytes = 0;
+        } else if (windowBytes >= MAX_BYTES_PER_INTERVAL && !(m_Pending.load(std::memory_order_relaxed) & STOP)) {
+            std::this_thread::sleep_until(windowStart + WRITE_INTERVAL);
+            windowStart = std::chrono::steady_clock::now();
+            windowBytes = 0;
+        }
     }
 }
 
@@ -1,12 +1,74 @@
 #pragma once
 
-#include <string>
+#include <atomic>
+#include <charconv>
+#include <chrono>
+#include <cstddef>
+#include <filesystem>
+#include <fstream>
 #include <memory>
 #include <mutex>
-#include <fstream>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <type_traits>
+
+// Lowest level compiled in: 0 Debug, 1 Info, 2 Warning, 3 Error
+#ifndef SOL_LOG_LEVEL
+#ifdef NDEBUG
+#define SOL_LOG_LEVEL 1
+#else
+#define SOL_LOG_LEVEL 0
+#endif
+#endif
 
 namespace sol {
 
+// One argument of a log call, viewed or formatted in place so the message
+// is put together only once the level is known to be logged
+class LogPiece {
+public:
+    LogPiece(std::string_view text) : m_Text(text) {}
+    LogPiece(const char* text) : m_Text(text) {}
+    LogPiece(const std::string& text) : m_Text(text) {}
+    LogPiece(const std::filesystem::path& path) {
+        if constexpr (std::is_same_v<std::filesystem::path::value_type, char>) {
+            m_Text = path.native();
+        } else {
+            m_Owned = path.string();
+            m_Text = m_Owned;
+        }
+    }
+    LogPiece(char c) : m_Buffer{c}, m_Text(m_Buffer, 1) {}
+    LogPiece(bool value) : m_Text(value ? "true" : "false") {}
+    template <typename T> requires std::is_arithmetic_v<T>
+    LogPiece(T value) {
+        auto result = std::to_chars(m_Buffer, m_Buffer + sizeof(m_Buffer), value);
+        m_Text = std::string_view(m_Buffer, result.ptr - m_Buffer);
+    }
+
+    LogPiece(const LogPiece&) = delete;
+    LogPiece& operator=(const LogPiece&) = delete;
+
+    std::string_view Text() const { return m_Text; }
+
+private:
+    char m_Buffer[32] = {};
+    std::string_view m_Text;
+    std::string m_Owned;
+};
+
+// Messages go into a fixed ring that threads claim entries of without
+// locking, and a background thread formats them, timestamps included, and
+// writes them out in batches. A caller never waits for output: when the
+// ring is full the message is dropped and counted, and the writer caps its
+// output rate, so a burst of logging cannot stall the thread doing it.
+// Calls below SOL_LOG_LEVEL compile to nothing; passing pieces instead of a
+// concatenated string leaves nothing to evaluate either.
+//
+// Usage Example:
+//
+// sol::Logger::Info("Loaded ", path, " in ", ms, " ms");
 class Logger {
 public:
     enum class Level {
@@ -16,6 +78,8 @@ public:
         Error
     };
 
+    static constexpr Level MIN_LEVEL = static_cast<Level>(SOL_LOG_LEVEL);
+
     static Logger& GetInstance();
 
     Logger(const Logger&) = delete;
@@ -25,24 +89,52 @@ public:
 
     // Static convenience methods
     static void SetLogFile(const std::string& filePath) { GetInstance().SetLogFilePath(filePath); }
-    static void Debug(const std::string& message) { GetInstance().Log(Level::Debug, message); }
-    static void Info(const std::string& message) { GetInstance().Log(Level::Info, message); }
-    static void Warning(const std::string& message) { GetInstance().Log(Level::Warning, message); }
-    static void Error(const std::string& message) { GetInstance().Log(Level::Error, message); }
+    template <typename... Args>
+    static void Debug(const Args&... args) { Write<Level::Debug>(args...); }
+    template <typename... Args>
+    static void Info(const Args&... args) { Write<Level::Info>(args...); }
+    template <typename... Args>
+    static void Warning(const Args&... args) { Write<Level::Warning>(args...); }
+    template <typename... Args>
+    static void Error(const Args&... args) { Write<Level::Error>(args...); }
 
 private:
-    Logger() = default;
+    Logger();
     ~Logger();
 
+    template <Level L, typename First, typename... Rest>
+    static void Write(const First& first, const Rest&... rest) {
+        if constexpr (L >= MIN_LEVEL) {
+            const LogPiece pieces[] = {LogPiece(first), LogPiece(rest)...};
+            GetInstance().Log(L, pieces, 1 + sizeof...(Rest));
+        }
+    }
+
+    struct Entry;
+    using Clock = std::chrono::system_clock;
+
     void SetLogFilePath(const std::string& filePath);
-    void Log(Level level, const std::string& message);
+    void Log(Level level, const LogPiece* pieces, size_t count);
+    void RunWriter();
+    // Formats the entries logged so far into all, and each also into the
+    // terminal stream of its level; returns how many
+    size_t Drain(std::string& all, std::string& out, std::string& err);
+
+    static const char* LevelToString(Level level);
+    static void FormatEntry(const Entry& entry, std::string& out);
 
-    std::string LevelToString(Level level) const;
-    std::string FormatMessage(Level level, const std::string& message) const;
+    std::unique_ptr<Entry[]> m_Ring;
+    std::atomic<size_t> m_Head{0};  // Next entry to claim
+    size_t m_Tail = 0;              // Next entry to write, writer thread only
+    // Entries logged but not written, with STOP set once the writer should
+    // finish; the writer waits on it
+    std::atomic<size_t> m_Pending{0};
+    std::atomic<size_t> m_Dropped{0};
+    std::thread m_Writer;
 
     std::string m_LogFilePath;
     std::unique_ptr<std::ofstream> m_FileStream;
-    mutable std::mutex m_Mutex;
+    mutable std::mutex m_Mutex;  // Guards the file
 };
 
 } // namespace sol
@@ -1,5 +1,9 @@
 #include "lsp_client.h"
+#include "lsp_framer.h"
+#include "core/frame_scheduler.h"
 #include "core/logger.h"
+#include "core/profiler.h"
+#include <algorithm>
 #include <iostream>
 #include <sstream>
 #include <unistd.h>
@@ -31,286 +35,607 @@ bool LSPClient::Initialize(const std::string& rootPath) {
 
     m_Running = true;
     m_ReadThread = std::thread(&LSPClient::ReadLoop, this);
+    m_WriteThread = std::thread(&LSPClient::WriteLoop, this);
 
-    JsonObject params;
-    params["processId"] = static_cast<int>(getpid());
-    params["rootUri"] = FilePathToURI(rootPath);
-    params["capabilities"] = JsonObject{}; // Simplified capabilities
-
-    SendRequest("initialize", params, [this](const JsonValue& result) {
-        SendNotification("initialized", {});
+    const std::string rootUri = FilePathToURI(rootPath);
+    SendRequest("initialize", [rootUri](JsonWriter& writer) {
+        writer.BeginObject();
+        writer.Key("processId").Int(getpid());
+        writer.Key("rootUri").String(rootUri);
+        writer.Key("workspaceFolders").BeginArray();
+        WriteWorkspaceFolder(writer, rootUri);
+        writer.EndArray();
+        writer.Key("capabilities").BeginObject();
+        writer.Key("workspace").BeginObject().Key("workspaceFolders").Bool(true).EndObject();
+        writer.Key("textDocument").BeginObject();
+        writer.Key("synchronization").BeginObject().Key("dynamicRegistration").Bool(false).EndObject();
+        writer.Key("semanticTokens").BeginObject();
+        writer.Key("dynamicRegistration").Bool(false);
+        writer.Key("requests").BeginObject();
+        writer.Key("range").Bool(true);
+        writer.Key("full").BeginObject().Key("delta").Bool(true).EndObject();
+        writer.EndObject();
+        writer.Key("tokenTypes").BeginArray();
+        for (const char* type : SEMANTIC_TOKEN_TYPES) writer.String(type);
+        writer.EndArray();
+        writer.Key("tokenModifiers").BeginArray().EndArray();
+        writer.Key("formats").BeginArray().String("relative").EndArray();
+        writer.Key("overlappingTokenSupport").Bool(false);
+        writer.Key("multilineTokenSupport").Bool(false);
+        writer.EndObject();
+        writer.EndObject();
+        writer.EndObject();
+        writer.EndObject();
+    }, [this](std::string_view result) {
+        // A number or an options object; servers that leave it out want no changes
+        JsonDocument document;
+        document.Parse(result);
+        const JsonNode& sync = document.Root()["capabilities"]["textDocumentSync"];
+        const int kind = sync.IsObject() ? sync["change"].AsInt() : sync.AsInt();
+        m_SyncKind = kind == 2 ? TextDocumentSyncKind::Incremental
+                   : kind == 1 ? TextDocumentSyncKind::Full : TextDocumentSyncKind::None;
+        
+        const JsonNode& semantic = document.Root()["capabilities"]["semanticTokensProvider"];
+        if (semantic.IsObject()) {
+            LSPSemanticTokensProvider provider;
+            for (const JsonNode& type : semantic["legend"]["tokenTypes"].Items()) {
+                provider.tokenTypes.emplace_back(type.AsString());
+            }
+            // Each is a boolean or an options object
+            const JsonNode& full = semantic["full"];
+            provider.full = full.IsObject() || full.AsBool();
+            provider.delta = full["delta"].AsBool();
+            provider.range = semantic["range"].IsObject() || semantic["range"].AsBool();
+            std::lock_guard<std::mutex> lock(m_Mutex);
+            m_SemanticTokens = std::move(provider);
+        }
+        
+        // Folder changes are only announced to servers that asked for them
+        const JsonNode& folders = document.Root()["capabilities"]["workspace"]["workspaceFolders"];
+        const JsonNode& notifications = folders["changeNotifications"];
+        m_WorkspaceFolders = folders["supported"].AsBool() && (notifications.AsBool() || notifications.IsString());
+        m_Initialized = true;
+        SendNotification("initialized", nullptr);
     });
 
     return true;
 }
 
+void LSPClient::AddWorkspaceFolder(const std::string& rootPath) {
+    SendNotification("workspace/didChangeWorkspaceFolders", [uri = FilePathToURI(rootPath)](JsonWriter& writer) {
+        writer.BeginObject();
+        writer.Key("event").BeginObject();
+        writer.Key("added").BeginArray();
+        WriteWorkspaceFolder(writer, uri);
+        writer.EndArray();
+        writer.Key("removed").BeginArray().EndArray();
+        writer.EndObject();
+        writer.EndObject();
+    });
+}
+
+void LSPClient::WriteWorkspaceFolder(JsonWriter& writer, const std::string& uri) {
+    const size_t slash = uri.find_last_of('/');
+    writer.BeginObject();
+    writer.Key("uri").String(uri);
+    writer.Key("name").String(slash == std::string::npos ? uri : uri.substr(slash + 1));
+    writer.EndObject();
+}
+
 void LSPClient::Shutdown() {
     if (m_Running) {
-        m_Running = false;  // Signal read thread to stop first
-        
         // Only send shutdown if process still running
-        if (m_Process && m_Process->IsRunning()) {
-            SendRequest("shutdown", {}, [](const JsonValue&) {});
-            SendNotification("exit", {});
-            
-            // Give it a moment to exit gracefully
-            std::this_thread::sleep_for(std::chrono::milliseconds(100));
-            m_Process->Stop();
+        const bool running = m_Process && m_Process->IsRunning();
+        if (running) {
+            SendRequest("shutdown", nullptr);
+            SendNotification("exit", nullptr);
         }
         
-        // Wait for read thread to finish
+        // The writer sends everything queued before it stops
+        {
+            std::lock_guard<std::mutex> lock(m_OutgoingMutex);
+            m_StopWriting = true;
+        }
+        m_OutgoingReady.notify_one();
+        if (m_WriteThread.joinable()) {
+            m_WriteThread.join();
+        }
+        m_Running = false;  // Signal read thread to stop
+        m_Process->Interrupt();
+        
+        // Wait for read thread to finish before its pipe is closed
         if (m_ReadThread.joinable()) {
             m_ReadThread.join();
         }
+        
+        {
+            std::lock_guard<std::mutex> lock(m_Mutex);
+            m_PendingRequests.clear();
+            m_LatestRequests.clear();
+        }
+        
+        if (running) {
+            // Give it a moment to exit gracefully
+            std::this_thread::sleep_for(std::chrono::milliseconds(100));
+            m_Process->Stop();
+        }
     }
 }
 
-void LSPClient::SendRequest(const std::string& method, const JsonObject& params, std::function<void(const JsonValue&)> callback) {
+void LSPClient::SendRequest(const std::string& method, ParamsWriter params, ResponseCallback callback,
+                            std::string supersedeKey, CancellationToken cancel) {
     if (!m_Running || !m_Process || !m_Process->IsRunning()) {
         return;
     }
     
-    std::lock_guard<std::mutex> lock(m_Mutex);
-    int id = m_NextRequestId++;
+    Outgoing item;
+    item.method = method;
+    item.params = std::move(params);
+    std::optional<int> superseded;
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        int id = m_NextRequestId++;
+        m_PendingRequests[id] = {method, std::move(callback), std::chrono::steady_clock::now(), std::move(cancel),
+                                 supersedeKey};
+        item.id = id;
+        
+        if (!supersedeKey.empty()) {
+            auto [latest, inserted] = m_LatestRequests.try_emplace(std::move(supersedeKey), id);
+            if (!inserted) {
+                // Only one still waiting for its answer needs cancelling
+                if (m_PendingRequests.erase(latest->second)) superseded = latest->second;
+                latest->second = id;
+            }
+        }
+    }
     
-    if (callback) {
-        m_PendingRequests[id] = callback;
+    if (superseded) CancelRequest(*superseded);
+    // Queued behind any gathered changes, so the server answers about the current text
+    Enqueue(std::move(item));
+}
+
+void LSPClient::WithdrawCancelledRequests() {
+    std::vector<int> cancelled;
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        for (auto it = m_PendingRequests.begin(); it != m_PendingRequests.end();) {
+            if (it->second.cancel.IsCancelled()) {
+                cancelled.push_back(it->first);
+                ForgetLatest(it->first, it->second.supersedeKey);
+                it = m_PendingRequests.erase(it);
+            } else {
+                ++it;
+            }
+        }
     }
+    for (int id : cancelled) CancelRequest(id);
+}
 
-    JsonObject msg;
-    msg["jsonrpc"] = "2.0";
-    msg["id"] = id;
-    msg["method"] = method;
-    msg["params"] = params;
+void LSPClient::ForgetLatest(int id, const std::string& supersedeKey) {
+    if (supersedeKey.empty()) return;
+    auto latest = m_LatestRequests.find(supersedeKey);
+    if (latest != m_LatestRequests.end() && latest->second == id) m_LatestRequests.erase(latest);
+}
 
-    std::string jsonStr = Json::Serialize(msg);
-    std::string packet = "Content-Length: " + std::to_string(jsonStr.length()) + "\r\n\r\n" + jsonStr;
+void LSPClient::CancelRequest(int id) {
+    {
+        std::lock_guard<std::mutex> lock(m_OutgoingMutex);
+        auto it = std::find_if(m_Outgoing.begin(), m_Outgoing.end(), [id](const Outgoing& item) { return item.id == id; });
+        if (it != m_Outgoing.end()) {
+            m_Outgoing.erase(it);
+            return;
+        }
+    }
     
-    m_Process->Write(packet);
+    SendNotification("$/cancelRequest", [id](JsonWriter& writer) {
+        writer.BeginObject().Key("id").Int(id).EndObject();
+    });
 }
 
-void LSPClient::SendNotification(const std::string& method, const JsonObject& params) {
+void LSPClient::SendNotification(const std::string& method, ParamsWriter params) {
     if (!m_Running || !m_Process || !m_Process->IsRunning()) {
         return;
     }
     
-    JsonObject msg;
-    msg["jsonrpc"] = "2.0";
-    msg["method"] = method;
-    msg["params"] = params;
+    Outgoing item;
+    item.method = method;
+    item.params = std::move(params);
+    Enqueue(std::move(item));
+}
 
-    std::string jsonStr = Json::Serialize(msg);
-    std::string packet = "Content-Length: " + std::to_string(jsonStr.length()) + "\r\n\r\n" + jsonStr;
+void LSPClient::Enqueue(Outgoing item) {
+    {
+        std::lock_guard<std::mutex> lock(m_OutgoingMutex);
+        m_Outgoing.push_back(std::move(item));
+    }
+    m_OutgoingReady.notify_one();
+}
+
+void LSPClient::WriteLoop() {
+    SOL_PROFILE_THREAD("LSP write");
+    std::unique_lock<std::mutex> lock(m_OutgoingMutex);
+    while (true) {
+        m_OutgoingReady.wait(lock, [this] { return m_StopWriting || !m_Outgoing.empty(); });
+        if (m_Outgoing.empty()) return;
+        
+        // Gathered changes wait out their window for more edits unless something follows them
+        const Outgoing& front = m_Outgoing.front();
+        if (!m_StopWriting && m_Outgoing.size() == 1 && !front.changedFile.empty() &&
+            std::chrono::steady_clock::now() < front.due) {
+            const auto due = front.due;
+            m_OutgoingReady.wait_until(lock, due);
+            continue;
+        }
+        
+        Outgoing item = std::move(m_Outgoing.front());
+        m_Outgoing.pop_front();
+        lock.unlock();
+        Write(item);
+        lock.lock();
+    }
+}
+
+void LSPClient::Write(Outgoing& item) {
+    if (!m_Process->IsRunning()) return;
+    
+    m_Writer.Clear();
+    m_Writer.BeginObject();
+    m_Writer.Key("jsonrpc").String("2.0");
+    if (item.id) m_Writer.Key("id").Int(*item.id);
+    m_Writer.Key("method").String(item.changedFile.empty() ? item.method : "textDocument/didChange");
+    m_Writer.Key("params");
+    if (!item.changedFile.empty()) {
+        WriteChanges(item);
+    } else if (item.params) {
+        item.params(m_Writer);
+    } else {
+        m_Writer.BeginObject().EndObject();
+    }
+    m_Writer.EndObject();
     
-    m_Process->Write(packet);
+    const std::string& body = m_Writer.Str();
+    m_Packet.assign("Content-Length: ");
+    m_Packet += std::to_string(body.size());
+    m_Packet += "\r\n\r\n";
+    m_Packet += body;
+    m_Process->Write(m_Packet);
 }
 
-void LSPClient::ReadLoop() {
-    std::vector<char> buffer(4096);
-    std::vector<char> errBuffer(4096);
-    std::string accumulator;
+void LSPClient::WriteChanges(Outgoing& item) {
+    m_Writer.BeginObject();
+    m_Writer.Key("textDocument").BeginObject();
+    m_Writer.Key("uri").String(FilePathToURI(item.changedFile));
+    m_Writer.Key("version").Int(item.version);
+    m_Writer.EndObject();
     
-    while (m_Running) {
-        // Check if process is still alive
-        if (!m_Process || !m_Process->IsRunning()) {
-            break;
+    m_Writer.Key("contentChanges").BeginArray();
+    if (item.fullText) {
+        m_Writer.BeginObject().Key("text").String(*item.fullText).EndObject();
+    } else {
+        for (const LSPTextChange& change : item.changes) {
+            m_Writer.BeginObject().Key("range");
+            change.range.Write(m_Writer);
+            m_Writer.Key("text").String(change.text).EndObject();
         }
-        
-        // Drain stderr to prevent blocking, but don't log it
-        m_Process->ReadErr(errBuffer.data(), errBuffer.size());
+    }
+    m_Writer.EndArray();
+    m_Writer.EndObject();
+}
 
-        size_t bytesRead = m_Process->Read(buffer.data(), buffer.size());
-        if (bytesRead > 0) {
-            accumulator.append(buffer.data(), bytesRead);
-            
-            while (true) {
-                // Find Content-Length
-                size_t headerEnd = accumulator.find("\r\n\r\n");
-                if (headerEnd == std::string::npos) break;
-                
-                size_t contentLengthPos = accumulator.find("Content-Length: ");
-                if (contentLengthPos == std::string::npos || contentLengthPos > headerEnd) {
-                    // Invalid header? discard
-                    accumulator.erase(0, headerEnd + 4);
-                    continue;
-                }
-                
-                size_t lenStart = contentLengthPos + 16;
-                size_t lenEnd = accumulator.find("\r\n", lenStart);
-                if (lenEnd == std::string::npos) break;
-                
-                int contentLength = 0;
-                try {
-                    contentLength = std::stoi(accumulator.substr(lenStart, lenEnd - lenStart));
-                } catch (...) {
-                    // Invalid content-length, discard header
-                    accumulator.erase(0, headerEnd + 4);
-                    continue;
-                }
-                
-                if (accumulator.length() >= headerEnd + 4 + contentLength) {
-                    std::string payload = accumulator.substr(headerEnd + 4, contentLength);
-                    accumulator.erase(0, headerEnd + 4 + contentLength);
-                    
-                    try {
-                        JsonValue json = Json::Parse(payload);
-                        HandleMessage(json);
-                    } catch (...) {
-                        Logger::Error("Failed to parse JSON message from LSP");
-                    }
-                } else {
-                    break; // Wait for more data
-                }
-            }
+void LSPClient::ReadLoop() {
+    SOL_PROFILE_THREAD("LSP read");
+    LSPFramer framer;
+    while (m_Running) {
+        const std::span<char> space = framer.Prepare(READ_CHUNK);
+        const size_t bytesRead = m_Process->Read(space.data(), space.size());
+        if (bytesRead == 0) break;  // Server closed its output or Shutdown interrupted the read
+        framer.Commit(bytesRead);
+        
+        std::string_view body;
+        while (framer.Next(body)) {
+            HandleMessage(body);
         }
-        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        FrameScheduler::GetInstance().RequestFrame();
     }
+    // So the manager sees the server gone
+    FrameScheduler::GetInstance().RequestFrame();
 }
 
-void LSPClient::HandleMessage(const JsonValue& json) {
-    if (json.type != JsonType::Object) return;
+// Only the envelope is read here; the result or params are handed on as raw
+// text for their handler to pull what it needs from
+void LSPClient::HandleMessage(std::string_view payload) {
+    SOL_PROFILE_ZONE("LSPClient::HandleMessage");
+    JsonReader reader(payload);
+    std::optional<int> id;
+    std::string method;
+    std::string_view result;
+    std::string_view params;
+    bool error = false;
+    const bool parsed = reader.Object([&](std::string_view key) {
+        if (key == "id") {
+            if (reader.Peek() == JsonType::Number) id = reader.Int();
+        } else if (key == "method") {
+            method = reader.String();
+        } else if (key == "result") {
+            result = reader.Skip();
+        } else if (key == "params") {
+            params = reader.Skip();
+        } else if (key == "error") {
+            error = true;
+        }
+    });
+    if (!parsed) {
+        Logger::Error("Failed to parse JSON message from LSP");
+        return;
+    }
     
-    try {
-        // Response
-        if (json.Has("id") && json.Has("result")) {
-            int id = json["id"].ToInt();
+    // Response
+    if (id && method.empty() && (!result.empty() || error)) {
+        // Superseded requests are gone from the map, so their results are never parsed
+        PendingRequest request;
+        bool slow = false;
+        {
             std::lock_guard<std::mutex> lock(m_Mutex);
-            if (m_PendingRequests.count(id)) {
-                m_PendingRequests[id](json["result"]);
-                m_PendingRequests.erase(id);
-            }
-        }
-        // Notification or Request from Server
-        else if (json.Has("method")) {
-            std::string method = json["method"].ToString();
+            auto it = m_PendingRequests.find(*id);
+            if (it == m_PendingRequests.end()) return;
+            request = std::move(it->second);
+            m_PendingRequests.erase(it);
+            ForgetLatest(*id, request.supersedeKey);
             
-            if (method == "textDocument/publishDiagnostics") {
-                if (m_DiagnosticsCallback && json.Has("params")) {
-                    auto params = json["params"];
-                    if (!params.Has("uri") || !params.Has("diagnostics")) return;
-                    
-                    std::string uri = params["uri"].ToString();
-                    auto diagnosticsJson = params["diagnostics"].AsArray();
-                    
-                    std::vector<LSPDiagnostic> diagnostics;
-                    for (const auto& item : diagnosticsJson) {
-                        LSPDiagnostic d;
-                        if (item.Has("range")) {
-                            d.range = LSPRange::FromJson(item["range"]);
-                        }
-                        d.message = item.Has("message") ? item["message"].ToString() : "";
-                        d.severity = item.Has("severity") ? item["severity"].ToInt() : 1;
-                        diagnostics.push_back(d);
-                    }
-                    
-                    m_DiagnosticsCallback(uri, diagnostics);
-                }
-            }
+            const auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(
+                std::chrono::steady_clock::now() - request.sent);
+            RequestStats& stats = m_RequestStats[request.method];
+            slow = elapsed > SLOW_RESPONSE && stats.max <= SLOW_RESPONSE;
+            stats.count++;
+            stats.total += elapsed;
+            stats.max = std::max(stats.max, elapsed);
+            stats.last = elapsed;
         }
-    } catch (const std::exception& e) {
-        Logger::Error(std::string("Error handling LSP message: ") + e.what());
+        if (slow) {
+            Logger::Warning("LSP server took over a second to answer ", request.method);
+        }
+        // Cancelled after the last withdrawal; the answer was already on its way
+        if (request.callback && !request.cancel.IsCancelled()) request.callback(error ? std::string_view("null") : result);
+    }
+    // Notification or Request from Server
+    else if (method == "textDocument/publishDiagnostics") {
+        HandleDiagnostics(params);
     }
 }
 
-void LSPClient::DidOpen(const std::string& filePath, const std::string& content, const std::string& languageId) {
-    JsonObject params;
-    JsonObject textDocument;
-    textDocument["uri"] = FilePathToURI(filePath);
-    textDocument["languageId"] = languageId;
+void LSPClient::HandleDiagnostics(std::string_view params) {
+    if (!m_DiagnosticsCallback || params.empty()) return;
     
+    JsonReader reader(params);
+    std::string uri;
+    std::vector<LSPDiagnostic> diagnostics;
+    bool hasDiagnostics = false;
+    reader.Object([&](std::string_view key) {
+        if (key == "uri") {
+            uri = reader.String();
+        } else if (key == "diagnostics") {
+            hasDiagnostics = reader.Array([&] {
+                LSPDiagnostic d{};
+                d.severity = 1;
+                reader.Object([&](std::string_view field) {
+                    if (field == "range") d.range = LSPRange::Read(reader);
+                    else if (field == "message") d.message = reader.String();
+                    else if (field == "severity") d.severity = reader.Int();
+                });
+                diagnostics.push_back(std::move(d));
+            });
+        }
+    });
+    if (reader.Failed() || uri.empty() || !hasDiagnostics) return;
+    
+    m_DiagnosticsCallback(uri, diagnostics);
+}
+
+void LSPClient::DidOpen(const std::string& filePath, std::string content, const std::string& languageId) {
     int version = 1;
     {
         std::lock_guard<std::mutex> lock(m_Mutex);
         m_FileVersions[filePath] = version;
     }
     
-    textDocument["version"] = version;
-    textDocument["text"] = content;
-    params["textDocument"] = textDocument;
-    
-    SendNotification("textDocument/didOpen", params);
+    SendNotification("textDocument/didOpen", [uri = FilePathToURI(filePath), languageId, version,
+                                              content = std::move(content)](JsonWriter& writer) {
+        writer.BeginObject().Key("textDocument").BeginObject();
+        writer.Key("uri").String(uri);
+        writer.Key("languageId").String(languageId);
+        writer.Key("version").Int(version);
+        writer.Key("text").String(content);
+        writer.EndObject().EndObject();
+    });
 }
 
-void LSPClient::DidChange(const std::string& filePath, const std::string& content) {
-    JsonObject params;
-    JsonObject textDocument;
-    textDocument["uri"] = FilePathToURI(filePath);
+void LSPClient::DidChange(const std::string& filePath, const std::vector<LSPTextChange>& changes,
+                          const std::function<std::string()>& fullText) {
+    const TextDocumentSyncKind kind = m_SyncKind;
+    if (kind == TextDocumentSyncKind::None || !IsRunning()) return;
     
     int version = 0;
     {
         std::lock_guard<std::mutex> lock(m_Mutex);
         version = ++m_FileVersions[filePath];
     }
+    const bool full = kind == TextDocumentSyncKind::Full;
+    std::string text = full ? fullText() : std::string();
     
-    textDocument["version"] = version; 
-    params["textDocument"] = textDocument;
-    
-    JsonArray contentChanges;
-    JsonObject change;
-    change["text"] = content; // Full sync for now
-    contentChanges.push_back(change);
-    params["contentChanges"] = contentChanges;
-    
-    SendNotification("textDocument/didChange", params);
+    {
+        std::lock_guard<std::mutex> lock(m_OutgoingMutex);
+        // Anything still queued is unsent, so the latest change can join it
+        if (m_Outgoing.empty() || m_Outgoing.back().changedFile != filePath ||
+            m_Outgoing.back().fullText.has_value() != full) {
+            Outgoing item;
+            item.changedFile = filePath;
+            item.due = std::chrono::steady_clock::now() + CHANGE_MERGE_WINDOW;
+            m_Outgoing.push_back(std::move(item));
+        }
+        Outgoing& item = m_Outgoing.back();
+        item.version = version;
+        if (full) {
+            item.fullText = std::move(text);
+        } else {
+            item.changes.insert(item.changes.end(), changes.begin(), changes.end());
+        }
+    }
+    m_OutgoingReady.notify_one();
 }
 
 bool LSPClient::IsRunning() const {
     return m_Running && m_Process && m_Process->IsRunning();
 }
 
+std::unordered_map<std::string, LSPClient::RequestStats> LSPClient::GetRequestStats() const {
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    return m_RequestStats;
+}
+
 void LSPClient::DidClose(const std::string& filePath) {
-    JsonObject params;
-    JsonObject textDocument;
-    textDocument["uri"] = FilePathToURI(filePath);
-    params["textDocument"] = textDocument;
-    
     {
         std::lock_guard<std::mutex> lock(m_Mutex);
         m_FileVersions.erase(filePath);
+        // Requests still pending for the file are answered as usual; later
+        // ones no longer supersede them
+        std::erase_if(m_LatestRequests, [&filePath](const auto& latest) {
+            const std::string& key = latest.first;
+            return key.size() > filePath.size() && key.ends_with(filePath) &&
+                   key[key.size() - filePath.size() - 1] == ' ';
+        });
     }
     
-    SendNotification("textDocument/didClose", params);
+    SendNotification("textDocument/didClose", [uri = FilePathToURI(filePath)](JsonWriter& writer) {
+        writer.BeginObject().Key("textDocument").BeginObject().Key("uri").String(uri).EndObject().EndObject();
+    });
 }
 
-void LSPClient::RequestCompletion(const std::string& filePath, int line, int character, CompletionCallback callback) {
-    JsonObject params;
-    JsonObject textDocument;
-    textDocument["uri"] = FilePathToURI(filePath);
-    params["textDocument"] = textDocument;
-    
-    LSPPosition pos{line, character};
-    params["position"] = pos.ToJson();
-    
-    SendRequest("textDocument/completion", params, [callback](const JsonValue& result) {
+void LSPClient::RequestCompletion(const std::string& filePath, int line, int character, CompletionCallback callback,
+                                  CancellationToken cancel) {
+    const LSPPosition pos{line, character};
+    SendRequest("textDocument/completion", [uri = FilePathToURI(filePath), pos](JsonWriter& writer) {
+        writer.BeginObject();
+        writer.Key("textDocument").BeginObject().Key("uri").String(uri).EndObject();
+        writer.Key("position");
+        pos.Write(writer);
+        writer.EndObject();
+    }, [callback](std::string_view result) {
+        // Either a list of items or a CompletionList holding one; only the
+        // fields the popup shows are read
         std::vector<LSPCompletionItem> items;
-        
-        try {
-            JsonArray itemsJson;
-            if (result.type == JsonType::Array) {
-                itemsJson = result.AsArray();
-            } else if (result.type == JsonType::Object && result.Has("items")) {
-                itemsJson = result["items"].AsArray();
-            }
-            
-            for (const auto& item : itemsJson) {
-                if (!item.Has("label")) continue;  // Skip invalid items
-                
-                LSPCompletionItem completion;
-                completion.label = item["label"].ToString();
-                completion.kind = item.Has("kind") ? item["kind"].ToInt() : 1;
-                if (item.Has("detail")) completion.detail = item["detail"].ToString();
-                if (item.Has("documentation")) completion.documentation = item["documentation"].ToString();
-                if (item.Has("insertText")) completion.insertText = item["insertText"].ToString();
-                else completion.insertText = completion.label;
-                
-                items.push_back(completion);
-            }
-        } catch (...) {
-            // Silently ignore malformed completion responses
+        JsonReader reader(result);
+        auto readItem = [&] {
+            LSPCompletionItem completion{};
+            completion.kind = 1;
+            bool hasLabel = false;
+            bool hasInsertText = false;
+            reader.Object([&](std::string_view key) {
+                if (key == "label") {
+                    completion.label = reader.String();
+                    hasLabel = true;
+                } else if (key == "kind") {
+                    completion.kind = reader.Int();
+                } else if (key == "detail") {
+                    completion.detail = reader.String();
+                } else if (key == "documentation") {
+                    // A plain string or MarkupContent
+                    if (reader.Peek() == JsonType::String) {
+                        completion.documentation = reader.String();
+                    } else {
+                        reader.Object([&](std::string_view field) {
+                            if (field == "value") completion.documentation = reader.String();
+                        });
+                    }
+                } else if (key == "insertText") {
+                    completion.insertText = reader.String();
+                    hasInsertText = true;
+                }
+            });
+            if (!hasLabel) return;  // Skip invalid items
+            if (!hasInsertText) completion.insertText = completion.label;
+            items.push_back(std::move(completion));
+        };
+        if (reader.Peek() == JsonType::Array) {
+            reader.Array(readItem);
+        } else {
+            reader.Object([&](std::string_view key) {
+                if (key == "items") reader.Array(readItem);
+            });
         }
         
         if (callback) callback(items);
+    }, "textDocument/completion " + filePath, std::move(cancel));
+}
+
+namespace {
+
+// SemanticTokens, SemanticTokensDelta or null. The data arrays are read
+// straight into integers, never into a tree; they run to hundreds of
+// thousands of numbers in large files.
+std::optional<LSPSemanticTokens> ReadSemanticTokens(std::string_view result) {
+    JsonReader reader(result);
+    if (reader.Peek() != JsonType::Object) return std::nullopt;
+    
+    LSPSemanticTokens tokens;
+    auto readData = [&reader](std::vector<uint32_t>& data) {
+        reader.Array([&] { data.push_back(static_cast<uint32_t>(reader.Number())); });
+    };
+    bool hasData = false;
+    const bool parsed = reader.Object([&](std::string_view key) {
+        if (key == "resultId") {
+            tokens.resultId = reader.String();
+        } else if (key == "data") {
+            readData(tokens.data);
+            hasData = true;
+        } else if (key == "edits") {
+            tokens.delta = true;
+            reader.Array([&] {
+                LSPSemanticTokensEdit edit;
+                reader.Object([&](std::string_view field) {
+                    if (field == "start") edit.start = static_cast<uint32_t>(reader.Number());
+                    else if (field == "deleteCount") edit.deleteCount = static_cast<uint32_t>(reader.Number());
+                    else if (field == "data") readData(edit.data);
+                });
+                tokens.edits.push_back(std::move(edit));
+            });
+        }
     });
+    if (!parsed || (!hasData && !tokens.delta)) return std::nullopt;
+    return tokens;
+}
+
+} // namespace
+
+LSPSemanticTokensProvider LSPClient::GetSemanticTokensProvider() const {
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    return m_SemanticTokens;
+}
+
+void LSPClient::RequestSemanticTokens(const std::string& filePath, const std::string& previousResultId,
+                                      SemanticTokensCallback callback, CancellationToken cancel) {
+    const bool delta = !previousResultId.empty();
+    SendRequest(delta ? "textDocument/semanticTokens/full/delta" : "textDocument/semanticTokens/full",
+                [uri = FilePathToURI(filePath), previousResultId](JsonWriter& writer) {
+        writer.BeginObject();
+        writer.Key("textDocument").BeginObject().Key("uri").String(uri).EndObject();
+        if (!previousResultId.empty()) writer.Key("previousResultId").String(previousResultId);
+        writer.EndObject();
+    }, [callback](std::string_view result) {
+        callback(ReadSemanticTokens(result));
+    }, "textDocument/semanticTokens " + filePath, std::move(cancel));
+}
+
+void LSPClient::RequestSemanticTokensRange(const std::string& filePath, const LSPRange& range,
+                                           SemanticTokensCallback callback, CancellationToken cancel) {
+    SendRequest("textDocument/semanticTokens/range", [uri = FilePathToURI(filePath), range](JsonWriter& writer) {
+        writer.BeginObject();
+        writer.Key("textDocument").BeginObject().Key("uri").String(uri).EndObject();
+        writer.Key("range");
+        range.Write(writer);
+        writer.EndObject();
+    }, [callback](std::string_view result) {
+        callback(ReadSemanticTokens(result));
+    }, "textDocument/semanticTokens " + filePath, std::move(cancel));
 }
 
 void LSPClient::SetDiagnosticsCallback(DiagnosticsCallback callback) {
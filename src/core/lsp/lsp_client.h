@@ -2,14 +2,20 @@
 
 #include "lsp_types.h"
 #include "core/platform/process.h"
+#include "core/cancellation.h"
 #include "core/job_system.h"
 #include <functional>
 #include <mutex>
 #include <unordered_map>
 #include <map>
 #include <string>
+#include <string_view>
 #include <thread>
 #include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <optional>
 
 namespace sol {
 
@@ -17,39 +23,136 @@ class LSPClient {
 public:
     using CompletionCallback = std::function<void(const std::vector<LSPCompletionItem>&)>;
     using DiagnosticsCallback = std::function<void(const std::string& uri, const std::vector<LSPDiagnostic>&)>;
+    // Empty when the server failed or answered with something unreadable
+    using SemanticTokensCallback = std::function<void(std::optional<LSPSemanticTokens>)>;
+    
+    // Round trips of answered requests, per method
+    struct RequestStats {
+        size_t count = 0;
+        std::chrono::microseconds total{0};
+        std::chrono::microseconds max{0};
+        std::chrono::microseconds last{0};
+    };
 
     LSPClient(const std::string& command, const std::vector<std::string>& args);
     ~LSPClient();
 
     bool Initialize(const std::string& rootPath);
     void Shutdown();
+    
+    // Both false until the server has answered initialize. A server that
+    // takes workspace folder changes can serve more roots than the first.
+    bool IsInitialized() const { return m_Initialized; }
+    bool SupportsWorkspaceFolders() const { return m_WorkspaceFolders; }
+    void AddWorkspaceFolder(const std::string& rootPath);
 
     // Document sync
-    void DidOpen(const std::string& filePath, const std::string& content, const std::string& languageId);
-    void DidChange(const std::string& filePath, const std::string& content);
+    void DidOpen(const std::string& filePath, std::string content, const std::string& languageId);
+    // Each change applies to the text the previous one left; fullText is only
+    // called when the server syncs whole documents
+    void DidChange(const std::string& filePath, const std::vector<LSPTextChange>& changes,
+                   const std::function<std::string()>& fullText);
     void DidClose(const std::string& filePath);
     
-    // Features
-    void RequestCompletion(const std::string& filePath, int line, int character, CompletionCallback callback);
+    // Features; a new completion request for a file cancels the one still in
+    // flight. A request whose token is cancelled is never answered.
+    void RequestCompletion(const std::string& filePath, int line, int character, CompletionCallback callback,
+                           CancellationToken cancel = {});
+    // A semantic tokens request of a file replaces the one in flight. With a
+    // previousResultId the server may answer with edits to that result.
+    LSPSemanticTokensProvider GetSemanticTokensProvider() const;
+    void RequestSemanticTokens(const std::string& filePath, const std::string& previousResultId,
+                               SemanticTokensCallback callback, CancellationToken cancel = {});
+    void RequestSemanticTokensRange(const std::string& filePath, const LSPRange& range, SemanticTokensCallback callback,
+                                    CancellationToken cancel = {});
+    // Takes back the requests cancelled since the last call: drops them from
+    // the queue, or sends $/cancelRequest for those already sent
+    void WithdrawCancelledRequests();
     void SetDiagnosticsCallback(DiagnosticsCallback callback); // Set call back to handle errors
 
     bool IsRunning() const;
+    std::unordered_map<std::string, RequestStats> GetRequestStats() const;
 
 private:
-    void SendRequest(const std::string& method, const JsonObject& params, std::function<void(const JsonValue&)> callback = nullptr);
-    void SendNotification(const std::string& method, const JsonObject& params);
+    using ParamsWriter = std::function<void(JsonWriter&)>;
+    // Receives the raw result, or null when the server answered with an error
+    using ResponseCallback = std::function<void(std::string_view result)>;
+    
+    // A message waiting for the writer thread, which writes its params.
+    // Consecutive didChange notifications of one file gather into a single
+    // message, sent once the merge window closes or as soon as anything is
+    // queued behind it.
+    struct Outgoing {
+        std::string method;
+        std::optional<int> id;  // Requests only
+        ParamsWriter params;
+        std::string changedFile;  // Set for gathered didChange notifications
+        int version = 0;
+        std::vector<LSPTextChange> changes;
+        std::optional<std::string> fullText;  // Whole-document sync
+        std::chrono::steady_clock::time_point due;
+    };
+    
+    static constexpr auto CHANGE_MERGE_WINDOW = std::chrono::milliseconds(20);
+    static constexpr size_t READ_CHUNK = 64 * 1024;
+    static constexpr auto SLOW_RESPONSE = std::chrono::seconds(1);
+    // Token types offered to servers; their own legend says which they use
+    static constexpr const char* SEMANTIC_TOKEN_TYPES[] = {
+        "namespace", "type", "class", "enum", "interface", "struct", "typeParameter", "parameter",
+        "variable", "property", "enumMember", "event", "function", "method", "macro", "keyword",
+        "modifier", "comment", "string", "number", "regexp", "operator", "decorator"
+    };
+    
+    struct PendingRequest {
+        std::string method;
+        ResponseCallback callback;
+        std::chrono::steady_clock::time_point sent;
+        CancellationToken cancel;
+        std::string supersedeKey;
+    };
+    
+    // A request with a supersedeKey replaces the previous one with the same
+    // key: that one is dropped from the queue, or cancelled if already sent,
+    // and its answer is ignored
+    void SendRequest(const std::string& method, ParamsWriter params, ResponseCallback callback = nullptr,
+                     std::string supersedeKey = {}, CancellationToken cancel = {});
+    void CancelRequest(int id);
+    // Called with m_Mutex held once request id is answered or withdrawn
+    void ForgetLatest(int id, const std::string& supersedeKey);
+    void SendNotification(const std::string& method, ParamsWriter params);
+    void Enqueue(Outgoing item);
+    void WriteLoop();
+    void Write(Outgoing& item);
+    void WriteChanges(Outgoing& item);
     void ReadLoop();
-    void HandleMessage(const JsonValue& json);
+    void HandleMessage(std::string_view payload);
+    void HandleDiagnostics(std::string_view params);
+    static void WriteWorkspaceFolder(JsonWriter& writer, const std::string& uri);
     
     std::unique_ptr<Process> m_Process;
     std::thread m_ReadThread;
     std::atomic<bool> m_Running{false};
     
+    std::thread m_WriteThread;
+    std::mutex m_OutgoingMutex;
+    std::condition_variable m_OutgoingReady;
+    std::deque<Outgoing> m_Outgoing;
+    bool m_StopWriting = false;  // The writer drains the queue, then exits
+    JsonWriter m_Writer;         // Used by the writer thread only
+    std::string m_Packet;
+    
     int m_NextRequestId = 1;
-    std::mutex m_Mutex;
-    std::unordered_map<int, std::function<void(const JsonValue&)>> m_PendingRequests;
+    mutable std::mutex m_Mutex;
+    std::unordered_map<int, PendingRequest> m_PendingRequests;
+    std::unordered_map<std::string, int> m_LatestRequests;  // Supersede key to the newest id still pending
+    std::unordered_map<std::string, RequestStats> m_RequestStats;
+    LSPSemanticTokensProvider m_SemanticTokens;
     
     DiagnosticsCallback m_DiagnosticsCallback;
+    // Full until the initialize result says otherwise; a whole text is valid under any kind
+    std::atomic<TextDocumentSyncKind> m_SyncKind{TextDocumentSyncKind::Full};
+    std::atomic<bool> m_Initialized{false};
+    std::atomic<bool> m_WorkspaceFolders{false};
     
     std::string FilePathToURI(const std::string& path);
     
@@ -0,0 +1,96 @@
+#include "lsp_framer.h"
+#include <algorithm>
+#include <cctype>
+#include <charconv>
+#include <cstring>
+
+namespace sol {
+
+namespace {
+
+// Buffers grown for one huge response are given back once it has been handled
+constexpr size_t RETAINED_CAPACITY = 1024 * 1024;
+
+bool StartsWithNoCase(std::string_view text, std::string_view prefix) {
+    if (text.size() < prefix.size()) return false;
+    for (size_t i = 0; i < prefix.size(); ++i) {
+        if (std::tolower(static_cast<unsigned char>(text[i])) != prefix[i]) return false;
+    }
+    return true;
+}
+
+} // namespace
+
+std::span<char> LSPFramer::Prepare(size_t minimum) {
+    const size_t pending = m_End - m_Begin;
+    if (m_InBody && m_Length > pending) {
+        minimum = std::max(minimum, m_Length - pending);
+    }
+
+    if (pending == 0 && m_Capacity > RETAINED_CAPACITY && minimum <= RETAINED_CAPACITY) {
+        m_Buffer.reset();
+        m_Capacity = 0;
+    }
+    if (m_Capacity - m_End < minimum) {
+        if (m_Capacity - pending < minimum) {
+            const size_t capacity = std::max(m_Capacity * 2, pending + minimum);
+            std::unique_ptr<char[]> buffer(new char[capacity]);
+            if (pending) std::memcpy(buffer.get(), m_Buffer.get() + m_Begin, pending);
+            m_Buffer = std::move(buffer);
+            m_Capacity = capacity;
+        } else if (pending) {
+            std::memmove(m_Buffer.get(), m_Buffer.get() + m_Begin, pending);
+        }
+        m_Begin = 0;
+        m_End = pending;
+    }
+    return {m_Buffer.get() + m_End, m_Capacity - m_End};
+}
+
+void LSPFramer::Commit(size_t bytes) {
+    m_End += std::min(bytes, m_Capacity - m_End);
+}
+
+bool LSPFramer::ReadHeader() {
+    while (true) {
+        const char* line = m_Buffer.get() + m_Begin;
+        const size_t available = m_End - m_Begin;
+        const void* newline = std::memchr(line + m_Scan, '\n', available - m_Scan);
+        if (!newline) {
+            m_Scan = available;
+            return false;
+        }
+
+        size_t length = static_cast<const char*>(newline) - line;
+        m_Begin += length + 1;
+        m_Scan = 0;
+        if (length > 0 && line[length - 1] == '\r') --length;
+        std::string_view field(line, length);
+        if (field.empty()) return true;
+
+        constexpr std::string_view CONTENT_LENGTH = "content-length:";
+        if (StartsWithNoCase(field, CONTENT_LENGTH)) {
+            field.remove_prefix(CONTENT_LENGTH.size());
+            while (!field.empty() && field.front() == ' ') field.remove_prefix(1);
+            const auto result = std::from_chars(field.data(), field.data() + field.size(), m_Length);
+            m_HasLength = result.ec == std::errc();
+        }
+    }
+}
+
+bool LSPFramer::Next(std::string_view& body) {
+    while (!m_InBody) {
+        if (m_Begin == m_End || !ReadHeader()) return false;
+        // A header without a usable length frames nothing; look for the next one
+        m_InBody = m_HasLength;
+    }
+    if (m_End - m_Begin < m_Length) return false;
+
+    body = std::string_view(m_Buffer.get() + m_Begin, m_Length);
+    m_Begin += m_Length;
+    m_InBody = false;
+    m_HasLength = false;
+    return true;
+}
+
+} // namespace sol
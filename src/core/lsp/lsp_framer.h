@@ -0,0 +1,39 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <span>
+#include <string_view>
+
+namespace sol {
+
+// Splits the server's output into Content-Length framed message bodies.
+// Bytes are read straight into the buffer and bodies are handed out as views
+// of it, so a message is never copied unless a partial tail has to move to
+// the front to make room.
+class LSPFramer {
+public:
+    // Space for the next read, at least minimum bytes or the rest of the
+    // current body if that is larger. Invalidates bodies returned earlier.
+    std::span<char> Prepare(size_t minimum);
+    void Commit(size_t bytes);
+
+    // False until a whole body has arrived; the view lasts until Prepare
+    bool Next(std::string_view& body);
+
+private:
+    // Consumes header lines; true once the blank line ending them is reached
+    bool ReadHeader();
+
+    std::unique_ptr<char[]> m_Buffer;
+    size_t m_Capacity = 0;
+    size_t m_Begin = 0;  // Start of the unconsumed bytes
+    size_t m_End = 0;
+    size_t m_Scan = 0;   // Header bytes already looked at, from m_Begin
+
+    bool m_InBody = false;
+    bool m_HasLength = false;
+    size_t m_Length = 0;
+};
+
+} // namespace sol
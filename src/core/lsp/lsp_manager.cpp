@@ -1,5 +1,7 @@
 #include "lsp_manager.h"
+#include "core/frame_scheduler.h"
 #include "core/logger.h"
+#include <algorithm>
 
 namespace sol {
 
@@ -57,16 +59,55 @@ void LSPManager::Initialize(const std::string& projectRoot) {
 
 void LSPManager::Shutdown() {
     std::lock_guard<std::mutex> lock(m_Mutex);
-    for (auto& [lang, client] : m_Clients) {
+    for (auto& server : m_Servers) {
         try {
-            if (client) {
-                client->Shutdown();
-            }
+            server->client->Shutdown();
         } catch (...) {
             // Ignore shutdown errors
         }
     }
-    m_Clients.clear();
+    m_Servers.clear();
+    m_Documents.clear();
+}
+
+void LSPManager::Update() {
+    std::vector<std::string> detached;
+    std::vector<std::shared_ptr<LSPClient>> idle;
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        const auto now = Clock::now();
+        for (auto it = m_Servers.begin(); it != m_Servers.end();) {
+            Server& server = **it;
+            const bool running = server.client->IsRunning();
+            if (running && now - server.lastUsed < IDLE_TIMEOUT) {
+                server.client->WithdrawCancelledRequests();
+                FrameScheduler::GetInstance().RequestFrameAt(server.lastUsed + IDLE_TIMEOUT);
+                ++it;
+                continue;
+            }
+            
+            if (running) {
+                Logger::Info("Stopping idle language server: ", server.key);
+                idle.push_back(server.client);
+                m_Restarts.erase(server.key);
+            } else {
+                Logger::Warning("Language server exited: ", server.key);
+                if (now - server.started >= STABLE_RUN) m_Restarts.erase(server.key);
+                RecordFailure(server.key, now);
+            }
+            std::vector<std::string> paths = ReleaseServer(&server);
+            detached.insert(detached.end(), paths.begin(), paths.end());
+            it = m_Servers.erase(it);
+        }
+    }
+    
+    // Shutting down waits on the server, so it happens off the main thread
+    for (const auto& client : idle) {
+        JobSystem::Submit(JobPriority::Idle, [client] {
+            client->Shutdown();
+        });
+    }
+    ClearDiagnostics(detached);
 }
 
 void LSPManager::RegisterServer(const std::string& languageId, const std::string& command, const std::vector<std::string>& args) {
@@ -79,72 +120,208 @@ bool LSPManager::HasServerFor(const std::string& languageId) {
     return m_ServerConfigs.count(languageId) > 0;
 }
 
-LSPClient* LSPManager::GetClient(const std::string& languageId) {
+std::vector<LSPManager::ServerStats> LSPManager::GetServerStats() {
+    std::vector<std::pair<std::string, std::shared_ptr<LSPClient>>> clients;
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        for (const auto& server : m_Servers) clients.emplace_back(server->key, server->client);
+    }
+    std::vector<ServerStats> stats;
+    stats.reserve(clients.size());
+    for (const auto& [name, client] : clients) stats.push_back({name, client->GetRequestStats()});
+    return stats;
+}
+
+std::shared_ptr<LSPClient> LSPManager::GetClient(const std::string& filePath) {
     std::lock_guard<std::mutex> lock(m_Mutex);
+    auto it = m_Documents.find(filePath);
+    if (it == m_Documents.end() || !it->second.server || !it->second.server->client->IsRunning()) return nullptr;
+    return it->second.server->client;
+}
+
+// A server that died keeps its documents until Update drops it and sets
+// when it may be restarted
+std::shared_ptr<LSPClient> LSPManager::GetClientForRequest(const std::string& filePath,
+                                                           const std::function<std::string()>& fullText) {
+    std::shared_ptr<LSPClient> client;
+    std::string languageId;
+    bool opened = false;
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        auto it = m_Documents.find(filePath);
+        if (it == m_Documents.end()) return nullptr;
+        Document& document = it->second;
+        if (!document.server) {
+            document.server = FindServer(document, true);
+            opened = document.server != nullptr;
+        }
+        if (!document.server || !document.server->client->IsRunning()) return nullptr;
+        document.server->lastUsed = Clock::now();
+        client = document.server->client;
+        languageId = document.languageId;
+    }
+    if (opened) client->DidOpen(filePath, fullText(), languageId);
+    return client;
+}
+
+LSPManager::Server* LSPManager::FindServer(const Document& document, bool start) {
+    auto config = m_ServerConfigs.find(document.languageId);
+    if (config == m_ServerConfigs.end()) return nullptr;
+    
+    std::string key = config->second.command;
+    for (const std::string& arg : config->second.args) key += " " + arg;
     
-    // Check if client already running
-    auto it = m_Clients.find(languageId);
-    if (it != m_Clients.end()) {
-        if (it->second->IsRunning()) {
-            return it->second.get();
+    Server* shared = nullptr;
+    for (auto& server : m_Servers) {
+        if (server->key != key || !server->client->IsRunning()) continue;
+        if (std::find(server->roots.begin(), server->roots.end(), document.root) != server->roots.end()) {
+            return server.get();
         }
-        // Client died, remove it so we can try restarting
-        m_Clients.erase(it);
+        if (!shared && server->client->SupportsWorkspaceFolders()) shared = server.get();
+    }
+    if (shared) {
+        shared->client->AddWorkspaceFolder(document.root);
+        shared->roots.push_back(document.root);
+        return shared;
     }
     
-    // Check if we have config
-    auto configIt = m_ServerConfigs.find(languageId);
-    if (configIt == m_ServerConfigs.end()) {
+    if (!start) return nullptr;
+    auto restart = m_Restarts.find(key);
+    if (restart != m_Restarts.end() && Clock::now() < restart->second.notBefore) return nullptr;
+    return StartServer(key, config->second, document.root);
+}
+
+LSPManager::Server* LSPManager::StartServer(const std::string& key, const ServerConfig& config, const std::string& root) {
+    auto client = std::make_shared<LSPClient>(config.command, config.args);
+    if (!client->Initialize(root)) {
+        RecordFailure(key, Clock::now());
         return nullptr;
     }
     
-    // Start new client
-    auto client = std::make_unique<LSPClient>(configIt->second.first, configIt->second.second);
-    if (client->Initialize(m_ProjectRoot)) {
-        
-        // Hook up diagnostics
-        client->SetDiagnosticsCallback([this](const std::string& uri, const std::vector<LSPDiagnostic>& diagnostics) {
-            if (m_DiagnosticsCallback) {
-                // Convert URI back to file path: strip scheme and decode percent-encoding
-                std::string path = uri;
-                if (path.find("file://") == 0) path = path.substr(7);
-                path = DecodeURIPath(path);
-                m_DiagnosticsCallback(path, diagnostics);
-            }
-        });
-        
-        LSPClient* clientPtr = client.get();
-        m_Clients[languageId] = std::move(client);
-        return clientPtr;
-    }
+    // Hook up diagnostics
+    client->SetDiagnosticsCallback([this](const std::string& uri, const std::vector<LSPDiagnostic>& diagnostics) {
+        if (m_DiagnosticsCallback) {
+            // Convert URI back to file path: strip scheme and decode percent-encoding
+            std::string path = uri;
+            if (path.find("file://") == 0) path = path.substr(7);
+            path = DecodeURIPath(path);
+            m_DiagnosticsCallback(path, diagnostics);
+        }
+    });
     
-    return nullptr;
+    Logger::Info("Started language server: ", key);
+    auto server = std::make_unique<Server>();
+    server->key = key;
+    server->client = std::move(client);
+    server->roots.push_back(root);
+    server->started = server->lastUsed = Clock::now();
+    m_Servers.push_back(std::move(server));
+    return m_Servers.back().get();
 }
 
-void LSPManager::DidOpen(const std::string& filePath, const std::string& content, const std::string& languageId) {
-    if (auto* client = GetClient(languageId)) {
-        client->DidOpen(filePath, content, languageId);
+std::vector<std::string> LSPManager::ReleaseServer(Server* server) {
+    std::vector<std::string> paths;
+    for (auto& [path, document] : m_Documents) {
+        if (document.server != server) continue;
+        document.server = nullptr;
+        paths.push_back(path);
     }
+    return paths;
 }
 
-void LSPManager::DidChange(const std::string& filePath, const std::string& content, const std::string& languageId) {
-    if (auto* client = GetClient(languageId)) {
-        client->DidChange(filePath, content);
+void LSPManager::ClearDiagnostics(const std::vector<std::string>& paths) {
+    if (!m_DiagnosticsCallback) return;
+    for (const std::string& path : paths) m_DiagnosticsCallback(path, {});
+}
+
+void LSPManager::RecordFailure(const std::string& key, Clock::time_point now) {
+    Restart& restart = m_Restarts[key];
+    const int doublings = std::min(restart.failures++, 16);
+    const auto delay = std::min<Clock::duration>(RESTART_DELAY * (1 << doublings), MAX_RESTART_DELAY);
+    restart.notBefore = now + delay;
+    Logger::Warning("Language server ", key, " will not be restarted for ",
+                    std::chrono::duration_cast<std::chrono::seconds>(delay).count(), "s");
+}
+
+void LSPManager::DidOpen(const std::string& filePath, std::string content, const std::string& languageId) {
+    LSPClient* client = nullptr;
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        Document& document = m_Documents[filePath];
+        // The file was reloaded; the server gets it anew
+        if (document.server) document.server->client->DidClose(filePath);
+        document.languageId = languageId;
+        document.root = m_ProjectRoot;
+        document.server = FindServer(document, false);
+        if (document.server) client = document.server->client.get();
+    }
+    if (client) client->DidOpen(filePath, std::move(content), languageId);
+}
+
+void LSPManager::DidChange(const std::string& filePath, const std::vector<LSPTextChange>& changes,
+                           const std::function<std::string()>& fullText, const std::string& languageId) {
+    LSPClient* client = nullptr;
+    bool opened = false;
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        auto [it, added] = m_Documents.try_emplace(filePath, Document{languageId, m_ProjectRoot});
+        Document& document = it->second;
+        if (!document.server) {
+            document.languageId = languageId;
+            document.server = FindServer(document, true);
+            opened = document.server != nullptr;
+        }
+        if (!document.server) return;
+        document.server->lastUsed = Clock::now();
+        client = document.server->client.get();
+    }
+    // A document newly given to a server is opened with the changes already in
+    if (opened) {
+        client->DidOpen(filePath, fullText(), languageId);
+    } else {
+        client->DidChange(filePath, changes, fullText);
     }
 }
 
-void LSPManager::DidClose(const std::string& filePath, const std::string& languageId) {
-    // Only close if we have an active client for this language
+void LSPManager::DidClose(const std::string& filePath) {
     std::lock_guard<std::mutex> lock(m_Mutex);
-    auto it = m_Clients.find(languageId);
-    if (it != m_Clients.end()) {
-        it->second->DidClose(filePath);
+    auto it = m_Documents.find(filePath);
+    if (it == m_Documents.end()) return;
+    if (it->second.server) it->second.server->client->DidClose(filePath);
+    m_Documents.erase(it);
+}
+
+bool LSPManager::RequestCompletion(const std::string& filePath, const std::function<std::string()>& fullText, int line,
+                                   int character, LSPClient::CompletionCallback callback, CancellationToken cancel) {
+    if (auto client = GetClientForRequest(filePath, fullText)) {
+        client->RequestCompletion(filePath, line, character, std::move(callback), std::move(cancel));
+        return true;
     }
+    return false;
 }
 
-bool LSPManager::RequestCompletion(const std::string& filePath, const std::string& languageId, int line, int character, LSPClient::CompletionCallback callback) {
-    if (auto* client = GetClient(languageId)) {
-        client->RequestCompletion(filePath, line, character, callback);
+LSPSemanticTokensProvider LSPManager::GetSemanticTokensProvider(const std::string& filePath) {
+    if (auto client = GetClient(filePath)) {
+        return client->GetSemanticTokensProvider();
+    }
+    return {};
+}
+
+bool LSPManager::RequestSemanticTokens(const std::string& filePath, const std::function<std::string()>& fullText,
+                                       const std::string& previousResultId, LSPClient::SemanticTokensCallback callback,
+                                       CancellationToken cancel) {
+    if (auto client = GetClientForRequest(filePath, fullText)) {
+        client->RequestSemanticTokens(filePath, previousResultId, std::move(callback), std::move(cancel));
+        return true;
+    }
+    return false;
+}
+
+bool LSPManager::RequestSemanticTokensRange(const std::string& filePath, const std::function<std::string()>& fullText,
+                                            const LSPRange& range, LSPClient::SemanticTokensCallback callback,
+                                            CancellationToken cancel) {
+    if (auto client = GetClientForRequest(filePath, fullText)) {
+        client->RequestSemanticTokensRange(filePath, range, std::move(callback), std::move(cancel));
         return true;
     }
     return false;
@@ -156,19 +333,3 @@ void LSPManager::SetDiagnosticsCallback(GlobalDiagnosticsCallback callback) {
 }
 
 } // namespace sol
-
-namespace sol {
-bool LSPManager::IsClientActive(const std::string& languageId) {
-    std::lock_guard<std::mutex> lock(m_Mutex);
-    auto it = m_Clients.find(languageId);
-    if (it == m_Clients.end()) return false;
-    
-    // Check if the process is actually running
-    if (!it->second->IsRunning()) {
-        // Cleanup dead client? Maybe lazily or here.
-        // For now, just report truth.
-        return false;
-    }
-    return true;
-}
-}
@@ -1,53 +1,131 @@
 #pragma once
 
 #include "lsp_client.h"
+#include <chrono>
 #include <map>
 #include <memory>
 #include <string>
 #include <mutex>
-#include <future>
+#include <unordered_map>
+#include <vector>
 
 namespace sol {
 
+// Language servers are started by the first edit of a document they serve,
+// not by opening it, and stopped once none of their documents has been
+// edited for a while. Languages configured with the same command share one
+// server, which also takes in further workspace roots when it supports
+// folder changes. A server that fails to start or dies is restarted no
+// sooner than a backoff that doubles up to a cap.
 class LSPManager {
 public:
     static LSPManager& GetInstance();
-    
+
+    // Sets the root of documents opened from now on
     void Initialize(const std::string& projectRoot);
     void Shutdown();
-    
+    // Stops idle servers, drops dead ones and withdraws cancelled requests;
+    // called once per frame
+    void Update();
+
     // Register a language server command for a language ID
     void RegisterServer(const std::string& languageId, const std::string& command, const std::vector<std::string>& args);
-    
+
     // Check if we have language support
     bool HasServerFor(const std::string& languageId);
-    
-    // Check if client is actually active
-    bool IsClientActive(const std::string& languageId);
-    
-    // Document sync
-    void DidOpen(const std::string& filePath, const std::string& content, const std::string& languageId);
-    void DidChange(const std::string& filePath, const std::string& content, const std::string& languageId);
-    void DidClose(const std::string& filePath, const std::string& languageId);
-    
-    // Features
-    // Returns true if request was sent (client active/started), false otherwise
-    bool RequestCompletion(const std::string& filePath, const std::string& languageId, int line, int character, LSPClient::CompletionCallback callback);
-    
+
+    // Document sync. Opening only sends the text to a server that is
+    // already running; otherwise the first change starts one and opens the
+    // document with the text it leaves.
+    void DidOpen(const std::string& filePath, std::string content, const std::string& languageId);
+    void DidChange(const std::string& filePath, const std::vector<LSPTextChange>& changes,
+                   const std::function<std::string()>& fullText, const std::string& languageId);
+    void DidClose(const std::string& filePath);
+
+    // Features, answered by the server the document is open with. A document
+    // whose server was stopped for idling starts one again and is opened
+    // with fullText; false when there is no server for it. Each request
+    // keeps its server from idling. Cancelling the token withdraws a request
+    // by the next Update.
+    bool RequestCompletion(const std::string& filePath, const std::function<std::string()>& fullText, int line,
+                           int character, LSPClient::CompletionCallback callback, CancellationToken cancel = {});
+    // The provider is empty until the server is ready
+    LSPSemanticTokensProvider GetSemanticTokensProvider(const std::string& filePath);
+    bool RequestSemanticTokens(const std::string& filePath, const std::function<std::string()>& fullText,
+                               const std::string& previousResultId, LSPClient::SemanticTokensCallback callback,
+                               CancellationToken cancel = {});
+    bool RequestSemanticTokensRange(const std::string& filePath, const std::function<std::string()>& fullText,
+                                    const LSPRange& range, LSPClient::SemanticTokensCallback callback,
+                                    CancellationToken cancel = {});
+
     // Setup callbacks
     // callback: (filePath, diagnostics)
     using GlobalDiagnosticsCallback = std::function<void(const std::string&, const std::vector<LSPDiagnostic>&)>;
     void SetDiagnosticsCallback(GlobalDiagnosticsCallback callback);
 
+    // Round trips of the running servers, named by their command line
+    struct ServerStats {
+        std::string name;
+        std::unordered_map<std::string, LSPClient::RequestStats> requests;
+    };
+    std::vector<ServerStats> GetServerStats();
+
 private:
     LSPManager() = default;
-    
-    LSPClient* GetClient(const std::string& languageId);
-    
+
+    using Clock = std::chrono::steady_clock;
+    static constexpr auto IDLE_TIMEOUT = std::chrono::minutes(10);
+    static constexpr auto RESTART_DELAY = std::chrono::seconds(1);
+    static constexpr auto MAX_RESTART_DELAY = std::chrono::minutes(2);
+    // A server that ran this long before dying starts over from the first delay
+    static constexpr auto STABLE_RUN = std::chrono::minutes(1);
+
+    struct ServerConfig {
+        std::string command;
+        std::vector<std::string> args;
+    };
+
+    struct Server {
+        std::string key;  // Command line, shared by the languages it serves
+        std::shared_ptr<LSPClient> client;
+        std::vector<std::string> roots;
+        Clock::time_point started;
+        Clock::time_point lastUsed;
+    };
+
+    struct Restart {
+        int failures = 0;
+        Clock::time_point notBefore;
+    };
+
+    struct Document {
+        std::string languageId;
+        std::string root;
+        Server* server = nullptr;  // Set once the document is open with it
+    };
+
+    // Server the document is open with, without starting one
+    std::shared_ptr<LSPClient> GetClient(const std::string& filePath);
+    // Server for a feature request, marked used; one is started for a
+    // document without, which is then opened with fullText
+    std::shared_ptr<LSPClient> GetClientForRequest(const std::string& filePath,
+                                                   const std::function<std::string()>& fullText);
+    // Running server for the document's language and root, started if
+    // asked and allowed; nullptr otherwise. Called with m_Mutex held.
+    Server* FindServer(const Document& document, bool start);
+    Server* StartServer(const std::string& key, const ServerConfig& config, const std::string& root);
+    // Detaches the server's documents, returning their paths so their
+    // diagnostics can be cleared once the lock is released
+    std::vector<std::string> ReleaseServer(Server* server);
+    void ClearDiagnostics(const std::vector<std::string>& paths);
+    void RecordFailure(const std::string& key, Clock::time_point now);
+
     std::string m_ProjectRoot;
-    std::map<std::string, std::unique_ptr<LSPClient>> m_Clients;
-    std::map<std::string, std::pair<std::string, std::vector<std::string>>> m_ServerConfigs;
-    
+    std::vector<std::unique_ptr<Server>> m_Servers;
+    std::unordered_map<std::string, Document> m_Documents;  // By path
+    std::map<std::string, ServerConfig> m_ServerConfigs;    // By language ID
+    std::map<std::string, Restart> m_Restarts;              // By server key
+
     GlobalDiagnosticsCallback m_DiagnosticsCallback;
     std::mutex m_Mutex;
 };
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "core/utils/json.h"
+#include <cstdint>
 #include <string>
 #include <vector>
 
@@ -10,19 +11,17 @@ struct LSPPosition {
     int line;
     int character;
     
-    JsonObject ToJson() const {
-        return {
-            {"line", line},
-            {"character", character}
-        };
+    void Write(JsonWriter& writer) const {
+        writer.BeginObject().Key("line").Int(line).Key("character").Int(character).EndObject();
     }
     
-    static LSPPosition FromJson(const JsonValue& json) {
-        if (json.type != JsonType::Object) return {0, 0};
-        return {
-            json["line"].ToInt(),
-            json["character"].ToInt()
-        };
+    static LSPPosition Read(JsonReader& reader) {
+        LSPPosition position{0, 0};
+        reader.Object([&](std::string_view key) {
+            if (key == "line") position.line = reader.Int();
+            else if (key == "character") position.character = reader.Int();
+        });
+        return position;
     }
 };
 
@@ -30,21 +29,33 @@ struct LSPRange {
     LSPPosition start;
     LSPPosition end;
     
-    JsonObject ToJson() const {
-        return {
-            {"start", start.ToJson()},
-            {"end", end.ToJson()}
-        };
+    void Write(JsonWriter& writer) const {
+        writer.BeginObject().Key("start");
+        start.Write(writer);
+        writer.Key("end");
+        end.Write(writer);
+        writer.EndObject();
     }
     
-    static LSPRange FromJson(const JsonValue& json) {
-        return {
-            LSPPosition::FromJson(json["start"]),
-            LSPPosition::FromJson(json["end"])
-        };
+    static LSPRange Read(JsonReader& reader) {
+        LSPRange range{{0, 0}, {0, 0}};
+        reader.Object([&](std::string_view key) {
+            if (key == "start") range.start = LSPPosition::Read(reader);
+            else if (key == "end") range.end = LSPPosition::Read(reader);
+        });
+        return range;
     }
 };
 
+enum class TextDocumentSyncKind { None = 0, Full = 1, Incremental = 2 };
+
+// One contentChanges entry of didChange; the range is in the text the
+// change applies to
+struct LSPTextChange {
+    LSPRange range;
+    std::string text;
+};
+
 struct LSPCompletionItem {
     std::string label;
     int kind;
@@ -59,4 +70,28 @@ struct LSPDiagnostic {
     int severity; // 1: Error, 2: Warning, 3: Info, 4: Hint
 };
 
+// Semantic tokens in the protocol's relative encoding, five integers a token
+struct LSPSemanticTokensEdit {
+    uint32_t start = 0;
+    uint32_t deleteCount = 0;
+    std::vector<uint32_t> data;
+};
+
+// A full or range result carries data; a delta result carries edits
+// against the previous full result
+struct LSPSemanticTokens {
+    std::string resultId;
+    bool delta = false;
+    std::vector<uint32_t> data;
+    std::vector<LSPSemanticTokensEdit> edits;
+};
+
+// What the server's initialize result offers
+struct LSPSemanticTokensProvider {
+    std::vector<std::string> tokenTypes;  // Legend, indexed by token type
+    bool full = false;
+    bool delta = false;
+    bool range = false;
+};
+
 } // namespace sol
@@ -0,0 +1,148 @@
+#pragma once
+
+#include "job_system.h"
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace sol {
+
+// Data-parallel loops on the JobSystem workers. A range is cut into chunks
+// of at least minGrain items, a few per thread so uneven chunks even out,
+// which workers and the calling thread claim until none is left. The caller
+// then waits only for chunks already running, never for helpers still
+// queued, so the loops can nest and be called from jobs. Ranges of one
+// chunk run on the calling thread alone. An exception thrown by the body is
+// rethrown to the caller once every chunk is done.
+//
+// Usage Example:
+//
+// sol::ParallelFor(0, lines.size(), 1024, [&](size_t first, size_t last) {
+//     for (size_t i = first; i < last; ++i) Measure(lines[i]);
+// });
+// size_t total = sol::ParallelReduce(0, files.size(), 16, size_t{0},
+//     [&](size_t first, size_t last) { return CountSymbols(files, first, last); },
+//     [](size_t a, size_t b) { return a + b; });
+
+namespace detail {
+
+struct ParallelLoop {
+    size_t begin = 0;
+    size_t end = 0;
+    size_t grain = 0;
+    size_t chunks = 0;
+    std::atomic<size_t> next{0};      // Next unclaimed chunk
+    std::atomic<size_t> finished{0};  // Chunks done
+    std::mutex mutex;
+    std::exception_ptr error;  // First thrown by the body
+};
+
+constexpr size_t CHUNKS_PER_THREAD = 4;
+
+inline void PlanLoop(ParallelLoop& loop, size_t begin, size_t end, size_t minGrain) {
+    const size_t count = end > begin ? end - begin : 0;
+    const size_t threads = JobSystem::GetWorkerCount() + 1;
+    const size_t target = (count + threads * CHUNKS_PER_THREAD - 1) / (threads * CHUNKS_PER_THREAD);
+    loop.begin = begin;
+    loop.end = begin + count;
+    loop.grain = std::max<size_t>({minGrain, target, 1});
+    loop.chunks = (count + loop.grain - 1) / loop.grain;
+}
+
+// body(chunk, first, last) for each chunk claimed
+template <typename Body>
+void RunChunks(ParallelLoop& loop, const Body& body) {
+    for (size_t chunk; (chunk = loop.next.fetch_add(1, std::memory_order_relaxed)) < loop.chunks;) {
+        const size_t first = loop.begin + chunk * loop.grain;
+        const size_t last = std::min(loop.end, first + loop.grain);
+        try {
+            body(chunk, first, last);
+        } catch (...) {
+            std::lock_guard<std::mutex> lock(loop.mutex);
+            if (!loop.error) loop.error = std::current_exception();
+        }
+        if (loop.finished.fetch_add(1, std::memory_order_acq_rel) + 1 == loop.chunks) loop.finished.notify_all();
+    }
+}
+
+// Helpers only touch the body after claiming a chunk, and the caller
+// returns only once every chunk is done, so they can borrow it
+template <typename Body>
+void RunLoop(const std::shared_ptr<ParallelLoop>& loop, const Body& body, JobPriority priority) {
+    if (loop->chunks <= 1) {
+        if (loop->chunks == 1) body(size_t{0}, loop->begin, loop->end);
+        return;
+    }
+
+    const size_t helpers = std::min<size_t>(JobSystem::GetWorkerCount(), loop->chunks - 1);
+    for (size_t i = 0; i < helpers; ++i) {
+        JobSystem::Submit(priority, [loop, body = &body] { RunChunks(*loop, *body); });
+    }
+    RunChunks(*loop, body);
+    for (size_t done; (done = loop->finished.load(std::memory_order_acquire)) < loop->chunks;) {
+        loop->finished.wait(done, std::memory_order_acquire);
+    }
+    if (loop->error) std::rethrow_exception(loop->error);
+}
+
+} // namespace detail
+
+// body(first, last) over [begin, end) in chunks
+template <typename Body>
+void ParallelFor(size_t begin, size_t end, size_t minGrain, const Body& body,
+                 JobPriority priority = JobPriority::Interactive) {
+    auto loop = std::make_shared<detail::ParallelLoop>();
+    detail::PlanLoop(*loop, begin, end, minGrain);
+    detail::RunLoop(loop, [&body](size_t, size_t first, size_t last) { body(first, last); }, priority);
+}
+
+// map(first, last) per chunk, folded with reduce in range order starting
+// from identity, so reduce need not be commutative
+template <typename T, typename Map, typename Reduce>
+T ParallelReduce(size_t begin, size_t end, size_t minGrain, T identity, const Map& map, const Reduce& reduce,
+                 JobPriority priority = JobPriority::Interactive) {
+    auto loop = std::make_shared<detail::ParallelLoop>();
+    detail::PlanLoop(*loop, begin, end, minGrain);
+    std::vector<T> partial(loop->chunks, identity);
+    detail::RunLoop(loop, [&](size_t chunk, size_t first, size_t last) { partial[chunk] = map(first, last); }, priority);
+
+    T result = std::move(identity);
+    for (T& value : partial) result = reduce(std::move(result), std::move(value));
+    return result;
+}
+
+// Sorts chunks in parallel, then merges neighbours in parallel rounds. Not
+// stable. Inputs shorter than SORT_SERIAL_LIMIT go straight to std::sort.
+constexpr size_t SORT_SERIAL_LIMIT = 16 * 1024;
+
+template <typename It, typename Compare>
+void ParallelSort(It first, It last, Compare compare, JobPriority priority = JobPriority::Interactive) {
+    const size_t count = static_cast<size_t>(std::distance(first, last));
+    if (count < SORT_SERIAL_LIMIT) {
+        std::sort(first, last, compare);
+        return;
+    }
+
+    auto loop = std::make_shared<detail::ParallelLoop>();
+    detail::PlanLoop(*loop, 0, count, SORT_SERIAL_LIMIT / 4);
+    const size_t grain = loop->grain;
+    detail::RunLoop(loop, [&](size_t, size_t begin, size_t end) {
+        std::sort(first + begin, first + end, compare);
+    }, priority);
+
+    for (size_t width = grain; width < count; width *= 2) {
+        const size_t merges = (count - width + 2 * width - 1) / (2 * width);
+        ParallelFor(0, merges, 1, [&](size_t begin, size_t end) {
+            for (size_t merge = begin; merge < end; ++merge) {
+                const size_t low = merge * 2 * width;
+                std::inplace_merge(first + low, first + low + width, first + std::min(count, low + 2 * width), compare);
+            }
+        }, priority);
+    }
+}
+
+} // namespace sol
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <filesystem>
+#include <memory>
+#include <string_view>
+
+namespace sol {
+
+// A file written beside its target and renamed over it only once the data is
+// on disk, so a crash leaves either the old contents or the new ones. The
+// temporary file is removed unless Commit succeeds.
+class AtomicFile {
+public:
+    ~AtomicFile();
+    
+    AtomicFile(const AtomicFile&) = delete;
+    AtomicFile& operator=(const AtomicFile&) = delete;
+    
+    // Returns nullptr if the temporary file cannot be created
+    static std::unique_ptr<AtomicFile> Create(const std::filesystem::path& target);
+    
+    bool Write(std::string_view data);
+    // Flushes the data to disk, then replaces the target with it
+    bool Commit();
+    
+private:
+    AtomicFile() = default;
+    
+    std::filesystem::path m_Target;
+    std::filesystem::path m_Temporary;
+    
+    struct Impl;
+    std::unique_ptr<Impl> m_Impl;
+};
+
+} // namespace sol
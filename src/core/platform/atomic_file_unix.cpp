@@ -0,0 +1,81 @@
+#include "atomic_file.h"
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <atomic>
+#include <cerrno>
+#include <string>
+
+namespace sol {
+
+struct AtomicFile::Impl {
+    int fd = -1;
+};
+
+AtomicFile::~AtomicFile() {
+    if (!m_Impl || m_Impl->fd < 0) return;
+    close(m_Impl->fd);
+    unlink(m_Temporary.c_str());
+}
+
+std::unique_ptr<AtomicFile> AtomicFile::Create(const std::filesystem::path& target) {
+    static std::atomic<unsigned> counter{0};
+    
+    std::unique_ptr<AtomicFile> file(new AtomicFile());
+    file->m_Impl = std::make_unique<Impl>();
+    file->m_Target = target;
+    
+    // Hidden, so workspace walks and watches pass over it
+    const std::string prefix = "." + target.filename().string() + ".sol-" + std::to_string(getpid()) + "-";
+    int fd = -1;
+    for (int attempt = 0; attempt < 16 && fd < 0; ++attempt) {
+        file->m_Temporary = target.parent_path() / (prefix + std::to_string(counter++));
+        fd = open(file->m_Temporary.c_str(), O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, 0666);
+        if (fd < 0 && errno != EEXIST) return nullptr;
+    }
+    if (fd < 0) return nullptr;
+    file->m_Impl->fd = fd;
+    
+    // Keep the permissions of the file being replaced
+    struct stat st;
+    if (stat(target.c_str(), &st) == 0) fchmod(fd, st.st_mode & 07777);
+    return file;
+}
+
+bool AtomicFile::Write(std::string_view data) {
+    while (!data.empty()) {
+        const ssize_t written = write(m_Impl->fd, data.data(), data.size());
+        if (written < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        data.remove_prefix(static_cast<size_t>(written));
+    }
+    return true;
+}
+
+bool AtomicFile::Commit() {
+#ifdef F_FULLFSYNC
+    // fsync on macOS leaves the data in the drive's cache
+    bool synced = fcntl(m_Impl->fd, F_FULLFSYNC) == 0 || fsync(m_Impl->fd) == 0;
+#else
+    bool synced = fsync(m_Impl->fd) == 0;
+#endif
+    synced = close(m_Impl->fd) == 0 && synced;
+    m_Impl->fd = -1;
+    if (!synced || rename(m_Temporary.c_str(), m_Target.c_str()) != 0) {
+        unlink(m_Temporary.c_str());
+        return false;
+    }
+    
+    // The rename itself is only durable once the directory is synced
+    std::filesystem::path directory = m_Target.parent_path();
+    const int dir = open(directory.empty() ? "." : directory.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (dir >= 0) {
+        fsync(dir);
+        close(dir);
+    }
+    return true;
+}
+
+} // namespace sol
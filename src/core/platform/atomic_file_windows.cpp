@@ -0,0 +1,60 @@
+#include "atomic_file.h"
+#include <windows.h>
+#include <algorithm>
+#include <atomic>
+#include <string>
+
+namespace sol {
+
+struct AtomicFile::Impl {
+    HANDLE hFile = INVALID_HANDLE_VALUE;
+};
+
+AtomicFile::~AtomicFile() {
+    if (!m_Impl || m_Impl->hFile == INVALID_HANDLE_VALUE) return;
+    CloseHandle(m_Impl->hFile);
+    DeleteFileW(m_Temporary.c_str());
+}
+
+std::unique_ptr<AtomicFile> AtomicFile::Create(const std::filesystem::path& target) {
+    static std::atomic<unsigned> counter{0};
+    
+    std::unique_ptr<AtomicFile> file(new AtomicFile());
+    file->m_Impl = std::make_unique<Impl>();
+    file->m_Target = target;
+    
+    const std::wstring prefix = L"." + target.filename().wstring() + L".sol-" + std::to_wstring(GetCurrentProcessId()) + L"-";
+    HANDLE hFile = INVALID_HANDLE_VALUE;
+    for (int attempt = 0; attempt < 16 && hFile == INVALID_HANDLE_VALUE; ++attempt) {
+        file->m_Temporary = target.parent_path() / (prefix + std::to_wstring(counter++));
+        hFile = CreateFileW(file->m_Temporary.c_str(), GENERIC_WRITE, 0, nullptr, CREATE_NEW,
+                            FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+        if (hFile == INVALID_HANDLE_VALUE && GetLastError() != ERROR_FILE_EXISTS) return nullptr;
+    }
+    if (hFile == INVALID_HANDLE_VALUE) return nullptr;
+    file->m_Impl->hFile = hFile;
+    return file;
+}
+
+bool AtomicFile::Write(std::string_view data) {
+    while (!data.empty()) {
+        const DWORD chunk = static_cast<DWORD>(std::min<size_t>(data.size(), 1u << 30));
+        DWORD written = 0;
+        if (!WriteFile(m_Impl->hFile, data.data(), chunk, &written, nullptr)) return false;
+        data.remove_prefix(written);
+    }
+    return true;
+}
+
+bool AtomicFile::Commit() {
+    bool synced = FlushFileBuffers(m_Impl->hFile) != 0;
+    synced = CloseHandle(m_Impl->hFile) != 0 && synced;
+    m_Impl->hFile = INVALID_HANDLE_VALUE;
+    if (!synced || !MoveFileExW(m_Temporary.c_str(), m_Target.c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH)) {
+        DeleteFileW(m_Temporary.c_str());
+        return false;
+    }
+    return true;
+}
+
+} // namespace sol
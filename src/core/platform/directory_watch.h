@@ -0,0 +1,34 @@
+#pragma once
+
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <vector>
+
+namespace sol {
+
+// Native recursive change notifications for one directory tree: inotify,
+// FSEvents or ReadDirectoryChangesW. Events are reported raw, without
+// coalescing, from a thread owned by the watch; destroying it stops them.
+class DirectoryWatch {
+public:
+    // Absolute paths of files or directories that changed; rescan when the
+    // system dropped events and anything under the root may have changed
+    using Callback = std::function<void(std::vector<std::filesystem::path> paths, bool rescan)>;
+
+    ~DirectoryWatch();
+
+    DirectoryWatch(const DirectoryWatch&) = delete;
+    DirectoryWatch& operator=(const DirectoryWatch&) = delete;
+
+    // Returns nullptr if the root cannot be watched
+    static std::unique_ptr<DirectoryWatch> Start(const std::filesystem::path& root, Callback callback);
+
+private:
+    DirectoryWatch() = default;
+
+    struct Impl;
+    std::unique_ptr<Impl> m_Impl;
+};
+
+} // namespace sol
@@ -0,0 +1,142 @@
+#include "directory_watch.h"
+#include "core/logger.h"
+#include "core/workspace_files.h"
+#include <sys/inotify.h>
+#include <poll.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <cerrno>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+
+namespace sol {
+
+namespace {
+
+constexpr uint32_t WATCH_MASK = IN_CREATE | IN_DELETE | IN_MODIFY | IN_CLOSE_WRITE | IN_MOVED_FROM | IN_MOVED_TO |
+                                IN_DELETE_SELF | IN_ONLYDIR | IN_EXCL_UNLINK;
+
+} // namespace
+
+// inotify watches single directories, so every directory the workspace walk
+// visits gets its own watch and directories created later are added as they appear
+struct DirectoryWatch::Impl {
+    std::filesystem::path root;
+    Callback callback;
+    int fd = -1;
+    int wake[2] = {-1, -1};
+    std::thread thread;
+    std::unordered_map<int, std::string> directories;  // Watch descriptor to relative path with a trailing '/'
+    bool limitReported = false;
+
+    void Run();
+    // Files already inside go to created, they may predate the watches
+    void AddTree(const std::string& relative, std::vector<std::filesystem::path>* created);
+    void RemoveTree(const std::string& relative);
+};
+
+DirectoryWatch::~DirectoryWatch() {
+    if (!m_Impl) return;
+    if (m_Impl->thread.joinable()) {
+        const char stop = 0;
+        while (write(m_Impl->wake[1], &stop, 1) < 0 && errno == EINTR) {}
+        m_Impl->thread.join();
+    }
+    if (m_Impl->fd >= 0) close(m_Impl->fd);
+    if (m_Impl->wake[0] >= 0) close(m_Impl->wake[0]);
+    if (m_Impl->wake[1] >= 0) close(m_Impl->wake[1]);
+}
+
+std::unique_ptr<DirectoryWatch> DirectoryWatch::Start(const std::filesystem::path& root, Callback callback) {
+    std::unique_ptr<DirectoryWatch> watch(new DirectoryWatch());
+    watch->m_Impl = std::make_unique<Impl>();
+    Impl& impl = *watch->m_Impl;
+    impl.root = root;
+    impl.callback = std::move(callback);
+    impl.fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (impl.fd < 0 || pipe2(impl.wake, O_CLOEXEC) != 0) return nullptr;
+
+    impl.thread = std::thread(&Impl::Run, &impl);
+    return watch;
+}
+
+void DirectoryWatch::Impl::AddTree(const std::string& relative, std::vector<std::filesystem::path>* created) {
+    std::mutex mutex;
+    std::vector<std::string> found;
+    WalkWorkspace(root, relative, [] { return false; }, [&](std::string_view directory, const std::vector<std::string>& names) {
+        std::lock_guard<std::mutex> lock(mutex);
+        found.emplace_back(directory);
+        if (!created) return;
+        for (const std::string& name : names) created->push_back(root / directory / name);
+    });
+
+    for (std::string& directory : found) {
+        const int wd = inotify_add_watch(fd, (root / directory).c_str(), WATCH_MASK);
+        if (wd >= 0) {
+            directories[wd] = std::move(directory);
+        } else if (errno == ENOSPC && !limitReported) {
+            limitReported = true;
+            Logger::Warning("inotify watch limit reached; some directories under ", root, " are not watched");
+        }
+    }
+}
+
+void DirectoryWatch::Impl::RemoveTree(const std::string& relative) {
+    std::erase_if(directories, [&](const auto& entry) {
+        if (!entry.second.starts_with(relative)) return false;
+        inotify_rm_watch(fd, entry.first);
+        return true;
+    });
+}
+
+void DirectoryWatch::Impl::Run() {
+    AddTree(std::string(), nullptr);
+
+    alignas(inotify_event) char buffer[64 * 1024];
+    pollfd fds[2] = {{fd, POLLIN, 0}, {wake[0], POLLIN, 0}};
+    while (true) {
+        if (poll(fds, 2, -1) < 0) {
+            if (errno == EINTR) continue;
+            return;
+        }
+        if (fds[1].revents) return;
+
+        std::vector<std::filesystem::path> paths;
+        bool rescan = false;
+        ssize_t length;
+        while ((length = read(fd, buffer, sizeof(buffer))) > 0) {
+            for (char* at = buffer; at < buffer + length;) {
+                const auto* event = reinterpret_cast<const inotify_event*>(at);
+                at += sizeof(inotify_event) + event->len;
+
+                if (event->mask & IN_Q_OVERFLOW) {
+                    rescan = true;
+                    continue;
+                }
+                auto directory = directories.find(event->wd);
+                if (directory == directories.end()) continue;
+                if (event->mask & IN_IGNORED) {
+                    directories.erase(directory);
+                    continue;
+                }
+
+                std::string relative = directory->second;
+                if (event->len) relative += event->name;
+                paths.push_back(root / relative);
+
+                if (event->mask & IN_ISDIR) {
+                    if (event->mask & IN_MOVED_FROM) RemoveTree(relative + '/');
+                    if ((event->mask & (IN_CREATE | IN_MOVED_TO)) &&
+                        !WorkspaceIgnoreFilter(root).IsIgnored(relative, true)) {
+                        AddTree(relative, &paths);
+                    }
+                }
+            }
+        }
+        if (!paths.empty() || rescan) callback(std::move(paths), rescan);
+    }
+}
+
+} // namespace sol
@@ -0,0 +1,74 @@
+#include "directory_watch.h"
+#include <CoreServices/CoreServices.h>
+#include <dispatch/dispatch.h>
+
+namespace sol {
+
+namespace {
+
+constexpr CFTimeInterval LATENCY = 0.05;
+constexpr FSEventStreamEventFlags RESCAN_FLAGS = kFSEventStreamEventFlagMustScanSubDirs |
+                                                 kFSEventStreamEventFlagUserDropped |
+                                                 kFSEventStreamEventFlagKernelDropped |
+                                                 kFSEventStreamEventFlagRootChanged;
+
+} // namespace
+
+struct DirectoryWatch::Impl {
+    Callback callback;
+    FSEventStreamRef stream = nullptr;
+    dispatch_queue_t queue = nullptr;
+
+    static void OnEvents(ConstFSEventStreamRef, void* info, size_t count, void* eventPaths,
+                         const FSEventStreamEventFlags flags[], const FSEventStreamEventId[]) {
+        auto* impl = static_cast<Impl*>(info);
+        char** list = static_cast<char**>(eventPaths);
+        std::vector<std::filesystem::path> paths;
+        paths.reserve(count);
+        bool rescan = false;
+        for (size_t i = 0; i < count; ++i) {
+            rescan |= (flags[i] & RESCAN_FLAGS) != 0;
+            paths.emplace_back(list[i]);
+        }
+        impl->callback(std::move(paths), rescan);
+    }
+};
+
+DirectoryWatch::~DirectoryWatch() {
+    if (!m_Impl) return;
+    if (m_Impl->stream) {
+        FSEventStreamStop(m_Impl->stream);
+        FSEventStreamInvalidate(m_Impl->stream);
+        FSEventStreamRelease(m_Impl->stream);
+    }
+    if (m_Impl->queue) {
+        // Let a callback already running on the queue finish first
+        dispatch_sync_f(m_Impl->queue, nullptr, [](void*) {});
+        dispatch_release(m_Impl->queue);
+    }
+}
+
+std::unique_ptr<DirectoryWatch> DirectoryWatch::Start(const std::filesystem::path& root, Callback callback) {
+    std::unique_ptr<DirectoryWatch> watch(new DirectoryWatch());
+    watch->m_Impl = std::make_unique<Impl>();
+    Impl& impl = *watch->m_Impl;
+    impl.callback = std::move(callback);
+
+    CFStringRef path = CFStringCreateWithCString(nullptr, root.c_str(), kCFStringEncodingUTF8);
+    if (!path) return nullptr;
+    CFArrayRef paths = CFArrayCreate(nullptr, reinterpret_cast<const void**>(&path), 1, &kCFTypeArrayCallBacks);
+    FSEventStreamContext context{0, &impl, nullptr, nullptr, nullptr};
+    impl.stream = FSEventStreamCreate(nullptr, &Impl::OnEvents, &context, paths, kFSEventStreamEventIdSinceNow, LATENCY,
+                                      kFSEventStreamCreateFlagFileEvents | kFSEventStreamCreateFlagNoDefer |
+                                      kFSEventStreamCreateFlagWatchRoot);
+    CFRelease(paths);
+    CFRelease(path);
+    if (!impl.stream) return nullptr;
+
+    impl.queue = dispatch_queue_create("sol.directory_watch", DISPATCH_QUEUE_SERIAL);
+    FSEventStreamSetDispatchQueue(impl.stream, impl.queue);
+    if (!FSEventStreamStart(impl.stream)) return nullptr;
+    return watch;
+}
+
+} // namespace sol
@@ -0,0 +1,86 @@
+#include "directory_watch.h"
+#include <windows.h>
+#include <thread>
+
+namespace sol {
+
+namespace {
+
+constexpr DWORD NOTIFY_FILTER = FILE_NOTIFY_CHANGE_FILE_NAME | FILE_NOTIFY_CHANGE_DIR_NAME |
+                                FILE_NOTIFY_CHANGE_LAST_WRITE | FILE_NOTIFY_CHANGE_SIZE;
+
+} // namespace
+
+struct DirectoryWatch::Impl {
+    std::filesystem::path root;
+    Callback callback;
+    HANDLE directory = INVALID_HANDLE_VALUE;
+    HANDLE stop = nullptr;
+    std::thread thread;
+
+    void Run();
+};
+
+DirectoryWatch::~DirectoryWatch() {
+    if (!m_Impl) return;
+    if (m_Impl->thread.joinable()) {
+        SetEvent(m_Impl->stop);
+        m_Impl->thread.join();
+    }
+    if (m_Impl->stop) CloseHandle(m_Impl->stop);
+    if (m_Impl->directory != INVALID_HANDLE_VALUE) CloseHandle(m_Impl->directory);
+}
+
+std::unique_ptr<DirectoryWatch> DirectoryWatch::Start(const std::filesystem::path& root, Callback callback) {
+    std::unique_ptr<DirectoryWatch> watch(new DirectoryWatch());
+    watch->m_Impl = std::make_unique<Impl>();
+    Impl& impl = *watch->m_Impl;
+    impl.root = root;
+    impl.callback = std::move(callback);
+    impl.directory = CreateFileW(root.c_str(), FILE_LIST_DIRECTORY,
+                                 FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, nullptr, OPEN_EXISTING,
+                                 FILE_FLAG_BACKUP_SEMANTICS | FILE_FLAG_OVERLAPPED, nullptr);
+    if (impl.directory == INVALID_HANDLE_VALUE) return nullptr;
+    impl.stop = CreateEventW(nullptr, TRUE, FALSE, nullptr);
+    if (!impl.stop) return nullptr;
+
+    impl.thread = std::thread(&Impl::Run, &impl);
+    return watch;
+}
+
+void DirectoryWatch::Impl::Run() {
+    std::vector<DWORD> buffer(16 * 1024);  // DWORD aligned, as the notifications require
+    OVERLAPPED overlapped{};
+    overlapped.hEvent = CreateEventW(nullptr, FALSE, FALSE, nullptr);
+    if (!overlapped.hEvent) return;
+
+    while (ReadDirectoryChangesW(directory, buffer.data(), static_cast<DWORD>(buffer.size() * sizeof(DWORD)), TRUE,
+                                 NOTIFY_FILTER, nullptr, &overlapped, nullptr)) {
+        HANDLE handles[] = {stop, overlapped.hEvent};
+        DWORD transferred = 0;
+        if (WaitForMultipleObjects(2, handles, FALSE, INFINITE) != WAIT_OBJECT_0 + 1) {
+            CancelIoEx(directory, &overlapped);
+            GetOverlappedResult(directory, &overlapped, &transferred, TRUE);
+            break;
+        }
+        if (!GetOverlappedResult(directory, &overlapped, &transferred, FALSE)) break;
+
+        // Nothing transferred means the system buffer overflowed
+        if (transferred == 0) {
+            callback({}, true);
+            continue;
+        }
+        std::vector<std::filesystem::path> paths;
+        const BYTE* at = reinterpret_cast<const BYTE*>(buffer.data());
+        while (true) {
+            const auto* info = reinterpret_cast<const FILE_NOTIFY_INFORMATION*>(at);
+            paths.push_back(root / std::wstring(info->FileName, info->FileNameLength / sizeof(WCHAR)));
+            if (info->NextEntryOffset == 0) break;
+            at += info->NextEntryOffset;
+        }
+        callback(std::move(paths), false);
+    }
+    CloseHandle(overlapped.hEvent);
+}
+
+} // namespace sol
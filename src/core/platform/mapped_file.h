@@ -0,0 +1,33 @@
+#pragma once
+
+#include <filesystem>
+#include <memory>
+
+namespace sol {
+
+// Read-only memory mapping of a whole file. Shared so that rope leaves
+// referencing the mapping keep it alive after the buffer that opened it.
+class MappedFile {
+public:
+    ~MappedFile();
+    
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+    
+    // Returns nullptr if the file cannot be opened or mapped
+    static std::shared_ptr<const MappedFile> Open(const std::filesystem::path& path);
+    
+    const char* Data() const { return m_Data; }
+    size_t Size() const { return m_Size; }
+    
+private:
+    MappedFile() = default;
+    
+    const char* m_Data = nullptr;
+    size_t m_Size = 0;
+    
+    struct Impl;
+    std::unique_ptr<Impl> m_Impl;
+};
+
+} // namespace sol
@@ -0,0 +1,49 @@
+#include "mapped_file.h"
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace sol {
+
+struct MappedFile::Impl {
+    void* address = MAP_FAILED;
+};
+
+MappedFile::~MappedFile() {
+    if (m_Impl && m_Impl->address != MAP_FAILED) {
+        munmap(m_Impl->address, m_Size);
+    }
+}
+
+std::shared_ptr<const MappedFile> MappedFile::Open(const std::filesystem::path& path) {
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return nullptr;
+    
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        close(fd);
+        return nullptr;
+    }
+    
+    std::shared_ptr<MappedFile> file(new MappedFile());
+    file->m_Impl = std::make_unique<Impl>();
+    file->m_Size = static_cast<size_t>(st.st_size);
+    
+    if (file->m_Size > 0) {
+        void* address = mmap(nullptr, file->m_Size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (address == MAP_FAILED) {
+            close(fd);
+            return nullptr;
+        }
+        madvise(address, file->m_Size, MADV_SEQUENTIAL);
+        file->m_Impl->address = address;
+        file->m_Data = static_cast<const char*>(address);
+    }
+    
+    // The mapping stays valid after the descriptor is closed
+    close(fd);
+    return file;
+}
+
+} // namespace sol
@@ -0,0 +1,45 @@
+#include "mapped_file.h"
+#include <windows.h>
+
+namespace sol {
+
+struct MappedFile::Impl {
+    HANDLE hFile = INVALID_HANDLE_VALUE;
+    HANDLE hMapping = nullptr;
+    LPVOID view = nullptr;
+};
+
+MappedFile::~MappedFile() {
+    if (!m_Impl) return;
+    if (m_Impl->view) UnmapViewOfFile(m_Impl->view);
+    if (m_Impl->hMapping) CloseHandle(m_Impl->hMapping);
+    if (m_Impl->hFile != INVALID_HANDLE_VALUE) CloseHandle(m_Impl->hFile);
+}
+
+std::shared_ptr<const MappedFile> MappedFile::Open(const std::filesystem::path& path) {
+    // FILE_SHARE_DELETE lets a save replace the file while leaves still map it
+    HANDLE hFile = CreateFileW(path.c_str(), GENERIC_READ,
+                               FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                               nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (hFile == INVALID_HANDLE_VALUE) return nullptr;
+    
+    std::shared_ptr<MappedFile> file(new MappedFile());
+    file->m_Impl = std::make_unique<Impl>();
+    file->m_Impl->hFile = hFile;
+    
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(hFile, &size)) return nullptr;
+    file->m_Size = static_cast<size_t>(size.QuadPart);
+    if (file->m_Size == 0) return file;
+    
+    file->m_Impl->hMapping = CreateFileMappingW(hFile, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (!file->m_Impl->hMapping) return nullptr;
+    
+    file->m_Impl->view = MapViewOfFile(file->m_Impl->hMapping, FILE_MAP_READ, 0, 0, 0);
+    if (!file->m_Impl->view) return nullptr;
+    
+    file->m_Data = static_cast<const char*>(file->m_Impl->view);
+    return file;
+}
+
+} // namespace sol
@@ -18,12 +18,12 @@ public:
     // Write data to the process's stdin
     bool Write(const std::string& data);
     
-    // Read data from the process's stdout (non-blocking)
-    // Returns bytes read, or 0 if nothing available
+    // Blocks until the process's stdout has data and reads it
+    // Returns bytes read, or 0 once stdout is closed or Interrupt was called
     size_t Read(char* buffer, size_t size);
     
-    // Read stderr (non-blocking)
-    size_t ReadErr(char* buffer, size_t size);
+    // Wakes a Read blocked on another thread; every later Read returns 0
+    void Interrupt();
     
     bool IsRunning() const;
     int GetExitCode() const;
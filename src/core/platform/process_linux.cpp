@@ -4,6 +4,8 @@
 #include <sys/wait.h>
 #include <fcntl.h>
 #include <signal.h>
+#include <poll.h>
+#include <cerrno>
 #include <cstring>
 #include <vector>
 #include <stdexcept>
@@ -14,7 +16,7 @@ struct Process::Impl {
     pid_t pid = -1;
     int stdinPipe[2] = {-1, -1};  // Parent writes to [1], Child reads from [0]
     int stdoutPipe[2] = {-1, -1}; // Child writes to [1], Parent reads from [0]
-    int stderrPipe[2] = {-1, -1}; // Child writes to [1], Parent reads from [0]
+    int wakePipe[2] = {-1, -1};   // Interrupt writes to [1], Read polls [0]
     bool running = false;
     int exitCode = 0;
 };
@@ -32,7 +34,7 @@ bool Process::Start() {
 
     if (pipe(m_Impl->stdinPipe) < 0 || 
         pipe(m_Impl->stdoutPipe) < 0 || 
-        pipe(m_Impl->stderrPipe) < 0) {
+        pipe2(m_Impl->wakePipe, O_CLOEXEC) < 0) {
         return false;
     }
 
@@ -52,9 +54,9 @@ bool Process::Start() {
         dup2(m_Impl->stdoutPipe[1], STDOUT_FILENO);
         close(m_Impl->stdoutPipe[0]); // Close read end
 
-        // Redirect stderr
-        dup2(m_Impl->stderrPipe[1], STDERR_FILENO);
-        close(m_Impl->stderrPipe[0]); // Close read end
+        // Nothing reads stderr, and a full pipe would stall the child
+        int devNull = open("/dev/null", O_WRONLY);
+        if (devNull >= 0) dup2(devNull, STDERR_FILENO);
 
         // Prepare args
         std::vector<char*> args;
@@ -65,19 +67,15 @@ bool Process::Start() {
         args.push_back(nullptr);
 
         execvp(m_Command.c_str(), args.data());
-        exit(1); // Failed
+        _exit(1); // Failed; exit would run the parent's static destructors
     } else {
         // Parent
         close(m_Impl->stdinPipe[0]);  // Close read end
         close(m_Impl->stdoutPipe[1]); // Close write end
-        close(m_Impl->stderrPipe[1]); // Close write end
         
-        // Set read pipes to non-blocking
+        // Read polls first, so stdout only needs to never block
         int flags = fcntl(m_Impl->stdoutPipe[0], F_GETFL, 0);
         fcntl(m_Impl->stdoutPipe[0], F_SETFL, flags | O_NONBLOCK);
-        
-        flags = fcntl(m_Impl->stderrPipe[0], F_GETFL, 0);
-        fcntl(m_Impl->stderrPipe[0], F_SETFL, flags | O_NONBLOCK);
 
         m_Impl->running = true;
         return true;
@@ -94,7 +92,10 @@ void Process::Stop() {
 
     if (m_Impl->stdinPipe[1] != -1) close(m_Impl->stdinPipe[1]);
     if (m_Impl->stdoutPipe[0] != -1) close(m_Impl->stdoutPipe[0]);
-    if (m_Impl->stderrPipe[0] != -1) close(m_Impl->stderrPipe[0]);
+    for (int& fd : m_Impl->wakePipe) {
+        if (fd != -1) close(fd);
+        fd = -1;
+    }
 
     m_Impl->running = false;
 }
@@ -107,29 +108,28 @@ bool Process::Write(const std::string& data) {
 }
 
 size_t Process::Read(char* buffer, size_t size) {
-    if (!m_Impl->running) return 0;
+    if (!m_Impl->running || m_Impl->stdoutPipe[0] == -1) return 0;
     
-    ssize_t bytesRead = read(m_Impl->stdoutPipe[0], buffer, size);
-    if (bytesRead < 0) {
-        if (errno == EAGAIN || errno == EWOULDBLOCK) {
+    pollfd fds[2] = {{m_Impl->stdoutPipe[0], POLLIN, 0}, {m_Impl->wakePipe[0], POLLIN, 0}};
+    while (true) {
+        if (poll(fds, 2, -1) < 0) {
+            if (errno == EINTR) continue;
             return 0;
         }
-        return 0; // Error
+        if (fds[1].revents) return 0;
+        
+        ssize_t bytesRead = read(fds[0].fd, buffer, size);
+        if (bytesRead > 0) return static_cast<size_t>(bytesRead);
+        if (bytesRead == 0 || (errno != EAGAIN && errno != EINTR)) return 0;
     }
-    return static_cast<size_t>(bytesRead);
 }
 
-size_t Process::ReadErr(char* buffer, size_t size) {
-    if (!m_Impl->running) return 0;
+void Process::Interrupt() {
+    if (m_Impl->wakePipe[1] == -1) return;
     
-    ssize_t bytesRead = read(m_Impl->stderrPipe[0], buffer, size);
-    if (bytesRead < 0) {
-        if (errno == EAGAIN || errno == EWOULDBLOCK) {
-            return 0;
-        }
-        return 0; // Error
-    }
-    return static_cast<size_t>(bytesRead);
+    // Left unread, so the pipe stays readable for every later Read
+    const char wake = 0;
+    while (write(m_Impl->wakePipe[1], &wake, 1) < 0 && errno == EINTR) {}
 }
 
 bool Process::IsRunning() const {
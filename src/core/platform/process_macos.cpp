@@ -4,6 +4,7 @@
 #include <sys/wait.h>
 #include <fcntl.h>
 #include <signal.h>
+#include <poll.h>
 #include <cstring>
 #include <vector>
 #include <errno.h>
@@ -14,7 +15,7 @@ struct Process::Impl {
     pid_t pid = -1;
     int stdinPipe[2] = {-1, -1};
     int stdoutPipe[2] = {-1, -1};
-    int stderrPipe[2] = {-1, -1};
+    int wakePipe[2] = {-1, -1};
     bool running = false;
     int exitCode = 0;
 };
@@ -32,7 +33,7 @@ bool Process::Start() {
 
     if (pipe(m_Impl->stdinPipe) < 0 || 
         pipe(m_Impl->stdoutPipe) < 0 || 
-        pipe(m_Impl->stderrPipe) < 0) {
+        pipe(m_Impl->wakePipe) < 0) {
         return false;
     }
 
@@ -43,8 +44,9 @@ bool Process::Start() {
         close(m_Impl->stdinPipe[1]);
         close(m_Impl->stdoutPipe[0]);
         close(m_Impl->stdoutPipe[1]);
-        close(m_Impl->stderrPipe[0]);
-        close(m_Impl->stderrPipe[1]);
+        close(m_Impl->wakePipe[0]);
+        close(m_Impl->wakePipe[1]);
+        m_Impl->wakePipe[0] = m_Impl->wakePipe[1] = -1;
         return false;
     }
 
@@ -58,9 +60,11 @@ bool Process::Start() {
         close(m_Impl->stdoutPipe[0]);
         close(m_Impl->stdoutPipe[1]);
 
-        dup2(m_Impl->stderrPipe[1], STDERR_FILENO);
-        close(m_Impl->stderrPipe[0]);
-        close(m_Impl->stderrPipe[1]);
+        // Nothing reads stderr, and a full pipe would stall the child
+        int devNull = open("/dev/null", O_WRONLY);
+        if (devNull >= 0) dup2(devNull, STDERR_FILENO);
+        close(m_Impl->wakePipe[0]);
+        close(m_Impl->wakePipe[1]);
 
         std::vector<char*> args;
         args.push_back(const_cast<char*>(m_Command.c_str()));
@@ -76,14 +80,10 @@ bool Process::Start() {
     // Parent process
     close(m_Impl->stdinPipe[0]);
     close(m_Impl->stdoutPipe[1]);
-    close(m_Impl->stderrPipe[1]);
 
     int flags = fcntl(m_Impl->stdoutPipe[0], F_GETFL, 0);
     fcntl(m_Impl->stdoutPipe[0], F_SETFL, flags | O_NONBLOCK);
 
-    flags = fcntl(m_Impl->stderrPipe[0], F_GETFL, 0);
-    fcntl(m_Impl->stderrPipe[0], F_SETFL, flags | O_NONBLOCK);
-
     m_Impl->running = true;
     return true;
 }
@@ -110,9 +110,11 @@ void Process::Stop() {
         close(m_Impl->stdoutPipe[0]);
         m_Impl->stdoutPipe[0] = -1;
     }
-    if (m_Impl->stderrPipe[0] != -1) {
-        close(m_Impl->stderrPipe[0]);
-        m_Impl->stderrPipe[0] = -1;
+    for (int& fd : m_Impl->wakePipe) {
+        if (fd != -1) {
+            close(fd);
+            fd = -1;
+        }
     }
 
     m_Impl->running = false;
@@ -128,27 +130,26 @@ bool Process::Write(const std::string& data) {
 size_t Process::Read(char* buffer, size_t size) {
     if (!m_Impl->running || m_Impl->stdoutPipe[0] == -1) return 0;
     
-    ssize_t bytesRead = read(m_Impl->stdoutPipe[0], buffer, size);
-    if (bytesRead < 0) {
-        if (errno == EAGAIN || errno == EWOULDBLOCK) {
+    pollfd fds[2] = {{m_Impl->stdoutPipe[0], POLLIN, 0}, {m_Impl->wakePipe[0], POLLIN, 0}};
+    while (true) {
+        if (poll(fds, 2, -1) < 0) {
+            if (errno == EINTR) continue;
             return 0;
         }
-        return 0;
+        if (fds[1].revents) return 0;
+        
+        ssize_t bytesRead = read(fds[0].fd, buffer, size);
+        if (bytesRead > 0) return static_cast<size_t>(bytesRead);
+        if (bytesRead == 0 || (errno != EAGAIN && errno != EINTR)) return 0;
     }
-    return static_cast<size_t>(bytesRead);
 }
 
-size_t Process::ReadErr(char* buffer, size_t size) {
-    if (!m_Impl->running || m_Impl->stderrPipe[0] == -1) return 0;
+void Process::Interrupt() {
+    if (m_Impl->wakePipe[1] == -1) return;
     
-    ssize_t bytesRead = read(m_Impl->stderrPipe[0], buffer, size);
-    if (bytesRead < 0) {
-        if (errno == EAGAIN || errno == EWOULDBLOCK) {
-            return 0;
-        }
-        return 0;
-    }
-    return static_cast<size_t>(bytesRead);
+    // Left unread, so the pipe stays readable for every later Read
+    const char wake = 0;
+    while (write(m_Impl->wakePipe[1], &wake, 1) < 0 && errno == EINTR) {}
 }
 
 bool Process::IsRunning() const {
@@ -1,5 +1,6 @@
 #include "process.h"
 #include <windows.h>
+#include <atomic>
 #include <string>
 #include <vector>
 
@@ -10,8 +11,11 @@ struct Process::Impl {
     HANDLE hThread = nullptr;
     HANDLE hStdinWrite = nullptr;
     HANDLE hStdoutRead = nullptr;
-    HANDLE hStderrRead = nullptr;
     bool running = false;
+    // A blocked ReadFile on an anonymous pipe can only be woken by cancelling it from another thread
+    std::atomic<HANDLE> readThread = nullptr;
+    std::atomic<bool> reading = false;
+    std::atomic<bool> interrupted = false;
     DWORD exitCode = 0;
 };
 
@@ -47,8 +51,9 @@ bool Process::Start() {
         return false;
     }
 
-    if (!CreatePipe(&m_Impl->hStderrRead, &hStderrWrite, &saAttr, 0) ||
-        !SetHandleInformation(m_Impl->hStderrRead, HANDLE_FLAG_INHERIT, 0)) {
+    // Nothing reads stderr, and a full pipe would stall the child
+    hStderrWrite = CreateFileA("NUL", GENERIC_WRITE, FILE_SHARE_WRITE, &saAttr, OPEN_EXISTING, 0, nullptr);
+    if (hStderrWrite == INVALID_HANDLE_VALUE) {
         CloseHandle(hStdinRead);
         CloseHandle(m_Impl->hStdinWrite);
         CloseHandle(m_Impl->hStdoutRead);
@@ -95,7 +100,6 @@ bool Process::Start() {
     if (!success) {
         CloseHandle(m_Impl->hStdinWrite);
         CloseHandle(m_Impl->hStdoutRead);
-        CloseHandle(m_Impl->hStderrRead);
         return false;
     }
 
@@ -132,9 +136,8 @@ void Process::Stop() {
         m_Impl->hStdoutRead = nullptr;
     }
 
-    if (m_Impl->hStderrRead) {
-        CloseHandle(m_Impl->hStderrRead);
-        m_Impl->hStderrRead = nullptr;
+    if (HANDLE thread = m_Impl->readThread.exchange(nullptr)) {
+        CloseHandle(thread);
     }
 
     m_Impl->running = false;
@@ -152,41 +155,31 @@ bool Process::Write(const std::string& data) {
 size_t Process::Read(char* buffer, size_t size) {
     if (!m_Impl->running || !m_Impl->hStdoutRead) return 0;
 
-    DWORD bytesAvail = 0;
-    if (!PeekNamedPipe(m_Impl->hStdoutRead, nullptr, 0, nullptr, &bytesAvail, nullptr)) {
-        return 0;
+    if (!m_Impl->readThread) {
+        HANDLE thread = nullptr;
+        DuplicateHandle(GetCurrentProcess(), GetCurrentThread(), GetCurrentProcess(), &thread, 0, FALSE,
+                        DUPLICATE_SAME_ACCESS);
+        m_Impl->readThread = thread;
     }
 
-    if (bytesAvail == 0) return 0;
-
+    m_Impl->reading = true;
     DWORD bytesRead = 0;
-    DWORD toRead = static_cast<DWORD>(size < bytesAvail ? size : bytesAvail);
-    
-    if (!ReadFile(m_Impl->hStdoutRead, buffer, toRead, &bytesRead, nullptr)) {
-        return 0;
+    BOOL success = FALSE;
+    if (!m_Impl->interrupted) {
+        success = ReadFile(m_Impl->hStdoutRead, buffer, static_cast<DWORD>(size), &bytesRead, nullptr);
     }
+    m_Impl->reading = false;
 
-    return static_cast<size_t>(bytesRead);
+    return success ? static_cast<size_t>(bytesRead) : 0;
 }
 
-size_t Process::ReadErr(char* buffer, size_t size) {
-    if (!m_Impl->running || !m_Impl->hStderrRead) return 0;
-
-    DWORD bytesAvail = 0;
-    if (!PeekNamedPipe(m_Impl->hStderrRead, nullptr, 0, nullptr, &bytesAvail, nullptr)) {
-        return 0;
+void Process::Interrupt() {
+    m_Impl->interrupted = true;
+    // The reader may be between its check and ReadFile, so cancel until it has left
+    while (m_Impl->reading) {
+        if (HANDLE thread = m_Impl->readThread) CancelSynchronousIo(thread);
+        Sleep(0);
     }
-
-    if (bytesAvail == 0) return 0;
-
-    DWORD bytesRead = 0;
-    DWORD toRead = static_cast<DWORD>(size < bytesAvail ? size : bytesAvail);
-    
-    if (!ReadFile(m_Impl->hStderrRead, buffer, toRead, &bytesRead, nullptr)) {
-        return 0;
-    }
-
-    return static_cast<size_t>(bytesRead);
 }
 
 bool Process::IsRunning() const {
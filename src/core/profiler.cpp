@@ -0,0 +1,154 @@
+#include "profiler.h"
+#include "logger.h"
+#include "utils/json.h"
+#include <algorithm>
+#include <atomic>
+#include <fstream>
+
+namespace sol {
+
+// Zone i of the thread lives in events[i % RING_SIZE]. The fields are
+// atomics so the exporter can copy them while the thread overwrites the
+// oldest; it then drops any a write may have reached meanwhile.
+struct Profiler::ThreadBuffer {
+    struct Event {
+        std::atomic<const char*> name{nullptr};
+        std::atomic<uint64_t> start{0};
+        std::atomic<uint64_t> end{0};
+    };
+
+    std::unique_ptr<Event[]> events = std::make_unique<Event[]>(RING_SIZE);
+    std::atomic<uint64_t> count{0};  // Zones ever recorded
+    uint32_t id = 0;                 // Trace thread id
+    std::string name;
+    bool live = true;  // Held by a running thread; a released buffer is reused
+};
+
+// Hands the thread's buffer back when the thread exits
+struct Profiler::ThreadSlot {
+    ThreadBuffer* buffer = nullptr;
+    ~ThreadSlot() {
+        if (buffer) GetInstance().Release(*buffer);
+    }
+};
+
+// Never destroyed: threads still running at exit release their buffers
+// into it from thread-local destructors
+Profiler& Profiler::GetInstance() {
+    static Profiler& instance = *new Profiler;
+    return instance;
+}
+
+Profiler::~Profiler() = default;
+
+Profiler::ThreadBuffer& Profiler::CurrentThread() {
+    thread_local ThreadSlot slot;
+    if (!slot.buffer) slot.buffer = &GetInstance().Acquire();
+    return *slot.buffer;
+}
+
+Profiler::ThreadBuffer& Profiler::Acquire() {
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    for (auto& buffer : m_Threads) {
+        if (buffer->live) continue;
+        buffer->live = true;
+        buffer->name.clear();
+        buffer->count.store(0, std::memory_order_relaxed);
+        return *buffer;
+    }
+    auto& buffer = m_Threads.emplace_back(std::make_unique<ThreadBuffer>());
+    buffer->id = static_cast<uint32_t>(m_Threads.size());
+    return *buffer;
+}
+
+void Profiler::Release(ThreadBuffer& buffer) {
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    buffer.live = false;
+}
+
+void Profiler::SetThreadName(std::string name) {
+    ThreadBuffer& buffer = CurrentThread();
+    std::lock_guard<std::mutex> lock(GetInstance().m_Mutex);
+    buffer.name = std::move(name);
+}
+
+void Profiler::Record(const char* name, uint64_t start, uint64_t end) {
+    ThreadBuffer& buffer = CurrentThread();
+    const uint64_t index = buffer.count.load(std::memory_order_relaxed);
+    ThreadBuffer::Event& event = buffer.events[index & (RING_SIZE - 1)];
+    event.name.store(name, std::memory_order_relaxed);
+    event.start.store(start, std::memory_order_relaxed);
+    event.end.store(end, std::memory_order_relaxed);
+    buffer.count.store(index + 1, std::memory_order_release);
+}
+
+bool Profiler::Export(const std::filesystem::path& path, double seconds) {
+    struct Zone {
+        const char* name;
+        uint64_t start;
+        uint64_t end;
+    };
+
+    const uint64_t now = Now();
+    const uint64_t horizon = now - std::min<uint64_t>(now, static_cast<uint64_t>(seconds * 1e9));
+    uint64_t origin = now;
+
+    JsonWriter writer;
+    writer.BeginObject().Key("traceEvents").BeginArray();
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        std::vector<std::pair<uint32_t, std::vector<Zone>>> threads;
+        for (const auto& buffer : m_Threads) {
+            const uint64_t last = buffer->count.load(std::memory_order_acquire);
+            const uint64_t first = last > RING_SIZE ? last - RING_SIZE : 0;
+            std::vector<Zone> zones;
+            zones.reserve(last - first);
+            for (uint64_t i = first; i < last; ++i) {
+                const ThreadBuffer::Event& event = buffer->events[i & (RING_SIZE - 1)];
+                zones.push_back({event.name.load(std::memory_order_relaxed), event.start.load(std::memory_order_relaxed),
+                                 event.end.load(std::memory_order_relaxed)});
+            }
+            // Zone i was overwritten if the thread got as far as writing zone i + RING_SIZE
+            std::atomic_thread_fence(std::memory_order_acquire);
+            const uint64_t reached = buffer->count.load(std::memory_order_relaxed) + 1;
+            const uint64_t valid = reached > RING_SIZE ? reached - RING_SIZE : 0;
+            if (valid > first) zones.erase(zones.begin(), zones.begin() + std::min<uint64_t>(valid - first, zones.size()));
+            std::erase_if(zones, [horizon](const Zone& zone) { return zone.end < horizon; });
+            if (zones.empty()) continue;
+
+            for (const Zone& zone : zones) origin = std::min(origin, zone.start);
+            writer.BeginObject()
+                .Key("name").String("thread_name")
+                .Key("ph").String("M")
+                .Key("pid").Int(1)
+                .Key("tid").Int(buffer->id)
+                .Key("args").BeginObject().Key("name").String(buffer->name.empty() ? "Thread" : buffer->name).EndObject()
+                .EndObject();
+            threads.emplace_back(buffer->id, std::move(zones));
+        }
+
+        for (const auto& [id, zones] : threads) {
+            for (const Zone& zone : zones) {
+                writer.BeginObject()
+                    .Key("name").String(zone.name)
+                    .Key("ph").String("X")
+                    .Key("pid").Int(1)
+                    .Key("tid").Int(id)
+                    .Key("ts").Number(static_cast<double>(zone.start - origin) / 1e3)
+                    .Key("dur").Number(static_cast<double>(zone.end - zone.start) / 1e3)
+                    .EndObject();
+            }
+        }
+    }
+    writer.EndArray().Key("displayTimeUnit").String("ms").EndObject();
+
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    if (!file || !file.write(writer.Str().data(), static_cast<std::streamsize>(writer.Str().size()))) {
+        Logger::Error("Failed to write trace: ", path);
+        return false;
+    }
+    Logger::Info("Wrote trace of the last ", seconds, " s to ", path);
+    return true;
+}
+
+} // namespace sol
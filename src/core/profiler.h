@@ -0,0 +1,91 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Zones compile to nothing unless this is nonzero
+#ifndef SOL_PROFILER
+#define SOL_PROFILER 1
+#endif
+
+namespace sol {
+
+// Timed zones recorded by every thread into a ring of its own, which only
+// that thread writes, so recording takes no lock. Each ring keeps the last
+// RING_SIZE zones of its thread; WriteTrace exports those ending in the
+// last few seconds as a Chrome trace, readable by Perfetto and
+// chrome://tracing.
+//
+// Usage Example:
+//
+// void TextBuffer::ParseIncremental() {
+//     SOL_PROFILE_ZONE("TextBuffer::ParseIncremental");  // Name must be a literal
+//     ...
+// }
+// sol::Profiler::WriteTrace("sol_trace.json", 10.0);
+class Profiler {
+public:
+    static constexpr size_t RING_SIZE = 32 * 1024;  // Zones kept per thread; a power of two
+
+    static Profiler& GetInstance();
+
+    Profiler(const Profiler&) = delete;
+    Profiler& operator=(const Profiler&) = delete;
+
+    // Shown for the calling thread's zones
+    static void SetThreadName(std::string name);
+    static bool WriteTrace(const std::filesystem::path& path, double seconds) {
+        return GetInstance().Export(path, seconds);
+    }
+
+    static uint64_t Now() {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+    static void Record(const char* name, uint64_t start, uint64_t end);
+
+private:
+    Profiler() = default;
+    ~Profiler();
+
+    struct ThreadBuffer;
+    struct ThreadSlot;
+
+    static ThreadBuffer& CurrentThread();
+    ThreadBuffer& Acquire();
+    void Release(ThreadBuffer& buffer);
+    bool Export(const std::filesystem::path& path, double seconds);
+
+    std::mutex m_Mutex;  // Guards the list of buffers and their names
+    std::vector<std::unique_ptr<ThreadBuffer>> m_Threads;
+};
+
+class ProfileZone {
+public:
+    explicit ProfileZone(const char* name) : m_Name(name), m_Start(Profiler::Now()) {}
+    ~ProfileZone() { Profiler::Record(m_Name, m_Start, Profiler::Now()); }
+
+    ProfileZone(const ProfileZone&) = delete;
+    ProfileZone& operator=(const ProfileZone&) = delete;
+
+private:
+    const char* m_Name;
+    uint64_t m_Start;
+};
+
+} // namespace sol
+
+#if SOL_PROFILER
+#define SOL_PROFILE_CONCAT_(a, b) a##b
+#define SOL_PROFILE_CONCAT(a, b) SOL_PROFILE_CONCAT_(a, b)
+#define SOL_PROFILE_ZONE(name) ::sol::ProfileZone SOL_PROFILE_CONCAT(solProfileZone, __LINE__)(name)
+#define SOL_PROFILE_THREAD(name) ::sol::Profiler::SetThreadName(name)
+#else
+#define SOL_PROFILE_ZONE(name) ((void)0)
+#define SOL_PROFILE_THREAD(name) ((void)0)
+#endif
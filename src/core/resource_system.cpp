@@ -1,7 +1,17 @@
 #include "resource_system.h"
 #include "logger.h"
+#include "core/event_bus.h"
 #include "core/lsp/lsp_manager.h"
+#include "core/job_system.h"
+#include "core/symbol_index.h"
+#include "core/platform/atomic_file.h"
+#include "core/text/parser_pool.h"
+#include "core/text/undo_file.h"
+#include "core/utils/hash.h"
+#include <algorithm>
+#include <condition_variable>
 #include <fstream>
+#include <set>
 #include <sstream>
 #include <imgui.h>
 
@@ -32,81 +42,256 @@ TextResource::TextResource(const std::filesystem::path& path)
 
 bool TextResource::Load() {
     try {
-        // Only use disk buffering for extremely large files (> 100MB) where loading to RAM is dangerous
-        // For standard "large" files (1-100MB), we use the Rope structure which supports editing
-        if (std::filesystem::file_size(m_Path) > 100 * 1024 * 1024) { 
-            // Large file > 100MB: Use Disk Buffering
-             m_Buffer.EnableDiskBuffering(m_Path);
-             // We still set language but we won't load content
-             auto lang = LanguageRegistry::GetInstance().GetLanguageForFile(m_Path);
+        // Files over 100MB are memory-mapped and edited as a piece table instead of read into RAM
+        if (std::filesystem::file_size(m_Path) > 100 * 1024 * 1024) {
+            if (!m_Buffer.EnableDiskBuffering(m_Path)) {
+                Logger::Error("Failed to map file: ", m_Path);
+                return false;
+            }
+            auto lang = LanguageRegistry::GetInstance().GetLanguageForFile(m_Path);
             if (lang) {
                 m_Buffer.SetLanguage(lang);
             }
-             m_Modified = false;
-             Logger::Info("Loaded file (streamed): " + m_Path.string());
-             return true;
+            m_Modified = false;
+            StampDisk();
+            Logger::Info("Loaded file (mapped): ", m_Path);
+            return true;
         }
 
-        std::ifstream file(m_Path);
-        if (!file.is_open()) {
-            Logger::Error("Failed to open file: " + m_Path.string());
+        // The text streams in on the JobSystem; parsing and didOpen follow
+        // once it is complete
+        if (!m_Buffer.LoadFile(m_Path)) {
+            Logger::Error("Failed to open file: ", m_Path);
             return false;
         }
         
-        std::stringstream buffer;
-        buffer << file.rdbuf();
-        std::string content = buffer.str();
-        
-        // Initialize TextBuffer with content
-        m_Buffer = TextBuffer(content);
-        m_Buffer.SetFilePath(m_Path);
-        
-        // Set language and parse
-        auto lang = LanguageRegistry::GetInstance().GetLanguageForFile(m_Path);
-        if (lang) {
-            m_Buffer.SetLanguage(lang);
-            LSPManager::GetInstance().DidOpen(m_Path.string(), m_Buffer.ToString(), lang->name);
-        }
-        
         m_Modified = false;
+        StampDisk();
         
-        Logger::Info("Loaded file: " + m_Path.string());
+        Logger::Info("Loading file: ", m_Path);
         return true;
     } catch (const std::exception& e) {
-        Logger::Error("Exception loading file: " + std::string(e.what()));
+        Logger::Error("Exception loading file: ", e.what());
         return false;
     }
 }
 
-bool TextResource::Save() {
-    try {
-        std::ofstream file(m_Path);
-        if (!file.is_open()) {
-            Logger::Error("Failed to save file: " + m_Path.string());
-            return false;
+namespace {
+
+// Rope leaves are a few KB, so chunks are gathered into larger writes
+constexpr size_t SAVE_BATCH_SIZE = 1024 * 1024;
+
+// Usage is summed over every open buffer, so the budget is not checked every frame
+constexpr auto BUDGET_INTERVAL = std::chrono::seconds(1);
+
+} // namespace
+
+// A save in flight, written by a worker or by the owner once it has to wait
+struct TextResource::SaveState {
+    Rope text;
+    std::filesystem::path path;
+    std::mutex mutex;
+    std::condition_variable finished;
+    bool claimed = false;
+    bool done = false;
+    bool written = false;
+    uint64_t hash = 0;
+    
+    void Run() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (claimed) return;
+            claimed = true;
         }
-        
-        file << m_Buffer.ToString();
-        
-        if (file.fail()) {
-            Logger::Error("Error writing to file: " + m_Path.string());
-            return false;
+        uint64_t digest = 0;
+        bool ok = false;
+        try {
+            ok = Write(digest);
+        } catch (const std::exception&) {
+            ok = false;
         }
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            written = ok;
+            hash = digest;
+            done = true;
+        }
+        finished.notify_all();
+    }
+    
+    bool Write(uint64_t& digest) const {
+        auto file = AtomicFile::Create(path);
+        if (!file) return false;
         
+        StreamHash stream;
+        std::string batch;
+        batch.reserve(SAVE_BATCH_SIZE);
+        bool ok = true;
+        text.ForEachChunk(0, text.Length(), [&](std::string_view chunk) {
+            stream.Update(chunk);
+            if (batch.size() + chunk.size() > SAVE_BATCH_SIZE) {
+                ok = file->Write(batch);
+                batch.clear();
+            }
+            if (ok && chunk.size() >= SAVE_BATCH_SIZE) {
+                ok = file->Write(chunk);
+            } else {
+                batch.append(chunk);
+            }
+            return ok;
+        });
+        if (!ok || !file->Write(batch) || !file->Commit()) return false;
+        digest = stream.Final();
+        return true;
+    }
+};
+
+bool TextResource::Save() {
+    // The file already holds text that was dropped or never read, and the empty buffer must not replace it
+    if (m_Residency >= Residency::NoContent) return true;
+    PollSave(true);
+    m_Buffer.FinishIndexing();
+    
+    // Saving through a symlink writes its target rather than replacing the link
+    std::filesystem::path target = m_Path;
+    std::error_code ec;
+    if (std::filesystem::is_symlink(m_Path, ec)) {
+        auto resolved = std::filesystem::canonical(m_Path, ec);
+        if (!ec) target = std::move(resolved);
+    }
+    
+    auto state = std::make_shared<SaveState>();
+    state->text = m_Buffer.Snapshot();
+    state->path = std::move(target);
+    m_Saving = state;
+    JobSystem::Submit(JobPriority::Interactive, [state] {
+        state->Run();
+    });
+    return true;
+}
+
+void TextResource::PollSave(bool wait) {
+    if (!m_Saving) return;
+    SaveState& state = *m_Saving;
+    {
+        std::unique_lock<std::mutex> lock(state.mutex);
+        if (!state.done) {
+            if (!wait) return;
+            lock.unlock();
+            state.Run();  // Unless a worker already is
+            lock.lock();
+            state.finished.wait(lock, [&state] { return state.done; });
+        }
+    }
+    
+    const std::shared_ptr<SaveState> saved = std::move(m_Saving);
+    if (!saved->written) {
+        Logger::Error("Error writing to file: ", m_Path);
+        return;
+    }
+    
+    StampDisk();
+    // Edits made while writing keep the buffer modified
+    if (m_Buffer.Snapshot().SharesText(saved->text)) {
         m_Modified = false;
         m_Buffer.SetModified(false);
-        
-        Logger::Info("Saved file: " + m_Path.string());
+        m_Buffer.GetUndoTree().Persist(saved->hash);
+    }
+    SymbolIndex::GetInstance().UpdateFile(m_Path);
+    Logger::Info("Saved file: ", m_Path);
+}
+
+bool TextResource::Reload() {
+    if (m_Buffer.IsDiskBuffered()) return Load();
+    if (m_Residency == Residency::NoContent) {
+        Restore();
         return true;
-    } catch (const std::exception& e) {
-        Logger::Error("Exception saving file: " + std::string(e.what()));
+    }
+
+    std::ifstream file(m_Path);
+    if (!file.is_open()) {
+        Logger::Error("Failed to open file: ", m_Path);
+        return false;
+    }
+    std::stringstream buffer;
+    buffer << file.rdbuf();
+    
+    // Replacing in place keeps the views, parser and LSP document of the buffer
+    m_Buffer.FinishIndexing();
+    m_Buffer.Replace(0, m_Buffer.Length(), buffer.str());
+    m_Buffer.SetModified(false);
+    m_Modified = false;
+    StampDisk();
+    return true;
+}
+
+bool TextResource::ChangedOnDisk() const {
+    std::error_code ec;
+    const auto time = std::filesystem::last_write_time(m_Path, ec);
+    if (ec) return false;
+    const auto size = std::filesystem::file_size(m_Path, ec);
+    return !ec && (time != m_DiskTime || size != m_DiskSize);
+}
+
+void TextResource::StampDisk() {
+    std::error_code ec;
+    m_DiskTime = std::filesystem::last_write_time(m_Path, ec);
+    m_DiskSize = std::filesystem::file_size(m_Path, ec);
+    if (ec) m_DiskSize = 0;
+}
+
+bool TextResource::Trim(Residency residency) {
+    if (residency <= m_Residency) return true;
+    if (m_Buffer.IsIndexing() || IsSaving()) return false;
+    if (residency == Residency::NoContent &&
+        (IsUntitled() || m_Modified || m_Buffer.IsModified() || m_Buffer.IsDiskBuffered() || ChangedOnDisk())) {
         return false;
     }
+    
+    m_Buffer.ReleaseSyntax();
+    if (residency >= Residency::NoCaches) m_Buffer.ReleaseCaches();
+    if (residency == Residency::NoContent) m_Buffer.Unload();
+    m_Residency = residency;
+    return true;
+}
+
+void TextResource::Restore() {
+    if (m_Residency == Residency::Full) return;
+    const Residency residency = m_Residency;
+    m_Residency = Residency::Full;
+    if (residency == Residency::Unread) {
+        Load();
+        return;
+    }
+    if (residency != Residency::NoContent) {
+        m_Buffer.RestoreSyntax();
+        return;
+    }
+    
+    // Waited for, so the cursors of views showing the buffer stay in the text
+    if (!ChangedOnDisk()) {
+        if (!m_Buffer.LoadFile(m_Path, true)) Logger::Error("Failed to reopen file: ", m_Path);
+    } else {
+        // The kept undo history no longer fits the file, so it opens afresh
+        if (m_Buffer.GetLanguage()) LSPManager::GetInstance().DidClose(m_Path.string());
+        Load();
+    }
+    m_Buffer.FinishIndexing();
+}
+
+void TextResource::MarkShown(uint64_t frame) {
+    m_LastShown = frame;
+    m_ShownAt = std::chrono::steady_clock::now();
+    Restore();
 }
 
 void TextResource::SetPath(const std::filesystem::path& path) {
+    PollSave(true);
     Resource::SetPath(path);
     m_Buffer.SetFilePath(path);
+    if (!m_Buffer.IsDiskBuffered()) {
+        m_Buffer.GetUndoTree().RebindFile(UndoFile::PathFor(path));
+    }
     
     // Update language based on new file extension
     auto lang = LanguageRegistry::GetInstance().GetLanguageForFile(path);
@@ -159,6 +344,12 @@ ResourceSystem& ResourceSystem::GetInstance() {
     return instance;
 }
 
+// The parser pool is made first so it outlives the buffers handing parsers back
+ResourceSystem::ResourceSystem() {
+    ParserPool::GetInstance();
+    FileWatcher::GetInstance().Subscribe([this](const FileChanges& changes) { OnFilesChanged(changes); });
+}
+
 std::shared_ptr<Buffer> ResourceSystem::OpenFile(const std::filesystem::path& path) {
     std::lock_guard<std::recursive_mutex> lock(m_Mutex);
     
@@ -180,14 +371,28 @@ std::shared_ptr<Buffer> ResourceSystem::OpenFile(const std::filesystem::path& pa
     auto buffer = std::make_shared<Buffer>(resource);
     m_Buffers.push_back(buffer);
     
-    if (m_OnBufferOpened) {
-        m_OnBufferOpened(buffer);
-    }
+    EventBus::Publish(BufferOpenedEvent{buffer});
     
     SetActiveBuffer(buffer->GetId());
     return buffer;
 }
 
+std::shared_ptr<Buffer> ResourceSystem::OpenFileDeferred(const std::filesystem::path& path) {
+    std::lock_guard<std::recursive_mutex> lock(m_Mutex);
+    
+    for (auto& buffer : m_Buffers) {
+        if (buffer->GetResource()->GetPath() == path) return buffer;
+    }
+    
+    auto text = std::dynamic_pointer_cast<TextResource>(CreateResource(path));
+    if (!text) return nullptr;
+    text->Defer();
+    
+    auto buffer = std::make_shared<Buffer>(text);
+    m_Buffers.push_back(buffer);
+    return buffer;
+}
+
 std::shared_ptr<Buffer> ResourceSystem::CreateNewBuffer() {
     std::lock_guard<std::recursive_mutex> lock(m_Mutex);
     
@@ -204,12 +409,10 @@ std::shared_ptr<Buffer> ResourceSystem::CreateNewBuffer() {
     auto buffer = std::make_shared<Buffer>(resource);
     m_Buffers.push_back(buffer);
     
-    if (m_OnBufferOpened) {
-        m_OnBufferOpened(buffer);
-    }
+    EventBus::Publish(BufferOpenedEvent{buffer});
     
     SetActiveBuffer(buffer->GetId());
-    Logger::Info("Created new buffer: " + name);
+    Logger::Info("Created new buffer: ", name);
     return buffer;
 }
 
@@ -222,20 +425,20 @@ void ResourceSystem::CloseBuffer(Buffer::Id id) {
     if (it != m_Buffers.end()) {
         auto buffer = *it;
         m_Buffers.erase(it);
-        
-        if (m_OnBufferClosed) {
-            m_OnBufferClosed(buffer);
+        if (auto text = std::dynamic_pointer_cast<TextResource>(buffer->GetResource())) {
+            text->PollSave(true);
         }
+        std::erase_if(m_ResourceCache, [&buffer](const auto& entry) { return entry.second == buffer->GetResource(); });
+        
+        EventBus::Publish(BufferClosedEvent{buffer});
         
         // Update active buffer
         if (m_ActiveBufferId == id) {
             m_ActiveBufferId = m_Buffers.empty() ? 0 : m_Buffers.back()->GetId();
-            if (m_OnActiveBufferChanged && !m_Buffers.empty()) {
-                m_OnActiveBufferChanged(m_Buffers.back());
-            }
+            if (!m_Buffers.empty()) EventBus::Publish(ActiveBufferChangedEvent{m_Buffers.back()});
         }
         
-        Logger::Info("Closed buffer: " + buffer->GetName());
+        Logger::Info("Closed buffer: ", buffer->GetName());
     }
 }
 
@@ -274,9 +477,121 @@ void ResourceSystem::SetWorkingDirectory(const std::filesystem::path& path) {
     
     if (std::filesystem::exists(path) && std::filesystem::is_directory(path)) {
         m_WorkingDirectory = path;
-        Logger::Info("Working directory set to: " + path.string());
+        SymbolIndex::GetInstance().SetRoot(path);
+        FileWatcher::GetInstance().SetRoot(path);
+        Logger::Info("Working directory set to: ", path);
     } else {
-        Logger::Error("Invalid directory: " + path.string());
+        Logger::Error("Invalid directory: ", path);
+    }
+}
+
+void ResourceSystem::Update() {
+    std::lock_guard<std::recursive_mutex> lock(m_Mutex);
+    
+    ++m_Frame;
+    for (const auto& buffer : m_Buffers) {
+        if (auto text = std::dynamic_pointer_cast<TextResource>(buffer->GetResource())) {
+            text->GetBuffer().PollIndexing();
+        }
+    }
+    PollSaves(false);
+    
+    const auto now = std::chrono::steady_clock::now();
+    if (now - m_LastBudgetCheck >= BUDGET_INTERVAL) {
+        m_LastBudgetCheck = now;
+        if (m_SyntaxIdleTime.count() > 0) ReleaseIdleSyntax(now);
+        if (m_MemoryBudget > 0) EnforceMemoryBudget();
+    }
+}
+
+void ResourceSystem::ReleaseIdleSyntax(std::chrono::steady_clock::time_point now) {
+    for (const auto& buffer : m_Buffers) {
+        auto* text = dynamic_cast<TextResource*>(buffer->GetResource().get());
+        if (text && text->GetLastShown() + 1 < m_Frame && now - text->GetShownAt() >= m_SyntaxIdleTime) {
+            text->Trim(TextResource::Residency::NoSyntax);
+        }
+    }
+}
+
+// Trims hidden buffers one level at a time across all of them, so every
+// tree goes before any text does
+void ResourceSystem::EnforceMemoryBudget() {
+    size_t total = 0;
+    std::vector<TextResource*> hidden;
+    for (const auto& buffer : m_Buffers) {
+        auto* text = dynamic_cast<TextResource*>(buffer->GetResource().get());
+        if (!text) continue;
+        total += text->GetMemoryUsage();
+        // Views mark what they draw during the frame before this update
+        if (text->GetLastShown() + 1 < m_Frame) hidden.push_back(text);
+    }
+    if (total <= m_MemoryBudget) return;
+    
+    std::sort(hidden.begin(), hidden.end(), [](const TextResource* a, const TextResource* b) {
+        return a->GetLastShown() < b->GetLastShown();
+    });
+    for (auto residency : {TextResource::Residency::NoSyntax, TextResource::Residency::NoCaches,
+                           TextResource::Residency::NoContent}) {
+        for (TextResource* text : hidden) {
+            if (total <= m_MemoryBudget) return;
+            const size_t before = text->GetMemoryUsage();
+            if (text->Trim(residency)) total -= before - std::min(before, text->GetMemoryUsage());
+        }
+    }
+}
+
+bool ResourceSystem::IsSaving() const {
+    std::lock_guard<std::recursive_mutex> lock(m_Mutex);
+    
+    return std::any_of(m_Buffers.begin(), m_Buffers.end(), [](const auto& buffer) {
+        auto text = std::dynamic_pointer_cast<TextResource>(buffer->GetResource());
+        return text && text->IsSaving();
+    });
+}
+
+void ResourceSystem::FinishSaves() {
+    std::lock_guard<std::recursive_mutex> lock(m_Mutex);
+    PollSaves(true);
+}
+
+void ResourceSystem::PollSaves(bool wait) {
+    for (const auto& buffer : m_Buffers) {
+        if (auto text = std::dynamic_pointer_cast<TextResource>(buffer->GetResource())) {
+            text->PollSave(wait);
+        }
+    }
+}
+
+void ResourceSystem::OnFilesChanged(const FileChanges& changes) {
+    std::lock_guard<std::recursive_mutex> lock(m_Mutex);
+    
+    if (changes.rescan) {
+        SymbolIndex::GetInstance().Refresh();
+    } else {
+        for (const auto& path : changes.paths) {
+            SymbolIndex::GetInstance().UpdateFile(path);
+        }
+    }
+    
+    const std::set<std::filesystem::path> changed(changes.paths.begin(), changes.paths.end());
+    for (const auto& buffer : m_Buffers) {
+        auto text = std::dynamic_pointer_cast<TextResource>(buffer->GetResource());
+        // A save in flight stamps the file once it is written; unread files load as they are when shown
+        if (!text || text->IsUntitled() || text->IsSaving() || text->GetResidency() == TextResource::Residency::Unread) {
+            continue;
+        }
+        
+        std::error_code ec;
+        const auto canonical = std::filesystem::weakly_canonical(text->GetPath(), ec);
+        if (!changes.rescan && !changed.contains(ec ? text->GetPath() : canonical)) continue;
+        // Our own saves match the stamp taken when saving
+        if (!text->ChangedOnDisk()) continue;
+        
+        if (text->IsModified()) {
+            Logger::Warning(text->GetName(), " changed on disk; keeping the unsaved edits");
+        } else if (text->Reload()) {
+            Logger::Info("Reloaded file changed on disk: ", text->GetPath());
+        }
     }
 }
 
@@ -307,9 +622,10 @@ void ResourceSystem::SetActiveBuffer(Buffer::Id id) {
         // Activate new buffer
         if (auto newBuffer = GetBuffer(id)) {
             newBuffer->SetActive(true);
-            if (m_OnActiveBufferChanged) {
-                m_OnActiveBufferChanged(newBuffer);
+            if (auto text = std::dynamic_pointer_cast<TextResource>(newBuffer->GetResource())) {
+                text->MarkShown(m_Frame);
             }
+            EventBus::Publish(ActiveBufferChangedEvent{newBuffer});
         }
     }
 }
@@ -360,7 +676,7 @@ std::shared_ptr<Resource> ResourceSystem::CreateResource(const std::filesystem::
     }
     
     if (!std::filesystem::exists(path)) {
-        Logger::Error("File does not exist: " + path.string());
+        Logger::Error("File does not exist: ", path);
         return nullptr;
     }
     
@@ -372,7 +688,7 @@ std::shared_ptr<Resource> ResourceSystem::CreateResource(const std::filesystem::
             resource = std::make_shared<TextResource>(path);
             break;
         default:
-            Logger::Warning("Unsupported file type: " + path.string());
+            Logger::Warning("Unsupported file type: ", path);
             resource = std::make_shared<TextResource>(path); // Fallback to text
             break;
     }
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <chrono>
 #include <string>
 #include <memory>
 #include <vector>
@@ -7,6 +8,7 @@
 #include <filesystem>
 #include <functional>
 #include <mutex>
+#include "file_watcher.h"
 #include "text/text_buffer.h"
 
 struct ImGuiInputTextCallbackData;
@@ -62,7 +64,33 @@ public:
     TextResource(const std::filesystem::path& path);
     
     bool Load() override;
+    // Streams a snapshot of the text to a temporary file on the JobSystem,
+    // synced and renamed over the file. The buffer counts as saved once the
+    // write is durable, unless it was edited meanwhile.
     bool Save() override;
+    bool IsSaving() const { return m_Saving != nullptr; }
+    // Applies a finished save; with wait, blocks until it is done
+    void PollSave(bool wait);
+    // Replaces the text with the file's current contents
+    bool Reload();
+    // The file's size or modification time differs from when it was last loaded or saved
+    bool ChangedOnDisk() const;
+    
+    // How far the memory budget trimmed a hidden buffer, each level freeing
+    // what the previous ones did too; Unread buffers were never loaded
+    enum class Residency : uint8_t { Full, NoSyntax, NoCaches, NoContent, Unread };
+    Residency GetResidency() const { return m_Residency; }
+    size_t GetMemoryUsage() const { return m_Buffer.GetMemoryUsage(); }
+    // Returns false when the buffer cannot be trimmed that far now; only
+    // unmodified text that matches its file is dropped
+    bool Trim(Residency residency);
+    // Brings back whatever trimming released; an Unread buffer starts loading
+    void Restore();
+    // Leaves the file unread until the buffer is first shown
+    void Defer() { m_Residency = Residency::Unread; }
+    uint64_t GetLastShown() const { return m_LastShown; }
+    std::chrono::steady_clock::time_point GetShownAt() const { return m_ShownAt; }
+    void MarkShown(uint64_t frame);
     
     // Override SetPath to also update TextBuffer
     void SetPath(const std::filesystem::path& path) override;
@@ -82,7 +110,17 @@ public:
     static int InputTextCallback(ImGuiInputTextCallbackData* data);
     
 private:
+    struct SaveState;
+    
+    void StampDisk();
+
     TextBuffer m_Buffer;
+    std::shared_ptr<SaveState> m_Saving;
+    Residency m_Residency = Residency::Full;
+    uint64_t m_LastShown = 0;
+    std::chrono::steady_clock::time_point m_ShownAt = std::chrono::steady_clock::now();  // Or opened
+    std::filesystem::file_time_type m_DiskTime{};
+    uintmax_t m_DiskSize = 0;
 };
 
 class Buffer {
@@ -105,6 +143,18 @@ private:
     static Id GenerateId();
 };
 
+// Published on the EventBus by the ResourceSystem, on the thread changing
+// its buffers
+struct BufferOpenedEvent {
+    std::shared_ptr<Buffer> buffer;
+};
+struct BufferClosedEvent {
+    std::shared_ptr<Buffer> buffer;
+};
+struct ActiveBufferChangedEvent {
+    std::shared_ptr<Buffer> buffer;
+};
+
 class ResourceSystem {
 public:
     static ResourceSystem& GetInstance();
@@ -114,6 +164,8 @@ public:
     
     // File operations
     std::shared_ptr<Buffer> OpenFile(const std::filesystem::path& path);
+    // Adds a tab for the file without reading it or showing it
+    std::shared_ptr<Buffer> OpenFileDeferred(const std::filesystem::path& path);
     std::shared_ptr<Buffer> CreateNewBuffer();  // Create untitled buffer
     void CloseBuffer(Buffer::Id id);
     void CloseAllBuffers();
@@ -131,20 +183,36 @@ public:
     void SetActiveBuffer(Buffer::Id id);
     const std::vector<std::shared_ptr<Buffer>>& GetBuffers() const { return m_Buffers; }
     
+    // Lands the ranges of progressive loads, including those of buffers no
+    // view draws, and applies finished saves
+    void Update();
+    bool IsSaving() const;
+    // Blocks until every save in flight is on disk
+    void FinishSaves();
+    
+    // Once open buffers hold more than this, the ones off screen are trimmed,
+    // least recently shown first; 0 = unlimited
+    void SetMemoryBudget(size_t bytes) { m_MemoryBudget = bytes; }
+    // Buffers off screen this long drop their syntax trees whatever the
+    // budget, reparsed when shown again; 0 = never
+    void SetSyntaxIdleTime(std::chrono::steady_clock::duration time) { m_SyntaxIdleTime = time; }
+    // Views call this for each buffer they draw
+    void MarkShown(TextResource& text) { text.MarkShown(m_Frame); }
+    
     // Buffer tab cycling
     void NextBuffer();
     void PrevBuffer();
     
-    // Callbacks
-    using BufferCallback = std::function<void(std::shared_ptr<Buffer>)>;
-    void SetOnBufferOpened(BufferCallback callback) { m_OnBufferOpened = callback; }
-    void SetOnBufferClosed(BufferCallback callback) { m_OnBufferClosed = callback; }
-    void SetOnActiveBufferChanged(BufferCallback callback) { m_OnActiveBufferChanged = callback; }
-    
 private:
-    ResourceSystem() = default;
+    ResourceSystem();
     ~ResourceSystem() = default;
     
+    // Reloads open buffers changed by other programs and forwards changes to the SymbolIndex
+    void OnFilesChanged(const FileChanges& changes);
+    void PollSaves(bool wait);
+    void EnforceMemoryBudget();
+    void ReleaseIdleSyntax(std::chrono::steady_clock::time_point now);
+    
     std::shared_ptr<Resource> CreateResource(const std::filesystem::path& path);
     ResourceType DetectResourceType(const std::filesystem::path& path);
     
@@ -153,10 +221,10 @@ private:
     std::vector<std::shared_ptr<Buffer>> m_Buffers;
     std::map<std::filesystem::path, std::shared_ptr<Resource>> m_ResourceCache;
     Buffer::Id m_ActiveBufferId = 0;
-    
-    BufferCallback m_OnBufferOpened;
-    BufferCallback m_OnBufferClosed;
-    BufferCallback m_OnActiveBufferChanged;
+    size_t m_MemoryBudget = 0;
+    std::chrono::steady_clock::duration m_SyntaxIdleTime{};
+    uint64_t m_Frame = 0;
+    std::chrono::steady_clock::time_point m_LastBudgetCheck;
 };
 
 } // namespace sol
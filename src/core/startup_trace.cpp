@@ -0,0 +1,70 @@
+#include "startup_trace.h"
+#include "logger.h"
+#include <cstdio>
+#include <string>
+
+namespace sol {
+
+namespace {
+
+double Milliseconds(StartupTrace::Clock::duration duration) {
+    return std::chrono::duration<double, std::milli>(duration).count();
+}
+
+long long Nanoseconds(StartupTrace::Clock::duration duration) {
+    return static_cast<long long>(std::chrono::duration_cast<std::chrono::nanoseconds>(duration).count());
+}
+
+} // namespace
+
+StartupTrace& StartupTrace::GetInstance() {
+    static StartupTrace instance;
+    return instance;
+}
+
+void StartupTrace::Begin() {
+    m_Start = Clock::now();
+    m_Last = m_Start;
+    m_Phases.clear();
+    m_Finished = false;
+}
+
+void StartupTrace::Mark(std::string_view phase) {
+    if (m_Finished) return;
+    const Clock::time_point now = Clock::now();
+    m_Phases.push_back({std::string(phase), now - m_Last});
+    m_Last = now;
+}
+
+void StartupTrace::Finish(std::string_view phase) {
+    if (m_Finished) return;
+    Mark(phase);
+    m_Finished = true;
+
+    std::string phases;
+    for (const Phase& p : m_Phases) {
+        char line[96];
+        std::snprintf(line, sizeof(line), "\n  %-12s %8.1f ms", p.name.c_str(), Milliseconds(p.duration));
+        phases += line;
+    }
+    if (GetTotal() > TARGET) {
+        Logger::Warning("First frame after ", Milliseconds(GetTotal()), " ms, over the ", Milliseconds(TARGET),
+                        " ms target:", phases);
+    } else {
+        Logger::Info("First frame after ", Milliseconds(GetTotal()), " ms:", phases);
+    }
+}
+
+void StartupTrace::WriteJson(std::ostream& out) const {
+    out << "{\n  \"total_ns\": " << Nanoseconds(GetTotal())
+        << ",\n  \"target_ns\": " << Nanoseconds(TARGET)
+        << ",\n  \"phases\": [";
+    for (size_t i = 0; i < m_Phases.size(); ++i) {
+        // Phase names are identifiers, nothing to escape
+        out << (i ? ",\n" : "\n") << "    {\"name\": \"" << m_Phases[i].name << "\", \"ns\": "
+            << Nanoseconds(m_Phases[i].duration) << "}";
+    }
+    out << "\n  ]\n}\n";
+}
+
+} // namespace sol
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace sol {
+
+// Time from launch to the first frame on screen, split into the phases the
+// main thread goes through. Each Mark ends the phase in progress, so phases
+// follow one another and add up to the total; work done on workers meanwhile
+// shows only as the phase that waits on it. Main thread only.
+class StartupTrace {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    // First frame time the editor aims to stay under
+    static constexpr Clock::duration TARGET = std::chrono::milliseconds(500);
+
+    struct Phase {
+        std::string name;
+        Clock::duration duration;
+    };
+
+    static StartupTrace& GetInstance();
+
+    StartupTrace(const StartupTrace&) = delete;
+    StartupTrace& operator=(const StartupTrace&) = delete;
+
+    // Launch, which the first phase counts from
+    void Begin();
+    void Mark(std::string_view phase);
+    // Ends the last phase and logs the trace; later calls do nothing
+    void Finish(std::string_view phase);
+
+    bool IsFinished() const { return m_Finished; }
+    const std::vector<Phase>& GetPhases() const { return m_Phases; }
+    Clock::duration GetTotal() const { return m_Last - m_Start; }
+
+    // {"total_ns": n, "target_ns": n, "phases": [{"name": s, "ns": n}, ...]}
+    void WriteJson(std::ostream& out) const;
+
+private:
+    StartupTrace() = default;
+
+    Clock::time_point m_Start = Clock::now();
+    Clock::time_point m_Last = m_Start;
+    std::vector<Phase> m_Phases;
+    bool m_Finished = false;
+};
+
+} // namespace sol
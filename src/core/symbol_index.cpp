@@ -0,0 +1,509 @@
+#include "symbol_index.h"
+#include "job_system.h"
+#include "logger.h"
+#include "parallel.h"
+#include "workspace_files.h"
+#include "core/utils/hash.h"
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <mutex>
+#include <utility>
+
+namespace sol {
+
+namespace {
+
+constexpr char MAGIC[8] = {'S', 'O', 'L', 'S', 'Y', 'M', 'S', '1'};
+
+// Larger sources are mostly generated and would dominate the index
+constexpr uintmax_t MAX_FILE_SIZE = 1024 * 1024;
+
+char Lower(char c) {
+    return static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+}
+
+int CompareIgnoringCase(std::string_view a, std::string_view b) {
+    const size_t length = std::min(a.length(), b.length());
+    for (size_t i = 0; i < length; ++i) {
+        const char x = Lower(a[i]);
+        const char y = Lower(b[i]);
+        if (x != y) return static_cast<unsigned char>(x) < static_cast<unsigned char>(y) ? -1 : 1;
+    }
+    return a.length() < b.length() ? -1 : (a.length() > b.length() ? 1 : 0);
+}
+
+bool ContainsIgnoringCase(std::string_view text, std::string_view lowered) {
+    return std::search(text.begin(), text.end(), lowered.begin(), lowered.end(),
+                       [](char a, char b) { return Lower(a) == b; }) != text.end();
+}
+
+bool Stat(const std::filesystem::path& path, int64_t& mtime, uint64_t& size) {
+    std::error_code ec;
+    size = std::filesystem::file_size(path, ec);
+    if (ec) return false;
+    auto time = std::filesystem::last_write_time(path, ec);
+    if (ec) return false;
+    mtime = static_cast<int64_t>(time.time_since_epoch().count());
+    return true;
+}
+
+template <typename T>
+void Put(std::string& out, const T& value) {
+    out.append(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+// Bounds-checked reads over the loaded index; any failure rejects the file
+struct Reader {
+    std::string_view data;
+
+    template <typename T>
+    bool Get(T& value) {
+        if (data.length() < sizeof(value)) return false;
+        std::memcpy(&value, data.data(), sizeof(value));
+        data.remove_prefix(sizeof(value));
+        return true;
+    }
+
+    bool Get(std::string& value, size_t length) {
+        if (data.length() < length) return false;
+        value.assign(data.data(), length);
+        data.remove_prefix(length);
+        return true;
+    }
+};
+
+} // namespace
+
+// Files of one refresh
+struct SymbolIndex::Pass {
+    struct Item {
+        std::filesystem::path path;
+        std::string relative;
+        int64_t mtime;
+        uint64_t size;
+        std::shared_ptr<const FileEntry> entry;  // Null if the file could not be read
+    };
+
+    std::vector<Item> items;
+};
+
+SymbolIndex& SymbolIndex::GetInstance() {
+    static SymbolIndex instance;
+    return instance;
+}
+
+std::filesystem::path SymbolIndex::PathFor(const std::filesystem::path& root) {
+    const char* home = std::getenv("HOME");
+    if (!home) home = "~";
+
+    char name[32];
+    std::snprintf(name, sizeof(name), "%016llx.idx", static_cast<unsigned long long>(StreamHash::Of(root.string())));
+    return std::filesystem::path(home) / ".sol" / "symbols" / name;
+}
+
+void SymbolIndex::SetRoot(const std::filesystem::path& root) {
+    std::error_code ec;
+    auto canonical = std::filesystem::weakly_canonical(root, ec);
+
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    m_PendingRoot = ec ? root : canonical;
+    m_RootChanged = true;
+    m_RefreshPending = true;
+    m_PendingFiles.clear();
+    m_Generation.fetch_add(1, std::memory_order_relaxed);
+    ScheduleLocked();
+}
+
+void SymbolIndex::Refresh() {
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    if (m_PendingRoot.empty()) return;
+    m_RefreshPending = true;
+    ScheduleLocked();
+}
+
+void SymbolIndex::UpdateFile(const std::filesystem::path& path) {
+    std::error_code ec;
+    auto canonical = std::filesystem::weakly_canonical(path, ec);
+
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    if (m_PendingRoot.empty() || m_RefreshPending) return;
+    m_PendingFiles.insert(ec ? path : canonical);
+    ScheduleLocked();
+}
+
+void SymbolIndex::Shutdown() {
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    m_Stopped = true;
+    m_Generation.fetch_add(1, std::memory_order_relaxed);
+}
+
+bool SymbolIndex::IsIndexing() const {
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    return m_Scheduled;
+}
+
+void SymbolIndex::ScheduleLocked() {
+    if (m_Scheduled || m_Stopped) return;
+    m_Scheduled = true;
+    JobSystem::Submit(JobPriority::Background, [this] {
+        Drain();
+    });
+}
+
+// Requests are served one at a time, so only this loop touches m_Root and
+// m_Files. A pass abandoned for a newer root is dropped unpublished.
+void SymbolIndex::Drain() {
+    while (true) {
+        std::filesystem::path root;
+        bool rootChanged = false;
+        bool refresh = false;
+        std::set<std::filesystem::path> files;
+        uint64_t generation = 0;
+        {
+            std::lock_guard<std::mutex> lock(m_Mutex);
+            if (m_Stopped || (!m_RootChanged && !m_RefreshPending && m_PendingFiles.empty())) {
+                m_Scheduled = false;
+                return;
+            }
+            root = m_PendingRoot;
+            rootChanged = std::exchange(m_RootChanged, false);
+            refresh = std::exchange(m_RefreshPending, false);
+            files.swap(m_PendingFiles);
+            generation = m_Generation.load(std::memory_order_relaxed);
+        }
+
+        if (rootChanged) {
+            Load(root);
+            Publish();
+        }
+        if (refresh) {
+            RefreshAll(generation);
+        } else {
+            RefreshFiles(files, generation);
+        }
+        if (m_Generation.load(std::memory_order_relaxed) != generation || !m_Dirty) continue;
+
+        Publish();
+        Save();
+        m_Dirty = false;
+    }
+}
+
+void SymbolIndex::Load(const std::filesystem::path& root) {
+    m_Root = root;
+    m_Files.clear();
+    m_Dirty = false;
+
+    std::ifstream in(PathFor(root), std::ios::binary);
+    if (!in) return;
+    const std::string data((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+
+    Reader reader{data};
+    char magic[sizeof(MAGIC)];
+    uint32_t rootLength = 0;
+    std::string savedRoot;
+    if (!reader.Get(magic) || std::memcmp(magic, MAGIC, sizeof(MAGIC)) != 0 ||
+        !reader.Get(rootLength) || !reader.Get(savedRoot, rootLength) || savedRoot != root.string()) {
+        return;
+    }
+
+    std::map<std::string, std::shared_ptr<const FileEntry>> files;
+    while (!reader.data.empty()) {
+        auto entry = std::make_shared<FileEntry>();
+        uint32_t pathLength = 0;
+        uint32_t namesLength = 0;
+        uint32_t symbolCount = 0;
+        if (!reader.Get(pathLength) || !reader.Get(entry->path, pathLength) ||
+            !reader.Get(entry->mtime) || !reader.Get(entry->size) ||
+            !reader.Get(namesLength) || !reader.Get(entry->names, namesLength) ||
+            !reader.Get(symbolCount) || reader.data.length() / sizeof(Symbol) < symbolCount) {
+            Logger::Error("Discarding corrupt symbol index: ", PathFor(root));
+            return;
+        }
+        entry->symbols.resize(symbolCount);
+        std::memcpy(entry->symbols.data(), reader.data.data(), symbolCount * sizeof(Symbol));
+        reader.data.remove_prefix(symbolCount * sizeof(Symbol));
+        for (const Symbol& symbol : entry->symbols) {
+            if (symbol.nameOffset + size_t{symbol.nameLength} > entry->names.length()) {
+                Logger::Error("Discarding corrupt symbol index: ", PathFor(root));
+                return;
+            }
+        }
+        files.emplace(entry->path, std::move(entry));
+    }
+    m_Files = std::move(files);
+}
+
+void SymbolIndex::RefreshAll(uint64_t generation) {
+    auto cancelled = [this, generation] { return m_Generation.load(std::memory_order_relaxed) != generation; };
+    std::vector<std::filesystem::path> paths = ListWorkspaceFiles(m_Root, cancelled);
+    if (cancelled()) return;
+
+    auto pass = std::make_shared<Pass>();
+    std::map<std::string, std::shared_ptr<const FileEntry>> files;
+    for (const std::filesystem::path& path : paths) {
+        const Language* language = LanguageRegistry::GetInstance().GetLanguageForFile(path);
+        int64_t mtime = 0;
+        uint64_t size = 0;
+        if (!language || !language->tagsQuery || !Stat(path, mtime, size) || size > MAX_FILE_SIZE) continue;
+
+        std::string relative = path.lexically_relative(m_Root).generic_string();
+        auto known = m_Files.find(relative);
+        if (known != m_Files.end() && known->second->mtime == mtime && known->second->size == size) {
+            files.emplace(std::move(relative), known->second);
+        } else {
+            pass->items.push_back({path, std::move(relative), mtime, size, nullptr});
+        }
+    }
+
+    Parse(pass, generation);
+    if (cancelled()) return;
+
+    for (Pass::Item& item : pass->items) {
+        if (item.entry) files.emplace(std::move(item.relative), std::move(item.entry));
+    }
+    if (!pass->items.empty() || files.size() != m_Files.size()) m_Dirty = true;
+    m_Files = std::move(files);
+}
+
+void SymbolIndex::RefreshFiles(const std::set<std::filesystem::path>& paths, uint64_t generation) {
+    auto cancelled = [this, generation] { return m_Generation.load(std::memory_order_relaxed) != generation; };
+    WorkspaceIgnoreFilter ignores(m_Root);
+    std::vector<std::filesystem::path> candidates;
+    std::mutex mutex;
+    for (const std::filesystem::path& path : paths) {
+        std::string relative = path.lexically_relative(m_Root).generic_string();
+        if (relative.empty() || relative.starts_with("..")) continue;
+
+        std::error_code ec;
+        const auto status = std::filesystem::status(path, ec);
+        if (std::filesystem::is_directory(status)) {
+            if (ignores.IsIgnored(relative, true)) continue;
+            WalkWorkspace(m_Root, relative, cancelled, [&](std::string_view directory, const std::vector<std::string>& names) {
+                const std::filesystem::path base = m_Root / directory;
+                std::lock_guard<std::mutex> lock(mutex);
+                for (const std::string& name : names) candidates.push_back(base / name);
+            });
+        } else if (!std::filesystem::exists(status)) {
+            // A removed directory takes everything indexed below it
+            const std::string prefix = relative + '/';
+            auto below = m_Files.lower_bound(prefix);
+            auto end = below;
+            while (end != m_Files.end() && end->first.starts_with(prefix)) ++end;
+            if (below != end || m_Files.erase(relative)) m_Dirty = true;
+            m_Files.erase(below, end);
+        } else if (!ignores.IsIgnored(relative, false)) {
+            candidates.push_back(path);
+        } else if (m_Files.erase(relative)) {
+            m_Dirty = true;
+        }
+    }
+    if (cancelled()) return;
+
+    auto pass = std::make_shared<Pass>();
+    for (const std::filesystem::path& path : candidates) {
+        std::string relative = path.lexically_relative(m_Root).generic_string();
+        const Language* language = LanguageRegistry::GetInstance().GetLanguageForFile(path);
+        int64_t mtime = 0;
+        uint64_t size = 0;
+        if (language && language->tagsQuery && Stat(path, mtime, size) && size <= MAX_FILE_SIZE) {
+            auto known = m_Files.find(relative);
+            if (known != m_Files.end() && known->second->mtime == mtime && known->second->size == size) continue;
+            pass->items.push_back({path, std::move(relative), mtime, size, nullptr});
+        } else if (m_Files.erase(relative)) {
+            m_Dirty = true;
+        }
+    }
+
+    Parse(pass, generation);
+    if (m_Generation.load(std::memory_order_relaxed) != generation) return;
+
+    for (Pass::Item& item : pass->items) {
+        if (item.entry) {
+            m_Files[item.relative] = std::move(item.entry);
+        } else {
+            m_Files.erase(item.relative);
+        }
+        m_Dirty = true;
+    }
+}
+
+// The drain parses alongside the workers; files are claimed one at a time
+// since their sizes vary widely
+void SymbolIndex::Parse(const std::shared_ptr<Pass>& pass, uint64_t generation) {
+    ParallelFor(0, pass->items.size(), 1, [&](size_t first, size_t last) {
+        for (size_t i = first; i < last; ++i) {
+            if (m_Generation.load(std::memory_order_relaxed) != generation) return;
+            Pass::Item& item = pass->items[i];
+            item.entry = IndexFile(item.path, item.relative, item.mtime, item.size);
+        }
+    }, JobPriority::Background);
+}
+
+std::shared_ptr<const SymbolIndex::FileEntry> SymbolIndex::IndexFile(const std::filesystem::path& path, std::string relative,
+                                                                      int64_t mtime, uint64_t size) {
+    std::ifstream in(path, std::ios::binary);
+    if (!in) return nullptr;
+    const std::string text((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+
+    auto entry = std::make_shared<FileEntry>();
+    entry->path = std::move(relative);
+    entry->mtime = mtime;
+    entry->size = size;
+    if (text.find('\0') != std::string::npos) return entry;
+
+    TextBuffer buffer(text);
+    buffer.SetLanguage(LanguageRegistry::GetInstance().GetLanguageForFile(path));
+    buffer.FinishParsing();
+    for (const SymbolDefinition& definition : buffer.GetSymbols()) {
+        if (definition.name.length() > UINT16_MAX) continue;
+        entry->symbols.push_back(Symbol{
+            .nameOffset = static_cast<uint32_t>(entry->names.length()),
+            .line = definition.line,
+            .column = definition.column,
+            .nameLength = static_cast<uint16_t>(definition.name.length()),
+            .kind = definition.kind
+        });
+        entry->names += definition.name;
+    }
+    return entry;
+}
+
+void SymbolIndex::Publish() {
+    auto snapshot = std::make_shared<Snapshot>();
+    snapshot->root = m_Root;
+    snapshot->files.reserve(m_Files.size());
+    for (const auto& [path, entry] : m_Files) {
+        const auto file = static_cast<uint32_t>(snapshot->files.size());
+        snapshot->files.push_back(entry);
+        for (uint32_t symbol = 0; symbol < entry->symbols.size(); ++symbol) snapshot->byName.emplace_back(file, symbol);
+    }
+
+    const auto& files = snapshot->files;
+    ParallelSort(snapshot->byName.begin(), snapshot->byName.end(), [&files](auto a, auto b) {
+        std::string_view x = files[a.first]->Name(files[a.first]->symbols[a.second]);
+        std::string_view y = files[b.first]->Name(files[b.first]->symbols[b.second]);
+        const int order = CompareIgnoringCase(x, y);
+        if (order != 0) return order < 0;
+        return x != y ? x < y : a < b;
+    }, JobPriority::Background);
+
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    m_Snapshot = std::move(snapshot);
+}
+
+// Layout: MAGIC, root, then per file its path, mtime, size, names and
+// symbols, in native byte order
+void SymbolIndex::Save() const {
+    std::string data(MAGIC, sizeof(MAGIC));
+    const std::string root = m_Root.string();
+    Put(data, static_cast<uint32_t>(root.length()));
+    data += root;
+    for (const auto& [path, entry] : m_Files) {
+        Put(data, static_cast<uint32_t>(path.length()));
+        data += path;
+        Put(data, entry->mtime);
+        Put(data, entry->size);
+        Put(data, static_cast<uint32_t>(entry->names.length()));
+        data += entry->names;
+        Put(data, static_cast<uint32_t>(entry->symbols.size()));
+        data.append(reinterpret_cast<const char*>(entry->symbols.data()), entry->symbols.size() * sizeof(Symbol));
+    }
+
+    const std::filesystem::path target = PathFor(m_Root);
+    std::error_code ec;
+    std::filesystem::create_directories(target.parent_path(), ec);
+    auto temp = target;
+    temp += ".tmp";
+    {
+        std::ofstream out(temp, std::ios::binary | std::ios::trunc);
+        out.write(data.data(), static_cast<std::streamsize>(data.size()));
+        if (!out) {
+            Logger::Error("Failed to write symbol index: ", target);
+            return;
+        }
+    }
+    std::filesystem::rename(temp, target, ec);
+    if (ec) Logger::Error("Failed to write symbol index: ", target);
+}
+
+WorkspaceSymbol SymbolIndex::MakeSymbol(const Snapshot& snapshot, std::pair<uint32_t, uint32_t> ref) {
+    const FileEntry& file = *snapshot.files[ref.first];
+    const Symbol& symbol = file.symbols[ref.second];
+    return WorkspaceSymbol{
+        .name = std::string(file.Name(symbol)),
+        .path = snapshot.root / file.path,
+        .kind = symbol.kind,
+        .line = symbol.line,
+        .column = symbol.column
+    };
+}
+
+std::vector<WorkspaceSymbol> SymbolIndex::Find(std::string_view query, size_t limit) const {
+    std::shared_ptr<const Snapshot> snapshot;
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        snapshot = m_Snapshot;
+    }
+    std::vector<WorkspaceSymbol> result;
+    if (!snapshot) return result;
+
+    const auto& files = snapshot->files;
+    auto name = [&files](std::pair<uint32_t, uint32_t> ref) {
+        return files[ref.first]->Name(files[ref.first]->symbols[ref.second]);
+    };
+
+    // Names starting with the query sort into one run
+    auto first = std::partition_point(snapshot->byName.begin(), snapshot->byName.end(), [&](auto ref) {
+        return CompareIgnoringCase(name(ref).substr(0, query.length()), query) < 0;
+    });
+    auto last = first;
+    while (last != snapshot->byName.end() && result.size() < limit && CompareIgnoringCase(name(*last).substr(0, query.length()), query) == 0) {
+        result.push_back(MakeSymbol(*snapshot, *last));
+        ++last;
+    }
+
+    std::string lowered(query);
+    std::transform(lowered.begin(), lowered.end(), lowered.begin(), Lower);
+    for (auto it = snapshot->byName.begin(); it != snapshot->byName.end() && result.size() < limit; ++it) {
+        if (it >= first && it < last) continue;
+        std::string_view candidate = name(*it);
+        if (candidate.length() > query.length() && ContainsIgnoringCase(candidate, lowered)) {
+            result.push_back(MakeSymbol(*snapshot, *it));
+        }
+    }
+    return result;
+}
+
+std::vector<WorkspaceSymbol> SymbolIndex::Complete(std::string_view prefix, size_t limit) const {
+    std::shared_ptr<const Snapshot> snapshot;
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        snapshot = m_Snapshot;
+    }
+    std::vector<WorkspaceSymbol> result;
+    if (!snapshot || prefix.empty()) return result;
+
+    const auto& files = snapshot->files;
+    auto name = [&files](std::pair<uint32_t, uint32_t> ref) {
+        return files[ref.first]->Name(files[ref.first]->symbols[ref.second]);
+    };
+    auto it = std::partition_point(snapshot->byName.begin(), snapshot->byName.end(), [&](auto ref) {
+        return CompareIgnoringCase(name(ref).substr(0, prefix.length()), prefix) < 0;
+    });
+    std::string_view previous;
+    for (; it != snapshot->byName.end() && result.size() < limit; ++it) {
+        std::string_view candidate = name(*it);
+        if (CompareIgnoringCase(candidate.substr(0, prefix.length()), prefix) != 0) break;
+        if (candidate == previous) continue;
+        previous = candidate;
+        result.push_back(MakeSymbol(*snapshot, *it));
+    }
+    return result;
+}
+
+} // namespace sol
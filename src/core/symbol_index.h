@@ -0,0 +1,113 @@
+#pragma once
+
+#include "text/text_buffer.h"
+#include <atomic>
+#include <cstdint>
+#include <filesystem>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace sol {
+
+struct WorkspaceSymbol {
+    std::string name;
+    std::filesystem::path path;
+    SymbolKind kind;
+    uint32_t line;
+    uint32_t column;
+};
+
+// Definitions in every file under the working directory whose language has a
+// tags query, so symbols can be found without a language server. Files are
+// parsed on JobSystem workers; the index is kept in
+// ~/.sol/symbols/<hash of the root>.idx and a refresh parses only files whose
+// size or modification time changed since.
+class SymbolIndex {
+public:
+    static SymbolIndex& GetInstance();
+
+    SymbolIndex(const SymbolIndex&) = delete;
+    SymbolIndex& operator=(const SymbolIndex&) = delete;
+
+    // Loads the saved index of root, then refreshes it
+    void SetRoot(const std::filesystem::path& root);
+    void Refresh();
+    void UpdateFile(const std::filesystem::path& path);  // The file changed on disk
+    void Shutdown();  // Abandons pending work so JobSystem shutdown does not wait on it
+    bool IsIndexing() const;
+
+    // Names containing query ignoring case, the ones starting with it first
+    std::vector<WorkspaceSymbol> Find(std::string_view query, size_t limit) const;
+    // One symbol per distinct name starting with prefix ignoring case
+    std::vector<WorkspaceSymbol> Complete(std::string_view prefix, size_t limit) const;
+
+private:
+    SymbolIndex() = default;
+    ~SymbolIndex() = default;
+
+    struct Symbol {
+        uint32_t nameOffset;
+        uint32_t line;
+        uint32_t column;
+        uint16_t nameLength;
+        SymbolKind kind;
+        uint8_t reserved = 0;
+    };
+
+    struct FileEntry {
+        std::string path;  // Relative to the root, generic separators
+        int64_t mtime = 0;
+        uint64_t size = 0;
+        std::string names; // Symbol names back to back
+        std::vector<Symbol> symbols;
+
+        std::string_view Name(const Symbol& symbol) const { return std::string_view(names).substr(symbol.nameOffset, symbol.nameLength); }
+    };
+
+    // Published state; readers copy the pointer and search without locking
+    struct Snapshot {
+        std::filesystem::path root;
+        std::vector<std::shared_ptr<const FileEntry>> files;
+        std::vector<std::pair<uint32_t, uint32_t>> byName;  // (file, symbol) sorted by name ignoring case
+    };
+
+    struct Pass;
+
+    void ScheduleLocked();
+    void Drain();
+    void Load(const std::filesystem::path& root);
+    void RefreshAll(uint64_t generation);
+    void RefreshFiles(const std::set<std::filesystem::path>& paths, uint64_t generation);
+    void Parse(const std::shared_ptr<Pass>& pass, uint64_t generation);
+    void Publish();
+    void Save() const;
+
+    static std::filesystem::path PathFor(const std::filesystem::path& root);
+    static std::shared_ptr<const FileEntry> IndexFile(const std::filesystem::path& path, std::string relative,
+                                                      int64_t mtime, uint64_t size);
+    static WorkspaceSymbol MakeSymbol(const Snapshot& snapshot, std::pair<uint32_t, uint32_t> ref);
+
+    // Requests, guarded by m_Mutex
+    mutable std::mutex m_Mutex;
+    std::filesystem::path m_PendingRoot;
+    bool m_RootChanged = false;
+    bool m_RefreshPending = false;
+    std::set<std::filesystem::path> m_PendingFiles;
+    std::shared_ptr<const Snapshot> m_Snapshot;
+    bool m_Scheduled = false;
+    bool m_Stopped = false;
+
+    std::atomic<uint64_t> m_Generation{0};  // Bumped to abandon the running pass
+
+    // Owned by the running drain
+    std::filesystem::path m_Root;
+    std::map<std::string, std::shared_ptr<const FileEntry>> m_Files;
+    bool m_Dirty = false;  // m_Files differs from the saved index
+};
+
+} // namespace sol
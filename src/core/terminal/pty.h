@@ -21,6 +21,11 @@ public:
     // Returns number of bytes read, or -1 on error, or 0 if nothing available
     int Read(char* buffer, size_t size);
     
+    // Block until there is output to read; false once the PTY hangs up
+    // or CancelWait is called
+    bool WaitForOutput();
+    void CancelWait();
+    
     // Write to the PTY
     bool Write(const char* data, size_t size);
     bool Write(const std::string& data);
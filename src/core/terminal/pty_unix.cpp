@@ -4,6 +4,7 @@
 #include <fcntl.h>
 #include <signal.h>
 #include <errno.h>
+#include <poll.h>
 #include <cstring>
 #include <sys/types.h>
 #include <sys/wait.h>
@@ -19,8 +20,16 @@
 
 namespace sol {
 
+namespace {
+
+// Longest a write waits for the program to make room in the PTY
+constexpr int WRITE_TIMEOUT_MS = 1000;
+
+} // namespace
+
 struct Pty::Impl {
     int masterFd = -1;
+    int wakeFds[2] = {-1, -1};  // Written by CancelWait to end WaitForOutput
     pid_t childPid = -1;
     int exitCode = 0;
     bool alive = false;
@@ -125,6 +134,13 @@ bool Pty::Spawn(const std::string& shell, int rows, int cols, const std::string&
     int flags = fcntl(masterFd, F_GETFL, 0);
     fcntl(masterFd, F_SETFL, flags | O_NONBLOCK);
     
+    if (pipe(m_Impl->wakeFds) == 0) {
+        for (int fd : m_Impl->wakeFds) {
+            fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+            fcntl(fd, F_SETFD, FD_CLOEXEC);
+        }
+    }
+    
     m_Impl->masterFd = masterFd;
     m_Impl->childPid = pid;
     m_Impl->alive = true;
@@ -165,6 +181,13 @@ void Pty::Close() {
         m_Impl->masterFd = -1;
     }
     
+    for (int& fd : m_Impl->wakeFds) {
+        if (fd >= 0) {
+            close(fd);
+            fd = -1;
+        }
+    }
+    
     m_Impl->alive = false;
 }
 
@@ -179,21 +202,57 @@ int Pty::Read(char* buffer, size_t size) {
         }
         return -1;  // Error
     }
+    if (n == 0) {
+        return -1;  // The child closed the terminal
+    }
     
     return static_cast<int>(n);
 }
 
+bool Pty::WaitForOutput() {
+    if (m_Impl->masterFd < 0) return false;
+    
+    struct pollfd fds[2] = {
+        {m_Impl->masterFd, POLLIN, 0},
+        {m_Impl->wakeFds[0], POLLIN, 0},
+    };
+    while (poll(fds, 2, -1) < 0) {
+        if (errno != EINTR) return false;
+    }
+    
+    if (fds[1].revents & POLLIN) {
+        // Drain the wake-ups so a later wait blocks again
+        char drain[64];
+        while (read(m_Impl->wakeFds[0], drain, sizeof(drain)) > 0) {}
+        return false;
+    }
+    // After a hang-up, output still unread is read before reading fails
+    return (fds[0].revents & (POLLIN | POLLHUP)) != 0;
+}
+
+void Pty::CancelWait() {
+    if (m_Impl->wakeFds[1] >= 0) {
+        const char wake = 1;
+        (void)write(m_Impl->wakeFds[1], &wake, 1);
+    }
+}
+
 bool Pty::Write(const char* data, size_t size) {
     if (m_Impl->masterFd < 0) return false;
     
+    // A program not reading its input fills the PTY; what it has not taken
+    // within the timeout is dropped rather than waited for
     size_t written = 0;
     while (written < size) {
         ssize_t n = write(m_Impl->masterFd, data + written, size - written);
         if (n < 0) {
-            if (errno == EAGAIN || errno == EWOULDBLOCK) {
-                continue;
-            }
-            return false;
+            if (errno == EINTR) continue;
+            if (errno != EAGAIN && errno != EWOULDBLOCK) return false;
+            struct pollfd fd = {m_Impl->masterFd, POLLOUT, 0};
+            int ready;
+            while ((ready = poll(&fd, 1, WRITE_TIMEOUT_MS)) < 0 && errno == EINTR) {}
+            if (ready <= 0 || !(fd.revents & POLLOUT)) return false;
+            continue;
         }
         written += static_cast<size_t>(n);
     }
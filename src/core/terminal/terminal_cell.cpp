@@ -0,0 +1,59 @@
+#include "terminal_cell.h"
+#include <algorithm>
+#include <functional>
+
+namespace sol {
+
+size_t TerminalStyleTable::Hash::operator()(const TerminalAttr& attr) const {
+    const uint64_t flags = static_cast<uint64_t>(attr.bold) | static_cast<uint64_t>(attr.italic) << 1 |
+                           static_cast<uint64_t>(attr.underline) << 2 | static_cast<uint64_t>(attr.strikethrough) << 3 |
+                           static_cast<uint64_t>(attr.inverse) << 4 | static_cast<uint64_t>(attr.dim) << 5;
+    const uint64_t colors = static_cast<uint64_t>(attr.fg) << 32 | attr.bg;
+    return std::hash<uint64_t>{}(colors ^ (flags * 0x9E3779B97F4A7C15ull));
+}
+
+TerminalStyleTable::TerminalStyleTable(const TerminalAttr& defaultAttr) {
+    m_Styles.push_back(defaultAttr);
+    m_Lookup.emplace(defaultAttr, Default);
+}
+
+std::optional<uint32_t> TerminalStyleTable::Find(const TerminalAttr& attr) const {
+    auto it = m_Lookup.find(attr);
+    if (it == m_Lookup.end()) return std::nullopt;
+    return it->second;
+}
+
+uint32_t TerminalStyleTable::Add(const TerminalAttr& attr) {
+    const auto style = static_cast<uint32_t>(m_Styles.size());
+    m_Styles.push_back(attr);
+    m_Lookup.emplace(attr, style);
+    return style;
+}
+
+std::vector<uint32_t> TerminalStyleTable::Compact(const std::vector<bool>& used) {
+    std::vector<uint32_t> remap(m_Styles.size(), Default);
+    std::vector<TerminalAttr> kept{m_Styles[Default]};
+    m_Lookup.clear();
+    m_Lookup.emplace(kept.front(), Default);
+    for (size_t style = 1; style < m_Styles.size(); ++style) {
+        if (!used[style]) continue;
+        remap[style] = static_cast<uint32_t>(kept.size());
+        m_Lookup.emplace(m_Styles[style], remap[style]);
+        kept.push_back(m_Styles[style]);
+    }
+    m_Styles = std::move(kept);
+    // Styles still in use set the bar for the next compaction, so a screen
+    // of many live styles is not rescanned for every new one
+    m_CompactAt = std::max(MinCompactAt, m_Styles.size() * 2);
+    return remap;
+}
+
+void TerminalStyleTable::SetDefault(const TerminalAttr& attr) {
+    if (m_Styles[Default] == attr) return;
+    auto it = m_Lookup.find(m_Styles[Default]);
+    if (it != m_Lookup.end() && it->second == Default) m_Lookup.erase(it);
+    m_Styles[Default] = attr;
+    m_Lookup.insert_or_assign(attr, Default);
+}
+
+} // namespace sol
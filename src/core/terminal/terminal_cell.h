@@ -0,0 +1,92 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <unordered_map>
+#include <vector>
+
+namespace sol {
+
+// Terminal cell attributes
+struct TerminalAttr {
+    uint32_t fg = 0xFFCCCCCC;  // Foreground color (ARGB)
+    uint32_t bg = 0xFF1E1E1E;  // Background color (ARGB)
+    bool bold = false;
+    bool italic = false;
+    bool underline = false;
+    bool strikethrough = false;
+    bool inverse = false;
+    bool dim = false;
+
+    bool operator==(const TerminalAttr& other) const {
+        return fg == other.fg && bg == other.bg && bold == other.bold &&
+               italic == other.italic && underline == other.underline &&
+               strikethrough == other.strikethrough && inverse == other.inverse &&
+               dim == other.dim;
+    }
+};
+
+// A single cell in the terminal grid; its attributes live in the
+// terminal's TerminalStyleTable
+struct TerminalCell {
+    char32_t codepoint = ' ';
+    uint32_t style = 0;  // Index into the style table, 0 the default
+
+    bool operator==(const TerminalCell& other) const = default;
+};
+
+static_assert(sizeof(TerminalCell) == 8);
+
+// A line of the grid or scrollback, valid until the terminal next changes.
+// Scrollback lines stop at their last cell that is not a default blank.
+struct TerminalLine {
+    std::span<const TerminalCell> cells;
+    bool wrapped = false;  // True if line continues to next (soft wrap), false if hard newline
+    // Renewed whenever the cells change and unique within the terminal, so
+    // lines of equal generation look alike; 0 for no line
+    uint64_t generation = 0;
+
+    size_t size() const { return cells.size(); }
+    bool empty() const { return cells.empty(); }
+    const TerminalCell& operator[](size_t i) const { return cells[i]; }
+    auto begin() const { return cells.begin(); }
+    auto end() const { return cells.end(); }
+};
+
+// The distinct attribute sets of one terminal. Cells refer to them by
+// index, so a screen of mostly identical attributes stores each once.
+class TerminalStyleTable {
+public:
+    static constexpr uint32_t Default = 0;
+
+    explicit TerminalStyleTable(const TerminalAttr& defaultAttr);
+
+    const TerminalAttr& Get(uint32_t style) const { return m_Styles[style]; }
+    size_t GetSize() const { return m_Styles.size(); }
+
+    std::optional<uint32_t> Find(const TerminalAttr& attr) const;
+    uint32_t Add(const TerminalAttr& attr);
+    // Set once the table has grown enough that unused styles should be dropped
+    bool IsFull() const { return m_Styles.size() >= m_CompactAt; }
+    // Keeps the default and the styles marked used, returning each old
+    // index's new one
+    std::vector<uint32_t> Compact(const std::vector<bool>& used);
+
+    // Changes what the default style looks like, and so every cell in it
+    void SetDefault(const TerminalAttr& attr);
+
+private:
+    static constexpr size_t MinCompactAt = 4096;
+
+    struct Hash {
+        size_t operator()(const TerminalAttr& attr) const;
+    };
+
+    std::vector<TerminalAttr> m_Styles;
+    std::unordered_map<TerminalAttr, uint32_t, Hash> m_Lookup;
+    size_t m_CompactAt = MinCompactAt;
+};
+
+} // namespace sol
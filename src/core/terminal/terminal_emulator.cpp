@@ -1,13 +1,15 @@
 #include "terminal_emulator.h"
+#include "core/frame_scheduler.h"
+#include "core/profiler.h"
+#include "core/text/text_scan.h"
 #include <algorithm>
 #include <cstring>
-#include <chrono>
 
 namespace sol {
 
-// Static empty instances for bounds checking
-TerminalLine TerminalEmulator::s_EmptyLine;
+// Static empty instance for bounds checking
 TerminalCell TerminalEmulator::s_EmptyCell;
+std::atomic<uint64_t> TerminalEmulator::s_BytesReceived{0};
 
 // Color palette initialization
 TerminalPalette::TerminalPalette() {
@@ -64,64 +66,132 @@ void TerminalPalette::SetColor(int index, uint32_t color) {
 }
 
 // Terminal Emulator implementation
-TerminalEmulator::TerminalEmulator(int rows, int cols)
-    : m_Rows(rows), m_Cols(cols) {
+TerminalEmulator::TerminalEmulator(int rows, int cols, size_t scrollback, size_t historyBytes)
+    : m_Grid(rows, cols, scrollback), m_History(historyBytes), m_Styles(TerminalAttr{}), m_Rows(rows), m_Cols(cols) {
+    m_Grid.SetScrollbackOverflow([this](const TerminalLine& line) { m_History.Append(line, m_Styles); });
     
     m_DefaultAttr.fg = m_Palette.GetColor(7);   // Default white
     m_DefaultAttr.bg = m_Palette.GetColor(0);   // Default black
     m_CurrentAttr = m_DefaultAttr;
+    m_Styles.SetDefault(m_DefaultAttr);
     
     m_ScrollTop = 0;
     m_ScrollBottom = m_Rows - 1;
-    
-    // Initialize screen buffer
-    m_Screen.resize(static_cast<size_t>(rows));
-    for (auto& line : m_Screen) {
-        line.resize(static_cast<size_t>(cols));
-        for (auto& cell : line) {
-            cell.attr = m_DefaultAttr;
-        }
-    }
-    
-    // Initialize empty line for bounds checking
-    s_EmptyLine.resize(static_cast<size_t>(cols));
 }
 
-TerminalEmulator::~TerminalEmulator() = default;
+TerminalEmulator::~TerminalEmulator() {
+    StopReader();
+}
 
 void TerminalEmulator::UpdateDefaultColors(uint32_t fg, uint32_t bg) {
+    if (m_DefaultAttr.fg == fg && m_DefaultAttr.bg == bg) return;
+    const TerminalAttr previous = m_DefaultAttr;
     m_DefaultAttr.fg = fg;
     m_DefaultAttr.bg = bg;
+    // Cells drawn in the default style follow the theme
+    m_Styles.SetDefault(m_DefaultAttr);
+    if (m_CurrentAttr == previous) {
+        m_CurrentAttr = m_DefaultAttr;
+    }
+    UpdateCurrentStyle();
+    MarkDirty();
+}
+
+void TerminalEmulator::UpdateCurrentStyle() {
+    m_CurrentStyle = StyleOf(m_CurrentAttr);
+}
+
+uint32_t TerminalEmulator::StyleOf(const TerminalAttr& attr) {
+    if (auto style = m_Styles.Find(attr)) {
+        return *style;
+    }
+    if (m_Styles.IsFull()) {
+        CompactStyles();
+    }
+    return m_Styles.Add(attr);
+}
+
+void TerminalEmulator::CompactStyles() {
+    std::vector<bool> used(m_Styles.GetSize());
+    m_Grid.ForEachCell([&](const TerminalCell& cell) { used[cell.style] = true; });
+    used[m_CurrentStyle] = true;
+    const std::vector<uint32_t> remap = m_Styles.Compact(used);
+    m_Grid.ForEachCell([&](TerminalCell& cell) { cell.style = remap[cell.style]; });
+    m_CurrentStyle = remap[m_CurrentStyle];
+    // The history keeps attributes, not styles, and decodes again
+    m_History.ForgetDecoded();
 }
 
 void TerminalEmulator::AttachPty(std::shared_ptr<Pty> pty) {
+    StopReader();
     m_Pty = pty;
     if (m_Pty) {
         m_Pty->Resize(m_Rows, m_Cols);
+        m_StopReading = false;
+        m_Reader = std::thread(&TerminalEmulator::ReadLoop, this);
     }
 }
 
-void TerminalEmulator::ProcessInput() {
-    if (!m_Pty) return;
-    
-    char buffer[4096];
-    
-    // Time-based limiting: spend max 2ms processing per frame
-    // This prevents UI freeze while still being responsive
-    auto startTime = std::chrono::steady_clock::now();
-    const auto maxDuration = std::chrono::microseconds(2000);
+std::unique_lock<std::mutex> TerminalEmulator::Lock() const {
+    m_LockWaiters.fetch_add(1, std::memory_order_relaxed);
+    std::unique_lock<std::mutex> lock(m_Mutex);
+    m_LockWaiters.fetch_sub(1, std::memory_order_relaxed);
+    return lock;
+}
+
+void TerminalEmulator::StopReader() {
+    if (!m_Reader.joinable()) return;
+    m_StopReading = true;
+    m_Pty->CancelWait();
+    m_Reader.join();
+}
+
+void TerminalEmulator::ReadLoop() {
+    SOL_PROFILE_THREAD("Terminal reader");
     
-    int n;
-    while ((n = m_Pty->Read(buffer, sizeof(buffer))) > 0) {
-        for (int i = 0; i < n; i++) {
-            ProcessByte(static_cast<uint8_t>(buffer[i]));
+    // Parsing runs here rather than in the frame, so output is taken as
+    // fast as the program writes it however often the UI draws
+    std::vector<char> buffer(64 * 1024);
+    std::string replies;
+    while (!m_StopReading && m_Pty->WaitForOutput()) {
+        const int n = m_Pty->Read(buffer.data(), buffer.size());
+        if (n < 0) break;
+        if (n == 0) continue;
+        s_BytesReceived.fetch_add(static_cast<uint64_t>(n), std::memory_order_relaxed);
+        {
+            SOL_PROFILE_ZONE("TerminalEmulator::ProcessOutput");
+            std::lock_guard<std::mutex> lock(m_Mutex);
+            ProcessOutput(std::string_view(buffer.data(), static_cast<size_t>(n)));
+            replies.swap(m_Replies);
         }
-        
-        // Check if we've exceeded our time budget
-        auto elapsed = std::chrono::steady_clock::now() - startTime;
-        if (elapsed > maxDuration) {
-            break;
+        // Written unlocked, as a program not reading its input would block them
+        if (!replies.empty()) {
+            m_Pty->Write(replies);
+            replies.clear();
+        }
+        FrameScheduler::GetInstance().RequestFrame();
+        // During a flood the next chunk is always ready; let a waiting
+        // frame in first
+        while (m_LockWaiters.load(std::memory_order_relaxed) > 0) {
+            std::this_thread::yield();
+        }
+    }
+    // The widget closes once it sees the program gone
+    FrameScheduler::GetInstance().RequestFrame();
+}
+
+void TerminalEmulator::ProcessOutput(std::string_view data) {
+    m_Replies.clear();
+    size_t i = 0;
+    while (i < data.size()) {
+        // Printable runs bypass the state machine, which still takes escape
+        // sequences, control characters and UTF-8 cut short by a run's end
+        if (m_ParseState == ParseState::Normal && m_UTF8Remaining == 0) {
+            const std::string_view rest = data.substr(i);
+            i += PutText(rest.substr(0, FindControl(rest)));
+            if (i == data.size()) break;
         }
+        ProcessByte(static_cast<uint8_t>(data[i++]));
     }
 }
 
@@ -263,115 +333,7 @@ void TerminalEmulator::HandleChar(char32_t c) {
 void TerminalEmulator::Resize(int rows, int cols) {
     if (rows == m_Rows && cols == m_Cols) return;
     
-    int oldCols = m_Cols;
-    int oldRows = m_Rows;
-    
-    // Only reflow if width changed
-    if (cols != oldCols) {
-        // Collect all content as logical lines (joined wrapped sequences)
-        std::vector<std::vector<TerminalCell>> logicalLines;
-        
-        // Process scrollback first
-        std::vector<TerminalCell> currentLogical;
-        for (auto& line : m_Scrollback) {
-            for (auto& cell : line.cells) {
-                currentLogical.push_back(cell);
-            }
-            if (!line.wrapped) {
-                logicalLines.push_back(std::move(currentLogical));
-                currentLogical.clear();
-            }
-        }
-        
-        // Then process screen
-        for (auto& line : m_Screen) {
-            for (auto& cell : line.cells) {
-                currentLogical.push_back(cell);
-            }
-            if (!line.wrapped) {
-                logicalLines.push_back(std::move(currentLogical));
-                currentLogical.clear();
-            }
-        }
-        
-        // Handle any remaining content
-        if (!currentLogical.empty()) {
-            logicalLines.push_back(std::move(currentLogical));
-        }
-        
-        // Rewrap to new width and rebuild buffers
-        m_Scrollback.clear();
-        m_Screen.clear();
-        
-        std::vector<TerminalLine> wrappedLines;
-        for (auto& logical : logicalLines) {
-            // Trim trailing spaces
-            while (!logical.empty() && logical.back().codepoint == ' ') {
-                logical.pop_back();
-            }
-            
-            if (logical.empty()) {
-                // Empty line
-                TerminalLine newLine;
-                newLine.cells.resize(static_cast<size_t>(cols));
-                for (auto& cell : newLine.cells) {
-                    cell.codepoint = ' ';
-                    cell.attr = m_DefaultAttr;
-                }
-                newLine.wrapped = false;
-                wrappedLines.push_back(std::move(newLine));
-            } else {
-                // Wrap to new width
-                size_t pos = 0;
-                while (pos < logical.size()) {
-                    TerminalLine newLine;
-                    newLine.cells.resize(static_cast<size_t>(cols));
-                    
-                    size_t lineLen = std::min(static_cast<size_t>(cols), logical.size() - pos);
-                    for (size_t i = 0; i < lineLen; i++) {
-                        newLine.cells[i] = logical[pos + i];
-                    }
-                    for (size_t i = lineLen; i < static_cast<size_t>(cols); i++) {
-                        newLine.cells[i].codepoint = ' ';
-                        newLine.cells[i].attr = m_DefaultAttr;
-                    }
-                    
-                    pos += lineLen;
-                    newLine.wrapped = (pos < logical.size());  // More content follows
-                    wrappedLines.push_back(std::move(newLine));
-                }
-            }
-        }
-        
-        // Distribute lines between scrollback and screen
-        // Keep last 'rows' lines on screen, rest goes to scrollback
-        if (wrappedLines.size() <= static_cast<size_t>(rows)) {
-            // All fits on screen
-            m_Screen = std::move(wrappedLines);
-        } else {
-            // Split between scrollback and screen
-            size_t scrollbackCount = wrappedLines.size() - static_cast<size_t>(rows);
-            for (size_t i = 0; i < scrollbackCount && i < MaxScrollback; i++) {
-                m_Scrollback.push_back(std::move(wrappedLines[i]));
-            }
-            for (size_t i = scrollbackCount; i < wrappedLines.size(); i++) {
-                m_Screen.push_back(std::move(wrappedLines[i]));
-            }
-        }
-    }
-    
-    // Ensure screen has exactly 'rows' lines
-    m_Screen.resize(static_cast<size_t>(rows));
-    for (auto& line : m_Screen) {
-        line.cells.resize(static_cast<size_t>(cols));
-        for (auto& cell : line.cells) {
-            if (cell.codepoint == 0) {
-                cell.codepoint = ' ';
-                cell.attr = m_DefaultAttr;
-                cell.dirty = true;
-            }
-        }
-    }
+    m_Grid.Resize(rows, cols);
     
     // Adjust cursor
     m_CursorRow = std::min(m_CursorRow, rows - 1);
@@ -384,30 +346,38 @@ void TerminalEmulator::Resize(int rows, int cols) {
     m_Rows = rows;
     m_Cols = cols;
     
-    // Resize empty line
-    s_EmptyLine.cells.resize(static_cast<size_t>(cols));
-    
     // Notify PTY
     if (m_Pty) {
         m_Pty->Resize(rows, cols);
     }
-    
-    MarkDirty();
 }
 
-const TerminalLine& TerminalEmulator::GetLine(int row) const {
-    if (row < 0 || row >= m_Rows) return s_EmptyLine;
-    return m_Screen[static_cast<size_t>(row)];
+TerminalLine TerminalEmulator::GetLine(int row) const {
+    if (row < 0 || row >= m_Rows) return {};
+    return m_Grid.GetLine(row);
 }
 
 const TerminalCell& TerminalEmulator::GetCell(int row, int col) const {
     if (row < 0 || row >= m_Rows || col < 0 || col >= m_Cols) return s_EmptyCell;
-    return m_Screen[static_cast<size_t>(row)][static_cast<size_t>(col)];
+    return m_Grid.GetLine(row)[static_cast<size_t>(col)];
 }
 
-const TerminalLine& TerminalEmulator::GetScrollbackLine(size_t index) const {
-    if (index >= m_Scrollback.size()) return s_EmptyLine;
-    return m_Scrollback[index];
+TerminalLine TerminalEmulator::GetScrollbackLine(size_t index) {
+    if (index < m_History.GetSize()) {
+        return m_History.GetLine(index, [this](const TerminalAttr& attr) { return StyleOf(attr); });
+    }
+    index -= m_History.GetSize();
+    if (index >= m_Grid.GetScrollbackSize()) return {};
+    return m_Grid.GetScrollbackLine(index);
+}
+
+TerminalHistory::Snapshot TerminalEmulator::TakeSearchSnapshot() const {
+    TerminalHistory::Snapshot snapshot = m_History.TakeSnapshot();
+    for (size_t index = 0; index < m_Grid.GetScrollbackSize(); ++index) {
+        TerminalHistory::AppendText(m_Grid.GetScrollbackLine(index), snapshot.tail);
+    }
+    for (int row = 0; row < m_Rows; ++row) TerminalHistory::AppendText(m_Grid.GetLine(row), snapshot.tail);
+    return snapshot;
 }
 
 void TerminalEmulator::SetSelection(int startRow, int startCol, int endRow, int endCol) {
@@ -440,7 +410,7 @@ std::string TerminalEmulator::GetSelectedText() const {
         int colStart = (row == sr) ? sc : 0;
         int colEnd = (row == er) ? ec : m_Cols - 1;
         
-        const auto& line = GetLine(row);
+        const TerminalLine line = GetLine(row);
         for (int col = colStart; col <= colEnd && col < static_cast<int>(line.size()); col++) {
             char32_t c = line[static_cast<size_t>(col)].codepoint;
             if (c < 0x80) {
@@ -454,22 +424,6 @@ std::string TerminalEmulator::GetSelectedText() const {
     return result;
 }
 
-void TerminalEmulator::MarkDirty() {
-    for (auto& line : m_Screen) {
-        for (auto& cell : line) {
-            cell.dirty = true;
-        }
-    }
-}
-
-void TerminalEmulator::ClearDirty() {
-    for (auto& line : m_Screen) {
-        for (auto& cell : line) {
-            cell.dirty = false;
-        }
-    }
-}
-
 bool TerminalEmulator::IsAlive() const {
     return m_Pty && m_Pty->IsAlive();
 }
@@ -772,12 +726,7 @@ void TerminalEmulator::ExecuteCSI(char finalByte) {
             break;
             
         case 'X':  // ECH - Erase Characters
-            for (int i = 0; i < param0 && m_CursorCol + i < m_Cols; i++) {
-                auto& cell = m_Screen[static_cast<size_t>(m_CursorRow)][static_cast<size_t>(m_CursorCol + i)];
-                cell.codepoint = ' ';
-                cell.attr = m_CurrentAttr;
-                cell.dirty = true;
-            }
+            m_Grid.Fill(m_CursorRow, m_CursorCol, m_CursorCol + param0, Blank(m_CurrentStyle));
             break;
             
         case '@':  // ICH - Insert Characters
@@ -804,8 +753,7 @@ void TerminalEmulator::ExecuteCSI(char finalByte) {
         case 'n':  // DSR - Device Status Report
             if (param0 == 6) {
                 // Report cursor position
-                std::string response = "\033[" + std::to_string(m_CursorRow + 1) + ";" + std::to_string(m_CursorCol + 1) + "R";
-                Write(response);
+                m_Replies += "\033[" + std::to_string(m_CursorRow + 1) + ";" + std::to_string(m_CursorCol + 1) + "R";
             }
             break;
             
@@ -826,7 +774,7 @@ void TerminalEmulator::ExecuteCSI(char finalByte) {
             
         case 'c':  // DA - Device Attributes
             // Report as VT100 with no options
-            Write("\033[?1;0c");
+            m_Replies += "\033[?1;0c";
             break;
     }
 }
@@ -858,7 +806,7 @@ void TerminalEmulator::PutChar(char32_t c) {
     if (m_CursorCol >= m_Cols) {
         if (m_AutoWrap) {
             // Mark current line as wrapped (soft wrap, not hard newline)
-            m_Screen[static_cast<size_t>(m_CursorRow)].wrapped = true;
+            m_Grid.SetWrapped(m_CursorRow, true);
             CarriageReturn();
             Newline();
         } else {
@@ -866,14 +814,62 @@ void TerminalEmulator::PutChar(char32_t c) {
         }
     }
     
-    auto& cell = m_Screen[static_cast<size_t>(m_CursorRow)].cells[static_cast<size_t>(m_CursorCol)];
+    auto& cell = m_Grid.Row(m_CursorRow)[m_CursorCol];
     cell.codepoint = c;
-    cell.attr = m_CurrentAttr;
-    cell.dirty = true;
+    cell.style = m_CurrentStyle;
+    m_Grid.Touch(m_CursorRow);
     
     m_CursorCol++;
 }
 
+size_t TerminalEmulator::PutText(std::string_view text) {
+    TerminalCell* row = m_Grid.Row(m_CursorRow);
+    bool touched = false;
+    size_t i = 0;
+    while (i < text.size()) {
+        const auto byte = static_cast<uint8_t>(text[i]);
+        char32_t codepoint = byte;
+        if (byte < 0x80) {
+            ++i;
+        } else {
+            // Invalid leads and sequences are dropped as ProcessByte drops them
+            const size_t length = (byte & 0xE0) == 0xC0 ? 2 : (byte & 0xF0) == 0xE0 ? 3 : (byte & 0xF8) == 0xF0 ? 4 : 0;
+            if (length == 0) {
+                ++i;
+                continue;
+            }
+            if (i + length > text.size()) break;
+            codepoint = byte & (0x7F >> length);
+            size_t next = i + 1;
+            for (; next < i + length && (static_cast<uint8_t>(text[next]) & 0xC0) == 0x80; ++next) {
+                codepoint = (codepoint << 6) | (static_cast<uint8_t>(text[next]) & 0x3F);
+            }
+            const bool complete = next == i + length;
+            i = next;
+            if (!complete) continue;
+        }
+
+        // As PutChar does
+        if (m_CursorCol >= m_Cols) {
+            if (m_AutoWrap) {
+                m_Grid.SetWrapped(m_CursorRow, true);
+                CarriageReturn();
+                Newline();
+                row = m_Grid.Row(m_CursorRow);
+                touched = false;
+            } else {
+                m_CursorCol = m_Cols - 1;
+            }
+        }
+        if (!touched) {
+            m_Grid.Touch(m_CursorRow);
+            touched = true;
+        }
+        row[m_CursorCol++] = {codepoint, m_CurrentStyle};
+    }
+    return i;
+}
+
 void TerminalEmulator::Newline() {
     if (m_CursorRow == m_ScrollBottom) {
         ScrollUp();
@@ -927,49 +923,12 @@ void TerminalEmulator::MoveCursorRight(int n) {
 }
 
 void TerminalEmulator::ScrollUp(int n) {
-    for (int i = 0; i < n; i++) {
-        // Move top line to scrollback
-        if (m_ScrollTop == 0) {
-            m_Scrollback.push_back(std::move(m_Screen[static_cast<size_t>(m_ScrollTop)]));
-            if (m_Scrollback.size() > MaxScrollback) {
-                m_Scrollback.pop_front();
-            }
-        }
-        
-        // Scroll region up
-        for (int row = m_ScrollTop; row < m_ScrollBottom; row++) {
-            m_Screen[static_cast<size_t>(row)] = std::move(m_Screen[static_cast<size_t>(row + 1)]);
-        }
-        
-        // Clear bottom line
-        m_Screen[static_cast<size_t>(m_ScrollBottom)].clear();
-        m_Screen[static_cast<size_t>(m_ScrollBottom)].resize(static_cast<size_t>(m_Cols));
-        for (auto& cell : m_Screen[static_cast<size_t>(m_ScrollBottom)]) {
-            cell.attr = m_DefaultAttr;
-            cell.dirty = true;
-        }
-    }
-    
-    MarkDirty();
+    // Lines scrolled off the top of the screen are kept in scrollback
+    m_Grid.ScrollUp(m_ScrollTop, m_ScrollBottom, n, m_ScrollTop == 0, Blank(TerminalStyleTable::Default));
 }
 
 void TerminalEmulator::ScrollDown(int n) {
-    for (int i = 0; i < n; i++) {
-        // Scroll region down
-        for (int row = m_ScrollBottom; row > m_ScrollTop; row--) {
-            m_Screen[static_cast<size_t>(row)] = std::move(m_Screen[static_cast<size_t>(row - 1)]);
-        }
-        
-        // Clear top line
-        m_Screen[static_cast<size_t>(m_ScrollTop)].clear();
-        m_Screen[static_cast<size_t>(m_ScrollTop)].resize(static_cast<size_t>(m_Cols));
-        for (auto& cell : m_Screen[static_cast<size_t>(m_ScrollTop)]) {
-            cell.attr = m_DefaultAttr;
-            cell.dirty = true;
-        }
-    }
-    
-    MarkDirty();
+    m_Grid.ScrollDown(m_ScrollTop, m_ScrollBottom, n, Blank(TerminalStyleTable::Default));
 }
 
 void TerminalEmulator::EraseInDisplay(int mode) {
@@ -977,44 +936,31 @@ void TerminalEmulator::EraseInDisplay(int mode) {
         case 0:  // Erase from cursor to end of display
             EraseInLine(0);
             for (int row = m_CursorRow + 1; row < m_Rows; row++) {
-                for (auto& cell : m_Screen[static_cast<size_t>(row)]) {
-                    cell.codepoint = ' ';
-                    cell.attr = m_CurrentAttr;
-                    cell.dirty = true;
-                }
+                m_Grid.Fill(row, 0, m_Cols, Blank(m_CurrentStyle));
             }
             break;
             
         case 1:  // Erase from start of display to cursor
             for (int row = 0; row < m_CursorRow; row++) {
-                for (auto& cell : m_Screen[static_cast<size_t>(row)]) {
-                    cell.codepoint = ' ';
-                    cell.attr = m_CurrentAttr;
-                    cell.dirty = true;
-                }
+                m_Grid.Fill(row, 0, m_Cols, Blank(m_CurrentStyle));
             }
             EraseInLine(1);
             break;
             
         case 2:  // Erase entire display
         case 3:  // Erase entire display with scrollback
-            for (auto& line : m_Screen) {
-                for (auto& cell : line) {
-                    cell.codepoint = ' ';
-                    cell.attr = m_CurrentAttr;
-                    cell.dirty = true;
-                }
+            for (int row = 0; row < m_Rows; row++) {
+                m_Grid.Fill(row, 0, m_Cols, Blank(m_CurrentStyle));
             }
             if (mode == 3) {
-                m_Scrollback.clear();
+                m_History.Clear(m_Grid.GetScrollbackSize());
+                m_Grid.ClearScrollback();
             }
             break;
     }
 }
 
 void TerminalEmulator::EraseInLine(int mode) {
-    auto& line = m_Screen[static_cast<size_t>(m_CursorRow)];
-    
     int start = 0, end = m_Cols;
     switch (mode) {
         case 0: start = m_CursorCol; break;  // From cursor to end
@@ -1022,76 +968,32 @@ void TerminalEmulator::EraseInLine(int mode) {
         case 2: break;  // Entire line
     }
     
-    for (int col = start; col < end; col++) {
-        auto& cell = line[static_cast<size_t>(col)];
-        cell.codepoint = ' ';
-        cell.attr = m_CurrentAttr;
-        cell.dirty = true;
-    }
+    m_Grid.Fill(m_CursorRow, start, end, Blank(m_CurrentStyle));
 }
 
 void TerminalEmulator::DeleteChars(int n) {
-    auto& line = m_Screen[static_cast<size_t>(m_CursorRow)];
-    
-    for (int col = m_CursorCol; col < m_Cols - n; col++) {
-        line[static_cast<size_t>(col)] = line[static_cast<size_t>(col + n)];
-        line[static_cast<size_t>(col)].dirty = true;
-    }
-    
-    for (int col = m_Cols - n; col < m_Cols; col++) {
-        auto& cell = line[static_cast<size_t>(col)];
-        cell.codepoint = ' ';
-        cell.attr = m_CurrentAttr;
-        cell.dirty = true;
-    }
+    n = std::min(n, m_Cols - m_CursorCol);
+    TerminalCell* line = m_Grid.Row(m_CursorRow);
+    std::copy(line + m_CursorCol + n, line + m_Cols, line + m_CursorCol);
+    m_Grid.Fill(m_CursorRow, m_Cols - n, m_Cols, Blank(m_CurrentStyle));
 }
 
 void TerminalEmulator::InsertChars(int n) {
-    auto& line = m_Screen[static_cast<size_t>(m_CursorRow)];
-    
-    for (int col = m_Cols - 1; col >= m_CursorCol + n; col--) {
-        line[static_cast<size_t>(col)] = line[static_cast<size_t>(col - n)];
-        line[static_cast<size_t>(col)].dirty = true;
-    }
-    
-    for (int col = m_CursorCol; col < m_CursorCol + n && col < m_Cols; col++) {
-        auto& cell = line[static_cast<size_t>(col)];
-        cell.codepoint = ' ';
-        cell.attr = m_CurrentAttr;
-        cell.dirty = true;
-    }
+    n = std::min(n, m_Cols - m_CursorCol);
+    TerminalCell* line = m_Grid.Row(m_CursorRow);
+    std::copy_backward(line + m_CursorCol, line + m_Cols - n, line + m_Cols);
+    m_Grid.Fill(m_CursorRow, m_CursorCol, m_CursorCol + n, Blank(m_CurrentStyle));
 }
 
+// Both only act within the scroll region
 void TerminalEmulator::DeleteLines(int n) {
-    for (int i = 0; i < n; i++) {
-        for (int row = m_CursorRow; row < m_ScrollBottom; row++) {
-            m_Screen[static_cast<size_t>(row)] = std::move(m_Screen[static_cast<size_t>(row + 1)]);
-        }
-        
-        m_Screen[static_cast<size_t>(m_ScrollBottom)].clear();
-        m_Screen[static_cast<size_t>(m_ScrollBottom)].resize(static_cast<size_t>(m_Cols));
-        for (auto& cell : m_Screen[static_cast<size_t>(m_ScrollBottom)]) {
-            cell.attr = m_DefaultAttr;
-            cell.dirty = true;
-        }
-    }
-    MarkDirty();
+    if (m_CursorRow < m_ScrollTop || m_CursorRow > m_ScrollBottom) return;
+    m_Grid.ScrollUp(m_CursorRow, m_ScrollBottom, n, false, Blank(TerminalStyleTable::Default));
 }
 
 void TerminalEmulator::InsertLines(int n) {
-    for (int i = 0; i < n; i++) {
-        for (int row = m_ScrollBottom; row > m_CursorRow; row--) {
-            m_Screen[static_cast<size_t>(row)] = std::move(m_Screen[static_cast<size_t>(row - 1)]);
-        }
-        
-        m_Screen[static_cast<size_t>(m_CursorRow)].clear();
-        m_Screen[static_cast<size_t>(m_CursorRow)].resize(static_cast<size_t>(m_Cols));
-        for (auto& cell : m_Screen[static_cast<size_t>(m_CursorRow)]) {
-            cell.attr = m_DefaultAttr;
-            cell.dirty = true;
-        }
-    }
-    MarkDirty();
+    if (m_CursorRow < m_ScrollTop || m_CursorRow > m_ScrollBottom) return;
+    m_Grid.ScrollDown(m_CursorRow, m_ScrollBottom, n, Blank(TerminalStyleTable::Default));
 }
 
 void TerminalEmulator::SetScrollRegion(int top, int bottom) {
@@ -1210,6 +1112,7 @@ void TerminalEmulator::SetGraphicsRendition() {
                 break;
         }
     }
+    UpdateCurrentStyle();
 }
 
 void TerminalEmulator::SetCursorVisibility(bool visible) {
@@ -1223,9 +1126,11 @@ void TerminalEmulator::SaveCursor() {
 }
 
 void TerminalEmulator::RestoreCursor() {
-    m_CursorRow = m_SavedCursorRow;
-    m_CursorCol = m_SavedCursorCol;
+    // The terminal may have shrunk since
+    m_CursorRow = std::min(m_SavedCursorRow, m_Rows - 1);
+    m_CursorCol = std::min(m_SavedCursorCol, m_Cols - 1);
     m_CurrentAttr = m_SavedAttr;
+    UpdateCurrentStyle();
 }
 
 void TerminalEmulator::Reset() {
@@ -1233,6 +1138,7 @@ void TerminalEmulator::Reset() {
     m_CursorCol = 0;
     m_CursorVisible = true;
     m_CurrentAttr = m_DefaultAttr;
+    m_CurrentStyle = TerminalStyleTable::Default;
     m_ScrollTop = 0;
     m_ScrollBottom = m_Rows - 1;
     m_AutoWrap = true;
@@ -1242,12 +1148,8 @@ void TerminalEmulator::Reset() {
     m_ApplicationKeypad = false;
     m_Title.clear();
     
-    for (auto& line : m_Screen) {
-        for (auto& cell : line) {
-            cell.codepoint = ' ';
-            cell.attr = m_DefaultAttr;
-            cell.dirty = true;
-        }
+    for (int row = 0; row < m_Rows; row++) {
+        m_Grid.Fill(row, 0, m_Cols, Blank(TerminalStyleTable::Default));
     }
 }
 
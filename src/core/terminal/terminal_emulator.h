@@ -1,59 +1,19 @@
 #pragma once
 
 #include "pty.h"
+#include "terminal_grid.h"
+#include "terminal_history.h"
+#include <atomic>
 #include <string>
+#include <string_view>
 #include <vector>
-#include <deque>
 #include <memory>
+#include <mutex>
+#include <thread>
 #include <cstdint>
 
 namespace sol {
 
-// Terminal cell attributes
-struct TerminalAttr {
-    uint32_t fg = 0xFFCCCCCC;  // Foreground color (ARGB)
-    uint32_t bg = 0xFF1E1E1E;  // Background color (ARGB)
-    bool bold = false;
-    bool italic = false;
-    bool underline = false;
-    bool strikethrough = false;
-    bool inverse = false;
-    bool dim = false;
-    
-    bool operator==(const TerminalAttr& other) const {
-        return fg == other.fg && bg == other.bg && bold == other.bold &&
-               italic == other.italic && underline == other.underline &&
-               strikethrough == other.strikethrough && inverse == other.inverse &&
-               dim == other.dim;
-    }
-};
-
-// A single cell in the terminal grid
-struct TerminalCell {
-    char32_t codepoint = ' ';
-    TerminalAttr attr;
-    bool dirty = true;  // Needs redraw
-};
-
-// A line in the terminal with wrap tracking
-struct TerminalLine {
-    std::vector<TerminalCell> cells;
-    bool wrapped = false;  // True if line continues to next (soft wrap), false if hard newline
-    
-    // Convenience accessors to maintain compatibility
-    size_t size() const { return cells.size(); }
-    bool empty() const { return cells.empty(); }
-    void resize(size_t n) { cells.resize(n); }
-    void clear() { cells.clear(); wrapped = false; }
-    TerminalCell& operator[](size_t i) { return cells[i]; }
-    const TerminalCell& operator[](size_t i) const { return cells[i]; }
-    auto begin() { return cells.begin(); }
-    auto end() { return cells.end(); }
-    auto begin() const { return cells.begin(); }
-    auto end() const { return cells.end(); }
-    void push_back(const TerminalCell& c) { cells.push_back(c); }
-};
-
 // Terminal color palette (256 color)
 class TerminalPalette {
 public:
@@ -79,15 +39,30 @@ private:
 // Terminal emulator state machine and buffer
 class TerminalEmulator {
 public:
-    TerminalEmulator(int rows = 24, int cols = 80);
+    static constexpr size_t DefaultScrollback = 10000;
+    
+    // Keeps scrollback lines in memory, then those older in compressed
+    // temporary files up to historyBytes
+    TerminalEmulator(int rows = 24, int cols = 80, size_t scrollback = DefaultScrollback, size_t historyBytes = 0);
     ~TerminalEmulator();
     
-    // Connect to a PTY
+    // Connect to a PTY; a thread of the terminal's own reads and parses its
+    // output as it arrives, until the PTY hangs up or is detached
     void AttachPty(std::shared_ptr<Pty> pty);
     std::shared_ptr<Pty> GetPty() const { return m_Pty; }
     
-    // Process input from PTY
-    void ProcessInput();
+    // Parse output of the terminal's program, as the reader thread does with
+    // what it reads. Replies it asks for, such as cursor reports, are kept
+    // until the next call for the reader to write once it lets go of the lock.
+    void ProcessOutput(std::string_view data);
+    // Read from the PTYs of all terminals so far
+    static uint64_t GetBytesReceived() { return s_BytesReceived.load(std::memory_order_relaxed); }
+    
+    // Holds the terminal still against its reader thread. With a PTY
+    // attached, everything but Write, HandleKey and HandleChar is called
+    // under this lock; those write to the PTY, which may block until the
+    // program reads, so they must be called without it.
+    std::unique_lock<std::mutex> Lock() const;
     
     // Write to PTY (keyboard input)
     void Write(const std::string& data);
@@ -109,13 +84,21 @@ public:
     int GetCursorCol() const { return m_CursorCol; }
     bool IsCursorVisible() const { return m_CursorVisible; }
     
-    // Access screen buffer
-    const TerminalLine& GetLine(int row) const;
+    // Access screen buffer; lines are valid until the terminal next changes
+    TerminalLine GetLine(int row) const;
     const TerminalCell& GetCell(int row, int col) const;
-    
-    // Scrollback buffer
-    size_t GetScrollbackSize() const { return m_Scrollback.size(); }
-    const TerminalLine& GetScrollbackLine(size_t index) const;
+    // Attributes of a cell's style
+    const TerminalAttr& GetStyle(uint32_t style) const { return m_Styles.Get(style); }
+    
+    // Scrollback buffer, the history on disk first; lines are valid until
+    // the terminal next changes or reads another line
+    size_t GetScrollbackSize() const { return m_History.GetSize() + m_Grid.GetScrollbackSize(); }
+    TerminalLine GetScrollbackLine(size_t index);
+    // Number of scrollback line 0, counting every line dropped since the start
+    uint64_t GetScrollbackStart() const { return m_History.GetFirst(); }
+    // The text of the scrollback and screen, numbered from GetScrollbackStart,
+    // for a search without the lock
+    TerminalHistory::Snapshot TakeSearchSnapshot() const;
     
     // Selection
     void SetSelection(int startRow, int startCol, int endRow, int endCol);
@@ -123,11 +106,8 @@ public:
     bool HasSelection() const { return m_HasSelection; }
     std::string GetSelectedText() const;
     
-    // Mark all cells as dirty (force full redraw)
-    void MarkDirty();
-    
-    // Clear dirty flags
-    void ClearDirty();
+    // Give every screen row a new generation (force full redraw)
+    void MarkDirty() { m_Grid.MarkDirty(); }
     
     // Is the terminal alive?
     bool IsAlive() const;
@@ -166,8 +146,14 @@ private:
     void ExecuteCSI(char finalByte);
     void ExecuteOSC();
     
+    void ReadLoop();
+    void StopReader();
+    
     // Terminal operations
     void PutChar(char32_t c);
+    // Writes a run of printable UTF-8, stopping before a sequence the run
+    // cuts short; returns the bytes consumed
+    size_t PutText(std::string_view text);
     void Newline();
     void CarriageReturn();
     void Tab();
@@ -205,10 +191,18 @@ private:
     // Helper to convert ANSI color index to ARGB
     uint32_t AnsiToColor(int ansi, bool bright);
     
-    // Screen buffer
-    std::vector<TerminalLine> m_Screen;
-    std::deque<TerminalLine> m_Scrollback;
-    static constexpr size_t MaxScrollback = 10000;
+    static TerminalCell Blank(uint32_t style) { return {' ', style}; }
+    // The style of m_CurrentAttr, to be called whenever it changes
+    void UpdateCurrentStyle();
+    // Finds or adds the style of the attributes
+    uint32_t StyleOf(const TerminalAttr& attr);
+    // Drops styles no cell uses any more
+    void CompactStyles();
+    
+    // Screen and scrollback buffer
+    TerminalGrid m_Grid;
+    TerminalHistory m_History;
+    TerminalStyleTable m_Styles;
     
     // Dimensions
     int m_Rows;
@@ -231,12 +225,14 @@ private:
     // Current attributes
     TerminalAttr m_CurrentAttr;
     TerminalAttr m_DefaultAttr;
+    uint32_t m_CurrentStyle = TerminalStyleTable::Default;
     
     // Parse state
     ParseState m_ParseState = ParseState::Normal;
     std::vector<int> m_CSIParams;
     std::string m_CSIIntermediate;
     std::string m_OSCString;
+    std::string m_Replies;  // To the program, for this call of ProcessOutput
     int m_CurrentParam = 0;
     bool m_HasParam = false;
     
@@ -256,21 +252,27 @@ private:
     
     // PTY
     std::shared_ptr<Pty> m_Pty;
+    std::thread m_Reader;
+    std::atomic<bool> m_StopReading{false};
+    mutable std::mutex m_Mutex;
+    // Threads blocked in Lock, for the reader to step aside for
+    mutable std::atomic<int> m_LockWaiters{0};
     
     // Color palette
     TerminalPalette m_Palette;
     
     // Mode flags
     bool m_AlternateScreen = false;
-    bool m_ApplicationCursor = false;
+    std::atomic<bool> m_ApplicationCursor{false};  // Read by HandleKey outside the lock
     bool m_ApplicationKeypad = false;
     bool m_AutoWrap = true;
     bool m_OriginMode = false;
     bool m_InsertMode = false;
     
-    // Empty line for bounds checking
-    static TerminalLine s_EmptyLine;
+    // Empty cell for bounds checking
     static TerminalCell s_EmptyCell;
+    
+    static std::atomic<uint64_t> s_BytesReceived;
 };
 
 } // namespace sol
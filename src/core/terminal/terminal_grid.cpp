@@ -0,0 +1,122 @@
+#include "terminal_grid.h"
+#include <algorithm>
+#include <numeric>
+
+namespace sol {
+
+TerminalGrid::TerminalGrid(int rows, int cols, size_t maxScrollback)
+    : m_Rows(rows),
+      m_Cols(cols),
+      m_Order(static_cast<size_t>(rows)),
+      m_Cells(static_cast<size_t>(rows) * static_cast<size_t>(cols)),
+      m_Info(static_cast<size_t>(rows)),
+      m_Scrollback(maxScrollback) {
+    std::iota(m_Order.begin(), m_Order.end(), 0u);
+    MarkDirty();
+}
+
+TerminalLine TerminalGrid::GetLine(int row) const {
+    const uint32_t physical = m_Order[static_cast<size_t>(row)];
+    return {std::span<const TerminalCell>(Cells(physical), static_cast<size_t>(m_Cols)), m_Info[physical].wrapped,
+            m_Info[physical].generation};
+}
+
+void TerminalGrid::MarkDirty() {
+    for (RowInfo& info : m_Info) info.generation = ++m_Generation;
+}
+
+void TerminalGrid::Fill(int row, int start, int end, const TerminalCell& cell) {
+    start = std::clamp(start, 0, m_Cols);
+    end = std::clamp(end, start, m_Cols);
+    TerminalCell* cells = Row(row);
+    std::fill(cells + start, cells + end, cell);
+    Touch(row);
+}
+
+void TerminalGrid::SetRow(int row, std::span<const TerminalCell> cells, bool wrapped) {
+    const size_t count = std::min(cells.size(), static_cast<size_t>(m_Cols));
+    TerminalCell* target = Row(row);
+    std::copy_n(cells.begin(), count, target);
+    std::fill(target + count, target + m_Cols, TerminalCell{});
+    Info(row) = {wrapped, ++m_Generation};
+}
+
+void TerminalGrid::Blank(int row, const TerminalCell& blank) {
+    TerminalCell* cells = Row(row);
+    std::fill(cells, cells + m_Cols, blank);
+    Info(row) = {false, ++m_Generation};
+}
+
+void TerminalGrid::ScrollUp(int top, int bottom, int n, bool scrollback, const TerminalCell& blank) {
+    scrollback = scrollback && top == 0;
+    const int moved = std::min(n, bottom - top + 1);
+    if (scrollback) {
+        for (int row = 0; row < moved; ++row) m_Scrollback.Push(GetLine(row));
+    }
+
+    const auto first = m_Order.begin() + top;
+    std::rotate(first, first + moved, m_Order.begin() + bottom + 1);
+    for (int row = bottom - moved + 1; row <= bottom; ++row) Blank(row, blank);
+
+    // Past the region's height the lines scrolled into scrollback are blank ones
+    if (scrollback) {
+        const size_t extra = std::min(static_cast<size_t>(n - moved), m_Scrollback.GetMaxLines());
+        for (size_t i = 0; i < extra; ++i) m_Scrollback.Push(GetLine(bottom));
+    }
+}
+
+void TerminalGrid::ScrollDown(int top, int bottom, int n, const TerminalCell& blank) {
+    const int moved = std::min(n, bottom - top + 1);
+    const auto last = m_Order.begin() + bottom + 1;
+    std::rotate(m_Order.begin() + top, last - moved, last);
+    for (int row = top; row < top + moved; ++row) Blank(row, blank);
+}
+
+void TerminalGrid::Resize(int rows, int cols) {
+    TerminalGrid next(rows, cols, m_Scrollback.GetMaxLines());
+    // Generations stay unique across the resize
+    next.m_Generation = m_Generation;
+    next.MarkDirty();
+
+    if (cols == m_Cols) {
+        next.m_Scrollback = std::move(m_Scrollback);
+        for (int row = 0; row < std::min(rows, m_Rows); ++row) {
+            const TerminalLine line = GetLine(row);
+            next.SetRow(row, line.cells, line.wrapped);
+        }
+    } else {
+        next.m_Scrollback.SetOverflow(m_Scrollback.GetOverflow());
+        // Rewrapped lines fill the screen from the top, then scroll it
+        int filled = 0;
+        auto push = [&](std::span<const TerminalCell> cells, bool wrapped) {
+            if (filled == rows) {
+                next.ScrollUp(0, rows - 1, 1, true, TerminalCell{});
+                --filled;
+            }
+            next.SetRow(filled++, cells, wrapped);
+        };
+        // Logical lines are runs of soft-wrapped rows, rewrapped without
+        // their trailing spaces
+        std::vector<TerminalCell> logical;
+        auto flush = [&] {
+            while (!logical.empty() && logical.back().codepoint == ' ') logical.pop_back();
+            if (logical.empty()) push({}, false);
+            for (size_t pos = 0; pos < logical.size(); pos += static_cast<size_t>(cols)) {
+                const size_t length = std::min(static_cast<size_t>(cols), logical.size() - pos);
+                push(std::span(logical).subspan(pos, length), pos + length < logical.size());
+            }
+            logical.clear();
+        };
+        auto add = [&](const TerminalLine& line) {
+            logical.insert(logical.end(), line.begin(), line.end());
+            if (!line.wrapped) flush();
+        };
+        for (size_t index = 0; index < m_Scrollback.GetSize(); ++index) add(m_Scrollback.GetLine(index));
+        for (int row = 0; row < m_Rows; ++row) add(GetLine(row));
+        if (!logical.empty()) flush();
+    }
+
+    *this = std::move(next);
+}
+
+} // namespace sol
@@ -0,0 +1,80 @@
+#pragma once
+
+#include "terminal_cell.h"
+#include "terminal_scrollback.h"
+#include <vector>
+
+namespace sol {
+
+// The screen as fixed-width rows plus the scrollback above it. Screen rows
+// are reached through a table of row indices, so scrolling moves indices,
+// never cells; only rows leaving the top of the screen for scrollback are
+// copied, trimmed. Every change to a row's cells gives it a new generation,
+// which moving the row or scrolling it into scrollback keeps.
+class TerminalGrid {
+public:
+    TerminalGrid(int rows, int cols, size_t maxScrollback);
+
+    int GetRows() const { return m_Rows; }
+    int GetCols() const { return m_Cols; }
+    size_t GetScrollbackSize() const { return m_Scrollback.GetSize(); }
+
+    // Screen rows, 0 at the top. Writing through Row leaves the generation
+    // to be renewed by Touch.
+    TerminalCell* Row(int row) { return Cells(m_Order[static_cast<size_t>(row)]); }
+    TerminalLine GetLine(int row) const;
+    // Scrollback lines, 0 the oldest
+    TerminalLine GetScrollbackLine(size_t index) const { return m_Scrollback.GetLine(index); }
+
+    void SetWrapped(int row, bool wrapped) { Info(row).wrapped = wrapped; }
+    void Touch(int row) { Info(row).generation = ++m_Generation; }
+    // Touches every screen row
+    void MarkDirty();
+    // Sets columns [start, end) of the row to the cell
+    void Fill(int row, int start, int end, const TerminalCell& cell);
+
+    // Moves screen rows [top, bottom] up by n, blanking the n rows uncovered
+    // at the bottom. With scrollback and top 0, the rows leaving the top
+    // become its newest lines instead of being dropped.
+    void ScrollUp(int top, int bottom, int n, bool scrollback, const TerminalCell& blank);
+    // Moves screen rows [top, bottom] down by n, blanking the n rows uncovered at the top
+    void ScrollDown(int top, int bottom, int n, const TerminalCell& blank);
+    void ClearScrollback() { m_Scrollback.Clear(); }
+    // Receives the lines the scrollback limit drops, resizes included
+    void SetScrollbackOverflow(TerminalScrollback::Overflow overflow) { m_Scrollback.SetOverflow(std::move(overflow)); }
+
+    // A new width rewraps every line, joining soft-wrapped runs first. Fewer
+    // rows drop those at the bottom of the screen; more add blank ones.
+    void Resize(int rows, int cols);
+
+    // Visits every cell of the screen and scrollback
+    template <typename Fn>
+    void ForEachCell(Fn&& fn) {
+        for (TerminalCell& cell : m_Cells) fn(cell);
+        m_Scrollback.ForEachCell(fn);
+    }
+
+private:
+    struct RowInfo {
+        bool wrapped = false;
+        uint64_t generation = 0;
+    };
+
+    // Sets the row to the cells and blanks the rest of it
+    void SetRow(int row, std::span<const TerminalCell> cells, bool wrapped);
+    void Blank(int row, const TerminalCell& blank);
+
+    TerminalCell* Cells(uint32_t physical) { return m_Cells.data() + physical * static_cast<size_t>(m_Cols); }
+    const TerminalCell* Cells(uint32_t physical) const { return m_Cells.data() + physical * static_cast<size_t>(m_Cols); }
+    RowInfo& Info(int row) { return m_Info[m_Order[static_cast<size_t>(row)]]; }
+
+    int m_Rows = 0;
+    int m_Cols = 0;
+    std::vector<uint32_t> m_Order;      // Screen row to physical row
+    std::vector<TerminalCell> m_Cells;  // m_Cols per physical row
+    std::vector<RowInfo> m_Info;        // Per physical row
+    uint64_t m_Generation = 0;          // The newest given to a row
+    TerminalScrollback m_Scrollback;
+};
+
+} // namespace sol
@@ -0,0 +1,341 @@
+#include "terminal_history.h"
+#include "core/logger.h"
+#include "core/utils/compress.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+
+namespace sol {
+
+namespace {
+
+// A block of more attributes is written early, keeping their lookup short
+constexpr size_t MAX_BLOCK_ATTRS = 256;
+constexpr size_t ATTR_SIZE = 9;
+constexpr size_t MIN_SEGMENT_BYTES = 1024 * 1024;
+constexpr size_t MAX_SEGMENT_BYTES = 1024 * 1024 * 1024;  // Offsets stay within a long
+
+void PutVarint(std::string& out, uint64_t value) {
+    for (; value >= 0x80; value >>= 7) out.push_back(static_cast<char>(value | 0x80));
+    out.push_back(static_cast<char>(value));
+}
+
+bool GetVarint(std::string_view data, size_t& pos, uint64_t& value) {
+    value = 0;
+    for (int shift = 0; shift < 64 && pos < data.size(); shift += 7) {
+        const uint8_t byte = static_cast<uint8_t>(data[pos++]);
+        value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+        if (!(byte & 0x80)) return true;
+    }
+    return false;
+}
+
+void PutAttr(std::string& out, const TerminalAttr& attr) {
+    char bytes[ATTR_SIZE];
+    std::memcpy(bytes, &attr.fg, 4);
+    std::memcpy(bytes + 4, &attr.bg, 4);
+    bytes[8] = static_cast<char>(attr.bold | attr.italic << 1 | attr.underline << 2 | attr.strikethrough << 3 |
+                                 attr.inverse << 4 | attr.dim << 5);
+    out.append(bytes, ATTR_SIZE);
+}
+
+TerminalAttr GetAttr(const char* bytes) {
+    TerminalAttr attr;
+    std::memcpy(&attr.fg, bytes, 4);
+    std::memcpy(&attr.bg, bytes + 4, 4);
+    const uint8_t flags = static_cast<uint8_t>(bytes[8]);
+    attr.bold = flags & 1;
+    attr.italic = flags & 2;
+    attr.underline = flags & 4;
+    attr.strikethrough = flags & 8;
+    attr.inverse = flags & 16;
+    attr.dim = flags & 32;
+    return attr;
+}
+
+void PutUtf8(std::string& out, char32_t cp) {
+    if (cp < 0x20 || cp > 0x10FFFF) cp = U' ';
+    if (cp < 0x80) {
+        out.push_back(static_cast<char>(cp));
+    } else if (cp < 0x800) {
+        out.push_back(static_cast<char>(0xC0 | (cp >> 6)));
+        out.push_back(static_cast<char>(0x80 | (cp & 0x3F)));
+    } else if (cp < 0x10000) {
+        out.push_back(static_cast<char>(0xE0 | (cp >> 12)));
+        out.push_back(static_cast<char>(0x80 | ((cp >> 6) & 0x3F)));
+        out.push_back(static_cast<char>(0x80 | (cp & 0x3F)));
+    } else {
+        out.push_back(static_cast<char>(0xF0 | (cp >> 18)));
+        out.push_back(static_cast<char>(0x80 | ((cp >> 12) & 0x3F)));
+        out.push_back(static_cast<char>(0x80 | ((cp >> 6) & 0x3F)));
+        out.push_back(static_cast<char>(0x80 | (cp & 0x3F)));
+    }
+}
+
+// Decodes what PutUtf8 encoded; false at a newline or the end of the text
+bool GetUtf8(std::string_view text, size_t& pos, char32_t& cp) {
+    if (pos >= text.size() || text[pos] == '\n') return false;
+    const uint8_t lead = static_cast<uint8_t>(text[pos]);
+    const size_t length = lead < 0x80 ? 1 : lead < 0xE0 ? 2 : lead < 0xF0 ? 3 : 4;
+    if (length > text.size() - pos) return false;
+    cp = length == 1 ? lead : lead & (0x7F >> length);
+    for (size_t i = 1; i < length; ++i) cp = cp << 6 | (static_cast<uint8_t>(text[pos + i]) & 0x3F);
+    pos += length;
+    return true;
+}
+
+} // namespace
+
+TerminalHistory::Segment::~Segment() {
+    if (file) std::fclose(file);
+    std::error_code ec;
+    std::filesystem::remove(path, ec);
+}
+
+TerminalHistory::TerminalHistory(size_t maxBytes)
+    : m_MaxBytes(maxBytes), m_SegmentBytes(std::clamp(maxBytes / 4, MIN_SEGMENT_BYTES, MAX_SEGMENT_BYTES)) {
+}
+
+void TerminalHistory::Append(const TerminalLine& line, const TerminalStyleTable& styles) {
+    if (m_MaxBytes == 0) {
+        ++m_First;
+        return;
+    }
+
+    m_PendingMeta.push_back(line.wrapped ? 1 : 0);
+    PutVarint(m_PendingMeta, line.generation);
+    PutVarint(m_PendingMeta, line.size());
+    for (size_t start = 0; start < line.size();) {
+        const uint32_t style = line[start].style;
+        size_t end = start + 1;
+        while (end < line.size() && line[end].style == style) ++end;
+        PutVarint(m_PendingMeta, end - start);
+        PutVarint(m_PendingMeta, AttrIndex(styles.Get(style)));
+        start = end;
+    }
+    AppendText(line, m_PendingText);
+    ++m_PendingLines;
+    ++m_Lines;
+
+    if (m_PendingMeta.size() + m_PendingText.size() >= BLOCK_SIZE || m_PendingAttrs.size() >= MAX_BLOCK_ATTRS) {
+        Flush();
+    }
+}
+
+void TerminalHistory::AppendText(const TerminalLine& line, std::string& out) {
+    for (const TerminalCell& cell : line) PutUtf8(out, cell.codepoint);
+    out.push_back('\n');
+}
+
+uint32_t TerminalHistory::AttrIndex(const TerminalAttr& attr) {
+    auto it = std::find(m_PendingAttrs.begin(), m_PendingAttrs.end(), attr);
+    if (it != m_PendingAttrs.end()) return static_cast<uint32_t>(it - m_PendingAttrs.begin());
+    m_PendingAttrs.push_back(attr);
+    return static_cast<uint32_t>(m_PendingAttrs.size() - 1);
+}
+
+void TerminalHistory::Flush() {
+    std::string raw;
+    PutVarint(raw, m_PendingAttrs.size());
+    for (const TerminalAttr& attr : m_PendingAttrs) PutAttr(raw, attr);
+    raw += m_PendingMeta;
+    const size_t metaSize = raw.size();
+    raw += m_PendingText;
+    const std::string packed = CompressBlock(raw);
+
+    if ((m_Segments.empty() || m_Segments.back()->bytes >= m_SegmentBytes) && !OpenSegment()) return;
+    Segment& segment = *m_Segments.back();
+    if (std::fseek(segment.file, 0, SEEK_END) != 0 ||
+        std::fwrite(packed.data(), 1, packed.size(), segment.file) != packed.size() || std::fflush(segment.file) != 0) {
+        Fail("write");
+        return;
+    }
+
+    segment.blocks.push_back({m_First + m_Lines - m_PendingLines, segment.bytes, static_cast<uint32_t>(packed.size()),
+                              static_cast<uint32_t>(raw.size()), static_cast<uint32_t>(metaSize),
+                              static_cast<uint32_t>(m_PendingLines)});
+    segment.bytes += packed.size();
+    segment.lines += m_PendingLines;
+    m_Bytes += packed.size();
+    m_PendingAttrs.clear();
+    m_PendingMeta.clear();
+    m_PendingText.clear();
+    m_PendingLines = 0;
+
+    while (m_Bytes > m_MaxBytes && m_Segments.size() > 1) {
+        const Segment& oldest = *m_Segments.front();
+        m_First += oldest.lines;
+        m_Lines -= oldest.lines;
+        m_Bytes -= oldest.bytes;
+        m_Segments.erase(m_Segments.begin());
+    }
+}
+
+bool TerminalHistory::OpenSegment() {
+    static std::atomic<uint32_t> s_Count{0};
+    const auto stamp = std::chrono::steady_clock::now().time_since_epoch().count();
+    const std::string name = "sol-scrollback-" + std::to_string(stamp) + "-" + std::to_string(s_Count++) + ".tmp";
+
+    std::error_code ec;
+    const std::filesystem::path directory = std::filesystem::temp_directory_path(ec);
+    auto segment = std::make_shared<Segment>();
+    if (!ec) {
+        segment->path = directory / name;
+        segment->file = std::fopen(segment->path.string().c_str(), "w+b");
+    }
+    if (!segment->file) {
+        Fail("file");
+        return false;
+    }
+    m_Segments.push_back(std::move(segment));
+    return true;
+}
+
+void TerminalHistory::Fail(const char* what) {
+    Logger::Error("Terminal history ", what, " failed, older scrollback is dropped");
+    Clear(0);
+    m_MaxBytes = 0;
+}
+
+void TerminalHistory::Clear(size_t skipped) {
+    m_First += m_Lines + skipped;
+    m_Lines = 0;
+    m_Bytes = 0;
+    m_Segments.clear();
+    m_PendingAttrs.clear();
+    m_PendingMeta.clear();
+    m_PendingText.clear();
+    m_PendingLines = 0;
+    ForgetDecoded();
+}
+
+void TerminalHistory::ForgetDecoded() {
+    for (Decoded& decoded : m_Decoded) decoded.first = UINT64_MAX;
+    ++m_Forgets;
+}
+
+TerminalHistory::Decoded& TerminalHistory::Slot(uint64_t first, size_t lines) {
+    for (size_t slot = 0; slot < 2; ++slot) {
+        if (m_Decoded[slot].first == first && m_Decoded[slot].lines == lines) {
+            m_LastSlot = slot;
+            return m_Decoded[slot];
+        }
+    }
+    m_LastSlot = 1 - m_LastSlot;
+    m_Decoded[m_LastSlot].first = UINT64_MAX;
+    return m_Decoded[m_LastSlot];
+}
+
+TerminalLine TerminalHistory::GetLine(size_t index, const StyleResolver& styles) {
+    if (index >= m_Lines) return {};
+    const uint64_t number = m_First + index;
+    const uint64_t pendingFirst = m_First + m_Lines - m_PendingLines;
+
+    const Block* block = nullptr;
+    const Segment* segment = nullptr;
+    uint64_t first = pendingFirst;
+    size_t lines = m_PendingLines;
+    if (number < pendingFirst) {
+        auto byFirst = [](uint64_t n, const Block& b) { return n < b.first; };
+        auto seg = std::upper_bound(m_Segments.begin(), m_Segments.end(), number,
+                                    [](uint64_t n, const auto& s) { return n < s->blocks.front().first; });
+        segment = (*std::prev(seg)).get();
+        block = &*std::prev(std::upper_bound(segment->blocks.begin(), segment->blocks.end(), number, byFirst));
+        first = block->first;
+        lines = block->lines;
+    }
+
+    Decoded& decoded = Slot(first, lines);
+    if (decoded.first == UINT64_MAX) {
+        const bool ok = block ? DecodeBlock(*segment, *block, styles, decoded)
+                              : Decode(m_PendingAttrs, m_PendingMeta, m_PendingText, lines, styles, decoded);
+        if (!ok) {
+            Fail("read");
+            return {};
+        }
+        decoded.first = first;
+        decoded.lines = lines;
+    }
+
+    const Decoded::Line& info = decoded.info[number - first];
+    return {std::span<const TerminalCell>(decoded.cells.data() + info.start, info.length), info.wrapped,
+            info.generation};
+}
+
+bool TerminalHistory::DecodeBlock(const Segment& segment, const Block& block, const StyleResolver& styles,
+                                  Decoded& out) {
+    if (!ReadBlock(segment.file, block, m_Scratch)) return false;
+    const std::string_view raw = m_Scratch;
+    size_t pos = 0;
+    uint64_t count = 0;
+    if (!GetVarint(raw, pos, count) || pos > block.metaSize || count > (block.metaSize - pos) / ATTR_SIZE) return false;
+
+    std::vector<TerminalAttr> attrs;
+    for (uint64_t i = 0; i < count; ++i, pos += ATTR_SIZE) attrs.push_back(GetAttr(raw.data() + pos));
+    return Decode(attrs, raw.substr(pos, block.metaSize - pos), raw.substr(block.metaSize), block.lines, styles, out);
+}
+
+bool TerminalHistory::Decode(const std::vector<TerminalAttr>& attrs, std::string_view meta, std::string_view text,
+                             size_t lines, const StyleResolver& styles, Decoded& out) {
+    // Resolving a style may compact the table, forgetting what was decoded
+    // and any style resolved before
+    std::vector<uint32_t> ids;
+    uint64_t forgets;
+    do {
+        forgets = m_Forgets;
+        ids.clear();
+        for (const TerminalAttr& attr : attrs) ids.push_back(styles(attr));
+    } while (forgets != m_Forgets);
+
+    out.cells.clear();
+    out.info.clear();
+    size_t pos = 0;
+    size_t textPos = 0;
+    for (size_t line = 0; line < lines; ++line) {
+        if (pos >= meta.size()) return false;
+        Decoded::Line info;
+        info.wrapped = meta[pos++] & 1;
+        uint64_t count = 0;
+        if (!GetVarint(meta, pos, info.generation) || !GetVarint(meta, pos, count)) return false;
+        // Every cell takes a byte of text at least
+        if (count > text.size() - textPos) return false;
+        info.start = static_cast<uint32_t>(out.cells.size());
+        info.length = static_cast<uint32_t>(count);
+
+        for (uint64_t filled = 0; filled < count;) {
+            uint64_t run = 0;
+            uint64_t attr = 0;
+            if (!GetVarint(meta, pos, run) || !GetVarint(meta, pos, attr)) return false;
+            if (run == 0 || run > count - filled || attr >= ids.size()) return false;
+            out.cells.insert(out.cells.end(), run, TerminalCell{U' ', ids[attr]});
+            filled += run;
+        }
+        for (size_t cell = info.start; cell < out.cells.size(); ++cell) {
+            if (!GetUtf8(text, textPos, out.cells[cell].codepoint)) return false;
+        }
+        if (textPos >= text.size() || text[textPos] != '\n') return false;
+        ++textPos;
+        out.info.push_back(info);
+    }
+    return true;
+}
+
+TerminalHistory::Snapshot TerminalHistory::TakeSnapshot() const {
+    Snapshot snapshot;
+    for (const auto& segment : m_Segments) snapshot.parts.push_back({segment, segment->blocks});
+    snapshot.tail = m_PendingText;
+    snapshot.tailFirst = m_First + m_Lines - m_PendingLines;
+    return snapshot;
+}
+
+bool TerminalHistory::ReadBlock(std::FILE* file, const Block& block, std::string& raw) {
+    std::string packed(block.size, '\0');
+    if (std::fseek(file, static_cast<long>(block.offset), SEEK_SET) != 0 ||
+        std::fread(packed.data(), 1, packed.size(), file) != packed.size()) {
+        return false;
+    }
+    return DecompressBlock(packed, block.rawSize, raw) && block.metaSize <= raw.size();
+}
+
+} // namespace sol
@@ -0,0 +1,130 @@
+#pragma once
+
+#include "terminal_cell.h"
+#include <cstdio>
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace sol {
+
+// Scrollback older than the in-memory ring, spilled to temporary files up
+// to a byte limit, past which the oldest file is deleted whole. Lines are
+// packed into blocks of about BLOCK_SIZE, each compressed and appended to
+// the newest file. A block unpacks to its meta, the attributes (style
+// indices do not outlive compaction) and wrap flags of its lines, and then
+// its text: the lines' characters, one per cell, each line ended by a
+// newline, so that a search can scan it as it is. Reading a line decodes its
+// block; the last two read stay decoded.
+class TerminalHistory {
+public:
+    static constexpr size_t BLOCK_SIZE = 64 * 1024;
+
+    // A block written, never changed after
+    struct Block {
+        uint64_t first = 0;     // Number of the first line, as GetFirst counts
+        uint64_t offset = 0;    // In the file
+        uint32_t size = 0;      // Compressed
+        uint32_t rawSize = 0;
+        uint32_t metaSize = 0;  // Where the text starts once unpacked
+        uint32_t lines = 0;
+    };
+
+    // One file, deleted with the last reference to it
+    struct Segment {
+        ~Segment();
+
+        std::filesystem::path path;
+        std::FILE* file = nullptr;
+        std::vector<Block> blocks;
+        uint64_t bytes = 0;
+        size_t lines = 0;
+    };
+
+    // The blocks at one point, for a search on another thread, then the text
+    // of the lines after them
+    struct Snapshot {
+        struct Part {
+            std::shared_ptr<const Segment> segment;
+            std::vector<Block> blocks;
+        };
+        std::vector<Part> parts;
+        std::string tail;
+        uint64_t tailFirst = 0;  // Number of the tail's first line
+    };
+
+    using StyleResolver = std::function<uint32_t(const TerminalAttr&)>;
+
+    // No lines are kept with a limit of 0
+    explicit TerminalHistory(size_t maxBytes);
+
+    TerminalHistory(const TerminalHistory&) = delete;
+    TerminalHistory& operator=(const TerminalHistory&) = delete;
+
+    size_t GetSize() const { return m_Lines; }
+    // Number of the oldest line held, counting every line ever dropped
+    uint64_t GetFirst() const { return m_First; }
+
+    void Append(const TerminalLine& line, const TerminalStyleTable& styles);
+    // Valid until the history changes or decodes another block; styles
+    // gives the cells' styles for the attributes stored
+    TerminalLine GetLine(size_t index, const StyleResolver& styles);
+    // Drops every line, numbering the next as if skipped more were dropped too
+    void Clear(size_t skipped);
+    // Drops the lines decoded, whose styles compaction renumbers
+    void ForgetDecoded();
+
+    Snapshot TakeSnapshot() const;
+    // Reads a block back from its segment's file, or from another handle
+    // to it on another thread, and unpacks it
+    static bool ReadBlock(std::FILE* file, const Block& block, std::string& raw);
+    // Appends a line's text as blocks store it
+    static void AppendText(const TerminalLine& line, std::string& out);
+
+private:
+    struct Decoded {
+        uint64_t first = UINT64_MAX;
+        size_t lines = 0;
+        std::vector<TerminalCell> cells;
+        struct Line {
+            uint32_t start = 0;
+            uint32_t length = 0;
+            bool wrapped = false;
+            uint64_t generation = 0;
+        };
+        std::vector<Line> info;
+    };
+
+    uint32_t AttrIndex(const TerminalAttr& attr);
+    void Flush();
+    bool OpenSegment();
+    // Lost lines leave the history empty and spilling off
+    void Fail(const char* what);
+    bool DecodeBlock(const Segment& segment, const Block& block, const StyleResolver& styles, Decoded& out);
+    bool Decode(const std::vector<TerminalAttr>& attrs, std::string_view meta, std::string_view text, size_t lines,
+                const StyleResolver& styles, Decoded& out);
+    Decoded& Slot(uint64_t first, size_t lines);
+
+    size_t m_MaxBytes;
+    size_t m_SegmentBytes;
+    std::vector<std::shared_ptr<Segment>> m_Segments;
+    uint64_t m_First = 0;
+    size_t m_Lines = 0;
+    uint64_t m_Bytes = 0;
+
+    // Lines of the block not written yet
+    std::vector<TerminalAttr> m_PendingAttrs;
+    std::string m_PendingMeta;  // Without the attributes, which come first once written
+    std::string m_PendingText;
+    size_t m_PendingLines = 0;
+
+    Decoded m_Decoded[2];
+    size_t m_LastSlot = 0;
+    uint64_t m_Forgets = 0;  // Counts ForgetDecoded, which styles may call while decoding
+    std::string m_Scratch;
+};
+
+} // namespace sol
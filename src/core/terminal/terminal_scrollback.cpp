@@ -0,0 +1,81 @@
+#include "terminal_scrollback.h"
+#include <algorithm>
+
+namespace sol {
+
+namespace {
+constexpr size_t MIN_CELLS = 16 * 1024;
+}
+
+TerminalScrollback::TerminalScrollback(size_t maxLines)
+    : m_MaxLines(maxLines) {
+}
+
+TerminalLine TerminalScrollback::GetLine(size_t index) const {
+    const Entry& entry = m_Lines[(m_First + index) % m_Lines.size()];
+    return {std::span<const TerminalCell>(m_Cells.data() + Offset(entry.start), entry.length), entry.wrapped,
+            entry.generation};
+}
+
+void TerminalScrollback::Push(const TerminalLine& line) {
+    if (m_MaxLines == 0) return;
+    std::span<const TerminalCell> cells = line.cells;
+    // A soft-wrapped line keeps its trailing blanks so rewrapping can rejoin it
+    if (!line.wrapped) {
+        while (!cells.empty() && cells.back() == TerminalCell{}) cells = cells.first(cells.size() - 1);
+    }
+
+    if (m_Count == m_MaxLines) {
+        if (m_Overflow) m_Overflow(GetLine(0));
+        m_First = (m_First + 1) % m_Lines.size();
+        --m_Count;
+    }
+    if (m_Count == 0) m_End = 0;
+
+    // Lines never straddle the end of the buffer; the cells skipped are
+    // reused once the lines before them are dropped
+    uint64_t start = m_End;
+    const size_t offset = Offset(start);
+    if (offset + cells.size() > m_Cells.size()) start += m_Cells.size() - offset;
+    const uint64_t oldest = m_Count > 0 ? m_Lines[m_First].start : start;
+    if (start + cells.size() - oldest > m_Cells.size()) {
+        Grow(cells.size());
+        start = m_End;
+    }
+
+    std::copy(cells.begin(), cells.end(), m_Cells.begin() + static_cast<std::ptrdiff_t>(Offset(start)));
+    const Entry entry{start, static_cast<uint32_t>(cells.size()), line.wrapped, line.generation};
+    if (m_Lines.size() < m_MaxLines) {
+        m_Lines.push_back(entry);
+    } else {
+        m_Lines[(m_First + m_Count) % m_Lines.size()] = entry;
+    }
+    ++m_Count;
+    m_End = start + cells.size();
+}
+
+void TerminalScrollback::Clear() {
+    m_Lines.clear();
+    m_First = 0;
+    m_Count = 0;
+    m_Cells = {};
+    m_End = 0;
+}
+
+void TerminalScrollback::Grow(size_t length) {
+    size_t used = length;
+    for (size_t index = 0; index < m_Count; ++index) used += m_Lines[(m_First + index) % m_Lines.size()].length;
+
+    std::vector<TerminalCell> cells(std::max({m_Cells.size() * 2, used, MIN_CELLS}));
+    uint64_t position = 0;
+    for (size_t index = 0; index < m_Count; ++index) {
+        Entry& entry = m_Lines[(m_First + index) % m_Lines.size()];
+        std::copy_n(m_Cells.data() + Offset(entry.start), entry.length, cells.data() + position);
+        entry.start = position;
+        position += entry.length;
+    }
+    m_Cells = std::move(cells);
+    m_End = position;
+}
+
+} // namespace sol
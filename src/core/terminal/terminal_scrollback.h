@@ -0,0 +1,60 @@
+#pragma once
+
+#include "terminal_cell.h"
+#include <functional>
+
+namespace sol {
+
+// Lines that scrolled off the top of the screen, oldest first, up to a
+// limit past which the oldest is dropped. A hard-wrapped line keeps its
+// cells only up to the last one that is not a default blank; the lines
+// are packed end to end in one circular buffer, which grows while their
+// total does and otherwise reuses the space of the lines dropped.
+class TerminalScrollback {
+public:
+    explicit TerminalScrollback(size_t maxLines);
+
+    size_t GetSize() const { return m_Count; }
+    size_t GetMaxLines() const { return m_MaxLines; }
+    TerminalLine GetLine(size_t index) const;
+
+    // Copies the line, keeping its generation
+    void Push(const TerminalLine& line);
+    void Clear();
+    
+    // Called with the oldest line just before the limit drops it
+    using Overflow = std::function<void(const TerminalLine&)>;
+    void SetOverflow(Overflow overflow) { m_Overflow = std::move(overflow); }
+    const Overflow& GetOverflow() const { return m_Overflow; }
+
+    template <typename Fn>
+    void ForEachCell(Fn&& fn) {
+        for (size_t index = 0; index < m_Count; ++index) {
+            const Entry& entry = m_Lines[(m_First + index) % m_Lines.size()];
+            TerminalCell* cells = m_Cells.data() + Offset(entry.start);
+            for (uint32_t i = 0; i < entry.length; ++i) fn(cells[i]);
+        }
+    }
+
+private:
+    struct Entry {
+        uint64_t start = 0;   // Cells pushed before the line, counting any skipped
+        uint32_t length = 0;
+        bool wrapped = false;
+        uint64_t generation = 0;
+    };
+
+    size_t Offset(uint64_t start) const { return m_Cells.empty() ? 0 : static_cast<size_t>(start % m_Cells.size()); }
+    // Moves the lines to the front of a buffer with room for length more cells
+    void Grow(size_t length);
+
+    size_t m_MaxLines;
+    std::vector<Entry> m_Lines;        // A ring once it reaches m_MaxLines
+    size_t m_First = 0;                // Entry of the oldest line
+    size_t m_Count = 0;
+    std::vector<TerminalCell> m_Cells;
+    uint64_t m_End = 0;                // Start of the next line
+    Overflow m_Overflow;
+};
+
+} // namespace sol
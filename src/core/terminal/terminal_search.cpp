@@ -0,0 +1,121 @@
+#include "terminal_search.h"
+#include "terminal_emulator.h"
+#include "core/cancellation.h"
+#include "core/job_system.h"
+#include "core/text/text_scan.h"
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+
+namespace sol {
+
+struct TerminalSearch::Pass {
+    TerminalHistory::Snapshot snapshot;
+    std::string query;  // Folded literal
+    std::shared_ptr<const Regex> regex;
+    std::vector<Match> found;
+    CancellationSource cancel;
+    std::atomic<bool> done{false};
+};
+
+namespace {
+
+// Appends the matches in text, whose lines each end in a newline and are
+// numbered from first; false once the limit is reached
+bool ScanLines(std::string_view text, uint64_t first, std::string_view query, RegexMatcher* matcher,
+               std::vector<TerminalSearch::Match>& out) {
+    uint64_t line = first;
+    size_t lineStart = 0;
+    size_t counted = 0;  // Newlines before here are in line
+    auto add = [&](size_t start, size_t end) {
+        const size_t newlines = CountNewlines(text.substr(counted, start - counted));
+        if (newlines > 0) {
+            line += newlines;
+            lineStart = text.rfind('\n', start - 1) + 1;
+        }
+        counted = start;
+        end = std::min(end, text.find('\n', start));
+        out.push_back({line, static_cast<uint32_t>(ScanText(text.substr(lineStart, start - lineStart)).codepoints),
+                       static_cast<uint32_t>(ScanText(text.substr(start, end - start)).codepoints)});
+        return out.size() < TerminalSearch::MAX_MATCHES;
+    };
+
+    bool open = true;
+    if (matcher) {
+        matcher->ForEach(text, 0, text.size(), [&](RegexMatcher::Match match) {
+            return open = add(match.start, match.end);
+        });
+    } else {
+        for (size_t from = 0, hit; open && (hit = FindFolded(text.substr(from), query)) != std::string_view::npos;
+             from += hit + query.size()) {
+            open = add(from + hit, from + hit + query.size());
+        }
+    }
+    return open;
+}
+
+} // namespace
+
+TerminalSearch::~TerminalSearch() {
+    Cancel();
+}
+
+void TerminalSearch::Start(const TerminalEmulator& emulator, std::string_view query, bool regex) {
+    Clear();
+    if (query.empty()) return;
+
+    auto pass = std::make_shared<Pass>();
+    if (regex) {
+        pass->regex = Regex::Compile(query, true, m_Error);
+        if (!pass->regex) return;
+    } else {
+        for (char c : query) pass->query.push_back(FoldAscii(c));
+    }
+    pass->snapshot = emulator.TakeSearchSnapshot();
+    m_Pending = pass;
+
+    JobSystem::Submit(JobPriority::Interactive, pass->cancel.Token(), [pass] {
+        const CancellationToken cancel = pass->cancel.Token();
+        std::unique_ptr<RegexMatcher> matcher;
+        if (pass->regex) matcher = std::make_unique<RegexMatcher>(pass->regex);
+
+        // Blocks on disk are read through a handle of this thread's own
+        bool open = true;
+        std::string raw;
+        for (const TerminalHistory::Snapshot::Part& part : pass->snapshot.parts) {
+            std::FILE* file = std::fopen(part.segment->path.string().c_str(), "rb");
+            if (!file) continue;
+            for (const TerminalHistory::Block& block : part.blocks) {
+                if (cancel.IsCancelled() || !open) break;
+                if (!TerminalHistory::ReadBlock(file, block, raw)) continue;
+                open = ScanLines(std::string_view(raw).substr(block.metaSize), block.first, pass->query, matcher.get(),
+                                 pass->found);
+            }
+            std::fclose(file);
+        }
+        if (cancel.IsCancelled()) return;
+        if (open) ScanLines(pass->snapshot.tail, pass->snapshot.tailFirst, pass->query, matcher.get(), pass->found);
+        pass->done.store(true, std::memory_order_release);
+    });
+}
+
+void TerminalSearch::Clear() {
+    Cancel();
+    m_Error.clear();
+    m_Matches.clear();
+}
+
+bool TerminalSearch::Poll() {
+    if (!m_Pending || !m_Pending->done.load(std::memory_order_acquire)) return false;
+    m_Matches = std::move(m_Pending->found);
+    m_Pending.reset();
+    return true;
+}
+
+void TerminalSearch::Cancel() {
+    if (!m_Pending) return;
+    m_Pending->cancel.Cancel();
+    m_Pending.reset();
+}
+
+} // namespace sol
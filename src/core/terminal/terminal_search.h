@@ -0,0 +1,60 @@
+#pragma once
+
+#include "terminal_history.h"
+#include "core/text/regex.h"
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace sol {
+
+class TerminalEmulator;
+
+// Search of a terminal's scrollback and screen for a literal ignoring ASCII
+// case or a Regex. Start takes a snapshot of the text, the blocks on disk by
+// reference, and scans it on the JobSystem, reading those blocks back one at
+// a time; Poll takes the result. Matches stay within a line and are
+// numbered as GetScrollbackStart counts lines, so output arriving meanwhile
+// does not move them.
+class TerminalSearch {
+public:
+    struct Match {
+        uint64_t line = 0;
+        uint32_t col = 0;     // In cells
+        uint32_t length = 0;
+    };
+
+    // A search stops once it has found this many
+    static constexpr size_t MAX_MATCHES = 100000;
+
+    TerminalSearch() = default;
+    ~TerminalSearch();
+
+    TerminalSearch(const TerminalSearch&) = delete;
+    TerminalSearch& operator=(const TerminalSearch&) = delete;
+
+    // Called under the emulator's lock
+    void Start(const TerminalEmulator& emulator, std::string_view query, bool regex);
+    void Clear();
+    // Takes a finished scan; true when Matches changed
+    bool Poll();
+
+    bool IsComplete() const { return !m_Pending; }
+    // Why the query is not a valid regex, empty otherwise
+    const std::string& Error() const { return m_Error; }
+    // In line and column order
+    const std::vector<Match>& Matches() const { return m_Matches; }
+
+private:
+    struct Pass;
+
+    void Cancel();
+
+    std::string m_Error;
+    std::vector<Match> m_Matches;
+    std::shared_ptr<Pass> m_Pending;
+};
+
+} // namespace sol
@@ -0,0 +1,38 @@
+#include "diagnostic_store.h"
+
+namespace sol {
+
+void DiagnosticStore::Set(std::vector<Diagnostic> diagnostics) {
+    std::stable_sort(diagnostics.begin(), diagnostics.end(),
+                     [](const Diagnostic& a, const Diagnostic& b) { return a.start < b.start; });
+    m_Diagnostics = std::move(diagnostics);
+    m_MaxLength = 0;
+    for (const Diagnostic& diagnostic : m_Diagnostics) m_MaxLength = std::max(m_MaxLength, Length(diagnostic));
+}
+
+void DiagnosticStore::Clear() {
+    std::vector<Diagnostic>().swap(m_Diagnostics);
+    m_MaxLength = 0;
+}
+
+// Positions are mapped monotonically, so the order holds
+void DiagnosticStore::Shift(size_t start, size_t oldEnd, size_t newEnd) {
+    if (m_Diagnostics.empty()) return;
+
+    auto map = [&](size_t pos, size_t inside) {
+        if (pos <= start) return pos;
+        if (pos >= oldEnd) return pos - oldEnd + newEnd;
+        return inside;
+    };
+    const size_t from = start - std::min(start, m_MaxLength);
+    auto it = std::lower_bound(m_Diagnostics.begin(), m_Diagnostics.end(), from,
+                               [](const Diagnostic& diagnostic, size_t value) { return diagnostic.start < value; });
+    for (; it != m_Diagnostics.end(); ++it) {
+        if (it->end < start) continue;
+        it->start = map(it->start, start);
+        it->end = map(it->end, newEnd);
+        m_MaxLength = std::max(m_MaxLength, Length(*it));
+    }
+}
+
+} // namespace sol
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace sol {
+
+// A problem the language server reported, in byte offsets of the text
+struct Diagnostic {
+    size_t start;
+    size_t end;
+    int severity;  // 1: Error, 2: Warning, 3: Info, 4: Hint
+    std::string message;
+};
+
+// A buffer's diagnostics, sorted by start. Edits move them right away so
+// they stay on their text until the server publishes again. The longest
+// one bounds how far before a range a diagnostic reaching into it can
+// start, so range queries are a binary search and a short scan.
+class DiagnosticStore {
+public:
+    void Set(std::vector<Diagnostic> diagnostics);
+    void Clear();
+    bool Empty() const { return m_Diagnostics.empty(); }
+    size_t Size() const { return m_Diagnostics.size(); }
+
+    // Bytes [start, oldEnd) became [start, newEnd). Diagnostics within the
+    // replaced text stretch over what replaced it.
+    void Shift(size_t start, size_t oldEnd, size_t newEnd);
+
+    // Calls f(diagnostic) for those overlapping [begin, end) in start order;
+    // an empty diagnostic counts as covering its position
+    template <typename F>
+    void ForRange(size_t begin, size_t end, F&& f) const;
+
+private:
+    static size_t Length(const Diagnostic& diagnostic) {
+        return std::max<size_t>(diagnostic.end - diagnostic.start, 1);
+    }
+
+    std::vector<Diagnostic> m_Diagnostics;
+    size_t m_MaxLength = 0;  // At least the longest diagnostic
+};
+
+template <typename F>
+void DiagnosticStore::ForRange(size_t begin, size_t end, F&& f) const {
+    const size_t from = begin - std::min(begin, m_MaxLength);
+    auto it = std::lower_bound(m_Diagnostics.begin(), m_Diagnostics.end(), from,
+                               [](const Diagnostic& diagnostic, size_t value) { return diagnostic.start < value; });
+    for (; it != m_Diagnostics.end() && it->start < end; ++it) {
+        if (it->start + Length(*it) > begin) f(*it);
+    }
+}
+
+} // namespace sol
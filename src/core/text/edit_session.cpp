@@ -0,0 +1,232 @@
+#include "edit_session.h"
+#include "core/logger.h"
+#include "core/platform/atomic_file.h"
+#include "core/utils/compress.h"
+#include <concepts>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+
+namespace sol {
+
+namespace {
+
+// An LZ4 block unpacks to at most this many times its size
+constexpr size_t MAX_RATIO = 255;
+
+void PutVarint(std::string& out, uint64_t value) {
+    for (; value >= 0x80; value >>= 7) out.push_back(static_cast<char>(value | 0x80));
+    out.push_back(static_cast<char>(value));
+}
+
+void PutString(std::string& out, std::string_view text) {
+    PutVarint(out, text.size());
+    out += text;
+}
+
+void PutOperation(std::string& out, const EditOperation& op) {
+    PutVarint(out, static_cast<uint64_t>(op.type));
+    PutVarint(out, op.position);
+    PutVarint(out, op.cursorBefore);
+    PutVarint(out, op.cursorAfter);
+    PutString(out, op.oldText);
+    PutString(out, op.newText);
+    PutVarint(out, op.parts.size());
+    for (const EditOperation& part : op.parts) PutOperation(out, part);
+}
+
+struct Reader {
+    std::string_view data;
+
+    template <std::unsigned_integral T>
+    bool Get(T& value) {
+        uint64_t wide = 0;
+        for (int shift = 0; shift < 64 && !data.empty(); shift += 7) {
+            const uint8_t byte = static_cast<uint8_t>(data.front());
+            data.remove_prefix(1);
+            wide |= static_cast<uint64_t>(byte & 0x7F) << shift;
+            if (!(byte & 0x80)) {
+                value = static_cast<T>(wide);
+                return true;
+            }
+        }
+        return false;
+    }
+
+    bool Get(std::string& value) {
+        size_t length = 0;
+        if (!Get(length) || data.length() < length) return false;
+        value.assign(data.data(), length);
+        data.remove_prefix(length);
+        return true;
+    }
+
+    // Counts of entries at least a byte each
+    bool GetCount(size_t& count) { return Get(count) && count <= data.length(); }
+
+    // Parts of a batch have no parts of their own
+    bool Get(EditOperation& op, bool isPart) {
+        uint64_t type = 0;
+        size_t parts = 0;
+        if (!Get(type) || type > static_cast<uint64_t>(EditOperation::Type::Batch) || !Get(op.position) ||
+            !Get(op.cursorBefore) || !Get(op.cursorAfter) || !Get(op.oldText) || !Get(op.newText) ||
+            !GetCount(parts) || (parts > 0 && isPart)) {
+            return false;
+        }
+        op.type = static_cast<EditOperation::Type>(type);
+        op.parts.resize(parts);
+        for (EditOperation& part : op.parts) {
+            if (!Get(part, true)) return false;
+        }
+        return true;
+    }
+};
+
+} // namespace
+
+EditSession::EditSession(std::string fileName, std::string text)
+    : m_FileName(std::move(fileName)), m_Text(std::move(text)) {}
+
+EditSession::Step& EditSession::Begin(Kind kind) {
+    const auto now = std::chrono::steady_clock::now();
+    Step& step = m_Steps.emplace_back();
+    step.kind = kind;
+    step.delayUs = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(now - m_Last).count());
+    m_Last = now;
+    return step;
+}
+
+void EditSession::RecordEdits(std::span<const Rope::Edit> edits) {
+    Step& step = Begin(Kind::Edit);
+    step.edits.reserve(edits.size());
+    for (const Rope::Edit& edit : edits) step.edits.push_back({edit.pos, edit.len, std::string(edit.text)});
+}
+
+void EditSession::RecordPush(const EditOperation& op) {
+    Begin(Kind::Push).op = op;
+}
+
+void EditSession::RecordHighlight(size_t firstLine, size_t endLine) {
+    if (!m_Steps.empty()) {
+        const Step& last = m_Steps.back();
+        if (last.kind == Kind::Highlight && last.first == firstLine && last.end == endLine) return;
+    }
+    Step& step = Begin(Kind::Highlight);
+    step.first = firstLine;
+    step.end = endLine;
+}
+
+void EditSession::RecordCompletion(std::string_view prefix, size_t cursor) {
+    Step& step = Begin(Kind::Completion);
+    step.prefix = prefix;
+    step.first = cursor;
+}
+
+bool EditSession::Save(const std::filesystem::path& path) const {
+    std::string raw;
+    PutString(raw, m_FileName);
+    PutString(raw, m_Text);
+    PutVarint(raw, m_Steps.size());
+    for (const Step& step : m_Steps) {
+        PutVarint(raw, static_cast<uint64_t>(step.kind));
+        PutVarint(raw, step.delayUs);
+        switch (step.kind) {
+        case Kind::Edit:
+            PutVarint(raw, step.edits.size());
+            for (const TextEdit& edit : step.edits) {
+                PutVarint(raw, edit.pos);
+                PutVarint(raw, edit.len);
+                PutString(raw, edit.text);
+            }
+            break;
+        case Kind::Push:
+            PutOperation(raw, step.op);
+            break;
+        case Kind::Undo:
+        case Kind::Redo:
+            break;
+        case Kind::Highlight:
+            PutVarint(raw, step.first);
+            PutVarint(raw, step.end);
+            break;
+        case Kind::Completion:
+            PutString(raw, step.prefix);
+            PutVarint(raw, step.first);
+            break;
+        }
+    }
+
+    std::string data(MAGIC, sizeof(MAGIC));
+    PutVarint(data, raw.size());
+    data += CompressBlock(raw);
+    auto file = AtomicFile::Create(path);
+    if (!file || !file->Write(data) || !file->Commit()) {
+        Logger::Error("Failed to write edit session: ", path);
+        return false;
+    }
+    return true;
+}
+
+std::optional<EditSession> EditSession::Load(const std::filesystem::path& path) {
+    std::ifstream in(path, std::ios::binary);
+    if (!in) return std::nullopt;
+    const std::string data((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+
+    Reader header{data};
+    size_t size = 0;
+    if (header.data.size() < sizeof(MAGIC) || std::memcmp(header.data.data(), MAGIC, sizeof(MAGIC)) != 0) {
+        return std::nullopt;
+    }
+    header.data.remove_prefix(sizeof(MAGIC));
+    std::string raw;
+    if (!header.Get(size) || size / MAX_RATIO > header.data.size() || !DecompressBlock(header.data, size, raw)) {
+        Logger::Error("Corrupt edit session: ", path);
+        return std::nullopt;
+    }
+
+    Reader reader{raw};
+    EditSession session({}, {});
+    size_t count = 0;
+    if (!reader.Get(session.m_FileName) || !reader.Get(session.m_Text) || !reader.GetCount(count)) {
+        Logger::Error("Corrupt edit session: ", path);
+        return std::nullopt;
+    }
+    session.m_Steps.resize(count);
+    for (Step& step : session.m_Steps) {
+        uint64_t kind = 0;
+        bool ok = reader.Get(kind) && kind <= static_cast<uint64_t>(Kind::Completion) && reader.Get(step.delayUs);
+        step.kind = static_cast<Kind>(kind);
+        size_t edits = 0;
+        if (ok) {
+            switch (step.kind) {
+            case Kind::Edit:
+                ok = reader.GetCount(edits);
+                step.edits.resize(edits);
+                for (size_t i = 0; ok && i < edits; ++i) {
+                    TextEdit& edit = step.edits[i];
+                    ok = reader.Get(edit.pos) && reader.Get(edit.len) && reader.Get(edit.text);
+                }
+                break;
+            case Kind::Push:
+                ok = reader.Get(step.op, false);
+                break;
+            case Kind::Undo:
+            case Kind::Redo:
+                break;
+            case Kind::Highlight:
+                ok = reader.Get(step.first) && reader.Get(step.end);
+                break;
+            case Kind::Completion:
+                ok = reader.Get(step.prefix) && reader.Get(step.first);
+                break;
+            }
+        }
+        if (!ok) {
+            Logger::Error("Corrupt edit session: ", path);
+            return std::nullopt;
+        }
+    }
+    return session;
+}
+
+} // namespace sol
@@ -0,0 +1,76 @@
+#pragma once
+
+#include "text_buffer.h"
+#include "undo_tree.h"
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace sol {
+
+// An editing session on one buffer: the text it started from and each step
+// taken on it since, with the time from the step before, for replaying
+// headlessly. Buffer edits and undo history are recorded apart, so an undo
+// replays as the history step and then the edits that reversed it, and the
+// text replayed is the text recorded whatever the history merges.
+// File layout: MAGIC, the unpacked size as a varint, then one CompressBlock
+// of varints and length-prefixed strings: the file name, the initial text,
+// and per step its kind, microseconds since the step before and its fields.
+class EditSession {
+public:
+    static constexpr char MAGIC[8] = {'S', 'O', 'L', 'E', 'D', 'I', 'T', '1'};
+
+    enum class Kind : uint8_t {
+        Edit,        // The buffer edited
+        Push,        // An edit recorded in the undo history
+        Undo,
+        Redo,
+        Highlight,   // Lines highlighted for drawing
+        Completion,  // Words completing a prefix looked up
+    };
+
+    struct Step {
+        Kind kind = Kind::Edit;
+        uint64_t delayUs = 0;
+        std::vector<TextEdit> edits;  // Edit: sorted, positioned in the text before the step
+        EditOperation op{};           // Push
+        size_t first = 0;             // Highlight: lines [first, end); Completion: the cursor
+        size_t end = 0;
+        std::string prefix;           // Completion
+    };
+
+    EditSession(std::string fileName, std::string text);
+
+    void RecordEdits(std::span<const Rope::Edit> edits);
+    void RecordPush(const EditOperation& op);
+    void RecordUndo() { Begin(Kind::Undo); }
+    void RecordRedo() { Begin(Kind::Redo); }
+    // The same lines again with nothing done in between are left out
+    void RecordHighlight(size_t firstLine, size_t endLine);
+    void RecordCompletion(std::string_view prefix, size_t cursor);
+
+    bool Save(const std::filesystem::path& path) const;
+    // nullopt when the file is missing or not a session
+    static std::optional<EditSession> Load(const std::filesystem::path& path);
+
+    // Name of the file edited, which picks its language
+    const std::string& GetFileName() const { return m_FileName; }
+    const std::string& GetText() const { return m_Text; }
+    const std::vector<Step>& GetSteps() const { return m_Steps; }
+
+private:
+    Step& Begin(Kind kind);
+
+    std::string m_FileName;
+    std::string m_Text;
+    std::vector<Step> m_Steps;
+    std::chrono::steady_clock::time_point m_Last = std::chrono::steady_clock::now();
+};
+
+} // namespace sol
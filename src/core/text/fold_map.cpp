@@ -0,0 +1,65 @@
+#include "fold_map.h"
+#include <algorithm>
+
+namespace sol {
+
+void FoldMap::Build(const std::set<size_t>& folded, const std::map<size_t, size_t>& ends) {
+    std::vector<Run> previous = std::move(m_Runs);
+    m_Runs.clear();
+    m_Hidden = 0;
+    // Starts come in order, so a fold either extends the last run or opens one
+    for (size_t start : folded) {
+        auto end = ends.find(start);
+        if (end == ends.end() || end->second <= start) continue;
+        if (!m_Runs.empty() && start + 1 <= m_Runs.back().last + 1) {
+            Run& run = m_Runs.back();
+            if (end->second > run.last) {
+                m_Hidden += end->second - run.last;
+                run.last = end->second;
+            }
+            continue;
+        }
+        m_Runs.push_back({start + 1, end->second, m_Hidden});
+        m_Hidden += end->second - start;
+    }
+    if (m_Runs != previous) ++m_Version;
+}
+
+const FoldMap::Run* FoldMap::Find(size_t line) const {
+    auto it = std::upper_bound(m_Runs.begin(), m_Runs.end(), line,
+                               [](size_t value, const Run& run) { return value < run.first; });
+    return it == m_Runs.begin() ? nullptr : &*(it - 1);
+}
+
+bool FoldMap::IsHidden(size_t line) const {
+    const Run* run = Find(line);
+    return run && line <= run->last;
+}
+
+size_t FoldMap::NextVisible(size_t line) const {
+    const Run* run = Find(line);
+    return run && line <= run->last ? run->last + 1 : line;
+}
+
+size_t FoldMap::VisibleOwner(size_t line) const {
+    const Run* run = Find(line);
+    return run && line <= run->last ? run->first - 1 : line;
+}
+
+size_t FoldMap::LineToRow(size_t line) const {
+    const Run* run = Find(line);
+    if (!run) return line;
+    if (line <= run->last) return run->first - run->hiddenBefore;
+    return line - run->hiddenBefore - (run->last - run->first + 1);
+}
+
+size_t FoldMap::RowToLine(size_t row) const {
+    // A run's first line would sit on row first - hiddenBefore; those rows
+    // increase strictly, and the rows before the first run past row fall in
+    // the gap in front of it
+    auto it = std::upper_bound(m_Runs.begin(), m_Runs.end(), row,
+                               [](size_t value, const Run& run) { return value < run.first - run.hiddenBefore; });
+    return row + (it == m_Runs.end() ? m_Hidden : it->hiddenBefore);
+}
+
+} // namespace sol
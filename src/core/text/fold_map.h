@@ -0,0 +1,52 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <set>
+#include <vector>
+
+namespace sol {
+
+// The lines folds hide, as disjoint runs in line order that each know how
+// many lines the runs before them hide. Testing a line and mapping between
+// buffer lines and visible rows are then binary searches over the runs.
+// Rebuilt when the folded set changes, which is far rarer than lookups.
+class FoldMap {
+public:
+    // Each folded start hides the lines after it through its end, as ends
+    // gives them; nested and overlapping folds merge
+    void Build(const std::set<size_t>& folded, const std::map<size_t, size_t>& ends);
+
+    bool Empty() const { return m_Runs.empty(); }
+    // Changes whenever a build hides other lines than the one before
+    uint64_t GetVersion() const { return m_Version; }
+    size_t GetHiddenCount() const { return m_Hidden; }
+
+    bool IsHidden(size_t line) const;
+    // line when shown, otherwise the first shown line after its run
+    size_t NextVisible(size_t line) const;
+    // line when shown, otherwise the fold start it is hidden under
+    size_t VisibleOwner(size_t line) const;
+    // Shown lines before line
+    size_t LineToRow(size_t line) const;
+    // The shown line on row; rows past the last map past the last line
+    size_t RowToLine(size_t row) const;
+
+private:
+    struct Run {
+        size_t first = 0;
+        size_t last = 0;          // Inclusive
+        size_t hiddenBefore = 0;  // By the runs before
+        bool operator==(const Run&) const = default;
+    };
+
+    // The last run starting at or before line, or null
+    const Run* Find(size_t line) const;
+
+    std::vector<Run> m_Runs;
+    size_t m_Hidden = 0;
+    uint64_t m_Version = 0;
+};
+
+} // namespace sol
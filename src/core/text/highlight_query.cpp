@@ -0,0 +1,152 @@
+#include "highlight_query.h"
+#include "core/logger.h"
+#include <algorithm>
+
+namespace sol {
+
+namespace {
+
+// Capture names used by the bundled grammars' highlights.scm
+constexpr std::pair<std::string_view, HighlightGroup> CAPTURE_GROUPS[] = {
+    {"keyword", HighlightGroup::Keyword},
+    {"conditional", HighlightGroup::Keyword},
+    {"repeat", HighlightGroup::Keyword},
+    {"exception", HighlightGroup::Keyword},
+    {"include", HighlightGroup::Keyword},
+    {"storageclass", HighlightGroup::Keyword},
+    {"tag", HighlightGroup::Keyword},
+    {"variable.builtin", HighlightGroup::Keyword},
+    {"type", HighlightGroup::Type},
+    {"constructor", HighlightGroup::Type},
+    {"function", HighlightGroup::Function},
+    {"method", HighlightGroup::Function},
+    {"function.macro", HighlightGroup::Macro},
+    {"function.special", HighlightGroup::Macro},
+    {"macro", HighlightGroup::Macro},
+    {"preproc", HighlightGroup::Macro},
+    {"define", HighlightGroup::Macro},
+    {"attribute", HighlightGroup::Macro},
+    {"variable", HighlightGroup::Variable},
+    {"parameter", HighlightGroup::Variable},
+    {"property", HighlightGroup::Variable},
+    {"field", HighlightGroup::Variable},
+    {"string", HighlightGroup::String},
+    {"character", HighlightGroup::String},
+    {"string.escape", HighlightGroup::Constant},
+    {"escape", HighlightGroup::Constant},
+    {"number", HighlightGroup::Number},
+    {"float", HighlightGroup::Number},
+    {"boolean", HighlightGroup::Constant},
+    {"constant", HighlightGroup::Constant},
+    {"comment", HighlightGroup::Comment},
+    {"operator", HighlightGroup::Operator},
+    {"punctuation", HighlightGroup::Punctuation},
+    {"namespace", HighlightGroup::Namespace},
+    {"module", HighlightGroup::Namespace},
+    {"text.title", HighlightGroup::Keyword},
+    {"markup.heading", HighlightGroup::Keyword},
+    {"text.literal", HighlightGroup::String},
+    {"markup.raw", HighlightGroup::String},
+    {"text.uri", HighlightGroup::String},
+    {"markup.link", HighlightGroup::String},
+};
+
+HighlightGroup GroupForCapture(std::string_view name) {
+    while (!name.empty()) {
+        for (const auto& [capture, group] : CAPTURE_GROUPS) {
+            if (capture == name) return group;
+        }
+        size_t dot = name.rfind('.');
+        if (dot == std::string_view::npos) break;
+        name = name.substr(0, dot);
+    }
+    return HighlightGroup::None;
+}
+
+} // namespace
+
+std::unique_ptr<HighlightQuery> HighlightQuery::Compile(const TSLanguage* language, std::string_view source) {
+    if (!language || source.empty()) return nullptr;
+
+    uint32_t errorOffset = 0;
+    TSQueryError error = TSQueryErrorNone;
+    TSQuery* query = ts_query_new(language, source.data(), static_cast<uint32_t>(source.length()), &errorOffset, &error);
+    if (!query) {
+        Logger::Error("Invalid highlight query at offset ", errorOffset);
+        return nullptr;
+    }
+
+    std::unique_ptr<HighlightQuery> result(new HighlightQuery());
+    result->m_Query = query;
+
+    const uint32_t captureCount = ts_query_capture_count(query);
+    result->m_CaptureGroups.resize(captureCount);
+    for (uint32_t i = 0; i < captureCount; ++i) {
+        uint32_t length = 0;
+        const char* name = ts_query_capture_name_for_id(query, i, &length);
+        result->m_CaptureGroups[i] = static_cast<uint16_t>(GroupForCapture(std::string_view(name, length)));
+    }
+
+    result->m_Predicates.Compile(query);
+    return result;
+}
+
+HighlightQuery::~HighlightQuery() {
+    if (m_Query) ts_query_delete(m_Query);
+}
+
+void HighlightQuery::Captures(const Language& language, TSNode root, const Rope& text, uint32_t startByte, uint32_t endByte,
+                              std::vector<SyntaxToken>& out) const {
+    const size_t first = out.size();
+    TSQueryCursor* cursor = ts_query_cursor_new();
+    ts_query_cursor_set_byte_range(cursor, startByte, endByte);
+    ts_query_cursor_exec(cursor, m_Query, root);
+
+    TSQueryMatch match;
+    uint32_t captureIndex = 0;
+    while (ts_query_cursor_next_capture(cursor, &match, &captureIndex)) {
+        if (!m_Predicates.Accepts(match, text)) {
+            ts_query_cursor_remove_match(cursor, match.id);
+            continue;
+        }
+
+        const TSQueryCapture& capture = match.captures[captureIndex];
+        const uint16_t group = m_CaptureGroups[capture.index];
+        if (group == static_cast<uint16_t>(HighlightGroup::None)) continue;
+
+        TSNode node = capture.node;
+        const uint32_t nodeStart = ts_node_start_byte(node);
+        const uint32_t nodeEnd = ts_node_end_byte(node);
+        if (nodeStart >= nodeEnd) continue;
+
+        // Captures of one node arrive together in pattern order
+        if (out.size() > first && out.back().startByte == nodeStart && out.back().endByte == nodeEnd) continue;
+
+        const TSSymbol symbol = ts_node_symbol(node);
+        uint16_t depth = 0;
+        if (language.Symbol(symbol).bracket) {
+            for (TSNode parent = ts_node_parent(node); !ts_node_is_null(parent); parent = ts_node_parent(parent)) ++depth;
+        }
+        TSPoint sp = ts_node_start_point(node);
+        TSPoint ep = ts_node_end_point(node);
+        out.push_back(SyntaxToken{
+            .startByte = nodeStart,
+            .endByte = nodeEnd,
+            .startRow = sp.row,
+            .startCol = sp.column,
+            .endRow = ep.row,
+            .endCol = ep.column,
+            .symbol = symbol,
+            .highlightId = group,
+            .depth = depth
+        });
+    }
+    ts_query_cursor_delete(cursor);
+
+    std::stable_sort(out.begin() + first, out.end(), [](const SyntaxToken& a, const SyntaxToken& b) {
+        if (a.startByte != b.startByte) return a.startByte < b.startByte;
+        return a.endByte > b.endByte;
+    });
+}
+
+} // namespace sol
@@ -0,0 +1,42 @@
+#pragma once
+
+#include "text_buffer.h"
+#include "query_predicates.h"
+#include <tree_sitter/api.h>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace sol {
+
+// highlights.scm of a bundled grammar, embedded at build time; empty when the
+// grammar ships none
+std::string_view BundledHighlightQuery(std::string_view language);
+
+// A grammar's highlights.scm, compiled once per language. Capture names map
+// to highlight groups along their dotted prefixes ("function.method" falls
+// back to "function"), and text predicates are evaluated on the buffer.
+class HighlightQuery {
+public:
+    static std::unique_ptr<HighlightQuery> Compile(const TSLanguage* language, std::string_view source);
+    ~HighlightQuery();
+
+    HighlightQuery(const HighlightQuery&) = delete;
+    HighlightQuery& operator=(const HighlightQuery&) = delete;
+
+    // Appends captures overlapping [startByte, endByte) ordered by start,
+    // enclosing captures before the ones nested in them. A node captured by
+    // several patterns keeps the group of the first.
+    void Captures(const Language& language, TSNode root, const Rope& text, uint32_t startByte, uint32_t endByte,
+                  std::vector<SyntaxToken>& out) const;
+
+private:
+    HighlightQuery() = default;
+
+    TSQuery* m_Query = nullptr;
+    std::vector<uint16_t> m_CaptureGroups;  // HighlightGroup per capture id
+    QueryPredicates m_Predicates;
+};
+
+} // namespace sol
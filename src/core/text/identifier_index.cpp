@@ -0,0 +1,123 @@
+#include "identifier_index.h"
+#include <algorithm>
+#include <cctype>
+#include <unordered_map>
+
+namespace sol {
+
+namespace {
+
+// Lines scanned on each side of the cursor when ranking; matches further
+// away keep alphabetical order
+constexpr size_t RANK_RADIUS = 4096;
+
+void AppendLower(std::string& out, std::string_view text) {
+    for (char c : text) out.push_back(static_cast<char>(std::tolower(static_cast<unsigned char>(c))));
+}
+
+std::string_view WordOf(const std::string& key) {
+    return std::string_view(key).substr(key.find('\0') + 1);
+}
+
+} // namespace
+
+void IdentifierIndex::Reset(size_t lineCount) {
+    m_Words.clear();
+    m_Lines.assign(lineCount, {});
+    m_Indexed = 0;
+    m_TextLines = 0;
+}
+
+void IdentifierIndex::Clear(Line& line) {
+    for (WordMap::iterator word : line.words) {
+        if (--word->second == 0) m_Words.erase(word);
+    }
+    line.words.clear();
+    if (line.state != LineState::Stale) --m_Indexed;
+    if (line.state == LineState::Text) --m_TextLines;
+    line.state = LineState::Stale;
+}
+
+void IdentifierIndex::Shift(size_t firstRow, size_t oldEndRow, size_t newEndRow) {
+    if (firstRow >= m_Lines.size()) return;
+    oldEndRow = std::min(oldEndRow, m_Lines.size() - 1);
+    for (size_t i = firstRow; i <= oldEndRow; ++i) Clear(m_Lines[i]);
+
+    const size_t oldCount = oldEndRow - firstRow + 1;
+    const size_t newCount = newEndRow - firstRow + 1;
+    auto tail = m_Lines.begin() + static_cast<ptrdiff_t>(firstRow + std::min(oldCount, newCount));
+    if (newCount > oldCount) {
+        m_Lines.insert(tail, newCount - oldCount, Line{});
+    } else {
+        m_Lines.erase(tail, tail + static_cast<ptrdiff_t>(oldCount - newCount));
+    }
+}
+
+void IdentifierIndex::Invalidate(size_t firstRow, size_t lastRow) {
+    lastRow = std::min(lastRow + 1, m_Lines.size());
+    for (size_t i = firstRow; i < lastRow; ++i) Clear(m_Lines[i]);
+}
+
+void IdentifierIndex::SetLine(size_t line, const std::vector<std::string_view>& words, LineState state) {
+    Line& entry = m_Lines[line];
+    Clear(entry);
+
+    std::string key;
+    for (std::string_view word : words) {
+        key.clear();
+        AppendLower(key, word);
+        key.push_back('\0');
+        key.append(word);
+
+        auto it = m_Words.lower_bound(key);
+        if (it == m_Words.end() || it->first != key) it = m_Words.emplace_hint(it, key, 0);
+        // A word repeated on one line is referenced once
+        if (std::find(entry.words.begin(), entry.words.end(), it) != entry.words.end()) continue;
+        ++it->second;
+        entry.words.push_back(it);
+    }
+    entry.state = state;
+    ++m_Indexed;
+    if (state == LineState::Text) ++m_TextLines;
+}
+
+std::vector<std::string> IdentifierIndex::Complete(std::string_view prefix, size_t cursorLine) const {
+    std::string lowered;
+    AppendLower(lowered, prefix);
+
+    // Rank of each match, SIZE_MAX until it is seen near the cursor
+    std::unordered_map<const WordMap::value_type*, size_t> matches;
+    std::vector<WordMap::const_iterator> ordered;
+    for (auto it = m_Words.lower_bound(lowered); it != m_Words.end() && it->first.starts_with(lowered); ++it) {
+        // Keys of words shorter than the prefix hold the NUL where it differs
+        if (WordOf(it->first) == prefix) continue;
+        matches.emplace(&*it, SIZE_MAX);
+        ordered.push_back(it);
+    }
+
+    std::vector<std::string> result;
+    result.reserve(ordered.size());
+    if (ordered.size() > 1 && !m_Lines.empty()) {
+        auto visit = [&](const Line& line) {
+            for (WordMap::const_iterator word : line.words) {
+                auto match = matches.find(&*word);
+                if (match != matches.end() && match->second == SIZE_MAX) {
+                    match->second = result.size();
+                    result.emplace_back(WordOf(word->first));
+                }
+            }
+        };
+        cursorLine = std::min(cursorLine, m_Lines.size() - 1);
+        for (size_t distance = 0; distance <= RANK_RADIUS && result.size() < ordered.size(); ++distance) {
+            if (distance > cursorLine && cursorLine + distance >= m_Lines.size()) break;
+            if (distance <= cursorLine) visit(m_Lines[cursorLine - distance]);
+            if (distance > 0 && cursorLine + distance < m_Lines.size()) visit(m_Lines[cursorLine + distance]);
+        }
+    }
+    for (WordMap::const_iterator it : ordered) {
+        if (matches[&*it] == SIZE_MAX) result.emplace_back(WordOf(it->first));
+    }
+    return result;
+}
+
+} // namespace sol
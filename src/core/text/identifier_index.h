@@ -0,0 +1,54 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace sol {
+
+// Words of a buffer for built-in completion. Each distinct word is interned
+// once, ref-counted by the lines it occurs on and sorted case-insensitively,
+// so a prefix query is a single range lookup and an edit re-indexes only the
+// lines it touched.
+class IdentifierIndex {
+public:
+    // How a line was indexed: Text takes every word, Syntax only identifier
+    // nodes of a current tree
+    enum class LineState : uint8_t { Stale, Text, Syntax };
+
+    void Reset(size_t lineCount);  // Every line stale
+    size_t LineCount() const { return m_Lines.size(); }
+    LineState GetState(size_t line) const { return m_Lines[line].state; }
+    bool IsComplete() const { return m_Indexed == m_Lines.size(); }
+    bool HasTextLines() const { return m_TextLines > 0; }
+
+    // Rows [firstRow, oldEndRow] became [firstRow, newEndRow]; those are stale
+    void Shift(size_t firstRow, size_t oldEndRow, size_t newEndRow);
+    void Invalidate(size_t firstRow, size_t lastRow);
+    void SetLine(size_t line, const std::vector<std::string_view>& words, LineState state);
+
+    // Words starting with prefix (ignoring case) other than prefix itself,
+    // nearest occurrence to cursorLine first
+    std::vector<std::string> Complete(std::string_view prefix, size_t cursorLine) const;
+
+private:
+    // Key is the lowercased word, a NUL, then the word; the value counts lines
+    using WordMap = std::map<std::string, uint32_t, std::less<>>;
+
+    struct Line {
+        std::vector<WordMap::iterator> words;
+        LineState state = LineState::Stale;
+    };
+
+    void Clear(Line& line);
+
+    WordMap m_Words;
+    std::vector<Line> m_Lines;
+    size_t m_Indexed = 0;    // Lines not stale
+    size_t m_TextLines = 0;
+};
+
+} // namespace sol
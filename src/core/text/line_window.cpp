@@ -0,0 +1,51 @@
+#include "line_window.h"
+
+namespace sol {
+
+void LineWindow::Prepare(const Rope& rope, size_t firstLine, size_t lastLine) {
+    if (!rope.IsLargeFile()) {
+        if (!m_Starts.empty()) Release();
+        return;
+    }
+    const size_t first = firstLine > PADDING_LINES ? firstLine - PADDING_LINES : 0;
+    const size_t last = std::min(lastLine + PADDING_LINES, rope.LineCount());
+    if (rope.SharesText(m_Snapshot) && !m_Starts.empty() && first >= m_FirstLine && last + 1 <= m_FirstLine + m_Starts.size()) {
+        return;
+    }
+
+    m_Snapshot = rope.Snapshot();
+    m_FirstLine = first;
+    const size_t start = rope.LineStart(first);
+    const size_t end = std::max(start, last < rope.LineCount() ? rope.LineStart(last) : rope.Length());
+    m_Text.clear();
+    m_Text.reserve(end - start);
+    m_Starts.clear();
+    m_Starts.push_back(0);
+    rope.ForEachChunk(start, end, [&](std::string_view chunk) {
+        for (size_t pos = chunk.find('\n'); pos != std::string_view::npos; pos = chunk.find('\n', pos + 1)) {
+            m_Starts.push_back(m_Text.size() + pos + 1);
+        }
+        m_Text.append(chunk);
+    });
+    // Short only when the range runs to the end of the text
+    m_Starts.resize(last - first + 1, m_Text.size());
+}
+
+std::string_view LineWindow::Line(const Rope& rope, size_t lineNum) const {
+    if (lineNum < m_FirstLine || lineNum + 1 >= m_FirstLine + m_Starts.size() || !rope.SharesText(m_Snapshot)) {
+        return rope.LineView(lineNum);
+    }
+    const size_t index = lineNum - m_FirstLine;
+    size_t end = m_Starts[index + 1];
+    if (end > m_Starts[index] && m_Text[end - 1] == '\n') --end;
+    return std::string_view(m_Text).substr(m_Starts[index], end - m_Starts[index]);
+}
+
+void LineWindow::Release() {
+    m_Snapshot = Rope();
+    m_FirstLine = 0;
+    std::string().swap(m_Text);
+    std::vector<size_t>().swap(m_Starts);
+}
+
+} // namespace sol
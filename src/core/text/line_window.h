@@ -0,0 +1,34 @@
+#pragma once
+
+#include "rope.h"
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace sol {
+
+// One view's copy of the lines around what it shows of a large rope, so
+// reading them skips the tree. It holds a snapshot of the rope it copied
+// from, and lines are served from the copy only while the rope still shares
+// that tree; each split keeps its own, so views of one buffer never evict
+// each other. Ropes small enough to keep contiguous text need none.
+class LineWindow {
+public:
+    // Covers [firstLine, lastLine) with some padding, copying only when the
+    // rope changed or the lines fall outside the copy
+    void Prepare(const Rope& rope, size_t firstLine, size_t lastLine);
+    // The line without its newline, valid until the next Prepare or edit
+    std::string_view Line(const Rope& rope, size_t lineNum) const;
+    void Release();
+
+private:
+    static constexpr size_t PADDING_LINES = 50;
+
+    Rope m_Snapshot;
+    size_t m_FirstLine = 0;
+    std::string m_Text;
+    std::vector<size_t> m_Starts;  // Offsets in m_Text of each line copied, then its end
+};
+
+} // namespace sol
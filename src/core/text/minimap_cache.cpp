@@ -0,0 +1,137 @@
+#include "minimap_cache.h"
+#include "text_buffer.h"
+#include <algorithm>
+#include <limits>
+#include <string>
+
+namespace sol {
+
+bool MinimapCache::Update(TextBuffer& buffer, size_t maxRows, size_t columns, size_t tabSize, size_t budget) {
+    maxRows = std::max<size_t>(maxRows, 1);
+    columns = std::clamp<size_t>(columns, 1, std::numeric_limits<uint16_t>::max());
+    tabSize = std::max<size_t>(tabSize, 1);
+    const size_t lines = buffer.LineCount();
+    size_t linesPerRow = 1;
+    while ((lines + linesPerRow - 1) / linesPerRow > maxRows) linesPerRow <<= 1;
+    const size_t rows = (lines + linesPerRow - 1) / linesPerRow;
+    if (&buffer != m_Buffer || linesPerRow != m_LinesPerRow || columns != m_Columns || tabSize != m_TabSize ||
+        !CatchUp(buffer, rows)) {
+        m_Buffer = &buffer;
+        m_LinesPerRow = linesPerRow;
+        m_Columns = columns;
+        m_TabSize = tabSize;
+        Reset(buffer, rows);
+    }
+
+    // Stale rows next to each other are highlighted in one pass when each
+    // row is a line
+    for (size_t row = 0; row < m_Rows.size() && m_Stale > 0 && budget > 0;) {
+        if (!m_Rows[row].stale) {
+            ++row;
+            continue;
+        }
+        size_t end = row;
+        while (end < m_Rows.size() && end - row < budget && m_Rows[end].stale) ++end;
+        budget -= end - row;
+        if (m_LinesPerRow == 1) buffer.UpdateHighlights(row, end);
+        for (; row < end; ++row) {
+            if (m_LinesPerRow > 1) buffer.UpdateHighlights(row * m_LinesPerRow, row * m_LinesPerRow + 1);
+            Build(buffer, row);
+        }
+    }
+    return m_Stale == 0;
+}
+
+// Rows kept from before show until rebuilt, so the picture never blanks
+void MinimapCache::Reset(const TextBuffer& buffer, size_t rows) {
+    m_LineVersion = buffer.GetLineVersion();
+    m_Rows.resize(rows);
+    for (Row& row : m_Rows) row.stale = true;
+    m_Stale = rows;
+}
+
+bool MinimapCache::CatchUp(const TextBuffer& buffer, size_t rows) {
+    if (m_LineVersion != buffer.GetLineVersion()) {
+        std::vector<TextBuffer::LineShift> shifts;
+        if (!buffer.GetLineShiftsSince(m_LineVersion, shifts)) return false;
+        m_LineVersion = buffer.GetLineVersion();
+        for (const auto& [first, oldLast, newLast] : shifts) {
+            if (oldLast < first || newLast < first) return false;
+            if (oldLast == newLast) {
+                MarkStale(first / m_LinesPerRow, oldLast / m_LinesPerRow + 1);
+                continue;
+            }
+            // Lines after the edit move between bands, so every band from
+            // it on samples another line
+            if (m_LinesPerRow > 1) {
+                MarkStale(first / m_LinesPerRow, m_Rows.size());
+                continue;
+            }
+            if (oldLast >= m_Rows.size()) return false;
+            const size_t oldCount = oldLast - first + 1;
+            const size_t newCount = newLast - first + 1;
+            MarkStale(first, first + std::min(oldCount, newCount));
+            auto tail = m_Rows.begin() + first + std::min(oldCount, newCount);
+            if (newCount > oldCount) {
+                m_Rows.insert(tail, newCount - oldCount, Row{});
+                m_Stale += newCount - oldCount;
+            } else {
+                auto erased = tail + (oldCount - newCount);
+                m_Stale -= static_cast<size_t>(std::count_if(tail, erased, [](const Row& row) { return row.stale; }));
+                m_Rows.erase(tail, erased);
+            }
+        }
+    }
+    if (m_Rows.size() == rows) return true;
+    if (m_LinesPerRow == 1) return false;
+    if (rows < m_Rows.size()) {
+        m_Stale -= static_cast<size_t>(std::count_if(m_Rows.begin() + rows, m_Rows.end(), [](const Row& row) { return row.stale; }));
+    } else {
+        m_Stale += rows - m_Rows.size();
+    }
+    m_Rows.resize(rows);
+    return true;
+}
+
+void MinimapCache::MarkStale(size_t first, size_t end) {
+    for (size_t row = first; row < std::min(end, m_Rows.size()); ++row) {
+        if (!m_Rows[row].stale) {
+            m_Rows[row].stale = true;
+            ++m_Stale;
+        }
+    }
+}
+
+// Blanks end runs, so words show as dashes with gaps between them
+void MinimapCache::Build(const TextBuffer& buffer, size_t row) {
+    Row& out = m_Rows[row];
+    out.runs.clear();
+    if (out.stale) {
+        out.stale = false;
+        --m_Stale;
+    }
+
+    // A byte takes a cell at least, so more than a row's width is never read
+    const size_t line = row * m_LinesPerRow;
+    const size_t start = buffer.LineStart(line);
+    const std::string text = buffer.Substring(start, std::min(buffer.LineEnd(line) - start, m_Columns));
+    const std::span<const HighlightSpan> spans = buffer.GetLineHighlights(line);
+    auto span = spans.begin();
+    size_t cell = 0;
+    for (size_t i = 0; i < text.size() && cell < m_Columns; ++i) {
+        if (text[i] == ' ' || text[i] == '\t' || text[i] == '\r') {
+            cell += text[i] == '\t' ? m_TabSize : 1;
+            continue;
+        }
+        while (span != spans.end() && span->end <= i) ++span;
+        const uint16_t group = span != spans.end() && span->start <= i ? span->highlightId : 0;
+        if (!out.runs.empty() && out.runs.back().last == cell && out.runs.back().group == group) {
+            ++out.runs.back().last;
+        } else {
+            out.runs.push_back({static_cast<uint16_t>(cell), static_cast<uint16_t>(cell + 1), group});
+        }
+        ++cell;
+    }
+}
+
+} // namespace sol
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+namespace sol {
+
+class TextBuffer;
+
+// A downsampled picture of a buffer for drawing a minimap: one row per band
+// of lines, each the colored runs of cells its first line fills. Bands are as
+// few lines as a power of two allows while the rows still fit in maxRows, so
+// a huge buffer highlights only the lines it samples. Updates replay the
+// buffer's line shifts and mark just the rows they touched stale; stale rows
+// keep their old runs until rebuilt, at most budget of them per update. A
+// byte takes a cell and a tab tabSize of them, as the editor draws them.
+class MinimapCache {
+public:
+    struct Run {
+        uint16_t first = 0;  // Cells [first, last)
+        uint16_t last = 0;
+        uint16_t group = 0;  // HighlightGroup, 0 for plain text
+    };
+
+    // True once every row is current
+    bool Update(TextBuffer& buffer, size_t maxRows, size_t columns, size_t tabSize, size_t budget);
+
+    size_t GetRowCount() const { return m_Rows.size(); }
+    size_t GetLinesPerRow() const { return m_LinesPerRow; }
+    std::span<const Run> GetRow(size_t row) const { return m_Rows[row].runs; }
+
+private:
+    struct Row {
+        std::vector<Run> runs;
+        bool stale = true;
+    };
+
+    void Reset(const TextBuffer& buffer, size_t rows);
+    // False when the shifts can no longer be replayed
+    bool CatchUp(const TextBuffer& buffer, size_t rows);
+    void MarkStale(size_t first, size_t end);
+    void Build(const TextBuffer& buffer, size_t row);
+
+    const TextBuffer* m_Buffer = nullptr;
+    uint64_t m_LineVersion = 0;
+    size_t m_LinesPerRow = 1;
+    size_t m_Columns = 0;
+    size_t m_TabSize = 0;
+    size_t m_Stale = 0;
+    std::vector<Row> m_Rows;
+};
+
+} // namespace sol
@@ -0,0 +1,64 @@
+#include "parser_pool.h"
+#include "core/job_system.h"
+#include <tree_sitter/api.h>
+
+namespace sol {
+
+ParserPool& ParserPool::GetInstance() {
+    static ParserPool instance;
+    return instance;
+}
+
+ParserPool::~ParserPool() {
+    for (auto& [language, parsers] : m_Idle) {
+        for (TSParser* parser : parsers) ts_parser_delete(parser);
+    }
+}
+
+void ParserPool::Lease::Reset() {
+    if (!m_Parser) return;
+    ParserPool::GetInstance().Release(std::exchange(m_Parser, nullptr), m_Language);
+}
+
+ParserPool::Lease ParserPool::Acquire(const TSLanguage* language) {
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        std::vector<TSParser*>& idle = m_Idle[language];
+        if (!idle.empty()) {
+            TSParser* parser = idle.back();
+            idle.pop_back();
+            --m_IdleCount;
+            return Lease(parser, language);
+        }
+        ++m_Parsers;
+    }
+    TSParser* parser = ts_parser_new();
+    ts_parser_set_language(parser, language);
+    return Lease(parser, language);
+}
+
+// Every worker and the main thread may parse the language at once; parsers
+// beyond that are only needed by parses halted between slices
+void ParserPool::Release(TSParser* parser, const TSLanguage* language) {
+    ts_parser_reset(parser);
+    ts_parser_set_cancellation_flag(parser, nullptr);
+    ts_parser_set_timeout_micros(parser, 0);
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        std::vector<TSParser*>& idle = m_Idle[language];
+        if (idle.size() <= JobSystem::GetWorkerCount()) {
+            idle.push_back(parser);
+            ++m_IdleCount;
+            return;
+        }
+        --m_Parsers;
+    }
+    ts_parser_delete(parser);
+}
+
+ParserPool::Stats ParserPool::GetStats() const {
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    return {m_Parsers, m_IdleCount};
+}
+
+} // namespace sol
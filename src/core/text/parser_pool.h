@@ -0,0 +1,76 @@
+#pragma once
+
+#include <cstddef>
+#include <mutex>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// Forward declare tree-sitter types
+extern "C" {
+    typedef struct TSParser TSParser;
+    typedef struct TSLanguage TSLanguage;
+}
+
+namespace sol {
+
+// Tree-sitter parsers shared by every buffer. A parse leases one set to its
+// language and hands it back when done, so there are only as many parsers
+// as parses running at once, plus a few idle per language for the next.
+class ParserPool {
+public:
+    static ParserPool& GetInstance();
+    
+    ParserPool(const ParserPool&) = delete;
+    ParserPool& operator=(const ParserPool&) = delete;
+    
+    // A parser set to the language with no timeout or cancellation flag,
+    // returned to the pool, reset, when the lease ends
+    class Lease {
+    public:
+        Lease() = default;
+        Lease(Lease&& other) noexcept
+            : m_Parser(std::exchange(other.m_Parser, nullptr)), m_Language(other.m_Language) {}
+        Lease& operator=(Lease&& other) noexcept {
+            if (this != &other) {
+                Reset();
+                m_Parser = std::exchange(other.m_Parser, nullptr);
+                m_Language = other.m_Language;
+            }
+            return *this;
+        }
+        ~Lease() { Reset(); }
+        
+        TSParser* Get() const { return m_Parser; }
+        explicit operator bool() const { return m_Parser != nullptr; }
+        void Reset();
+        
+    private:
+        friend class ParserPool;
+        Lease(TSParser* parser, const TSLanguage* language) : m_Parser(parser), m_Language(language) {}
+        
+        TSParser* m_Parser = nullptr;
+        const TSLanguage* m_Language = nullptr;
+    };
+    
+    Lease Acquire(const TSLanguage* language);
+    
+    struct Stats {
+        size_t parsers = 0;  // Leased and idle
+        size_t idle = 0;
+    };
+    Stats GetStats() const;
+    
+private:
+    ParserPool() = default;
+    ~ParserPool();
+    
+    void Release(TSParser* parser, const TSLanguage* language);
+    
+    mutable std::mutex m_Mutex;
+    std::unordered_map<const TSLanguage*, std::vector<TSParser*>> m_Idle;
+    size_t m_Parsers = 0;
+    size_t m_IdleCount = 0;
+};
+
+} // namespace sol
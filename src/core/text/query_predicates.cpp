@@ -0,0 +1,118 @@
+#include "query_predicates.h"
+#include "core/logger.h"
+#include <algorithm>
+#include <cstdint>
+
+namespace sol {
+
+namespace {
+
+std::string NodeText(const Rope& text, TSNode node) {
+    uint32_t start = ts_node_start_byte(node);
+    return text.Substring(start, ts_node_end_byte(node) - start);
+}
+
+} // namespace
+
+void QueryPredicates::Compile(const TSQuery* query) {
+    const uint32_t patternCount = ts_query_pattern_count(query);
+    m_Predicates.assign(patternCount, {});
+    m_Disabled.assign(patternCount, false);
+    for (uint32_t pattern = 0; pattern < patternCount; ++pattern) {
+        m_Disabled[pattern] = !CompilePattern(query, pattern);
+    }
+}
+
+// Predicates arrive as flat step lists: name, arguments, Done
+bool QueryPredicates::CompilePattern(const TSQuery* query, uint32_t pattern) {
+    uint32_t stepCount = 0;
+    const TSQueryPredicateStep* steps = ts_query_predicates_for_pattern(query, pattern, &stepCount);
+    auto stringValue = [query](const TSQueryPredicateStep& step) {
+        uint32_t length = 0;
+        const char* value = ts_query_string_value_for_id(query, step.value_id, &length);
+        return std::string(value, length);
+    };
+
+    uint32_t begin = 0;
+    while (begin < stepCount) {
+        uint32_t end = begin;
+        while (end < stepCount && steps[end].type != TSQueryPredicateStepTypeDone) ++end;
+        const uint32_t argCount = end - begin;
+        const TSQueryPredicateStep* args = steps + begin;
+        const uint32_t next = end + 1;
+
+        if (argCount < 3 || args[0].type != TSQueryPredicateStepTypeString || args[1].type != TSQueryPredicateStepTypeCapture) {
+            begin = next;
+            continue;
+        }
+        std::string name = stringValue(args[0]);
+        Predicate predicate{Predicate::Op::Eq, name.starts_with("not-"), args[1].value_id, UINT32_MAX, {}, {}};
+        if (predicate.negate) name.erase(0, 4);
+
+        if (name == "eq?") {
+            if (args[2].type == TSQueryPredicateStepTypeCapture) {
+                predicate.otherCapture = args[2].value_id;
+            } else {
+                predicate.values.push_back(stringValue(args[2]));
+            }
+        } else if (name == "match?") {
+            predicate.op = Predicate::Op::Match;
+            try {
+                predicate.regex = std::regex(stringValue(args[2]), std::regex::ECMAScript | std::regex::optimize);
+            } catch (const std::regex_error&) {
+                Logger::Error("Unsupported query regex: ", stringValue(args[2]));
+                return false;
+            }
+        } else if (name == "any-of?") {
+            predicate.op = Predicate::Op::AnyOf;
+            for (uint32_t i = 2; i < argCount; ++i) {
+                if (args[i].type == TSQueryPredicateStepTypeString) predicate.values.push_back(stringValue(args[i]));
+            }
+        } else {
+            begin = next;
+            continue;
+        }
+        m_Predicates[pattern].push_back(std::move(predicate));
+        begin = next;
+    }
+    return true;
+}
+
+bool QueryPredicates::Accepts(const TSQueryMatch& match, const Rope& text) const {
+    if (m_Disabled[match.pattern_index]) return false;
+    
+    auto find = [&match](uint32_t capture) -> const TSQueryCapture* {
+        for (uint16_t i = 0; i < match.capture_count; ++i) {
+            if (match.captures[i].index == capture) return &match.captures[i];
+        }
+        return nullptr;
+    };
+
+    for (const Predicate& predicate : m_Predicates[match.pattern_index]) {
+        const TSQueryCapture* capture = find(predicate.capture);
+        if (!capture) continue;
+        std::string value = NodeText(text, capture->node);
+
+        bool result = false;
+        switch (predicate.op) {
+            case Predicate::Op::Eq:
+                if (predicate.otherCapture != UINT32_MAX) {
+                    const TSQueryCapture* other = find(predicate.otherCapture);
+                    result = other && NodeText(text, other->node) == value;
+                } else {
+                    result = value == predicate.values.front();
+                }
+                break;
+            case Predicate::Op::Match:
+                result = std::regex_search(value, predicate.regex);
+                break;
+            case Predicate::Op::AnyOf:
+                result = std::find(predicate.values.begin(), predicate.values.end(), value) != predicate.values.end();
+                break;
+        }
+        if (result == predicate.negate) return false;
+    }
+    return true;
+}
+
+} // namespace sol
@@ -0,0 +1,38 @@
+#pragma once
+
+#include "rope.h"
+#include <tree_sitter/api.h>
+#include <regex>
+#include <string>
+#include <vector>
+
+namespace sol {
+
+// The text predicates tree-sitter leaves to its host (#eq?, #match?,
+// #any-of? and their not- forms), compiled once per query pattern. Ones that
+// do not affect which text matches (#set!, #is?, #strip! ...) are skipped.
+class QueryPredicates {
+public:
+    void Compile(const TSQuery* query);
+    
+    // A match stands if its pattern compiled and its predicates hold on text
+    bool Accepts(const TSQueryMatch& match, const Rope& text) const;
+    
+private:
+    struct Predicate {
+        enum class Op { Eq, Match, AnyOf };
+        Op op;
+        bool negate;
+        uint32_t capture;
+        uint32_t otherCapture;  // #eq? against a second capture, or UINT32_MAX
+        std::vector<std::string> values;
+        std::regex regex;
+    };
+    
+    bool CompilePattern(const TSQuery* query, uint32_t pattern);
+    
+    std::vector<std::vector<Predicate>> m_Predicates;  // Per pattern
+    std::vector<bool> m_Disabled;                      // Patterns with predicates we could not compile
+};
+
+} // namespace sol
@@ -0,0 +1,893 @@
+#include "regex.h"
+#include "text_scan.h"
+#include <algorithm>
+#include <cctype>
+
+namespace sol {
+
+namespace {
+
+constexpr size_t MAX_PROGRAM = 1 << 16;
+constexpr int MAX_REPEAT = 1000;
+constexpr int MAX_NESTING = 256;
+constexpr uint32_t MAX_CODEPOINT = 0x10FFFF;
+constexpr size_t CACHE_BYTES = 2 * 1024 * 1024;  // Transition tables per matcher
+
+// Context bits of a DFA state: what the byte before its position was
+constexpr uint8_t AFTER_NEWLINE = 1;  // Also the start of the text
+constexpr uint8_t AFTER_WORD = 2;
+
+using Ranges = std::vector<std::pair<uint32_t, uint32_t>>;
+using ByteSequence = std::vector<std::pair<uint8_t, uint8_t>>;
+
+bool IsWordByte(int c) {
+    return (c >= '0' && c <= '9') || (c >= 'A' && c <= 'Z') || (c >= 'a' && c <= 'z') || c == '_';
+}
+
+void Normalize(Ranges& ranges) {
+    std::sort(ranges.begin(), ranges.end());
+    size_t out = 0;
+    for (const auto& range : ranges) {
+        if (out > 0 && range.first <= ranges[out - 1].second + 1) {
+            ranges[out - 1].second = std::max(ranges[out - 1].second, range.second);
+        } else {
+            ranges[out++] = range;
+        }
+    }
+    ranges.resize(out);
+}
+
+void Negate(Ranges& ranges) {
+    Ranges inverse;
+    uint32_t next = 0;
+    for (const auto& [lo, hi] : ranges) {
+        if (lo > next) inverse.emplace_back(next, lo - 1);
+        next = hi + 1;
+    }
+    if (next <= MAX_CODEPOINT) inverse.emplace_back(next, MAX_CODEPOINT);
+    ranges = std::move(inverse);
+}
+
+void AddOtherCase(Ranges& ranges) {
+    const size_t count = ranges.size();
+    for (size_t i = 0; i < count; ++i) {
+        auto [lo, hi] = ranges[i];
+        uint32_t from = std::max<uint32_t>(lo, 'a'), to = std::min<uint32_t>(hi, 'z');
+        if (from <= to) ranges.emplace_back(from - 32, to - 32);
+        from = std::max<uint32_t>(lo, 'A');
+        to = std::min<uint32_t>(hi, 'Z');
+        if (from <= to) ranges.emplace_back(from + 32, to + 32);
+    }
+}
+
+size_t EncodeUtf8(uint32_t cp, uint8_t* out) {
+    if (cp < 0x80) {
+        out[0] = static_cast<uint8_t>(cp);
+        return 1;
+    }
+    if (cp < 0x800) {
+        out[0] = static_cast<uint8_t>(0xC0 | (cp >> 6));
+        out[1] = static_cast<uint8_t>(0x80 | (cp & 0x3F));
+        return 2;
+    }
+    if (cp < 0x10000) {
+        out[0] = static_cast<uint8_t>(0xE0 | (cp >> 12));
+        out[1] = static_cast<uint8_t>(0x80 | ((cp >> 6) & 0x3F));
+        out[2] = static_cast<uint8_t>(0x80 | (cp & 0x3F));
+        return 3;
+    }
+    out[0] = static_cast<uint8_t>(0xF0 | (cp >> 18));
+    out[1] = static_cast<uint8_t>(0x80 | ((cp >> 12) & 0x3F));
+    out[2] = static_cast<uint8_t>(0x80 | ((cp >> 6) & 0x3F));
+    out[3] = static_cast<uint8_t>(0x80 | (cp & 0x3F));
+    return 4;
+}
+
+// Splits [lo, hi] until each piece encodes as one sequence of byte ranges
+void AppendUtf8Sequences(uint32_t lo, uint32_t hi, std::vector<ByteSequence>& out) {
+    if (lo > hi) return;
+    static constexpr uint32_t LENGTH_MAX[] = {0x7F, 0x7FF, 0xFFFF};
+    for (uint32_t max : LENGTH_MAX) {
+        if (lo <= max && hi > max) {
+            AppendUtf8Sequences(lo, max, out);
+            AppendUtf8Sequences(max + 1, hi, out);
+            return;
+        }
+    }
+    for (int i = 1; i < 4; ++i) {
+        const uint32_t m = (1u << (6 * i)) - 1;
+        if ((lo & ~m) != (hi & ~m)) {
+            if ((lo & m) != 0) {
+                AppendUtf8Sequences(lo, lo | m, out);
+                AppendUtf8Sequences((lo | m) + 1, hi, out);
+                return;
+            }
+            if ((hi & m) != m) {
+                AppendUtf8Sequences(lo, (hi & ~m) - 1, out);
+                AppendUtf8Sequences(hi & ~m, hi, out);
+                return;
+            }
+        }
+    }
+    uint8_t a[4], b[4];
+    const size_t n = EncodeUtf8(lo, a);
+    EncodeUtf8(hi, b);
+    ByteSequence sequence;
+    for (size_t i = 0; i < n; ++i) sequence.emplace_back(a[i], b[i]);
+    out.push_back(std::move(sequence));
+}
+
+size_t LengthOf(const Rope& text) { return text.Length(); }
+size_t LengthOf(std::string_view text) { return text.length(); }
+
+// The contiguous text from pos, non-empty while pos < length
+std::string_view PieceAt(const Rope& text, size_t pos) {
+    Rope::ChunkIterator it = text.ChunkAt(pos);
+    while (it.Valid() && pos - it.Offset() >= (*it).length()) ++it;
+    return it.Valid() ? (*it).substr(pos - it.Offset()) : std::string_view();
+}
+std::string_view PieceAt(std::string_view text, size_t pos) { return text.substr(pos); }
+
+unsigned char ByteAt(const Rope& text, size_t pos) { return static_cast<unsigned char>(text.At(pos)); }
+unsigned char ByteAt(std::string_view text, size_t pos) { return static_cast<unsigned char>(text[pos]); }
+
+size_t LineStartOf(const Rope& text, size_t pos) {
+    for (Rope::ChunkIterator it = text.ChunkAt(pos); it.Valid(); --it) {
+        std::string_view chunk = (*it).substr(0, pos > it.Offset() ? pos - it.Offset() : 0);
+        size_t newline = chunk.rfind('\n');
+        if (newline != std::string_view::npos) return it.Offset() + newline + 1;
+        if (it.Offset() == 0) break;
+    }
+    return 0;
+}
+size_t LineStartOf(std::string_view text, size_t pos) {
+    size_t newline = pos > 0 ? text.rfind('\n', pos - 1) : std::string_view::npos;
+    return newline == std::string_view::npos ? 0 : newline + 1;
+}
+
+// First occurrence of needle at or after from, or npos. Text pieces are
+// searched in place; a needle straddling two is found through a seam of the
+// bytes around the boundary.
+template <typename Text>
+size_t FindLiteral(const Text& text, std::string_view needle, bool folded, size_t from) {
+    auto find = [&](std::string_view haystack) {
+        return folded ? FindFolded(haystack, needle) : haystack.find(needle);
+    };
+    const size_t keep = needle.length() - 1;
+    const size_t length = LengthOf(text);
+    std::string seam;
+    for (size_t pos = from; pos < length;) {
+        std::string_view piece = PieceAt(text, pos);
+        if (piece.empty()) break;
+        if (!seam.empty()) {
+            const size_t tail = seam.length();
+            seam.append(piece.substr(0, keep));
+            size_t hit = find(seam);
+            if (hit < tail) return pos - tail + hit;
+            seam.resize(tail);
+        }
+        size_t hit = find(piece);
+        if (hit != std::string_view::npos) return pos + hit;
+        if (piece.length() >= keep) {
+            seam.assign(piece.substr(piece.length() - keep));
+        } else {
+            seam.append(piece);
+            if (seam.length() > keep) seam.erase(0, seam.length() - keep);
+        }
+        pos += piece.length();
+    }
+    return std::string_view::npos;
+}
+
+uint8_t ContextAfter(int c) {
+    return (c == '\n' ? AFTER_NEWLINE : 0) | (IsWordByte(c) ? AFTER_WORD : 0);
+}
+
+template <typename Text>
+uint8_t ContextBefore(const Text& text, size_t pos) {
+    return pos == 0 ? AFTER_NEWLINE : ContextAfter(ByteAt(text, pos - 1));
+}
+
+} // namespace
+
+struct Regex::Node {
+    enum class Kind : uint8_t { Empty, Class, Concat, Alternate, Repeat, Assert };
+    Kind kind = Kind::Empty;
+    Ranges ranges;  // Class: sorted, merged code point ranges
+    std::vector<Node> children;
+    int min = 0;
+    int max = 0;    // Repeat: negative is unbounded
+    Assertion assertion = Assertion::LineStart;
+};
+
+class Regex::Parser {
+public:
+    Parser(std::string_view pattern, bool ignoreCase) : m_Pattern(pattern), m_IgnoreCase(ignoreCase) {}
+
+    bool Parse(Node& root, std::string& error) {
+        if (!Alternation(root)) {
+            error = m_Error;
+            return false;
+        }
+        if (m_Pos < m_Pattern.length()) {
+            error = "unmatched )";
+            return false;
+        }
+        return true;
+    }
+
+private:
+    bool Fail(const char* message) {
+        m_Error = message;
+        return false;
+    }
+
+    bool AtEnd() const { return m_Pos >= m_Pattern.length(); }
+    char Peek() const { return m_Pattern[m_Pos]; }
+
+    bool Alternation(Node& out) {
+        if (++m_Depth > MAX_NESTING) return Fail("pattern nested too deeply");
+        Node first;
+        if (!Sequence(first)) return false;
+        if (AtEnd() || Peek() != '|') {
+            out = std::move(first);
+            --m_Depth;
+            return true;
+        }
+        out.kind = Node::Kind::Alternate;
+        out.children.push_back(std::move(first));
+        while (!AtEnd() && Peek() == '|') {
+            ++m_Pos;
+            Node next;
+            if (!Sequence(next)) return false;
+            out.children.push_back(std::move(next));
+        }
+        --m_Depth;
+        return true;
+    }
+
+    bool Sequence(Node& out) {
+        out.kind = Node::Kind::Concat;
+        while (!AtEnd() && Peek() != '|' && Peek() != ')') {
+            Node atom;
+            bool grouped = false;
+            if (!Atom(atom, grouped)) return false;
+            bool repeated = false;
+            while (!AtEnd()) {
+                bool applied = false;
+                if (!Quantifier(atom, applied)) return false;
+                if (!applied) break;
+                repeated = true;
+            }
+            // Groups do not capture, so an unrepeated group's sequence is spliced in
+            if (grouped && !repeated && atom.kind == Node::Kind::Concat) {
+                for (Node& child : atom.children) out.children.push_back(std::move(child));
+            } else {
+                out.children.push_back(std::move(atom));
+            }
+        }
+        if (out.children.empty()) {
+            out.kind = Node::Kind::Empty;
+        } else if (out.children.size() == 1) {
+            Node only = std::move(out.children.front());
+            out = std::move(only);
+        }
+        return true;
+    }
+
+    bool Quantifier(Node& atom, bool& applied) {
+        int min = 0, max = 0;
+        const size_t start = m_Pos;
+        switch (Peek()) {
+            case '*': min = 0; max = -1; ++m_Pos; break;
+            case '+': min = 1; max = -1; ++m_Pos; break;
+            case '?': min = 0; max = 1; ++m_Pos; break;
+            case '{': {
+                ++m_Pos;
+                if (!Number(min)) {
+                    m_Pos = start;  // Not a repetition; '{' is a literal
+                    return true;
+                }
+                max = min;
+                if (!AtEnd() && Peek() == ',') {
+                    ++m_Pos;
+                    max = -1;
+                    if (!AtEnd() && Peek() != '}' && !Number(max)) {
+                        m_Pos = start;
+                        return true;
+                    }
+                }
+                if (AtEnd() || Peek() != '}') {
+                    m_Pos = start;
+                    return true;
+                }
+                ++m_Pos;
+                if (min > MAX_REPEAT || max > MAX_REPEAT) return Fail("repetition count too large");
+                if (max >= 0 && max < min) return Fail("invalid repetition range");
+                break;
+            }
+            default:
+                return true;
+        }
+        // Lazy quantifiers match the same text under leftmost-longest
+        if (!AtEnd() && Peek() == '?') ++m_Pos;
+        Node repeat;
+        repeat.kind = Node::Kind::Repeat;
+        repeat.min = min;
+        repeat.max = max;
+        repeat.children.push_back(std::move(atom));
+        atom = std::move(repeat);
+        applied = true;
+        return true;
+    }
+
+    bool Number(int& value) {
+        size_t digits = 0;
+        value = 0;
+        while (!AtEnd() && Peek() >= '0' && Peek() <= '9' && digits < 6) {
+            value = value * 10 + (Peek() - '0');
+            ++m_Pos;
+            ++digits;
+        }
+        return digits > 0;
+    }
+
+    bool Atom(Node& out, bool& grouped) {
+        const char c = Peek();
+        switch (c) {
+            case '(': {
+                ++m_Pos;
+                if (m_Pattern.substr(m_Pos, 2) == "?:") {
+                    m_Pos += 2;
+                } else if (!AtEnd() && Peek() == '?') {
+                    return Fail("unsupported group");
+                }
+                if (!Alternation(out)) return false;
+                if (AtEnd() || Peek() != ')') return Fail("missing )");
+                ++m_Pos;
+                grouped = true;
+                return true;
+            }
+            case '[':
+                ++m_Pos;
+                return Class(out);
+            case '.':
+                ++m_Pos;
+                out.kind = Node::Kind::Class;
+                out.ranges = {{0, '\n' - 1}, {'\n' + 1, MAX_CODEPOINT}};
+                return true;
+            case '^':
+            case '$':
+                ++m_Pos;
+                out.kind = Node::Kind::Assert;
+                out.assertion = c == '^' ? Assertion::LineStart : Assertion::LineEnd;
+                return true;
+            case '*':
+            case '+':
+            case '?':
+                return Fail("nothing to repeat");
+            case '\\': {
+                ++m_Pos;
+                if (AtEnd()) return Fail("trailing \\");
+                if (Peek() == 'b' || Peek() == 'B') {
+                    out.kind = Node::Kind::Assert;
+                    out.assertion = Peek() == 'b' ? Assertion::WordBoundary : Assertion::NotWordBoundary;
+                    ++m_Pos;
+                    return true;
+                }
+                out.kind = Node::Kind::Class;
+                if (!Escape(out.ranges)) return false;
+                break;
+            }
+            default: {
+                uint32_t cp;
+                if (!Codepoint(cp)) return false;
+                out.kind = Node::Kind::Class;
+                out.ranges = {{cp, cp}};
+                break;
+            }
+        }
+        FinishClass(out.ranges, false);
+        return true;
+    }
+
+    bool Class(Node& out) {
+        bool negated = false;
+        if (!AtEnd() && Peek() == '^') {
+            negated = true;
+            ++m_Pos;
+        }
+        Ranges ranges;
+        bool first = true;
+        while (true) {
+            if (AtEnd()) return Fail("missing ]");
+            if (Peek() == ']' && !first) {
+                ++m_Pos;
+                break;
+            }
+            first = false;
+            uint32_t lo;
+            if (Peek() == '\\') {
+                ++m_Pos;
+                if (AtEnd()) return Fail("trailing \\");
+                Ranges escaped;
+                if (!Escape(escaped)) return false;
+                if (escaped.size() != 1 || escaped[0].first != escaped[0].second) {
+                    ranges.insert(ranges.end(), escaped.begin(), escaped.end());
+                    continue;
+                }
+                lo = escaped[0].first;
+            } else if (!Codepoint(lo)) {
+                return false;
+            }
+            uint32_t hi = lo;
+            if (m_Pattern.substr(m_Pos, 1) == "-" && m_Pos + 1 < m_Pattern.length() && m_Pattern[m_Pos + 1] != ']') {
+                ++m_Pos;
+                if (Peek() == '\\') {
+                    ++m_Pos;
+                    if (AtEnd()) return Fail("trailing \\");
+                    Ranges escaped;
+                    if (!Escape(escaped)) return false;
+                    if (escaped.size() != 1 || escaped[0].first != escaped[0].second) return Fail("invalid class range");
+                    hi = escaped[0].first;
+                } else if (!Codepoint(hi)) {
+                    return false;
+                }
+                if (hi < lo) return Fail("invalid class range");
+            }
+            ranges.emplace_back(lo, hi);
+        }
+        out.kind = Node::Kind::Class;
+        out.ranges = std::move(ranges);
+        FinishClass(out.ranges, negated);
+        return true;
+    }
+
+    void FinishClass(Ranges& ranges, bool negated) {
+        if (m_IgnoreCase) AddOtherCase(ranges);
+        Normalize(ranges);
+        if (negated) Negate(ranges);
+    }
+
+    // The escape after a backslash as code point ranges
+    bool Escape(Ranges& out) {
+        const char c = m_Pattern[m_Pos++];
+        switch (c) {
+            case 'd': out = {{'0', '9'}}; return true;
+            case 'D': out = {{'0', '9'}}; Negate(out); return true;
+            case 'w': out = {{'0', '9'}, {'A', 'Z'}, {'_', '_'}, {'a', 'z'}}; return true;
+            case 'W': out = {{'0', '9'}, {'A', 'Z'}, {'_', '_'}, {'a', 'z'}}; Negate(out); return true;
+            case 's': out = {{'\t', '\r'}, {' ', ' '}}; return true;
+            case 'S': out = {{'\t', '\r'}, {' ', ' '}}; Negate(out); return true;
+            case 'n': out = {{'\n', '\n'}}; return true;
+            case 't': out = {{'\t', '\t'}}; return true;
+            case 'r': out = {{'\r', '\r'}}; return true;
+            case 'f': out = {{'\f', '\f'}}; return true;
+            case 'v': out = {{'\v', '\v'}}; return true;
+            case '0': out = {{0, 0}}; return true;
+            case 'x': {
+                uint32_t value = 0;
+                for (int i = 0; i < 2; ++i) {
+                    if (AtEnd() || !std::isxdigit(static_cast<unsigned char>(Peek()))) return Fail("invalid \\x escape");
+                    const char h = Peek();
+                    value = value * 16 + static_cast<uint32_t>(h <= '9' ? h - '0' : (h | 0x20) - 'a' + 10);
+                    ++m_Pos;
+                }
+                out = {{value, value}};
+                return true;
+            }
+            default:
+                if (static_cast<unsigned char>(c) < 0x80 && !std::isalnum(static_cast<unsigned char>(c))) {
+                    out = {{static_cast<uint32_t>(c), static_cast<uint32_t>(c)}};
+                    return true;
+                }
+                return Fail("unknown escape");
+        }
+    }
+
+    bool Codepoint(uint32_t& cp) {
+        const unsigned char lead = static_cast<unsigned char>(m_Pattern[m_Pos]);
+        size_t length = lead < 0x80 ? 1 : lead >= 0xF0 ? 4 : lead >= 0xE0 ? 3 : lead >= 0xC0 ? 2 : 0;
+        if (length == 0 || m_Pos + length > m_Pattern.length()) return Fail("invalid UTF-8");
+        cp = length == 1 ? lead : lead & (0x7F >> length);
+        for (size_t i = 1; i < length; ++i) {
+            const unsigned char next = static_cast<unsigned char>(m_Pattern[m_Pos + i]);
+            if ((next & 0xC0) != 0x80) return Fail("invalid UTF-8");
+            cp = (cp << 6) | (next & 0x3F);
+        }
+        if (cp > MAX_CODEPOINT) return Fail("invalid UTF-8");
+        m_Pos += length;
+        return true;
+    }
+
+    std::string_view m_Pattern;
+    size_t m_Pos = 0;
+    bool m_IgnoreCase;
+    int m_Depth = 0;
+    std::string m_Error;
+};
+
+std::shared_ptr<const Regex> Regex::Compile(std::string_view pattern, bool ignoreCase, std::string& error) {
+    Node root;
+    if (!Parser(pattern, ignoreCase).Parse(root, error)) return nullptr;
+
+    auto regex = std::make_shared<Regex>();
+    regex->m_IgnoreCase = ignoreCase;
+    const uint32_t match = regex->Add({Op::Match});
+    regex->m_Start = regex->Emit(root, match);
+    if (regex->m_TooLarge) {
+        error = "pattern too large";
+        return nullptr;
+    }
+    for (const Inst& inst : regex->m_Program) {
+        if (inst.op == Op::Byte && inst.lo <= '\n' && inst.hi >= '\n') regex->m_Multiline = true;
+    }
+    regex->ExtractLiterals(root);
+    regex->BuildByteClasses();
+    return regex;
+}
+
+uint32_t Regex::Add(Inst inst) {
+    if (m_Program.size() >= MAX_PROGRAM) {
+        m_TooLarge = true;
+        return 0;
+    }
+    m_Program.push_back(inst);
+    return static_cast<uint32_t>(m_Program.size() - 1);
+}
+
+// Compiles node so that it continues at next, returning its entry
+uint32_t Regex::Emit(const Node& node, uint32_t next) {
+    if (m_TooLarge) return next;
+    switch (node.kind) {
+        case Node::Kind::Empty:
+            return next;
+        case Node::Kind::Assert:
+            return Add({Op::Assert, 0, 0, node.assertion, next});
+        case Node::Kind::Class: {
+            std::vector<ByteSequence> sequences;
+            for (const auto& [lo, hi] : node.ranges) AppendUtf8Sequences(lo, hi, sequences);
+            if (sequences.empty()) return Add({Op::Byte, 1, 0});  // Matches nothing
+            uint32_t entry = 0;
+            for (size_t i = 0; i < sequences.size(); ++i) {
+                uint32_t id = next;
+                for (auto it = sequences[i].rbegin(); it != sequences[i].rend(); ++it) {
+                    id = Add({Op::Byte, it->first, it->second, Assertion::LineStart, id});
+                }
+                entry = i == 0 ? id : Add({Op::Split, 0, 0, Assertion::LineStart, id, entry});
+            }
+            return entry;
+        }
+        case Node::Kind::Concat:
+            for (auto it = node.children.rbegin(); it != node.children.rend(); ++it) next = Emit(*it, next);
+            return next;
+        case Node::Kind::Alternate: {
+            uint32_t entry = Emit(node.children.back(), next);
+            for (size_t i = node.children.size() - 1; i-- > 0;) {
+                entry = Add({Op::Split, 0, 0, Assertion::LineStart, Emit(node.children[i], next), entry});
+            }
+            return entry;
+        }
+        case Node::Kind::Repeat: {
+            const Node& child = node.children.front();
+            uint32_t tail = next;
+            if (node.max < 0) {
+                const uint32_t loop = Add({Op::Split});
+                if (m_TooLarge) return next;
+                const uint32_t body = Emit(child, loop);
+                m_Program[loop].out = body;
+                m_Program[loop].out1 = next;
+                tail = loop;
+            } else {
+                for (int i = node.min; i < node.max && !m_TooLarge; ++i) {
+                    tail = Add({Op::Split, 0, 0, Assertion::LineStart, Emit(child, tail), next});
+                }
+            }
+            for (int i = 0; i < node.min && !m_TooLarge; ++i) tail = Emit(child, tail);
+            return tail;
+        }
+    }
+    return next;
+}
+
+// Prefix and required literal of a top-level sequence, for skipping input
+void Regex::ExtractLiterals(const Node& root) {
+    auto literalOf = [&](const Node& node, std::string& out) {
+        if (node.kind != Node::Kind::Class) return false;
+        const Ranges& r = node.ranges;
+        uint32_t cp;
+        if (r.size() == 1 && r[0].first == r[0].second) {
+            cp = r[0].first;
+            if (m_IgnoreCase && cp < 0x80 && std::isalpha(static_cast<int>(cp))) return false;
+        } else if (m_IgnoreCase && r.size() == 2 && r[0].first == r[0].second && r[1].first == r[1].second &&
+                   r[0].first >= 'A' && r[0].first <= 'Z' && r[1].first == r[0].first + 32) {
+            cp = r[1].first;
+        } else {
+            return false;
+        }
+        uint8_t bytes[4];
+        out.append(reinterpret_cast<const char*>(bytes), EncodeUtf8(cp, bytes));
+        return true;
+    };
+
+    std::vector<const Node*> items;
+    if (root.kind == Node::Kind::Concat) {
+        for (const Node& child : root.children) items.push_back(&child);
+    } else {
+        items.push_back(&root);
+    }
+
+    std::string run;
+    bool leading = true;      // Nothing consuming seen yet
+    bool runLeading = false;  // run started at the beginning of every match
+    auto finish = [&] {
+        if (runLeading && m_Prefix.empty()) m_Prefix = run;
+        if (run.length() > m_Required.length()) m_Required = run;
+        run.clear();
+    };
+    for (const Node* item : items) {
+        if (item->kind == Node::Kind::Assert) continue;  // Zero width
+        if (run.empty()) runLeading = leading;
+        if (!literalOf(*item, run)) finish();
+        leading = false;
+    }
+    finish();
+}
+
+void Regex::BuildByteClasses() {
+    std::array<bool, 257> boundary{};
+    auto mark = [&](int lo, int hi) {
+        boundary[lo] = true;
+        boundary[hi + 1] = true;
+    };
+    for (const Inst& inst : m_Program) {
+        if (inst.op == Op::Byte && inst.lo <= inst.hi) mark(inst.lo, inst.hi);
+    }
+    // Context and assertions depend on these
+    mark('\n', '\n');
+    mark('0', '9');
+    mark('A', 'Z');
+    mark('_', '_');
+    mark('a', 'z');
+    uint8_t cls = 0;
+    for (int c = 0; c < 256; ++c) {
+        if (c > 0 && boundary[c]) ++cls;
+        m_ByteClass[c] = cls;
+    }
+    m_ClassCount = static_cast<size_t>(cls) + 1;
+}
+
+RegexMatcher::RegexMatcher(std::shared_ptr<const Regex> regex) : m_Regex(std::move(regex)) {
+    m_MaxStates = std::max<size_t>(64, CACHE_BYTES / (m_Regex->m_ClassCount * sizeof(int32_t) * 2));
+    m_Seen.assign(m_Regex->m_Program.size(), 0);
+    Reset();
+}
+
+void RegexMatcher::Reset() {
+    m_States.clear();
+    m_Index.clear();
+    m_Transitions[ANCHORED].clear();
+    m_Transitions[UNANCHORED].clear();
+    m_Starts.fill(-1);
+    m_States.push_back({});
+    m_Transitions[ANCHORED].resize(m_Regex->m_ClassCount, -1);
+    m_Transitions[UNANCHORED].resize(m_Regex->m_ClassCount, -1);
+}
+
+// Adds the byte, match and pending assertion instructions reachable from
+// root. Assertions on the next byte are pending while next is unknown.
+void RegexMatcher::Close(uint32_t root, uint8_t context, int next, std::vector<uint32_t>& out) {
+    const std::vector<Regex::Inst>& program = m_Regex->m_Program;
+    m_Stack.push_back(root);
+    while (!m_Stack.empty()) {
+        const uint32_t id = m_Stack.back();
+        m_Stack.pop_back();
+        if (m_Seen[id] == m_SeenMark) continue;
+        m_Seen[id] = m_SeenMark;
+
+        const Regex::Inst& inst = program[id];
+        switch (inst.op) {
+            case Regex::Op::Split:
+                m_Stack.push_back(inst.out1);
+                m_Stack.push_back(inst.out);
+                break;
+            case Regex::Op::Assert: {
+                bool holds;
+                if (inst.assertion == Regex::Assertion::LineStart) {
+                    holds = context & AFTER_NEWLINE;
+                } else if (next == UNKNOWN_NEXT) {
+                    out.push_back(id);
+                    break;
+                } else if (inst.assertion == Regex::Assertion::LineEnd) {
+                    holds = next == '\n' || next == END_OF_TEXT;
+                } else {
+                    const bool boundary = ((context & AFTER_WORD) != 0) != IsWordByte(next);
+                    holds = inst.assertion == Regex::Assertion::WordBoundary ? boundary : !boundary;
+                }
+                if (holds) m_Stack.push_back(inst.out);
+                break;
+            }
+            case Regex::Op::Byte:
+            case Regex::Op::Match:
+                out.push_back(id);
+                break;
+        }
+    }
+}
+
+void RegexMatcher::NewMark() {
+    if (++m_SeenMark == 0) {
+        std::fill(m_Seen.begin(), m_Seen.end(), 0);
+        m_SeenMark = 1;
+    }
+}
+
+uint32_t RegexMatcher::Intern(std::vector<uint32_t>& insts, uint8_t context) {
+    if (insts.empty()) return DEAD;
+    std::sort(insts.begin(), insts.end());
+    m_Key.assign(1, static_cast<char>(context));
+    m_Key.append(reinterpret_cast<const char*>(insts.data()), insts.size() * sizeof(uint32_t));
+    auto it = m_Index.find(m_Key);
+    if (it != m_Index.end()) return it->second;
+
+    if (m_States.size() >= m_MaxStates) {
+        Reset();
+        m_Flushed = true;
+    }
+    const uint32_t id = static_cast<uint32_t>(m_States.size());
+    m_States.push_back({insts, context});
+    m_Transitions[ANCHORED].resize(m_Transitions[ANCHORED].size() + m_Regex->m_ClassCount, -1);
+    m_Transitions[UNANCHORED].resize(m_Transitions[UNANCHORED].size() + m_Regex->m_ClassCount, -1);
+    m_Index.emplace(m_Key, id);
+    return id;
+}
+
+int32_t RegexMatcher::Compute(uint32_t state, Mode mode, unsigned char c) {
+    const std::vector<Regex::Inst>& program = m_Regex->m_Program;
+    const uint8_t context = m_States[state].context;
+
+    m_Expanded.clear();
+    NewMark();
+    for (uint32_t id : m_States[state].insts) Close(id, context, c, m_Expanded);
+
+    bool matched = false;
+    const uint8_t after = ContextAfter(c);
+    m_Next.clear();
+    NewMark();
+    for (uint32_t id : m_Expanded) {
+        const Regex::Inst& inst = program[id];
+        if (inst.op == Regex::Op::Match) {
+            matched = true;
+        } else if (inst.op == Regex::Op::Byte && inst.lo <= c && c <= inst.hi) {
+            Close(inst.out, after, UNKNOWN_NEXT, m_Next);
+        }
+    }
+    if (mode == UNANCHORED) Close(m_Regex->m_Start, after, UNKNOWN_NEXT, m_Next);
+
+    m_Flushed = false;
+    const uint32_t next = Intern(m_Next, after);
+    const int32_t transition = static_cast<int32_t>(next << 1) | (matched ? 1 : 0);
+    // A flush dropped the source state; only next is valid now
+    if (!m_Flushed) m_Transitions[mode][state * m_Regex->m_ClassCount + m_Regex->m_ByteClass[c]] = transition;
+    return transition;
+}
+
+uint32_t RegexMatcher::StartState(uint8_t context) {
+    if (m_Starts[context] >= 0) return static_cast<uint32_t>(m_Starts[context]);
+    m_Next.clear();
+    NewMark();
+    Close(m_Regex->m_Start, context, UNKNOWN_NEXT, m_Next);
+    const uint32_t id = Intern(m_Next, context);
+    m_Starts[context] = id;
+    return id;
+}
+
+bool RegexMatcher::MatchesAtEnd(uint32_t state) {
+    State& s = m_States[state];
+    if (s.matchAtEnd < 0) {
+        m_Expanded.clear();
+        NewMark();
+        for (uint32_t id : s.insts) Close(id, s.context, END_OF_TEXT, m_Expanded);
+        s.matchAtEnd = std::any_of(m_Expanded.begin(), m_Expanded.end(), [&](uint32_t id) {
+            return m_Regex->m_Program[id].op == Regex::Op::Match;
+        }) ? 1 : 0;
+    }
+    return s.matchAtEnd == 1;
+}
+
+// Smallest e > from at which a match starting in [from, limit) may end; a
+// match that is empty can also report e
+template <typename Text>
+size_t RegexMatcher::EarliestEnd(const Text& text, size_t from, size_t limit) {
+    const size_t length = LengthOf(text);
+    uint32_t state = StartState(ContextBefore(text, from));
+    size_t pos = from;
+    while (pos < length) {
+        std::string_view piece = PieceAt(text, pos);
+        if (piece.empty()) break;
+        for (unsigned char c : piece) {
+            // Threads keep starting while the next position is before limit
+            const Mode mode = pos + 1 < limit ? UNANCHORED : ANCHORED;
+            const int32_t transition = Step(state, mode, c);
+            if ((transition & 1) && pos > from) return pos;
+            state = static_cast<uint32_t>(transition) >> 1;
+            ++pos;
+            if (state == DEAD && mode == ANCHORED) return std::string_view::npos;
+        }
+    }
+    return pos > from && MatchesAtEnd(state) ? pos : std::string_view::npos;
+}
+
+// End of the longest non-empty match at start, or npos
+template <typename Text>
+size_t RegexMatcher::LongestFrom(const Text& text, size_t start) {
+    const size_t length = LengthOf(text);
+    uint32_t state = StartState(ContextBefore(text, start));
+    size_t best = std::string_view::npos;
+    size_t pos = start;
+    while (pos < length && state != DEAD) {
+        std::string_view piece = PieceAt(text, pos);
+        if (piece.empty()) break;
+        for (size_t i = 0; i < piece.length() && state != DEAD; ++i, ++pos) {
+            const int32_t transition = Step(state, ANCHORED, static_cast<unsigned char>(piece[i]));
+            if ((transition & 1) && pos > start) best = pos;
+            state = static_cast<uint32_t>(transition) >> 1;
+        }
+    }
+    if (state != DEAD && pos > start && MatchesAtEnd(state)) best = pos;
+    return best;
+}
+
+template <typename Text>
+std::optional<RegexMatcher::Match> RegexMatcher::FindInRange(const Text& text, size_t from, size_t limit) {
+    while (from < limit) {
+        const size_t end = EarliestEnd(text, from, limit);
+        if (end == std::string_view::npos) return std::nullopt;
+        // The leftmost match starts before the earliest end
+        for (size_t start = from; start < end && start < limit; ++start) {
+            const size_t longest = LongestFrom(text, start);
+            if (longest != std::string_view::npos) return Match{start, longest};
+        }
+        from = end;
+    }
+    return std::nullopt;
+}
+
+template <typename Text>
+std::optional<RegexMatcher::Match> RegexMatcher::FindIn(const Text& text, size_t from, size_t limit) {
+    constexpr size_t npos = std::string_view::npos;
+    const Regex& regex = *m_Regex;
+    limit = std::min(limit, LengthOf(text));
+    while (from < limit) {
+        if (!regex.m_Prefix.empty()) {
+            const size_t start = FindLiteral(text, regex.m_Prefix, regex.m_IgnoreCase, from);
+            if (start == npos || start >= limit) return std::nullopt;
+            const size_t end = LongestFrom(text, start);
+            if (end != npos) return Match{start, end};
+            from = start + 1;
+        } else if (!regex.m_Required.empty() && !regex.m_Multiline) {
+            // Matches stay on one line, so only lines holding the literal are run
+            const size_t hit = FindLiteral(text, regex.m_Required, regex.m_IgnoreCase, from);
+            if (hit == npos) return std::nullopt;
+            const size_t lineStart = std::max(from, LineStartOf(text, hit));
+            if (lineStart >= limit) return std::nullopt;
+            const size_t newline = FindLiteral(text, "\n", false, hit);
+            const size_t lineEnd = newline == npos ? LengthOf(text) : newline + 1;
+            if (auto match = FindInRange(text, lineStart, std::min(limit, lineEnd))) return match;
+            from = lineEnd;
+        } else {
+            return FindInRange(text, from, limit);
+        }
+    }
+    return std::nullopt;
+}
+
+std::optional<RegexMatcher::Match> RegexMatcher::Find(const Rope& text, size_t from, size_t limit) {
+    return FindIn(text, from, limit);
+}
+
+std::optional<RegexMatcher::Match> RegexMatcher::Find(std::string_view text, size_t from, size_t limit) {
+    return FindIn(text, from, limit);
+}
+
+} // namespace sol
@@ -0,0 +1,134 @@
+#pragma once
+
+#include "rope.h"
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace sol {
+
+// Compiled regular expression for text search. Supports literals, ., classes
+// ([a-z], [^...], \d \w \s and their negations), groups, |, * + ? {m,n},
+// and the ^ $ (line) and \b \B assertions. Matching is leftmost-longest over
+// UTF-8; case folding is ASCII only. Immutable, so one Regex can be shared by
+// any number of threads, each with its own RegexMatcher.
+class Regex {
+public:
+    // nullptr with error set when the pattern is invalid
+    static std::shared_ptr<const Regex> Compile(std::string_view pattern, bool ignoreCase, std::string& error);
+
+private:
+    friend class RegexMatcher;
+    struct Node;
+    class Parser;
+
+    enum class Op : uint8_t { Byte, Split, Assert, Match };
+    enum class Assertion : uint8_t { LineStart, LineEnd, WordBoundary, NotWordBoundary };
+
+    struct Inst {
+        Op op;
+        uint8_t lo = 0;  // Byte: inclusive range
+        uint8_t hi = 0;
+        Assertion assertion = Assertion::LineStart;
+        uint32_t out = 0;
+        uint32_t out1 = 0;  // Split
+    };
+
+    uint32_t Emit(const Node& node, uint32_t next);
+    uint32_t Add(Inst inst);
+    void ExtractLiterals(const Node& root);
+    void BuildByteClasses();
+
+    std::vector<Inst> m_Program;
+    uint32_t m_Start = 0;
+    bool m_IgnoreCase = false;
+    bool m_Multiline = false;  // Some match can contain a newline
+    bool m_TooLarge = false;
+    std::string m_Prefix;      // Every match starts with it (folded when ignoring case)
+    std::string m_Required;    // Every match contains it
+    std::array<uint8_t, 256> m_ByteClass{};
+    size_t m_ClassCount = 0;
+};
+
+// Lazily built DFA over a Regex. Holds a bounded state cache, so it is not
+// thread-safe; use one per thread.
+class RegexMatcher {
+public:
+    explicit RegexMatcher(std::shared_ptr<const Regex> regex);
+
+    struct Match {
+        size_t start;
+        size_t end;
+    };
+
+    // Every non-overlapping non-empty match starting in [from, limit) in
+    // order; f(Match) may return false to stop
+    template <typename Text, typename F>
+    void ForEach(const Text& text, size_t from, size_t limit, F&& f);
+
+    // First match starting in [from, limit)
+    std::optional<Match> Find(const Rope& text, size_t from, size_t limit);
+    std::optional<Match> Find(std::string_view text, size_t from, size_t limit);
+
+private:
+    enum Mode { ANCHORED, UNANCHORED };
+    static constexpr uint32_t DEAD = 0;
+    static constexpr int END_OF_TEXT = 256;
+    static constexpr int UNKNOWN_NEXT = -1;
+
+    struct State {
+        std::vector<uint32_t> insts;
+        uint8_t context;       // Facts about the previous byte
+        int8_t matchAtEnd = -1;
+    };
+
+    template <typename Text> std::optional<Match> FindIn(const Text& text, size_t from, size_t limit);
+    template <typename Text> std::optional<Match> FindInRange(const Text& text, size_t from, size_t limit);
+    template <typename Text> size_t EarliestEnd(const Text& text, size_t from, size_t limit);
+    template <typename Text> size_t LongestFrom(const Text& text, size_t start);
+
+    int32_t Step(uint32_t state, Mode mode, unsigned char c) {
+        int32_t t = m_Transitions[mode][state * m_Regex->m_ClassCount + m_Regex->m_ByteClass[c]];
+        return t >= 0 ? t : Compute(state, mode, c);
+    }
+    int32_t Compute(uint32_t state, Mode mode, unsigned char c);
+    uint32_t StartState(uint8_t context);
+    bool MatchesAtEnd(uint32_t state);
+    uint32_t Intern(std::vector<uint32_t>& insts, uint8_t context);
+    void Reset();
+    void NewMark();
+    void Close(uint32_t root, uint8_t context, int next, std::vector<uint32_t>& out);
+
+    std::shared_ptr<const Regex> m_Regex;
+    std::vector<State> m_States;
+    std::vector<int32_t> m_Transitions[2];  // (state << 1) | match ended before the byte, -1 unknown
+    std::unordered_map<std::string, uint32_t> m_Index;
+    std::array<int64_t, 4> m_Starts{};
+    size_t m_MaxStates = 0;
+    bool m_Flushed = false;  // The last Intern emptied the cache
+
+    // Closure scratch
+    std::vector<uint32_t> m_Seen;
+    uint32_t m_SeenMark = 0;
+    std::vector<uint32_t> m_Stack;
+    std::vector<uint32_t> m_Expanded;
+    std::vector<uint32_t> m_Next;
+    std::string m_Key;
+};
+
+template <typename Text, typename F>
+void RegexMatcher::ForEach(const Text& text, size_t from, size_t limit, F&& f) {
+    while (from < limit) {
+        std::optional<Match> m = Find(text, from, limit);
+        if (!m || !f(*m)) return;
+        from = m->end;
+    }
+}
+
+} // namespace sol
@@ -1,97 +1,131 @@
 #include "rope.h"
+#include "text_scan.h"
+#include "core/platform/mapped_file.h"
+#include "core/parallel.h"
 #include <algorithm>
 #include <cassert>
 #include <cstring>
 
 namespace sol {
 
-// Leaf implementation
-Rope::Leaf::Leaf(std::string_view t) : text(t) {
-    UpdateNewlineCount();
-}
+namespace {
 
-void Rope::Leaf::UpdateNewlineCount() {
-    newlineCount = std::count(text.begin(), text.end(), '\n');
+// Largest cut <= want that does not split a UTF-8 sequence
+size_t Utf8SafeCut(std::string_view text, size_t want) {
+    if (want >= text.length()) return text.length();
+    size_t cut = want;
+    while (cut > 0 && (static_cast<unsigned char>(text[cut]) & 0xC0) == 0x80) cut--;
+    return cut > 0 ? cut : want;
 }
 
-std::unique_ptr<Rope::Node> Rope::Leaf::Clone() const {
-    return std::make_unique<Leaf>(text);
+// Backs pos up over at most three continuation bytes
+size_t Utf8LeadAtOrBefore(std::string_view text, size_t pos) {
+    if (pos >= text.length()) return text.length();
+    size_t lead = pos;
+    while (lead > 0 && pos - lead < 3 && (static_cast<unsigned char>(text[lead]) & 0xC0) == 0x80) lead--;
+    return (static_cast<unsigned char>(text[lead]) & 0xC0) == 0x80 ? pos : lead;
 }
 
-// Branch implementation
-Rope::Branch::Branch(std::unique_ptr<Node> l, std::unique_ptr<Node> r)
-    : left(std::move(l)), right(std::move(r)) {
-    UpdateMetrics();
-}
+// Bytes of new leaves a worker measures at a time; scanning for newlines and
+// code points is most of the cost of building leaves from large text
+constexpr size_t PARALLEL_LEAF_BYTES = 1024 * 1024;
 
-void Rope::Branch::UpdateMetrics() {
-    leftLen = left ? left->Length() : 0;
-    leftLines = left ? left->LineCount() : 0;
-}
+} // namespace
 
-size_t Rope::Branch::Length() const {
-    return leftLen + (right ? right->Length() : 0);
-}
-
-size_t Rope::Branch::LineCount() const {
-    return leftLines + (right ? right->LineCount() : 0);
-}
-
-char Rope::Branch::At(size_t pos) const {
-    if (pos < leftLen) {
-        return left->At(pos);
+Rope::Metrics Rope::Metrics::Of(std::string_view text) {
+    TextScanResult scan = ScanText(text);
+    Metrics m;
+    m.bytes = text.length();
+    m.newlines = scan.newlines;
+    m.codepoints = scan.codepoints;
+    m.utf16 = scan.utf16;
+    if (m.newlines == 0) {
+        m.firstLine = m.lastLine = m.longestLine = m.bytes;
+        return m;
     }
-    return right->At(pos - leftLen);
+    m.firstLine = text.find('\n');
+    m.lastLine = m.bytes - text.rfind('\n') - 1;
+    m.longestLine = std::max(m.firstLine, m.lastLine);
+    for (size_t start = m.firstLine + 1, end; (end = text.find('\n', start)) != std::string_view::npos; start = end + 1) {
+        m.longestLine = std::max(m.longestLine, end - start);
+    }
+    return m;
 }
 
-void Rope::Branch::CollectString(std::string& out) const {
-    if (left) left->CollectString(out);
-    if (right) right->CollectString(out);
+// Leaf implementation
+Rope::InlineLeaf::InlineLeaf(std::string_view t) {
+    assert(t.length() <= LEAF_CAPACITY);
+    std::memcpy(data, t.data(), t.length());
+    text = data;
+    metrics = Metrics::Of(t);
 }
 
-std::unique_ptr<Rope::Node> Rope::Branch::Clone() const {
-    return std::make_unique<Branch>(
-        left ? left->Clone() : nullptr,
-        right ? right->Clone() : nullptr
-    );
+Rope::MappedLeaf::MappedLeaf(std::shared_ptr<const MappedFile> f, std::string_view t)
+    : file(std::move(f)) {
+    isMapped = true;
+    text = t.data();
+    metrics = Metrics::Of(t);
 }
 
-size_t Rope::Branch::Depth() const {
-    size_t ld = left ? left->Depth() : 0;
-    size_t rd = right ? right->Depth() : 0;
-    return 1 + std::max(ld, rd);
+// Branch implementation
+Rope::Branch::Branch(const NodePtr* first, size_t n) {
+    assert(n > 0 && n <= MAX_CHILDREN);
+    isLeaf = false;
+    count = static_cast<uint16_t>(n);
+    for (size_t i = 0; i < n; ++i) {
+        children[i] = first[i];
+        childMetrics[i] = first[i]->metrics;
+        metrics += childMetrics[i];
+    }
 }
 
 // Rope implementation
-Rope::Rope() : m_Root(std::make_unique<Leaf>("")) {}
+Rope::Rope() : m_Root(MakeLeaf("")) {}
 
-Rope::Rope(std::string_view text) {
-    if (text.empty()) {
-        m_Root = std::make_unique<Leaf>("");
-    } else {
+Rope::Rope(std::string_view text) : m_Root(BuildFromText(text)) {}
+
+Rope::Rope(std::shared_ptr<const MappedFile> file, size_t begin, size_t end, bool copy) {
+    std::string_view text(file->Data(), file->Size());
+    begin = Utf8LeadAtOrBefore(text, begin);
+    end = Utf8LeadAtOrBefore(text, end);
+    text = text.substr(begin, end > begin ? end - begin : 0);
+    if (copy) {
         m_Root = BuildFromText(text);
+        return;
+    }
+    std::vector<std::string_view> pieces;
+    pieces.reserve(text.length() / MAPPED_LEAF_SIZE + 1);
+    while (!text.empty()) {
+        size_t cut = Utf8SafeCut(text, MAPPED_LEAF_SIZE);
+        pieces.push_back(text.substr(0, cut));
+        text.remove_prefix(cut);
     }
+    NodeList leaves(pieces.size());
+    ParallelFor(0, pieces.size(), PARALLEL_LEAF_BYTES / MAPPED_LEAF_SIZE, [&](size_t first, size_t last) {
+        for (size_t i = first; i < last; ++i) leaves[i] = std::make_shared<MappedLeaf>(file, pieces[i]);
+    });
+    m_Root = BuildRoot(std::move(leaves));
 }
 
-Rope::Rope(const Rope& other) {
-    if (other.m_Root) {
-        m_Root = other.m_Root->Clone();
-    }
-    m_LastEdit = other.m_LastEdit;
+Rope::Rope(const Rope& other)
+    : m_Root(other.m_Root)
+    , m_LastEdit(other.m_LastEdit) {
 }
 
 Rope::Rope(Rope&& other) noexcept
     : m_Root(std::move(other.m_Root))
     , m_LastEdit(other.m_LastEdit)
     , m_Cache(std::move(other.m_Cache))
-    , m_CacheDirty(other.m_CacheDirty) {
+    , m_CacheDirty(other.m_CacheDirty)
+    , m_LineStarts(std::move(other.m_LineStarts))
+    , m_LineStartsDirty(other.m_LineStartsDirty) {
 }
 
 Rope& Rope::operator=(const Rope& other) {
     if (this != &other) {
-        m_Root = other.m_Root ? other.m_Root->Clone() : nullptr;
+        m_Root = other.m_Root;
         m_LastEdit = other.m_LastEdit;
-        m_CacheDirty = true;
+        InvalidateCache();
     }
     return *this;
 }
@@ -102,85 +136,401 @@ Rope& Rope::operator=(Rope&& other) noexcept {
         m_LastEdit = other.m_LastEdit;
         m_Cache = std::move(other.m_Cache);
         m_CacheDirty = other.m_CacheDirty;
+        m_LineStarts = std::move(other.m_LineStarts);
+        m_LineStartsDirty = other.m_LineStartsDirty;
     }
     return *this;
 }
 
 Rope::~Rope() = default;
 
-std::unique_ptr<Rope::Node> Rope::BuildFromText(std::string_view text) {
-    if (text.length() <= LEAF_SIZE) {
-        return std::make_unique<Leaf>(text);
+// Splits text into evenly filled leaves so no leaf starts out underfull;
+// leaves of large text are built on the workers
+void Rope::AppendLeaves(std::string_view text, NodeList& out) {
+    if (text.length() <= LEAF_CAPACITY) {
+        out.push_back(MakeLeaf(text));
+        return;
+    }
+    size_t leafCount = (text.length() + LEAF_CAPACITY - 1) / LEAF_CAPACITY;
+    std::vector<std::string_view> pieces;
+    pieces.reserve(leafCount + 1);
+    while (!text.empty()) {
+        // Cuts backed off a split sequence leave more for later leaves
+        size_t want = std::min(LEAF_CAPACITY, (text.length() + leafCount - 1) / leafCount);
+        size_t cut = Utf8SafeCut(text, want);
+        pieces.push_back(text.substr(0, cut));
+        text.remove_prefix(cut);
+        if (leafCount > 1) leafCount--;
+    }
+    const size_t offset = out.size();
+    out.resize(offset + pieces.size());
+    ParallelFor(0, pieces.size(), PARALLEL_LEAF_BYTES / LEAF_CAPACITY, [&](size_t first, size_t last) {
+        for (size_t i = first; i < last; ++i) out[offset + i] = MakeLeaf(pieces[i]);
+    });
+}
+
+// Groups same-height nodes into as few evenly filled branches as possible
+void Rope::AppendBranches(const NodeList& nodes, NodeList& out) {
+    size_t n = nodes.size();
+    size_t groups = (n + MAX_CHILDREN - 1) / MAX_CHILDREN;
+    size_t offset = 0;
+    for (size_t g = 0; g < groups; ++g) {
+        size_t take = (n - offset) / (groups - g);
+        out.push_back(std::make_shared<Branch>(nodes.data() + offset, take));
+        offset += take;
+    }
+}
+
+Rope::NodePtr Rope::BuildRoot(NodeList nodes) {
+    if (nodes.empty()) return MakeLeaf("");
+    while (nodes.size() > 1) {
+        NodeList parents;
+        AppendBranches(nodes, parents);
+        nodes = std::move(parents);
+    }
+    return std::move(nodes.front());
+}
+
+Rope::NodePtr Rope::BuildFromText(std::string_view text) {
+    NodeList leaves;
+    AppendLeaves(text, leaves);
+    return BuildRoot(std::move(leaves));
+}
+
+bool Rope::IsUnderfull(const NodePtr& node) {
+    if (node->isMapped) return false;
+    return node->isLeaf ? node->metrics.bytes < MIN_LEAF_FILL : node->count < MIN_CHILDREN;
+}
+
+// Appends [start, end) of a leaf; mapped leaves are sliced without copying
+void Rope::AppendSlice(const NodePtr& leaf, size_t start, size_t end, NodeList& out) {
+    if (start >= end) return;
+    const Leaf& source = AsLeaf(leaf);
+    std::string_view text = source.Text().substr(start, end - start);
+    if (leaf->isMapped) {
+        out.push_back(std::make_shared<MappedLeaf>(static_cast<const MappedLeaf&>(source).file, text));
+    } else {
+        out.push_back(MakeLeaf(text));
+    }
+}
+
+// Nodes are never mutated after construction: edits rebuild only the path
+// from the root to the touched leaves and share every other subtree.
+void Rope::InsertAt(const NodePtr& node, size_t pos, std::string_view text, NodeList& out) {
+    if (node->isMapped) {
+        AppendSlice(node, 0, pos, out);
+        AppendLeaves(text, out);
+        AppendSlice(node, pos, node->metrics.bytes, out);
+        return;
     }
+    if (node->isLeaf) {
+        std::string_view current = AsLeaf(node).Text();
+        if (current.length() + text.length() <= LEAF_CAPACITY) {
+            char joined[LEAF_CAPACITY];
+            std::memcpy(joined, current.data(), pos);
+            std::memcpy(joined + pos, text.data(), text.length());
+            std::memcpy(joined + pos + text.length(), current.data() + pos, current.length() - pos);
+            out.push_back(MakeLeaf(std::string_view(joined, current.length() + text.length())));
+            return;
+        }
+        std::string joined;
+        joined.reserve(current.length() + text.length());
+        joined.append(current.substr(0, pos)).append(text).append(current.substr(pos));
+        AppendLeaves(joined, out);
+        return;
+    }
+    
+    const Branch& branch = AsBranch(node);
+    size_t idx = 0;
+    while (idx + 1 < branch.count && pos > branch.childMetrics[idx].bytes) {
+        pos -= branch.childMetrics[idx].bytes;
+        idx++;
+    }
+    
+    NodeList children(branch.children.begin(), branch.children.begin() + idx);
+    InsertAt(branch.children[idx], pos, text, children);
+    children.insert(children.end(), branch.children.begin() + idx + 1, branch.children.begin() + branch.count);
     
-    size_t mid = text.length() / 2;
-    auto left = BuildFromText(text.substr(0, mid));
-    auto right = BuildFromText(text.substr(mid));
-    return std::make_unique<Branch>(std::move(left), std::move(right));
+    if (children.size() <= MAX_CHILDREN) {
+        out.push_back(std::make_shared<Branch>(children.data(), children.size()));
+    } else {
+        AppendBranches(children, out);
+    }
 }
 
-std::pair<std::unique_ptr<Rope::Node>, std::unique_ptr<Rope::Node>>
-Rope::Split(std::unique_ptr<Node> node, size_t pos) {
-    if (!node) {
-        return {nullptr, nullptr};
+// Appends what remains of the node once [start, end) is removed. The result
+// may be underfull; the caller rebalances it against its siblings.
+void Rope::EraseRange(const NodePtr& node, size_t start, size_t end, NodeList& out) {
+    if (start == 0 && end >= node->metrics.bytes) return;
+    
+    if (node->isMapped) {
+        AppendSlice(node, 0, start, out);
+        AppendSlice(node, end, node->metrics.bytes, out);
+        return;
+    }
+    if (node->isLeaf) {
+        std::string_view current = AsLeaf(node).Text();
+        char kept[LEAF_CAPACITY];
+        std::memcpy(kept, current.data(), start);
+        std::memcpy(kept + start, current.data() + end, current.length() - end);
+        out.push_back(MakeLeaf(std::string_view(kept, current.length() - (end - start))));
+        return;
+    }
+    
+    const Branch& branch = AsBranch(node);
+    NodeList children;
+    children.reserve(branch.count + 1);
+    size_t offset = 0;
+    for (size_t i = 0; i < branch.count; ++i) {
+        size_t childLen = branch.childMetrics[i].bytes;
+        size_t childStart = offset;
+        size_t childEnd = offset + childLen;
+        offset = childEnd;
+        
+        if (childEnd <= start || childStart >= end) {
+            children.push_back(branch.children[i]);
+            continue;
+        }
+        size_t localStart = start > childStart ? start - childStart : 0;
+        size_t localEnd = std::min(end, childEnd) - childStart;
+        EraseRange(branch.children[i], localStart, localEnd, children);
+    }
+    
+    FixUnderflow(children);
+    if (children.empty()) return;
+    if (children.size() <= MAX_CHILDREN) {
+        out.push_back(std::make_shared<Branch>(children.data(), children.size()));
+    } else {
+        AppendBranches(children, out);
+    }
+}
+
+// InsertAt and EraseRange for many edits at once. An edit's text goes where
+// InsertAt would put it (the first child ending at or after its position)
+// while its removed range is split across the children it overlaps.
+void Rope::EditRange(const NodePtr& node, const Edit* edits, size_t count, NodeList& out) {
+    if (node->isLeaf) {
+        const size_t length = node->metrics.bytes;
+        if (node->isMapped) {
+            size_t cursor = 0;
+            for (size_t i = 0; i < count; ++i) {
+                AppendSlice(node, cursor, edits[i].pos, out);
+                if (!edits[i].text.empty()) AppendLeaves(edits[i].text, out);
+                cursor = edits[i].pos + edits[i].len;
+            }
+            AppendSlice(node, cursor, length, out);
+            return;
+        }
+        
+        std::string_view current = AsLeaf(node).Text();
+        std::string result;
+        size_t cursor = 0;
+        for (size_t i = 0; i < count; ++i) {
+            result.append(current.substr(cursor, edits[i].pos - cursor)).append(edits[i].text);
+            cursor = edits[i].pos + edits[i].len;
+        }
+        result.append(current.substr(cursor));
+        if (!result.empty()) AppendLeaves(result, out);
+        return;
     }
     
-    if (auto* leaf = dynamic_cast<Leaf*>(node.get())) {
-        if (pos == 0) {
-            return {nullptr, std::move(node)};
+    const Branch& branch = AsBranch(node);
+    NodeList children;
+    children.reserve(branch.count + 1);
+    std::vector<Edit> local;
+    size_t next = 0;
+    size_t offset = 0;
+    for (size_t i = 0; i < branch.count; ++i) {
+        const size_t childStart = offset;
+        const size_t childEnd = offset + branch.childMetrics[i].bytes;
+        offset = childEnd;
+        
+        local.clear();
+        size_t e = next;
+        for (; e < count && edits[e].pos <= childEnd; ++e) {
+            const Edit& edit = edits[e];
+            const bool ownsText = edit.pos > childStart || i == 0;
+            const size_t removeStart = std::max(edit.pos, childStart);
+            const size_t removeEnd = std::min(edit.pos + edit.len, childEnd);
+            const size_t removed = removeEnd > removeStart ? removeEnd - removeStart : 0;
+            if (ownsText || removed > 0) {
+                local.push_back({removeStart - childStart, removed, ownsText ? edit.text : std::string_view()});
+            }
+            // The rest of its range belongs to the next child
+            if (edit.pos + edit.len > childEnd) break;
         }
-        if (pos >= leaf->text.length()) {
-            return {std::move(node), nullptr};
+        next = e;
+        
+        if (local.empty()) {
+            children.push_back(branch.children[i]);
+        } else {
+            EditRange(branch.children[i], local.data(), local.size(), children);
         }
-        auto left = std::make_unique<Leaf>(leaf->text.substr(0, pos));
-        auto right = std::make_unique<Leaf>(leaf->text.substr(pos));
-        return {std::move(left), std::move(right)};
     }
     
-    auto* branch = dynamic_cast<Branch*>(node.get());
-    if (pos <= branch->leftLen) {
-        auto [ll, lr] = Split(std::move(branch->left), pos);
-        auto right = Concat(std::move(lr), std::move(branch->right));
-        return {std::move(ll), std::move(right)};
+    FixUnderflow(children);
+    if (children.empty()) return;
+    if (children.size() <= MAX_CHILDREN) {
+        out.push_back(std::make_shared<Branch>(children.data(), children.size()));
     } else {
-        auto [rl, rr] = Split(std::move(branch->right), pos - branch->leftLen);
-        auto left = Concat(std::move(branch->left), std::move(rl));
-        return {std::move(left), std::move(rr)};
+        AppendBranches(children, out);
     }
 }
 
-std::unique_ptr<Rope::Node> Rope::Concat(std::unique_ptr<Node> left, std::unique_ptr<Node> right) {
-    if (!left) return right;
-    if (!right) return left;
-    
-    // Try to merge small leaves
-    auto* ll = dynamic_cast<Leaf*>(left.get());
-    auto* rl = dynamic_cast<Leaf*>(right.get());
-    if (ll && rl && ll->text.length() + rl->text.length() <= LEAF_SIZE) {
-        return std::make_unique<Leaf>(ll->text + rl->text);
+void Rope::FixUnderflow(NodeList& nodes) {
+    size_t i = 0;
+    while (i < nodes.size() && nodes.size() > 1) {
+        if (!IsUnderfull(nodes[i])) {
+            i++;
+            continue;
+        }
+        size_t j = (i + 1 < nodes.size()) ? i : i - 1;
+        NodeList merged = Merge(nodes[j], nodes[j + 1]);
+        nodes.erase(nodes.begin() + j, nodes.begin() + j + 2);
+        nodes.insert(nodes.begin() + j, merged.begin(), merged.end());
+        i = merged.size() == 1 ? j : j + merged.size();
+    }
+}
+
+// Merges two adjacent same-height nodes into one node, or two balanced ones
+Rope::NodeList Rope::Merge(const NodePtr& a, const NodePtr& b) {
+    NodeList out;
+    if (a->isMapped || b->isMapped) {
+        out = {a, b};
+        return out;
+    }
+    if (a->isLeaf) {
+        std::string joined;
+        joined.reserve(a->metrics.bytes + b->metrics.bytes);
+        joined.append(AsLeaf(a).Text()).append(AsLeaf(b).Text());
+        AppendLeaves(joined, out);
+        return out;
+    }
+    
+    const Branch& left = AsBranch(a);
+    const Branch& right = AsBranch(b);
+    NodeList children(left.children.begin(), left.children.begin() + left.count);
+    children.insert(children.end(), right.children.begin(), right.children.begin() + right.count);
+    FixUnderflow(children);
+    if (children.size() <= MAX_CHILDREN) {
+        out.push_back(std::make_shared<Branch>(children.data(), children.size()));
+    } else {
+        AppendBranches(children, out);
     }
-    
-    auto result = std::make_unique<Branch>(std::move(left), std::move(right));
-    return Rebalance(std::move(result));
+    return out;
 }
 
-std::unique_ptr<Rope::Node> Rope::Rebalance(std::unique_ptr<Node> node) {
-    if (!node) return nullptr;
-    
-    auto* branch = dynamic_cast<Branch*>(node.get());
-    if (!branch) return node;
-    
-    size_t ld = branch->left ? branch->left->Depth() : 0;
-    size_t rd = branch->right ? branch->right->Depth() : 0;
+size_t Rope::Height(const NodePtr& node) {
+    size_t height = 0;
+    for (const Node* n = node.get(); !n->isLeaf; n = static_cast<const Branch*>(n)->children[0].get()) {
+        height++;
+    }
+    return height;
+}
+
+// Concatenates two subtrees by descending the taller one's facing spine to
+// the other's height; returns one node, or two when the seam splits
+Rope::NodeList Rope::Join(const NodePtr& a, size_t heightA, const NodePtr& b, size_t heightB) {
+    if (heightA == heightB) {
+        if (IsUnderfull(a) || IsUnderfull(b)) return Merge(a, b);
+        return {a, b};
+    }
     
-    // Simple rebalancing: if imbalanced by more than 2, rebuild
-    if (ld > rd + 2 || rd > ld + 2) {
-        std::string content;
-        node->CollectString(content);
-        return BuildFromText(content);
+    NodeList children;
+    if (heightA > heightB) {
+        const Branch& left = AsBranch(a);
+        children.assign(left.children.begin(), left.children.begin() + left.count - 1);
+        NodeList seam = Join(left.children[left.count - 1], heightA - 1, b, heightB);
+        children.insert(children.end(), seam.begin(), seam.end());
+    } else {
+        const Branch& right = AsBranch(b);
+        children = Join(a, heightA, right.children[0], heightB - 1);
+        children.insert(children.end(), right.children.begin() + 1, right.children.begin() + right.count);
     }
     
-    return node;
+    NodeList out;
+    if (children.size() <= MAX_CHILDREN) {
+        out.push_back(std::make_shared<Branch>(children.data(), children.size()));
+    } else {
+        AppendBranches(children, out);
+    }
+    return out;
+}
+
+Rope::ChunkIterator Rope::ChunkAt(size_t pos) const {
+    ChunkIterator it;
+    it.m_Root = m_Root;
+    it.Seek(std::min(pos, Length()));
+    return it;
+}
+
+void Rope::ChunkIterator::Seek(size_t pos) {
+    m_Depth = 0;
+    m_Offset = 0;
+    const Node* node = m_Root.get();
+    while (!node->isLeaf) {
+        const auto* branch = static_cast<const Branch*>(node);
+        size_t i = 0;
+        while (i + 1 < branch->count && pos >= branch->childMetrics[i].bytes) {
+            pos -= branch->childMetrics[i].bytes;
+            m_Offset += branch->childMetrics[i].bytes;
+            i++;
+        }
+        m_Path[m_Depth++] = {branch, i};
+        node = branch->children[i].get();
+    }
+    m_Leaf = static_cast<const Leaf*>(node);
+}
+
+void Rope::ChunkIterator::DescendFirst(const Node* node) {
+    while (!node->isLeaf) {
+        const auto* branch = static_cast<const Branch*>(node);
+        m_Path[m_Depth++] = {branch, 0};
+        node = branch->children[0].get();
+    }
+    m_Leaf = static_cast<const Leaf*>(node);
+}
+
+void Rope::ChunkIterator::DescendLast(const Node* node) {
+    while (!node->isLeaf) {
+        const auto* branch = static_cast<const Branch*>(node);
+        size_t last = branch->count - 1u;
+        m_Path[m_Depth++] = {branch, last};
+        node = branch->children[last].get();
+    }
+    m_Leaf = static_cast<const Leaf*>(node);
+}
+
+Rope::ChunkIterator& Rope::ChunkIterator::operator++() {
+    if (!m_Leaf) return *this;
+    m_Offset += m_Leaf->metrics.bytes;
+    while (m_Depth > 0) {
+        Frame& frame = m_Path[m_Depth - 1];
+        if (frame.index + 1 < frame.branch->count) {
+            frame.index++;
+            DescendFirst(frame.branch->children[frame.index].get());
+            return *this;
+        }
+        m_Depth--;
+    }
+    m_Leaf = nullptr;
+    return *this;
+}
+
+Rope::ChunkIterator& Rope::ChunkIterator::operator--() {
+    if (!m_Leaf) return *this;
+    while (m_Depth > 0) {
+        Frame& frame = m_Path[m_Depth - 1];
+        if (frame.index > 0) {
+            frame.index--;
+            DescendLast(frame.branch->children[frame.index].get());
+            m_Offset -= m_Leaf->metrics.bytes;
+            return *this;
+        }
+        m_Depth--;
+    }
+    m_Leaf = nullptr;
+    return *this;
 }
 
 void Rope::Insert(size_t pos, std::string_view text) {
@@ -203,21 +553,14 @@ void Rope::Insert(size_t pos, std::string_view text) {
     m_LastEdit.oldEndPoint = {startLine, startCol};
     
     // Structural edit on the rope tree
-    auto [left, right] = Split(std::move(m_Root), pos);
-    auto middle = BuildFromText(text);
-    auto temp = Concat(std::move(left), std::move(middle));
-    m_Root = Concat(std::move(temp), std::move(right));
+    NodeList replacement;
+    InsertAt(m_Root, pos, text, replacement);
+    SetRoot(std::move(replacement));
     
-    if (IsLargeFile()) {
-        m_VisibleRangeBuf.clear();
-        auto [endLine, endCol] = PosToLineCol(pos + text.length());
-        m_LastEdit.newEndPoint = {endLine, endCol};
-    } else {
-        // Patch cache and line starts incrementally
-        PatchCacheInsert(pos, text);
-        auto [endLine, endCol] = PosToLineCol(pos + text.length());
-        m_LastEdit.newEndPoint = {endLine, endCol};
-    }
+    // Patch cache and line starts incrementally
+    if (!IsLargeFile()) PatchCacheInsert(pos, text);
+    auto [endLine, endCol] = PosToLineCol(pos + text.length());
+    m_LastEdit.newEndPoint = {endLine, endCol};
 }
 
 void Rope::Delete(size_t pos, size_t len) {
@@ -243,19 +586,57 @@ void Rope::Delete(size_t pos, size_t len) {
     m_LastEdit.newEndPoint = {startLine, startCol};
     
     // Structural edit on the rope tree
-    auto [left, temp] = Split(std::move(m_Root), pos);
-    auto [_, right] = Split(std::move(temp), len);
-    m_Root = Concat(std::move(left), std::move(right));
+    NodeList remaining;
+    EraseRange(m_Root, pos, pos + len, remaining);
+    SetRoot(std::move(remaining));
     
-    if (!m_Root) {
-        m_Root = std::make_unique<Leaf>("");
+    if (!IsLargeFile()) PatchCacheDelete(pos, len);
+}
+
+void Rope::SetRoot(NodeList nodes) {
+    m_Root = BuildRoot(std::move(nodes));
+    while (!m_Root->isLeaf && m_Root->count == 1) {
+        m_Root = AsBranch(m_Root).children[0];
     }
-    
-    if (IsLargeFile()) {
-        m_VisibleRangeBuf.clear();
+}
+
+void Rope::Append(const Rope& other) {
+    if (other.Empty()) return;
+    if (Empty()) {
+        m_Root = other.m_Root;
     } else {
-        PatchCacheDelete(pos, len);
+        SetRoot(Join(m_Root, Height(m_Root), other.m_Root, Height(other.m_Root)));
+    }
+    InvalidateCache();
+}
+
+std::vector<Rope::EditInfo> Rope::ApplyEdits(const std::vector<Edit>& edits) {
+    std::vector<EditInfo> infos;
+    infos.reserve(edits.size());
+    
+    for (const Edit& edit : edits) {
+        EditInfo info;
+        info.startByte = edit.pos;
+        info.oldEndByte = edit.pos + edit.len;
+        info.newEndByte = edit.pos + edit.text.length();
+        info.startPoint = PosToLineCol(info.startByte);
+        info.oldEndPoint = PosToLineCol(info.oldEndByte);
+        size_t lastNewline = edit.text.rfind('\n');
+        if (lastNewline == std::string_view::npos) {
+            info.newEndPoint = {info.startPoint.first, info.startPoint.second + edit.text.length()};
+        } else {
+            info.newEndPoint = {info.startPoint.first + CountNewlines(edit.text), edit.text.length() - lastNewline - 1};
+        }
+        infos.push_back(info);
+    }
+    
+    if (!edits.empty()) {
+        NodeList replacement;
+        EditRange(m_Root, edits.data(), edits.size(), replacement);
+        SetRoot(std::move(replacement));
     }
+    InvalidateCache();
+    return infos;
 }
 
 void Rope::Replace(size_t pos, size_t len, std::string_view text) {
@@ -267,7 +648,17 @@ char Rope::At(size_t pos) const {
     if (pos >= Length()) {
         return '\0';  // Return null char for out of bounds
     }
-    return m_Root->At(pos);
+    const Node* node = m_Root.get();
+    while (!node->isLeaf) {
+        const auto& branch = static_cast<const Branch&>(*node);
+        size_t i = 0;
+        while (pos >= branch.childMetrics[i].bytes) {
+            pos -= branch.childMetrics[i].bytes;
+            i++;
+        }
+        node = branch.children[i].get();
+    }
+    return static_cast<const Leaf*>(node)->text[pos];
 }
 
 std::string Rope::Substring(size_t pos, size_t len) const {
@@ -287,20 +678,18 @@ std::string Rope::Substring(size_t pos, size_t len) const {
 }
 
 std::string Rope::ToString() const {
+    if (IsLargeFile()) return SubstringDirect(0, Length());
     EnsureCache();
     return m_Cache;
 }
 
 size_t Rope::Length() const {
-    return m_Root ? m_Root->Length() : 0;
+    return m_Root->metrics.bytes;
 }
 
 size_t Rope::LineCount() const {
     if (IsLargeFile()) {
-        return (m_Root ? m_Root->LineCount() : 0) + 1; // +1 for the last implicit line? Or 0-based?
-        // Metrics store "newlineCount".
-        // "A\nB" has 1 newline, 2 lines.
-        // So return newlineCount + 1.
+        return m_Root->metrics.newlines + 1;
     }
     EnsureLineStarts();
     return m_LineStarts.size();
@@ -313,12 +702,7 @@ void Rope::EnsureLineStarts() const {
     EnsureCache();
     m_LineStarts.clear();
     m_LineStarts.push_back(0);  // First line starts at 0
-    
-    for (size_t i = 0; i < m_Cache.length(); ++i) {
-        if (m_Cache[i] == '\n') {
-            m_LineStarts.push_back(i + 1);
-        }
-    }
+    AppendLineStarts(m_Cache, 0, m_LineStarts);
     
     m_LineStartsDirty = false;
 }
@@ -371,46 +755,10 @@ std::string Rope::Line(size_t lineNum) const {
 
 std::string_view Rope::LineView(size_t lineNum) const {
     if (IsLargeFile()) {
-        if (lineNum >= m_VisibleFirstLine && lineNum < m_VisibleLastLine) {
-            size_t globalStart = FindLineStartDirect(lineNum);
-            size_t globalEnd = FindLineStartDirect(lineNum + 1);
-            if (globalEnd > 0 && At(globalEnd - 1) == '\n') globalEnd--; // Exclude newline? 
-            // Better: LineView usually excludes newline? 
-            // The original implementation:
-            // start = LineStart(lineNum), end = LineEnd(lineNum)
-            // LineEnd returns position BEFORE newline if it exists?
-            // LineEnd implementation: return nextLineStart > 0 ? nextLineStart - 1 : 0
-            // Wait, nextLineStart is index AFTER \n. So -1 is the \n.
-            // So LineEnd includes the content UP TO \n? Or excludes \n?
-            // "return nextLineStart > 0 ? nextLineStart - 1 : 0" 
-            // If text is "A\nB", line 0 start=0, line 1 start=2.
-            // LineEnd(0) = 2 - 1 = 1. Substring(0, 1) -> "A".
-            // So LineEnd excludes \n.
-            
-            // Adjust for VisibleRange logic
-            if (globalStart >= m_VisibleRangeStart) {
-                size_t localStart = globalStart - m_VisibleRangeStart;
-                size_t len = globalEnd - globalStart;
-                if (len > 0 && globalEnd > 0) {
-                     // Check if ends with newline
-                     // We can peek into visible buffer
-                     size_t localEnd = localStart + len;
-                     if (localEnd <= m_VisibleRangeBuf.length()) {
-                         if (localEnd > 0 && m_VisibleRangeBuf[localEnd-1] == '\n') {
-                             len--;
-                         }
-                         return std::string_view(m_VisibleRangeBuf.data() + localStart, len);
-                     }
-                }
-            }
-        }
-        // Fallback for lines outside visible range (slow path)
+        // Views read the lines they show through a LineWindow; this is the slow path
         static std::string temp;
         size_t s = FindLineStartDirect(lineNum);
         size_t nextS = FindLineStartDirect(lineNum + 1);
-        size_t e = (nextS > 0 && nextS > s) ? nextS - 1 : s; // approximate
-        // Accurate check for newline:
-        // We'd have to read char at e.
         temp = SubstringDirect(s, nextS - s);
         if (!temp.empty() && temp.back() == '\n') temp.pop_back();
         return temp;
@@ -430,24 +778,18 @@ std::pair<size_t, size_t> Rope::PosToLineCol(size_t pos) const {
         size_t offset = pos;
         size_t line = 0;
         const Node* node = m_Root.get();
-
-        while (node) {
-            if (auto* leaf = dynamic_cast<const Leaf*>(node)) {
-                 size_t limit = std::min(offset, leaf->text.length());
-                 for (size_t i = 0; i < limit; ++i) {
-                     if (leaf->text[i] == '\n') line++;
-                 }
-                 break;
-            } else if (auto* branch = dynamic_cast<const Branch*>(node)) {
-                 if (offset < branch->leftLen) {
-                     node = branch->left.get();
-                 } else {
-                     line += branch->leftLines;
-                     offset -= branch->leftLen;
-                     node = branch->right.get();
-                 }
+        while (!node->isLeaf) {
+            const auto& branch = static_cast<const Branch&>(*node);
+            size_t i = 0;
+            while (i + 1 < branch.count && offset >= branch.childMetrics[i].bytes) {
+                offset -= branch.childMetrics[i].bytes;
+                line += branch.childMetrics[i].newlines;
+                i++;
             }
+            node = branch.children[i].get();
         }
+        std::string_view text = static_cast<const Leaf*>(node)->Text();
+        line += CountNewlines(text.substr(0, offset));
         size_t start = FindLineStartDirect(line);
         return {line, (pos >= start) ? (pos - start) : 0};
     }
@@ -475,25 +817,70 @@ size_t Rope::LineColToPos(size_t line, size_t col) const {
     return std::min(start + col, end);
 }
 
-void Rope::ForEach(CharCallback callback) const {
-    ForEachInRange(0, Length(), callback);
+size_t Rope::ByteToMetric(size_t Metrics::*metric, size_t pos) const {
+    pos = std::min(pos, Length());
+    size_t result = 0;
+    const Node* node = m_Root.get();
+    while (!node->isLeaf) {
+        const auto& branch = static_cast<const Branch&>(*node);
+        size_t i = 0;
+        while (i + 1 < branch.count && pos >= branch.childMetrics[i].bytes) {
+            pos -= branch.childMetrics[i].bytes;
+            result += branch.childMetrics[i].*metric;
+            i++;
+        }
+        node = branch.children[i].get();
+    }
+    std::string_view text = static_cast<const Leaf*>(node)->Text();
+    return result + Metrics::Of(text.substr(0, pos)).*metric;
+}
+
+size_t Rope::MetricToByte(size_t Metrics::*metric, size_t value) const {
+    if (value >= m_Root->metrics.*metric) return Length();
+    size_t offset = 0;
+    const Node* node = m_Root.get();
+    while (!node->isLeaf) {
+        const auto& branch = static_cast<const Branch&>(*node);
+        size_t i = 0;
+        while (i + 1 < branch.count && value >= branch.childMetrics[i].*metric) {
+            value -= branch.childMetrics[i].*metric;
+            offset += branch.childMetrics[i].bytes;
+            i++;
+        }
+        node = branch.children[i].get();
+    }
+    
+    // Walk codepoints until `value` units have been consumed; a position
+    // inside a surrogate pair resolves to the start of that codepoint
+    std::string_view text = static_cast<const Leaf*>(node)->Text();
+    size_t i = 0;
+    while (i < text.length()) {
+        size_t next = i + 1;
+        while (next < text.length() && (static_cast<unsigned char>(text[next]) & 0xC0) == 0x80) next++;
+        size_t units = Metrics::Of(text.substr(i, next - i)).*metric;
+        if (units > value) break;
+        value -= units;
+        i = next;
+    }
+    return offset + i;
 }
 
-void Rope::ForEachInRange(size_t start, size_t end, CharCallback callback) const {
-    EnsureCache();
-    end = std::min(end, m_Cache.length());
-    for (size_t i = start; i < end; ++i) {
-        if (!callback(i, m_Cache[i])) break;
-    }
+std::pair<size_t, size_t> Rope::PosToLineUtf16Col(size_t pos) const {
+    size_t line = PosToLineCol(pos).first;
+    return {line, ByteToUtf16(pos) - ByteToUtf16(LineStart(line))};
+}
+
+size_t Rope::LineUtf16ColToPos(size_t line, size_t col) const {
+    size_t start = LineStart(line);
+    return std::min(Utf16ToByte(ByteToUtf16(start) + col), LineEnd(line));
 }
 
 void Rope::EnsureCache() const {
     if (IsLargeFile()) return;
     if (m_CacheDirty) {
         m_Cache.clear();
-        if (m_Root) {
-            m_Root->CollectString(m_Cache);
-        }
+        m_Cache.reserve(Length());
+        ForEachChunk(0, Length(), [this](std::string_view chunk) { m_Cache.append(chunk); });
         m_CacheDirty = false;
     }
 }
@@ -537,11 +924,7 @@ void Rope::PatchCacheInsert(size_t pos, std::string_view text) {
     
     // Collect positions of newlines in inserted text
     std::vector<size_t> newNewlines;
-    for (size_t i = 0; i < text.length(); ++i) {
-        if (text[i] == '\n') {
-            newNewlines.push_back(pos + i + 1);  // Line starts after the newline
-        }
-    }
+    AppendLineStarts(text, pos, newNewlines);
     
     // Shift all line starts after pos by text.length()
     for (size_t i = lineIdx; i < m_LineStarts.size(); ++i) {
@@ -586,126 +969,47 @@ void Rope::PatchCacheDelete(size_t pos, size_t len) {
     m_LineStartsDirty = false;
 }
 
-size_t Rope::CountNewlines(std::string_view text) const {
-    return std::count(text.begin(), text.end(), '\n');
-}
-
 // -------------------------------------------------------------------------------------------------
 // Large File Optimizations
 // -------------------------------------------------------------------------------------------------
 
-size_t Rope::Leaf::FindLineStart(size_t lineNum, size_t& linesSkipped) const {
-    size_t targetIndex = lineNum - linesSkipped;
-    if (targetIndex == 0) return 0; // Starts at beginning of this leaf range
-    
-    size_t count = 0;
-    for (size_t i = 0; i < text.length(); ++i) {
-        if (text[i] == '\n') {
-            count++;
-            if (count == targetIndex) {
-                return i + 1; // Start of next line
-            }
-        }
-    }
-    return text.length(); 
-}
-
-void Rope::Leaf::CollectRange(std::string& out, size_t start, size_t end) const {
-    size_t len = text.length();
-    if (start >= len) return;
-    
-    size_t realEnd = std::min(end, len);
-    if (realEnd > start) {
-        out.append(text, start, realEnd - start);
-    }
-}
-
-size_t Rope::Branch::FindLineStart(size_t lineNum, size_t& linesSkipped) const {
-    size_t currentLines = linesSkipped;
-    
-    if (lineNum <= currentLines + leftLines) {
-         // It's in the left child
-         return left->FindLineStart(lineNum, linesSkipped);
-    }
-    
-    // It's in the right child
-    linesSkipped += leftLines;
-    return leftLen + right->FindLineStart(lineNum, linesSkipped);
-}
-
-void Rope::Branch::CollectRange(std::string& out, size_t start, size_t end) const {
-    if (start < leftLen) {
-        left->CollectRange(out, start, end); 
-    }
-    if (end > leftLen) {
-        size_t rightStart = (start > leftLen) ? (start - leftLen) : 0;
-        size_t rightEnd = end - leftLen; // Safe because end > leftLen
-        right->CollectRange(out, rightStart, rightEnd);
-    }
-}
-
 size_t Rope::FindLineStartDirect(size_t lineNum) const {
     if (lineNum == 0) return 0;
-    if (!m_Root) return 0;
-    
-    size_t skippedLines = 0;
-    return m_Root->FindLineStart(lineNum, skippedLines);
+    if (lineNum > m_Root->metrics.newlines) return Length();
+    
+    // Descend to the leaf holding the lineNum-th newline
+    size_t offset = 0;
+    const Node* node = m_Root.get();
+    while (!node->isLeaf) {
+        const auto& branch = static_cast<const Branch&>(*node);
+        size_t i = 0;
+        while (lineNum > branch.childMetrics[i].newlines) {
+            lineNum -= branch.childMetrics[i].newlines;
+            offset += branch.childMetrics[i].bytes;
+            i++;
+        }
+        node = branch.children[i].get();
+    }
+    std::string_view text = static_cast<const Leaf*>(node)->Text();
+    size_t idx = FindNthNewline(text, lineNum);
+    return offset + (idx == std::string_view::npos ? text.length() : idx + 1);
 }
 
 std::string Rope::SubstringDirect(size_t pos, size_t len) const {
     std::string out;
     out.reserve(len);
-    if (m_Root) {
-        m_Root->CollectRange(out, pos, pos + len);
-    }
+    ForEachChunk(pos, pos + len, [&out](std::string_view chunk) { out.append(chunk); });
     return out;
 }
 
-void Rope::PrepareVisibleRange(size_t firstLine, size_t lastLine) {
-    if (!IsLargeFile()) return;
-    
-    size_t pad = 50;
-    size_t startL = (firstLine > pad) ? (firstLine - pad) : 0;
-    size_t endL = lastLine + pad;
-    size_t maxL = LineCount(); // This might be slow if using old LineCount? No, LineCount needs optimization too.
-    
-    // For large files, LineCount() comes from root metrics which is fast.
-    if (m_Root) maxL = m_Root->LineCount() + 1; // +1 because line count is newlines + 1 roughly
-    
-    if (endL > maxL) endL = maxL;
-    
-    // Check coverage
-    if (startL >= m_VisibleFirstLine && endL <= m_VisibleLastLine && !m_VisibleRangeBuf.empty()) {
-        return;
-    }
-    
-    m_VisibleFirstLine = startL;
-    m_VisibleLastLine = endL;
-    
-    size_t startByte = FindLineStartDirect(startL);
-    size_t endByte = FindLineStartDirect(endL); 
-    
-    if (endByte < startByte) endByte = startByte;
-    
-    m_VisibleRangeStart = startByte;
-    m_VisibleRangeBuf = SubstringDirect(startByte, endByte - startByte);
-}
-
-void Rope::SetVisibleBuffer(const std::string& buffer, size_t firstLine, size_t lastLine, size_t startByte) {
-    m_VisibleRangeBuf = buffer;
-    m_VisibleFirstLine = firstLine;
-    m_VisibleLastLine = lastLine;
-    m_VisibleRangeStart = startByte;
+size_t Rope::CacheMemory() const {
+    return m_Cache.capacity() + m_LineStarts.capacity() * sizeof(size_t);
 }
 
-std::string_view Rope::GetVisibleBufferView(size_t globalStart, size_t len) const {
-    if (globalStart >= m_VisibleRangeStart) {
-        size_t localStart = globalStart - m_VisibleRangeStart;
-        if (localStart + len <= m_VisibleRangeBuf.length()) {
-            return std::string_view(m_VisibleRangeBuf.data() + localStart, len);
-        }
-    }
-    return "";
+void Rope::ReleaseCaches() {
+    std::string().swap(m_Cache);
+    std::vector<size_t>().swap(m_LineStarts);
+    InvalidateCache();
 }
 
 } // namespace sol
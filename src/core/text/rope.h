@@ -3,27 +3,46 @@
 #include <string>
 #include <string_view>
 #include <memory>
+#include <array>
+#include <cstdint>
+#include <algorithm>
 #include <vector>
-#include <functional>
+#include <type_traits>
 
 namespace sol {
 
+class MappedFile;
+
 // Rope data structure for efficient text editing
 // Similar to what Neovim uses - O(log n) insertions/deletions
+// Nodes are immutable and reference counted: edits path-copy, so copies and
+// snapshots share every unchanged subtree and are O(1) to take.
 class Rope {
 public:
     Rope();
     explicit Rope(std::string_view text);
+    // Piece-table mode: leaves reference [begin, end) of the mapping, edits add
+    // in-memory leaves. Both ends are moved back to a UTF-8 lead byte, so
+    // adjacent ranges tile the file exactly. With copy the range is copied
+    // into in-memory leaves instead, so the mapping can be released.
+    Rope(std::shared_ptr<const MappedFile> file, size_t begin, size_t end, bool copy = false);
     Rope(const Rope& other);
     Rope(Rope&& other) noexcept;
     Rope& operator=(const Rope& other);
     Rope& operator=(Rope&& other) noexcept;
     ~Rope();
     
+    // O(1) immutable view of the current text, safe to hand to another thread
+    Rope Snapshot() const { return Rope(*this); }
+    // True when both hold the same tree, i.e. one is an unedited snapshot of the other
+    bool SharesText(const Rope& other) const { return m_Root == other.m_Root; }
+    
     // Basic operations
     void Insert(size_t pos, std::string_view text);
     void Delete(size_t pos, size_t len);
     void Replace(size_t pos, size_t len, std::string_view text);
+    // Concatenates in O(log n), sharing every node of other
+    void Append(const Rope& other);
     
     // Access
     char At(size_t pos) const;
@@ -41,20 +60,40 @@ public:
     std::string_view LineView(size_t lineNum) const;
     std::pair<size_t, size_t> PosToLineCol(size_t pos) const;  // Returns (line, col)
     size_t LineColToPos(size_t line, size_t col) const;
+    // Bytes of the longest line, newline excluded, kept by every node so it
+    // costs nothing to read and a path of nodes to update
+    size_t MaxLineLength() const { return m_Root->metrics.longestLine; }
     
-    // Large file optimization: prepare visible line range for efficient rendering
-    void PrepareVisibleRange(size_t firstLine, size_t lastLine);
-    void SetVisibleBuffer(const std::string& buffer, size_t firstLine, size_t lastLine, size_t startByte);
-    
-    // Helper to get view into visible buffer using global offsets
-    std::string_view GetVisibleBufferView(size_t globalStart, size_t len) const;
+    // Unicode offsets, resolved by tree descent (LSP positions are UTF-16 units)
+    size_t ByteToUtf16(size_t pos) const { return ByteToMetric(&Metrics::utf16, pos); }
+    size_t ByteToCodepoint(size_t pos) const { return ByteToMetric(&Metrics::codepoints, pos); }
+    size_t Utf16ToByte(size_t units) const { return MetricToByte(&Metrics::utf16, units); }
+    size_t CodepointToByte(size_t codepoints) const { return MetricToByte(&Metrics::codepoints, codepoints); }
+    std::pair<size_t, size_t> PosToLineUtf16Col(size_t pos) const;  // Returns (line, UTF-16 col)
+    size_t LineUtf16ColToPos(size_t line, size_t col) const;
     
     bool IsLargeFile() const { return Length() > LARGE_FILE_THRESHOLD; }
+    
+    // Heap held by the contiguous and line caches, which are
+    // rebuilt on demand after ReleaseCaches
+    size_t CacheMemory() const;
+    void ReleaseCaches();
 
-    // Iteration
-    using CharCallback = std::function<bool(size_t pos, char c)>;
-    void ForEach(CharCallback callback) const;
-    void ForEachInRange(size_t start, size_t end, CharCallback callback) const;
+    // Iteration over contiguous leaf slices; valid while the rope (or a
+    // snapshot holding the same tree) is unchanged
+    class ChunkIterator;
+    ChunkIterator ChunkAt(size_t pos) const;
+    
+    // f(std::string_view chunk) for every slice in [start, end); f may return
+    // false to stop early
+    template <typename F>
+    void ForEachChunk(size_t start, size_t end, F&& f) const;
+    
+    // f(size_t pos, char c) -> bool, stops when f returns false
+    template <typename F>
+    void ForEach(F&& f) const { ForEachInRange(0, Length(), std::forward<F>(f)); }
+    template <typename F>
+    void ForEachInRange(size_t start, size_t end, F&& f) const;
     
     // For tree-sitter integration
     struct EditInfo {
@@ -67,6 +106,18 @@ public:
     };
     EditInfo GetLastEdit() const { return m_LastEdit; }
     
+    // One replacement of [pos, pos + len) within a batch
+    struct Edit {
+        size_t pos;
+        size_t len;
+        std::string_view text;
+    };
+    // Applies sorted, non-overlapping edits positioned in the text before the
+    // batch in one descent, so every touched path is copied once and caches
+    // are rebuilt once rather than per edit. Returns one EditInfo per edit in
+    // those same coordinates; a syntax tree must take them last to first.
+    std::vector<EditInfo> ApplyEdits(const std::vector<Edit>& edits);
+    
     // For ImGui compatibility - returns a contiguous buffer (cached)
     const char* CStr() const;
     char* Data();
@@ -74,61 +125,79 @@ public:
     void SyncFromBuffer();  // Call after ImGui modifies the buffer
     
 private:
-    static constexpr size_t LEAF_SIZE = 512;  // Max chars per leaf node
+    // B-tree layout: every leaf sits at the same depth, branches keep their
+    // children's metrics inline so descents never touch unrelated nodes.
+    static constexpr size_t LEAF_CAPACITY = 1024;
+    static constexpr size_t MAPPED_LEAF_SIZE = 16 * 1024;
+    static constexpr size_t MIN_LEAF_FILL = LEAF_CAPACITY / 2;
+    static constexpr size_t MAX_CHILDREN = 16;
+    static constexpr size_t MIN_CHILDREN = MAX_CHILDREN / 2;
     
-    struct Node {
-        virtual ~Node() = default;
-        virtual size_t Length() const = 0;
-        virtual size_t LineCount() const = 0;
-        virtual char At(size_t pos) const = 0;
-        virtual void CollectString(std::string& out) const = 0;
-        virtual std::unique_ptr<Node> Clone() const = 0;
-        virtual size_t Depth() const = 0;
+    struct Metrics {
+        size_t bytes = 0;
+        size_t newlines = 0;
+        size_t codepoints = 0;  // UTF-8 lead bytes
+        size_t utf16 = 0;       // Code units; 4-byte sequences count twice
+        // Line lengths without the newline; a text without one is all first
+        // and last line. Together they give the longest line of two texts
+        // joined, which may run across the seam.
+        size_t firstLine = 0;
+        size_t lastLine = 0;
+        size_t longestLine = 0;
         
-        // Tree-based line operations (O(log N))
-        virtual size_t FindLineStart(size_t lineNum, size_t& linesSkipped) const = 0;
-        virtual void CollectRange(std::string& out, size_t start, size_t end) const = 0;
+        // o is the text following this one
+        Metrics& operator+=(const Metrics& o) {
+            longestLine = std::max({longestLine, o.longestLine, lastLine + o.firstLine});
+            if (newlines == 0) firstLine = bytes + o.firstLine;
+            lastLine = o.newlines == 0 ? lastLine + o.bytes : o.lastLine;
+            bytes += o.bytes;
+            newlines += o.newlines;
+            codepoints += o.codepoints;
+            utf16 += o.utf16;
+            return *this;
+        }
+        static Metrics Of(std::string_view text);
+    };
+    
+    struct Node;
+    using NodePtr = std::shared_ptr<const Node>;
+    
+    struct Node {
+        Metrics metrics;
+        uint16_t count = 0;  // Children of a branch
+        bool isLeaf = true;
+        bool isMapped = false;
     };
     
     struct Leaf : Node {
-        std::string text;
-        size_t newlineCount = 0;
-        
-        explicit Leaf(std::string_view t);
-        size_t Length() const override { return text.length(); }
-        size_t LineCount() const override { return newlineCount; }
-        char At(size_t pos) const override { return text[pos]; }
-        void CollectString(std::string& out) const override { out += text; }
-        std::unique_ptr<Node> Clone() const override;
-        size_t Depth() const override { return 1; }
-        
-        size_t FindLineStart(size_t lineNum, size_t& linesSkipped) const override;
-        void CollectRange(std::string& out, size_t start, size_t end) const override;
-        
-        void UpdateNewlineCount();
+        const char* text = nullptr;
+        std::string_view Text() const { return {text, metrics.bytes}; }
+    };
+    
+    // An in-memory leaf and its text share one allocation (together with the
+    // shared_ptr control block) instead of a node plus a heap string.
+    struct InlineLeaf : Leaf {
+        char data[LEAF_CAPACITY];
+        explicit InlineLeaf(std::string_view text);
+    };
+    
+    // Slice of a memory-mapped file; never copied into RAM
+    struct MappedLeaf : Leaf {
+        std::shared_ptr<const MappedFile> file;
+        MappedLeaf(std::shared_ptr<const MappedFile> f, std::string_view text);
     };
     
     struct Branch : Node {
-        std::unique_ptr<Node> left;
-        std::unique_ptr<Node> right;
-        size_t leftLen = 0;
-        size_t leftLines = 0;
-        
-        Branch(std::unique_ptr<Node> l, std::unique_ptr<Node> r);
-        size_t Length() const override;
-        size_t LineCount() const override;
-        char At(size_t pos) const override;
-        void CollectString(std::string& out) const override;
-        std::unique_ptr<Node> Clone() const override;
-        size_t Depth() const override;
-        
-        size_t FindLineStart(size_t lineNum, size_t& linesSkipped) const override;
-        void CollectRange(std::string& out, size_t start, size_t end) const override;
+        std::array<NodePtr, MAX_CHILDREN> children;
+        std::array<Metrics, MAX_CHILDREN> childMetrics;
         
-        void UpdateMetrics();
+        Branch(const NodePtr* first, size_t n);
     };
     
-    std::unique_ptr<Node> m_Root;
+    static const Leaf& AsLeaf(const NodePtr& node) { return static_cast<const Leaf&>(*node); }
+    static const Branch& AsBranch(const NodePtr& node) { return static_cast<const Branch&>(*node); }
+    
+    NodePtr m_Root;
     EditInfo m_LastEdit{};
     
     // Cache for contiguous text access — updated incrementally on edits
@@ -139,19 +208,30 @@ private:
     mutable std::vector<size_t> m_LineStarts;
     mutable bool m_LineStartsDirty = true;
     
-    // Large file optimization:
-    // Instead of caching the whole file string, we only cache the visible range + padding
-    mutable std::string m_VisibleRangeBuf;
-    mutable size_t m_VisibleFirstLine = 0;
-    mutable size_t m_VisibleLastLine = 0;
-    mutable size_t m_VisibleRangeStart = 0;
+    // Above this the whole text is never made contiguous; views copy out the
+    // lines they show through a LineWindow instead
     static constexpr size_t LARGE_FILE_THRESHOLD = 1024 * 1024; // 1MB
 
     // Internal helpers
-    static std::unique_ptr<Node> BuildFromText(std::string_view text);
-    static std::pair<std::unique_ptr<Node>, std::unique_ptr<Node>> Split(std::unique_ptr<Node> node, size_t pos);
-    static std::unique_ptr<Node> Concat(std::unique_ptr<Node> left, std::unique_ptr<Node> right);
-    static std::unique_ptr<Node> Rebalance(std::unique_ptr<Node> node);
+    using NodeList = std::vector<NodePtr>;
+    static NodePtr BuildFromText(std::string_view text);
+    static void AppendLeaves(std::string_view text, NodeList& out);
+    static void AppendBranches(const NodeList& nodes, NodeList& out);
+    static NodePtr BuildRoot(NodeList nodes);
+    static NodePtr MakeLeaf(std::string_view text) { return std::make_shared<InlineLeaf>(text); }
+    static void AppendSlice(const NodePtr& leaf, size_t start, size_t end, NodeList& out);
+    static void InsertAt(const NodePtr& node, size_t pos, std::string_view text, NodeList& out);
+    static void EraseRange(const NodePtr& node, size_t start, size_t end, NodeList& out);
+    void SetRoot(NodeList nodes);
+    static void EditRange(const NodePtr& node, const Edit* edits, size_t count, NodeList& out);
+    static void FixUnderflow(NodeList& nodes);
+    static NodeList Merge(const NodePtr& a, const NodePtr& b);
+    static NodeList Join(const NodePtr& a, size_t heightA, const NodePtr& b, size_t heightB);
+    static size_t Height(const NodePtr& node);
+    static bool IsUnderfull(const NodePtr& node);
+    
+    size_t ByteToMetric(size_t Metrics::*metric, size_t pos) const;
+    size_t MetricToByte(size_t Metrics::*metric, size_t value) const;
     
     size_t FindLineStartDirect(size_t lineNum) const;
     std::string SubstringDirect(size_t pos, size_t len) const;
@@ -164,7 +244,64 @@ private:
     void PatchCacheInsert(size_t pos, std::string_view text);
     void PatchCacheDelete(size_t pos, size_t len);
     
-    size_t CountNewlines(std::string_view text) const;
 };
 
+class Rope::ChunkIterator {
+public:
+    ChunkIterator() = default;
+    
+    bool Valid() const { return m_Leaf != nullptr; }
+    std::string_view operator*() const { return m_Leaf->Text(); }
+    size_t Offset() const { return m_Offset; }  // Byte offset of the current chunk
+    
+    ChunkIterator& operator++();
+    ChunkIterator& operator--();
+    
+private:
+    friend class Rope;
+    static constexpr size_t MAX_DEPTH = 16;
+    
+    struct Frame {
+        const Branch* branch;
+        size_t index;
+    };
+    
+    void Seek(size_t pos);
+    void DescendFirst(const Node* node);
+    void DescendLast(const Node* node);
+    
+    NodePtr m_Root;  // Keeps the visited tree alive across edits
+    std::array<Frame, MAX_DEPTH> m_Path{};
+    size_t m_Depth = 0;
+    const Leaf* m_Leaf = nullptr;
+    size_t m_Offset = 0;
+};
+
+template <typename F>
+void Rope::ForEachChunk(size_t start, size_t end, F&& f) const {
+    end = std::min(end, Length());
+    for (ChunkIterator it = ChunkAt(start); it.Valid() && it.Offset() < end; ++it) {
+        std::string_view chunk = *it;
+        size_t from = start > it.Offset() ? start - it.Offset() : 0;
+        size_t to = std::min(chunk.length(), end - it.Offset());
+        if (from >= to) continue;
+        if constexpr (std::is_same_v<std::invoke_result_t<F&, std::string_view>, bool>) {
+            if (!f(chunk.substr(from, to - from))) return;
+        } else {
+            f(chunk.substr(from, to - from));
+        }
+    }
+}
+
+template <typename F>
+void Rope::ForEachInRange(size_t start, size_t end, F&& f) const {
+    size_t pos = start;
+    ForEachChunk(start, end, [&](std::string_view chunk) {
+        for (char c : chunk) {
+            if (!f(pos++, c)) return false;
+        }
+        return true;
+    });
+}
+
 } // namespace sol
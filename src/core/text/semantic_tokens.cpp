@@ -0,0 +1,82 @@
+#include "semantic_tokens.h"
+
+namespace sol {
+
+void SemanticTokens::SetFull(std::string resultId, std::vector<uint32_t> data) {
+    m_ResultId = std::move(resultId);
+    m_Full = std::move(data);
+    m_HasFull = true;
+    m_ShowingRange = false;
+    std::vector<uint32_t>().swap(m_Range);
+    BuildIndex();
+}
+
+bool SemanticTokens::ApplyDelta(std::string resultId, std::vector<LSPSemanticTokensEdit> edits) {
+    // Every edit refers to the array before any of them, so they go last first
+    std::sort(edits.begin(), edits.end(), [](const LSPSemanticTokensEdit& a, const LSPSemanticTokensEdit& b) { return a.start > b.start; });
+    for (const LSPSemanticTokensEdit& edit : edits) {
+        if (edit.start > m_Full.size() || edit.deleteCount > m_Full.size() - edit.start) return false;
+    }
+    for (LSPSemanticTokensEdit& edit : edits) {
+        auto at = m_Full.begin() + edit.start;
+        const size_t replaced = std::min<size_t>(edit.deleteCount, edit.data.size());
+        std::copy_n(edit.data.begin(), replaced, at);
+        if (edit.deleteCount > replaced) {
+            m_Full.erase(at + replaced, at + edit.deleteCount);
+        } else {
+            m_Full.insert(at + replaced, edit.data.begin() + replaced, edit.data.end());
+        }
+    }
+    m_ResultId = std::move(resultId);
+    m_ShowingRange = false;
+    std::vector<uint32_t>().swap(m_Range);
+    BuildIndex();
+    return true;
+}
+
+void SemanticTokens::SetRange(std::vector<uint32_t> data) {
+    m_Range = std::move(data);
+    m_ShowingRange = true;
+    BuildIndex();
+}
+
+void SemanticTokens::Clear() {
+    m_ResultId.clear();
+    std::vector<uint32_t>().swap(m_Full);
+    std::vector<uint32_t>().swap(m_Range);
+    std::vector<LineTokens>().swap(m_Lines);
+    m_HasFull = false;
+    m_ShowingRange = false;
+}
+
+void SemanticTokens::BuildIndex() {
+    m_Lines.clear();
+    const std::vector<uint32_t>& data = Shown();
+    const size_t count = data.size() / TOKEN_SIZE;
+    uint32_t line = 0;
+    for (size_t token = 0; token < count; ++token) {
+        const uint32_t deltaLine = data[token * TOKEN_SIZE];
+        line += deltaLine;
+        if (token == 0 || deltaLine != 0) m_Lines.push_back({line, static_cast<uint32_t>(token)});
+    }
+}
+
+void SemanticTokens::Shift(size_t startLine, size_t oldEndLine, size_t newEndLine) {
+    if (m_Lines.empty() || (startLine == oldEndLine && oldEndLine == newEndLine)) return;
+
+    auto first = std::lower_bound(m_Lines.begin(), m_Lines.end(), startLine,
+                                  [](const LineTokens& entry, size_t value) { return entry.line < value; });
+    auto last = std::upper_bound(first, m_Lines.end(), oldEndLine,
+                                 [](size_t value, const LineTokens& entry) { return value < entry.line; });
+    const int64_t delta = static_cast<int64_t>(newEndLine) - static_cast<int64_t>(oldEndLine);
+    for (auto it = last; it != m_Lines.end(); ++it) {
+        it->line = static_cast<uint32_t>(it->line + delta);
+    }
+    m_Lines.erase(first, last);
+}
+
+size_t SemanticTokens::GetMemoryUsage() const {
+    return (m_Full.capacity() + m_Range.capacity()) * sizeof(uint32_t) + m_Lines.capacity() * sizeof(LineTokens);
+}
+
+} // namespace sol
@@ -0,0 +1,84 @@
+#pragma once
+
+#include "core/lsp/lsp_types.h"
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace sol {
+
+// A buffer's semantic tokens as the language server encodes them: five
+// integers per token, positions relative to the previous token. The last
+// full result is kept exactly as sent so delta responses apply to it. A
+// sorted index of where each line's tokens start lets lines be read without
+// decoding the rest, and is all that edits touch: lines an edit rewrites
+// drop their tokens until the next result, later lines only move.
+class SemanticTokens {
+public:
+    static constexpr size_t TOKEN_SIZE = 5;
+
+    // Highlight id per token type index of the server's legend
+    void SetLegend(std::vector<uint16_t> groups) { m_Groups = std::move(groups); }
+    bool HasLegend() const { return !m_Groups.empty(); }
+
+    void SetFull(std::string resultId, std::vector<uint32_t> data);
+    // Edits are against the last full result; false if one is out of its bounds
+    bool ApplyDelta(std::string resultId, std::vector<LSPSemanticTokensEdit> edits);
+    // Tokens of part of the text, shown until the next full result
+    void SetRange(std::vector<uint32_t> data);
+    void Clear();
+
+    const std::string& GetResultId() const { return m_ResultId; }
+    bool HasFull() const { return m_HasFull; }
+    bool IsShowingRange() const { return m_ShowingRange; }
+    bool Empty() const { return m_Lines.empty(); }
+
+    // Rows [startLine, oldEndLine] became [startLine, newEndLine]. An edit
+    // within one line keeps that line's tokens, at most a few columns off.
+    void Shift(size_t startLine, size_t oldEndLine, size_t newEndLine);
+
+    // Calls f(utf16Start, utf16Length, highlightId) for the line's tokens in
+    // column order, skipping types without a highlight
+    template <typename F>
+    void ForLine(size_t line, F&& f) const;
+
+    size_t GetMemoryUsage() const;
+
+private:
+    void BuildIndex();
+    const std::vector<uint32_t>& Shown() const { return m_ShowingRange ? m_Range : m_Full; }
+
+    struct LineTokens {
+        uint32_t line;
+        uint32_t first;  // Token index into the shown data
+    };
+
+    std::vector<uint16_t> m_Groups;
+    std::string m_ResultId;
+    std::vector<uint32_t> m_Full;
+    bool m_HasFull = false;
+    std::vector<uint32_t> m_Range;
+    bool m_ShowingRange = false;
+    std::vector<LineTokens> m_Lines;  // Sorted by line
+};
+
+template <typename F>
+void SemanticTokens::ForLine(size_t line, F&& f) const {
+    auto it = std::lower_bound(m_Lines.begin(), m_Lines.end(), line,
+                               [](const LineTokens& entry, size_t value) { return entry.line < value; });
+    if (it == m_Lines.end() || it->line != line) return;
+
+    const std::vector<uint32_t>& data = Shown();
+    const size_t count = data.size() / TOKEN_SIZE;
+    uint32_t column = 0;
+    for (size_t token = it->first; token < count; ++token) {
+        const uint32_t* t = data.data() + token * TOKEN_SIZE;
+        if (token != it->first && t[0] != 0) break;
+        column = token == it->first ? t[1] : column + t[1];
+        if (t[3] < m_Groups.size() && m_Groups[t[3]] != 0) f(column, t[2], m_Groups[t[3]]);
+    }
+}
+
+} // namespace sol
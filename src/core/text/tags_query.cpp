@@ -0,0 +1,101 @@
+#include "tags_query.h"
+#include "core/logger.h"
+#include <algorithm>
+
+namespace sol {
+
+namespace {
+
+constexpr std::pair<std::string_view, SymbolKind> DEFINITION_KINDS[] = {
+    {"definition.function", SymbolKind::Function},
+    {"definition.method", SymbolKind::Method},
+    {"definition.class", SymbolKind::Class},
+    {"definition.interface", SymbolKind::Interface},
+    {"definition.module", SymbolKind::Module},
+    {"definition.macro", SymbolKind::Macro},
+    {"definition.type", SymbolKind::Type},
+    {"definition.constant", SymbolKind::Constant},
+    {"definition.variable", SymbolKind::Variable},
+};
+
+} // namespace
+
+std::unique_ptr<TagsQuery> TagsQuery::Compile(const TSLanguage* language, std::string_view source) {
+    if (!language || source.empty()) return nullptr;
+    
+    uint32_t errorOffset = 0;
+    TSQueryError error = TSQueryErrorNone;
+    TSQuery* query = ts_query_new(language, source.data(), static_cast<uint32_t>(source.length()), &errorOffset, &error);
+    if (!query) {
+        Logger::Error("Invalid tags query at offset ", errorOffset);
+        return nullptr;
+    }
+    
+    std::unique_ptr<TagsQuery> result(new TagsQuery());
+    result->m_Query = query;
+    
+    const uint32_t captureCount = ts_query_capture_count(query);
+    result->m_CaptureKinds.assign(captureCount, NOT_A_DEFINITION);
+    for (uint32_t i = 0; i < captureCount; ++i) {
+        uint32_t length = 0;
+        const char* raw = ts_query_capture_name_for_id(query, i, &length);
+        std::string_view name(raw, length);
+        if (name == "name") {
+            result->m_NameCapture = i;
+        } else if (name.starts_with("definition.")) {
+            auto kind = std::find_if(std::begin(DEFINITION_KINDS), std::end(DEFINITION_KINDS),
+                                     [name](const auto& entry) { return entry.first == name; });
+            result->m_CaptureKinds[i] = static_cast<uint32_t>(kind != std::end(DEFINITION_KINDS) ? kind->second : SymbolKind::Other);
+        }
+    }
+    
+    result->m_Predicates.Compile(query);
+    return result;
+}
+
+TagsQuery::~TagsQuery() {
+    if (m_Query) ts_query_delete(m_Query);
+}
+
+void TagsQuery::Definitions(TSNode root, const Rope& text, std::vector<SymbolDefinition>& out) const {
+    if (m_NameCapture == UINT32_MAX) return;
+    
+    const size_t first = out.size();
+    TSQueryCursor* cursor = ts_query_cursor_new();
+    ts_query_cursor_exec(cursor, m_Query, root);
+    
+    TSQueryMatch match;
+    while (ts_query_cursor_next_match(cursor, &match)) {
+        const TSQueryCapture* name = nullptr;
+        uint32_t kind = NOT_A_DEFINITION;
+        for (uint16_t i = 0; i < match.capture_count; ++i) {
+            const uint32_t index = match.captures[i].index;
+            if (index == m_NameCapture) name = &match.captures[i];
+            else if (m_CaptureKinds[index] != NOT_A_DEFINITION) kind = m_CaptureKinds[index];
+        }
+        if (!name || kind == NOT_A_DEFINITION || !m_Predicates.Accepts(match, text)) continue;
+        
+        const uint32_t start = ts_node_start_byte(name->node);
+        const uint32_t end = ts_node_end_byte(name->node);
+        if (start >= end) continue;
+        const TSPoint point = ts_node_start_point(name->node);
+        out.push_back(SymbolDefinition{
+            .name = text.Substring(start, end - start),
+            .kind = static_cast<SymbolKind>(kind),
+            .line = point.row,
+            .column = point.column
+        });
+    }
+    ts_query_cursor_delete(cursor);
+    
+    // Overlapping patterns may define one name twice
+    auto before = [](const SymbolDefinition& a, const SymbolDefinition& b) {
+        return a.line != b.line ? a.line < b.line : a.column < b.column;
+    };
+    std::stable_sort(out.begin() + first, out.end(), before);
+    out.erase(std::unique(out.begin() + first, out.end(), [](const SymbolDefinition& a, const SymbolDefinition& b) {
+        return a.line == b.line && a.column == b.column;
+    }), out.end());
+}
+
+} // namespace sol
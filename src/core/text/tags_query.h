@@ -0,0 +1,41 @@
+#pragma once
+
+#include "text_buffer.h"
+#include "query_predicates.h"
+#include <tree_sitter/api.h>
+#include <memory>
+#include <string_view>
+#include <vector>
+
+namespace sol {
+
+// tags.scm of a bundled grammar, embedded at build time; empty when the
+// grammar ships none
+std::string_view BundledTagsQuery(std::string_view language);
+
+// A grammar's tags.scm, compiled once per language. Each match pairs a
+// @definition.<kind> capture with the @name of what it defines; references
+// and documentation captures are ignored.
+class TagsQuery {
+public:
+    static std::unique_ptr<TagsQuery> Compile(const TSLanguage* language, std::string_view source);
+    ~TagsQuery();
+    
+    TagsQuery(const TagsQuery&) = delete;
+    TagsQuery& operator=(const TagsQuery&) = delete;
+    
+    // Appends the definitions under root in source order
+    void Definitions(TSNode root, const Rope& text, std::vector<SymbolDefinition>& out) const;
+    
+private:
+    TagsQuery() = default;
+    
+    static constexpr uint32_t NOT_A_DEFINITION = UINT32_MAX;
+    
+    TSQuery* m_Query = nullptr;
+    uint32_t m_NameCapture = UINT32_MAX;
+    std::vector<uint32_t> m_CaptureKinds;  // SymbolKind per capture id, or NOT_A_DEFINITION
+    QueryPredicates m_Predicates;
+};
+
+} // namespace sol
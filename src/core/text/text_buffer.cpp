@@ -1,9 +1,26 @@
 #include "text_buffer.h"
+#include "highlight_query.h"
+#include "tags_query.h"
+#include "edit_session.h"
 #include "core/lsp/lsp_manager.h"
+#include "undo_file.h"
+#include "parser_pool.h"
+#include "core/platform/mapped_file.h"
+#include "core/cancellation.h"
+#include "core/job_system.h"
+#include "core/profiler.h"
+#include "core/utils/hash.h"
 #include <tree_sitter/api.h>
 #include <algorithm>
-#include <set>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <optional>
+#include <utility>
 #include <cctype>
+#include <cstdlib>
 #include <cstring>
 
 // Language declarations
@@ -22,291 +39,1056 @@ extern "C" {
 
 namespace sol {
 
+namespace {
+
+// Small enough that the first screen is indexed within a frame or two
+constexpr size_t INDEX_RANGE_SIZE = 8 * 1024 * 1024;
+
+// Longer parses are split into slices of this length so they share the
+// workers with other jobs
+constexpr uint64_t PARSE_SLICE_MICROS = 20000;
+
+// Larger texts are only highlighted lexically; trees cost many times the text
+constexpr size_t MAX_PARSE_SIZE = 32 * 1024 * 1024;
+
+// Tree-sitter cannot report a tree's size, only how many visible nodes it
+// has; this is roughly what each takes with the hidden nodes between them
+constexpr size_t TREE_BYTES_PER_NODE = 96;
+
+// Semantic tokens are asked for once typing pauses; a failed or unanswered
+// request, or a server not ready yet, is retried after a while
+constexpr auto SEMANTIC_DEBOUNCE = std::chrono::milliseconds(100);
+constexpr auto SEMANTIC_RETRY = std::chrono::seconds(2);
+constexpr auto SEMANTIC_TIMEOUT = std::chrono::seconds(10);
+
+// Line shifts kept for views to catch up with; one further behind redoes
+// its per-line state
+constexpr size_t MAX_LINE_SHIFTS = 1024;
+
+} // namespace
+
+struct TextBuffer::IndexState {
+    struct Range {
+        size_t begin;
+        size_t end;
+        std::optional<Rope> rope;
+        bool claimed = false;
+        bool failed = false;
+    };
+    
+    std::shared_ptr<const MappedFile> file;
+    bool copy = false;          // Ranges are read into memory rather than mapped
+    std::vector<Range> ranges;  // Never resized once jobs are submitted
+    size_t published = 0;       // Owner thread only
+    bool restore = false;          // Brings back an unloaded text
+    std::optional<uint64_t> hash;  // Of the whole file, taken when opening it
+    bool hashClaimed = false;
+    std::atomic<size_t> indexedBytes{0};
+    CancellationSource cancel;
+    std::mutex mutex;
+    std::condition_variable finished;
+    
+    // Returns false if another thread already claimed the range
+    bool Build(size_t i) {
+        Range& range = ranges[i];
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (range.claimed) return false;
+            range.claimed = true;
+            range.failed = false;
+        }
+        Rope part(file, range.begin, range.end, copy);
+        indexedBytes += range.end - range.begin;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            range.rope = std::move(part);
+        }
+        finished.notify_all();
+        return true;
+    }
+    
+    // Returns false if another thread already claimed the hash
+    bool Hash() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (hashClaimed) return false;
+            hashClaimed = true;
+        }
+        const uint64_t value = StreamHash::Of(std::string_view(file->Data(), file->Size()));
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            hash = value;
+        }
+        finished.notify_all();
+        return true;
+    }
+    
+    void Fail(size_t i) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            ranges[i].claimed = false;
+            ranges[i].failed = true;
+        }
+        finished.notify_all();
+    }
+};
+
+// A background parse leases a parser from the pool; the buffer keeps a copy
+// of the edits it made meanwhile so the result can be caught up instead of
+// thrown away. The parse runs in timed slices, each claimed by a worker or
+// by a caller too impatient to wait for the next one to be dequeued; a slice
+// that runs out of time leaves the parser halted and keeps it leased for the
+// next to resume.
+struct TextBuffer::ParseState {
+    const TSLanguage* language;
+    ParserPool::Lease parser;
+    CancellationSource cancel;  // Also polled by tree-sitter during the parse
+    std::mutex mutex;
+    std::condition_variable finished;
+    uint64_t generation = 0;
+    bool claimed = false;  // A slice is running
+    bool started = false;  // The leased parser holds a halted parse of text
+    bool done = false;
+    TSTree* result = nullptr;
+    std::chrono::steady_clock::duration spent{};  // In the parser, over the slices of this generation
+    
+    // Input of the current generation, released once it is parsed
+    Rope text;
+    TSTree* old = nullptr;
+    
+    // Owner thread only
+    bool inFlight = false;
+    std::vector<TSInputEdit> edits;  // Applied to the buffer's tree since the parse started
+    
+    explicit ParseState(const TSLanguage* lang) : language(lang) {}
+    
+    ~ParseState() {
+        if (result) ts_tree_delete(result);
+        if (old) ts_tree_delete(old);
+    }
+    
+    uint64_t Begin(Rope snapshot, TSTree* base) {
+        std::lock_guard<std::mutex> lock(mutex);
+        parser.Reset();
+        if (old) ts_tree_delete(old);
+        text = std::move(snapshot);
+        old = base;
+        claimed = false;
+        started = false;
+        done = false;
+        spent = {};
+        return ++generation;
+    }
+    
+    // Fails if the parse finished or a slice of it is running
+    bool Claim(uint64_t gen) {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (claimed || done || gen != generation) return false;
+        claimed = true;
+        return true;
+    }
+    
+    // Runs the claimed parse until it finishes, times out or is cancelled;
+    // 0 lets it run to the end
+    TSTree* Run(uint64_t timeoutMicros = PARSE_SLICE_MICROS) {
+        SOL_PROFILE_ZONE("TextBuffer::BackgroundParse");
+        const auto start = std::chrono::steady_clock::now();
+        TSTree* tree = nullptr;
+        if (!cancel.IsCancelled()) {
+            if (!parser) {
+                parser = ParserPool::GetInstance().Acquire(language);
+                ts_parser_set_cancellation_flag(parser.Get(), cancel.Token().Flag());
+            }
+            ts_parser_set_timeout_micros(parser.Get(), timeoutMicros);
+            tree = ts_parser_parse(parser.Get(), old, MakeInput(text));
+        }
+        const auto elapsed = std::chrono::steady_clock::now() - start;
+        if (!tree && !cancel.IsCancelled()) {
+            std::lock_guard<std::mutex> lock(mutex);
+            started = true;
+            claimed = false;
+            spent += elapsed;
+        } else {
+            Finish(tree, elapsed);
+        }
+        finished.notify_all();
+        return tree;
+    }
+    
+    void Finish(TSTree* tree, std::chrono::steady_clock::duration elapsed = {}) {
+        std::lock_guard<std::mutex> lock(mutex);
+        result = tree;
+        done = true;
+        spent += elapsed;
+        parser.Reset();
+        text = Rope();
+        if (old) ts_tree_delete(old);
+        old = nullptr;
+    }
+    
+    bool IsDone() {
+        std::lock_guard<std::mutex> lock(mutex);
+        return done;
+    }
+    
+    // Until the parse finishes or its running slice ends; returns done
+    bool Wait() {
+        std::unique_lock<std::mutex> lock(mutex);
+        finished.wait(lock, [this] { return done || !claimed; });
+        return done;
+    }
+    
+    static void Submit(const std::shared_ptr<ParseState>& state, uint64_t gen) {
+        JobSystem::Submit(JobPriority::Interactive, state->cancel.Token(), [state, gen] {
+            if (state->Claim(gen) && !state->Run() && !state->IsDone()) Submit(state, gen);
+        });
+    }
+};
+
+// One semantic tokens request; the answer arrives on the language client's
+// reader thread
+struct TextBuffer::SemanticRequest {
+    CancellationSource cancel;  // Withdraws the request from the server
+    std::mutex mutex;
+    bool done = false;
+    std::optional<LSPSemanticTokens> result;
+    
+    // Owner thread only
+    bool range = false;
+    std::pair<size_t, size_t> lines;
+    uint64_t editCount = 0;
+    std::chrono::steady_clock::time_point sent;
+    std::vector<std::array<size_t, 3>> shifts;  // Line shifts of the edits made since it was sent
+};
+
 // TextBuffer implementation
-TextBuffer::TextBuffer() {
-    m_Parser = ts_parser_new();
-}
+TextBuffer::TextBuffer() = default;
 
-TextBuffer::TextBuffer(std::string_view text) : m_Rope(text) {
-    m_Parser = ts_parser_new();
-}
+TextBuffer::TextBuffer(std::string_view text) : m_Rope(text) {}
 
 TextBuffer::~TextBuffer() {
+    CancelIndexing();
+    CancelParsing();
+    CancelSemanticRequest();
     ReleaseTree();
-    if (m_Parser) {
-        ts_parser_delete(m_Parser);
-    }
 }
 
 TextBuffer::TextBuffer(TextBuffer&& other) noexcept
     : m_Rope(std::move(other.m_Rope))
-    , m_Parser(other.m_Parser)
+    , m_UndoTree(std::move(other.m_UndoTree))
+    , m_Session(std::move(other.m_Session))
+    , m_IsDiskBuffered(other.m_IsDiskBuffered)
+    , m_Indexing(std::move(other.m_Indexing))
     , m_Tree(other.m_Tree)
+    , m_Parsing(std::move(other.m_Parsing))
+    , m_LastParseTime(other.m_LastParseTime)
+    , m_Highlights(std::move(other.m_Highlights))
+    , m_HighlightStats(other.m_HighlightStats)
+    , m_Folds(std::move(other.m_Folds))
+    , m_Semantic(std::move(other.m_Semantic))
+    , m_SemanticRequest(std::move(other.m_SemanticRequest))
+    , m_SemanticProvider(std::move(other.m_SemanticProvider))
+    , m_EditCount(other.m_EditCount)
+    , m_SemanticVersion(other.m_SemanticVersion)
+    , m_SemanticLines(other.m_SemanticLines)
+    , m_SemanticNotBefore(other.m_SemanticNotBefore)
+    , m_Diagnostics(std::move(other.m_Diagnostics))
+    , m_Identifiers(std::move(other.m_Identifiers))
     , m_Language(other.m_Language)
     , m_FilePath(std::move(other.m_FilePath))
-    , m_Modified(other.m_Modified) {
-    other.m_Parser = nullptr;
+    , m_Modified(other.m_Modified)
+    , m_LineShifts(std::move(other.m_LineShifts))
+    , m_LineShiftsFrom(other.m_LineShiftsFrom)
+    , m_LineVersion(other.m_LineVersion) {
     other.m_Tree = nullptr;
 }
 
 TextBuffer& TextBuffer::operator=(TextBuffer&& other) noexcept {
     if (this != &other) {
+        CancelIndexing();
+        CancelParsing();
+        CancelSemanticRequest();
         ReleaseTree();
-        if (m_Parser) ts_parser_delete(m_Parser);
         
         m_Rope = std::move(other.m_Rope);
-        m_Parser = other.m_Parser;
+        m_UndoTree = std::move(other.m_UndoTree);
+        m_Session = std::move(other.m_Session);
+        m_IsDiskBuffered = other.m_IsDiskBuffered;
+        m_Indexing = std::move(other.m_Indexing);
         m_Tree = other.m_Tree;
+        m_Parsing = std::move(other.m_Parsing);
+        m_LastParseTime = other.m_LastParseTime;
+        m_Highlights = std::move(other.m_Highlights);
+        m_HighlightStats = other.m_HighlightStats;
+        m_Folds = std::move(other.m_Folds);
+        m_Semantic = std::move(other.m_Semantic);
+        m_SemanticRequest = std::move(other.m_SemanticRequest);
+        m_SemanticProvider = std::move(other.m_SemanticProvider);
+        m_EditCount = other.m_EditCount;
+        m_SemanticVersion = other.m_SemanticVersion;
+        m_SemanticLines = other.m_SemanticLines;
+        m_SemanticNotBefore = other.m_SemanticNotBefore;
+        m_Diagnostics = std::move(other.m_Diagnostics);
+        m_Identifiers = std::move(other.m_Identifiers);
         m_Language = other.m_Language;
         m_FilePath = std::move(other.m_FilePath);
         m_Modified = other.m_Modified;
+        m_LineShifts = std::move(other.m_LineShifts);
+        m_LineShiftsFrom = other.m_LineShiftsFrom;
+        m_LineVersion = other.m_LineVersion;
         
-        other.m_Parser = nullptr;
         other.m_Tree = nullptr;
     }
     return *this;
 }
 
 void TextBuffer::Insert(size_t pos, std::string_view text) {
+    if (text.empty()) return;
+    if (m_Transaction) {
+        m_Rope.Insert(pos, text);
+        return;
+    }
+    const Rope::Edit edit{std::min(pos, m_Rope.Length()), 0, text};
+    if (m_Session) m_Session->RecordEdits({&edit, 1});
+    const auto changes = ChangesFor({&edit, 1});
     m_Rope.Insert(pos, text);
     m_Modified = true;
     ParseIncremental();
-    
-    if (m_Language && !m_Rope.IsLargeFile()) {
-        LSPManager::GetInstance().DidChange(m_FilePath.string(), std::string(m_Rope.CStr(), m_Rope.Length()), m_Language->name);
-    }
+    NotifyChanged(changes);
 }
 
 void TextBuffer::Delete(size_t pos, size_t len) {
+    if (len == 0 || pos >= m_Rope.Length()) return;
+    if (m_Transaction) {
+        m_Rope.Delete(pos, len);
+        return;
+    }
+    const Rope::Edit edit{pos, std::min(len, m_Rope.Length() - pos), {}};
+    if (m_Session) m_Session->RecordEdits({&edit, 1});
+    const auto changes = ChangesFor({&edit, 1});
     m_Rope.Delete(pos, len);
     m_Modified = true;
     ParseIncremental();
-    
-    if (m_Language && !m_Rope.IsLargeFile()) {
-        LSPManager::GetInstance().DidChange(m_FilePath.string(), std::string(m_Rope.CStr(), m_Rope.Length()), m_Language->name);
-    }
+    NotifyChanged(changes);
 }
 
+// One rope edit, so the tree is shifted by the whole replacement rather than
+// by its insert half only
 void TextBuffer::Replace(size_t pos, size_t len, std::string_view text) {
-    m_Rope.Replace(pos, len, text);
+    pos = std::min(pos, m_Rope.Length());
+    len = std::min(len, m_Rope.Length() - pos);
+    if (len == 0 && text.empty()) return;
+    const std::vector<Rope::Edit> edits{{pos, len, text}};
+    if (m_Transaction) {
+        m_Rope.ApplyEdits(edits);
+        return;
+    }
+    if (m_Session) m_Session->RecordEdits(edits);
+    const auto changes = ChangesFor(edits);
+    std::vector<Rope::EditInfo> infos = m_Rope.ApplyEdits(edits);
     m_Modified = true;
-    ParseIncremental();
+    ParseEdited(infos);
+    NotifyChanged(changes);
+}
+
+bool TextBuffer::ApplyEdits(std::vector<TextEdit>& edits, std::vector<std::string>* replaced) {
+    std::stable_sort(edits.begin(), edits.end(), [](const TextEdit& a, const TextEdit& b) { return a.pos < b.pos; });
+    size_t end = 0;
+    for (const TextEdit& edit : edits) {
+        if (edit.pos < end || edit.pos > m_Rope.Length() || edit.len > m_Rope.Length() - edit.pos) return false;
+        end = edit.pos + edit.len;
+    }
+    if (replaced) replaced->clear();
+    if (edits.empty()) return true;
+    
+    std::vector<Rope::Edit> ropeEdits;
+    ropeEdits.reserve(edits.size());
+    if (replaced) replaced->reserve(edits.size());
+    for (const TextEdit& edit : edits) {
+        if (replaced) replaced->push_back(m_Rope.Substring(edit.pos, edit.len));
+        ropeEdits.push_back({edit.pos, edit.len, edit.text});
+    }
+    if (m_Transaction) {
+        m_Rope.ApplyEdits(ropeEdits);
+        return true;
+    }
+    
+    if (m_Session) m_Session->RecordEdits(ropeEdits);
+    const auto changes = ChangesFor(ropeEdits);
+    auto infos = m_Rope.ApplyEdits(ropeEdits);
+    m_Modified = true;
+    ParseEdited(infos);
+    NotifyChanged(changes);
+    return true;
+}
+
+namespace {
+
+size_t CommonPrefix(const Rope& a, const Rope& b) {
+    const size_t limit = std::min(a.Length(), b.Length());
+    if (limit == 0) return 0;
+    auto ia = a.ChunkAt(0);
+    auto ib = b.ChunkAt(0);
+    size_t same = 0;
+    while (same < limit && ia.Valid() && ib.Valid()) {
+        const std::string_view ca = (*ia).substr(same - ia.Offset());
+        const std::string_view cb = (*ib).substr(same - ib.Offset());
+        const size_t n = std::min({ca.size(), cb.size(), limit - same});
+        const size_t run = std::mismatch(ca.begin(), ca.begin() + n, cb.begin()).first - ca.begin();
+        same += run;
+        if (run < n) break;
+        if (same - ia.Offset() == (*ia).size()) ++ia;
+        if (same - ib.Offset() == (*ib).size()) ++ib;
+    }
+    return same;
+}
+
+// At most limit bytes, so the suffix never overlaps the prefix
+size_t CommonSuffix(const Rope& a, const Rope& b, size_t limit) {
+    if (limit == 0) return 0;
+    auto ia = a.ChunkAt(a.Length() - 1);
+    auto ib = b.ChunkAt(b.Length() - 1);
+    size_t same = 0;
+    while (same < limit && ia.Valid() && ib.Valid()) {
+        const std::string_view ca = (*ia).substr(0, a.Length() - same - ia.Offset());
+        const std::string_view cb = (*ib).substr(0, b.Length() - same - ib.Offset());
+        const size_t n = std::min({ca.size(), cb.size(), limit - same});
+        const size_t run = std::mismatch(ca.rbegin(), ca.rbegin() + n, cb.rbegin()).first - ca.rbegin();
+        same += run;
+        if (run < n) break;
+        if (a.Length() - same == ia.Offset()) --ia;
+        if (b.Length() - same == ib.Offset()) --ib;
+    }
+    return same;
+}
+
+} // namespace
+
+std::shared_ptr<EditSession> TextBuffer::StartRecording() {
+    FinishIndexing();
+    m_Session = std::make_shared<EditSession>(m_FilePath.filename().string(), m_Rope.ToString());
+    m_UndoTree.SetSession(m_Session);
+    return m_Session;
+}
+
+void TextBuffer::BeginTransaction() {
+    if (!m_Transaction) m_Transaction = m_Rope.Snapshot();
+}
+
+// The text before and after share an unchanged head and tail, so rewinding
+// and replacing just the middle leaves the same text through one edit
+void TextBuffer::EndTransaction(size_t cursorBefore, size_t cursorAfter) {
+    if (!m_Transaction) return;
+    Rope after = std::move(m_Rope);
+    m_Rope = std::move(*m_Transaction);
+    m_Transaction.reset();
+    
+    const size_t prefix = CommonPrefix(m_Rope, after);
+    const size_t suffix = CommonSuffix(m_Rope, after, std::min(m_Rope.Length(), after.Length()) - prefix);
+    const size_t oldLen = m_Rope.Length() - prefix - suffix;
+    const std::string newText = after.Substring(prefix, after.Length() - prefix - suffix);
+    if (oldLen == 0 && newText.empty()) return;
+    
+    EditOperation op = EditOperation::Replace(prefix, m_Rope.Substring(prefix, oldLen), newText, cursorBefore);
+    op.cursorAfter = cursorAfter;
+    Replace(prefix, oldLen, newText);
+    m_UndoTree.Push(op);
+}
+
+// A loading text is opened with the server only once complete, and mapped
+// files are never opened
+std::vector<LSPTextChange> TextBuffer::ChangesFor(std::span<const Rope::Edit> edits) const {
+    std::vector<LSPTextChange> changes;
+    if (!m_Language || m_Indexing || m_IsDiskBuffered || !LSPManager::GetInstance().HasServerFor(m_Language->name)) {
+        return changes;
+    }
     
-    if (m_Language && !m_Rope.IsLargeFile()) {
-        LSPManager::GetInstance().DidChange(m_FilePath.string(), std::string(m_Rope.CStr(), m_Rope.Length()), m_Language->name);
+    changes.reserve(edits.size());
+    for (auto edit = edits.rbegin(); edit != edits.rend(); ++edit) {
+        const auto [startLine, startColumn] = m_Rope.PosToLineUtf16Col(edit->pos);
+        const auto [endLine, endColumn] = m_Rope.PosToLineUtf16Col(edit->pos + edit->len);
+        LSPRange range{{static_cast<int>(startLine), static_cast<int>(startColumn)},
+                       {static_cast<int>(endLine), static_cast<int>(endColumn)}};
+        changes.push_back({range, std::string(edit->text)});
     }
+    return changes;
+}
+
+void TextBuffer::NotifyChanged(const std::vector<LSPTextChange>& changes) {
+    if (changes.empty()) return;
+    LSPManager::GetInstance().DidChange(m_FilePath.string(), changes, [this] { return m_Rope.ToString(); }, m_Language->name);
 }
 
 void TextBuffer::SetLanguage(const Language* lang) {
     m_Language = lang;
-    if (m_Parser && lang && lang->tsLanguage) {
-        ts_parser_set_language(m_Parser, lang->tsLanguage);
-        Parse();  // Full parse with new language
+    m_Semantic.SetLegend({});
+    Reparse();
+}
+
+// The whole text changed, so nothing of the old tree is worth reusing
+void TextBuffer::SyncFromBuffer() {
+    m_Rope.SyncFromBuffer();
+    ResetLineShifts();
+    Reparse();
+}
+
+bool TextBuffer::GetLineShiftsSince(uint64_t version, std::vector<LineShift>& out) const {
+    if (version < m_LineShiftsFrom || version > m_LineVersion) return false;
+    out.insert(out.end(), m_LineShifts.begin() + (version - m_LineShiftsFrom), m_LineShifts.end());
+    return true;
+}
+
+void TextBuffer::PushLineShift(const LineShift& shift) {
+    m_LineShifts.push_back(shift);
+    ++m_LineVersion;
+    if (m_LineShifts.size() > MAX_LINE_SHIFTS) {
+        m_LineShifts.pop_front();
+        ++m_LineShiftsFrom;
     }
 }
 
+// Versions before this one can no longer be replayed
+void TextBuffer::ResetLineShifts() {
+    m_LineShifts.clear();
+    m_LineShiftsFrom = ++m_LineVersion;
+}
+
+void TextBuffer::Reparse() {
+    CancelParsing();
+    ReleaseTree();
+    ResetSemanticTokens();
+    if (CanParse()) StartParse();
+}
+
+// Mapped files are too large to parse, and texts grow without edits while indexing
+bool TextBuffer::CanParse() const {
+    return m_Language && m_Language->tsLanguage && !m_IsDiskBuffered && !m_Indexing &&
+           m_Rope.Length() <= MAX_PARSE_SIZE;
+}
+
 void TextBuffer::ReleaseTree() {
     if (m_Tree) {
         ts_tree_delete(m_Tree);
         m_Tree = nullptr;
     }
+    m_Highlights.clear();
+    InvalidateFolds();
+    m_Identifiers.Reset(0);
+    ResetLineShifts();
 }
 
 const char* TextBuffer::TSRead(void* payload, uint32_t byteOffset, TSPoint position, uint32_t* bytesRead) {
-    TextBuffer* buffer = static_cast<TextBuffer*>(payload);
-    
-    size_t len = buffer->m_Rope.Length();
-    if (byteOffset >= len) {
+    const Rope& rope = *static_cast<const Rope*>(payload);
+    if (byteOffset >= rope.Length()) {
         *bytesRead = 0;
-        return nullptr;
+        return "";
     }
     
-    // Use the cached string for reading
-    const char* str = const_cast<TextBuffer*>(buffer)->m_Rope.CStr();
-    *bytesRead = static_cast<uint32_t>(len - byteOffset);
-    return str + byteOffset;
+    // Serve straight from the leaf holding byteOffset; leaves stay alive
+    // while the tree is being parsed, so no contiguous copy is needed
+    Rope::ChunkIterator it = rope.ChunkAt(byteOffset);
+    std::string_view chunk = (*it).substr(byteOffset - it.Offset());
+    *bytesRead = static_cast<uint32_t>(chunk.length());
+    return chunk.data();
+}
+
+TSInput TextBuffer::MakeInput(const Rope& rope) {
+    return TSInput{
+        const_cast<Rope*>(&rope),
+        TSRead,
+        TSInputEncodingUTF8
+    };
 }
 
 void TextBuffer::Parse() {
-    if (!m_Parser || !m_Language || !m_Language->tsLanguage) {
-        return;
-    }
-    
-    if (m_Rope.IsLargeFile()) return;
+    if (!CanParse()) return;
     
+    CancelParsing();
     ReleaseTree();
-    
-    // Use cached buffer directly — no copy needed
-    const char* content = m_Rope.CStr();
-    uint32_t len = static_cast<uint32_t>(m_Rope.Length());
-    m_Tree = ts_parser_parse_string(
-        m_Parser,
-        nullptr,
-        content,
-        len
-    );
+    m_Tree = ParseNow(nullptr);
+}
+
+TSTree* TextBuffer::ParseNow(TSTree* old) {
+    const auto start = std::chrono::steady_clock::now();
+    ParserPool::Lease parser = ParserPool::GetInstance().Acquire(m_Language->tsLanguage);
+    TSTree* tree = ts_parser_parse(parser.Get(), old, MakeInput(m_Rope));
+    m_LastParseTime = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start);
+    return tree;
 }
 
 void TextBuffer::ParseIncremental() {
-    if (!m_Parser || !m_Language || !m_Language->tsLanguage) {
-        return;
+    SOL_PROFILE_ZONE("TextBuffer::ParseIncremental");
+    Rope::EditInfo edit = m_Rope.GetLastEdit();
+    ParseEdited(std::span(&edit, 1));
+}
+
+// Edits of a batch are all positioned in the text before it, so the tree is
+// shifted last to first and each edit's coordinates stay valid
+void TextBuffer::ParseEdited(std::span<const Rope::EditInfo> edits) {
+    for (auto it = edits.rbegin(); it != edits.rend(); ++it) {
+        m_Identifiers.Shift(it->startPoint.first, it->oldEndPoint.first, it->newEndPoint.first);
+        m_Semantic.Shift(it->startPoint.first, it->oldEndPoint.first, it->newEndPoint.first);
+        if (m_SemanticRequest) {
+            m_SemanticRequest->shifts.push_back({it->startPoint.first, it->oldEndPoint.first, it->newEndPoint.first});
+        }
+        m_Diagnostics.Shift(it->startByte, it->oldEndByte, it->newEndByte);
+        PushLineShift({it->startPoint.first, it->oldEndPoint.first, it->newEndPoint.first});
     }
+    ++m_EditCount;
+    m_SemanticNotBefore = std::max(m_SemanticNotBefore, std::chrono::steady_clock::now() + SEMANTIC_DEBOUNCE);
     
-    if (m_Rope.IsLargeFile()) return;
+    if (!m_Language) return;
     
-    if (!m_Tree) {
-        Parse();
+    // Past the parse limit the text is highlighted lexically
+    if (!CanParse()) {
+        if (m_Tree || m_Parsing) {
+            CancelParsing();
+            ReleaseTree();
+            return;
+        }
+        for (auto it = edits.rbegin(); it != edits.rend(); ++it) ShiftHighlights(*it);
         return;
     }
     
-    // Get edit info from rope
-    auto edit = m_Rope.GetLastEdit();
-    
-    TSInputEdit tsEdit = {
-        .start_byte = static_cast<uint32_t>(edit.startByte),
-        .old_end_byte = static_cast<uint32_t>(edit.oldEndByte),
-        .new_end_byte = static_cast<uint32_t>(edit.newEndByte),
-        .start_point = {
-            .row = static_cast<uint32_t>(edit.startPoint.first),
-            .column = static_cast<uint32_t>(edit.startPoint.second)
-        },
-        .old_end_point = {
-            .row = static_cast<uint32_t>(edit.oldEndPoint.first),
-            .column = static_cast<uint32_t>(edit.oldEndPoint.second)
-        },
-        .new_end_point = {
-            .row = static_cast<uint32_t>(edit.newEndPoint.first),
-            .column = static_cast<uint32_t>(edit.newEndPoint.second)
-        }
-    };
+    const bool inFlight = m_Parsing && m_Parsing->inFlight;
+    for (auto it = edits.rbegin(); it != edits.rend(); ++it) {
+        TSInputEdit tsEdit = {
+            .start_byte = static_cast<uint32_t>(it->startByte),
+            .old_end_byte = static_cast<uint32_t>(it->oldEndByte),
+            .new_end_byte = static_cast<uint32_t>(it->newEndByte),
+            .start_point = {
+                .row = static_cast<uint32_t>(it->startPoint.first),
+                .column = static_cast<uint32_t>(it->startPoint.second)
+            },
+            .old_end_point = {
+                .row = static_cast<uint32_t>(it->oldEndPoint.first),
+                .column = static_cast<uint32_t>(it->oldEndPoint.second)
+            },
+            .new_end_point = {
+                .row = static_cast<uint32_t>(it->newEndPoint.first),
+                .column = static_cast<uint32_t>(it->newEndPoint.second)
+            }
+        };
+        if (m_Tree) ts_tree_edit(m_Tree, &tsEdit);
+        ShiftHighlights(*it);
+        ShiftFolds(*it);
+        if (inFlight) m_Parsing->edits.push_back(tsEdit);
+    }
+    
+    // A parse already running is caught up and followed by another when it lands
+    if (!inFlight) StartParse();
+}
+
+void TextBuffer::StartParse() {
+    if (!m_Parsing) m_Parsing = std::make_shared<ParseState>(m_Language->tsLanguage);
+    m_Parsing->inFlight = true;
+    m_Parsing->edits.clear();
+    const uint64_t gen = m_Parsing->Begin(m_Rope.Snapshot(), m_Tree ? ts_tree_copy(m_Tree) : nullptr);
+    ParseState::Submit(m_Parsing, gen);
+}
+
+// Replaces the shifted tree with the finished parse, replaying the edits made
+// since it started; returns true if that left it behind the text
+bool TextBuffer::SwapInParse() {
+    ParseState& state = *m_Parsing;
+    TSTree* tree = nullptr;
+    {
+        std::lock_guard<std::mutex> lock(state.mutex);
+        tree = std::exchange(state.result, nullptr);
+        state.done = false;
+        m_LastParseTime = std::chrono::duration_cast<std::chrono::microseconds>(state.spent);
+    }
+    state.inFlight = false;
     
-    ts_tree_edit(m_Tree, &tsEdit);
+    if (tree) {
+        for (const TSInputEdit& edit : state.edits) ts_tree_edit(tree, &edit);
+        ReplaceTree(tree);
+    }
+    bool stale = !state.edits.empty();
+    state.edits.clear();
+    return stale;
+}
+
+bool TextBuffer::IsParsing() const {
+    return m_Parsing && m_Parsing->inFlight;
+}
+
+bool TextBuffer::PollParsing() {
+    if (!IsParsing() || !m_Parsing->IsDone()) return false;
+    if (SwapInParse()) StartParse();
+    return true;
+}
+
+// Parses here when no worker has picked the job up, the shifted tree being
+// as good a starting point as the snapshot the job would have used. A parse
+// already under way is resumed here between slices without a time limit.
+void TextBuffer::FinishParsing() {
+    if (!IsParsing()) return;
+    ParseState& state = *m_Parsing;
+    const uint64_t gen = state.generation;
+    bool claimed = state.Claim(gen);
+    while (!claimed && !state.Wait()) claimed = state.Claim(gen);
+    
+    if (claimed && !state.started) {
+        state.Finish(nullptr);
+        state.inFlight = false;
+        state.edits.clear();
+        ReplaceTree(ParseNow(m_Tree));
+        return;
+    }
+    if (claimed) state.Run(0);
+    if (SwapInParse()) ReplaceTree(ParseNow(m_Tree));
+}
+
+// Swaps in a reparse of the current tree, dropping cached highlights only
+// where the syntax changed
+void TextBuffer::ReplaceTree(TSTree* tree) {
+    if (!m_Tree || !tree) {
+        ReleaseTree();
+        m_Tree = tree;
+        return;
+    }
     
-    // Reparse using cached buffer directly — no copy needed
-    const char* content = m_Rope.CStr();
-    uint32_t len = static_cast<uint32_t>(m_Rope.Length());
-    TSTree* newTree = ts_parser_parse_string(
-        m_Parser,
-        m_Tree,
-        content,
-        len
-    );
+    uint32_t count = 0;
+    TSRange* ranges = ts_tree_get_changed_ranges(m_Tree, tree, &count);
+    for (uint32_t i = 0; i < count; ++i) {
+        size_t end = std::min<size_t>(ranges[i].end_point.row + 1, m_Highlights.size());
+        for (size_t line = ranges[i].start_point.row; line < end; ++line) m_Highlights[line].valid = false;
+        m_Identifiers.Invalidate(ranges[i].start_point.row, ranges[i].end_point.row);
+        const size_t last = std::min<size_t>(ranges[i].end_point.row, m_Rope.LineCount() - 1);
+        if (ranges[i].start_point.row <= last) PushLineShift({ranges[i].start_point.row, last, last});
+    }
+    ts_tree_delete(m_Tree);
+    m_Tree = tree;
+    RefreshFolds(ranges, count);
+    std::free(ranges);
+}
+
+void TextBuffer::CancelParsing() {
+    if (!m_Parsing) return;
+    m_Parsing->cancel.Cancel();
+    m_Parsing.reset();
+}
+
+bool TextBuffer::LoadFile(const std::filesystem::path& path, bool restore) {
+    auto file = MappedFile::Open(path);
+    if (!file) return false;
     
+    CancelParsing();
     ReleaseTree();
-    m_Tree = newTree;
+    CancelIndexing();
+    m_Rope = Rope();
+    ResetLineShifts();
+    if (!restore) m_UndoTree = UndoTree();
+    m_FilePath = path;
+    m_IsDiskBuffered = false;
+    m_Modified = false;
+    
+    if (file->Size() == 0) {
+        FinishLoad(restore ? std::nullopt : std::optional<uint64_t>(StreamHash::Of({})));
+        return true;
+    }
+    StartIndexing(std::move(file), true, restore);
+    return true;
 }
 
-void TextBuffer::EnableDiskBuffering(const std::filesystem::path& path) {
-    if (m_IsDiskBuffered) return;
+bool TextBuffer::EnableDiskBuffering(const std::filesystem::path& path) {
+    if (m_IsDiskBuffered) return true;
+    
+    auto file = MappedFile::Open(path);
+    if (!file) return false;
     
+    CancelParsing();
+    ReleaseTree();
+    CancelIndexing();
+    m_Rope = Rope();
+    ResetLineShifts();
     m_FilePath = path;
     m_IsDiskBuffered = true;
-    IndexDiskFile();
+    StartIndexing(std::move(file), false, false);
+    return true;
 }
 
-void TextBuffer::IndexDiskFile() {
-    m_DiskLineStarts.clear();
-    m_DiskLineStarts.push_back(0);
-    
-    // Get file size
-    try {
-        m_DiskFileSize = std::filesystem::file_size(m_FilePath);
-    } catch (...) {
-        m_DiskFileSize = 0;
+void TextBuffer::StartIndexing(std::shared_ptr<const MappedFile> file, bool copy, bool restore) {
+    auto state = std::make_shared<IndexState>();
+    const size_t size = file->Size();
+    for (size_t begin = 0; begin < size; begin += INDEX_RANGE_SIZE) {
+        state->ranges.push_back({begin, std::min(size, begin + INDEX_RANGE_SIZE)});
     }
-    
-    std::ifstream file(m_FilePath, std::ios::binary);
-    if (!file.is_open()) {
-        m_IsDiskBuffered = false;
-        return;
+    state->file = std::move(file);
+    state->copy = copy;
+    state->restore = restore;
+    if (state->ranges.empty()) return;
+    
+    for (size_t i = 0; i < state->ranges.size(); ++i) {
+        JobSystem::Submit(JobPriority::Interactive, state->cancel.Token(), [state, i] {
+            try {
+                state->Build(i);
+            } catch (const std::exception&) {
+                state->Fail(i);
+            }
+        });
     }
-    
-    // We can read in chunks to find newlines without loading whole file
-    const size_t CHUNK_SIZE = 1024 * 64;
-    std::vector<char> buffer(CHUNK_SIZE);
-    
-    size_t offset = 0;
-    while (file.read(buffer.data(), CHUNK_SIZE) || file.gcount() > 0) {
-        size_t count = file.gcount();
-        for (size_t i = 0; i < count; ++i) {
-            if (buffer[i] == '\n') {
-                m_DiskLineStarts.push_back(offset + i + 1);
+    if (copy && !restore) {
+        JobSystem::Submit(JobPriority::Background, state->cancel.Token(), [state] {
+            state->Hash();
+        });
+    }
+    m_Indexing = std::move(state);
+}
+
+float TextBuffer::GetIndexingProgress() const {
+    if (!m_Indexing) return 1.0f;
+    return static_cast<float>(m_Indexing->indexedBytes.load()) / static_cast<float>(m_Indexing->file->Size());
+}
+
+void TextBuffer::PollIndexing() {
+    if (m_Indexing) PublishIndexedRanges(false);
+}
+
+void TextBuffer::FinishIndexing() {
+    if (m_Indexing) PublishIndexedRanges(true);
+}
+
+// Appends finished ranges in file order. Ranges a worker failed on are rebuilt
+// here; when waiting, unclaimed ranges are built here too instead of queueing
+// behind other jobs.
+void TextBuffer::PublishIndexedRanges(bool wait) {
+    IndexState& state = *m_Indexing;
+    while (state.published < state.ranges.size()) {
+        IndexState::Range& range = state.ranges[state.published];
+        std::unique_lock<std::mutex> lock(state.mutex);
+        if (!range.rope) {
+            if (range.claimed) {
+                if (!wait) return;
+                state.finished.wait(lock, [&range] { return range.rope || !range.claimed; });
+            }
+            if (!range.rope) {
+                if (!wait && !range.failed) return;
+                lock.unlock();
+                state.Build(state.published);
+                continue;
             }
         }
-        offset += count;
+        Rope part = std::move(*range.rope);
+        range.rope.reset();
+        lock.unlock();
+        
+        // The last line grows by the range's first and is followed by the rest
+        const size_t last = m_Rope.LineCount() - 1;
+        m_Rope.Append(part);
+        PushLineShift({last, last, m_Rope.LineCount() - 1});
+        state.published++;
     }
     
-    // Create an empty rope just to satisfy structure, 
-    // but we will override access methods.
-    // Actually, we must ensure Rope is NOT used if m_IsDiskBuffered
+    if (!state.copy) {
+        m_Indexing.reset();
+        return;
+    }
+    if (state.restore) {
+        m_Indexing.reset();
+        FinishLoad(std::nullopt);
+        return;
+    }
+    std::unique_lock<std::mutex> lock(state.mutex);
+    if (!state.hash) {
+        if (!wait) return;
+        lock.unlock();
+        state.Hash();  // Unless a worker already is
+        lock.lock();
+        state.finished.wait(lock, [&state] { return state.hash.has_value(); });
+    }
+    const uint64_t hash = *state.hash;
+    lock.unlock();
+    // Every leaf is a copy, so this releases the mapping
+    m_Indexing.reset();
+    FinishLoad(hash);
 }
 
-std::string TextBuffer::Line(size_t lineNum) const {
-    if (m_IsDiskBuffered) {
-        return std::string(LineView(lineNum));
+void TextBuffer::CancelIndexing() {
+    if (!m_Indexing) return;
+    m_Indexing->cancel.Cancel();
+    m_Indexing.reset();
+}
+
+// Without a hash the text is a restore, already known to the undo history and the server
+void TextBuffer::FinishLoad(std::optional<uint64_t> hash) {
+    Reparse();
+    if (!hash) return;
+    m_UndoTree.BindFile(UndoFile::PathFor(m_FilePath), *hash);
+    if (m_Language) {
+        LSPManager::GetInstance().DidOpen(m_FilePath.string(), m_Rope.ToString(), m_Language->name);
     }
-    return m_Rope.Line(lineNum);
 }
 
-std::string_view TextBuffer::LineView(size_t lineNum) const {
-    if (m_IsDiskBuffered) {
-        size_t start = LineStart(lineNum);
-        size_t end = LineEnd(lineNum);
-        
-        // Ensure end includes start
-        if (end < start) end = start;
-        
-        // NOTE: LineEnd logic for disk should probably exclude newline if possible,
-        // but since we just read raw bytes, it depends on what we want.
-        // Rope::LineView usually excludes the newline?
-        // Let's assume we want to return the raw bytes we have, excluding newline if prevalent.
-        // But we don't know where newline is without reading.
-        // Wait, m_DiskLineStarts stores the start of line.
-        // LineEnd returns start of NEXT line - 1?
-        // Let's re-verify LineEnd logic in header.
-        // return next > 0 ? next - 1 : 0;
-        // So it points to the newline character usually.
-        // If we want LineView to NOT include newline, we rely on the caller or just return what we have?
-        // Standard Rope::LineView tries to exclude newline.
-        
-        size_t len = end - start;
-        std::string_view view = m_Rope.GetVisibleBufferView(start, len);
+size_t TextBuffer::GetMemoryUsage() const {
+    size_t bytes = m_Rope.CacheMemory() + m_Highlights.capacity() * sizeof(LineHighlights) + m_Semantic.GetMemoryUsage();
+    if (!m_IsDiskBuffered) bytes += m_Rope.Length();
+    return bytes + GetTreeMemory();
+}
+
+size_t TextBuffer::GetTreeMemory() const {
+    return m_Tree ? ts_node_descendant_count(ts_tree_root_node(m_Tree)) * TREE_BYTES_PER_NODE : 0;
+}
+
+void TextBuffer::ReleaseSyntax() {
+    CancelParsing();
+    ReleaseTree();
+    ResetSemanticTokens();
+    std::vector<LineHighlights>().swap(m_Highlights);
+}
+
+void TextBuffer::RestoreSyntax() {
+    if (!m_Tree && !m_Parsing) Reparse();
+}
+
+void TextBuffer::Unload() {
+    ReleaseSyntax();
+    CancelIndexing();
+    m_Rope = Rope();
+    ResetLineShifts();
+}
+
+namespace {
+
+bool IsWordChar(char c) {
+    return std::isalnum(static_cast<unsigned char>(c)) || c == '_';
+}
+
+bool IsLexicalWord(std::string_view text) {
+    return !text.empty() && !std::isdigit(static_cast<unsigned char>(text[0])) && std::all_of(text.begin(), text.end(), IsWordChar);
+}
+
+// Comments, strings, numbers and keywords of one line without a tree.
+// inBlock carries an unterminated block comment over to the next line.
+void LexLine(const Language& language, std::string_view line, bool& inBlock, std::vector<HighlightSpan>& spans) {
+    const Language::LexicalSyntax& syntax = language.lexical;
+    auto push = [&spans](size_t start, size_t end, HighlightGroup group) {
+        if (start < end) spans.push_back({static_cast<uint32_t>(start), static_cast<uint32_t>(end), static_cast<uint16_t>(group), 0, false});
+    };
+    
+    size_t i = 0;
+    if (inBlock) {
+        const size_t close = line.find(syntax.blockCommentEnd);
+        if (close == std::string_view::npos) {
+            push(0, line.length(), HighlightGroup::Comment);
+            return;
+        }
+        i = close + syntax.blockCommentEnd.length();
+        push(0, i, HighlightGroup::Comment);
+        inBlock = false;
+    }
+    
+    while (i < line.length()) {
+        const std::string_view rest = line.substr(i);
+        const char c = line[i];
+        if (!syntax.lineComment.empty() && rest.starts_with(syntax.lineComment)) {
+            push(i, line.length(), HighlightGroup::Comment);
+            return;
+        }
+        if (!syntax.blockCommentStart.empty() && rest.starts_with(syntax.blockCommentStart)) {
+            const size_t close = line.find(syntax.blockCommentEnd, i + syntax.blockCommentStart.length());
+            if (close == std::string_view::npos) {
+                push(i, line.length(), HighlightGroup::Comment);
+                inBlock = true;
+                return;
+            }
+            const size_t end = close + syntax.blockCommentEnd.length();
+            push(i, end, HighlightGroup::Comment);
+            i = end;
+            continue;
+        }
+        if (syntax.quotes.find(c) != std::string_view::npos) {
+            size_t end = i + 1;
+            while (end < line.length() && line[end] != c) end += line[end] == '\\' ? 2 : 1;
+            end = std::min(end + 1, line.length());
+            push(i, end, HighlightGroup::String);
+            i = end;
+            continue;
+        }
+        if (!IsWordChar(c)) {
+            ++i;
+            continue;
+        }
         
-        // If we successfully got the view, check for newline at the end
-        if (!view.empty() && view.back() == '\n') {
-            view.remove_suffix(1);
+        size_t end = i + 1;
+        if (std::isdigit(static_cast<unsigned char>(c))) {
+            while (end < line.length() && (IsWordChar(line[end]) || line[end] == '.')) ++end;
+            push(i, end, HighlightGroup::Number);
+        } else {
+            while (end < line.length() && IsWordChar(line[end])) ++end;
+            const std::string_view word = line.substr(i, end - i);
+            auto keyword = std::lower_bound(language.keywords.begin(), language.keywords.end(), word, [](const auto& entry, std::string_view w) {
+                return entry.first < w;
+            });
+            if (keyword != language.keywords.end() && keyword->first == word) push(i, end, keyword->second);
         }
-        return view;
+        i = end;
     }
-    return m_Rope.LineView(lineNum);
 }
 
-void TextBuffer::PrepareVisibleRange(size_t firstLine, size_t lastLine) {
-    if (m_IsDiskBuffered) {
-        size_t startByte = LineStart(firstLine);
-        size_t endByte = LineEnd(lastLine);
-        if (endByte < startByte) endByte = startByte;
-        size_t len = endByte - startByte;
-        
-        std::string buffer;
-        buffer.resize(len);
-        
-        std::ifstream file(m_FilePath, std::ios::binary);
-        if (file.is_open()) {
-            file.seekg(startByte);
-            file.read(buffer.data(), len);
+// Query captures nest (an escape inside a string); the innermost, painted
+// last, wins so each line ends up with disjoint spans
+void FlattenSpans(std::vector<HighlightSpan>& spans, std::vector<uint32_t>& paint) {
+    auto overlap = std::adjacent_find(spans.begin(), spans.end(), [](const HighlightSpan& a, const HighlightSpan& b) {
+        return b.start < a.end;
+    });
+    if (overlap == spans.end()) return;
+    
+    constexpr uint32_t NONE = UINT32_MAX;
+    // Spans running past the line keep one cell beyond every bounded one
+    uint32_t width = 0;
+    bool open = false;
+    for (const HighlightSpan& span : spans) {
+        open |= span.end == UINT32_MAX;
+        width = std::max(width, span.end == UINT32_MAX ? span.start + 1 : span.end);
+    }
+    width += open;
+    paint.assign(width, NONE);
+    for (uint32_t i = 0; i < spans.size(); ++i) {
+        std::fill(paint.begin() + spans[i].start, paint.begin() + std::min(spans[i].end, width), i);
+    }
+    
+    std::vector<HighlightSpan> flat;
+    for (uint32_t begin = 0; begin < width;) {
+        uint32_t end = begin + 1;
+        while (end < width && paint[end] == paint[begin]) ++end;
+        if (paint[begin] != NONE) {
+            HighlightSpan span = spans[paint[begin]];
+            span.start = begin;
+            if (end < width || span.end != UINT32_MAX) span.end = end;
+            flat.push_back(span);
         }
-        
-        m_Rope.SetVisibleBuffer(buffer, firstLine, lastLine, startByte);
-    } else {
-        m_Rope.PrepareVisibleRange(firstLine, lastLine);
+        begin = end;
+    }
+    spans = std::move(flat);
+}
+
+// Joins touching spans painted alike, so a view draws one run for them
+void MergeSpans(std::vector<HighlightSpan>& spans) {
+    size_t out = 0;
+    for (size_t i = 0; i < spans.size(); ++i) {
+        if (out > 0) {
+            HighlightSpan& last = spans[out - 1];
+            const HighlightSpan& span = spans[i];
+            if (last.end == span.start && last.highlightId == span.highlightId && last.depth == span.depth &&
+                last.bracket == span.bracket) {
+                last.end = span.end;
+                continue;
+            }
+        }
+        spans[out++] = spans[i];
     }
+    spans.resize(out);
 }
 
+} // namespace
+
 std::vector<SyntaxToken> TextBuffer::GetSyntaxTokens(size_t startLine, size_t endLine) const {
+    SOL_PROFILE_ZONE("TextBuffer::GetSyntaxTokens");
     std::vector<SyntaxToken> tokens;
     
-    if (!m_Tree) {
+    if (!m_Tree || !m_Language) {
         return tokens;
     }
     
@@ -316,6 +1098,11 @@ std::vector<SyntaxToken> TextBuffer::GetSyntaxTokens(size_t startLine, size_t en
     size_t startByte = m_Rope.LineStart(startLine);
     size_t endByte = (endLine < m_Rope.LineCount()) ? m_Rope.LineEnd(endLine) : m_Rope.Length();
     
+    if (m_Language && m_Language->highlightQuery) {
+        m_Language->highlightQuery->Captures(*m_Language, root, m_Rope, static_cast<uint32_t>(startByte), static_cast<uint32_t>(endByte), tokens);
+        return tokens;
+    }
+    
     // Use tree-sitter cursor for efficient traversal
     TSTreeCursor cursor = ts_tree_cursor_new(root);
     int currentDepth = 0;
@@ -383,7 +1170,7 @@ std::vector<SyntaxToken> TextBuffer::GetSyntaxTokens(size_t startLine, size_t en
         
         // Add leaf nodes or anonymous nodes
         if (childCount == 0 || !ts_node_is_named(node)) {
-            const char* type = ts_node_type(node);
+            TSSymbol symbol = ts_node_symbol(node);
             TSPoint sp = ts_node_start_point(node);
             TSPoint ep = ts_node_end_point(node);
             
@@ -394,8 +1181,8 @@ std::vector<SyntaxToken> TextBuffer::GetSyntaxTokens(size_t startLine, size_t en
                 .startCol = sp.column,
                 .endRow = ep.row,
                 .endCol = ep.column,
-                .type = type,
-                .highlightId = static_cast<uint16_t>(MapNodeTypeToHighlight(type)),
+                .symbol = symbol,
+                .highlightId = static_cast<uint16_t>(m_Language->Symbol(symbol).group),
                 .depth = static_cast<uint16_t>(currentDepth)
             });
         }
@@ -437,8 +1224,272 @@ done:
     return tokens;
 }
 
+void TextBuffer::UpdateHighlights(size_t firstLine, size_t endLine) {
+    if (m_Session) m_Session->RecordHighlight(firstLine, endLine);
+    if (!m_Language) return;
+    
+    const size_t lineCount = m_Rope.LineCount();
+    if (m_Highlights.size() != lineCount) m_Highlights.assign(lineCount, {});
+    endLine = std::min(endLine, lineCount);
+    
+    // One traversal per run of invalid lines
+    std::vector<uint32_t> paint;
+    for (size_t line = firstLine; line < endLine;) {
+        if (m_Highlights[line].valid) {
+            ++m_HighlightStats.hits;
+            ++line;
+            continue;
+        }
+        size_t runEnd = line + 1;
+        while (runEnd < endLine && !m_Highlights[runEnd].valid) ++runEnd;
+        m_HighlightStats.misses += runEnd - line;
+        for (size_t i = line; i < runEnd; ++i) {
+            m_Highlights[i].spans.clear();
+            m_Highlights[i].valid = true;
+        }
+        
+        if (!m_Tree) {
+            const size_t start = m_Rope.LineStart(line);
+            const std::string text = m_Rope.Substring(start, m_Rope.LineEnd(runEnd - 1) - start);
+            bool inBlock = false;
+            size_t offset = 0;
+            for (size_t i = line; i < runEnd; ++i) {
+                const size_t next = std::min(text.find('\n', offset), text.length());
+                LexLine(*m_Language, std::string_view(text).substr(offset, next - offset), inBlock, m_Highlights[i].spans);
+                offset = next + 1;
+            }
+        } else {
+            for (const SyntaxToken& token : GetSyntaxTokens(line, runEnd - 1)) {
+                const bool bracket = m_Language->Symbol(token.symbol).bracket;
+                const size_t last = std::min(token.endRow, runEnd - 1);
+                for (size_t row = std::max(token.startRow, line); row <= last; ++row) {
+                    uint32_t start = row == token.startRow ? static_cast<uint32_t>(token.startCol) : 0;
+                    uint32_t end = row == token.endRow ? static_cast<uint32_t>(token.endCol) : UINT32_MAX;
+                    if (start >= end) continue;
+                    m_Highlights[row].spans.push_back({start, end, token.highlightId, token.depth, bracket});
+                }
+            }
+        }
+        for (size_t i = line; i < runEnd; ++i) {
+            OverlaySemanticTokens(i);
+            FlattenSpans(m_Highlights[i].spans, paint);
+            MergeSpans(m_Highlights[i].spans);
+        }
+        line = runEnd;
+    }
+}
+
+std::span<const HighlightSpan> TextBuffer::GetLineHighlights(size_t line) const {
+    if (line >= m_Highlights.size()) return {};
+    return m_Highlights[line].spans;
+}
+
+namespace {
+
+// Token types of the standard legend that have a highlight group; others
+// leave the syntax tree's highlight in place
+HighlightGroup SemanticGroup(std::string_view type) {
+    static constexpr std::pair<std::string_view, HighlightGroup> GROUPS[] = {
+        {"namespace", HighlightGroup::Namespace},
+        {"type", HighlightGroup::Type},
+        {"class", HighlightGroup::Type},
+        {"enum", HighlightGroup::Type},
+        {"interface", HighlightGroup::Type},
+        {"struct", HighlightGroup::Type},
+        {"typeParameter", HighlightGroup::Type},
+        {"parameter", HighlightGroup::Variable},
+        {"variable", HighlightGroup::Variable},
+        {"property", HighlightGroup::Variable},
+        {"enumMember", HighlightGroup::Constant},
+        {"function", HighlightGroup::Function},
+        {"method", HighlightGroup::Function},
+        {"macro", HighlightGroup::Macro},
+        {"keyword", HighlightGroup::Keyword},
+        {"modifier", HighlightGroup::Keyword},
+        {"comment", HighlightGroup::Comment},
+        {"string", HighlightGroup::String},
+        {"regexp", HighlightGroup::String},
+        {"number", HighlightGroup::Number},
+        {"operator", HighlightGroup::Operator},
+    };
+    for (const auto& [name, group] : GROUPS) {
+        if (name == type) return group;
+    }
+    return HighlightGroup::None;
+}
+
+} // namespace
+
+void TextBuffer::UpdateSemanticTokens(size_t firstLine, size_t endLine) {
+    if (!m_Language || m_Indexing || m_IsDiskBuffered || m_FilePath.empty()) return;
+    
+    const auto now = std::chrono::steady_clock::now();
+    if (m_SemanticRequest) {
+        SemanticRequest& request = *m_SemanticRequest;
+        std::optional<LSPSemanticTokens> result;
+        {
+            std::lock_guard<std::mutex> lock(request.mutex);
+            if (!request.done && now - request.sent < SEMANTIC_TIMEOUT) return;
+            result = std::move(request.result);
+        }
+        if (!result || !ApplySemanticTokens(request, std::move(*result))) m_SemanticNotBefore = now + SEMANTIC_RETRY;
+        CancelSemanticRequest();
+    }
+    if (now >= m_SemanticNotBefore) RequestSemanticTokens(firstLine, std::min(endLine, m_Rope.LineCount()));
+}
+
+void TextBuffer::RequestSemanticTokens(size_t firstLine, size_t endLine) {
+    LSPManager& lsp = LSPManager::GetInstance();
+    const auto now = std::chrono::steady_clock::now();
+    if (!m_Semantic.HasLegend()) {
+        LSPSemanticTokensProvider provider = lsp.GetSemanticTokensProvider(m_FilePath.string());
+        if (provider.tokenTypes.empty() || (!provider.full && !provider.range)) {
+            m_SemanticNotBefore = now + SEMANTIC_RETRY;
+            return;
+        }
+        std::vector<uint16_t> groups;
+        groups.reserve(provider.tokenTypes.size());
+        for (const std::string& type : provider.tokenTypes) groups.push_back(static_cast<uint16_t>(SemanticGroup(type)));
+        m_Semantic.SetLegend(std::move(groups));
+        provider.tokenTypes.clear();
+        m_SemanticProvider = std::move(provider);
+    }
+    
+    // A full result is current until the next edit; without full support a
+    // range result is, until the view leaves it
+    const bool full = m_SemanticProvider.full;
+    if (m_SemanticVersion == m_EditCount) {
+        if (full && m_Semantic.HasFull() && !m_Semantic.IsShowingRange()) return;
+        if (!full && m_Semantic.IsShowingRange() && firstLine >= m_SemanticLines.first && endLine <= m_SemanticLines.second) return;
+    }
+    const bool preview = m_SemanticProvider.range && !m_Semantic.HasFull() && !m_Semantic.IsShowingRange();
+    
+    auto request = std::make_shared<SemanticRequest>();
+    request->range = !full || preview;
+    request->lines = {firstLine, endLine};
+    request->editCount = m_EditCount;
+    request->sent = now;
+    auto callback = [request](std::optional<LSPSemanticTokens> tokens) {
+        std::lock_guard<std::mutex> lock(request->mutex);
+        request->result = std::move(tokens);
+        request->done = true;
+    };
+    
+    const auto fullText = [this] { return m_Rope.ToString(); };
+    bool sent;
+    if (request->range) {
+        const LSPRange range{{static_cast<int>(firstLine), 0}, {static_cast<int>(endLine), 0}};
+        sent = lsp.RequestSemanticTokensRange(m_FilePath.string(), fullText, range, std::move(callback),
+                                              request->cancel.Token());
+    } else {
+        const bool delta = m_SemanticProvider.delta && m_Semantic.HasFull();
+        sent = lsp.RequestSemanticTokens(m_FilePath.string(), fullText, delta ? m_Semantic.GetResultId() : std::string(),
+                                         std::move(callback), request->cancel.Token());
+    }
+    if (sent) {
+        m_SemanticRequest = std::move(request);
+    } else {
+        m_SemanticNotBefore = now + SEMANTIC_RETRY;
+    }
+}
+
+// The tokens are for the text when the request was sent; edits made since
+// are replayed on them like on the tokens shown meanwhile
+bool TextBuffer::ApplySemanticTokens(SemanticRequest& request, LSPSemanticTokens tokens) {
+    if (request.range) {
+        m_Semantic.SetRange(std::move(tokens.data));
+        m_SemanticLines = request.lines;
+    } else if (!tokens.delta) {
+        m_Semantic.SetFull(std::move(tokens.resultId), std::move(tokens.data));
+    } else if (!m_Semantic.ApplyDelta(std::move(tokens.resultId), std::move(tokens.edits))) {
+        // Edits against some other result; the next request asks for all tokens
+        m_Semantic.Clear();
+        return false;
+    }
+    for (const auto& [start, oldEnd, newEnd] : request.shifts) m_Semantic.Shift(start, oldEnd, newEnd);
+    m_SemanticVersion = request.editCount;
+    for (LineHighlights& line : m_Highlights) line.valid = false;
+    PushLineShift({0, m_Rope.LineCount() - 1, m_Rope.LineCount() - 1});
+    return true;
+}
+
+void TextBuffer::ResetSemanticTokens() {
+    m_Semantic.Clear();
+    CancelSemanticRequest();
+    m_SemanticNotBefore = {};
+}
+
+// A request that timed out may still be answered; the server can stop working on it
+void TextBuffer::CancelSemanticRequest() {
+    if (!m_SemanticRequest) return;
+    m_SemanticRequest->cancel.Cancel();
+    m_SemanticRequest.reset();
+}
+
+// Positions beyond the text are clamped to its end
+void TextBuffer::SetDiagnostics(const std::vector<LSPDiagnostic>& diagnostics) {
+    const size_t lastLine = m_Rope.LineCount() - 1;
+    auto toPos = [&](const LSPPosition& position) {
+        const size_t line = std::min<size_t>(std::max(position.line, 0), lastLine);
+        return m_Rope.LineUtf16ColToPos(line, std::max(position.character, 0));
+    };
+    
+    std::vector<Diagnostic> converted;
+    converted.reserve(diagnostics.size());
+    for (const LSPDiagnostic& diagnostic : diagnostics) {
+        const size_t start = toPos(diagnostic.range.start);
+        converted.push_back({start, std::max(start, toPos(diagnostic.range.end)), diagnostic.severity, diagnostic.message});
+    }
+    m_Diagnostics.Set(std::move(converted));
+}
+
+// Semantic spans go after the line's own, so flattening paints them on top.
+// Their UTF-16 columns are turned into bytes walking the line once.
+void TextBuffer::OverlaySemanticTokens(size_t line) {
+    if (m_Semantic.Empty()) return;
+    
+    std::vector<HighlightSpan>& spans = m_Highlights[line].spans;
+    const std::string_view text = m_Rope.LineView(line);
+    size_t byte = 0;
+    size_t units = 0;
+    auto toByte = [&](size_t column) {
+        while (units < column && byte < text.size()) {
+            const unsigned char lead = static_cast<unsigned char>(text[byte]);
+            const size_t length = lead < 0xC0 ? 1 : lead < 0xE0 ? 2 : lead < 0xF0 ? 3 : 4;
+            units += length == 4 ? 2 : 1;
+            byte = std::min(byte + length, text.size());
+        }
+        return static_cast<uint32_t>(byte);
+    };
+    m_Semantic.ForLine(line, [&](uint32_t start, uint32_t length, uint16_t group) {
+        const uint32_t begin = toByte(start);
+        const uint32_t end = toByte(static_cast<size_t>(start) + length);
+        if (begin < end) spans.push_back({begin, end, group, 0, false});
+    });
+}
+
+// Lines the edit replaced become as many unhighlighted lines as it inserted;
+// the lines after it keep their spans since those are line-relative
+void TextBuffer::ShiftHighlights(const Rope::EditInfo& edit) {
+    if (m_Highlights.empty()) return;
+    
+    const size_t first = std::min(edit.startPoint.first, m_Highlights.size());
+    const size_t oldCount = std::min(edit.oldEndPoint.first + 1, m_Highlights.size()) - first;
+    const size_t newCount = edit.newEndPoint.first - edit.startPoint.first + 1;
+    for (size_t i = first; i < first + std::min(oldCount, newCount); ++i) {
+        m_Highlights[i].spans.clear();
+        m_Highlights[i].valid = false;
+    }
+    auto tail = m_Highlights.begin() + (first + std::min(oldCount, newCount));
+    if (newCount > oldCount) {
+        m_Highlights.insert(tail, newCount - oldCount, LineHighlights{});
+    } else {
+        m_Highlights.erase(tail, tail + (oldCount - newCount));
+    }
+}
+
 HighlightGroup TextBuffer::GetHighlightAt(size_t pos) const {
-    if (!m_Tree) {
+    if (!m_Tree || !m_Language) {
         return HighlightGroup::None;
     }
     
@@ -451,7 +1502,7 @@ HighlightGroup TextBuffer::GetHighlightAt(size_t pos) const {
         return HighlightGroup::None;
     }
     
-    return MapNodeTypeToHighlight(ts_node_type(node));
+    return m_Language->Symbol(ts_node_symbol(node)).group;
 }
 
 std::pair<size_t, size_t> TextBuffer::GetScopeRange(size_t pos) const {
@@ -530,10 +1581,10 @@ size_t TextBuffer::GetMatchingBracket(size_t pos) const {
     return SIZE_MAX;
 }
 
-std::vector<FoldRange> TextBuffer::GetFoldRanges() const {
-    std::vector<FoldRange> ranges;
-    if (!m_Tree) return ranges;
-    
+// Folds of the nodes spanning rows [firstRow, lastRow] that reach into them;
+// subtrees outside those rows are not visited
+void TextBuffer::CollectFolds(size_t firstRow, size_t lastRow, std::vector<FoldRange>& ranges) const {
+    const size_t first = ranges.size();
     TSNode root = ts_tree_root_node(m_Tree);
     TSTreeCursor cursor = ts_tree_cursor_new(root);
     
@@ -584,8 +1635,9 @@ std::vector<FoldRange> TextBuffer::GetFoldRanges() const {
     
     while (true) {
         TSNode node = ts_tree_cursor_current_node(&cursor);
+        const bool inRows = ts_node_start_point(node).row <= lastRow && ts_node_end_point(node).row >= firstRow;
         
-        if (visitChildren) {
+        if (visitChildren && inRows) {
             const char* type = ts_node_type(node);
             std::string_view typeSv(type);
             
@@ -813,7 +1865,7 @@ std::vector<FoldRange> TextBuffer::GetFoldRanges() const {
         }
         
         // Try to descend into children
-        if (visitChildren && ts_tree_cursor_goto_first_child(&cursor)) {
+        if (visitChildren && inRows && ts_tree_cursor_goto_first_child(&cursor)) {
             visitChildren = true;
             continue;
         }
@@ -839,28 +1891,127 @@ std::vector<FoldRange> TextBuffer::GetFoldRanges() const {
 done:
     ts_tree_cursor_delete(&cursor);
     
-    // Sort by start line
-    std::sort(ranges.begin(), ranges.end(), [](const FoldRange& a, const FoldRange& b) {
-        return a.startLine < b.startLine;
+    ranges.erase(std::remove_if(ranges.begin() + first, ranges.end(), [&](const FoldRange& range) {
+        return range.startLine > lastRow || range.endLine < firstRow;
+    }), ranges.end());
+}
+
+namespace {
+
+uint64_t NextFoldVersion() {
+    static std::atomic<uint64_t> version{0};
+    return ++version;
+}
+
+// Sorts by start line and keeps the outermost fold of each line
+void NormalizeFolds(std::vector<FoldRange>& ranges) {
+    std::stable_sort(ranges.begin(), ranges.end(), [](const FoldRange& a, const FoldRange& b) {
+        if (a.startLine != b.startLine) return a.startLine < b.startLine;
+        return a.endLine > b.endLine;
     });
-    
-    return ranges;
+    ranges.erase(std::unique(ranges.begin(), ranges.end(), [](const FoldRange& a, const FoldRange& b) {
+        return a.startLine == b.startLine;
+    }), ranges.end());
+}
+
+} // namespace
+
+const std::vector<FoldRange>& TextBuffer::GetFoldRanges() {
+    if (!m_Folds.valid && m_Tree) {
+        m_Folds.ranges.clear();
+        CollectFolds(0, SIZE_MAX, m_Folds.ranges);
+        NormalizeFolds(m_Folds.ranges);
+        for (FoldRange& range : m_Folds.ranges) range.id = m_Folds.nextId++;
+        m_Folds.valid = true;
+        m_Folds.version = NextFoldVersion();
+    }
+    return m_Folds.ranges;
+}
+
+void TextBuffer::InvalidateFolds() {
+    if (!m_Folds.valid && m_Folds.ranges.empty()) return;
+    m_Folds.ranges.clear();
+    m_Folds.valid = false;
+    m_Folds.version = NextFoldVersion();
 }
 
-HighlightGroup TextBuffer::MapNodeTypeToHighlight(const char* nodeType) const {
-    if (!nodeType) return HighlightGroup::None;
+// Moves folds after the edit by its line delta and clips the ones it cut
+// into; the reparse that follows fixes those up through RefreshFolds
+void TextBuffer::ShiftFolds(const Rope::EditInfo& edit) {
+    if (!m_Folds.valid) return;
+    
+    const size_t first = edit.startPoint.first;
+    const size_t oldEnd = edit.oldEndPoint.first;
+    const size_t newEnd = edit.newEndPoint.first;
+    if (oldEnd == newEnd && oldEnd == first) return;
+    
+    for (FoldRange& range : m_Folds.ranges) {
+        if (range.endLine < first) continue;
+        if (range.startLine > oldEnd) {
+            range.startLine = range.startLine - oldEnd + newEnd;
+        } else if (range.startLine > first) {
+            range.startLine = std::min(range.startLine, newEnd);
+        }
+        range.endLine = range.endLine >= oldEnd ? range.endLine - oldEnd + newEnd : std::min(range.endLine, newEnd);
+    }
+    std::erase_if(m_Folds.ranges, [](const FoldRange& range) { return range.startLine >= range.endLine; });
+    NormalizeFolds(m_Folds.ranges);
+    m_Folds.version = NextFoldVersion();
+}
+
+// Rebuilds the folds touching the rows a reparse changed from the new tree,
+// keeping the ids of folds that still start on the same line
+void TextBuffer::RefreshFolds(const TSRange* changed, uint32_t count) {
+    if (!m_Folds.valid || count == 0) return;
+    
+    auto touched = [&](const FoldRange& range) {
+        for (uint32_t i = 0; i < count; ++i) {
+            if (range.startLine <= changed[i].end_point.row && range.endLine >= changed[i].start_point.row) return true;
+        }
+        return false;
+    };
+    std::vector<FoldRange> removed;
+    std::erase_if(m_Folds.ranges, [&](const FoldRange& range) {
+        if (!touched(range)) return false;
+        removed.push_back(range);
+        return true;
+    });
+    
+    std::vector<FoldRange> fresh;
+    for (uint32_t i = 0; i < count; ++i) {
+        CollectFolds(changed[i].start_point.row, changed[i].end_point.row, fresh);
+    }
+    NormalizeFolds(fresh);
+    for (FoldRange& range : fresh) {
+        auto old = std::lower_bound(removed.begin(), removed.end(), range.startLine, [](const FoldRange& r, size_t line) {
+            return r.startLine < line;
+        });
+        range.id = old != removed.end() && old->startLine == range.startLine ? old->id : m_Folds.nextId++;
+    }
     
+    const size_t kept = m_Folds.ranges.size();
+    m_Folds.ranges.insert(m_Folds.ranges.end(), fresh.begin(), fresh.end());
+    std::inplace_merge(m_Folds.ranges.begin(), m_Folds.ranges.begin() + kept, m_Folds.ranges.end(), [](const FoldRange& a, const FoldRange& b) {
+        if (a.startLine != b.startLine) return a.startLine < b.startLine;
+        return a.endLine > b.endLine;
+    });
+    m_Folds.ranges.erase(std::unique(m_Folds.ranges.begin(), m_Folds.ranges.end(), [](const FoldRange& a, const FoldRange& b) {
+        return a.startLine == b.startLine;
+    }), m_Folds.ranges.end());
+    m_Folds.version = NextFoldVersion();
+}
+
+namespace {
+
+HighlightGroup MapNodeTypeToHighlight(const Language& language, std::string_view type) {
     // Check language-specific mappings first
-    if (m_Language) {
-        for (const auto& [type, group] : m_Language->highlightMappings) {
-            if (type == nodeType) {
-                return group;
-            }
+    for (const auto& [name, group] : language.highlightMappings) {
+        if (name == type) {
+            return group;
         }
     }
     
     // Default mappings (common across languages)
-    std::string_view type = nodeType;
     
     // Comments
     if (type.find("comment") != std::string_view::npos) {
@@ -937,23 +2088,73 @@ HighlightGroup TextBuffer::MapNodeTypeToHighlight(const char* nodeType) const {
     return HighlightGroup::None;
 }
 
+} // namespace
+
 // LanguageRegistry implementation
 LanguageRegistry& LanguageRegistry::GetInstance() {
     static LanguageRegistry instance;
     return instance;
 }
 
+Language::~Language() = default;
+
 void LanguageRegistry::RegisterLanguage(std::unique_ptr<Language> lang) {
     m_Languages.push_back(std::move(lang));
 }
 
+void LanguageRegistry::AddBuiltin(std::string name, std::vector<std::string> extensions, Language::Loader load) {
+    auto lang = std::make_unique<Language>();
+    lang->name = std::move(name);
+    lang->extensions = std::move(extensions);
+    lang->load = load;
+    RegisterLanguage(std::move(lang));
+}
+
+// Runs once per language, possibly on a worker, before any caller sees it
+const Language* LanguageRegistry::Loaded(Language& language) {
+    std::call_once(language.loaded, [lang = &language] {
+        if (lang->load) lang->load(*lang);
+        if (lang->tsLanguage) {
+            const uint32_t count = ts_language_symbol_count(lang->tsLanguage);
+            lang->symbols.resize(count);
+            for (uint32_t symbol = 0; symbol < count; ++symbol) {
+                std::string_view type = ts_language_symbol_name(lang->tsLanguage, static_cast<TSSymbol>(symbol));
+                const TSSymbolType kind = ts_language_symbol_type(lang->tsLanguage, static_cast<TSSymbol>(symbol));
+                const bool named = kind == TSSymbolTypeRegular;
+                lang->symbols[symbol] = {
+                    MapNodeTypeToHighlight(*lang, type),
+                    type == "{" || type == "}" || type == "(" || type == ")" || type == "[" || type == "]",
+                    named && (type.find("identifier") != std::string_view::npos || type.find("name") != std::string_view::npos || type == "word"),
+                    type.find("string") != std::string_view::npos || type.find("comment") != std::string_view::npos
+                };
+                // Anonymous words are the grammar's keywords
+                if (kind == TSSymbolTypeAnonymous && type.length() > 1 && IsLexicalWord(type)) {
+                    const HighlightGroup group = lang->symbols[symbol].group;
+                    lang->keywords.emplace_back(type, group == HighlightGroup::None ? HighlightGroup::Keyword : group);
+                }
+            }
+            std::sort(lang->keywords.begin(), lang->keywords.end());
+            lang->keywords.erase(std::unique(lang->keywords.begin(), lang->keywords.end(), [](const auto& a, const auto& b) {
+                return a.first == b.first;
+            }), lang->keywords.end());
+        }
+        if (!lang->highlightQuery) {
+            lang->highlightQuery = HighlightQuery::Compile(lang->tsLanguage, BundledHighlightQuery(lang->name));
+        }
+        if (!lang->tagsQuery) {
+            lang->tagsQuery = TagsQuery::Compile(lang->tsLanguage, BundledTagsQuery(lang->name));
+        }
+    });
+    return &language;
+}
+
 const Language* LanguageRegistry::GetLanguageForFile(const std::filesystem::path& path) const {
     std::string ext = path.extension().string();
     
     for (const auto& lang : m_Languages) {
         for (const auto& langExt : lang->extensions) {
             if (ext == langExt) {
-                return lang.get();
+                return Loaded(*lang);
             }
         }
     }
@@ -964,7 +2165,7 @@ const Language* LanguageRegistry::GetLanguageForFile(const std::filesystem::path
 const Language* LanguageRegistry::GetLanguageByName(const std::string& name) const {
     for (const auto& lang : m_Languages) {
         if (lang->name == name) {
-            return lang.get();
+            return Loaded(*lang);
         }
     }
     return nullptr;
@@ -972,328 +2173,297 @@ const Language* LanguageRegistry::GetLanguageByName(const std::string& name) con
 
 void LanguageRegistry::InitializeBuiltins() {
     // C language
-    auto cLang = std::make_unique<Language>();
-    cLang->name = "c";
-    cLang->extensions = {".c", ".h"};
-    cLang->tsLanguage = tree_sitter_c();
-    cLang->highlightMappings = {
-        {"primitive_type", HighlightGroup::Type},
-        {"type_identifier", HighlightGroup::Type},
-        {"sized_type_specifier", HighlightGroup::Type},
-        {"function_declarator", HighlightGroup::Function},
-        {"call_expression", HighlightGroup::Function},
-        {"preproc_include", HighlightGroup::Macro},
-        {"preproc_def", HighlightGroup::Macro},
-        {"preproc_ifdef", HighlightGroup::Macro},
-        {"string_literal", HighlightGroup::String},
-        {"char_literal", HighlightGroup::String},
-        {"number_literal", HighlightGroup::Number},
-        {"comment", HighlightGroup::Comment},
-    };
-    RegisterLanguage(std::move(cLang));
+    AddBuiltin("c", {".c", ".h"}, [](Language& lang) {
+        lang.tsLanguage = tree_sitter_c();
+        lang.lexical = {"//", "/*", "*/", "\"'"};
+        lang.highlightMappings = {
+            {"primitive_type", HighlightGroup::Type},
+            {"type_identifier", HighlightGroup::Type},
+            {"sized_type_specifier", HighlightGroup::Type},
+            {"function_declarator", HighlightGroup::Function},
+            {"call_expression", HighlightGroup::Function},
+            {"preproc_include", HighlightGroup::Macro},
+            {"preproc_def", HighlightGroup::Macro},
+            {"preproc_ifdef", HighlightGroup::Macro},
+            {"string_literal", HighlightGroup::String},
+            {"char_literal", HighlightGroup::String},
+            {"number_literal", HighlightGroup::Number},
+            {"comment", HighlightGroup::Comment},
+        };
+    });
     
     // C++ language
-    auto cppLang = std::make_unique<Language>();
-    cppLang->name = "cpp";
-    cppLang->extensions = {".cpp", ".hpp", ".cc", ".cxx", ".hxx", ".h"};
-    cppLang->tsLanguage = tree_sitter_cpp();
-    cppLang->highlightMappings = {
-        {"primitive_type", HighlightGroup::Type},
-        {"type_identifier", HighlightGroup::Type},
-        {"sized_type_specifier", HighlightGroup::Type},
-        {"namespace_identifier", HighlightGroup::Namespace},
-        {"function_declarator", HighlightGroup::Function},
-        {"call_expression", HighlightGroup::Function},
-        {"template_type", HighlightGroup::Type},
-        {"auto", HighlightGroup::Keyword},
-        {"nullptr", HighlightGroup::Constant},
-        {"true", HighlightGroup::Constant},
-        {"false", HighlightGroup::Constant},
-        {"string_literal", HighlightGroup::String},
-        {"raw_string_literal", HighlightGroup::String},
-        {"char_literal", HighlightGroup::String},
-        {"number_literal", HighlightGroup::Number},
-        {"comment", HighlightGroup::Comment},
-    };
-    RegisterLanguage(std::move(cppLang));
+    AddBuiltin("cpp", {".cpp", ".hpp", ".cc", ".cxx", ".hxx", ".h"}, [](Language& lang) {
+        lang.tsLanguage = tree_sitter_cpp();
+        lang.lexical = {"//", "/*", "*/", "\"'"};
+        lang.highlightMappings = {
+            {"primitive_type", HighlightGroup::Type},
+            {"type_identifier", HighlightGroup::Type},
+            {"sized_type_specifier", HighlightGroup::Type},
+            {"namespace_identifier", HighlightGroup::Namespace},
+            {"function_declarator", HighlightGroup::Function},
+            {"call_expression", HighlightGroup::Function},
+            {"template_type", HighlightGroup::Type},
+            {"auto", HighlightGroup::Keyword},
+            {"nullptr", HighlightGroup::Constant},
+            {"true", HighlightGroup::Constant},
+            {"false", HighlightGroup::Constant},
+            {"string_literal", HighlightGroup::String},
+            {"raw_string_literal", HighlightGroup::String},
+            {"char_literal", HighlightGroup::String},
+            {"number_literal", HighlightGroup::Number},
+            {"comment", HighlightGroup::Comment},
+        };
+    });
     
     // Python language
-    auto pyLang = std::make_unique<Language>();
-    pyLang->name = "python";
-    pyLang->extensions = {".py", ".pyw", ".pyi"};
-    pyLang->tsLanguage = tree_sitter_python();
-    pyLang->highlightMappings = {
-        {"identifier", HighlightGroup::Variable},
-        {"type", HighlightGroup::Type},
-        {"function_definition", HighlightGroup::Function},
-        {"call", HighlightGroup::Function},
-        {"decorator", HighlightGroup::Macro},
-        {"string", HighlightGroup::String},
-        {"integer", HighlightGroup::Number},
-        {"float", HighlightGroup::Number},
-        {"comment", HighlightGroup::Comment},
-        {"true", HighlightGroup::Constant},
-        {"false", HighlightGroup::Constant},
-        {"none", HighlightGroup::Constant},
-    };
-    RegisterLanguage(std::move(pyLang));
+    AddBuiltin("python", {".py", ".pyw", ".pyi"}, [](Language& lang) {
+        lang.tsLanguage = tree_sitter_python();
+        lang.lexical = {"#", "", "", "\"'"};
+        lang.highlightMappings = {
+            {"identifier", HighlightGroup::Variable},
+            {"type", HighlightGroup::Type},
+            {"function_definition", HighlightGroup::Function},
+            {"call", HighlightGroup::Function},
+            {"decorator", HighlightGroup::Macro},
+            {"string", HighlightGroup::String},
+            {"integer", HighlightGroup::Number},
+            {"float", HighlightGroup::Number},
+            {"comment", HighlightGroup::Comment},
+            {"true", HighlightGroup::Constant},
+            {"false", HighlightGroup::Constant},
+            {"none", HighlightGroup::Constant},
+        };
+    });
 
     // CMake language
-    auto cmakeLang = std::make_unique<Language>();
-    cmakeLang->name = "cmake";
-    cmakeLang->extensions = {".cmake", "CMakeLists.txt"};
-    cmakeLang->tsLanguage = tree_sitter_cmake();
-    cmakeLang->highlightMappings = {
-        {"identifier", HighlightGroup::Variable},
-        {"function", HighlightGroup::Function},
-        {"variable", HighlightGroup::Variable},
-        {"string", HighlightGroup::String},
-        {"number", HighlightGroup::Number},
-        {"comment", HighlightGroup::Comment},
-        {"boolean", HighlightGroup::Constant},
-    };
-    RegisterLanguage(std::move(cmakeLang));
+    AddBuiltin("cmake", {".cmake", "CMakeLists.txt"}, [](Language& lang) {
+        lang.tsLanguage = tree_sitter_cmake();
+        lang.lexical = {"#", "", "", "\""};
+        lang.highlightMappings = {
+            {"identifier", HighlightGroup::Variable},
+            {"function", HighlightGroup::Function},
+            {"variable", HighlightGroup::Variable},
+            {"string", HighlightGroup::String},
+            {"number", HighlightGroup::Number},
+            {"comment", HighlightGroup::Comment},
+            {"boolean", HighlightGroup::Constant},
+        };
+    });
 
     // CSS language
-    auto cssLang = std::make_unique<Language>();
-    cssLang->name = "css";
-    cssLang->extensions = {".css"};
-    cssLang->tsLanguage = tree_sitter_css();
-    cssLang->highlightMappings = {
-        {"tag_name", HighlightGroup::Keyword},
-        {"class_name", HighlightGroup::Type},
-        {"id_name", HighlightGroup::Type},
-        {"attribute_name", HighlightGroup::Variable},
-        {"property_name", HighlightGroup::Variable},
-        {"string_value", HighlightGroup::String},
-        {"integer_value", HighlightGroup::Number},
-        {"float_value", HighlightGroup::Number},
-        {"comment", HighlightGroup::Comment},
-        {"color_value", HighlightGroup::Constant},
-    };
-    RegisterLanguage(std::move(cssLang));
+    AddBuiltin("css", {".css"}, [](Language& lang) {
+        lang.tsLanguage = tree_sitter_css();
+        lang.lexical = {"", "/*", "*/", "\"'"};
+        lang.highlightMappings = {
+            {"tag_name", HighlightGroup::Keyword},
+            {"class_name", HighlightGroup::Type},
+            {"id_name", HighlightGroup::Type},
+            {"attribute_name", HighlightGroup::Variable},
+            {"property_name", HighlightGroup::Variable},
+            {"string_value", HighlightGroup::String},
+            {"integer_value", HighlightGroup::Number},
+            {"float_value", HighlightGroup::Number},
+            {"comment", HighlightGroup::Comment},
+            {"color_value", HighlightGroup::Constant},
+        };
+    });
 
     // HTML language
-    auto htmlLang = std::make_unique<Language>();
-    htmlLang->name = "html";
-    htmlLang->extensions = {".html", ".htm"};
-    htmlLang->tsLanguage = tree_sitter_html();
-    htmlLang->highlightMappings = {
-        {"tag_name", HighlightGroup::Keyword},
-        {"attribute_name", HighlightGroup::Variable},
-        {"attribute_value", HighlightGroup::String},
-        {"comment", HighlightGroup::Comment},
-        {"doctype", HighlightGroup::Macro},
-    };
-    RegisterLanguage(std::move(htmlLang));
+    AddBuiltin("html", {".html", ".htm"}, [](Language& lang) {
+        lang.tsLanguage = tree_sitter_html();
+        lang.lexical = {"", "<!--", "-->", ""};
+        lang.highlightMappings = {
+            {"tag_name", HighlightGroup::Keyword},
+            {"attribute_name", HighlightGroup::Variable},
+            {"attribute_value", HighlightGroup::String},
+            {"comment", HighlightGroup::Comment},
+            {"doctype", HighlightGroup::Macro},
+        };
+    });
 
     // JavaScript language
-    auto jsLang = std::make_unique<Language>();
-    jsLang->name = "javascript";
-    jsLang->extensions = {".js", ".mjs", ".cjs"};
-    jsLang->tsLanguage = tree_sitter_javascript();
-    jsLang->highlightMappings = {
-        {"identifier", HighlightGroup::Variable},
-        {"property_identifier", HighlightGroup::Variable},
-        {"shorthand_property_identifier", HighlightGroup::Variable},
-        {"function_declaration", HighlightGroup::Function},
-        {"function", HighlightGroup::Function},
-        {"call_expression", HighlightGroup::Function},
-        {"string", HighlightGroup::String},
-        {"template_string", HighlightGroup::String},
-        {"number", HighlightGroup::Number},
-        {"comment", HighlightGroup::Comment},
-        {"true", HighlightGroup::Constant},
-        {"false", HighlightGroup::Constant},
-        {"null", HighlightGroup::Constant},
-        {"undefined", HighlightGroup::Constant},
-    };
-    RegisterLanguage(std::move(jsLang));
+    AddBuiltin("javascript", {".js", ".mjs", ".cjs"}, [](Language& lang) {
+        lang.tsLanguage = tree_sitter_javascript();
+        lang.lexical = {"//", "/*", "*/", "\"'`"};
+        lang.highlightMappings = {
+            {"identifier", HighlightGroup::Variable},
+            {"property_identifier", HighlightGroup::Variable},
+            {"shorthand_property_identifier", HighlightGroup::Variable},
+            {"function_declaration", HighlightGroup::Function},
+            {"function", HighlightGroup::Function},
+            {"call_expression", HighlightGroup::Function},
+            {"string", HighlightGroup::String},
+            {"template_string", HighlightGroup::String},
+            {"number", HighlightGroup::Number},
+            {"comment", HighlightGroup::Comment},
+            {"true", HighlightGroup::Constant},
+            {"false", HighlightGroup::Constant},
+            {"null", HighlightGroup::Constant},
+            {"undefined", HighlightGroup::Constant},
+        };
+    });
 
     // JSON language
-    auto jsonLang = std::make_unique<Language>();
-    jsonLang->name = "json";
-    jsonLang->extensions = {".json"};
-    jsonLang->tsLanguage = tree_sitter_json();
-    jsonLang->highlightMappings = {
-        {"pair_key", HighlightGroup::Variable},
-        {"string", HighlightGroup::String},
-        {"number", HighlightGroup::Number},
-        {"true", HighlightGroup::Constant},
-        {"false", HighlightGroup::Constant},
-        {"null", HighlightGroup::Constant},
-    };
-    RegisterLanguage(std::move(jsonLang));
+    AddBuiltin("json", {".json"}, [](Language& lang) {
+        lang.tsLanguage = tree_sitter_json();
+        lang.lexical = {"", "", "", "\""};
+        lang.highlightMappings = {
+            {"pair_key", HighlightGroup::Variable},
+            {"string", HighlightGroup::String},
+            {"number", HighlightGroup::Number},
+            {"true", HighlightGroup::Constant},
+            {"false", HighlightGroup::Constant},
+            {"null", HighlightGroup::Constant},
+        };
+    });
 
     // Markdown language
-    auto mdLang = std::make_unique<Language>();
-    mdLang->name = "markdown";
-    mdLang->extensions = {".md", ".markdown"};
-    mdLang->tsLanguage = tree_sitter_markdown();
-    mdLang->highlightMappings = {
-        {"atx_heading", HighlightGroup::Function},
-        {"setext_heading", HighlightGroup::Function},
-        {"fenced_code_block", HighlightGroup::String}, // Treat code blocks as "string" for now
-        {"link_text", HighlightGroup::Keyword},
-        {"link_destination", HighlightGroup::String},
-        {"list_marker_plus", HighlightGroup::Operator},
-        {"list_marker_minus", HighlightGroup::Operator},
-        {"list_marker_star", HighlightGroup::Operator},
-        {"list_marker_dot", HighlightGroup::Operator},
-        {"emphasis", HighlightGroup::Type},
-        {"strong_emphasis", HighlightGroup::Type},
-    };
-    RegisterLanguage(std::move(mdLang));
+    AddBuiltin("markdown", {".md", ".markdown"}, [](Language& lang) {
+        lang.tsLanguage = tree_sitter_markdown();
+        lang.highlightMappings = {
+            {"atx_heading", HighlightGroup::Function},
+            {"setext_heading", HighlightGroup::Function},
+            {"fenced_code_block", HighlightGroup::String}, // Treat code blocks as "string" for now
+            {"link_text", HighlightGroup::Keyword},
+            {"link_destination", HighlightGroup::String},
+            {"list_marker_plus", HighlightGroup::Operator},
+            {"list_marker_minus", HighlightGroup::Operator},
+            {"list_marker_star", HighlightGroup::Operator},
+            {"list_marker_dot", HighlightGroup::Operator},
+            {"emphasis", HighlightGroup::Type},
+            {"strong_emphasis", HighlightGroup::Type},
+        };
+    });
 
     // TypeScript language
-    auto tsLang = std::make_unique<Language>();
-    tsLang->name = "typescript";
-    tsLang->extensions = {".ts", ".tsx"};
-    tsLang->tsLanguage = tree_sitter_typescript();
-    tsLang->highlightMappings = {
-        {"identifier", HighlightGroup::Variable},
-        {"property_identifier", HighlightGroup::Variable},
-        {"shorthand_property_identifier", HighlightGroup::Variable},
-        {"type_identifier", HighlightGroup::Type},
-        {"predefined_type", HighlightGroup::Type},
-        {"function_declaration", HighlightGroup::Function},
-        {"function", HighlightGroup::Function},
-        {"call_expression", HighlightGroup::Function},
-        {"string", HighlightGroup::String},
-        {"template_string", HighlightGroup::String},
-        {"number", HighlightGroup::Number},
-        {"comment", HighlightGroup::Comment},
-        {"true", HighlightGroup::Constant},
-        {"false", HighlightGroup::Constant},
-        {"null", HighlightGroup::Constant},
-        {"undefined", HighlightGroup::Constant},
-    };
-    RegisterLanguage(std::move(tsLang));
+    AddBuiltin("typescript", {".ts", ".tsx"}, [](Language& lang) {
+        lang.tsLanguage = tree_sitter_typescript();
+        lang.lexical = {"//", "/*", "*/", "\"'`"};
+        lang.highlightMappings = {
+            {"identifier", HighlightGroup::Variable},
+            {"property_identifier", HighlightGroup::Variable},
+            {"shorthand_property_identifier", HighlightGroup::Variable},
+            {"type_identifier", HighlightGroup::Type},
+            {"predefined_type", HighlightGroup::Type},
+            {"function_declaration", HighlightGroup::Function},
+            {"function", HighlightGroup::Function},
+            {"call_expression", HighlightGroup::Function},
+            {"string", HighlightGroup::String},
+            {"template_string", HighlightGroup::String},
+            {"number", HighlightGroup::Number},
+            {"comment", HighlightGroup::Comment},
+            {"true", HighlightGroup::Constant},
+            {"false", HighlightGroup::Constant},
+            {"null", HighlightGroup::Constant},
+            {"undefined", HighlightGroup::Constant},
+        };
+    });
 }
 
 } // namespace sol
 
 namespace sol {
-std::vector<std::string> TextBuffer::GetWordCompletions(const std::string& prefix, size_t cursorPos) const {
-    std::set<std::string> words;
+std::vector<SymbolDefinition> TextBuffer::GetSymbols() const {
+    std::vector<SymbolDefinition> symbols;
+    if (m_Tree && m_Language && m_Language->tagsQuery) {
+        m_Language->tagsQuery->Definitions(ts_tree_root_node(m_Tree), m_Rope, symbols);
+    }
+    return symbols;
+}
+
+std::vector<std::string> TextBuffer::GetWordCompletions(const std::string& prefix, size_t cursorPos) {
+    if (m_Session) m_Session->RecordCompletion(prefix, cursorPos);
+    UpdateIdentifiers();
+    return m_Identifiers.Complete(prefix, m_Rope.PosToLineCol(std::min(cursorPos, m_Rope.Length())).first);
+}
+
+// Indexes stale lines, and lines indexed as plain text once a current tree
+// can tell identifiers from keywords, strings and comments
+void TextBuffer::UpdateIdentifiers() {
+    using LineState = IdentifierIndex::LineState;
+    const size_t lineCount = m_Rope.LineCount();
+    if (m_Identifiers.LineCount() != lineCount) m_Identifiers.Reset(lineCount);
+    
+    const bool syntax = m_Tree && m_Language && !IsParsing();
+    if (syntax && m_Identifiers.HasTextLines()) {
+        for (size_t line = 0; line < lineCount; ++line) {
+            if (m_Identifiers.GetState(line) == LineState::Text) m_Identifiers.Invalidate(line, line);
+        }
+    }
+    if (m_Identifiers.IsComplete()) return;
     
-    // 1. Try Tree-sitter completions first if available (Smarter, "Educated" fallback)
-    if (m_Tree) {
-        TSNode root = ts_tree_root_node(m_Tree);
-        TSTreeCursor cursor = ts_tree_cursor_new(root);
-        
-        bool visitChildren = true;
-        while (true) {
-            TSNode node = ts_tree_cursor_current_node(&cursor);
-            const char* type = ts_node_type(node);
-            std::string typeStr = (type ? type : "");
-            
-            // Skip comments and strings to keep completions clean
-            bool isStringOrComment = (typeStr.find("string") != std::string::npos || 
-                                     typeStr.find("comment") != std::string::npos);
-            
-            if (isStringOrComment) {
-                visitChildren = false; 
-            } else {
-                // Collect identifiers
-                if (ts_node_is_named(node)) {
-                    bool isId = false;
-                    // Heuristic: check for identifier-like node types
-                    if (typeStr.find("identifier") != std::string::npos || 
-                        typeStr.find("name") != std::string::npos || 
-                        typeStr == "word") {
-                        isId = true;
-                    }
+    const LineState state = syntax ? LineState::Syntax : LineState::Text;
+    for (size_t line = 0; line < lineCount;) {
+        if (m_Identifiers.GetState(line) != LineState::Stale) {
+            ++line;
+            continue;
+        }
+        size_t runEnd = line + 1;
+        while (runEnd < lineCount && m_Identifiers.GetState(runEnd) == LineState::Stale) ++runEnd;
+        IndexIdentifiers(line, runEnd, state);
+        line = runEnd;
+    }
+}
 
-                    if (isId) {
-                        uint32_t start = ts_node_start_byte(node);
-                        uint32_t end = ts_node_end_byte(node);
-                        if (end > start) {
-                            std::string text = m_Rope.Substring(start, end - start);
-                            if (!text.empty() && (isalpha(text[0]) || text[0] == '_')) {
-                                bool match = true;
-                                if (!prefix.empty()) {
-                                    if (text.length() < prefix.length()) match = false;
-                                    else {
-                                        for(size_t i = 0; i < prefix.length(); ++i) {
-                                            if (std::tolower(text[i]) != std::tolower(prefix[i])) {
-                                                match = false;
-                                                break;
-                                            }
-                                        }
-                                    }
-                                }
-                                if (match && text != prefix) {
-                                    words.insert(text);
-                                }
-                            }
-                        }
-                    }
-                }
-            }
-            
-            // Traverse
-            if (visitChildren && ts_tree_cursor_goto_first_child(&cursor)) {
-                visitChildren = true;
-                continue;
-            }
-            
-            bool moved = false;
-            while (!moved) {
-                if (ts_tree_cursor_goto_next_sibling(&cursor)) {
-                    visitChildren = true;
-                    moved = true;
-                } else {
-                    if (!ts_tree_cursor_goto_parent(&cursor)) {
-                        ts_tree_cursor_delete(&cursor);
-                        // If we found words, return them
-                        if (!words.empty()) {
-                            return std::vector<std::string>(words.begin(), words.end());
-                        }
-                        goto raw_fallback;
-                    }
-                }
+void TextBuffer::IndexIdentifiers(size_t firstLine, size_t endLine, IdentifierIndex::LineState state) {
+    auto isWordStart = [](char c) { return std::isalpha(static_cast<unsigned char>(c)) || c == '_'; };
+    auto isWordChar = [](char c) { return std::isalnum(static_cast<unsigned char>(c)) || c == '_'; };
+    std::vector<std::vector<std::string_view>> words(endLine - firstLine);
+    
+    if (state == IdentifierIndex::LineState::Text) {
+        const size_t start = m_Rope.LineStart(firstLine);
+        const std::string text = m_Rope.Substring(start, m_Rope.LineEnd(endLine - 1) - start);
+        size_t row = 0;
+        for (size_t i = 0; i < text.length();) {
+            if (text[i] == '\n') {
+                ++row;
+                ++i;
+            } else if (isWordChar(text[i])) {
+                size_t end = i;
+                while (end < text.length() && isWordChar(text[end])) ++end;
+                if (isWordStart(text[i])) words[row].push_back(std::string_view(text).substr(i, end - i));
+                i = end;
+            } else {
+                ++i;
             }
         }
+        for (size_t line = firstLine; line < endLine; ++line) m_Identifiers.SetLine(line, words[line - firstLine], state);
+        return;
     }
-
-raw_fallback:
-    std::string text = m_Rope.ToString(); // Not optimal for huge files, but safe
-    const char* ptr = text.c_str();
-    const char* end = ptr + text.length();
     
-    while (ptr < end) {
-        // Skip non-word chars
-        while (ptr < end && !(isalnum(*ptr) || *ptr == '_')) {
-            ptr++;
-        }
-        
-        if (ptr >= end) break;
+    // Identifier nodes starting on the lines, outside strings and comments
+    std::vector<std::pair<size_t, std::string>> found;
+    TSTreeCursor cursor = ts_tree_cursor_new(ts_tree_root_node(m_Tree));
+    while (true) {
+        TSNode node = ts_tree_cursor_current_node(&cursor);
+        const TSPoint start = ts_node_start_point(node);
+        const bool inRows = start.row < endLine && ts_node_end_point(node).row >= firstLine;
+        const Language::SymbolInfo& info = m_Language->Symbol(ts_node_symbol(node));
         
-        const char* start = ptr;
-        while (ptr < end && (isalnum(*ptr) || *ptr == '_')) {
-            ptr++;
+        if (inRows && info.identifier && start.row >= firstLine) {
+            const uint32_t startByte = ts_node_start_byte(node);
+            const uint32_t endByte = ts_node_end_byte(node);
+            std::string text = m_Rope.Substring(startByte, endByte - startByte);
+            if (!text.empty() && isWordStart(text[0])) found.emplace_back(start.row, std::move(text));
         }
         
-        std::string word(start, ptr - start);
-        // If prefix matches (case insensitive)
-        if (word.length() > prefix.length()) {
-            bool match = true;
-            for(size_t i = 0; i < prefix.length(); ++i) {
-                if (std::tolower(word[i]) != std::tolower(prefix[i])) {
-                    match = false;
-                    break;
-                }
+        if (inRows && !info.literal && ts_tree_cursor_goto_first_child(&cursor)) continue;
+        if (ts_tree_cursor_goto_next_sibling(&cursor)) continue;
+        
+        bool moved = false;
+        while (ts_tree_cursor_goto_parent(&cursor)) {
+            if (ts_tree_cursor_goto_next_sibling(&cursor)) {
+                moved = true;
+                break;
             }
-            if (match) words.insert(word);
-        }
-        // If empty prefix, just all words? Maybe too many. Limit length > 3
-        else if (prefix.empty() && word.length() > 3) {
-            words.insert(word);
         }
+        if (!moved) break;
     }
+    ts_tree_cursor_delete(&cursor);
     
-    return std::vector<std::string>(words.begin(), words.end());
+    for (const auto& [row, text] : found) words[row - firstLine].push_back(text);
+    for (size_t line = firstLine; line < endLine; ++line) m_Identifiers.SetLine(line, words[line - firstLine], state);
 }
 }
 
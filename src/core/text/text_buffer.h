@@ -1,24 +1,40 @@
 #pragma once
 
 #include "rope.h"
+#include "line_window.h"
+#include "undo_tree.h"
+#include "identifier_index.h"
+#include "semantic_tokens.h"
+#include "diagnostic_store.h"
+#include <array>
+#include <chrono>
+#include <deque>
 #include <string>
 #include <string_view>
 #include <vector>
 #include <memory>
+#include <mutex>
+#include <optional>
 #include <functional>
 #include <filesystem>
-#include <fstream>
+#include <span>
 
 // Forward declare tree-sitter types
 extern "C" {
-    typedef struct TSParser TSParser;
     typedef struct TSTree TSTree;
     typedef struct TSLanguage TSLanguage;
     struct TSPoint;
+    struct TSInput;
+    struct TSRange;
 }
 
 namespace sol {
 
+struct LSPTextChange;
+class EditSession;
+class HighlightQuery;
+class TagsQuery;
+
 // Syntax highlight token
 struct SyntaxToken {
     size_t startByte;
@@ -27,16 +43,57 @@ struct SyntaxToken {
     size_t startCol;
     size_t endRow;
     size_t endCol;
-    const char* type;       // Tree-sitter node type
+    uint16_t symbol;        // Tree-sitter node symbol
     uint16_t highlightId;   // Mapped highlight group
     uint16_t depth;         // Nesting depth for rainbow brackets
 };
 
+// Highlighted run of one line, in bytes from the line start; end may run
+// past the line for tokens that continue onto the next one. Touching runs
+// of one highlight are merged.
+struct HighlightSpan {
+    uint32_t start;
+    uint32_t end;
+    uint16_t highlightId;
+    uint16_t depth;
+    bool bracket;           // Candidate for rainbow coloring
+};
+
 // Foldable range (for collapsible scopes)
 struct FoldRange {
     size_t startLine;   // Line where fold starts (has the fold indicator)
     size_t endLine;     // Line where fold ends (inclusive)
     const char* type;   // Node type (for potential icons/hints)
+    uint32_t id;        // Stable across edits that move the fold without reshaping it
+};
+
+enum class SymbolKind : uint8_t {
+    Function,
+    Method,
+    Class,
+    Interface,
+    Module,
+    Macro,
+    Type,
+    Constant,
+    Variable,
+    Other
+};
+
+// A definition found by the language's tags query; the position is where
+// the name starts
+struct SymbolDefinition {
+    std::string name;
+    SymbolKind kind;
+    uint32_t line;
+    uint32_t column;
+};
+
+// Replacement of [pos, pos + len) within a batch of edits
+struct TextEdit {
+    size_t pos;
+    size_t len;
+    std::string text;
 };
 
 // Highlight groups (similar to Neovim)
@@ -58,14 +115,51 @@ enum class HighlightGroup : uint16_t {
     Count
 };
 
-// Language definition
+// Language definition. Registered by name and extensions only; load fills
+// in the grammar, mappings and lexical syntax on first lookup, and the
+// tables derived from them are built right after.
 struct Language {
+    using Loader = void (*)(Language&);
+    
     std::string name;
     std::vector<std::string> extensions;
-    const TSLanguage* tsLanguage;
+    Loader load = nullptr;
+    std::once_flag loaded;
+    const TSLanguage* tsLanguage = nullptr;
     
-    // Highlight mappings (node type -> highlight group)
+    // Highlight mappings (node type -> highlight group), used when the
+    // grammar has no highlight query
     std::vector<std::pair<std::string, HighlightGroup>> highlightMappings;
+    std::unique_ptr<HighlightQuery> highlightQuery;
+    std::unique_ptr<TagsQuery> tagsQuery;  // Definitions for the symbol index
+    
+    // Indexed by TSSymbol, resolved from the mappings at registration so
+    // highlighting never compares type names
+    struct SymbolInfo {
+        HighlightGroup group = HighlightGroup::None;
+        bool bracket = false;   // Candidate for rainbow coloring
+        bool identifier = false; // Offered by built-in completion
+        bool literal = false;    // String or comment, not searched for identifiers
+    };
+    std::vector<SymbolInfo> symbols;
+    
+    // Lexical highlighting, shown until the first parse lands and for texts
+    // too large to parse
+    struct LexicalSyntax {
+        std::string_view lineComment;
+        std::string_view blockCommentStart;
+        std::string_view blockCommentEnd;
+        std::string_view quotes;
+    };
+    LexicalSyntax lexical;
+    std::vector<std::pair<std::string, HighlightGroup>> keywords;  // Word tokens of the grammar, sorted
+    
+    const SymbolInfo& Symbol(uint16_t symbol) const {
+        static constexpr SymbolInfo NONE{};
+        return symbol < symbols.size() ? symbols[symbol] : NONE;
+    }
+    
+    ~Language();
 };
 
 // TextBuffer - combines Rope with tree-sitter for nvim-like editing
@@ -84,124 +178,261 @@ public:
     void Insert(size_t pos, std::string_view text);
     void Delete(size_t pos, size_t len);
     void Replace(size_t pos, size_t len, std::string_view text);
+    // Applies a batch in one rope pass with one reparse and one change
+    // notification. Positions refer to the text before the batch; edits are
+    // sorted in place and must not overlap. replaced receives the old text of
+    // each edit in sorted order.
+    bool ApplyEdits(std::vector<TextEdit>& edits, std::vector<std::string>* replaced = nullptr);
+    // Edits until EndTransaction change the text only: nothing is reparsed,
+    // shifted or sent to a server. The end folds them into one replacement
+    // of the span that differs, applied as a single edit, and pushes that
+    // as one undo step. Transactions do not nest.
+    void BeginTransaction();
+    void EndTransaction(size_t cursorBefore, size_t cursorAfter);
+    bool InTransaction() const { return m_Transaction.has_value(); }
+    
+    // Records every edit, undo step, highlight and completion from here on,
+    // from the whole text as it is; see EditSession. Text replaced whole, as
+    // by loading, is not recorded.
+    std::shared_ptr<EditSession> StartRecording();
     
     char At(size_t pos) const { return m_Rope.At(pos); }
     std::string Substring(size_t pos, size_t len) const { return m_Rope.Substring(pos, len); }
     std::string ToString() const { return m_Rope.ToString(); }
     size_t Length() const { return m_Rope.Length(); }
     bool Empty() const { return m_Rope.Empty(); }
+    Rope Snapshot() const { return m_Rope.Snapshot(); }
+    
+    // Zero-copy access to the underlying leaf slices
+    Rope::ChunkIterator ChunkAt(size_t pos) const { return m_Rope.ChunkAt(pos); }
+    template <typename F>
+    void ForEachChunk(size_t start, size_t end, F&& f) const { m_Rope.ForEachChunk(start, end, std::forward<F>(f)); }
     
     // Line operations
-    size_t LineCount() const { 
-        if (m_IsDiskBuffered) return m_DiskLineStarts.size();
-        return m_Rope.LineCount(); 
-    }
-    std::string Line(size_t lineNum) const;
-    std::string_view LineView(size_t lineNum) const;
-    
-    size_t LineStart(size_t lineNum) const { 
-        if (m_IsDiskBuffered) {
-             if (lineNum >= m_DiskLineStarts.size()) return 0;
-             return m_DiskLineStarts[lineNum];
-        }
-        return m_Rope.LineStart(lineNum); 
-    }
-    size_t LineEnd(size_t lineNum) const { 
-        if (m_IsDiskBuffered) {
-            if (lineNum + 1 < m_DiskLineStarts.size()) {
-                 size_t next = m_DiskLineStarts[lineNum+1];
-                 return next > 0 ? next - 1 : 0;
-            }
-            return m_DiskFileSize;
-        }
-        return m_Rope.LineEnd(lineNum); 
-    }
-    std::pair<size_t, size_t> PosToLineCol(size_t pos) const { 
-         if (m_IsDiskBuffered) {
-              // Binary search m_DiskLineStarts
-              auto it = std::upper_bound(m_DiskLineStarts.begin(), m_DiskLineStarts.end(), pos);
-              size_t line = 0;
-              if (it != m_DiskLineStarts.begin()) {
-                  line = static_cast<size_t>(it - m_DiskLineStarts.begin()) - 1;
-              }
-              return {line, pos - m_DiskLineStarts[line]};
-         }
-         return m_Rope.PosToLineCol(pos); 
-    }
+    size_t LineCount() const { return m_Rope.LineCount(); }
+    std::string Line(size_t lineNum) const { return m_Rope.Line(lineNum); }
+    std::string_view LineView(size_t lineNum) const { return m_Rope.LineView(lineNum); }
+    
+    size_t LineStart(size_t lineNum) const { return m_Rope.LineStart(lineNum); }
+    size_t LineEnd(size_t lineNum) const { return m_Rope.LineEnd(lineNum); }
+    std::pair<size_t, size_t> PosToLineCol(size_t pos) const { return m_Rope.PosToLineCol(pos); }
     size_t LineColToPos(size_t line, size_t col) const { return m_Rope.LineColToPos(line, col); }
-    void PrepareVisibleRange(size_t firstLine, size_t lastLine);
+    size_t MaxLineLength() const { return m_Rope.MaxLineLength(); }
+    
+    // UTF-16 positions as used by LSP
+    std::pair<size_t, size_t> PosToLineUtf16Col(size_t pos) const { return m_Rope.PosToLineUtf16Col(pos); }
+    size_t LineUtf16ColToPos(size_t line, size_t col) const { return m_Rope.LineUtf16ColToPos(line, col); }
+    // A view's own copy of the lines it shows, read through LineView(window, line)
+    void PrepareLineWindow(LineWindow& window, size_t firstLine, size_t lastLine) const { window.Prepare(m_Rope, firstLine, lastLine); }
+    std::string_view LineView(const LineWindow& window, size_t lineNum) const { return window.Line(m_Rope, lineNum); }
     
     // Language/syntax
     void SetLanguage(const Language* lang);
     const Language* GetLanguage() const { return m_Language; }
     bool HasLanguage() const { return m_Language != nullptr; }
     
-    // Syntax highlighting
-    void Parse();
+    // Syntax highlighting. Edits shift the current tree right away and
+    // reparse on the JobSystem against a snapshot, in time slices; the tree is
+    // only replaced once that parse has caught up, so rendering never waits
+    // on the parser. Lines are highlighted lexically until the first tree.
+    void Parse();  // Full parse on the calling thread
     void ParseIncremental();
     bool IsParsed() const { return m_Tree != nullptr; }
+    bool IsParsing() const;
+    bool PollParsing();     // Returns true when a new tree was swapped in
+    void FinishParsing();   // Blocks until the tree matches the text
     
     // Get syntax tokens for a line range (for rendering)
     std::vector<SyntaxToken> GetSyntaxTokens(size_t startLine, size_t endLine) const;
+    // Cached per-line spans: edits and reparses invalidate only the lines
+    // they touch, UpdateHighlights recomputes those in [firstLine, endLine)
+    void UpdateHighlights(size_t firstLine, size_t endLine);
+    std::span<const HighlightSpan> GetLineHighlights(size_t line) const;
+    // Lines UpdateHighlights found cached, and those it had to recompute
+    struct HighlightStats {
+        uint64_t hits = 0;
+        uint64_t misses = 0;
+    };
+    const HighlightStats& GetHighlightStats() const { return m_HighlightStats; }
+    // Time the parser spent on the last tree swapped in, over all its slices
+    std::chrono::microseconds GetLastParseTime() const { return m_LastParseTime; }
+    // Asks the language server for semantic tokens once edits settle and
+    // takes in answers that arrived, never waiting for one. Until the first
+    // full result the visible lines are requested on their own. Their
+    // highlights override the syntax tree's.
+    void UpdateSemanticTokens(size_t firstLine, size_t endLine);
+    
+    // The language server's diagnostics, shared by every view of the buffer
+    // and moved by edits until the server publishes again
+    void SetDiagnostics(const std::vector<LSPDiagnostic>& diagnostics);
+    const DiagnosticStore& GetDiagnostics() const { return m_Diagnostics; }
     HighlightGroup GetHighlightAt(size_t pos) const;
 
     // Advanced syntax features
     std::pair<size_t, size_t> GetScopeRange(size_t pos) const;
     size_t GetMatchingBracket(size_t pos) const; // Returns pos, or -1 (SIZE_MAX) if none
     
-    // Code folding - returns all foldable ranges sorted by startLine
-    std::vector<FoldRange> GetFoldRanges() const;
+    // Code folding - one foldable range per start line, sorted by startLine.
+    // Edits shift the ranges and reparses recompute only the changed parts;
+    // the version changes whenever the ranges do, across all buffers.
+    const std::vector<FoldRange>& GetFoldRanges();
+    uint64_t GetFoldVersion() const { return m_Folds.version; }
+    
+    // Definitions in the current tree, in source order
+    std::vector<SymbolDefinition> GetSymbols() const;
     
-    // Built-in completion
-    std::vector<std::string> GetWordCompletions(const std::string& prefix, size_t cursorPos = 0) const;
+    // Built-in completion from an identifier index kept up to date per line,
+    // nearest occurrences to cursorPos first
+    std::vector<std::string> GetWordCompletions(const std::string& prefix, size_t cursorPos = 0);
 
     // For ImGui compatibility
     const char* CStr() const { return m_Rope.CStr(); }
     char* Data() { return m_Rope.Data(); }
     size_t Capacity() const { return m_Rope.Capacity(); }
-    void SyncFromBuffer() { m_Rope.SyncFromBuffer(); ParseIncremental(); }
+    void SyncFromBuffer();
     
     // File association
     void SetFilePath(const std::filesystem::path& path) { m_FilePath = path; }
     const std::filesystem::path& GetFilePath() const { return m_FilePath; }
     
-    // Streaming support
-    void EnableDiskBuffering(const std::filesystem::path& path);
+    // Replaces the text with the file's, copied into in-memory leaves on the
+    // JobSystem. The parse, the undo history and the language server's
+    // didOpen follow once the whole file is in; a restore after Unload keeps
+    // the history and the server's document instead. Returns false if the
+    // file could not be opened.
+    bool LoadFile(const std::filesystem::path& path, bool restore = false);
+    
+    // Streaming support: memory-maps the file and edits it as a piece table.
+    // Returns false if the file could not be mapped.
+    bool EnableDiskBuffering(const std::filesystem::path& path);
     bool IsDiskBuffered() const { return m_IsDiskBuffered; }
+    
+    // Loaded and mapped files are indexed in ranges on the JobSystem.
+    // PollIndexing appends the ranges finished so far in file order, so the
+    // head is usable while the tail is still being scanned.
+    bool IsIndexing() const { return m_Indexing != nullptr; }
+    float GetIndexingProgress() const;
+    void PollIndexing();
+    void FinishIndexing();  // Blocks until the whole file is in the rope
 
+    // Memory budget support. Usage counts the in-memory text, its caches and
+    // an estimate of the syntax tree. What is released comes back on demand:
+    // RestoreSyntax reparses in the background and caches rebuild when read.
+    size_t GetMemoryUsage() const;
+    size_t GetTreeMemory() const;  // Estimated from the tree's node count
+    void ReleaseSyntax();
+    void RestoreSyntax();
+    void ReleaseCaches() { m_Rope.ReleaseCaches(); }
+    // Drops the text, keeping the file, language and undo history
+    void Unload();
+    
     // Modified state
     bool IsModified() const { return m_Modified; }
 
     void SetModified(bool modified) { m_Modified = modified; }
     void MarkModified() { m_Modified = true; }
     
-    // Undo/Redo support (future)
-    struct EditRecord {
-        size_t pos;
-        std::string oldText;
-        std::string newText;
-    };
+    // Edit history lives with the text so every view of a buffer shares it
+    UndoTree& GetUndoTree() { return m_UndoTree; }
+    
+    // Views caching per-line state follow the text through its line shifts:
+    // each edit replaces lines [first, oldLast] with [first, newLast], and a
+    // reparse or new semantic tokens recolor lines in place, with oldLast and
+    // newLast equal; the line version counts the shifts made.
+    // GetLineShiftsSince appends those made after version, or returns false
+    // once they are no longer kept or the whole text was replaced or lost its
+    // tree since, and everything cached is stale.
+    using LineShift = std::array<size_t, 3>;  // first, oldLast, newLast
+    uint64_t GetLineVersion() const { return m_LineVersion; }
+    bool GetLineShiftsSince(uint64_t version, std::vector<LineShift>& out) const;
     
 private:
     Rope m_Rope;
-    // Disk buffering members
+    UndoTree m_UndoTree;
+    std::optional<Rope> m_Transaction;  // Text at BeginTransaction
+    std::shared_ptr<EditSession> m_Session;
     bool m_IsDiskBuffered = false;
-    mutable std::ifstream m_FileStream; // Unused but kept for ABI compat if needed? No, I can remove users.
-    mutable std::vector<size_t> m_DiskLineStarts;
-    size_t m_DiskFileSize = 0;
-    void IndexDiskFile();
     
-    TSParser* m_Parser = nullptr;
+    struct IndexState;
+    std::shared_ptr<IndexState> m_Indexing;
+    void StartIndexing(std::shared_ptr<const MappedFile> file, bool copy, bool restore);
+    void PublishIndexedRanges(bool wait);
+    void CancelIndexing();
+    void FinishLoad(std::optional<uint64_t> hash);
+    
     TSTree* m_Tree = nullptr;
+    
+    struct ParseState;
+    std::shared_ptr<ParseState> m_Parsing;
+    std::chrono::microseconds m_LastParseTime{0};
+    bool CanParse() const;
+    TSTree* ParseNow(TSTree* old);  // On this thread, timed
+    void StartParse();
+    void Reparse();
+    bool SwapInParse();
+    void CancelParsing();
+    void ReplaceTree(TSTree* tree);
+    
+    struct LineHighlights {
+        std::vector<HighlightSpan> spans;
+        bool valid = false;
+    };
+    std::vector<LineHighlights> m_Highlights;  // One per line once highlighting is requested
+    HighlightStats m_HighlightStats;
+    void ShiftHighlights(const Rope::EditInfo& edit);
+    
+    struct FoldIndex {
+        std::vector<FoldRange> ranges;
+        bool valid = false;
+        uint64_t version = 0;
+        uint32_t nextId = 0;
+    };
+    FoldIndex m_Folds;
+    void CollectFolds(size_t firstRow, size_t lastRow, std::vector<FoldRange>& ranges) const;
+    void ShiftFolds(const Rope::EditInfo& edit);
+    void RefreshFolds(const TSRange* changed, uint32_t count);
+    void InvalidateFolds();
+    
+    SemanticTokens m_Semantic;
+    struct SemanticRequest;
+    std::shared_ptr<SemanticRequest> m_SemanticRequest;
+    LSPSemanticTokensProvider m_SemanticProvider;  // Without token types once the legend is set
+    uint64_t m_EditCount = 0;
+    uint64_t m_SemanticVersion = 0;  // Edit count of the text the shown tokens are for
+    std::pair<size_t, size_t> m_SemanticLines;  // Lines of the shown range result
+    std::chrono::steady_clock::time_point m_SemanticNotBefore;
+    void RequestSemanticTokens(size_t firstLine, size_t endLine);
+    bool ApplySemanticTokens(SemanticRequest& request, LSPSemanticTokens tokens);
+    void ResetSemanticTokens();
+    void CancelSemanticRequest();
+    void OverlaySemanticTokens(size_t line);
+    
+    DiagnosticStore m_Diagnostics;
+    
+    IdentifierIndex m_Identifiers;
+    void UpdateIdentifiers();
+    void IndexIdentifiers(size_t firstLine, size_t endLine, IdentifierIndex::LineState state);
     const Language* m_Language = nullptr;
     std::filesystem::path m_FilePath;
     bool m_Modified = false;
     
-    // Tree-sitter read callback
+    std::deque<LineShift> m_LineShifts;
+    uint64_t m_LineShiftsFrom = 0;  // Version before the oldest shift kept
+    uint64_t m_LineVersion = 0;
+    void PushLineShift(const LineShift& shift);
+    void ResetLineShifts();
+    
+    // Tree-sitter read callback; payload is the Rope being parsed
     static const char* TSRead(void* payload, uint32_t byteOffset, TSPoint position, uint32_t* bytesRead);
+    static TSInput MakeInput(const Rope& rope);
     
     void ReleaseTree();
-    HighlightGroup MapNodeTypeToHighlight(const char* nodeType) const;
+    void ParseEdited(std::span<const Rope::EditInfo> edits);
+    // The server's view of edits about to be applied, last first so each
+    // range holds in the text before the batch; empty when no server follows
+    // the buffer
+    std::vector<LSPTextChange> ChangesFor(std::span<const Rope::Edit> edits) const;
+    void NotifyChanged(const std::vector<LSPTextChange>& changes);
 };
 
 // Language registry
@@ -213,9 +444,9 @@ public:
     LanguageRegistry& operator=(const LanguageRegistry&) = delete;
     
     void RegisterLanguage(std::unique_ptr<Language> lang);
+    // Lookups load the language they return
     const Language* GetLanguageForFile(const std::filesystem::path& path) const;
     const Language* GetLanguageByName(const std::string& name) const;
-    const std::vector<std::unique_ptr<Language>>& GetLanguages() const { return m_Languages; }
     
     // Initialize built-in languages
     void InitializeBuiltins();
@@ -224,6 +455,9 @@ private:
     LanguageRegistry() = default;
     ~LanguageRegistry() = default;
     
+    void AddBuiltin(std::string name, std::vector<std::string> extensions, Language::Loader load);
+    static const Language* Loaded(Language& language);
+    
     std::vector<std::unique_ptr<Language>> m_Languages;
 };
 
@@ -0,0 +1,438 @@
+#include "text_scan.h"
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+    #define SOL_SCAN_X86 1
+    #include <immintrin.h>
+    #if defined(_MSC_VER) && !defined(__clang__)
+        #include <intrin.h>
+    #endif
+#elif defined(__aarch64__) || defined(_M_ARM64)
+    #define SOL_SCAN_NEON 1
+    #include <arm_neon.h>
+#endif
+
+// GCC/Clang can emit AVX2 for a single function and pick it at runtime;
+// MSVC only gets it when the whole build targets AVX2
+#if defined(SOL_SCAN_X86) && (defined(__GNUC__) || defined(__clang__))
+    #define SOL_SCAN_AVX2 1
+    #define SOL_AVX2_FN __attribute__((target("avx2,popcnt")))
+#elif defined(SOL_SCAN_X86) && defined(__AVX2__)
+    #define SOL_SCAN_AVX2 1
+    #define SOL_AVX2_FN
+#endif
+
+namespace sol {
+
+namespace {
+
+inline bool IsLead(unsigned char c) { return (c & 0xC0) != 0x80; }
+
+void ScanScalar(const char* p, size_t n, TextScanResult& r) {
+    for (size_t i = 0; i < n; ++i) {
+        unsigned char c = static_cast<unsigned char>(p[i]);
+        r.newlines += c == '\n';
+        r.codepoints += IsLead(c);
+        r.utf16 += IsLead(c) + (c >= 0xF0);
+    }
+}
+
+inline unsigned CountTrailingZeros(uint32_t v) {
+#if defined(_MSC_VER) && !defined(__clang__)
+    unsigned long idx;
+    _BitScanForward(&idx, v);
+    return idx;
+#else
+    return static_cast<unsigned>(__builtin_ctz(v));
+#endif
+}
+
+inline unsigned PopCount(uint32_t v) {
+#if defined(_MSC_VER) && !defined(__clang__)
+    return __popcnt(v);
+#else
+    return static_cast<unsigned>(__builtin_popcount(v));
+#endif
+}
+
+inline bool EqualFolded(const char* p, std::string_view needle) {
+    for (size_t i = 0; i < needle.length(); ++i) {
+        if (FoldAscii(p[i]) != needle[i]) return false;
+    }
+    return true;
+}
+
+// OR-ing 0x20 into a byte maps exactly 'A'..'Z' onto 'a'..'z' for comparison
+// against a lowercase letter; other needle bytes are compared unchanged
+inline char CaseBit(char c) { return c >= 'a' && c <= 'z' ? 0x20 : 0; }
+
+// Continuation bytes are 0x80..0xBF, i.e. -128..-65 as signed bytes, so
+// leads are the bytes greater than -65. 4-byte leads are 0xF0..0xFF, tested
+// unsigned as max(v, 0xF0) == v.
+constexpr char LEAD_ABOVE = -65;
+constexpr char FOUR_BYTE_LEAD = static_cast<char>(0xF0);
+
+#if defined(SOL_SCAN_X86)
+
+inline size_t SumBytes(__m128i acc) {
+    __m128i sums = _mm_sad_epu8(acc, _mm_setzero_si128());
+    return static_cast<size_t>(_mm_cvtsi128_si32(sums)) + static_cast<size_t>(_mm_extract_epi16(sums, 4));
+}
+
+size_t ScanSSE2(const char* p, size_t n, TextScanResult& r) {
+    const __m128i nl = _mm_set1_epi8('\n');
+    const __m128i lead = _mm_set1_epi8(LEAD_ABOVE);
+    const __m128i four = _mm_set1_epi8(FOUR_BYTE_LEAD);
+    size_t i = 0;
+    while (n - i >= 16) {
+        // Byte counters overflow after 255 blocks
+        size_t blocks = std::min<size_t>((n - i) / 16, 255);
+        __m128i accNl = _mm_setzero_si128(), accLead = _mm_setzero_si128(), accFour = _mm_setzero_si128();
+        for (size_t b = 0; b < blocks; ++b, i += 16) {
+            __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + i));
+            accNl = _mm_sub_epi8(accNl, _mm_cmpeq_epi8(v, nl));
+            accLead = _mm_sub_epi8(accLead, _mm_cmpgt_epi8(v, lead));
+            accFour = _mm_sub_epi8(accFour, _mm_cmpeq_epi8(_mm_max_epu8(v, four), v));
+        }
+        size_t leads = SumBytes(accLead);
+        r.newlines += SumBytes(accNl);
+        r.codepoints += leads;
+        r.utf16 += leads + SumBytes(accFour);
+    }
+    return i;
+}
+
+// Vectorized filter on the first and last needle byte, then a full compare
+// of each candidate. Returns true with i at the match, or false with i where
+// the scalar tail should resume.
+bool FindFoldedSSE2(const char* p, size_t n, std::string_view needle, size_t& i) {
+    const size_t span = needle.length() - 1;
+    const __m128i first = _mm_set1_epi8(needle.front()), firstCase = _mm_set1_epi8(CaseBit(needle.front()));
+    const __m128i last = _mm_set1_epi8(needle.back()), lastCase = _mm_set1_epi8(CaseBit(needle.back()));
+    for (; n - i >= span + 16; i += 16) {
+        __m128i a = _mm_or_si128(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p + i)), firstCase);
+        __m128i b = _mm_or_si128(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p + i + span)), lastCase);
+        uint32_t mask = static_cast<uint32_t>(_mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(a, first), _mm_cmpeq_epi8(b, last))));
+        for (; mask; mask &= mask - 1) {
+            size_t at = i + CountTrailingZeros(mask);
+            if (EqualFolded(p + at, needle)) {
+                i = at;
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+uint32_t NewlineMaskSSE2(const char* p) {
+    __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+    return static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(v, _mm_set1_epi8('\n'))));
+}
+
+// Bytes below 0x20 are those unchanged by an unsigned min with 0x1F
+uint32_t ControlMaskSSE2(const char* p) {
+    __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+    return static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_min_epu8(v, _mm_set1_epi8(0x1F)), v)));
+}
+
+#endif
+
+#if defined(SOL_SCAN_AVX2)
+
+SOL_AVX2_FN inline size_t SumBytes256(__m256i acc) {
+    __m256i sums = _mm256_sad_epu8(acc, _mm256_setzero_si256());
+    __m128i folded = _mm_add_epi64(_mm256_castsi256_si128(sums), _mm256_extracti128_si256(sums, 1));
+    return static_cast<size_t>(_mm_cvtsi128_si32(folded)) + static_cast<size_t>(_mm_extract_epi16(folded, 4));
+}
+
+SOL_AVX2_FN size_t ScanAVX2(const char* p, size_t n, TextScanResult& r) {
+    const __m256i nl = _mm256_set1_epi8('\n');
+    const __m256i lead = _mm256_set1_epi8(LEAD_ABOVE);
+    const __m256i four = _mm256_set1_epi8(FOUR_BYTE_LEAD);
+    size_t i = 0;
+    while (n - i >= 32) {
+        size_t blocks = std::min<size_t>((n - i) / 32, 255);
+        __m256i accNl = _mm256_setzero_si256(), accLead = _mm256_setzero_si256(), accFour = _mm256_setzero_si256();
+        for (size_t b = 0; b < blocks; ++b, i += 32) {
+            __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + i));
+            accNl = _mm256_sub_epi8(accNl, _mm256_cmpeq_epi8(v, nl));
+            accLead = _mm256_sub_epi8(accLead, _mm256_cmpgt_epi8(v, lead));
+            accFour = _mm256_sub_epi8(accFour, _mm256_cmpeq_epi8(_mm256_max_epu8(v, four), v));
+        }
+        size_t leads = SumBytes256(accLead);
+        r.newlines += SumBytes256(accNl);
+        r.codepoints += leads;
+        r.utf16 += leads + SumBytes256(accFour);
+    }
+    return i;
+}
+
+SOL_AVX2_FN size_t CountNewlinesAVX2(const char* p, size_t n, size_t& count) {
+    const __m256i nl = _mm256_set1_epi8('\n');
+    size_t i = 0;
+    while (n - i >= 32) {
+        size_t blocks = std::min<size_t>((n - i) / 32, 255);
+        __m256i acc = _mm256_setzero_si256();
+        for (size_t b = 0; b < blocks; ++b, i += 32) {
+            __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + i));
+            acc = _mm256_sub_epi8(acc, _mm256_cmpeq_epi8(v, nl));
+        }
+        count += SumBytes256(acc);
+    }
+    return i;
+}
+
+SOL_AVX2_FN bool FindFoldedAVX2(const char* p, size_t n, std::string_view needle, size_t& i) {
+    const size_t span = needle.length() - 1;
+    const __m256i first = _mm256_set1_epi8(needle.front()), firstCase = _mm256_set1_epi8(CaseBit(needle.front()));
+    const __m256i last = _mm256_set1_epi8(needle.back()), lastCase = _mm256_set1_epi8(CaseBit(needle.back()));
+    for (; n - i >= span + 32; i += 32) {
+        __m256i a = _mm256_or_si256(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + i)), firstCase);
+        __m256i b = _mm256_or_si256(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + i + span)), lastCase);
+        uint32_t mask = static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_and_si256(_mm256_cmpeq_epi8(a, first), _mm256_cmpeq_epi8(b, last))));
+        for (; mask; mask &= mask - 1) {
+            size_t at = i + CountTrailingZeros(mask);
+            if (EqualFolded(p + at, needle)) {
+                i = at;
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+SOL_AVX2_FN bool FindControlAVX2(const char* p, size_t n, size_t& i) {
+    const __m256i limit = _mm256_set1_epi8(0x1F);
+    for (; n - i >= 32; i += 32) {
+        __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + i));
+        uint32_t mask = static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_min_epu8(v, limit), v)));
+        if (mask) {
+            i += CountTrailingZeros(mask);
+            return true;
+        }
+    }
+    return false;
+}
+
+bool HasAVX2() {
+#if defined(__AVX2__)
+    return true;
+#elif defined(__GNUC__) || defined(__clang__)
+    static const bool supported = __builtin_cpu_supports("avx2") && __builtin_cpu_supports("popcnt");
+    return supported;
+#else
+    return false;
+#endif
+}
+
+#endif
+
+#if defined(SOL_SCAN_NEON)
+
+inline uint8x16_t LeadMask(uint8x16_t v) {
+    return vmvnq_u8(vceqq_u8(vandq_u8(v, vdupq_n_u8(0xC0)), vdupq_n_u8(0x80)));
+}
+
+size_t ScanNEON(const char* p, size_t n, TextScanResult& r) {
+    const uint8x16_t nl = vdupq_n_u8('\n');
+    const uint8x16_t four = vdupq_n_u8(0xF0);
+    size_t i = 0;
+    while (n - i >= 16) {
+        size_t blocks = std::min<size_t>((n - i) / 16, 255);
+        uint8x16_t accNl = vdupq_n_u8(0), accLead = vdupq_n_u8(0), accFour = vdupq_n_u8(0);
+        for (size_t b = 0; b < blocks; ++b, i += 16) {
+            uint8x16_t v = vld1q_u8(reinterpret_cast<const uint8_t*>(p + i));
+            accNl = vsubq_u8(accNl, vceqq_u8(v, nl));
+            accLead = vsubq_u8(accLead, LeadMask(v));
+            accFour = vsubq_u8(accFour, vcgeq_u8(v, four));
+        }
+        size_t leads = vaddlvq_u8(accLead);
+        r.newlines += vaddlvq_u8(accNl);
+        r.codepoints += leads;
+        r.utf16 += leads + vaddlvq_u8(accFour);
+    }
+    return i;
+}
+
+inline unsigned CountTrailingZeros64(uint64_t v) {
+#if defined(_MSC_VER) && !defined(__clang__)
+    unsigned long idx;
+    _BitScanForward64(&idx, v);
+    return idx;
+#else
+    return static_cast<unsigned>(__builtin_ctzll(v));
+#endif
+}
+
+bool FindFoldedNEON(const char* p, size_t n, std::string_view needle, size_t& i) {
+    const size_t span = needle.length() - 1;
+    const uint8x16_t first = vdupq_n_u8(static_cast<uint8_t>(needle.front()));
+    const uint8x16_t firstCase = vdupq_n_u8(static_cast<uint8_t>(CaseBit(needle.front())));
+    const uint8x16_t last = vdupq_n_u8(static_cast<uint8_t>(needle.back()));
+    const uint8x16_t lastCase = vdupq_n_u8(static_cast<uint8_t>(CaseBit(needle.back())));
+    for (; n - i >= span + 16; i += 16) {
+        uint8x16_t a = vorrq_u8(vld1q_u8(reinterpret_cast<const uint8_t*>(p + i)), firstCase);
+        uint8x16_t b = vorrq_u8(vld1q_u8(reinterpret_cast<const uint8_t*>(p + i + span)), lastCase);
+        uint8x16_t hits = vandq_u8(vceqq_u8(a, first), vceqq_u8(b, last));
+        // Four bits per byte
+        uint64_t mask = vget_lane_u64(vreinterpret_u64_u8(vshrn_n_u16(vreinterpretq_u16_u8(hits), 4)), 0);
+        while (mask) {
+            unsigned bit = CountTrailingZeros64(mask);
+            mask &= ~(uint64_t{0xF} << bit);
+            size_t at = i + bit / 4;
+            if (EqualFolded(p + at, needle)) {
+                i = at;
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+// One bit per byte of a comparison result, packed into 16 bits
+inline uint32_t MoveMaskNEON(uint8x16_t hits) {
+    static const uint8_t bits[16] = {1, 2, 4, 8, 16, 32, 64, 128, 1, 2, 4, 8, 16, 32, 64, 128};
+    uint8x16_t m = vandq_u8(hits, vld1q_u8(bits));
+    uint32_t lo = vaddv_u8(vget_low_u8(m));
+    uint32_t hi = vaddv_u8(vget_high_u8(m));
+    return lo | (hi << 8);
+}
+
+uint32_t NewlineMaskNEON(const char* p) {
+    uint8x16_t v = vld1q_u8(reinterpret_cast<const uint8_t*>(p));
+    return MoveMaskNEON(vceqq_u8(v, vdupq_n_u8('\n')));
+}
+
+uint32_t ControlMaskNEON(const char* p) {
+    uint8x16_t v = vld1q_u8(reinterpret_cast<const uint8_t*>(p));
+    return MoveMaskNEON(vcltq_u8(v, vdupq_n_u8(0x20)));
+}
+
+#endif
+
+// 16-byte newline and control bitmasks on every vector target
+#if defined(SOL_SCAN_X86)
+inline uint32_t NewlineMask16(const char* p) { return NewlineMaskSSE2(p); }
+inline uint32_t ControlMask16(const char* p) { return ControlMaskSSE2(p); }
+#define SOL_SCAN_MASK16 1
+#elif defined(SOL_SCAN_NEON)
+inline uint32_t NewlineMask16(const char* p) { return NewlineMaskNEON(p); }
+inline uint32_t ControlMask16(const char* p) { return ControlMaskNEON(p); }
+#define SOL_SCAN_MASK16 1
+#endif
+
+} // namespace
+
+TextScanResult ScanText(std::string_view text) {
+    TextScanResult r;
+    const char* p = text.data();
+    size_t n = text.length();
+    size_t done = 0;
+#if defined(SOL_SCAN_AVX2)
+    if (HasAVX2()) done = ScanAVX2(p, n, r);
+#endif
+#if defined(SOL_SCAN_X86)
+    done += ScanSSE2(p + done, n - done, r);
+#elif defined(SOL_SCAN_NEON)
+    done += ScanNEON(p + done, n - done, r);
+#endif
+    ScanScalar(p + done, n - done, r);
+    return r;
+}
+
+size_t CountNewlines(std::string_view text) {
+    const char* p = text.data();
+    size_t n = text.length();
+    size_t count = 0;
+    size_t i = 0;
+#if defined(SOL_SCAN_AVX2)
+    if (HasAVX2()) i = CountNewlinesAVX2(p, n, count);
+#endif
+#if defined(SOL_SCAN_MASK16)
+    for (; n - i >= 16; i += 16) count += PopCount(NewlineMask16(p + i));
+#endif
+    for (; i < n; ++i) count += p[i] == '\n';
+    return count;
+}
+
+size_t FindNthNewline(std::string_view text, size_t n) {
+    if (n == 0) return std::string_view::npos;
+    const char* p = text.data();
+    size_t len = text.length();
+    size_t i = 0;
+#if defined(SOL_SCAN_MASK16)
+    for (; len - i >= 16; i += 16) {
+        uint32_t mask = NewlineMask16(p + i);
+        size_t count = PopCount(mask);
+        if (count < n) {
+            n -= count;
+            continue;
+        }
+        while (--n > 0) mask &= mask - 1;
+        return i + CountTrailingZeros(mask);
+    }
+#endif
+    for (; i < len; ++i) {
+        if (p[i] == '\n' && --n == 0) return i;
+    }
+    return std::string_view::npos;
+}
+
+void AppendLineStarts(std::string_view text, size_t base, std::vector<size_t>& out) {
+    const char* p = text.data();
+    size_t len = text.length();
+    size_t i = 0;
+#if defined(SOL_SCAN_MASK16)
+    for (; len - i >= 16; i += 16) {
+        for (uint32_t mask = NewlineMask16(p + i); mask; mask &= mask - 1) {
+            out.push_back(base + i + CountTrailingZeros(mask) + 1);
+        }
+    }
+#endif
+    for (; i < len; ++i) {
+        if (p[i] == '\n') out.push_back(base + i + 1);
+    }
+}
+
+size_t FindControl(std::string_view text) {
+    const char* p = text.data();
+    size_t n = text.length();
+    size_t i = 0;
+#if defined(SOL_SCAN_AVX2)
+    if (HasAVX2() && FindControlAVX2(p, n, i)) return i;
+#endif
+#if defined(SOL_SCAN_MASK16)
+    for (; n - i >= 16; i += 16) {
+        uint32_t mask = ControlMask16(p + i);
+        if (mask) return i + CountTrailingZeros(mask);
+    }
+#endif
+    for (; i < n; ++i) {
+        if (static_cast<unsigned char>(p[i]) < 0x20) return i;
+    }
+    return std::string_view::npos;
+}
+
+size_t FindFolded(std::string_view text, std::string_view needle) {
+    if (needle.empty()) return 0;
+    if (text.length() < needle.length()) return std::string_view::npos;
+    const char* p = text.data();
+    size_t n = text.length();
+    size_t i = 0;
+#if defined(SOL_SCAN_AVX2)
+    if (HasAVX2() && FindFoldedAVX2(p, n, needle, i)) return i;
+#endif
+#if defined(SOL_SCAN_X86)
+    if (FindFoldedSSE2(p, n, needle, i)) return i;
+#elif defined(SOL_SCAN_NEON)
+    if (FindFoldedNEON(p, n, needle, i)) return i;
+#endif
+    for (; n - i >= needle.length(); ++i) {
+        if (EqualFolded(p + i, needle)) return i;
+    }
+    return std::string_view::npos;
+}
+
+} // namespace sol
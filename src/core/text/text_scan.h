@@ -0,0 +1,35 @@
+#pragma once
+
+#include <string_view>
+#include <vector>
+#include <cstddef>
+
+namespace sol {
+
+// Vectorized byte scanning behind every line and Unicode metric.
+// Uses AVX2 (selected at runtime), SSE2 or NEON, with a scalar fallback.
+struct TextScanResult {
+    size_t newlines = 0;
+    size_t codepoints = 0;  // UTF-8 lead bytes
+    size_t utf16 = 0;       // Code units; 4-byte sequences count twice
+};
+
+TextScanResult ScanText(std::string_view text);
+size_t CountNewlines(std::string_view text);
+
+// Index of the n-th newline (1-based), or npos if text has fewer
+size_t FindNthNewline(std::string_view text, size_t n);
+
+// Appends base + i + 1 for every newline at index i
+void AppendLineStarts(std::string_view text, size_t base, std::vector<size_t>& out);
+
+// Index of the first C0 control byte (below 0x20, ESC among them), or npos
+size_t FindControl(std::string_view text);
+
+inline char FoldAscii(char c) { return c >= 'A' && c <= 'Z' ? static_cast<char>(c + ('a' - 'A')) : c; }
+
+// Index of the first occurrence of needle in text ignoring ASCII case, or
+// npos. needle must already be folded with FoldAscii.
+size_t FindFolded(std::string_view text, std::string_view needle);
+
+} // namespace sol
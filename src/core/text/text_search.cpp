@@ -0,0 +1,236 @@
+#include "text_search.h"
+#include "text_scan.h"
+#include "core/cancellation.h"
+#include "core/job_system.h"
+#include "core/parallel.h"
+#include <algorithm>
+#include <atomic>
+
+namespace sol {
+
+namespace {
+
+// Texts up to this size are searched in one go on the calling thread
+constexpr size_t SYNC_SEARCH_LIMIT = 1024 * 1024;
+// Bytes a background regex scan covers between cancellation checks
+constexpr size_t CANCEL_BLOCK = 256 * 1024;
+// Bytes a worker scans for a literal at a time in the background
+constexpr size_t PARALLEL_SCAN_BLOCK = 1024 * 1024;
+
+using Found = std::vector<std::pair<size_t, size_t>>;
+
+// Appends every match of the literal beginning in [begin, end), including
+// overlapping ones; false when cancelled first
+bool Scan(const Rope& text, std::string_view query, size_t begin, size_t end,
+          Found& out, std::string& seam, const CancellationToken& cancel) {
+    constexpr size_t npos = std::string_view::npos;
+    const size_t keep = query.length() - 1;
+    size_t base = begin;
+    bool finished = true;
+    seam.clear();
+    text.ForEachChunk(begin, end + keep, [&](std::string_view chunk) {
+        if (cancel.IsCancelled()) return finished = false;
+
+        // seam holds the last keep bytes before this chunk; a match starting
+        // there is too long to have been found already
+        if (!seam.empty()) {
+            const size_t tail = seam.length();
+            seam.append(chunk.substr(0, keep));
+            std::string_view joined = seam;
+            for (size_t from = 0, hit; (hit = FindFolded(joined.substr(from), query)) != npos && from + hit < tail;
+                 from += hit + 1) {
+                const size_t start = base - tail + from + hit;
+                out.emplace_back(start, start + query.length());
+            }
+            seam.resize(tail);
+        }
+        for (size_t from = 0, hit; (hit = FindFolded(chunk.substr(from), query)) != npos; from += hit + 1) {
+            out.emplace_back(base + from + hit, base + from + hit + query.length());
+        }
+
+        if (chunk.length() >= keep) {
+            seam.assign(chunk.substr(chunk.length() - keep));
+        } else {
+            seam.append(chunk);
+            if (seam.length() > keep) seam.erase(0, seam.length() - keep);
+        }
+        base += chunk.length();
+        return true;
+    });
+    return finished;
+}
+
+bool ScanRegex(const Rope& text, RegexMatcher& matcher, size_t begin, size_t end,
+               Found& out, const CancellationToken& cancel) {
+    while (begin < end) {
+        if (cancel.IsCancelled()) return false;
+        const size_t blockEnd = std::min(end, begin + CANCEL_BLOCK);
+        size_t next = blockEnd;
+        matcher.ForEach(text, begin, blockEnd, [&](RegexMatcher::Match match) {
+            out.emplace_back(match.start, match.end);
+            next = std::max(next, match.end);
+            return true;
+        });
+        begin = next;
+    }
+    return true;
+}
+
+void AppendBlocks(size_t begin, size_t end, std::vector<std::pair<size_t, size_t>>& out) {
+    for (; begin < end; begin += PARALLEL_SCAN_BLOCK) out.emplace_back(begin, std::min(end, begin + PARALLEL_SCAN_BLOCK));
+}
+
+bool MatchesAt(const Rope& text, size_t pos, std::string_view query) {
+    if (pos + query.length() > text.Length()) return false;
+    size_t i = 0;
+    bool equal = true;
+    text.ForEachChunk(pos, pos + query.length(), [&](std::string_view chunk) {
+        for (char c : chunk) {
+            if (FoldAscii(c) != query[i++]) return equal = false;
+        }
+        return true;
+    });
+    return equal;
+}
+
+} // namespace
+
+struct TextSearch::Pass {
+    Rope text;
+    std::string query;
+    std::shared_ptr<const Regex> regex;
+    size_t windowStart = 0;  // The window itself was scanned by Start
+    size_t windowEnd = 0;
+    Found found;
+    CancellationSource cancel;
+    std::atomic<bool> done{false};
+};
+
+TextSearch::~TextSearch() {
+    Cancel();
+}
+
+void TextSearch::Start(const Rope& text, std::string_view query, bool regex, size_t windowStart, size_t windowEnd) {
+    const size_t previous = m_Query.length();
+    bool extends = !regex && !m_Regex && IsComplete() && previous > 0 && query.length() > previous &&
+                   text.SharesText(m_Text);
+    for (size_t i = 0; extends && i < previous; ++i) extends = FoldAscii(query[i]) == m_Query[i];
+
+    m_Query.clear();
+    for (char c : query) m_Query.push_back(FoldAscii(c));
+
+    if (extends) {
+        std::string_view added = std::string_view(m_Query).substr(previous);
+        std::erase_if(m_Found, [&](auto& match) { return !MatchesAt(m_Text, match.first + previous, added); });
+        for (auto& match : m_Found) match.second = match.first + m_Query.length();
+        Publish();
+        return;
+    }
+
+    Cancel();
+    m_Text = text.Snapshot();
+    m_Found.clear();
+    m_Error.clear();
+    m_Regex = nullptr;
+    if (regex && !m_Query.empty()) {
+        m_Regex = Regex::Compile(query, true, m_Error);
+        if (!m_Regex) m_Query.clear();
+    }
+    if (!m_Query.empty()) {
+        const size_t length = m_Text.Length();
+        if (length <= SYNC_SEARCH_LIMIT) {
+            windowStart = 0;
+            windowEnd = length;
+        }
+        windowStart = std::min(windowStart, length);
+        windowEnd = std::clamp(windowEnd, windowStart, length);
+        if (m_Regex) {
+            RegexMatcher matcher(m_Regex);
+            ScanRegex(m_Text, matcher, windowStart, windowEnd, m_Found, {});
+        } else {
+            Scan(m_Text, m_Query, windowStart, windowEnd, m_Found, m_Seam, {});
+        }
+
+        if (windowStart > 0 || windowEnd < length) {
+            auto pass = std::make_shared<Pass>();
+            pass->text = m_Text;
+            pass->query = m_Query;
+            pass->regex = m_Regex;
+            pass->windowStart = windowStart;
+            pass->windowEnd = windowEnd;
+            m_Pending = pass;
+            JobSystem::Submit(JobPriority::Interactive, pass->cancel.Token(), [pass] {
+                const size_t length = pass->text.Length();
+                const CancellationToken cancel = pass->cancel.Token();
+                bool finished;
+                if (pass->regex) {
+                    RegexMatcher matcher(pass->regex);
+                    finished = ScanRegex(pass->text, matcher, 0, pass->windowStart, pass->found, cancel) &&
+                               ScanRegex(pass->text, matcher, pass->windowEnd, length, pass->found, cancel);
+                } else {
+                    // Blocks are scanned independently, matches running past
+                    // a block's end included, and concatenated in order
+                    std::vector<std::pair<size_t, size_t>> blocks;
+                    AppendBlocks(0, pass->windowStart, blocks);
+                    AppendBlocks(pass->windowEnd, length, blocks);
+                    auto scan = [&](size_t first, size_t last) {
+                        Found found;
+                        std::string seam;
+                        for (size_t i = first; i < last; ++i) {
+                            if (!Scan(pass->text, pass->query, blocks[i].first, blocks[i].second, found, seam, cancel)) break;
+                        }
+                        return found;
+                    };
+                    auto concat = [](Found a, Found b) {
+                        a.insert(a.end(), b.begin(), b.end());
+                        return a;
+                    };
+                    pass->found = ParallelReduce(0, blocks.size(), 1, Found(), scan, concat);
+                    finished = !cancel.IsCancelled();
+                }
+                if (finished) pass->done.store(true, std::memory_order_release);
+            });
+        }
+    }
+    Publish();
+}
+
+void TextSearch::Clear() {
+    Cancel();
+    m_Text = Rope();
+    m_Query.clear();
+    m_Regex = nullptr;
+    m_Error.clear();
+    m_Found.clear();
+    m_Matches.clear();
+    m_Ends.clear();
+}
+
+bool TextSearch::Poll() {
+    if (!m_Pending || !m_Pending->done.load(std::memory_order_acquire)) return false;
+    const Found& found = m_Pending->found;
+    auto split = std::lower_bound(found.begin(), found.end(), std::make_pair(m_Pending->windowStart, size_t{0}));
+    m_Found.insert(m_Found.begin(), found.begin(), split);
+    m_Found.insert(m_Found.end(), split, found.end());
+    m_Pending.reset();
+    Publish();
+    return true;
+}
+
+void TextSearch::Cancel() {
+    if (!m_Pending) return;
+    m_Pending->cancel.Cancel();
+    m_Pending.reset();
+}
+
+void TextSearch::Publish() {
+    m_Matches.clear();
+    m_Ends.clear();
+    for (const auto& [start, end] : m_Found) {
+        if (!m_Ends.empty() && start < m_Ends.back()) continue;
+        m_Matches.push_back(start);
+        m_Ends.push_back(end);
+    }
+}
+
+} // namespace sol
@@ -0,0 +1,56 @@
+#pragma once
+
+#include "regex.h"
+#include "rope.h"
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace sol {
+
+// Search ignoring ASCII case for a literal or a Regex, streamed over rope
+// chunks without copying the text. Start scans a window (the visible lines)
+// on the calling thread and the rest of a snapshot on the JobSystem; Poll
+// merges that in. A literal extending the previous one over unchanged text
+// only rechecks the earlier matches.
+class TextSearch {
+public:
+    TextSearch() = default;
+    ~TextSearch();
+
+    TextSearch(const TextSearch&) = delete;
+    TextSearch& operator=(const TextSearch&) = delete;
+
+    void Start(const Rope& text, std::string_view query, bool regex, size_t windowStart, size_t windowEnd);
+    void Clear();
+    // Merges a finished background scan; true when Matches changed
+    bool Poll();
+
+    bool IsComplete() const { return !m_Pending; }
+    // Why the query is not a valid regex, empty otherwise
+    const std::string& Error() const { return m_Error; }
+    // Non-overlapping match offsets in text order
+    const std::vector<size_t>& Matches() const { return m_Matches; }
+    size_t MatchEnd(size_t index) const { return m_Ends[index]; }
+
+private:
+    struct Pass;
+
+    void Cancel();
+    void Publish();
+
+    Rope m_Text;
+    std::string m_Query;           // Folded literal
+    std::shared_ptr<const Regex> m_Regex;
+    std::string m_Error;
+    // Every match found, in order; for a literal overlapping ones included
+    std::vector<std::pair<size_t, size_t>> m_Found;
+    std::vector<size_t> m_Matches;
+    std::vector<size_t> m_Ends;
+    std::string m_Seam;            // Scratch for matches spanning chunks
+    std::shared_ptr<Pass> m_Pending;
+};
+
+} // namespace sol
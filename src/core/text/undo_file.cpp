@@ -0,0 +1,85 @@
+#include "undo_file.h"
+#include "core/job_system.h"
+#include "core/logger.h"
+#include "core/utils/hash.h"
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+
+namespace sol {
+
+std::filesystem::path UndoFile::PathFor(const std::filesystem::path& file) {
+    const char* home = std::getenv("HOME");
+    if (!home) home = "~";
+    
+    std::error_code ec;
+    auto absolute = std::filesystem::absolute(file, ec);
+    char name[32];
+    std::snprintf(name, sizeof(name), "%016llx.undo",
+                  static_cast<unsigned long long>(StreamHash::Of((ec ? file : absolute).string())));
+    return std::filesystem::path(home) / ".sol" / "undo" / name;
+}
+
+void UndoFile::Write(std::string records, bool rewrite) {
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        m_Queue.push_back({std::move(records), rewrite});
+        if (m_Scheduled) return;
+        m_Scheduled = true;
+    }
+    
+    auto self = shared_from_this();
+    JobSystem::Submit(JobPriority::Background, [self] {
+        self->Drain();
+    });
+}
+
+void UndoFile::WaitIdle() {
+    std::unique_lock<std::mutex> lock(m_Mutex);
+    m_Idle.wait(lock, [this] { return !m_Scheduled; });
+}
+
+void UndoFile::Drain() {
+    while (true) {
+        PendingWrite write;
+        {
+            std::lock_guard<std::mutex> lock(m_Mutex);
+            if (m_Queue.empty()) {
+                m_Scheduled = false;
+                m_Idle.notify_all();
+                return;
+            }
+            write = std::move(m_Queue.front());
+            m_Queue.pop_front();
+        }
+        
+        bool ok = write.rewrite ? Replace(write.records) : Append(write.records);
+        if (!ok) {
+            Logger::Error("Failed to write undo history: ", m_Path);
+        }
+    }
+}
+
+bool UndoFile::Replace(const std::string& records) const {
+    std::error_code ec;
+    std::filesystem::create_directories(m_Path.parent_path(), ec);
+    
+    auto temp = m_Path;
+    temp += ".tmp";
+    {
+        std::ofstream out(temp, std::ios::binary | std::ios::trunc);
+        out.write(MAGIC, sizeof(MAGIC));
+        out.write(records.data(), static_cast<std::streamsize>(records.size()));
+        if (!out) return false;
+    }
+    std::filesystem::rename(temp, m_Path, ec);
+    return !ec;
+}
+
+bool UndoFile::Append(const std::string& records) const {
+    std::ofstream out(m_Path, std::ios::binary | std::ios::app);
+    out.write(records.data(), static_cast<std::streamsize>(records.size()));
+    return static_cast<bool>(out);
+}
+
+} // namespace sol
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <string>
+
+namespace sol {
+
+// Background writer for a persistent undo history ("undofile").
+// Layout: HEADER then append-only records in native byte order; see
+// UndoTree for the record encoding. Writes are queued and applied in order
+// on a JobSystem worker, so saving a buffer never waits on disk.
+class UndoFile : public std::enable_shared_from_this<UndoFile> {
+public:
+    static constexpr char MAGIC[8] = {'S', 'O', 'L', 'U', 'N', 'D', 'O', '1'};
+    static constexpr size_t HEADER_SIZE = sizeof(MAGIC);
+    
+    // ~/.sol/undo/<hash of the absolute path>.undo
+    static std::filesystem::path PathFor(const std::filesystem::path& file);
+    
+    explicit UndoFile(std::filesystem::path path) : m_Path(std::move(path)) {}
+    
+    const std::filesystem::path& GetPath() const { return m_Path; }
+    
+    // Appends records, or replaces the whole file atomically when rewrite is set
+    void Write(std::string records, bool rewrite);
+    
+    // Blocks until every queued write has reached the file
+    void WaitIdle();
+    
+private:
+    struct PendingWrite {
+        std::string records;
+        bool rewrite = false;
+    };
+    
+    void Drain();
+    bool Replace(const std::string& records) const;
+    bool Append(const std::string& records) const;
+    
+    std::filesystem::path m_Path;
+    std::mutex m_Mutex;
+    std::condition_variable m_Idle;
+    std::deque<PendingWrite> m_Queue;
+    bool m_Scheduled = false;
+};
+
+} // namespace sol
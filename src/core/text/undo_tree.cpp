@@ -1,60 +1,196 @@
 #include "undo_tree.h"
+#include "undo_file.h"
+#include "edit_session.h"
+#include "core/platform/mapped_file.h"
 #include <algorithm>
+#include <cstring>
 
 namespace sol {
 
+namespace {
+
+// Undofile records: a kind byte followed by the fixed part; node records are
+// then followed by their old and new text. Node indices follow record order,
+// with the root implicit at 0.
+enum RecordKind : uint8_t {
+    NODE_RECORD = 1,
+    STATE_RECORD = 2,
+};
+
+struct NodeRecord {
+    uint32_t parent;
+    uint32_t type;
+    uint64_t position;
+    uint64_t cursorBefore;
+    uint64_t cursorAfter;
+    uint64_t timestamp;
+    uint64_t oldLength;
+    uint64_t newLength;
+};
+
+// Written on every save; the last complete one describes the file
+struct StateRecord {
+    uint32_t nodeCount;
+    uint32_t saved;
+    uint64_t savedTimestamp;
+    uint64_t timestamp;
+    uint64_t contentHash;  // Of the file as saved
+};
+
+template <typename T>
+void AppendRecord(std::string& out, RecordKind kind, const T& record) {
+    out += static_cast<char>(kind);
+    out.append(reinterpret_cast<const char*>(&record), sizeof(record));
+}
+
+// A batch is stored as one text: per part its header, old text and new text
+struct PartHeader {
+    uint64_t position;
+    uint64_t oldLength;
+    uint64_t newLength;
+};
+
+std::string PackParts(const std::vector<EditOperation>& parts) {
+    size_t size = 0;
+    for (const auto& part : parts) size += sizeof(PartHeader) + part.oldText.length() + part.newText.length();
+    std::string packed;
+    packed.reserve(size);
+    for (const auto& part : parts) {
+        PartHeader header{part.position, part.oldText.length(), part.newText.length()};
+        packed.append(reinterpret_cast<const char*>(&header), sizeof(header));
+        packed.append(part.oldText).append(part.newText);
+    }
+    return packed;
+}
+
+std::vector<EditOperation> UnpackParts(std::string_view packed) {
+    std::vector<EditOperation> parts;
+    while (packed.length() >= sizeof(PartHeader)) {
+        PartHeader header;
+        std::memcpy(&header, packed.data(), sizeof(header));
+        packed.remove_prefix(sizeof(header));
+        if (header.oldLength > packed.length() || header.newLength > packed.length() - header.oldLength) break;
+        std::string oldText(packed.substr(0, header.oldLength));
+        std::string newText(packed.substr(header.oldLength, header.newLength));
+        packed.remove_prefix(header.oldLength + header.newLength);
+        parts.push_back(EditOperation::Replace(header.position, oldText, newText, header.position));
+    }
+    return parts;
+}
+
+} // namespace
+
 UndoTree::UndoTree() {
-    // Create a dummy root node
-    m_Root = std::make_shared<UndoNode>(
-        EditOperation{ EditOperation::Type::Insert, 0, "", "", 0, 0 },
-        0
-    );
-    m_Current = m_Root;
+    Clear();
+}
+
+UndoTree::TextRef UndoTree::StoreText(std::string_view text) {
+    TextRef ref{m_DiskBytes + m_Text.size(), text.length()};
+    m_Text.append(text);
+    return ref;
+}
+
+std::string_view UndoTree::GetText(const TextRef& ref) const {
+    if (ref.offset < m_DiskBytes) return std::string_view(m_Disk->Data() + ref.offset, ref.length);
+    return std::string_view(m_Text).substr(ref.offset - m_DiskBytes, ref.length);
+}
+
+EditOperation UndoTree::ToOperation(NodeIndex index) const {
+    const Node& node = m_Nodes[index];
+    if (node.type == EditOperation::Type::Batch) {
+        return EditOperation::Batch(UnpackParts(GetText(node.newText)), node.cursorBefore, node.cursorAfter);
+    }
+    return { node.type, node.position, std::string(GetText(node.oldText)), std::string(GetText(node.newText)),
+             node.cursorBefore, node.cursorAfter };
+}
+
+UndoTree::NodeIndex UndoTree::ChildAt(NodeIndex parent, size_t branch) const {
+    NodeIndex child = m_Nodes[parent].firstChild;
+    while (child != NONE && branch-- > 0) child = m_Nodes[child].nextSibling;
+    return child;
+}
+
+size_t UndoTree::ChildCount(NodeIndex parent) const {
+    size_t count = 0;
+    for (NodeIndex child = m_Nodes[parent].firstChild; child != NONE; child = m_Nodes[child].nextSibling) ++count;
+    return count;
+}
+
+void UndoTree::Link(std::vector<Node>& nodes, NodeIndex parent, NodeIndex child) {
+    Node& p = nodes[parent];
+    nodes[child].parent = parent;
+    if (p.lastChild == NONE) {
+        p.firstChild = child;
+    } else {
+        nodes[p.lastChild].nextSibling = child;
+    }
+    p.lastChild = child;
 }
 
 void UndoTree::Push(const EditOperation& op) {
+    if (m_Session) m_Session->RecordPush(op);
     ++m_Timestamp;
     
-    // Check if we should merge with the previous operation
-    if (ShouldMerge(op) && !m_Current->children.empty()) {
-        // Merge with the last operation
-        auto& lastChild = m_Current->children.back();
-        if (lastChild->operation.type == EditOperation::Type::Insert &&
-            op.type == EditOperation::Type::Insert) {
-            // Merge consecutive inserts
-            lastChild->operation.newText += op.newText;
-            lastChild->operation.cursorAfter = op.cursorAfter;
-            lastChild->timestamp = m_Timestamp;
-            return;
+    // Consecutive typing extends the current node
+    if (ShouldMerge(op)) {
+        Node& current = m_Nodes[m_Current];
+        if (current.newText.offset >= m_DiskBytes &&
+            current.newText.offset + current.newText.length == m_DiskBytes + m_Text.size()) {
+            m_Text.append(op.newText);
+            current.newText.length += op.newText.length();
+        } else {
+            std::string merged(GetText(current.newText));
+            merged += op.newText;
+            current.newText = StoreText(merged);
         }
+        current.cursorAfter = op.cursorAfter;
+        current.timestamp = m_Timestamp;
+        m_LastPush = std::chrono::steady_clock::now();
+        return;
     }
     
-    auto newNode = std::make_shared<UndoNode>(op, m_Timestamp);
-    newNode->parent = m_Current;
-    m_Current->children.push_back(newNode);
-    m_Current = newNode;
+    Node node;
+    node.type = op.type;
+    node.position = op.position;
+    node.cursorBefore = op.cursorBefore;
+    node.cursorAfter = op.cursorAfter;
+    node.oldText = StoreText(op.oldText);
+    node.newText = op.type == EditOperation::Type::Batch ? StoreText(PackParts(op.parts)) : StoreText(op.newText);
+    node.timestamp = m_Timestamp;
+    
+    auto index = static_cast<NodeIndex>(m_Nodes.size());
+    m_Nodes.push_back(node);
+    Link(m_Nodes, m_Current, index);
+    m_Current = index;
     m_CurrentRedoBranch = 0;
+    m_LastPush = std::chrono::steady_clock::now();
+    
+    if (m_MemoryBudget && GetMemoryUsage() > m_MemoryBudget) {
+        Prune();
+    }
 }
 
 std::optional<EditOperation> UndoTree::Undo() {
+    if (m_Current == 0) {
+        LoadDiskHistory();
+    }
     if (!CanUndo()) {
         return std::nullopt;
     }
     
-    EditOperation op = m_Current->operation;
+    EditOperation op = ToOperation(m_Current);
     
     // Find which child index we are in the parent
-    auto parent = m_Current->parent.lock();
-    if (parent) {
-        for (size_t i = 0; i < parent->children.size(); ++i) {
-            if (parent->children[i] == m_Current) {
-                m_CurrentRedoBranch = i;
-                break;
-            }
-        }
+    NodeIndex parent = m_Nodes[m_Current].parent;
+    size_t branch = 0;
+    for (NodeIndex child = m_Nodes[parent].firstChild; child != m_Current; child = m_Nodes[child].nextSibling) {
+        ++branch;
     }
+    m_CurrentRedoBranch = branch;
     
     m_Current = parent;
+    m_LastPush = {};
+    if (m_Session) m_Session->RecordUndo();
     return op;
 }
 
@@ -64,21 +200,25 @@ std::optional<EditOperation> UndoTree::Redo() {
     }
     
     // Ensure branch index is valid for current node
-    if (m_CurrentRedoBranch >= m_Current->children.size()) {
-        m_CurrentRedoBranch = 0;
+    NodeIndex next = ChildAt(m_Current, m_CurrentRedoBranch);
+    if (next == NONE) {
+        next = m_Nodes[m_Current].firstChild;
     }
     
     // Navigate to the current redo branch
-    m_Current = m_Current->children[m_CurrentRedoBranch];
+    m_Current = next;
     
     // Reset branch for next level (default to most recent)
-    m_CurrentRedoBranch = m_Current->children.empty() ? 0 : m_Current->children.size() - 1;
+    size_t count = ChildCount(m_Current);
+    m_CurrentRedoBranch = count == 0 ? 0 : count - 1;
+    m_LastPush = {};
+    if (m_Session) m_Session->RecordRedo();
     
-    return m_Current->operation;
+    return ToOperation(m_Current);
 }
 
 bool UndoTree::GotoBranch(size_t branchIndex) {
-    if (branchIndex >= m_Current->children.size()) {
+    if (branchIndex >= ChildCount(m_Current)) {
         return false;
     }
     m_CurrentRedoBranch = branchIndex;
@@ -86,69 +226,76 @@ bool UndoTree::GotoBranch(size_t branchIndex) {
 }
 
 size_t UndoTree::GetRedoBranchCount() const {
-    return m_Current->children.size();
+    return ChildCount(m_Current);
 }
 
 bool UndoTree::CanUndo() const {
-    return m_Current != m_Root && m_Current->parent.lock() != nullptr;
+    return m_Current != 0;
 }
 
 bool UndoTree::CanRedo() const {
-    return !m_Current->children.empty();
+    return m_Nodes[m_Current].firstChild != NONE;
 }
 
 void UndoTree::Clear() {
-    m_Root = std::make_shared<UndoNode>(
-        EditOperation{ EditOperation::Type::Insert, 0, "", "", 0, 0 },
-        0
-    );
-    m_Current = m_Root;
+    // Root is a dummy node that is never undone
+    m_Nodes.assign(1, Node{});
+    m_Text.clear();
+    ReleaseDisk();
+    m_Current = 0;
     m_Timestamp = 0;
     m_SavedTimestamp = 0;
     m_CurrentRedoBranch = 0;
+    
+    // The start of the history no longer matches the undofile
+    if (m_DiskState == DiskState::Pending) m_DiskState = DiskState::Loaded;
+    m_PersistedNodes = 0;
+    m_RewriteFile = true;
+}
+
+void UndoTree::ReleaseDisk() {
+    m_Disk.reset();
+    m_DiskBytes = 0;
 }
 
 size_t UndoTree::GetUndoCount() const {
     size_t count = 0;
-    auto node = m_Current;
-    while (node && node != m_Root) {
+    for (NodeIndex node = m_Current; node != 0; node = m_Nodes[node].parent) {
         ++count;
-        node = node->parent.lock();
     }
     return count;
 }
 
 size_t UndoTree::GetRedoCount() const {
     size_t count = 0;
-    auto node = m_Current;
-    while (!node->children.empty()) {
-        ++count;
-        node = node->children[0];  // Count along main branch
+    for (NodeIndex node = m_Nodes[m_Current].firstChild; node != NONE; node = m_Nodes[node].firstChild) {
+        ++count;  // Count along main branch
     }
     return count;
 }
 
 void UndoTree::MarkSaved() {
-    m_SavedTimestamp = m_Current ? m_Current->timestamp : 0;
+    m_SavedTimestamp = m_Nodes[m_Current].timestamp;
 }
 
 bool UndoTree::IsModified() const {
-    return m_Current && m_Current->timestamp != m_SavedTimestamp;
+    return m_Nodes[m_Current].timestamp != m_SavedTimestamp;
 }
 
 bool UndoTree::ShouldMerge(const EditOperation& newOp) const {
-    if (m_Current->children.empty()) return false;
+    // Merging into a node with redo children would rewrite those branches
+    if (m_Current == 0 || m_Nodes[m_Current].firstChild != NONE) return false;
     
-    const auto& lastChild = m_Current->children.back();
+    const Node& current = m_Nodes[m_Current];
     
     // Only merge consecutive character inserts
-    if (lastChild->operation.type != EditOperation::Type::Insert ||
+    if (current.type != EditOperation::Type::Insert ||
         newOp.type != EditOperation::Type::Insert) {
         return false;
     }
     
     // Check if insert is right after the previous insert
-    if (newOp.position != lastChild->operation.position + lastChild->operation.newText.length()) {
+    if (newOp.position != current.position + current.newText.length) {
         return false;
     }
     
@@ -157,8 +304,259 @@ bool UndoTree::ShouldMerge(const EditOperation& newOp) const {
         return false;
     }
     
-    // Check time window (simplified - would need actual time tracking)
-    return m_Timestamp - lastChild->timestamp < 10;  // Merge within 10 operations
+    // The saved state must stay addressable
+    if (current.timestamp == m_SavedTimestamp) {
+        return false;
+    }
+    
+    auto elapsed = std::chrono::steady_clock::now() - m_LastPush;
+    return elapsed < std::chrono::milliseconds(m_MergeWindow);
+}
+
+// Keeps the newest history that fits in three quarters of the budget, so
+// pruning runs rarely. The path from the root to the current state is cut
+// from the oldest end; branches off it are kept newest first.
+void UndoTree::Prune() {
+    const size_t target = m_MemoryBudget / 4 * 3;
+    const size_t count = m_Nodes.size();
+    
+    auto ownCost = [this](NodeIndex i) {
+        return sizeof(Node) + m_Nodes[i].oldText.length + m_Nodes[i].newText.length;
+    };
+    
+    // Subtree cost and newest timestamp; children follow their parent
+    std::vector<size_t> subtreeCost(count);
+    std::vector<size_t> newest(count);
+    for (size_t i = count; i-- > 0;) {
+        subtreeCost[i] += ownCost(static_cast<NodeIndex>(i));
+        newest[i] = std::max(newest[i], m_Nodes[i].timestamp);
+        NodeIndex parent = m_Nodes[i].parent;
+        if (parent != NONE) {
+            subtreeCost[parent] += subtreeCost[i];
+            newest[parent] = std::max(newest[parent], newest[i]);
+        }
+    }
+    
+    std::vector<NodeIndex> path;
+    for (NodeIndex node = m_Current; node != NONE; node = m_Nodes[node].parent) path.push_back(node);
+    std::reverse(path.begin(), path.end());
+    
+    // The new root is the oldest path node whose undo steps after it still fit
+    size_t used = sizeof(Node);
+    size_t rootDepth = path.size() - 1;
+    while (rootDepth > 0 && used + ownCost(path[rootDepth]) <= target) {
+        used += ownCost(path[rootDepth]);
+        rootDepth--;
+    }
+    
+    std::vector<uint8_t> onPath(count, 0);
+    std::vector<uint8_t> keep(count, 0);
+    for (size_t d = rootDepth; d < path.size(); ++d) {
+        onPath[path[d]] = 1;
+        keep[path[d]] = 1;
+    }
+    
+    std::vector<NodeIndex> branches;
+    for (size_t d = rootDepth; d < path.size(); ++d) {
+        for (NodeIndex child = m_Nodes[path[d]].firstChild; child != NONE; child = m_Nodes[child].nextSibling) {
+            if (!onPath[child]) branches.push_back(child);
+        }
+    }
+    std::sort(branches.begin(), branches.end(), [&newest](NodeIndex a, NodeIndex b) { return newest[a] > newest[b]; });
+    for (NodeIndex branch : branches) {
+        if (used + subtreeCost[branch] > target) continue;
+        used += subtreeCost[branch];
+        keep[branch] = 1;
+    }
+    for (size_t i = 0; i < count; ++i) {
+        NodeIndex parent = m_Nodes[i].parent;
+        if (!keep[i] && parent != NONE && keep[parent] && !onPath[parent]) keep[i] = 1;
+    }
+    
+    // Rebuild both arrays in index order, which preserves sibling order
+    std::vector<Node> nodes;
+    std::string text;
+    std::vector<NodeIndex> remap(count, NONE);
+    nodes.reserve(count);
+    text.reserve(used);
+    for (size_t i = 0; i < count; ++i) {
+        if (!keep[i]) continue;
+        Node node = m_Nodes[i];
+        bool isRoot = i == path[rootDepth];
+        node.parent = isRoot ? NONE : remap[m_Nodes[i].parent];
+        node.firstChild = node.lastChild = node.nextSibling = NONE;
+        for (TextRef* ref : {&node.oldText, &node.newText}) {
+            if (isRoot) {
+                *ref = {};
+                continue;
+            }
+            size_t offset = text.size();
+            text.append(GetText(*ref));
+            ref->offset = offset;
+        }
+        remap[i] = static_cast<NodeIndex>(nodes.size());
+        nodes.push_back(node);
+        if (node.parent != NONE) {
+            Link(nodes, node.parent, remap[i]);
+        }
+    }
+    
+    if (m_DiskState == DiskState::Pending && path[rootDepth] != 0) {
+        m_DiskState = DiskState::Loaded;
+    }
+    m_Nodes = std::move(nodes);
+    m_Text = std::move(text);
+    ReleaseDisk();
+    m_Current = remap[m_Current];
+    m_PersistedNodes = 0;
+    m_RewriteFile = true;
+}
+
+void UndoTree::BindFile(const std::filesystem::path& undoPath, uint64_t sessionHash) {
+    m_File = std::make_shared<UndoFile>(undoPath);
+    m_SessionHash = sessionHash;
+    std::error_code ec;
+    m_DiskState = std::filesystem::exists(undoPath, ec) ? DiskState::Pending : DiskState::Loaded;
+    m_PersistedNodes = 0;
+    m_RewriteFile = true;
+}
+
+void UndoTree::RebindFile(const std::filesystem::path& undoPath) {
+    LoadDiskHistory();
+    m_File = std::make_shared<UndoFile>(undoPath);
+    m_DiskState = DiskState::Loaded;
+    m_PersistedNodes = 0;
+    m_RewriteFile = true;
+}
+
+void UndoTree::Persist(uint64_t savedHash) {
+    MarkSaved();
+    if (!m_File) return;
+    
+    // Indices must line up with the file before appending to it
+    LoadDiskHistory();
+    
+    std::string records;
+    size_t first = m_RewriteFile ? 1 : std::max<size_t>(m_PersistedNodes, 1);
+    for (size_t i = first; i < m_Nodes.size(); ++i) {
+        EncodeNode(static_cast<NodeIndex>(i), records);
+    }
+    StateRecord state{static_cast<uint32_t>(m_Nodes.size()), m_Current, m_SavedTimestamp, m_Timestamp, savedHash};
+    AppendRecord(records, STATE_RECORD, state);
+    
+    m_File->Write(std::move(records), m_RewriteFile);
+    m_PersistedNodes = m_Nodes.size();
+    m_RewriteFile = false;
+}
+
+void UndoTree::EncodeNode(NodeIndex index, std::string& out) const {
+    const Node& node = m_Nodes[index];
+    NodeRecord record{node.parent, static_cast<uint32_t>(node.type), node.position, node.cursorBefore,
+                      node.cursorAfter, node.timestamp, node.oldText.length, node.newText.length};
+    AppendRecord(out, NODE_RECORD, record);
+    out.append(GetText(node.oldText));
+    out.append(GetText(node.newText));
+}
+
+// Grafts the previous session's history under the session start: its saved
+// state is where this session began, so the session root's children move
+// there and this session's timestamps continue after the file's.
+void UndoTree::LoadDiskHistory() {
+    if (m_DiskState != DiskState::Pending) return;
+    m_DiskState = DiskState::Loaded;
+    
+    m_File->WaitIdle();
+    auto file = MappedFile::Open(m_File->GetPath());
+    std::vector<Node> nodes;
+    NodeIndex saved = 0;
+    size_t timestamp = 0;
+    if (!file || !ReadDiskHistory(*file, nodes, saved, timestamp)) return;
+    
+    const size_t diskCount = nodes.size();
+    const size_t diskBytes = file->Size();
+    auto remap = [&](NodeIndex i) {
+        return i == 0 ? saved : static_cast<NodeIndex>(i + diskCount - 1);
+    };
+    
+    // Session branches follow the disk ones under the saved node
+    size_t diskBranches = 0;
+    for (NodeIndex c = nodes[saved].firstChild; c != NONE; c = nodes[c].nextSibling) ++diskBranches;
+    
+    nodes.reserve(diskCount + m_Nodes.size() - 1);
+    for (size_t i = 1; i < m_Nodes.size(); ++i) {
+        Node node = m_Nodes[i];
+        node.firstChild = node.lastChild = node.nextSibling = NONE;
+        node.oldText.offset += diskBytes;
+        node.newText.offset += diskBytes;
+        node.timestamp += timestamp;
+        NodeIndex parent = remap(node.parent);
+        nodes.push_back(node);
+        Link(nodes, parent, static_cast<NodeIndex>(nodes.size() - 1));
+    }
+    
+    if (m_Current == 0) m_CurrentRedoBranch += diskBranches;
+    m_SavedTimestamp = m_SavedTimestamp == 0 ? nodes[saved].timestamp : m_SavedTimestamp + timestamp;
+    m_Timestamp += timestamp;
+    m_Current = remap(m_Current);
+    m_Nodes = std::move(nodes);
+    m_Disk = std::move(file);
+    m_DiskBytes = diskBytes;
+    m_PersistedNodes = diskCount;
+    m_RewriteFile = false;
+}
+
+bool UndoTree::ReadDiskHistory(const MappedFile& file, std::vector<Node>& nodes, NodeIndex& saved, size_t& timestamp) const {
+    const char* data = file.Data();
+    const size_t size = file.Size();
+    if (size < UndoFile::HEADER_SIZE || std::memcmp(data, UndoFile::MAGIC, sizeof(UndoFile::MAGIC)) != 0) {
+        return false;
+    }
+    
+    // A torn final write leaves an incomplete record, or nodes after the
+    // last state record; both are ignored
+    nodes.assign(1, Node{});
+    std::optional<StateRecord> state;
+    size_t pos = UndoFile::HEADER_SIZE;
+    while (pos < size) {
+        const auto kind = static_cast<uint8_t>(data[pos++]);
+        if (kind == NODE_RECORD && size - pos >= sizeof(NodeRecord)) {
+            NodeRecord record;
+            std::memcpy(&record, data + pos, sizeof(record));
+            pos += sizeof(record);
+            if (record.parent >= nodes.size() || record.type > static_cast<uint32_t>(EditOperation::Type::Batch) ||
+                record.oldLength > size - pos || record.newLength > size - pos - record.oldLength) {
+                break;
+            }
+            Node node;
+            node.type = static_cast<EditOperation::Type>(record.type);
+            node.position = record.position;
+            node.cursorBefore = record.cursorBefore;
+            node.cursorAfter = record.cursorAfter;
+            node.timestamp = record.timestamp;
+            node.parent = record.parent;
+            node.oldText = {pos, record.oldLength};
+            node.newText = {pos + record.oldLength, record.newLength};
+            pos += record.oldLength + record.newLength;
+            nodes.push_back(node);
+        } else if (kind == STATE_RECORD && size - pos >= sizeof(StateRecord)) {
+            StateRecord record;
+            std::memcpy(&record, data + pos, sizeof(record));
+            pos += sizeof(record);
+            if (record.nodeCount != nodes.size() || record.saved >= record.nodeCount) break;
+            state = record;
+        } else {
+            break;
+        }
+    }
+    if (!state || state->contentHash != m_SessionHash) return false;
+    
+    nodes.resize(state->nodeCount);
+    for (size_t i = 1; i < nodes.size(); ++i) {
+        Link(nodes, nodes[i].parent, static_cast<NodeIndex>(i));
+    }
+    saved = state->saved;
+    timestamp = state->timestamp;
+    return true;
 }
 
 // UndoGroup implementation
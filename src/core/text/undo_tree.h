@@ -1,16 +1,23 @@
 #pragma once
 
 #include <string>
+#include <string_view>
 #include <vector>
-#include <memory>
 #include <optional>
-#include <functional>
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
 
 namespace sol {
 
+class EditSession;
+class MappedFile;
+class UndoFile;
+
 // Represents a single edit operation
 struct EditOperation {
-    enum class Type { Insert, Delete, Replace };
+    enum class Type { Insert, Delete, Replace, Batch };
     
     Type type;
     size_t position;
@@ -21,6 +28,10 @@ struct EditOperation {
     size_t cursorBefore;
     size_t cursorAfter;
     
+    // For batch: Replace operations sorted by position, all positioned in the
+    // text before the batch
+    std::vector<EditOperation> parts;
+    
     static EditOperation Insert(size_t pos, const std::string& text, size_t cursorBefore) {
         return { Type::Insert, pos, "", text, cursorBefore, pos + text.length() };
     }
@@ -32,19 +43,22 @@ struct EditOperation {
     static EditOperation Replace(size_t pos, const std::string& oldText, const std::string& newText, size_t cursorBefore) {
         return { Type::Replace, pos, oldText, newText, cursorBefore, pos + newText.length() };
     }
-};
-
-// Node in the undo tree
-struct UndoNode {
-    EditOperation operation;
-    std::weak_ptr<UndoNode> parent;
-    std::vector<std::shared_ptr<UndoNode>> children;
-    size_t timestamp;  // For ordering branches
-    
-    UndoNode(const EditOperation& op, size_t ts) : operation(op), timestamp(ts) {}
+    
+    static EditOperation Batch(std::vector<EditOperation> parts, size_t cursorBefore, size_t cursorAfter) {
+        size_t pos = parts.empty() ? 0 : parts.front().position;
+        return { Type::Batch, pos, "", "", cursorBefore, cursorAfter, std::move(parts) };
+    }
 };
 
 // Undo tree with branching history (like vim's undotree)
+// Nodes live in one append-only array linked by index, and all edit text is
+// appended to a single shared log, so recording an edit needs no allocation
+// of its own. Once the log outgrows its memory budget the oldest
+// branches, then the oldest undo steps, are pruned.
+// History can persist across sessions in an undofile (see UndoFile): saving
+// appends what is new in the background, and a previous session's history is
+// only read once the user undoes past the start of this one. Its text stays
+// in the mapped file and is paged in as those edits are replayed.
 class UndoTree {
 public:
     UndoTree();
@@ -81,18 +95,86 @@ public:
     
     // Merge consecutive similar operations (for grouping typing)
     void SetMergeWindow(size_t milliseconds) { m_MergeWindow = milliseconds; }
+    size_t GetMergeWindow() const { return m_MergeWindow; }
+    
+    // Bytes of history kept before pruning; 0 disables the cap
+    void SetMemoryBudget(size_t bytes) { m_MemoryBudget = bytes; }
+    size_t GetMemoryUsage() const { return m_Nodes.size() * sizeof(Node) + m_Text.size(); }
+    
+    // Names the undofile of a buffer whose content at the start of the
+    // session hashes to sessionHash; nothing is read yet
+    void BindFile(const std::filesystem::path& undoPath, uint64_t sessionHash);
+    // Keeps the history but writes it to another undofile from scratch
+    void RebindFile(const std::filesystem::path& undoPath);
+    // Marks the current state saved and queues the history not yet on disk
+    void Persist(uint64_t savedHash);
+    
+    // Records each push, undo and redo into session until reset
+    void SetSession(std::shared_ptr<EditSession> session) { m_Session = std::move(session); }
     
 private:
-    std::shared_ptr<UndoNode> m_Root;
-    std::shared_ptr<UndoNode> m_Current;  // Current position in tree
+    using NodeIndex = uint32_t;
+    static constexpr NodeIndex NONE = UINT32_MAX;
+    
+    // Slice of m_Text
+    struct TextRef {
+        size_t offset = 0;
+        size_t length = 0;
+    };
+    
+    // Children always have a larger index than their parent, and siblings are
+    // linked oldest to newest
+    struct Node {
+        EditOperation::Type type = EditOperation::Type::Insert;
+        size_t position = 0;
+        size_t cursorBefore = 0;
+        size_t cursorAfter = 0;
+        TextRef oldText;
+        TextRef newText;  // For batch: the packed parts
+        size_t timestamp = 0;
+        NodeIndex parent = NONE;
+        NodeIndex firstChild = NONE;
+        NodeIndex lastChild = NONE;
+        NodeIndex nextSibling = NONE;
+    };
+    
+    enum class DiskState { None, Pending, Loaded };
+    
+    std::vector<Node> m_Nodes;  // m_Nodes[0] is the root
+    std::string m_Text;         // Offsets start at m_DiskBytes
+    std::shared_ptr<const MappedFile> m_Disk;  // Text of nodes read from the undofile
+    size_t m_DiskBytes = 0;
+    NodeIndex m_Current = 0;  // Current position in tree
     size_t m_Timestamp = 0;
     size_t m_SavedTimestamp = 0;
     size_t m_MergeWindow = 500;  // Merge operations within 500ms
+    std::chrono::steady_clock::time_point m_LastPush;
+    size_t m_MemoryBudget = 64 * 1024 * 1024;
     
     // Track current redo path when navigating branches
     size_t m_CurrentRedoBranch = 0;
     
+    std::shared_ptr<UndoFile> m_File;
+    DiskState m_DiskState = DiskState::None;
+    uint64_t m_SessionHash = 0;
+    size_t m_PersistedNodes = 0;  // Prefix of m_Nodes already in the undofile
+    bool m_RewriteFile = true;
+    
+    std::shared_ptr<EditSession> m_Session;
+    
     bool ShouldMerge(const EditOperation& newOp) const;
+    TextRef StoreText(std::string_view text);
+    std::string_view GetText(const TextRef& ref) const;
+    EditOperation ToOperation(NodeIndex index) const;
+    NodeIndex ChildAt(NodeIndex parent, size_t branch) const;
+    size_t ChildCount(NodeIndex parent) const;
+    static void Link(std::vector<Node>& nodes, NodeIndex parent, NodeIndex child);
+    void Prune();
+    void ReleaseDisk();
+    
+    void LoadDiskHistory();
+    bool ReadDiskHistory(const MappedFile& file, std::vector<Node>& nodes, NodeIndex& saved, size_t& timestamp) const;
+    void EncodeNode(NodeIndex index, std::string& out) const;
 };
 
 // Groups multiple operations into a single undo unit
@@ -0,0 +1,170 @@
+#include "wrap_index.h"
+#include "fold_map.h"
+#include "text_buffer.h"
+#include <bit>
+#include <string>
+
+namespace sol {
+
+void WrapIndex::FindBreaks(std::string_view line, size_t columns, size_t tabSize, std::vector<size_t>& breaks) {
+    breaks.clear();
+    size_t rowStart = 0;
+    size_t cells = 0;
+    size_t afterBlank = 0;  // Where the row could break last, 0 for nowhere
+    for (size_t i = 0; i < line.size(); ++i) {
+        const size_t width = line[i] == '\t' ? tabSize : 1;
+        // A row holds at least one byte, however wide
+        while (cells + width > columns && i > rowStart) {
+            size_t at = afterBlank > rowStart ? afterBlank : i;
+            while (at > rowStart + 1 && (static_cast<unsigned char>(line[at]) & 0xC0) == 0x80) --at;
+            breaks.push_back(at);
+            rowStart = at;
+            afterBlank = 0;
+            cells = 0;
+            for (size_t j = at; j < i; ++j) cells += line[j] == '\t' ? tabSize : 1;
+        }
+        cells += width;
+        if (line[i] == ' ' || line[i] == '\t') afterBlank = i + 1;
+    }
+}
+
+void WrapIndex::Update(const TextBuffer& buffer, size_t columns, size_t tabSize, const FoldMap& folds) {
+    columns = std::max<size_t>(columns, 1);
+    tabSize = std::max<size_t>(tabSize, 1);
+    if (&buffer != m_Buffer || columns != m_Columns || tabSize != m_TabSize || !CatchUp(buffer, folds)) {
+        m_Buffer = &buffer;
+        m_Columns = columns;
+        m_TabSize = tabSize;
+        m_LineVersion = buffer.GetLineVersion();
+        Remeasure(buffer);
+        Rebuild(folds);
+        return;
+    }
+    if (folds.GetVersion() != m_FoldVersion) Rebuild(folds);
+}
+
+std::pair<size_t, size_t> WrapIndex::RowToLine(size_t row) const {
+    // The most lines whose rows end at or before row
+    size_t line = 0;
+    for (size_t step = std::bit_floor(m_Tree.size()); step > 0; step >>= 1) {
+        if (line + step <= m_Tree.size() && m_Tree[line + step - 1] <= row) {
+            line += step;
+            row -= m_Tree[line - 1];
+        }
+    }
+    if (line >= m_Rows.size()) return {m_Rows.size(), 0};
+    return {line, row};
+}
+
+uint32_t WrapIndex::Measure(const TextBuffer& buffer, size_t line) {
+    const size_t start = buffer.LineStart(line);
+    const size_t length = buffer.LineEnd(line) - start;
+    if (length <= m_Columns / m_TabSize) return 1;
+
+    const std::string text = buffer.Substring(start, length);
+    std::string_view view = text;
+    while (!view.empty() && view.back() == '\r') view.remove_suffix(1);
+    FindBreaks(view, m_Columns, m_TabSize, m_Breaks);
+    return static_cast<uint32_t>(m_Breaks.size() + 1);
+}
+
+size_t WrapIndex::Prefix(size_t count) const {
+    size_t rows = 0;
+    for (; count > 0; count &= count - 1) rows += m_Tree[count - 1];
+    return rows;
+}
+
+void WrapIndex::Add(size_t line, int64_t delta) {
+    for (size_t i = line + 1; i <= m_Tree.size(); i += i & (~i + 1)) {
+        m_Tree[i - 1] = static_cast<size_t>(static_cast<int64_t>(m_Tree[i - 1]) + delta);
+    }
+}
+
+void WrapIndex::Rebuild(const FoldMap& folds) {
+    m_Tree.assign(m_Rows.size(), 0);
+    for (size_t line = folds.NextVisible(0); line < m_Rows.size(); line = folds.NextVisible(line + 1)) {
+        m_Tree[line] = m_Rows[line];
+    }
+    for (size_t i = 1; i <= m_Tree.size(); ++i) {
+        const size_t parent = i + (i & (~i + 1));
+        if (parent <= m_Tree.size()) m_Tree[parent - 1] += m_Tree[i - 1];
+    }
+    m_FoldVersion = folds.GetVersion();
+}
+
+// Only a line longer than the width by bytes can wrap, so one scan for the
+// newlines finds the few worth measuring
+void WrapIndex::Remeasure(const TextBuffer& buffer) {
+    m_Rows.assign(buffer.LineCount(), 1);
+    const size_t fits = m_Columns / m_TabSize;
+    std::vector<size_t> wide;
+    size_t line = 0;
+    size_t length = 0;
+    buffer.ForEachChunk(0, buffer.Length(), [&](std::string_view chunk) {
+        for (size_t pos = 0; pos < chunk.size();) {
+            const size_t newline = chunk.find('\n', pos);
+            if (newline == std::string_view::npos) {
+                length += chunk.size() - pos;
+                break;
+            }
+            if (length + (newline - pos) > fits) wide.push_back(line);
+            ++line;
+            length = 0;
+            pos = newline + 1;
+        }
+    });
+    if (length > fits) wide.push_back(line);
+    for (size_t w : wide) {
+        if (w < m_Rows.size()) m_Rows[w] = Measure(buffer, w);
+    }
+}
+
+bool WrapIndex::CatchUp(const TextBuffer& buffer, const FoldMap& folds) {
+    if (m_LineVersion == buffer.GetLineVersion()) return true;
+    std::vector<TextBuffer::LineShift> shifts;
+    if (!buffer.GetLineShiftsSince(m_LineVersion, shifts)) return false;
+    m_LineVersion = buffer.GetLineVersion();
+
+    // Edits within lines keep every other line where it was
+    const bool sameLines = std::all_of(shifts.begin(), shifts.end(), [](const TextBuffer::LineShift& shift) {
+        return shift[1] == shift[2];
+    });
+    if (sameLines) {
+        for (const auto& [first, oldLast, newLast] : shifts) {
+            if (newLast >= m_Rows.size()) return false;
+            for (size_t line = first; line <= newLast; ++line) {
+                const uint32_t rows = Measure(buffer, line);
+                if (!folds.IsHidden(line)) Add(line, static_cast<int64_t>(rows) - m_Rows[line]);
+                m_Rows[line] = rows;
+            }
+        }
+        return true;
+    }
+
+    // Lines replaced are left unmeasured, as 0, until every shift is in
+    size_t dirtyFirst = SIZE_MAX;
+    size_t dirtyLast = 0;
+    for (const auto& [first, oldLast, newLast] : shifts) {
+        if (oldLast >= m_Rows.size() || oldLast < first || newLast < first) return false;
+        const size_t oldCount = oldLast - first + 1;
+        const size_t newCount = newLast - first + 1;
+        std::fill_n(m_Rows.begin() + first, std::min(oldCount, newCount), 0);
+        auto tail = m_Rows.begin() + first + std::min(oldCount, newCount);
+        if (newCount > oldCount) {
+            m_Rows.insert(tail, newCount - oldCount, 0);
+        } else {
+            m_Rows.erase(tail, tail + (oldCount - newCount));
+        }
+        if (dirtyFirst != SIZE_MAX && dirtyLast > oldLast) dirtyLast = dirtyLast + newCount - oldCount;
+        dirtyFirst = std::min(dirtyFirst, first);
+        dirtyLast = std::max(dirtyLast, newLast);
+    }
+    if (m_Rows.size() != buffer.LineCount()) return false;
+    for (size_t line = dirtyFirst; line <= std::min(dirtyLast, m_Rows.size() - 1); ++line) {
+        if (m_Rows[line] == 0) m_Rows[line] = Measure(buffer, line);
+    }
+    Rebuild(folds);
+    return true;
+}
+
+} // namespace sol
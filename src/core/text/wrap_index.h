@@ -0,0 +1,59 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace sol {
+
+class TextBuffer;
+class FoldMap;
+
+// Display rows of soft-wrapped lines: how many rows each buffer line takes
+// at a width in cells, and a Fenwick tree over them in which lines a fold
+// hides weigh nothing, so mapping between lines and rows is logarithmic.
+// Updates replay the buffer's line shifts and remeasure only the lines they
+// touched; a new width, tab size or buffer remeasures everything. A byte
+// takes a cell and a tab tabSize of them, as the editor draws them.
+class WrapIndex {
+public:
+    // Byte offsets in line where rows after the first start. Rows break
+    // after the last blank that fits, or at the width when none does, and
+    // never inside a UTF-8 sequence.
+    static void FindBreaks(std::string_view line, size_t columns, size_t tabSize, std::vector<size_t>& breaks);
+
+    void Update(const TextBuffer& buffer, size_t columns, size_t tabSize, const FoldMap& folds);
+
+    // Rows of the lines shown
+    size_t GetRowCount() const { return Prefix(m_Rows.size()); }
+    // Rows line takes when shown
+    size_t GetLineRows(size_t line) const { return line < m_Rows.size() ? m_Rows[line] : 1; }
+    // Rows of the lines shown before line
+    size_t LineToRow(size_t line) const { return Prefix(std::min(line, m_Rows.size())); }
+    // The shown line on row and the row within it; rows past the last map
+    // past the last line
+    std::pair<size_t, size_t> RowToLine(size_t row) const;
+
+private:
+    uint32_t Measure(const TextBuffer& buffer, size_t line);
+    size_t Prefix(size_t count) const;
+    void Add(size_t line, int64_t delta);
+    void Rebuild(const FoldMap& folds);
+    void Remeasure(const TextBuffer& buffer);
+    // False when the shifts can no longer be replayed
+    bool CatchUp(const TextBuffer& buffer, const FoldMap& folds);
+
+    const TextBuffer* m_Buffer = nullptr;
+    uint64_t m_LineVersion = 0;
+    uint64_t m_FoldVersion = 0;
+    size_t m_Columns = 0;
+    size_t m_TabSize = 0;
+    std::vector<uint32_t> m_Rows;  // Per line, folded or not
+    std::vector<size_t> m_Tree;    // Rows of the lines shown, as a Fenwick tree
+    std::vector<size_t> m_Breaks;  // Scratch
+};
+
+} // namespace sol
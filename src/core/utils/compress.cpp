@@ -0,0 +1,133 @@
+#include "compress.h"
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+
+namespace sol {
+
+namespace {
+
+constexpr size_t MIN_MATCH = 4;
+constexpr size_t LAST_LITERALS = 5;  // A block always ends in literals
+constexpr size_t MATCH_LIMIT = 12;   // No match starts this close to the end
+constexpr size_t MAX_OFFSET = 65535;
+constexpr int HASH_BITS = 14;
+
+uint32_t Load32(const char* p) {
+    uint32_t value;
+    std::memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+uint32_t Hash(uint32_t sequence) {
+    return (sequence * 2654435761u) >> (32 - HASH_BITS);
+}
+
+void PutLength(std::string& out, size_t length) {
+    for (; length >= 255; length -= 255) out.push_back(static_cast<char>(255));
+    out.push_back(static_cast<char>(length));
+}
+
+void PutSequence(std::string& out, std::string_view literals, size_t offset, size_t match) {
+    const size_t matchCode = match - MIN_MATCH;
+    const uint8_t token = static_cast<uint8_t>(std::min<size_t>(literals.size(), 15) << 4 | std::min<size_t>(matchCode, 15));
+    out.push_back(static_cast<char>(token));
+    if (literals.size() >= 15) PutLength(out, literals.size() - 15);
+    out.append(literals);
+    out.push_back(static_cast<char>(offset & 0xFF));
+    out.push_back(static_cast<char>(offset >> 8));
+    if (matchCode >= 15) PutLength(out, matchCode - 15);
+}
+
+void PutLast(std::string& out, std::string_view literals) {
+    out.push_back(static_cast<char>(std::min<size_t>(literals.size(), 15) << 4));
+    if (literals.size() >= 15) PutLength(out, literals.size() - 15);
+    out.append(literals);
+}
+
+// Adds the extension bytes of a length; false when they run past the data
+bool GetLength(std::string_view data, size_t& pos, size_t& length) {
+    uint8_t byte;
+    do {
+        if (pos >= data.size()) return false;
+        byte = static_cast<uint8_t>(data[pos++]);
+        length += byte;
+    } while (byte == 255);
+    return true;
+}
+
+} // namespace
+
+std::string CompressBlock(std::string_view data) {
+    std::string out;
+    out.reserve(data.size() + data.size() / 255 + 16);
+    const char* src = data.data();
+    size_t anchor = 0;
+
+    if (data.size() >= MATCH_LIMIT) {
+        // Positions plus one by hash of the four bytes there; 0 for none
+        auto table = std::make_unique<uint32_t[]>(size_t{1} << HASH_BITS);
+        const size_t limit = data.size() - MATCH_LIMIT;
+        size_t pos = 0;
+        while (pos < limit) {
+            const uint32_t sequence = Load32(src + pos);
+            uint32_t& slot = table[Hash(sequence)];
+            const size_t candidate = slot;
+            slot = static_cast<uint32_t>(pos + 1);
+            if (candidate == 0 || pos - (candidate - 1) > MAX_OFFSET || Load32(src + candidate - 1) != sequence) {
+                // Skip faster through data that does not repeat
+                pos += 1 + ((pos - anchor) >> 6);
+                continue;
+            }
+
+            const size_t match = candidate - 1;
+            const size_t maxLength = data.size() - LAST_LITERALS - pos;
+            size_t length = MIN_MATCH;
+            while (length < maxLength && src[match + length] == src[pos + length]) ++length;
+            PutSequence(out, data.substr(anchor, pos - anchor), pos - match, length);
+            pos += length;
+            anchor = pos;
+        }
+    }
+
+    PutLast(out, data.substr(anchor));
+    return out;
+}
+
+bool DecompressBlock(std::string_view data, size_t size, std::string& out) {
+    out.resize(size);
+    char* dst = out.data();
+    size_t in = 0;
+    size_t pos = 0;
+
+    while (in < data.size()) {
+        const uint8_t token = static_cast<uint8_t>(data[in++]);
+        size_t literals = token >> 4;
+        if (literals == 15 && !GetLength(data, in, literals)) return false;
+        if (literals > data.size() - in || literals > size - pos) return false;
+        std::memcpy(dst + pos, data.data() + in, literals);
+        in += literals;
+        pos += literals;
+        if (in == data.size()) break;  // The last sequence has no match
+
+        if (data.size() - in < 2) return false;
+        const size_t offset = static_cast<uint8_t>(data[in]) | static_cast<size_t>(static_cast<uint8_t>(data[in + 1])) << 8;
+        in += 2;
+        size_t length = token & 15;
+        if (length == 15 && !GetLength(data, in, length)) return false;
+        length += MIN_MATCH;
+        if (offset == 0 || offset > pos || length > size - pos) return false;
+
+        if (offset >= length) {
+            std::memcpy(dst + pos, dst + pos - offset, length);
+        } else {
+            // Overlapping: the match repeats the bytes it is still writing
+            for (size_t i = 0; i < length; ++i) dst[pos + i] = dst[pos - offset + i];
+        }
+        pos += length;
+    }
+    return pos == size;
+}
+
+} // namespace sol
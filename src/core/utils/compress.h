@@ -0,0 +1,18 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+
+namespace sol {
+
+// LZ77 block compression in the LZ4 block format: fast enough to run inline
+// with the output it packs, and good on repetitive text such as build logs.
+// Each call packs or unpacks one whole block; the unpacked size is kept by
+// the caller.
+std::string CompressBlock(std::string_view data);
+
+// False when data is not a valid block of exactly size bytes
+bool DecompressBlock(std::string_view data, size_t size, std::string& out);
+
+} // namespace sol
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <string_view>
+
+namespace sol {
+
+// 64-bit content hash fed in arbitrary pieces; the result depends only on the
+// byte sequence, not on how it was split, so rope chunks can be hashed as-is.
+// Not cryptographic; used to recognise unchanged files.
+class StreamHash {
+public:
+    void Update(std::string_view data) {
+        m_Length += data.length();
+        if (m_Pending) {
+            size_t take = std::min(sizeof(m_Word) - m_Pending, data.length());
+            std::memcpy(m_Word + m_Pending, data.data(), take);
+            m_Pending += take;
+            data.remove_prefix(take);
+            if (m_Pending < sizeof(m_Word)) return;
+            Mix(Load(m_Word));
+            m_Pending = 0;
+        }
+        while (data.length() >= sizeof(m_Word)) {
+            Mix(Load(data.data()));
+            data.remove_prefix(sizeof(m_Word));
+        }
+        std::memcpy(m_Word, data.data(), data.length());
+        m_Pending = data.length();
+    }
+    
+    uint64_t Final() const {
+        uint64_t h = m_State;
+        if (m_Pending) {
+            char tail[sizeof(m_Word)] = {};
+            std::memcpy(tail, m_Word, m_Pending);
+            h = Round(h, Load(tail));
+        }
+        h ^= m_Length;
+        h ^= h >> 33;
+        h *= 0xff51afd7ed558ccdULL;
+        h ^= h >> 33;
+        h *= 0xc4ceb9fe1a85ec53ULL;
+        h ^= h >> 33;
+        return h;
+    }
+    
+    static uint64_t Of(std::string_view data) {
+        StreamHash hash;
+        hash.Update(data);
+        return hash.Final();
+    }
+    
+private:
+    static uint64_t Load(const char* p) {
+        uint64_t v;
+        std::memcpy(&v, p, sizeof(v));
+        return v;
+    }
+    static uint64_t Round(uint64_t h, uint64_t v) {
+        h ^= v * 0x9e3779b97f4a7c15ULL;
+        h = (h << 31) | (h >> 33);
+        return h * 0xbf58476d1ce4e5b9ULL;
+    }
+    void Mix(uint64_t v) { m_State = Round(m_State, v); }
+    
+    uint64_t m_State = 0x243f6a8885a308d3ULL;
+    uint64_t m_Length = 0;
+    char m_Word[8] = {};
+    size_t m_Pending = 0;
+};
+
+} // namespace sol
@@ -0,0 +1,511 @@
+#include "json.h"
+#include <algorithm>
+#include <charconv>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+namespace sol {
+
+namespace {
+
+bool IsNumberChar(char c) {
+    return (c >= '0' && c <= '9') || c == '-' || c == '+' || c == '.' || c == 'e' || c == 'E';
+}
+
+int HexDigit(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+void AppendUtf8(std::string& out, uint32_t code) {
+    if (code < 0x80) {
+        out += static_cast<char>(code);
+    } else if (code < 0x800) {
+        out += static_cast<char>(0xC0 | (code >> 6));
+        out += static_cast<char>(0x80 | (code & 0x3F));
+    } else if (code < 0x10000) {
+        out += static_cast<char>(0xE0 | (code >> 12));
+        out += static_cast<char>(0x80 | ((code >> 6) & 0x3F));
+        out += static_cast<char>(0x80 | (code & 0x3F));
+    } else {
+        out += static_cast<char>(0xF0 | (code >> 18));
+        out += static_cast<char>(0x80 | ((code >> 12) & 0x3F));
+        out += static_cast<char>(0x80 | ((code >> 6) & 0x3F));
+        out += static_cast<char>(0x80 | (code & 0x3F));
+    }
+}
+
+constexpr double MAX_EXACT_INTEGER = 9007199254740992.0;  // 2^53
+
+} // namespace
+
+// --- JsonReader ---
+
+void JsonReader::SkipWhitespace() {
+    while (m_Pos < m_Text.size()) {
+        const char c = m_Text[m_Pos];
+        if (c != ' ' && c != '\n' && c != '\r' && c != '\t') return;
+        ++m_Pos;
+    }
+}
+
+bool JsonReader::Fail() {
+    m_Failed = true;
+    m_Pos = m_Text.size();
+    return false;
+}
+
+bool JsonReader::AtEnd() {
+    SkipWhitespace();
+    return m_Pos == m_Text.size();
+}
+
+JsonType JsonReader::Peek() {
+    SkipWhitespace();
+    if (m_Pos >= m_Text.size()) return JsonType::Null;
+    switch (m_Text[m_Pos]) {
+        case '{': return JsonType::Object;
+        case '[': return JsonType::Array;
+        case '"': return JsonType::String;
+        case 't': case 'f': return JsonType::Bool;
+        case 'n': return JsonType::Null;
+        default: return JsonType::Number;
+    }
+}
+
+bool JsonReader::Enter(char open) {
+    SkipWhitespace();
+    if (m_Pos >= m_Text.size()) return Fail();
+    if (m_Text[m_Pos] != open) {
+        Skip();
+        return false;
+    }
+    ++m_Pos;
+    return true;
+}
+
+bool JsonReader::Continue(char close) {
+    SkipWhitespace();
+    if (m_Pos < m_Text.size()) {
+        const char c = m_Text[m_Pos++];
+        if (c == ',') return true;
+        if (c == close) return false;
+    }
+    return Fail();
+}
+
+bool JsonReader::ReadKey(std::string_view& key) {
+    SkipWhitespace();
+    if (m_Pos >= m_Text.size() || m_Text[m_Pos] != '"' || !ReadString(key, m_KeyScratch)) return Fail();
+    SkipWhitespace();
+    if (m_Pos >= m_Text.size() || m_Text[m_Pos] != ':') return Fail();
+    ++m_Pos;
+    return true;
+}
+
+// At the opening quote. Text without escapes is returned in place.
+bool JsonReader::ReadString(std::string_view& out, std::string& scratch) {
+    const size_t start = ++m_Pos;
+    const size_t special = m_Text.find_first_of("\"\\", start);
+    if (special == std::string_view::npos) return Fail();
+    if (m_Text[special] == '"') {
+        out = m_Text.substr(start, special - start);
+        m_Pos = special + 1;
+        return true;
+    }
+
+    scratch.assign(m_Text.data() + start, special - start);
+    m_Pos = special;
+    while (m_Pos < m_Text.size()) {
+        const char c = m_Text[m_Pos++];
+        if (c == '"') {
+            out = scratch;
+            return true;
+        }
+        if (c != '\\') {
+            scratch += c;
+            continue;
+        }
+        if (m_Pos >= m_Text.size()) break;
+        const char escaped = m_Text[m_Pos++];
+        switch (escaped) {
+            case 'n': scratch += '\n'; break;
+            case 't': scratch += '\t'; break;
+            case 'r': scratch += '\r'; break;
+            case 'b': scratch += '\b'; break;
+            case 'f': scratch += '\f'; break;
+            case 'u': {
+                auto readHex = [this](uint32_t& code) {
+                    if (m_Pos + 4 > m_Text.size()) return false;
+                    code = 0;
+                    for (int i = 0; i < 4; ++i) {
+                        const int digit = HexDigit(m_Text[m_Pos++]);
+                        if (digit < 0) return false;
+                        code = code * 16 + static_cast<uint32_t>(digit);
+                    }
+                    return true;
+                };
+                uint32_t code;
+                if (!readHex(code)) return Fail();
+                // A high surrogate pairs with the escape that follows it
+                if (code >= 0xD800 && code < 0xDC00 && m_Text.substr(m_Pos, 2) == "\\u") {
+                    const size_t low = m_Pos;
+                    m_Pos += 2;
+                    uint32_t next;
+                    if (readHex(next) && next >= 0xDC00 && next < 0xE000) {
+                        code = 0x10000 + ((code - 0xD800) << 10) + (next - 0xDC00);
+                    } else {
+                        m_Pos = low;
+                    }
+                }
+                AppendUtf8(scratch, code);
+                break;
+            }
+            default: scratch += escaped; break;
+        }
+    }
+    return Fail();
+}
+
+bool JsonReader::SkipString() {
+    ++m_Pos;
+    while (true) {
+        const size_t special = m_Text.find_first_of("\"\\", m_Pos);
+        if (special == std::string_view::npos) return Fail();
+        m_Pos = special + 1;
+        if (m_Text[special] == '"') return true;
+        ++m_Pos;  // The escaped character
+    }
+}
+
+std::string_view JsonReader::String() {
+    if (Peek() != JsonType::String) {
+        Skip();
+        return {};
+    }
+    std::string_view out;
+    if (!ReadString(out, m_Scratch)) return {};
+    return out;
+}
+
+double JsonReader::Number() {
+    SkipWhitespace();
+    if (m_Pos >= m_Text.size() || !IsNumberChar(m_Text[m_Pos])) {
+        Skip();
+        return 0.0;
+    }
+    const size_t start = m_Pos;
+    while (m_Pos < m_Text.size() && IsNumberChar(m_Text[m_Pos])) ++m_Pos;
+    const std::string_view text = m_Text.substr(start, m_Pos - start);
+
+    // Almost every number in LSP traffic is a small integer
+    int64_t integer = 0;
+    auto [end, ec] = std::from_chars(text.data(), text.data() + text.size(), integer);
+    if (ec == std::errc() && end == text.data() + text.size()) return static_cast<double>(integer);
+
+    char buffer[64];
+    if (text.size() >= sizeof(buffer)) {
+        Fail();
+        return 0.0;
+    }
+    std::memcpy(buffer, text.data(), text.size());
+    buffer[text.size()] = '\0';
+    char* parsed = nullptr;
+    const double value = std::strtod(buffer, &parsed);
+    if (parsed != buffer + text.size()) {
+        Fail();
+        return 0.0;
+    }
+    return value;
+}
+
+bool JsonReader::Bool() {
+    SkipWhitespace();
+    if (m_Text.substr(m_Pos, 4) == "true") {
+        m_Pos += 4;
+        return true;
+    }
+    if (m_Text.substr(m_Pos, 5) == "false") {
+        m_Pos += 5;
+        return false;
+    }
+    Skip();
+    return false;
+}
+
+std::string_view JsonReader::Skip() {
+    SkipWhitespace();
+    const size_t start = m_Pos;
+    if (m_Pos >= m_Text.size()) {
+        Fail();
+        return {};
+    }
+
+    const char c = m_Text[m_Pos];
+    if (c == '"') {
+        SkipString();
+    } else if (c == '{' || c == '[') {
+        // Brackets are counted without checking they pair up; strings may hold any of them
+        size_t depth = 0;
+        while (m_Pos < m_Text.size()) {
+            const size_t next = m_Text.find_first_of("\"{}[]", m_Pos);
+            if (next == std::string_view::npos) {
+                Fail();
+                break;
+            }
+            m_Pos = next;
+            const char bracket = m_Text[next];
+            if (bracket == '"') {
+                if (!SkipString()) break;
+                continue;
+            }
+            ++m_Pos;
+            if (bracket == '{' || bracket == '[') {
+                ++depth;
+            } else if (--depth == 0) {
+                break;
+            }
+        }
+    } else if (m_Text.substr(m_Pos, 4) == "true" || m_Text.substr(m_Pos, 4) == "null") {
+        m_Pos += 4;
+    } else if (m_Text.substr(m_Pos, 5) == "false") {
+        m_Pos += 5;
+    } else if (IsNumberChar(c)) {
+        while (m_Pos < m_Text.size() && IsNumberChar(m_Text[m_Pos])) ++m_Pos;
+    } else {
+        Fail();
+    }
+    return m_Failed ? std::string_view() : m_Text.substr(start, m_Pos - start);
+}
+
+// --- JsonNode ---
+
+bool JsonNode::Has(std::string_view key) const {
+    for (const JsonMember& member : Members()) {
+        if (member.key == key) return true;
+    }
+    return false;
+}
+
+const JsonNode& JsonNode::operator[](std::string_view key) const {
+    static const JsonNode null;
+    for (const JsonMember& member : Members()) {
+        if (member.key == key) return member.value;
+    }
+    return null;
+}
+
+// --- JsonDocument ---
+
+void* JsonDocument::Allocate(size_t bytes, size_t align) {
+    if (!m_Blocks.empty()) {
+        Block& block = m_Blocks.back();
+        const size_t offset = (m_Used + align - 1) & ~(align - 1);
+        if (offset + bytes <= block.size) {
+            m_Used = offset + bytes;
+            m_Total += bytes;
+            return block.data.get() + offset;
+        }
+    }
+    const size_t size = std::max(BLOCK_SIZE, bytes);
+    m_Blocks.push_back({std::make_unique<std::byte[]>(size), size});
+    m_Used = bytes;
+    m_Total += bytes;
+    return m_Blocks.back().data.get();
+}
+
+// Keeps one block big enough for the last document, so a similar one needs no allocation
+void JsonDocument::ResetArena() {
+    if (m_Blocks.size() > 1) {
+        const size_t size = std::max(BLOCK_SIZE, m_Total + m_Total / 4);
+        m_Blocks.clear();
+        m_Blocks.push_back({std::make_unique<std::byte[]>(size), size});
+    }
+    m_Used = 0;
+    m_Total = 0;
+}
+
+std::string_view JsonDocument::Store(std::string_view text) {
+    if (text.empty()) return {};
+    char* copy = static_cast<char*>(Allocate(text.size(), 1));
+    std::memcpy(copy, text.data(), text.size());
+    return std::string_view(copy, text.size());
+}
+
+bool JsonDocument::Parse(std::string_view text) {
+    ResetArena();
+    m_Root = JsonNode();
+    JsonReader reader(text);
+    if (Build(reader, m_Root) && reader.AtEnd()) return true;
+    m_Root = JsonNode();
+    return false;
+}
+
+bool JsonDocument::Build(JsonReader& reader, JsonNode& node) {
+    node = JsonNode();
+    switch (reader.Peek()) {
+        case JsonType::Null:
+            reader.Skip();
+            break;
+        case JsonType::Bool:
+            node.m_Type = JsonType::Bool;
+            node.m_Bool = reader.Bool();
+            break;
+        case JsonType::Number:
+            node.m_Type = JsonType::Number;
+            node.m_Number = reader.Number();
+            break;
+        case JsonType::String: {
+            const std::string_view value = Store(reader.String());
+            node.m_Type = JsonType::String;
+            node.m_String = value.data();
+            node.m_Size = static_cast<uint32_t>(value.size());
+            break;
+        }
+        case JsonType::Array: {
+            const size_t mark = m_ItemStack.size();
+            reader.Array([&] {
+                JsonNode item;
+                if (Build(reader, item)) m_ItemStack.push_back(item);
+            });
+            const size_t count = m_ItemStack.size() - mark;
+            auto* items = static_cast<JsonNode*>(Allocate(count * sizeof(JsonNode), alignof(JsonNode)));
+            std::copy(m_ItemStack.begin() + static_cast<ptrdiff_t>(mark), m_ItemStack.end(), items);
+            m_ItemStack.resize(mark);
+            node.m_Type = JsonType::Array;
+            node.m_Items = items;
+            node.m_Size = static_cast<uint32_t>(count);
+            break;
+        }
+        case JsonType::Object: {
+            const size_t mark = m_MemberStack.size();
+            reader.Object([&](std::string_view key) {
+                JsonMember member{Store(key), JsonNode()};
+                if (Build(reader, member.value)) m_MemberStack.push_back(member);
+            });
+            const size_t count = m_MemberStack.size() - mark;
+            auto* members = static_cast<JsonMember*>(Allocate(count * sizeof(JsonMember), alignof(JsonMember)));
+            std::copy(m_MemberStack.begin() + static_cast<ptrdiff_t>(mark), m_MemberStack.end(), members);
+            m_MemberStack.resize(mark);
+            node.m_Type = JsonType::Object;
+            node.m_Members = members;
+            node.m_Size = static_cast<uint32_t>(count);
+            break;
+        }
+    }
+    return !reader.Failed();
+}
+
+// --- JsonWriter ---
+
+void JsonWriter::Separate() {
+    if (m_NeedComma) m_Out += ',';
+}
+
+JsonWriter& JsonWriter::Open(char c) {
+    Separate();
+    m_Out += c;
+    m_NeedComma = false;
+    return *this;
+}
+
+JsonWriter& JsonWriter::Close(char c) {
+    m_Out += c;
+    m_NeedComma = true;
+    return *this;
+}
+
+JsonWriter& JsonWriter::Key(std::string_view key) {
+    Separate();
+    AppendEscaped(key);
+    m_Out += ':';
+    m_NeedComma = false;
+    return *this;
+}
+
+JsonWriter& JsonWriter::String(std::string_view value) {
+    Separate();
+    AppendEscaped(value);
+    m_NeedComma = true;
+    return *this;
+}
+
+JsonWriter& JsonWriter::Int(int64_t value) {
+    Separate();
+    char buffer[24];
+    auto [end, ec] = std::to_chars(buffer, buffer + sizeof(buffer), value);
+    m_Out.append(buffer, end);
+    m_NeedComma = true;
+    return *this;
+}
+
+JsonWriter& JsonWriter::Number(double value) {
+    if (!std::isfinite(value)) return Null();
+    if (std::trunc(value) == value && std::abs(value) < MAX_EXACT_INTEGER) return Int(static_cast<int64_t>(value));
+    Separate();
+    char buffer[32];
+    const auto result = std::to_chars(buffer, buffer + sizeof(buffer), value);
+    m_Out.append(buffer, result.ptr);
+    m_NeedComma = true;
+    return *this;
+}
+
+JsonWriter& JsonWriter::Number(float value) {
+    if (!std::isfinite(value)) return Null();
+    if (std::trunc(value) == value && std::abs(value) < MAX_EXACT_INTEGER) return Int(static_cast<int64_t>(value));
+    Separate();
+    char buffer[32];
+    const auto result = std::to_chars(buffer, buffer + sizeof(buffer), value);
+    m_Out.append(buffer, result.ptr);
+    m_NeedComma = true;
+    return *this;
+}
+
+JsonWriter& JsonWriter::Bool(bool value) {
+    Separate();
+    m_Out += value ? "true" : "false";
+    m_NeedComma = true;
+    return *this;
+}
+
+JsonWriter& JsonWriter::Null() {
+    Separate();
+    m_Out += "null";
+    m_NeedComma = true;
+    return *this;
+}
+
+// Runs without escapes are appended whole
+void JsonWriter::AppendEscaped(std::string_view text) {
+    m_Out += '"';
+    size_t run = 0;
+    for (size_t i = 0; i < text.size(); ++i) {
+        const unsigned char c = static_cast<unsigned char>(text[i]);
+        if (c >= 0x20 && c != '"' && c != '\\') continue;
+        m_Out.append(text.data() + run, i - run);
+        run = i + 1;
+        switch (c) {
+            case '"': m_Out += "\\\""; break;
+            case '\\': m_Out += "\\\\"; break;
+            case '\n': m_Out += "\\n"; break;
+            case '\r': m_Out += "\\r"; break;
+            case '\t': m_Out += "\\t"; break;
+            case '\b': m_Out += "\\b"; break;
+            case '\f': m_Out += "\\f"; break;
+            default: {
+                char escaped[8];
+                std::snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+                m_Out += escaped;
+                break;
+            }
+        }
+    }
+    m_Out.append(text.data() + run, text.size() - run);
+    m_Out += '"';
+}
+
+} // namespace sol
@@ -1,266 +1,227 @@
 #pragma once
 
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <span>
 #include <string>
-#include <map>
+#include <string_view>
 #include <vector>
-#include <variant>
-#include <optional>
-#include <sstream>
 
-// Minimal JSON helper for LSP
-// Note: In a real production codebase, use nlohmann/json or rapidjson.
-// This is a lightweight implementation to avoid adding a large dependency in this session.
+// JSON for LSP traffic and config files, in three parts:
+// - JsonReader pulls values straight out of the text and skips what it is not asked for.
+// - JsonDocument is a read-only tree laid out in an arena.
+// - JsonWriter appends to a reusable buffer.
 
 namespace sol {
 
 enum class JsonType { Null, Bool, Number, String, Array, Object };
 
-struct JsonValue;
-
-using JsonObject = std::map<std::string, JsonValue>;
-using JsonArray = std::vector<JsonValue>;
-
-struct JsonValue {
-    JsonType type = JsonType::Null;
-    
-    std::variant<std::monostate, bool, double, std::string, JsonArray, JsonObject> data;
-    
-    JsonValue() = default;
-    JsonValue(bool v) : type(JsonType::Bool), data(v) {}
-    JsonValue(int v) : type(JsonType::Number), data(static_cast<double>(v)) {}
-    JsonValue(double v) : type(JsonType::Number), data(v) {}
-    JsonValue(const char* v) : type(JsonType::String), data(std::string(v)) {}
-    JsonValue(const std::string& v) : type(JsonType::String), data(v) {}
-    JsonValue(const JsonArray& v) : type(JsonType::Array), data(v) {}
-    JsonValue(const JsonObject& v) : type(JsonType::Object), data(v) {}
-    
-    // Helpers
-    std::string ToString() const {
-        if (type == JsonType::String) return std::get<std::string>(data);
-        return "";
-    }
-    
-    int ToInt() const {
-        if (type == JsonType::Number) return static_cast<int>(std::get<double>(data));
-        return 0;
-    }
-    
-    bool ToBool() const {
-        if (type == JsonType::Bool) return std::get<bool>(data);
-        return false;
-    }
+// Pull parser over text that must outlive it. Every read consumes one value;
+// a read of the wrong type skips the value and returns a default. Strings are
+// views into the text, or into scratch memory valid until the next read when
+// they hold escapes.
+class JsonReader {
+public:
+    explicit JsonReader(std::string_view text) : m_Text(text) {}
 
-    const JsonObject& AsObject() const {
-        static JsonObject empty;
-        if (type == JsonType::Object) return std::get<JsonObject>(data);
-        return empty;
-    }
-    
-    const JsonArray& AsArray() const {
-        static JsonArray empty;
-        if (type == JsonType::Array) return std::get<JsonArray>(data);
-        return empty;
-    }
+    // Type of the next value; Null at the end of the text
+    JsonType Peek();
+    std::string_view String();
+    double Number();
+    int Int() { return static_cast<int>(Number()); }
+    bool Bool();
+    // Consumes the next value and returns its raw text
+    std::string_view Skip();
 
-    bool Has(const std::string& key) const {
-        if (type != JsonType::Object) return false;
-        const auto& obj = std::get<JsonObject>(data);
-        return obj.find(key) != obj.end();
-    }
-    
-    const JsonValue& operator[](const std::string& key) const {
-        static JsonValue nullVal;
-        if (type != JsonType::Object) return nullVal;
-        const auto& obj = std::get<JsonObject>(data);
-        auto it = obj.find(key);
-        if (it != obj.end()) return it->second;
-        return nullVal;
-    }
+    // Calls onMember(key) for each member with the value next; members the
+    // callback leaves unread are skipped. The key is valid until the value
+    // is read. False if the value is not an object or the text is malformed.
+    template <typename F>
+    bool Object(F&& onMember);
+    // Calls onItem() for each element, skipping those left unread
+    template <typename F>
+    bool Array(F&& onItem);
+
+    bool Failed() const { return m_Failed; }
+    // Only whitespace remains
+    bool AtEnd();
+
+private:
+    void SkipWhitespace();
+    // Consumes open, or skips a value of another type and returns false
+    bool Enter(char open);
+    // After a member or element: true at ',', false once close is consumed
+    bool Continue(char close);
+    bool ReadKey(std::string_view& key);
+    bool ReadString(std::string_view& out, std::string& scratch);
+    bool SkipString();
+    bool Fail();
+
+    std::string_view m_Text;
+    size_t m_Pos = 0;
+    bool m_Failed = false;
+    std::string m_Scratch;
+    std::string m_KeyScratch;
 };
 
-class Json {
+template <typename F>
+bool JsonReader::Object(F&& onMember) {
+    if (!Enter('{')) return false;
+    SkipWhitespace();
+    if (m_Pos < m_Text.size() && m_Text[m_Pos] == '}') {
+        ++m_Pos;
+        return true;
+    }
+    do {
+        std::string_view key;
+        if (!ReadKey(key)) return false;
+        const size_t start = m_Pos;
+        onMember(key);
+        if (m_Failed) return false;
+        if (m_Pos == start) Skip();
+    } while (Continue('}'));
+    return !m_Failed;
+}
+
+template <typename F>
+bool JsonReader::Array(F&& onItem) {
+    if (!Enter('[')) return false;
+    SkipWhitespace();
+    if (m_Pos < m_Text.size() && m_Text[m_Pos] == ']') {
+        ++m_Pos;
+        return true;
+    }
+    do {
+        const size_t start = m_Pos;
+        onItem();
+        if (m_Failed) return false;
+        if (m_Pos == start) Skip();
+    } while (Continue(']'));
+    return !m_Failed;
+}
+
+struct JsonMember;
+
+// A value inside a JsonDocument, valid while the document is
+class JsonNode {
 public:
-    static std::string Serialize(const JsonValue& value) {
-        std::stringstream ss;
-        Serialize(value, ss);
-        return ss.str();
-    }
-    
-    static JsonValue Parse(const std::string& json) {
-        size_t pos = 0;
-        return ParseValue(json, pos);
-    }
-    
+    JsonNode() : m_Number(0) {}
+
+    JsonType Type() const { return m_Type; }
+    bool IsNull() const { return m_Type == JsonType::Null; }
+    bool IsObject() const { return m_Type == JsonType::Object; }
+    bool IsArray() const { return m_Type == JsonType::Array; }
+    bool IsNumber() const { return m_Type == JsonType::Number; }
+    bool IsString() const { return m_Type == JsonType::String; }
+    bool IsBool() const { return m_Type == JsonType::Bool; }
+
+    // The fallback when the value has another type
+    std::string_view AsString() const { return IsString() ? std::string_view(m_String, m_Size) : std::string_view(); }
+    double AsNumber(double fallback = 0.0) const { return IsNumber() ? m_Number : fallback; }
+    int AsInt(int fallback = 0) const { return IsNumber() ? static_cast<int>(m_Number) : fallback; }
+    bool AsBool(bool fallback = false) const { return IsBool() ? m_Bool : fallback; }
+
+    std::span<const JsonNode> Items() const;
+    std::span<const JsonMember> Members() const;
+    bool Has(std::string_view key) const;
+    // A null node when the member is missing
+    const JsonNode& operator[](std::string_view key) const;
+
 private:
-    static void Serialize(const JsonValue& val, std::stringstream& ss) {
-        switch (val.type) {
-            case JsonType::Null: ss << "null"; break;
-            case JsonType::Bool: ss << (std::get<bool>(val.data) ? "true" : "false"); break;
-            case JsonType::Number: ss << std::get<double>(val.data); break;
-            case JsonType::String: {
-                ss << "\"";
-                for (char c : std::get<std::string>(val.data)) {
-                    if (c == '"') ss << "\\\"";
-                    else if (c == '\\') ss << "\\\\";
-                    else if (c == '\b') ss << "\\b";
-                    else if (c == '\f') ss << "\\f";
-                    else if (c == '\n') ss << "\\n";
-                    else if (c == '\r') ss << "\\r";
-                    else if (c == '\t') ss << "\\t";
-                    else ss << c;
-                }
-                ss << "\"";
-                break;
-            }
-            case JsonType::Array: {
-                ss << "[";
-                const auto& arr = std::get<JsonArray>(val.data);
-                for (size_t i = 0; i < arr.size(); ++i) {
-                    if (i > 0) ss << ",";
-                    Serialize(arr[i], ss);
-                }
-                ss << "]";
-                break;
-            }
-            case JsonType::Object: {
-                ss << "{";
-                const auto& obj = std::get<JsonObject>(val.data);
-                bool first = true;
-                for (const auto& [k, v] : obj) {
-                    if (!first) ss << ",";
-                    ss << "\"" << k << "\":";
-                    Serialize(v, ss);
-                    first = false;
-                }
-                ss << "}";
-                break;
-            }
-        }
-    }
-    
-    static void SkipWhitespace(const std::string& json, size_t& pos) {
-        while (pos < json.length() && std::isspace(json[pos])) pos++;
-    }
-    
-    static JsonValue ParseValue(const std::string& json, size_t& pos) {
-        SkipWhitespace(json, pos);
-        if (pos >= json.length()) return JsonValue();
-        
-        char c = json[pos];
-        if (c == '{') return ParseObject(json, pos);
-        if (c == '[') return ParseArray(json, pos);
-        if (c == '"') return ParseString(json, pos);
-        if (c == 't' || c == 'f') return ParseBool(json, pos);
-        if (c == 'n') return ParseNull(json, pos);
-        if (std::isdigit(c) || c == '-') return ParseNumber(json, pos);
-        
-        return JsonValue();
-    }
-    
-    static JsonValue ParseString(const std::string& json, size_t& pos) {
-        pos++; // quote
-        std::string str;
-        while (pos < json.length()) {
-            char c = json[pos];
-            if (c == '"') {
-                pos++;
-                return JsonValue(str);
-            }
-            if (c == '\\') {
-                pos++;
-                if (pos >= json.length()) break;
-                char escaped = json[pos];
-                switch (escaped) {
-                    case '"': str += '"'; break;
-                    case '\\': str += '\\'; break;
-                    case 'n': str += '\n'; break;
-                    case 't': str += '\t'; break;
-                    case 'r': str += '\r'; break;
-                    case 'b': str += '\b'; break;
-                    case 'f': str += '\f'; break;
-                    default: str += escaped; break;
-                }
-            } else {
-                str += c;
-            }
-            pos++;
-        }
-        return JsonValue(str);
-    }
-    
-    static JsonValue ParseNumber(const std::string& json, size_t& pos) {
-        size_t start = pos;
-        if (json[pos] == '-') pos++;
-        while (pos < json.length() && std::isdigit(json[pos])) pos++;
-        if (pos < json.length() && json[pos] == '.') {
-            pos++;
-            while (pos < json.length() && std::isdigit(json[pos])) pos++;
-        }
-        std::string numStr = json.substr(start, pos - start);
-        return JsonValue(std::stod(numStr));
-    }
-    
-    static JsonValue ParseBool(const std::string& json, size_t& pos) {
-        if (json.compare(pos, 4, "true") == 0) {
-            pos += 4;
-            return JsonValue(true);
-        }
-        if (json.compare(pos, 5, "false") == 0) {
-            pos += 5;
-            return JsonValue(false);
-        }
-        return JsonValue();
-    }
-    
-    static JsonValue ParseNull(const std::string& json, size_t& pos) {
-        if (json.compare(pos, 4, "null") == 0) {
-            pos += 4;
-        }
-        return JsonValue();
-    }
-    
-    static JsonValue ParseObject(const std::string& json, size_t& pos) {
-        JsonObject obj;
-        pos++; // {
-        while (pos < json.length()) {
-            SkipWhitespace(json, pos);
-            if (json[pos] == '}') {
-                pos++;
-                return JsonValue(obj);
-            }
-            
-            JsonValue keyVal = ParseString(json, pos); // Parse key
-            std::string key = keyVal.ToString();
-            
-            SkipWhitespace(json, pos);
-            if (json[pos] == ':') pos++;
-            
-            JsonValue val = ParseValue(json, pos);
-            obj[key] = val;
-            
-            SkipWhitespace(json, pos);
-            if (json[pos] == ',') pos++;
-        }
-        return JsonValue(obj);
-    }
-    
-    static JsonValue ParseArray(const std::string& json, size_t& pos) {
-        JsonArray arr;
-        pos++; // [
-        while (pos < json.length()) {
-            SkipWhitespace(json, pos);
-            if (json[pos] == ']') {
-                pos++;
-                return JsonValue(arr);
-            }
-            
-            arr.push_back(ParseValue(json, pos));
-            
-            SkipWhitespace(json, pos);
-            if (json[pos] == ',') pos++;
-        }
-        return JsonValue(arr);
+    friend class JsonDocument;
+
+    JsonType m_Type = JsonType::Null;
+    uint32_t m_Size = 0;  // String length, or element or member count
+    union {
+        bool m_Bool;
+        double m_Number;
+        const char* m_String;
+        const JsonNode* m_Items;
+        const JsonMember* m_Members;
+    };
+};
+
+struct JsonMember {
+    std::string_view key;
+    JsonNode value;
+};
+
+inline std::span<const JsonNode> JsonNode::Items() const {
+    return IsArray() ? std::span<const JsonNode>(m_Items, m_Size) : std::span<const JsonNode>();
+}
+
+inline std::span<const JsonMember> JsonNode::Members() const {
+    return IsObject() ? std::span<const JsonMember>(m_Members, m_Size) : std::span<const JsonMember>();
+}
+
+// A parsed tree whose nodes, strings and keys share a few large blocks.
+// Parsing again reuses the memory of the previous tree.
+class JsonDocument {
+public:
+    JsonDocument() = default;
+    JsonDocument(const JsonDocument&) = delete;
+    JsonDocument& operator=(const JsonDocument&) = delete;
+
+    // False when text is not one JSON value; the root is then null
+    bool Parse(std::string_view text);
+    const JsonNode& Root() const { return m_Root; }
+
+private:
+    static constexpr size_t BLOCK_SIZE = 64 * 1024;
+
+    void* Allocate(size_t bytes, size_t align);
+    void ResetArena();
+    std::string_view Store(std::string_view text);
+    bool Build(JsonReader& reader, JsonNode& node);
+
+    struct Block {
+        std::unique_ptr<std::byte[]> data;
+        size_t size = 0;
+    };
+    std::vector<Block> m_Blocks;
+    size_t m_Used = 0;  // Bytes taken from the last block
+    size_t m_Total = 0;
+
+    // Containers gather their children here and move them into the arena whole
+    std::vector<JsonNode> m_ItemStack;
+    std::vector<JsonMember> m_MemberStack;
+
+    JsonNode m_Root;
+};
+
+// Compact JSON appended to a buffer that keeps its capacity across messages.
+// Commas are placed automatically; keys are only valid inside objects.
+class JsonWriter {
+public:
+    void Clear() {
+        m_Out.clear();
+        m_NeedComma = false;
     }
+    const std::string& Str() const { return m_Out; }
+
+    JsonWriter& BeginObject() { return Open('{'); }
+    JsonWriter& EndObject() { return Close('}'); }
+    JsonWriter& BeginArray() { return Open('['); }
+    JsonWriter& EndArray() { return Close(']'); }
+    JsonWriter& Key(std::string_view key);
+
+    JsonWriter& String(std::string_view value);
+    JsonWriter& Int(int64_t value);
+    // Shortest text that reads back as the same value
+    JsonWriter& Number(double value);
+    JsonWriter& Number(float value);
+    JsonWriter& Bool(bool value);
+    JsonWriter& Null();
+
+private:
+    JsonWriter& Open(char c);
+    JsonWriter& Close(char c);
+    void Separate();
+    void AppendEscaped(std::string_view text);
+
+    std::string m_Out;
+    bool m_NeedComma = false;
 };
 
 } // namespace sol
@@ -0,0 +1,379 @@
+#include "workspace_files.h"
+#include "ignore_rules.h"
+#include "job_system.h"
+#include <atomic>
+#include <cctype>
+#include <chrono>
+#include <condition_variable>
+#include <cstdlib>
+#include <deque>
+#include <fstream>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+
+namespace sol {
+
+namespace {
+
+// In increasing precedence
+constexpr std::string_view IGNORE_FILES[] = {".gitignore", ".ignore"};
+
+// The ignore files in effect for a directory, innermost first
+struct IgnoreChain {
+    std::shared_ptr<const IgnoreRules> rules;
+    std::shared_ptr<const IgnoreChain> parent;
+};
+
+struct Ignores {
+    std::vector<std::shared_ptr<const IgnoreRules>> globals;  // Weakest last
+
+    bool IsIgnored(const IgnoreChain* chain, std::string_view relative, bool directory) const {
+        for (; chain; chain = chain->parent.get()) {
+            const IgnoreRules::Result result = chain->rules->Match(relative, directory);
+            if (result != IgnoreRules::Result::None) return result == IgnoreRules::Result::Ignore;
+        }
+        for (const auto& rules : globals) {
+            const IgnoreRules::Result result = rules->Match(relative, directory);
+            if (result != IgnoreRules::Result::None) return result == IgnoreRules::Result::Ignore;
+        }
+        return false;
+    }
+};
+
+std::string_view Trim(std::string_view text) {
+    while (!text.empty() && (text.front() == ' ' || text.front() == '\t')) text.remove_prefix(1);
+    while (!text.empty() && (text.back() == ' ' || text.back() == '\t' || text.back() == '\r')) text.remove_suffix(1);
+    return text;
+}
+
+bool EqualsFolded(std::string_view a, std::string_view b) {
+    if (a.size() != b.size()) return false;
+    for (size_t i = 0; i < a.size(); ++i) {
+        if (std::tolower(static_cast<unsigned char>(a[i])) != b[i]) return false;
+    }
+    return true;
+}
+
+// core.excludesFile from the user's git config, else git's default location
+std::filesystem::path GlobalExcludesFile() {
+    const char* home = std::getenv("HOME");
+    if (!home || !*home) home = std::getenv("USERPROFILE");
+    const char* xdg = std::getenv("XDG_CONFIG_HOME");
+    std::filesystem::path config;
+    if (xdg && *xdg) {
+        config = std::filesystem::path(xdg) / "git";
+    } else if (home && *home) {
+        config = std::filesystem::path(home) / ".config" / "git";
+    }
+
+    std::filesystem::path excludes;
+    std::vector<std::filesystem::path> files;
+    if (!config.empty()) files.push_back(config / "config");
+    if (home && *home) files.push_back(std::filesystem::path(home) / ".gitconfig");
+    for (const auto& file : files) {
+        std::ifstream stream(file);
+        bool core = false;
+        for (std::string line; std::getline(stream, line);) {
+            const std::string_view text = Trim(line);
+            if (text.starts_with('[')) {
+                core = EqualsFolded(Trim(text.substr(1, text.find(']') - 1)), "core");
+                continue;
+            }
+            const size_t equals = text.find('=');
+            if (!core || equals == std::string_view::npos || !EqualsFolded(Trim(text.substr(0, equals)), "excludesfile")) continue;
+            std::string_view value = Trim(text.substr(equals + 1));
+            if (value.size() >= 2 && value.front() == '"' && value.back() == '"') value = value.substr(1, value.size() - 2);
+            if (value.starts_with("~/") && home && *home) {
+                excludes = std::filesystem::path(home) / value.substr(2);
+            } else {
+                excludes = value;
+            }
+        }
+    }
+    if (excludes.empty() && !config.empty()) excludes = config / "ignore";
+    return excludes;
+}
+
+Ignores LoadIgnores(const std::filesystem::path& root) {
+    Ignores ignores;
+    if (auto rules = IgnoreRules::Load((root / ".git" / "info" / "exclude").string(), "")) ignores.globals.push_back(rules);
+    const std::filesystem::path global = GlobalExcludesFile();
+    if (!global.empty()) {
+        if (auto rules = IgnoreRules::Load(global.string(), "")) ignores.globals.push_back(rules);
+    }
+    return ignores;
+}
+
+std::shared_ptr<const IgnoreChain> Extend(std::shared_ptr<const IgnoreChain> chain, const std::filesystem::path& directory,
+                                          const std::string& relative, const bool (&present)[std::size(IGNORE_FILES)]) {
+    for (size_t i = 0; i < std::size(IGNORE_FILES); ++i) {
+        if (!present[i]) continue;
+        if (auto rules = IgnoreRules::Load((directory / IGNORE_FILES[i]).string(), relative)) {
+            chain = std::make_shared<IgnoreChain>(IgnoreChain{std::move(rules), std::move(chain)});
+        }
+    }
+    return chain;
+}
+
+std::shared_ptr<const IgnoreChain> Extend(std::shared_ptr<const IgnoreChain> chain, const std::filesystem::path& root,
+                                          const std::string& relative) {
+    bool present[std::size(IGNORE_FILES)];
+    for (size_t i = 0; i < std::size(IGNORE_FILES); ++i) {
+        std::error_code ec;
+        present[i] = std::filesystem::is_regular_file(root / relative / IGNORE_FILES[i], ec);
+    }
+    return Extend(std::move(chain), root / relative, relative, present);
+}
+
+// Directories waiting to be read sit in one deque per participating thread.
+// A thread takes the newest of its own and steals the oldest of another's,
+// so each works depth first while thieves take whole subtrees.
+class Walk {
+public:
+    struct Directory {
+        std::string relative;
+        std::shared_ptr<const IgnoreChain> ignores;
+    };
+
+    Walk(std::filesystem::path root, Ignores ignores, size_t threads,
+         const std::function<bool()>& cancelled, const WorkspaceFilesCallback& onFiles)
+        : m_Root(std::move(root)), m_Ignores(std::move(ignores)), m_Queues(threads),
+          m_Cancelled(cancelled), m_OnFiles(onFiles) {}
+
+    void Push(size_t slot, Directory directory) {
+        m_Pending.fetch_add(1, std::memory_order_relaxed);
+        {
+            std::lock_guard<std::mutex> lock(m_Queues[slot].mutex);
+            m_Queues[slot].items.push_back(std::move(directory));
+        }
+        m_Queued.fetch_add(1, std::memory_order_release);
+        if (m_Sleeping.load(std::memory_order_acquire) > 0) {
+            std::lock_guard<std::mutex> lock(m_IdleMutex);
+            m_Idle.notify_one();
+        }
+    }
+
+    void Work(size_t slot) {
+        Directory directory;
+        while (true) {
+            if (Pop(slot, directory)) {
+                if (!m_Stopped.load(std::memory_order_relaxed)) {
+                    if (m_Cancelled()) {
+                        m_Stopped.store(true, std::memory_order_relaxed);
+                    } else {
+                        Read(slot, directory);
+                    }
+                }
+                directory = {};
+                if (m_Pending.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+                    std::lock_guard<std::mutex> lock(m_IdleMutex);
+                    m_Idle.notify_all();
+                }
+                continue;
+            }
+            std::unique_lock<std::mutex> lock(m_IdleMutex);
+            if (m_Pending.load(std::memory_order_acquire) == 0) return;
+            m_Sleeping.fetch_add(1, std::memory_order_acq_rel);
+            // The timeout covers a push racing past the sleeper count
+            m_Idle.wait_for(lock, std::chrono::milliseconds(1), [this] {
+                return m_Pending.load(std::memory_order_acquire) == 0 || m_Queued.load(std::memory_order_acquire) > 0;
+            });
+            m_Sleeping.fetch_sub(1, std::memory_order_acq_rel);
+        }
+    }
+
+    // Helpers that start after the caller finished must not touch the callbacks
+    bool Join() {
+        std::lock_guard<std::mutex> lock(m_JoinMutex);
+        if (m_Closed) return false;
+        ++m_Joined;
+        return true;
+    }
+
+    void Leave() {
+        std::lock_guard<std::mutex> lock(m_JoinMutex);
+        if (--m_Joined == 0) m_Left.notify_all();
+    }
+
+    void Close() {
+        std::unique_lock<std::mutex> lock(m_JoinMutex);
+        m_Closed = true;
+        m_Left.wait(lock, [this] { return m_Joined == 0; });
+    }
+
+    bool Finished() const { return !m_Stopped.load(std::memory_order_relaxed); }
+
+private:
+    struct Queue {
+        std::mutex mutex;
+        std::deque<Directory> items;
+    };
+
+    bool Pop(size_t slot, Directory& out) {
+        if (m_Queued.load(std::memory_order_acquire) == 0) return false;
+        for (size_t i = 0; i < m_Queues.size(); ++i) {
+            Queue& queue = m_Queues[(slot + i) % m_Queues.size()];
+            std::lock_guard<std::mutex> lock(queue.mutex);
+            if (queue.items.empty()) continue;
+            if (i == 0) {
+                out = std::move(queue.items.back());
+                queue.items.pop_back();
+            } else {
+                out = std::move(queue.items.front());
+                queue.items.pop_front();
+            }
+            m_Queued.fetch_sub(1, std::memory_order_relaxed);
+            return true;
+        }
+        return false;
+    }
+
+    void Read(size_t slot, const Directory& directory) {
+        const std::filesystem::path path = m_Root / directory.relative;
+        std::error_code ec;
+        std::filesystem::directory_iterator it(path, std::filesystem::directory_options::skip_permission_denied, ec);
+        if (ec) return;
+
+        std::vector<std::string> files;
+        std::vector<std::string> directories;
+        bool present[std::size(IGNORE_FILES)] = {};
+        for (const std::filesystem::directory_iterator end; it != end; it.increment(ec)) {
+            if (ec) break;
+            std::string name = it->path().filename().string();
+            if (name.empty() || name[0] == '.') {
+                for (size_t i = 0; i < std::size(IGNORE_FILES); ++i) present[i] |= name == IGNORE_FILES[i];
+                continue;
+            }
+            std::error_code typeError;
+            std::filesystem::file_type type = it->symlink_status(typeError).type();
+            if (type == std::filesystem::file_type::symlink) {
+                type = it->status(typeError).type();
+                if (type != std::filesystem::file_type::regular) continue;
+            }
+            if (typeError) continue;
+            if (type == std::filesystem::file_type::regular) {
+                files.push_back(std::move(name));
+            } else if (type == std::filesystem::file_type::directory) {
+                directories.push_back(std::move(name));
+            }
+        }
+
+        const std::shared_ptr<const IgnoreChain> ignores = Extend(directory.ignores, path, directory.relative, present);
+        std::string candidate = directory.relative;
+        for (const std::string& name : directories) {
+            candidate.resize(directory.relative.size());
+            candidate += name;
+            if (m_Ignores.IsIgnored(ignores.get(), candidate, true)) continue;
+            Push(slot, {candidate + '/', ignores});
+        }
+        std::erase_if(files, [&](const std::string& name) {
+            candidate.resize(directory.relative.size());
+            candidate += name;
+            return m_Ignores.IsIgnored(ignores.get(), candidate, false);
+        });
+        m_OnFiles(directory.relative, files);
+    }
+
+    const std::filesystem::path m_Root;
+    const Ignores m_Ignores;
+    std::vector<Queue> m_Queues;
+    std::atomic<size_t> m_Pending{0};  // Directories queued or being read
+    std::atomic<size_t> m_Queued{0};
+    std::atomic<size_t> m_Sleeping{0};
+    std::atomic<bool> m_Stopped{false};
+    std::mutex m_IdleMutex;
+    std::condition_variable m_Idle;
+
+    const std::function<bool()>& m_Cancelled;
+    const WorkspaceFilesCallback& m_OnFiles;
+    std::mutex m_JoinMutex;
+    std::condition_variable m_Left;
+    size_t m_Joined = 0;
+    bool m_Closed = false;
+};
+
+// The ignore files of relative's ancestors, the ones its entries inherit
+std::shared_ptr<const IgnoreChain> LoadChain(const std::filesystem::path& root, const std::filesystem::path& relative) {
+    std::shared_ptr<const IgnoreChain> chain;
+    std::string prefix;
+    for (const auto& part : relative) {
+        if (part.empty()) continue;
+        chain = Extend(std::move(chain), root, prefix);
+        prefix += part.generic_string();
+        prefix += '/';
+    }
+    return chain;
+}
+
+} // namespace
+
+bool WalkWorkspace(const std::filesystem::path& root, const std::filesystem::path& start,
+                   const std::function<bool()>& cancelled, const WorkspaceFilesCallback& onFiles) {
+    std::string relative = start.lexically_normal().generic_string();
+    if (relative == ".") relative.clear();
+    if (!relative.empty() && relative.back() != '/') relative += '/';
+
+    const size_t helpers = JobSystem::GetWorkerCount();
+    auto walk = std::make_shared<Walk>(root, LoadIgnores(root), helpers + 1, cancelled, onFiles);
+    walk->Push(0, {relative, LoadChain(root, relative)});
+    for (size_t slot = 1; slot <= helpers; ++slot) {
+        JobSystem::Submit(JobPriority::Background, [walk, slot] {
+            if (!walk->Join()) return;
+            walk->Work(slot);
+            walk->Leave();
+        });
+    }
+    walk->Work(0);
+    walk->Close();
+    return walk->Finished();
+}
+
+std::vector<std::filesystem::path> ListWorkspaceFiles(const std::filesystem::path& root,
+                                                      const std::function<bool()>& cancelled) {
+    std::mutex mutex;
+    std::vector<std::filesystem::path> collected;
+    WalkWorkspace(root, {}, cancelled, [&](std::string_view directory, const std::vector<std::string>& names) {
+        const std::filesystem::path base = root / directory;
+        std::lock_guard<std::mutex> lock(mutex);
+        for (const std::string& name : names) collected.push_back(base / name);
+    });
+    return collected;
+}
+
+struct WorkspaceIgnoreFilter::State {
+    std::filesystem::path root;
+    Ignores ignores;
+    // Chains in effect inside each directory checked so far
+    std::unordered_map<std::string, std::shared_ptr<const IgnoreChain>> chains;
+};
+
+WorkspaceIgnoreFilter::WorkspaceIgnoreFilter(const std::filesystem::path& root)
+    : m_State(std::make_unique<State>(State{root, LoadIgnores(root), {}})) {}
+
+WorkspaceIgnoreFilter::~WorkspaceIgnoreFilter() = default;
+
+bool WorkspaceIgnoreFilter::IsIgnored(const std::filesystem::path& relative, bool directory) {
+    auto chainFor = [this](const std::string& prefix, const std::shared_ptr<const IgnoreChain>& parent) {
+        auto [it, inserted] = m_State->chains.try_emplace(prefix);
+        if (inserted) it->second = Extend(parent, m_State->root, prefix);
+        return it->second;
+    };
+
+    std::string prefix;
+    std::shared_ptr<const IgnoreChain> chain = chainFor(prefix, nullptr);
+    for (auto it = relative.begin(); it != relative.end(); ++it) {
+        const std::string name = it->generic_string();
+        if (name.empty()) continue;
+        const bool last = std::next(it) == relative.end();
+        if (name[0] == '.') return true;
+        prefix += name;
+        if (m_State->ignores.IsIgnored(chain.get(), prefix, directory || !last)) return true;
+        prefix += '/';
+        if (!last) chain = chainFor(prefix, chain);
+    }
+    return false;
+}
+
+} // namespace sol
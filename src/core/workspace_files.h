@@ -0,0 +1,47 @@
+#pragma once
+
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace sol {
+
+// Receives each directory walked, relative to the walk root ('/' separators,
+// a trailing '/', empty at the root), with the names of its files that are
+// not ignored, possibly none. Called from several threads at once.
+using WorkspaceFilesCallback = std::function<void(std::string_view directory, const std::vector<std::string>& names)>;
+
+// Walks the regular files under root/start, which is relative to root, in
+// parallel on JobSystem workers with work stealing; the calling thread walks
+// too, so calling from a job is safe. Hidden entries are skipped, as is
+// anything matched by .gitignore and .ignore files, .git/info/exclude or the
+// global git excludes file. Symlinked directories are not followed. False when
+// cancelled returned true before the walk finished.
+bool WalkWorkspace(const std::filesystem::path& root, const std::filesystem::path& start,
+                   const std::function<bool()>& cancelled, const WorkspaceFilesCallback& onFiles);
+
+// Every file WalkWorkspace reports under root, unordered
+std::vector<std::filesystem::path> ListWorkspaceFiles(const std::filesystem::path& root,
+                                                      const std::function<bool()>& cancelled);
+
+// Answers whether WalkWorkspace would skip a file or directory given relative
+// to root, reading each ignore file once however many paths are checked
+class WorkspaceIgnoreFilter {
+public:
+    explicit WorkspaceIgnoreFilter(const std::filesystem::path& root);
+    ~WorkspaceIgnoreFilter();
+
+    WorkspaceIgnoreFilter(const WorkspaceIgnoreFilter&) = delete;
+    WorkspaceIgnoreFilter& operator=(const WorkspaceIgnoreFilter&) = delete;
+
+    bool IsIgnored(const std::filesystem::path& relative, bool directory);
+
+private:
+    struct State;
+    std::unique_ptr<State> m_State;
+};
+
+} // namespace sol
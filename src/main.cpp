@@ -1,9 +1,11 @@
 #include "core/application.h"
 #include "core/logger.h"
+#include "core/startup_trace.h"
 
 using sol::Logger;
 
 int main(int argc, char* argv[]) {
+    sol::StartupTrace::GetInstance().Begin();
     Logger::SetLogFile("sol.log");
     Logger::Info("Sol application starting");
     
@@ -1,10 +1,17 @@
 #include "editor_settings.h"
 #include "core/utils/json.h"
+#include "core/utils/hash.h"
 #include "core/logger.h"
+#include "core/parallel.h"
+#include "core/platform/atomic_file.h"
+#include "core/platform/mapped_file.h"
 #include <imgui.h>
 #include <fstream>
+#include <iterator>
 #include <cstdlib>
+#include <cstring>
 #include <algorithm>
+#include <type_traits>
 #include <unordered_map>
 
 namespace sol {
@@ -92,6 +99,10 @@ std::vector<KeybindEntry> GetDefaultKeybindings() {
         // Undo/Redo (Command mode, single keys)
         {"u", "undo", "Global"},
         {"r", "redo", "Global"},
+        // Macros (Command mode, single keys): q starts and stops recording,
+        // Q replays, a count typed first repeating it
+        {"q", "macro_record", "Global"},
+        {"Q", "macro_replay", "Global"},
         // Leader commands
         {"Leader q", "exit", "Global"},
         {"Leader o", "open_file_dialog", "Global"},
@@ -116,6 +127,8 @@ std::vector<KeybindEntry> GetDefaultKeybindings() {
         {"Leader w n", "open_in_new_instance", "Global"},
         // Telescope
         {"Leader f f", "telescope_find_files", "Global"},
+        // Diagnostics
+        {"Leader p p", "toggle_perf_hud", "Global"},
         // Tab cycling (context-aware: buffers or terminal tabs)
         {"Tab", "cycle_next", "Global"},
         {"Shift+Tab", "cycle_prev", "Global"},
@@ -472,54 +485,325 @@ std::filesystem::path EditorSettings::GetBehaviorPath() {
     return GetConfigDir() / "behavior.json";
 }
 
-// Helper to serialize ImVec4 to JSON array
-static JsonValue Vec4ToJson(const ImVec4& v) {
-    JsonArray arr;
-    arr.push_back(JsonValue(static_cast<double>(v.x)));
-    arr.push_back(JsonValue(static_cast<double>(v.y)));
-    arr.push_back(JsonValue(static_cast<double>(v.z)));
-    arr.push_back(JsonValue(static_cast<double>(v.w)));
-    return JsonValue(arr);
+std::filesystem::path EditorSettings::GetSnapshotPath() {
+    return GetConfigDir() / "settings.cache";
 }
 
-// Helper to serialize ImVec2 to JSON array
-static JsonValue Vec2ToJson(const ImVec2& v) {
-    JsonArray arr;
-    arr.push_back(JsonValue(static_cast<double>(v.x)));
-    arr.push_back(JsonValue(static_cast<double>(v.y)));
-    return JsonValue(arr);
+// --- Settings Snapshot ---
+// Layout: SNAPSHOT_MAGIC, SNAPSHOT_VERSION, the hash of the defaults, a
+// stamp per file, then the theme, keybinds and behavior, in native byte
+// order with strings prefixed by their length
+
+namespace {
+
+constexpr char SNAPSHOT_MAGIC[8] = {'S', 'O', 'L', 'S', 'E', 'T', 'S', '1'};
+constexpr uint32_t SNAPSHOT_VERSION = 1;
+
+static_assert(std::is_trivially_copyable_v<ThemeColors> && std::is_trivially_copyable_v<ThemeStyle> &&
+              std::is_trivially_copyable_v<EditorColors>);
+
+template <typename T>
+void Put(std::string& out, const T& value) {
+    out.append(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+void PutString(std::string& out, const std::string& value) {
+    Put(out, static_cast<uint32_t>(value.size()));
+    out += value;
+}
+
+struct SnapshotReader {
+    std::string_view data;
+
+    template <typename T>
+    bool Get(T& value) {
+        if (data.size() < sizeof(value)) return false;
+        std::memcpy(&value, data.data(), sizeof(value));
+        data.remove_prefix(sizeof(value));
+        return true;
+    }
+
+    bool Get(std::string& value) {
+        uint32_t length = 0;
+        if (!Get(length) || data.size() < length) return false;
+        value.assign(data.data(), length);
+        data.remove_prefix(length);
+        return true;
+    }
+};
+
+void PutParts(std::string& out, const Theme& theme, const KeybindSettings& keybinds, const BehaviorSettings& behavior) {
+    PutString(out, theme.name);
+    Put(out, theme.colors);
+    Put(out, theme.style);
+    PutString(out, theme.font.fontId);
+    Put(out, theme.font.fontSize);
+    Put(out, theme.font.fontScale);
+    Put(out, theme.editor);
+
+    Put(out, static_cast<int32_t>(keybinds.leaderKey));
+    Put(out, static_cast<int32_t>(keybinds.modeKey));
+    Put(out, static_cast<int32_t>(keybinds.insertKey));
+    Put(out, static_cast<uint8_t>(keybinds.defaultMode));
+    Put(out, static_cast<uint32_t>(keybinds.bindings.size()));
+    for (const KeybindEntry& entry : keybinds.bindings) {
+        PutString(out, entry.keys);
+        PutString(out, entry.eventId);
+        PutString(out, entry.context);
+    }
+
+    // Field by field, as the padding between them holds no value
+    Put(out, behavior.scrollOffPercent);
+    Put(out, static_cast<uint8_t>(behavior.softWrap));
+    Put(out, static_cast<uint8_t>(behavior.minimap));
+    Put(out, static_cast<int32_t>(behavior.undoMemoryMB));
+    Put(out, static_cast<int32_t>(behavior.bufferMemoryMB));
+    Put(out, static_cast<int32_t>(behavior.syntaxIdleMinutes));
+    Put(out, static_cast<int32_t>(behavior.terminalScrollback));
+    Put(out, static_cast<int32_t>(behavior.terminalHistoryMB));
+    Put(out, static_cast<uint8_t>(behavior.previewHighlighting));
+}
+
+bool GetParts(SnapshotReader& in, Theme& theme, KeybindSettings& keybinds, BehaviorSettings& behavior) {
+    if (!in.Get(theme.name) || !in.Get(theme.colors) || !in.Get(theme.style) || !in.Get(theme.font.fontId) ||
+        !in.Get(theme.font.fontSize) || !in.Get(theme.font.fontScale) || !in.Get(theme.editor)) {
+        return false;
+    }
+
+    int32_t leader = 0, mode = 0, insert = 0;
+    uint8_t defaultMode = 0;
+    uint32_t count = 0;
+    if (!in.Get(leader) || !in.Get(mode) || !in.Get(insert) || !in.Get(defaultMode) ||
+        defaultMode > static_cast<uint8_t>(EditorInputMode::Search) || !in.Get(count) ||
+        count > in.data.size() / (3 * sizeof(uint32_t))) {
+        return false;
+    }
+    keybinds.leaderKey = static_cast<ImGuiKey>(leader);
+    keybinds.modeKey = static_cast<ImGuiKey>(mode);
+    keybinds.insertKey = static_cast<ImGuiKey>(insert);
+    keybinds.defaultMode = static_cast<EditorInputMode>(defaultMode);
+    keybinds.bindings.resize(count);
+    for (KeybindEntry& entry : keybinds.bindings) {
+        if (!in.Get(entry.keys) || !in.Get(entry.eventId) || !in.Get(entry.context)) return false;
+    }
+
+    uint8_t softWrap = 0, minimap = 0, previewHighlighting = 0;
+    int32_t undoMemory = 0, bufferMemory = 0, syntaxIdle = 0, scrollback = 0, historyMemory = 0;
+    if (!in.Get(behavior.scrollOffPercent) || !in.Get(softWrap) || !in.Get(minimap) || !in.Get(undoMemory) ||
+        !in.Get(bufferMemory) || !in.Get(syntaxIdle) || !in.Get(scrollback) || !in.Get(historyMemory) ||
+        !in.Get(previewHighlighting)) {
+        return false;
+    }
+    behavior.softWrap = softWrap;
+    behavior.minimap = minimap;
+    behavior.undoMemoryMB = undoMemory;
+    behavior.bufferMemoryMB = bufferMemory;
+    behavior.syntaxIdleMinutes = syntaxIdle;
+    behavior.terminalScrollback = scrollback;
+    behavior.terminalHistoryMB = historyMemory;
+    behavior.previewHighlighting = previewHighlighting;
+    return true;
+}
+
+// Files are parsed over the defaults, so a snapshot holds those too and only
+// suits a build with the same ones
+uint64_t DefaultsHash() {
+    static const uint64_t hash = [] {
+        KeybindSettings keybinds;
+        keybinds.bindings = GetDefaultKeybindings();
+        std::string parts;
+        PutParts(parts, Theme{}, keybinds, BehaviorSettings{});
+        return StreamHash::Of(parts);
+    }();
+    return hash;
+}
+
+void PutStamp(std::string& out, const SettingsFileStamp& stamp) {
+    Put(out, static_cast<uint8_t>(stamp.exists));
+    Put(out, stamp.time);
+    Put(out, stamp.size);
+    Put(out, stamp.hash);
+}
+
+bool GetStamp(SnapshotReader& in, SettingsFileStamp& stamp) {
+    uint8_t exists = 0;
+    if (!in.Get(exists) || !in.Get(stamp.time) || !in.Get(stamp.size) || !in.Get(stamp.hash)) return false;
+    stamp.exists = exists;
+    return true;
+}
+
+std::filesystem::path PathOf(EditorSettings::File file) {
+    switch (file) {
+    case EditorSettings::File::Theme: return EditorSettings::GetConfigPath();
+    case EditorSettings::File::Keybinds: return EditorSettings::GetKeybindsPath();
+    case EditorSettings::File::Behavior: return EditorSettings::GetBehaviorPath();
+    }
+    return {};
+}
+
+// Without the hash, which needs the contents
+SettingsFileStamp StatFile(const std::filesystem::path& path) {
+    SettingsFileStamp stamp;
+    std::error_code ec;
+    const uintmax_t size = std::filesystem::file_size(path, ec);
+    if (ec) return stamp;
+    const auto time = std::filesystem::last_write_time(path, ec);
+    if (ec) return stamp;
+    stamp.exists = true;
+    stamp.time = static_cast<int64_t>(time.time_since_epoch().count());
+    stamp.size = size;
+    return stamp;
+}
+
+bool ReadFile(const std::filesystem::path& path, std::string& out) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file) {
+        Logger::Error("Failed to open settings file: ", path);
+        return false;
+    }
+    out.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    return true;
+}
+
+} // namespace
+
+void EditorSettings::Load() {
+    static constexpr bool (EditorSettings::*loaders[FILE_COUNT])(const std::string*) = {
+        &EditorSettings::LoadTheme, &EditorSettings::LoadKeybinds, &EditorSettings::LoadBehavior,
+    };
+    SettingsFileStamp saved[FILE_COUNT];
+    Theme theme;
+    KeybindSettings keybinds;
+    BehaviorSettings behavior;
+    const bool snapshot = ReadSnapshot(saved, theme, keybinds, behavior);
+
+    // A file whose size or time moved is read, and parsed unless it holds
+    // the bytes the snapshot was taken from; each fills its own part
+    ParallelFor(0, FILE_COUNT, 1, [&](size_t first, size_t last) {
+        for (size_t i = first; i < last; ++i) {
+            const File file = static_cast<File>(i);
+            SettingsFileStamp stamp = StatFile(PathOf(file));
+            bool same = snapshot && stamp.exists == saved[i].exists && stamp.time == saved[i].time &&
+                        stamp.size == saved[i].size;
+            std::string json;
+            if (!same && stamp.exists) {
+                stamp.exists = ReadFile(PathOf(file), json);
+                stamp.hash = StreamHash::Of(json);
+                same = snapshot && stamp.exists && saved[i].exists && stamp.hash == saved[i].hash;
+            }
+            if (same) {
+                stamp.hash = saved[i].hash;
+                switch (file) {
+                case File::Theme: m_Theme = std::move(theme); break;
+                case File::Keybinds: m_Keybinds = std::move(keybinds); break;
+                case File::Behavior: m_Behavior = behavior; break;
+                }
+            } else {
+                (this->*loaders[i])(stamp.exists ? &json : nullptr);
+            }
+            m_Stamps[i] = stamp;
+        }
+    });
+
+    if (snapshot && std::equal(std::begin(saved), std::end(saved), std::begin(m_Stamps))) {
+        Logger::Info("Settings loaded from ", GetSnapshotPath());
+        return;
+    }
+    WriteSnapshot();
+}
+
+void EditorSettings::SaveDirty() {
+    if (m_Dirty == 0) return;
+    static constexpr bool (EditorSettings::*savers[FILE_COUNT])() = {
+        &EditorSettings::SaveTheme, &EditorSettings::SaveKeybinds, &EditorSettings::SaveBehavior,
+    };
+    bool saved = true;
+    for (size_t i = 0; i < FILE_COUNT; ++i) {
+        if (m_Dirty & (1u << i)) saved &= (this->*savers[i])();
+    }
+    m_Dirty = 0;
+    
+    // A part that failed to save would be taken for what its file holds
+    if (saved) {
+        WriteSnapshot();
+    } else {
+        std::error_code ec;
+        std::filesystem::remove(GetSnapshotPath(), ec);
+    }
+}
+
+void EditorSettings::Stamp(File file, std::string_view written) {
+    SettingsFileStamp& stamp = m_Stamps[static_cast<size_t>(file)];
+    stamp = StatFile(PathOf(file));
+    stamp.hash = StreamHash::Of(written);
+}
+
+bool EditorSettings::ReadSnapshot(SettingsFileStamp (&stamps)[FILE_COUNT], Theme& theme, KeybindSettings& keybinds,
+                                  BehaviorSettings& behavior) const {
+    auto file = MappedFile::Open(GetSnapshotPath());
+    if (!file) return false;
+    SnapshotReader in{std::string_view(file->Data(), file->Size())};
+    char magic[sizeof(SNAPSHOT_MAGIC)];
+    uint32_t version = 0;
+    uint64_t defaults = 0;
+    if (!in.Get(magic) || std::memcmp(magic, SNAPSHOT_MAGIC, sizeof(magic)) != 0 || !in.Get(version) ||
+        version != SNAPSHOT_VERSION || !in.Get(defaults) || defaults != DefaultsHash()) {
+        return false;
+    }
+    for (SettingsFileStamp& stamp : stamps) {
+        if (!GetStamp(in, stamp)) return false;
+    }
+    if (!GetParts(in, theme, keybinds, behavior) || !in.data.empty()) {
+        Logger::Warning("Ignoring corrupt settings snapshot: ", GetSnapshotPath());
+        return false;
+    }
+    return true;
+}
+
+void EditorSettings::WriteSnapshot() const {
+    std::string data(SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC));
+    Put(data, SNAPSHOT_VERSION);
+    Put(data, DefaultsHash());
+    for (const SettingsFileStamp& stamp : m_Stamps) PutStamp(data, stamp);
+    PutParts(data, m_Theme, m_Keybinds, m_Behavior);
+    
+    std::error_code ec;
+    std::filesystem::create_directories(GetConfigDir(), ec);
+    auto file = AtomicFile::Create(GetSnapshotPath());
+    if (!file || !file->Write(data) || !file->Commit()) {
+        Logger::Error("Failed to write settings snapshot: ", GetSnapshotPath());
+    }
+}
+
+static void WriteVec4(JsonWriter& writer, std::string_view key, const ImVec4& v) {
+    writer.Key(key).BeginArray().Number(v.x).Number(v.y).Number(v.z).Number(v.w).EndArray();
+}
+
+static void WriteVec2(JsonWriter& writer, std::string_view key, const ImVec2& v) {
+    writer.Key(key).BeginArray().Number(v.x).Number(v.y).EndArray();
 }
 
 // Helper to deserialize ImVec4 from JSON array
-static ImVec4 JsonToVec4(const JsonValue& v, const ImVec4& def = ImVec4(0,0,0,1)) {
-    if (v.type != JsonType::Array) return def;
-    const auto& arr = v.AsArray();
+static ImVec4 JsonToVec4(const JsonNode& v, const ImVec4& def = ImVec4(0,0,0,1)) {
+    const auto arr = v.Items();
     if (arr.size() < 4) return def;
-    auto getFloat = [](const JsonValue& val) -> float {
-        if (val.type == JsonType::Number) return static_cast<float>(std::get<double>(val.data));
-        return 0.0f;
-    };
+    auto getFloat = [](const JsonNode& val) { return static_cast<float>(val.AsNumber()); };
     return ImVec4(getFloat(arr[0]), getFloat(arr[1]), getFloat(arr[2]), getFloat(arr[3]));
 }
 
 // Helper to deserialize ImVec2 from JSON array
-static ImVec2 JsonToVec2(const JsonValue& v, const ImVec2& def = ImVec2(0,0)) {
-    if (v.type != JsonType::Array) return def;
-    const auto& arr = v.AsArray();
+static ImVec2 JsonToVec2(const JsonNode& v, const ImVec2& def = ImVec2(0,0)) {
+    const auto arr = v.Items();
     if (arr.size() < 2) return def;
-    auto getFloat = [](const JsonValue& val) -> float {
-        if (val.type == JsonType::Number) return static_cast<float>(std::get<double>(val.data));
-        return 0.0f;
-    };
+    auto getFloat = [](const JsonNode& val) { return static_cast<float>(val.AsNumber()); };
     return ImVec2(getFloat(arr[0]), getFloat(arr[1]));
 }
 
-static float JsonToFloat(const JsonValue& v, float def = 0.0f) {
-    if (v.type == JsonType::Number) return static_cast<float>(std::get<double>(v.data));
-    return def;
+static float JsonToFloat(const JsonNode& v, float def = 0.0f) {
+    return static_cast<float>(v.AsNumber(def));
 }
 
-bool EditorSettings::Save() const {
+bool EditorSettings::SaveTheme() {
     auto configDir = GetConfigDir();
     auto configPath = GetConfigPath();
     
@@ -527,127 +811,131 @@ bool EditorSettings::Save() const {
     std::error_code ec;
     std::filesystem::create_directories(configDir, ec);
     if (ec) {
-        Logger::Error("Failed to create config directory: " + ec.message());
+        Logger::Error("Failed to create config directory: ", ec.message());
         return false;
     }
     
     const auto& theme = m_Theme;
     
+    JsonWriter writer;
+    writer.BeginObject();
+    writer.Key("name").String(theme.name);
+    
     // Serialize EditorColors
-    JsonObject editorObj;
-    editorObj["background"] = Vec4ToJson(theme.editor.background);
-    editorObj["text"] = Vec4ToJson(theme.editor.text);
-    editorObj["keyword"] = Vec4ToJson(theme.editor.keyword);
-    editorObj["type"] = Vec4ToJson(theme.editor.type);
-    editorObj["function"] = Vec4ToJson(theme.editor.function);
-    editorObj["variable"] = Vec4ToJson(theme.editor.variable);
-    editorObj["string"] = Vec4ToJson(theme.editor.string);
-    editorObj["number"] = Vec4ToJson(theme.editor.number);
-    editorObj["comment"] = Vec4ToJson(theme.editor.comment);
-    editorObj["op"] = Vec4ToJson(theme.editor.op);
-    editorObj["punctuation"] = Vec4ToJson(theme.editor.punctuation);
-    editorObj["macro"] = Vec4ToJson(theme.editor.macro);
-    editorObj["constant"] = Vec4ToJson(theme.editor.constant);
-    editorObj["error"] = Vec4ToJson(theme.editor.error);
-    editorObj["lineNumber"] = Vec4ToJson(theme.editor.lineNumber);
-    editorObj["currentLine"] = Vec4ToJson(theme.editor.currentLine);
-    editorObj["selection"] = Vec4ToJson(theme.editor.selection);
-    editorObj["cursor"] = Vec4ToJson(theme.editor.cursor);
-    editorObj["popupBg"] = Vec4ToJson(theme.editor.popupBg);
-    editorObj["popupBorder"] = Vec4ToJson(theme.editor.popupBorder);
-    editorObj["popupText"] = Vec4ToJson(theme.editor.popupText);
-    editorObj["popupSelected"] = Vec4ToJson(theme.editor.popupSelected);
+    writer.Key("editor").BeginObject();
+    WriteVec4(writer, "background", theme.editor.background);
+    WriteVec4(writer, "text", theme.editor.text);
+    WriteVec4(writer, "keyword", theme.editor.keyword);
+    WriteVec4(writer, "type", theme.editor.type);
+    WriteVec4(writer, "function", theme.editor.function);
+    WriteVec4(writer, "variable", theme.editor.variable);
+    WriteVec4(writer, "string", theme.editor.string);
+    WriteVec4(writer, "number", theme.editor.number);
+    WriteVec4(writer, "comment", theme.editor.comment);
+    WriteVec4(writer, "op", theme.editor.op);
+    WriteVec4(writer, "punctuation", theme.editor.punctuation);
+    WriteVec4(writer, "macro", theme.editor.macro);
+    WriteVec4(writer, "constant", theme.editor.constant);
+    WriteVec4(writer, "error", theme.editor.error);
+    WriteVec4(writer, "lineNumber", theme.editor.lineNumber);
+    WriteVec4(writer, "currentLine", theme.editor.currentLine);
+    WriteVec4(writer, "selection", theme.editor.selection);
+    WriteVec4(writer, "cursor", theme.editor.cursor);
+    WriteVec4(writer, "popupBg", theme.editor.popupBg);
+    WriteVec4(writer, "popupBorder", theme.editor.popupBorder);
+    WriteVec4(writer, "popupText", theme.editor.popupText);
+    WriteVec4(writer, "popupSelected", theme.editor.popupSelected);
+    writer.EndObject();
     
     // Serialize ThemeColors
-    JsonObject colorsObj;
-    colorsObj["windowBg"] = Vec4ToJson(theme.colors.windowBg);
-    colorsObj["childBg"] = Vec4ToJson(theme.colors.childBg);
-    colorsObj["popupBg"] = Vec4ToJson(theme.colors.popupBg);
-    colorsObj["border"] = Vec4ToJson(theme.colors.border);
-    colorsObj["frameBg"] = Vec4ToJson(theme.colors.frameBg);
-    colorsObj["frameBgHovered"] = Vec4ToJson(theme.colors.frameBgHovered);
-    colorsObj["frameBgActive"] = Vec4ToJson(theme.colors.frameBgActive);
-    colorsObj["titleBg"] = Vec4ToJson(theme.colors.titleBg);
-    colorsObj["titleBgActive"] = Vec4ToJson(theme.colors.titleBgActive);
-    colorsObj["menuBarBg"] = Vec4ToJson(theme.colors.menuBarBg);
-    colorsObj["scrollbarBg"] = Vec4ToJson(theme.colors.scrollbarBg);
-    colorsObj["scrollbarGrab"] = Vec4ToJson(theme.colors.scrollbarGrab);
-    colorsObj["scrollbarGrabHovered"] = Vec4ToJson(theme.colors.scrollbarGrabHovered);
-    colorsObj["scrollbarGrabActive"] = Vec4ToJson(theme.colors.scrollbarGrabActive);
-    colorsObj["checkMark"] = Vec4ToJson(theme.colors.checkMark);
-    colorsObj["sliderGrab"] = Vec4ToJson(theme.colors.sliderGrab);
-    colorsObj["sliderGrabActive"] = Vec4ToJson(theme.colors.sliderGrabActive);
-    colorsObj["button"] = Vec4ToJson(theme.colors.button);
-    colorsObj["buttonHovered"] = Vec4ToJson(theme.colors.buttonHovered);
-    colorsObj["buttonActive"] = Vec4ToJson(theme.colors.buttonActive);
-    colorsObj["header"] = Vec4ToJson(theme.colors.header);
-    colorsObj["headerHovered"] = Vec4ToJson(theme.colors.headerHovered);
-    colorsObj["headerActive"] = Vec4ToJson(theme.colors.headerActive);
-    colorsObj["separator"] = Vec4ToJson(theme.colors.separator);
-    colorsObj["separatorHovered"] = Vec4ToJson(theme.colors.separatorHovered);
-    colorsObj["tab"] = Vec4ToJson(theme.colors.tab);
-    colorsObj["tabHovered"] = Vec4ToJson(theme.colors.tabHovered);
-    colorsObj["tabActive"] = Vec4ToJson(theme.colors.tabActive);
-    colorsObj["tabUnfocused"] = Vec4ToJson(theme.colors.tabUnfocused);
-    colorsObj["tabUnfocusedActive"] = Vec4ToJson(theme.colors.tabUnfocusedActive);
-    colorsObj["dockingPreview"] = Vec4ToJson(theme.colors.dockingPreview);
-    colorsObj["text"] = Vec4ToJson(theme.colors.text);
-    colorsObj["textDisabled"] = Vec4ToJson(theme.colors.textDisabled);
-    colorsObj["textSelectedBg"] = Vec4ToJson(theme.colors.textSelectedBg);
+    writer.Key("colors").BeginObject();
+    WriteVec4(writer, "windowBg", theme.colors.windowBg);
+    WriteVec4(writer, "childBg", theme.colors.childBg);
+    WriteVec4(writer, "popupBg", theme.colors.popupBg);
+    WriteVec4(writer, "border", theme.colors.border);
+    WriteVec4(writer, "frameBg", theme.colors.frameBg);
+    WriteVec4(writer, "frameBgHovered", theme.colors.frameBgHovered);
+    WriteVec4(writer, "frameBgActive", theme.colors.frameBgActive);
+    WriteVec4(writer, "titleBg", theme.colors.titleBg);
+    WriteVec4(writer, "titleBgActive", theme.colors.titleBgActive);
+    WriteVec4(writer, "menuBarBg", theme.colors.menuBarBg);
+    WriteVec4(writer, "scrollbarBg", theme.colors.scrollbarBg);
+    WriteVec4(writer, "scrollbarGrab", theme.colors.scrollbarGrab);
+    WriteVec4(writer, "scrollbarGrabHovered", theme.colors.scrollbarGrabHovered);
+    WriteVec4(writer, "scrollbarGrabActive", theme.colors.scrollbarGrabActive);
+    WriteVec4(writer, "checkMark", theme.colors.checkMark);
+    WriteVec4(writer, "sliderGrab", theme.colors.sliderGrab);
+    WriteVec4(writer, "sliderGrabActive", theme.colors.sliderGrabActive);
+    WriteVec4(writer, "button", theme.colors.button);
+    WriteVec4(writer, "buttonHovered", theme.colors.buttonHovered);
+    WriteVec4(writer, "buttonActive", theme.colors.buttonActive);
+    WriteVec4(writer, "header", theme.colors.header);
+    WriteVec4(writer, "headerHovered", theme.colors.headerHovered);
+    WriteVec4(writer, "headerActive", theme.colors.headerActive);
+    WriteVec4(writer, "separator", theme.colors.separator);
+    WriteVec4(writer, "separatorHovered", theme.colors.separatorHovered);
+    WriteVec4(writer, "tab", theme.colors.tab);
+    WriteVec4(writer, "tabHovered", theme.colors.tabHovered);
+    WriteVec4(writer, "tabActive", theme.colors.tabActive);
+    WriteVec4(writer, "tabUnfocused", theme.colors.tabUnfocused);
+    WriteVec4(writer, "tabUnfocusedActive", theme.colors.tabUnfocusedActive);
+    WriteVec4(writer, "dockingPreview", theme.colors.dockingPreview);
+    WriteVec4(writer, "text", theme.colors.text);
+    WriteVec4(writer, "textDisabled", theme.colors.textDisabled);
+    WriteVec4(writer, "textSelectedBg", theme.colors.textSelectedBg);
+    writer.EndObject();
     
     // Serialize ThemeStyle
-    JsonObject styleObj;
-    styleObj["windowRounding"] = JsonValue(static_cast<double>(theme.style.windowRounding));
-    styleObj["frameRounding"] = JsonValue(static_cast<double>(theme.style.frameRounding));
-    styleObj["tabRounding"] = JsonValue(static_cast<double>(theme.style.tabRounding));
-    styleObj["scrollbarRounding"] = JsonValue(static_cast<double>(theme.style.scrollbarRounding));
-    styleObj["grabRounding"] = JsonValue(static_cast<double>(theme.style.grabRounding));
-    styleObj["childRounding"] = JsonValue(static_cast<double>(theme.style.childRounding));
-    styleObj["popupRounding"] = JsonValue(static_cast<double>(theme.style.popupRounding));
-    styleObj["windowBorderSize"] = JsonValue(static_cast<double>(theme.style.windowBorderSize));
-    styleObj["frameBorderSize"] = JsonValue(static_cast<double>(theme.style.frameBorderSize));
-    styleObj["tabBorderSize"] = JsonValue(static_cast<double>(theme.style.tabBorderSize));
-    styleObj["childBorderSize"] = JsonValue(static_cast<double>(theme.style.childBorderSize));
-    styleObj["popupBorderSize"] = JsonValue(static_cast<double>(theme.style.popupBorderSize));
-    styleObj["windowPadding"] = Vec2ToJson(theme.style.windowPadding);
-    styleObj["framePadding"] = Vec2ToJson(theme.style.framePadding);
-    styleObj["cellPadding"] = Vec2ToJson(theme.style.cellPadding);
-    styleObj["itemSpacing"] = Vec2ToJson(theme.style.itemSpacing);
-    styleObj["itemInnerSpacing"] = Vec2ToJson(theme.style.itemInnerSpacing);
-    styleObj["indentSpacing"] = JsonValue(static_cast<double>(theme.style.indentSpacing));
-    styleObj["scrollbarSize"] = JsonValue(static_cast<double>(theme.style.scrollbarSize));
-    styleObj["grabMinSize"] = JsonValue(static_cast<double>(theme.style.grabMinSize));
+    writer.Key("style").BeginObject();
+    writer.Key("windowRounding").Number(theme.style.windowRounding);
+    writer.Key("frameRounding").Number(theme.style.frameRounding);
+    writer.Key("tabRounding").Number(theme.style.tabRounding);
+    writer.Key("scrollbarRounding").Number(theme.style.scrollbarRounding);
+    writer.Key("grabRounding").Number(theme.style.grabRounding);
+    writer.Key("childRounding").Number(theme.style.childRounding);
+    writer.Key("popupRounding").Number(theme.style.popupRounding);
+    writer.Key("windowBorderSize").Number(theme.style.windowBorderSize);
+    writer.Key("frameBorderSize").Number(theme.style.frameBorderSize);
+    writer.Key("tabBorderSize").Number(theme.style.tabBorderSize);
+    writer.Key("childBorderSize").Number(theme.style.childBorderSize);
+    writer.Key("popupBorderSize").Number(theme.style.popupBorderSize);
+    WriteVec2(writer, "windowPadding", theme.style.windowPadding);
+    WriteVec2(writer, "framePadding", theme.style.framePadding);
+    WriteVec2(writer, "cellPadding", theme.style.cellPadding);
+    WriteVec2(writer, "itemSpacing", theme.style.itemSpacing);
+    WriteVec2(writer, "itemInnerSpacing", theme.style.itemInnerSpacing);
+    writer.Key("indentSpacing").Number(theme.style.indentSpacing);
+    writer.Key("scrollbarSize").Number(theme.style.scrollbarSize);
+    writer.Key("grabMinSize").Number(theme.style.grabMinSize);
+    writer.EndObject();
     
     // Serialize ThemeFont
-    JsonObject fontObj;
-    fontObj["fontId"] = JsonValue(theme.font.fontId);
-    fontObj["fontSize"] = JsonValue(static_cast<double>(theme.font.fontSize));
-    fontObj["fontScale"] = JsonValue(static_cast<double>(theme.font.fontScale));
-    
-    // Build root object
-    JsonObject root;
-    root["name"] = JsonValue(theme.name);
-    root["editor"] = JsonValue(editorObj);
-    root["colors"] = JsonValue(colorsObj);
-    root["style"] = JsonValue(styleObj);
-    root["font"] = JsonValue(fontObj);
-    
-    std::string jsonStr = Json::Serialize(JsonValue(root));
+    writer.Key("font").BeginObject();
+    writer.Key("fontId").String(theme.font.fontId);
+    writer.Key("fontSize").Number(theme.font.fontSize);
+    writer.Key("fontScale").Number(theme.font.fontScale);
+    writer.EndObject();
+    writer.EndObject();
     
     std::ofstream file(configPath);
     if (!file) {
-        Logger::Error("Failed to open config file for writing: " + configPath.string());
+        Logger::Error("Failed to open config file for writing: ", configPath);
         return false;
     }
     
-    file << jsonStr;
+    file << writer.Str();
     file.close();
+    if (!file) {
+        Logger::Error("Failed to write config file: ", configPath);
+        return false;
+    }
+    Stamp(File::Theme, writer.Str());
     
-    Logger::Info("Settings saved to " + configPath.string());
+    Logger::Info("Settings saved to ", configPath);
     return true;
 }
 
-bool EditorSettings::SaveKeybinds() const {
+bool EditorSettings::SaveKeybinds() {
     auto configDir = GetConfigDir();
     auto keybindsPath = GetKeybindsPath();
     
@@ -655,69 +943,64 @@ bool EditorSettings::SaveKeybinds() const {
     std::error_code ec;
     std::filesystem::create_directories(configDir, ec);
     if (ec) {
-        Logger::Error("Failed to create config directory: " + ec.message());
+        Logger::Error("Failed to create config directory: ", ec.message());
         return false;
     }
     
-    JsonObject keybindsObj;
-    keybindsObj["leaderKey"] = JsonValue(ImGuiKeyToString(m_Keybinds.leaderKey));
-    keybindsObj["modeKey"] = JsonValue(ImGuiKeyToString(m_Keybinds.modeKey));
-    keybindsObj["insertKey"] = JsonValue(ImGuiKeyToString(m_Keybinds.insertKey));
-    keybindsObj["defaultMode"] = JsonValue(std::string(EditorInputModeToString(m_Keybinds.defaultMode)));
+    JsonWriter writer;
+    writer.BeginObject();
+    writer.Key("leaderKey").String(ImGuiKeyToString(m_Keybinds.leaderKey));
+    writer.Key("modeKey").String(ImGuiKeyToString(m_Keybinds.modeKey));
+    writer.Key("insertKey").String(ImGuiKeyToString(m_Keybinds.insertKey));
+    writer.Key("defaultMode").String(EditorInputModeToString(m_Keybinds.defaultMode));
     
-    JsonArray bindingsArr;
+    writer.Key("bindings").BeginArray();
     for (const auto& binding : m_Keybinds.bindings) {
-        JsonObject bindObj;
-        bindObj["keys"] = JsonValue(binding.keys);
-        bindObj["event"] = JsonValue(binding.eventId);
-        bindObj["context"] = JsonValue(binding.context);
-        bindingsArr.push_back(JsonValue(bindObj));
+        writer.BeginObject();
+        writer.Key("keys").String(binding.keys);
+        writer.Key("event").String(binding.eventId);
+        writer.Key("context").String(binding.context);
+        writer.EndObject();
     }
-    keybindsObj["bindings"] = JsonValue(bindingsArr);
-    
-    std::string jsonStr = Json::Serialize(JsonValue(keybindsObj));
+    writer.EndArray();
+    writer.EndObject();
     
     std::ofstream file(keybindsPath);
     if (!file) {
-        Logger::Error("Failed to open keybinds file for writing: " + keybindsPath.string());
+        Logger::Error("Failed to open keybinds file for writing: ", keybindsPath);
         return false;
     }
     
-    file << jsonStr;
+    file << writer.Str();
     file.close();
+    if (!file) {
+        Logger::Error("Failed to write keybinds file: ", keybindsPath);
+        return false;
+    }
+    Stamp(File::Keybinds, writer.Str());
     
-    Logger::Info("Keybinds saved to " + keybindsPath.string());
+    Logger::Info("Keybinds saved to ", keybindsPath);
     return true;
 }
 
-bool EditorSettings::Load() {
+bool EditorSettings::LoadTheme(const std::string* json) {
     auto configPath = GetConfigPath();
     
-    if (!std::filesystem::exists(configPath)) {
-        Logger::Info("No config file found at " + configPath.string() + ", using defaults");
+    if (!json) {
+        Logger::Info("No config file found at ", configPath, ", using defaults");
         return false;
     }
     
-    std::ifstream file(configPath);
-    if (!file) {
-        Logger::Error("Failed to open config file: " + configPath.string());
-        return false;
-    }
-    
-    std::stringstream buffer;
-    buffer << file.rdbuf();
-    std::string jsonStr = buffer.str();
-    file.close();
-    
-    JsonValue root = Json::Parse(jsonStr);
-    if (root.type != JsonType::Object) {
+    JsonDocument document;
+    if (!document.Parse(*json) || !document.Root().IsObject()) {
         Logger::Error("Invalid config file format");
         return false;
     }
+    const JsonNode& root = document.Root();
     
     // Load theme name
     if (root.Has("name")) {
-        m_Theme.name = root["name"].ToString();
+        m_Theme.name = std::string(root["name"].AsString());
     }
     
     // Load EditorColors
@@ -818,66 +1101,55 @@ bool EditorSettings::Load() {
     if (root.Has("font")) {
         const auto& f = root["font"];
         auto& tf = m_Theme.font;
-        if (f.Has("fontId")) tf.fontId = f["fontId"].ToString();
+        if (f.Has("fontId")) tf.fontId = std::string(f["fontId"].AsString());
         if (f.Has("fontSize")) tf.fontSize = JsonToFloat(f["fontSize"], tf.fontSize);
         if (f.Has("fontScale")) tf.fontScale = JsonToFloat(f["fontScale"], tf.fontScale);
     }
     
-    Logger::Info("Settings loaded from " + configPath.string());
+    Logger::Info("Settings loaded from ", configPath);
     return true;
 }
 
-bool EditorSettings::LoadKeybinds() {
+bool EditorSettings::LoadKeybinds(const std::string* json) {
     auto keybindsPath = GetKeybindsPath();
     
-    if (!std::filesystem::exists(keybindsPath)) {
-        Logger::Info("No keybinds file found at " + keybindsPath.string() + ", using defaults");
+    if (!json) {
+        Logger::Info("No keybinds file found at ", keybindsPath, ", using defaults");
         m_Keybinds.bindings = GetDefaultKeybindings();
         return false;
     }
     
-    std::ifstream file(keybindsPath);
-    if (!file) {
-        Logger::Error("Failed to open keybinds file: " + keybindsPath.string());
-        m_Keybinds.bindings = GetDefaultKeybindings();
-        return false;
-    }
-    
-    std::stringstream buffer;
-    buffer << file.rdbuf();
-    std::string jsonStr = buffer.str();
-    file.close();
-    
-    JsonValue root = Json::Parse(jsonStr);
-    if (root.type != JsonType::Object) {
+    JsonDocument document;
+    if (!document.Parse(*json) || !document.Root().IsObject()) {
         Logger::Error("Invalid keybinds file format");
         m_Keybinds.bindings = GetDefaultKeybindings();
         return false;
     }
+    const JsonNode& root = document.Root();
     
     if (root.Has("leaderKey")) {
-        ImGuiKey key = ImGuiKeyFromString(root["leaderKey"].ToString());
+        ImGuiKey key = ImGuiKeyFromString(std::string(root["leaderKey"].AsString()));
         if (key != ImGuiKey_None) {
             m_Keybinds.leaderKey = key;
         }
     }
     
     if (root.Has("modeKey")) {
-        ImGuiKey key = ImGuiKeyFromString(root["modeKey"].ToString());
+        ImGuiKey key = ImGuiKeyFromString(std::string(root["modeKey"].AsString()));
         if (key != ImGuiKey_None) {
             m_Keybinds.modeKey = key;
         }
     }
     
     if (root.Has("insertKey")) {
-        ImGuiKey key = ImGuiKeyFromString(root["insertKey"].ToString());
+        ImGuiKey key = ImGuiKeyFromString(std::string(root["insertKey"].AsString()));
         if (key != ImGuiKey_None) {
             m_Keybinds.insertKey = key;
         }
     }
     
     if (root.Has("defaultMode")) {
-        std::string mode = root["defaultMode"].ToString();
+        std::string mode = std::string(root["defaultMode"].AsString());
         if (mode == "Command") {
             m_Keybinds.defaultMode = EditorInputMode::Command;
         } else {
@@ -885,15 +1157,14 @@ bool EditorSettings::LoadKeybinds() {
         }
     }
     
-    if (root.Has("bindings") && root["bindings"].type == JsonType::Array) {
+    if (root["bindings"].IsArray()) {
         m_Keybinds.bindings.clear();
-        const auto& bindings = std::get<JsonArray>(root["bindings"].data);
-        for (const auto& binding : bindings) {
-            if (binding.type == JsonType::Object) {
+        for (const JsonNode& binding : root["bindings"].Items()) {
+            if (binding.IsObject()) {
                 KeybindEntry entry;
-                if (binding.Has("keys")) entry.keys = binding["keys"].ToString();
-                if (binding.Has("event")) entry.eventId = binding["event"].ToString();
-                if (binding.Has("context")) entry.context = binding["context"].ToString();
+                if (binding.Has("keys")) entry.keys = std::string(binding["keys"].AsString());
+                if (binding.Has("event")) entry.eventId = std::string(binding["event"].AsString());
+                if (binding.Has("context")) entry.context = std::string(binding["context"].AsString());
                 if (!entry.keys.empty() && !entry.eventId.empty()) {
                     m_Keybinds.bindings.push_back(entry);
                 }
@@ -906,68 +1177,87 @@ bool EditorSettings::LoadKeybinds() {
         m_Keybinds.bindings = GetDefaultKeybindings();
     }
     
-    Logger::Info("Keybinds loaded from " + keybindsPath.string());
+    Logger::Info("Keybinds loaded from ", keybindsPath);
     return true;
 }
 
-bool EditorSettings::SaveBehavior() const {
+bool EditorSettings::SaveBehavior() {
     auto configDir = GetConfigDir();
     auto behaviorPath = GetBehaviorPath();
 
     std::error_code ec;
     std::filesystem::create_directories(configDir, ec);
     if (ec) {
-        Logger::Error("Failed to create config directory: " + ec.message());
+        Logger::Error("Failed to create config directory: ", ec.message());
         return false;
     }
 
-    JsonObject root;
-    root["scrollOffPercent"] = JsonValue(static_cast<double>(m_Behavior.scrollOffPercent));
-
-    std::string jsonStr = Json::Serialize(JsonValue(root));
+    JsonWriter writer;
+    writer.BeginObject();
+    writer.Key("scrollOffPercent").Number(m_Behavior.scrollOffPercent);
+    writer.Key("softWrap").Bool(m_Behavior.softWrap);
+    writer.Key("minimap").Bool(m_Behavior.minimap);
+    writer.Key("undoMemoryMB").Int(m_Behavior.undoMemoryMB);
+    writer.Key("bufferMemoryMB").Int(m_Behavior.bufferMemoryMB);
+    writer.Key("syntaxIdleMinutes").Int(m_Behavior.syntaxIdleMinutes);
+    writer.Key("terminalScrollback").Int(m_Behavior.terminalScrollback);
+    writer.Key("terminalHistoryMB").Int(m_Behavior.terminalHistoryMB);
+    writer.Key("previewHighlighting").Bool(m_Behavior.previewHighlighting);
+    writer.EndObject();
 
     std::ofstream file(behaviorPath);
     if (!file) {
-        Logger::Error("Failed to open behavior file for writing: " + behaviorPath.string());
+        Logger::Error("Failed to open behavior file for writing: ", behaviorPath);
         return false;
     }
 
-    file << jsonStr;
+    file << writer.Str();
     file.close();
+    if (!file) {
+        Logger::Error("Failed to write behavior file: ", behaviorPath);
+        return false;
+    }
+    Stamp(File::Behavior, writer.Str());
 
-    Logger::Info("Behavior settings saved to " + behaviorPath.string());
+    Logger::Info("Behavior settings saved to ", behaviorPath);
     return true;
 }
 
-bool EditorSettings::LoadBehavior() {
+bool EditorSettings::LoadBehavior(const std::string* json) {
     auto behaviorPath = GetBehaviorPath();
 
-    if (!std::filesystem::exists(behaviorPath)) {
-        Logger::Info("No behavior file found at " + behaviorPath.string() + ", using defaults");
+    if (!json) {
+        Logger::Info("No behavior file found at ", behaviorPath, ", using defaults");
         return false;
     }
 
-    std::ifstream file(behaviorPath);
-    if (!file) {
-        Logger::Error("Failed to open behavior file: " + behaviorPath.string());
-        return false;
-    }
-
-    std::stringstream buf;
-    buf << file.rdbuf();
-    std::string jsonStr = buf.str();
-    file.close();
-
-    JsonValue root = Json::Parse(jsonStr);
-    if (root.type != JsonType::Object) {
+    JsonDocument document;
+    if (!document.Parse(*json) || !document.Root().IsObject()) {
         Logger::Error("Invalid behavior file format");
         return false;
     }
+    const JsonNode& root = document.Root();
 
     if (root.Has("scrollOffPercent"))
         m_Behavior.scrollOffPercent = std::clamp(JsonToFloat(root["scrollOffPercent"], m_Behavior.scrollOffPercent), 0.0f, 0.5f);
+    if (root.Has("softWrap") && root["softWrap"].IsBool())
+        m_Behavior.softWrap = root["softWrap"].AsBool();
+    if (root.Has("minimap") && root["minimap"].IsBool())
+        m_Behavior.minimap = root["minimap"].AsBool();
+    if (root.Has("undoMemoryMB"))
+        m_Behavior.undoMemoryMB = std::clamp(static_cast<int>(JsonToFloat(root["undoMemoryMB"], static_cast<float>(m_Behavior.undoMemoryMB))), 0, 4096);
+    if (root.Has("bufferMemoryMB"))
+        m_Behavior.bufferMemoryMB = std::clamp(static_cast<int>(JsonToFloat(root["bufferMemoryMB"], static_cast<float>(m_Behavior.bufferMemoryMB))), 0, 65536);
+    if (root.Has("syntaxIdleMinutes"))
+        m_Behavior.syntaxIdleMinutes = std::clamp(static_cast<int>(JsonToFloat(root["syntaxIdleMinutes"], static_cast<float>(m_Behavior.syntaxIdleMinutes))), 0, 1440);
+    if (root.Has("terminalScrollback"))
+        m_Behavior.terminalScrollback = std::clamp(static_cast<int>(JsonToFloat(root["terminalScrollback"], static_cast<float>(m_Behavior.terminalScrollback))), 0, 1000000);
+    if (root.Has("terminalHistoryMB"))
+        m_Behavior.terminalHistoryMB = std::clamp(static_cast<int>(JsonToFloat(root["terminalHistoryMB"], static_cast<float>(m_Behavior.terminalHistoryMB))), 0, 65536);
+    if (root.Has("previewHighlighting") && root["previewHighlighting"].IsBool())
+        m_Behavior.previewHighlighting = root["previewHighlighting"].AsBool();
 
-    Logger::Info("Behavior settings loaded from " + behaviorPath.string());
+    Logger::Info("Behavior settings loaded from ", behaviorPath);
     return true;
 }
 
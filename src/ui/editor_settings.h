@@ -1,7 +1,9 @@
 #pragma once
 
 #include <cstddef>
+#include <cstdint>
 #include <string>
+#include <string_view>
 #include <vector>
 #include <filesystem>
 #include <imgui.h>
@@ -42,6 +44,28 @@ struct BehaviorSettings {
     // Percent (0.0-0.5) of viewport height kept as scroll margin around cursor.
     // Scroll begins when cursor enters this zone at the top or bottom.
     float scrollOffPercent = 0.10f;
+    
+    // Break long lines at the editor's width instead of scrolling sideways
+    bool softWrap = false;
+    
+    // Downsampled picture of the whole buffer along the editor's right edge
+    bool minimap = true;
+    
+    // Undo history kept per editor before the oldest edits are pruned; 0 = unlimited
+    int undoMemoryMB = 64;
+    
+    // Text, syntax trees and caches of open buffers before hidden ones are trimmed; 0 = unlimited
+    int bufferMemoryMB = 1024;
+
+    // Minutes off screen before a buffer drops its syntax tree, reparsed when shown again; 0 = never
+    int syntaxIdleMinutes = 10;
+
+    // Terminal scrollback lines kept in memory, then older ones compressed on disk; 0 = none on disk
+    int terminalScrollback = 10000;
+    int terminalHistoryMB = 256;
+
+    // Syntax highlight Telescope previews with the file's language (parsed off-thread)
+    bool previewHighlighting = true;
 };
 
 // Editor/buffer area colors (syntax highlighting, gutter, cursor, etc.)
@@ -149,6 +173,17 @@ struct Theme {
 // Default keybindings
 std::vector<KeybindEntry> GetDefaultKeybindings();
 
+// Size and time say a settings file is unchanged without reading it; the
+// hash does when a save wrote it again with the same bytes
+struct SettingsFileStamp {
+    bool exists = false;
+    int64_t time = 0;
+    uint64_t size = 0;
+    uint64_t hash = 0;
+    
+    bool operator==(const SettingsFileStamp&) const = default;
+};
+
 class EditorSettings {
 public:
     static EditorSettings& Get() {
@@ -156,28 +191,47 @@ public:
         return instance;
     }
     
+    // The settings files, each holding one part of the settings
+    enum class File : uint8_t { Theme, Keybinds, Behavior };
+    static constexpr size_t FILE_COUNT = 3;
+    
     // Config persistence
     static std::filesystem::path GetConfigDir();
     static std::filesystem::path GetConfigPath();
     static std::filesystem::path GetKeybindsPath();
     static std::filesystem::path GetBehaviorPath();
-    bool Load();
-    bool Save() const;
-    bool LoadKeybinds();
-    bool SaveKeybinds() const;
-    bool LoadBehavior();
-    bool SaveBehavior() const;
+    // Binary snapshot of what the files last parsed to, with the size, time
+    // and hash of each file it came from
+    static std::filesystem::path GetSnapshotPath();
+    
+    // Takes each part from the snapshot while its file is unchanged and
+    // parses only the files that changed, side by side
+    void Load();
+    // Live edits are saved once they settle: MarkDirty notes the file a
+    // change belongs in, SaveDirty writes the files noted and the snapshot
+    void MarkDirty(File file) { m_Dirty |= 1u << static_cast<unsigned>(file); }
+    void SaveDirty();
     
     // Cursor position for status bar
     size_t GetCursorLine() const { return m_CursorLine; }
     size_t GetCursorCol() const { return m_CursorCol; }
     void SetCursorPos(size_t line, size_t col) { m_CursorLine = line; m_CursorCol = col; }
+    
+    // Line indexing progress of the focused buffer in [0, 1]; negative when done
+    float GetIndexingProgress() const { return m_IndexingProgress; }
+    void SetIndexingProgress(float progress) { m_IndexingProgress = progress; }
+    
+    // Whether the focused editor is recording a macro
+    bool IsMacroRecording() const { return m_MacroRecording; }
+    void SetMacroRecording(bool recording) { m_MacroRecording = recording; }
 
     // In-buffer search state (set by the focused editor, read by status bar)
-    void SetSearch(const char* query, int current, int total) {
+    void SetSearch(const char* query, int current, int total, bool regex, const std::string& error) {
         m_SearchQuery = query;
         m_SearchCurrent = current;
         m_SearchTotal = total;
+        m_SearchRegex = regex;
+        m_SearchError = error;
         m_SearchActive = true;
     }
     void ClearSearch() { m_SearchActive = false; m_SearchQuery.clear(); }
@@ -185,6 +239,8 @@ public:
     const std::string& GetSearchQuery() const { return m_SearchQuery; }
     int GetSearchCurrent() const { return m_SearchCurrent; }
     int GetSearchTotal() const { return m_SearchTotal; }
+    bool IsSearchRegex() const { return m_SearchRegex; }
+    const std::string& GetSearchError() const { return m_SearchError; }  // Invalid regex
 
     Theme& GetTheme() { return m_Theme; }
     const Theme& GetTheme() const { return m_Theme; }
@@ -218,12 +274,32 @@ public:
 private:
     EditorSettings() = default;
     
+    // Each applies its file's JSON over the defaults; nullptr when missing
+    bool LoadTheme(const std::string* json);
+    bool LoadKeybinds(const std::string* json);
+    bool LoadBehavior(const std::string* json);
+    bool SaveTheme();
+    bool SaveKeybinds();
+    bool SaveBehavior();
+    // The file now holds written
+    void Stamp(File file, std::string_view written);
+    bool ReadSnapshot(SettingsFileStamp (&stamps)[FILE_COUNT], Theme& theme, KeybindSettings& keybinds,
+                      BehaviorSettings& behavior) const;
+    void WriteSnapshot() const;
+    
+    SettingsFileStamp m_Stamps[FILE_COUNT];
+    unsigned m_Dirty = 0;
+    
     size_t m_CursorLine = 1;
     size_t m_CursorCol = 1;
+    float m_IndexingProgress = -1.0f;
+    bool m_MacroRecording = false;
     bool m_SearchActive = false;
     std::string m_SearchQuery;
     int m_SearchCurrent = 0;
     int m_SearchTotal = 0;
+    bool m_SearchRegex = false;
+    std::string m_SearchError;
     Theme m_Theme;
     KeybindSettings m_Keybinds;
     BehaviorSettings m_Behavior;
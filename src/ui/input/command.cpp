@@ -8,101 +8,6 @@
 
 namespace sol {
 
-// Command implementation
-Command::Command(const std::string& id, const std::string& title, CommandCallback callback)
-    : m_Id(id), m_Title(title), m_Callback(callback) {}
-
-CommandResult Command::Execute(const CommandArgs& args) const {
-    if (!m_Enabled) {
-        return CommandResult::Failure("Command is disabled");
-    }
-    
-    if (!m_Callback) {
-        return CommandResult::Failure("No callback registered");
-    }
-    
-    try {
-        return m_Callback(args);
-    } catch (const std::exception& e) {
-        return CommandResult::Failure(std::string("Exception: ") + e.what());
-    }
-}
-
-// CommandRegistry implementation
-CommandRegistry& CommandRegistry::GetInstance() {
-    static CommandRegistry instance;
-    return instance;
-}
-
-void CommandRegistry::Register(std::shared_ptr<Command> command) {
-    if (!command) return;
-    m_Commands[command->GetId()] = command;
-}
-
-void CommandRegistry::Register(const std::string& id, const std::string& title, CommandCallback callback) {
-    Register(std::make_shared<Command>(id, title, callback));
-}
-
-void CommandRegistry::Unregister(const std::string& id) {
-    m_Commands.erase(id);
-}
-
-std::shared_ptr<Command> CommandRegistry::Get(const std::string& id) const {
-    auto it = m_Commands.find(id);
-    if (it != m_Commands.end()) {
-        return it->second;
-    }
-    return nullptr;
-}
-
-CommandResult CommandRegistry::Execute(const std::string& id, const CommandArgs& args) {
-    auto cmd = Get(id);
-    if (!cmd) {
-        return CommandResult::Failure("Command not found: " + id);
-    }
-    return cmd->Execute(args);
-}
-
-std::vector<std::shared_ptr<Command>> CommandRegistry::GetAll() const {
-    std::vector<std::shared_ptr<Command>> result;
-    result.reserve(m_Commands.size());
-    for (const auto& [id, cmd] : m_Commands) {
-        result.push_back(cmd);
-    }
-    return result;
-}
-
-std::vector<std::shared_ptr<Command>> CommandRegistry::GetByCategory(const std::string& category) const {
-    std::vector<std::shared_ptr<Command>> result;
-    for (const auto& [id, cmd] : m_Commands) {
-        if (cmd->GetCategory() == category) {
-            result.push_back(cmd);
-        }
-    }
-    return result;
-}
-
-std::vector<std::shared_ptr<Command>> CommandRegistry::Search(const std::string& query) const {
-    std::vector<std::shared_ptr<Command>> result;
-    
-    std::string lowerQuery = query;
-    std::transform(lowerQuery.begin(), lowerQuery.end(), lowerQuery.begin(), ::tolower);
-    
-    for (const auto& [id, cmd] : m_Commands) {
-        std::string lowerId = id;
-        std::string lowerTitle = cmd->GetTitle();
-        std::transform(lowerId.begin(), lowerId.end(), lowerId.begin(), ::tolower);
-        std::transform(lowerTitle.begin(), lowerTitle.end(), lowerTitle.begin(), ::tolower);
-        
-        if (lowerId.find(lowerQuery) != std::string::npos ||
-            lowerTitle.find(lowerQuery) != std::string::npos) {
-            result.push_back(cmd);
-        }
-    }
-    
-    return result;
-}
-
 // Keymap implementation
 Keymap::Keymap(const std::string& name) : m_Name(name) {}
 
@@ -111,11 +16,13 @@ void Keymap::Bind(const KeySequence& keys, const std::string& commandId, InputCo
     for (auto& binding : m_Bindings) {
         if (binding.keys == keys && binding.context == context) {
             binding.commandId = commandId;
+            m_TriesValid = false;
             return;
         }
     }
     
     m_Bindings.emplace_back(keys, commandId, context);
+    m_TriesValid = false;
 }
 
 void Keymap::Bind(const std::string& keys, const std::string& commandId, InputContext context) {
@@ -123,7 +30,7 @@ void Keymap::Bind(const std::string& keys, const std::string& commandId, InputCo
     if (seq) {
         Bind(*seq, commandId, context);
     } else {
-        Logger::Error("Failed to parse keybinding: " + keys);
+        Logger::Error("Failed to parse keybinding: ", keys);
     }
 }
 
@@ -135,6 +42,7 @@ void Keymap::Unbind(const KeySequence& keys, InputContext context) {
             }),
         m_Bindings.end()
     );
+    m_TriesValid = false;
 }
 
 void Keymap::Unbind(const std::string& keys, InputContext context) {
@@ -184,18 +92,28 @@ std::vector<const Keybinding*> Keymap::GetBindingsForCommand(const std::string&
     return result;
 }
 
-std::vector<KeySequence> Keymap::GetAllKeySequences(InputContext context) const {
-    std::vector<KeySequence> result;
-    for (const auto& binding : m_Bindings) {
-        if (binding.context == context || binding.context == InputContext::Global) {
-            result.push_back(binding.keys);
+const KeyTrie& Keymap::GetTrie(InputContext context) const {
+    if (!m_TriesValid) {
+        for (size_t i = 0; i < m_Tries.size(); ++i) {
+            KeyTrie& trie = m_Tries[i];
+            trie.Clear();
+            // Global bindings first, so the context's own of the same keys replace them
+            for (const auto& binding : m_Bindings) {
+                if (binding.context == InputContext::Global) trie.Insert(binding.keys, EventSystem::Resolve(binding.commandId));
+            }
+            if (static_cast<InputContext>(i) == InputContext::Global) continue;
+            for (const auto& binding : m_Bindings) {
+                if (binding.context == static_cast<InputContext>(i)) trie.Insert(binding.keys, EventSystem::Resolve(binding.commandId));
+            }
         }
+        m_TriesValid = true;
     }
-    return result;
+    return m_Tries[static_cast<size_t>(context)];
 }
 
 void Keymap::Clear() {
     m_Bindings.clear();
+    m_TriesValid = false;
 }
 
 // InputSystem implementation
@@ -257,24 +175,16 @@ bool InputSystem::ProcessKey(const KeyChord& chord, InputContext context) {
     // Command mode: process keybindings
     if (!m_ActiveKeymap) return false;
     
-    // Update matcher bindings if needed
-    auto allKeys = m_ActiveKeymap->GetAllKeySequences(context);
-    m_Matcher.SetBindings(allKeys);
-    
     // Process the chord
-    auto result = m_Matcher.ProcessChord(chord);
+    auto result = m_Matcher.ProcessChord(m_ActiveKeymap->GetTrie(context), chord);
     
     switch (result) {
         case KeySequenceMatcher::MatchResult::FullMatch: {
-            // Find binding and trigger the corresponding event
-            auto binding = m_ActiveKeymap->FindBinding(m_Matcher.GetCurrentSequence(), context);
-            if (binding) {
-                EventSystem::Execute(binding->commandId);
-                m_Matcher.Reset();
-                return true;
-            }
+            // Trigger the event the binding resolved to
+            const EventHandle command = m_Matcher.GetCommand();
             m_Matcher.Reset();
-            return false;
+            EventSystem::Execute(command);
+            return true;
         }
         
         case KeySequenceMatcher::MatchResult::PartialMatch:
@@ -407,8 +317,9 @@ void InputSystem::SetupDefaultBindings() {
     auto keymap = GetActiveKeymap();
     if (!keymap) return;
     
-    // Clear existing bindings
+    // Clear existing bindings, and any sequence begun with them
     keymap->Clear();
+    ResetPendingSequence();
     
     // Load bindings from settings
     auto& settings = EditorSettings::Get();
@@ -430,7 +341,7 @@ void InputSystem::SetupDefaultBindings() {
         keymap->Bind(entry.keys, entry.eventId, ctx);
     }
     
-    Logger::Info("Keybindings initialized (" + std::to_string(bindings.size()) + " bindings)");
+    Logger::Info("Keybindings initialized (", bindings.size(), " bindings)");
 }
 
 } // namespace sol
@@ -2,91 +2,14 @@
 
 #include "keybinding.h"
 #include "ui/editor_settings.h"
-#include <functional>
+#include <array>
 #include <memory>
 #include <string>
 #include <unordered_map>
 #include <vector>
-#include <any>
 
 namespace sol {
 
-// Command arguments - allows passing context to commands
-using CommandArgs = std::unordered_map<std::string, std::any>;
-
-// Command execution result
-struct CommandResult {
-    bool success = true;
-    std::string error;
-    
-    static CommandResult Success() { return {true, ""}; }
-    static CommandResult Failure(const std::string& err) { return {false, err}; }
-};
-
-// Command callback signature
-using CommandCallback = std::function<CommandResult(const CommandArgs&)>;
-
-// A command that can be executed
-class Command {
-public:
-    Command(const std::string& id, const std::string& title, CommandCallback callback);
-    
-    const std::string& GetId() const { return m_Id; }
-    const std::string& GetTitle() const { return m_Title; }
-    const std::string& GetDescription() const { return m_Description; }
-    const std::string& GetCategory() const { return m_Category; }
-    
-    Command& SetDescription(const std::string& desc) { m_Description = desc; return *this; }
-    Command& SetCategory(const std::string& cat) { m_Category = cat; return *this; }
-    
-    // Execute the command
-    CommandResult Execute(const CommandArgs& args = {}) const;
-    
-    // Check if command is enabled (can add conditions later)
-    bool IsEnabled() const { return m_Enabled; }
-    void SetEnabled(bool enabled) { m_Enabled = enabled; }
-    
-private:
-    std::string m_Id;           // Unique identifier (e.g., "editor.save")
-    std::string m_Title;        // Display name (e.g., "Save File")
-    std::string m_Description;  // Longer description
-    std::string m_Category;     // Category for grouping (e.g., "File", "Edit")
-    CommandCallback m_Callback;
-    bool m_Enabled = true;
-};
-
-// Registry of all commands
-class CommandRegistry {
-public:
-    static CommandRegistry& GetInstance();
-    
-    // Register a command
-    void Register(std::shared_ptr<Command> command);
-    void Register(const std::string& id, const std::string& title, CommandCallback callback);
-    
-    // Unregister a command
-    void Unregister(const std::string& id);
-    
-    // Get a command by ID
-    std::shared_ptr<Command> Get(const std::string& id) const;
-    
-    // Execute a command
-    CommandResult Execute(const std::string& id, const CommandArgs& args = {});
-    
-    // Get all commands
-    std::vector<std::shared_ptr<Command>> GetAll() const;
-    
-    // Get commands by category
-    std::vector<std::shared_ptr<Command>> GetByCategory(const std::string& category) const;
-    
-    // Search commands by title/id
-    std::vector<std::shared_ptr<Command>> Search(const std::string& query) const;
-    
-private:
-    CommandRegistry() = default;
-    std::unordered_map<std::string, std::shared_ptr<Command>> m_Commands;
-};
-
 // A keybinding associates a key sequence with a command
 struct Keybinding {
     KeySequence keys;
@@ -126,8 +49,9 @@ public:
     // Get all bindings for a command
     std::vector<const Keybinding*> GetBindingsForCommand(const std::string& commandId) const;
     
-    // Get all key sequences (for matcher setup)
-    std::vector<KeySequence> GetAllKeySequences(InputContext context) const;
+    // Bindings of context and the global ones it does not override, to
+    // event handles, compiled again after the bindings change
+    const KeyTrie& GetTrie(InputContext context) const;
     
     // Clear all bindings
     void Clear();
@@ -135,8 +59,13 @@ public:
 private:
     std::string m_Name;
     std::vector<Keybinding> m_Bindings;
+    mutable std::array<KeyTrie, INPUT_CONTEXT_COUNT> m_Tries;
+    mutable bool m_TriesValid = false;
 };
 
+// Macro keys left for the focused editor to act on
+enum class MacroAction { None, ToggleRecording, Replay };
+
 // Input system - manages keymaps and processes input
 class InputSystem {
 public:
@@ -188,6 +117,14 @@ public:
         return nav; 
     }
     
+    // Pending macro action (for command mode macro keys)
+    void SetPendingMacro(MacroAction action) { m_PendingMacro = action; }
+    MacroAction ConsumePendingMacro() {
+        MacroAction action = m_PendingMacro;
+        m_PendingMacro = MacroAction::None;
+        return action;
+    }
+    
 private:
     InputSystem();
     
@@ -199,12 +136,10 @@ private:
     KeySequenceMatcher m_Matcher;
     EditorInputMode m_InputMode = EditorInputMode::Insert;  // Modal editing state
     ImGuiKey m_PendingNav = ImGuiKey_None;  // Pending navigation direction
+    MacroAction m_PendingMacro = MacroAction::None;
 };
 
-// Convenience macros for registering commands
-#define SOL_REGISTER_COMMAND(id, title, callback) \
-    CommandRegistry::GetInstance().Register(id, title, callback)
-
+// Convenience macros for binding keys
 #define SOL_BIND_KEY(keys, command) \
     InputSystem::GetInstance().GetActiveKeymap()->Bind(keys, command)
 
@@ -1,8 +1,25 @@
 #include "input_manager.h"
 #include "standard_mode.h"
+#include "core/text/text_buffer.h"
 
 namespace sol {
 
+namespace {
+
+// Carries a result into state as the editor applies it, so the next event
+// replayed sees what the last one did
+void Advance(EditorState& state, const InputResult& result) {
+    if ((result.cursorMoved || result.textChanged) && result.newCursorPos) state.cursorPos = *result.newCursorPos;
+    if (result.selectionChanged) {
+        if (result.newSelectionStart) state.selectionStart = *result.newSelectionStart;
+        if (result.newSelectionEnd) state.selectionEnd = *result.newSelectionEnd;
+        state.hasSelection = state.selectionStart != state.selectionEnd;
+    }
+    if (result.newExtraCarets) state.extraCarets = *result.newExtraCarets;
+}
+
+} // namespace
+
 InputManager::InputManager() {
     // Register standard mode
     RegisterMode("standard", std::make_unique<StandardMode>());
@@ -49,14 +66,71 @@ InputResult InputManager::HandleKeyboard(EditorState& state) {
     if (!m_ActiveMode) {
         return {};
     }
-    return m_ActiveMode->HandleKeyboard(state);
+    std::optional<InputEvent> event = m_ActiveMode->PollKeyboard(state);
+    if (!event) {
+        return {};
+    }
+    InputResult result = m_ActiveMode->HandleKey(state, *event);
+    if (m_Recording && result.handled) m_Recorded.push_back(std::move(*event));
+    return result;
 }
 
 InputResult InputManager::HandleTextInput(EditorState& state, const ImWchar* chars, int count) {
     if (!m_ActiveMode) {
         return {};
     }
-    return m_ActiveMode->HandleTextInput(state, chars, count);
+    InputResult result = m_ActiveMode->HandleTextInput(state, chars, count);
+    if (m_Recording && result.handled) {
+        InputEvent event;
+        event.chars.assign(chars, chars + count);
+        m_Recorded.push_back(std::move(event));
+    }
+    return result;
+}
+
+void InputManager::StartRecording() {
+    m_Recording = true;
+    m_Recorded.clear();
+}
+
+void InputManager::StopRecording() {
+    if (!m_Recording) return;
+    m_Recording = false;
+    m_Macro = std::move(m_Recorded);
+    m_Recorded.clear();
+}
+
+// Edits go straight to the buffer, undo taking the transaction as one step
+InputResult InputManager::ReplayMacro(EditorState& state, size_t count) {
+    InputResult result;
+    if (!m_ActiveMode || m_Recording || m_Macro.empty() || count == 0) {
+        return result;
+    }
+    TextBuffer& buffer = *state.buffer;
+    UndoTree* undoTree = state.undoTree;
+    const size_t cursorBefore = state.cursorPos;
+    state.undoTree = nullptr;
+    buffer.BeginTransaction();
+    for (size_t i = 0; i < count; ++i) {
+        for (const InputEvent& event : m_Macro) {
+            const InputResult step = event.key != ImGuiKey_None
+                ? m_ActiveMode->HandleKey(state, event)
+                : m_ActiveMode->HandleTextInput(state, event.chars.data(), static_cast<int>(event.chars.size()));
+            result.textChanged |= step.textChanged;
+            Advance(state, step);
+        }
+    }
+    buffer.EndTransaction(cursorBefore, state.cursorPos);
+    state.undoTree = undoTree;
+    
+    result.handled = true;
+    result.cursorMoved = true;
+    result.newCursorPos = state.cursorPos;
+    result.selectionChanged = true;
+    result.newSelectionStart = state.selectionStart;
+    result.newSelectionEnd = state.selectionEnd;
+    result.newExtraCarets = state.extraCarets;
+    return result;
 }
 
 InputResult InputManager::HandleMouse(EditorState& state, ImVec2 mousePos, bool clicked, bool dragging, bool released) {
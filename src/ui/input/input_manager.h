@@ -29,6 +29,16 @@ public:
     InputResult HandleTextInput(EditorState& state, const ImWchar* chars, int count);
     InputResult HandleMouse(EditorState& state, ImVec2 mousePos, bool clicked, bool dragging, bool released);
     
+    // Macros: the keys and text handled between starting and stopping a
+    // recording. Replaying runs them count times into one buffer transaction,
+    // with nothing drawn between, so the buffer is reparsed, sent to a server
+    // and pushed to undo once however often it runs.
+    void StartRecording();
+    void StopRecording();
+    bool IsRecording() const { return m_Recording; }
+    bool HasMacro() const { return !m_Macro.empty(); }
+    InputResult ReplayMacro(EditorState& state, size_t count);
+    
     // Mode indicator for status bar
     const char* GetModeIndicator() const;
     
@@ -42,6 +52,10 @@ private:
     std::unordered_map<std::string, std::unique_ptr<InputMode>> m_Modes;
     std::string m_ActiveModeName;
     InputMode* m_ActiveMode = nullptr;
+    
+    bool m_Recording = false;
+    std::vector<InputEvent> m_Recorded;
+    std::vector<InputEvent> m_Macro;
 };
 
 } // namespace sol
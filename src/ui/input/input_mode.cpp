@@ -192,6 +192,58 @@ size_t FindString(const TextBuffer& buffer, size_t pos, const std::string& str,
     return pos;
 }
 
+// Streams the chunks, carrying over the tail a match could start in
+size_t FindNext(const TextBuffer& buffer, size_t pos, std::string_view needle) {
+    if (needle.empty()) return SIZE_MAX;
+    std::string window;
+    size_t windowStart = pos;
+    size_t found = SIZE_MAX;
+    buffer.ForEachChunk(pos, buffer.Length(), [&](std::string_view chunk) {
+        window.append(chunk);
+        const size_t at = window.find(needle);
+        if (at != std::string::npos) {
+            found = windowStart + at;
+            return false;
+        }
+        const size_t keep = std::min(window.size(), needle.size() - 1);
+        windowStart += window.size() - keep;
+        window.erase(0, window.size() - keep);
+        return true;
+    });
+    return found;
+}
+
+void NormalizeCarets(std::vector<Caret>& carets, size_t& primary) {
+    std::vector<size_t> order(carets.size());
+    for (size_t i = 0; i < order.size(); ++i) order[i] = i;
+    std::sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+        return carets[a].Start() != carets[b].Start() ? carets[a].Start() < carets[b].Start() : carets[a].End() < carets[b].End();
+    });
+    
+    std::vector<Caret> merged;
+    merged.reserve(carets.size());
+    size_t mergedPrimary = 0;
+    for (size_t i : order) {
+        const Caret& caret = carets[i];
+        if (!merged.empty() && (caret.Start() < merged.back().End() || caret.Start() == merged.back().Start())) {
+            // The merged caret keeps the direction of the first
+            Caret& last = merged.back();
+            const size_t end = std::max(last.End(), caret.End());
+            if (last.anchor <= last.pos) {
+                last.pos = end;
+            } else {
+                last.anchor = end;
+            }
+            if (i == primary) mergedPrimary = merged.size() - 1;
+            continue;
+        }
+        if (i == primary) mergedPrimary = merged.size();
+        merged.push_back(caret);
+    }
+    carets = std::move(merged);
+    primary = mergedPrimary;
+}
+
 void Insert(TextBuffer& buffer, UndoTree& undo, size_t pos, const std::string& text, size_t cursorBefore) {
     undo.Push(EditOperation::Insert(pos, text, cursorBefore));
     buffer.Insert(pos, text);
@@ -209,6 +261,19 @@ void Replace(TextBuffer& buffer, UndoTree& undo, size_t pos, size_t len, const s
     buffer.Replace(pos, len, text);
 }
 
+bool ApplyEdits(TextBuffer& buffer, UndoTree& undo, std::vector<TextEdit> edits, size_t cursorBefore, size_t cursorAfter) {
+    std::vector<std::string> replaced;
+    if (!buffer.ApplyEdits(edits, &replaced)) return false;
+    
+    std::vector<EditOperation> parts;
+    parts.reserve(edits.size());
+    for (size_t i = 0; i < edits.size(); ++i) {
+        parts.push_back(EditOperation::Replace(edits[i].pos, replaced[i], edits[i].text, cursorBefore));
+    }
+    undo.Push(EditOperation::Batch(std::move(parts), cursorBefore, cursorAfter));
+    return true;
+}
+
 std::optional<size_t> Undo(TextBuffer& buffer, UndoTree& undo) {
     auto op = undo.Undo();
     if (!op) return std::nullopt;
@@ -236,6 +301,20 @@ std::optional<size_t> Undo(TextBuffer& buffer, UndoTree& undo) {
                 buffer.Replace(op->position, op->newText.length(), op->oldText);
             }
             break;
+        case EditOperation::Type::Batch: {
+            // Each part moves by what the parts before it inserted or removed
+            std::vector<TextEdit> inverse;
+            inverse.reserve(op->parts.size());
+            size_t added = 0;
+            size_t removed = 0;
+            for (auto& part : op->parts) {
+                inverse.push_back({part.position + added - removed, part.newText.length(), std::move(part.oldText)});
+                added += part.newText.length();
+                removed += inverse.back().text.length();
+            }
+            buffer.ApplyEdits(inverse);
+            break;
+        }
     }
     
     // Return cursor position, clamped to valid range
@@ -267,6 +346,15 @@ std::optional<size_t> Redo(TextBuffer& buffer, UndoTree& undo) {
                 buffer.Replace(op->position, op->oldText.length(), op->newText);
             }
             break;
+        case EditOperation::Type::Batch: {
+            std::vector<TextEdit> edits;
+            edits.reserve(op->parts.size());
+            for (auto& part : op->parts) {
+                edits.push_back({part.position, part.oldText.length(), std::move(part.newText)});
+            }
+            buffer.ApplyEdits(edits);
+            break;
+        }
     }
     
     // Return cursor position, clamped to valid range
@@ -1,14 +1,29 @@
 #pragma once
 
 #include <imgui.h>
+#include <algorithm>
 #include <string>
+#include <string_view>
 #include <functional>
 #include <optional>
+#include <vector>
 
 namespace sol {
 
 class TextBuffer;
 class UndoTree;
+struct TextEdit;
+
+// A cursor and the end of its selection that stays put; the two are equal
+// when nothing is selected
+struct Caret {
+    size_t anchor = 0;
+    size_t pos = 0;
+    
+    size_t Start() const { return std::min(anchor, pos); }
+    size_t End() const { return std::max(anchor, pos); }
+    bool HasSelection() const { return anchor != pos; }
+};
 
 // Result of input handling
 struct InputResult {
@@ -19,6 +34,19 @@ struct InputResult {
     std::optional<size_t> newCursorPos;
     std::optional<size_t> newSelectionStart;
     std::optional<size_t> newSelectionEnd;
+    std::optional<std::vector<Caret>> newExtraCarets;
+};
+
+// A key or typed text as an input mode sees it, so input can be handled
+// again without ImGui, as a macro replays it. Key events have key set; text
+// events have chars instead. commandMode is the editor mode it came in.
+struct InputEvent {
+    ImGuiKey key = ImGuiKey_None;
+    bool ctrl = false;
+    bool shift = false;
+    bool alt = false;
+    bool commandMode = false;
+    std::vector<ImWchar> chars;
 };
 
 // Editor state passed to input modes
@@ -30,6 +58,8 @@ struct EditorState {
     size_t selectionStart = 0;
     size_t selectionEnd = 0;
     bool hasSelection = false;
+    // Cursors besides the one above, each with its own selection
+    std::vector<Caret> extraCarets;
     
     // View info
     size_t firstVisibleLine = 0;
@@ -49,8 +79,12 @@ public:
     // Get mode indicator (e.g., "NORMAL", "INSERT", "VISUAL" for vim)
     virtual const char* GetIndicator() const = 0;
     
-    // Handle keyboard input - called every frame when focused
-    virtual InputResult HandleKeyboard(EditorState& state) = 0;
+    // The key pressed this frame, nullopt when none the mode handles -
+    // called every frame when focused
+    virtual std::optional<InputEvent> PollKeyboard(const EditorState& state) = 0;
+    
+    // Handle a key event, reading nothing of ImGui's input state
+    virtual InputResult HandleKey(EditorState& state, const InputEvent& event) = 0;
     
     // Handle text input (character input)
     virtual InputResult HandleTextInput(EditorState& state, const ImWchar* chars, int count) = 0;
@@ -88,11 +122,20 @@ namespace TextOps {
     // Find operations
     size_t FindChar(const TextBuffer& buffer, size_t pos, char c, bool forward = true);
     size_t FindString(const TextBuffer& buffer, size_t pos, const std::string& str, bool forward = true);
+    // First exact occurrence of needle at or after pos, SIZE_MAX when none
+    size_t FindNext(const TextBuffer& buffer, size_t pos, std::string_view needle);
+    
+    // Multiple cursors: sorts carets by position and merges those whose
+    // selections overlap or that sit on the same spot; primary follows the
+    // caret it indexes
+    void NormalizeCarets(std::vector<Caret>& carets, size_t& primary);
     
     // Text manipulation with undo support
     void Insert(TextBuffer& buffer, UndoTree& undo, size_t pos, const std::string& text, size_t cursorBefore);
     void Delete(TextBuffer& buffer, UndoTree& undo, size_t pos, size_t len, size_t cursorBefore);
     void Replace(TextBuffer& buffer, UndoTree& undo, size_t pos, size_t len, const std::string& text, size_t cursorBefore);
+    // All edits as one buffer pass and one undo step; see TextBuffer::ApplyEdits
+    bool ApplyEdits(TextBuffer& buffer, UndoTree& undo, std::vector<TextEdit> edits, size_t cursorBefore, size_t cursorAfter);
     
     // Undo/redo operations
     std::optional<size_t> Undo(TextBuffer& buffer, UndoTree& undo);
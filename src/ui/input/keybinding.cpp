@@ -278,48 +278,60 @@ const char* InputContextToString(InputContext ctx) {
     return "Unknown";
 }
 
+void KeyTrie::Clear() {
+    m_Commands.assign(1, NONE);
+    m_Edges.clear();
+}
+
+void KeyTrie::Insert(const KeySequence& keys, uint32_t command) {
+    uint32_t node = 0;
+    for (const KeyChord& chord : keys.GetChords()) {
+        auto [it, added] = m_Edges.try_emplace(EdgeKey(node, chord), static_cast<uint32_t>(m_Commands.size()));
+        if (added) m_Commands.push_back(NONE);
+        node = it->second;
+    }
+    m_Commands[node] = command;
+}
+
+uint32_t KeyTrie::Next(uint32_t node, const KeyChord& chord) const {
+    auto it = m_Edges.find(EdgeKey(node, chord));
+    return it != m_Edges.end() ? it->second : NONE;
+}
+
+uint64_t KeyTrie::EdgeKey(uint32_t node, const KeyChord& chord) {
+    return (static_cast<uint64_t>(node) << 32) | (static_cast<uint64_t>(static_cast<uint32_t>(chord.key)) << 8) |
+           static_cast<uint8_t>(chord.mods);
+}
+
 void KeySequenceMatcher::Reset() {
     m_CurrentSequence.Clear();
+    m_Node = 0;
+    m_Command = KeyTrie::NONE;
     m_LastChordTime = 0.0;
 }
 
-KeySequenceMatcher::MatchResult KeySequenceMatcher::ProcessChord(const KeyChord& chord) {
+KeySequenceMatcher::MatchResult KeySequenceMatcher::ProcessChord(const KeyTrie& trie, const KeyChord& chord) {
     // No timeout - sequences wait forever until Escape resets
     // This allows users to type key sequences at their own pace
+    if (&trie != m_Trie) {
+        Reset();
+        m_Trie = &trie;
+    }
     
     // Add chord to current sequence
     m_CurrentSequence.Add(chord);
     m_LastChordTime = ImGui::GetTime();
     
-    // Check for matches
-    bool hasPartialMatch = false;
-    bool hasFullMatch = false;
-    
-    for (const auto& binding : m_Bindings) {
-        if (m_CurrentSequence == binding) {
-            hasFullMatch = true;
-            break;
-        }
-        if (m_CurrentSequence.IsPrefixOf(binding)) {
-            hasPartialMatch = true;
-        }
-    }
-    
-    if (hasFullMatch) {
-        return MatchResult::FullMatch;
-    }
-    
-    if (hasPartialMatch) {
-        return MatchResult::PartialMatch;
+    m_Node = trie.Next(m_Node, chord);
+    if (m_Node == KeyTrie::NONE) {
+        // No match - reset
+        Reset();
+        return MatchResult::NoMatch;
     }
     
-    // No match - reset
-    Reset();
-    return MatchResult::NoMatch;
-}
-
-void KeySequenceMatcher::SetBindings(const std::vector<KeySequence>& bindings) {
-    m_Bindings = bindings;
+    // A bound sequence runs even when longer ones start with it
+    m_Command = trie.GetCommand(m_Node);
+    return m_Command != KeyTrie::NONE ? MatchResult::FullMatch : MatchResult::PartialMatch;
 }
 
 float KeySequenceMatcher::GetTimeSinceLastChord() const {
@@ -5,6 +5,7 @@
 #include <vector>
 #include <optional>
 #include <cstdint>
+#include <unordered_map>
 
 namespace sol {
 
@@ -131,10 +132,32 @@ enum class InputContext {
     Search,      // Search/find is active
     Menu,        // Menu is open
 };
+constexpr size_t INPUT_CONTEXT_COUNT = static_cast<size_t>(InputContext::Menu) + 1;
 
 // Convert InputContext to string
 const char* InputContextToString(InputContext ctx);
 
+// Bindings compiled into a trie of chords, so following a key costs one
+// hash lookup however many bindings there are. Node 0 is the root, and a
+// node holds the command of the sequence ending there, if one is bound.
+class KeyTrie {
+public:
+    static constexpr uint32_t NONE = UINT32_MAX;
+    
+    void Clear();
+    // Binds keys to command, replacing what the same keys ran before
+    void Insert(const KeySequence& keys, uint32_t command);
+    // The node chord leads to from node, or NONE
+    uint32_t Next(uint32_t node, const KeyChord& chord) const;
+    uint32_t GetCommand(uint32_t node) const { return m_Commands[node]; }
+    
+private:
+    static uint64_t EdgeKey(uint32_t node, const KeyChord& chord);
+    
+    std::vector<uint32_t> m_Commands{NONE};         // Per node
+    std::unordered_map<uint64_t, uint32_t> m_Edges;  // Node and chord to the node after
+};
+
 // Key sequence matcher for tracking multi-chord sequences
 class KeySequenceMatcher {
 public:
@@ -148,21 +171,24 @@ public:
         FullMatch,    // Found a complete match
     };
     
-    // Process a key chord
-    MatchResult ProcessChord(const KeyChord& chord);
+    // Process a key chord against the bindings of trie; a sequence begun
+    // in another trie starts over
+    MatchResult ProcessChord(const KeyTrie& trie, const KeyChord& chord);
     
     // Get the current partial sequence
     const KeySequence& GetCurrentSequence() const { return m_CurrentSequence; }
     
-    // Set the bindings to match against (called when keymaps change)
-    void SetBindings(const std::vector<KeySequence>& bindings);
+    // Command of the sequence a FullMatch found
+    uint32_t GetCommand() const { return m_Command; }
     
     // Get time since last chord (for UI display)
     float GetTimeSinceLastChord() const;
     
 private:
     KeySequence m_CurrentSequence;
-    std::vector<KeySequence> m_Bindings;
+    const KeyTrie* m_Trie = nullptr;
+    uint32_t m_Node = 0;
+    uint32_t m_Command = KeyTrie::NONE;
     double m_LastChordTime = 0.0;
 };
 
@@ -8,88 +8,195 @@
 
 namespace sol {
 
-InputResult StandardMode::HandleKeyboard(EditorState& state) {
+namespace {
+
+Caret PrimaryCaret(const EditorState& state) {
+    return {state.hasSelection ? state.selectionStart : state.cursorPos, state.cursorPos};
+}
+
+// Every caret in position order, merged where they overlap
+std::vector<Caret> SortedCarets(const EditorState& state, size_t& primary) {
+    std::vector<Caret> carets;
+    carets.reserve(state.extraCarets.size() + 1);
+    carets.push_back(PrimaryCaret(state));
+    carets.insert(carets.end(), state.extraCarets.begin(), state.extraCarets.end());
+    primary = 0;
+    TextOps::NormalizeCarets(carets, primary);
+    return carets;
+}
+
+void SetCarets(InputResult& result, std::vector<Caret> carets, size_t primary) {
+    TextOps::NormalizeCarets(carets, primary);
+    const Caret main = carets[primary];
+    carets.erase(carets.begin() + primary);
+    result.handled = true;
+    result.cursorMoved = true;
+    result.newCursorPos = main.pos;
+    result.selectionChanged = true;
+    result.newSelectionStart = main.anchor;
+    result.newSelectionEnd = main.pos;
+    result.newExtraCarets = std::move(carets);
+}
+
+std::string SelectedText(const TextBuffer& buffer, const std::vector<Caret>& carets) {
+    std::string text;
+    for (const Caret& caret : carets) {
+        if (!caret.HasSelection()) continue;
+        if (!text.empty()) text += '\n';
+        text += buffer.Substring(caret.Start(), caret.End() - caret.Start());
+    }
+    return text;
+}
+
+// One edit per caret, edit(caret, index) giving it, applied as a single
+// batch so it is one reparse, one change set and one undo step however many
+// cursors there are. Carets come in order, so their edits do; one reaching
+// back into the edit before it is cut to where that ends.
+template <typename F>
+InputResult EditCarets(EditorState& state, std::vector<Caret> carets, size_t primary, F&& edit) {
+    std::vector<TextEdit> edits;
+    edits.reserve(carets.size());
+    size_t end = 0;
+    for (size_t i = 0; i < carets.size(); ++i) {
+        TextEdit next = edit(carets[i], i);
+        if (next.pos < end) {
+            next.len = next.pos + next.len > end ? next.pos + next.len - end : 0;
+            next.pos = end;
+        }
+        end = next.pos + next.len;
+        edits.push_back(std::move(next));
+    }
+    
+    // Each caret lands after its own edit, moved by the ones before it
+    const size_t cursorBefore = carets[primary].pos;
+    size_t added = 0;
+    size_t removed = 0;
+    for (size_t i = 0; i < edits.size(); ++i) {
+        const size_t pos = edits[i].pos + added - removed + edits[i].text.length();
+        carets[i] = {pos, pos};
+        added += edits[i].text.length();
+        removed += edits[i].len;
+    }
+    std::erase_if(edits, [](const TextEdit& e) { return e.len == 0 && e.text.empty(); });
+    
     InputResult result;
+    if (!edits.empty()) {
+        if (state.undoTree) {
+            TextOps::ApplyEdits(*state.buffer, *state.undoTree, std::move(edits), cursorBefore, carets[primary].pos);
+        } else {
+            state.buffer->ApplyEdits(edits);
+        }
+        result.textChanged = true;
+    }
+    SetCarets(result, std::move(carets), primary);
+    return result;
+}
+
+} // namespace
+
+// Keys in the order they were checked when handled straight from ImGui, so
+// a frame with several pressed handles the same one
+std::optional<InputEvent> StandardMode::PollKeyboard(const EditorState& state) {
     ImGuiIO& io = ImGui::GetIO();
+    InputEvent event;
+    event.ctrl = io.KeyCtrl;
+    event.shift = io.KeyShift;
+    event.alt = io.KeyAlt;
+    event.commandMode = InputSystem::GetInstance().GetInputMode() == EditorInputMode::Command;
+    auto pressed = [&](ImGuiKey key) {
+        if (!ImGui::IsKeyPressed(key)) return false;
+        event.key = key;
+        return true;
+    };
     
-    bool ctrl = io.KeyCtrl;
-    bool shift = io.KeyShift;
-    bool alt = io.KeyAlt;
+    // Adding and dropping cursors
+    if (event.commandMode && !event.ctrl && !event.alt && !state.extraCarets.empty() &&
+        pressed(EditorSettings::Get().GetKeybinds().modeKey)) {
+        return event;
+    }
+    if (event.ctrl && event.alt && (pressed(ImGuiKey_UpArrow) || pressed(ImGuiKey_DownArrow))) return event;
+    if (event.ctrl && (event.shift ? pressed(ImGuiKey_L) : pressed(ImGuiKey_D))) return event;
     
     // Configurable navigation keys in Command mode (via keybindings like w/a/s/d)
-    bool isCommandMode = InputSystem::GetInstance().GetInputMode() == EditorInputMode::Command;
-    if (isCommandMode && !ctrl && !alt) {
-        ImGuiKey navKey = InputSystem::GetInstance().ConsumePendingNavigation();
-        if (navKey != ImGuiKey_None) {
-            return HandleNavigation(state, navKey, shift, false);
-        }
+    if (event.commandMode && !event.ctrl && !event.alt) {
+        event.key = InputSystem::GetInstance().ConsumePendingNavigation();
+        if (event.key != ImGuiKey_None) return event;
     }
     
-    // Navigation keys
-    if (ImGui::IsKeyPressed(ImGuiKey_LeftArrow) ||
-        ImGui::IsKeyPressed(ImGuiKey_RightArrow) ||
-        ImGui::IsKeyPressed(ImGuiKey_UpArrow) ||
-        ImGui::IsKeyPressed(ImGuiKey_DownArrow) ||
-        ImGui::IsKeyPressed(ImGuiKey_Home) ||
-        ImGui::IsKeyPressed(ImGuiKey_End) ||
-        ImGui::IsKeyPressed(ImGuiKey_PageUp) ||
-        ImGui::IsKeyPressed(ImGuiKey_PageDown)) {
-        
-        ImGuiKey key = ImGuiKey_None;
-        if (ImGui::IsKeyPressed(ImGuiKey_LeftArrow)) key = ImGuiKey_LeftArrow;
-        else if (ImGui::IsKeyPressed(ImGuiKey_RightArrow)) key = ImGuiKey_RightArrow;
-        else if (ImGui::IsKeyPressed(ImGuiKey_UpArrow)) key = ImGuiKey_UpArrow;
-        else if (ImGui::IsKeyPressed(ImGuiKey_DownArrow)) key = ImGuiKey_DownArrow;
-        else if (ImGui::IsKeyPressed(ImGuiKey_Home)) key = ImGuiKey_Home;
-        else if (ImGui::IsKeyPressed(ImGuiKey_End)) key = ImGuiKey_End;
-        else if (ImGui::IsKeyPressed(ImGuiKey_PageUp)) key = ImGuiKey_PageUp;
-        else if (ImGui::IsKeyPressed(ImGuiKey_PageDown)) key = ImGuiKey_PageDown;
-        
-        return HandleNavigation(state, key, shift, ctrl);
+    static constexpr ImGuiKey keys[] = {
+        ImGuiKey_LeftArrow, ImGuiKey_RightArrow, ImGuiKey_UpArrow, ImGuiKey_DownArrow,
+        ImGuiKey_Home, ImGuiKey_End, ImGuiKey_PageUp, ImGuiKey_PageDown,
+        ImGuiKey_Backspace, ImGuiKey_Delete, ImGuiKey_Enter, ImGuiKey_Tab,
+    };
+    for (ImGuiKey key : keys) {
+        if (pressed(key)) return event;
     }
-    
-    // Editing keys - only in Insert mode
-    if (isCommandMode) {
-        // Block editing keys in Command mode - only navigation is allowed
-        // (Tab cycling is handled by cycle_next/cycle_prev keybindings)
-        if (ImGui::IsKeyPressed(ImGuiKey_Backspace) ||
-            ImGui::IsKeyPressed(ImGuiKey_Delete) ||
-            ImGui::IsKeyPressed(ImGuiKey_Enter) ||
-            ImGui::IsKeyPressed(ImGuiKey_Tab)) {
-            // Consume the key but don't edit
-            InputResult blocked;
-            blocked.handled = true;
-            return blocked;
-        }
+    if (event.ctrl && (pressed(ImGuiKey_A) || pressed(ImGuiKey_X) || pressed(ImGuiKey_C) || pressed(ImGuiKey_V))) {
+        return event;
     }
+    return std::nullopt;
+}
+
+InputResult StandardMode::HandleKey(EditorState& state, const InputEvent& event) {
+    InputResult result;
+    const ImGuiKey key = event.key;
+    const bool ctrl = event.ctrl;
+    
+    InputResult carets = HandleCarets(state, event);
+    if (carets.handled) return carets;
     
-    if (ImGui::IsKeyPressed(ImGuiKey_Backspace) ||
-        ImGui::IsKeyPressed(ImGuiKey_Delete) ||
-        ImGui::IsKeyPressed(ImGuiKey_Enter) ||
-        ImGui::IsKeyPressed(ImGuiKey_Tab)) {
+    // Navigation keys
+    switch (key) {
+        case ImGuiKey_LeftArrow:
+        case ImGuiKey_RightArrow:
+        case ImGuiKey_UpArrow:
+        case ImGuiKey_DownArrow:
+        case ImGuiKey_Home:
+        case ImGuiKey_End:
+        case ImGuiKey_PageUp:
+        case ImGuiKey_PageDown:
+            return HandleNavigation(state, key, event.shift, ctrl);
         
-        ImGuiKey key = ImGuiKey_None;
-        if (ImGui::IsKeyPressed(ImGuiKey_Backspace)) key = ImGuiKey_Backspace;
-        else if (ImGui::IsKeyPressed(ImGuiKey_Delete)) key = ImGuiKey_Delete;
-        else if (ImGui::IsKeyPressed(ImGuiKey_Enter)) key = ImGuiKey_Enter;
-        else if (ImGui::IsKeyPressed(ImGuiKey_Tab)) key = ImGuiKey_Tab;
+        case ImGuiKey_Backspace:
+        case ImGuiKey_Delete:
+        case ImGuiKey_Enter:
+        case ImGuiKey_Tab:
+            // Block editing keys in Command mode - only navigation is allowed
+            // (Tab cycling is handled by cycle_next/cycle_prev keybindings)
+            if (event.commandMode) {
+                result.handled = true;
+                return result;
+            }
+            return HandleEditing(state, key, event.shift, ctrl);
         
-        return HandleEditing(state, key, ctrl);
+        default:
+            break;
     }
     
     // Select all
-    if (ctrl && ImGui::IsKeyPressed(ImGuiKey_A)) {
+    if (ctrl && key == ImGuiKey_A) {
         result.handled = true;
         result.selectionChanged = true;
         result.newSelectionStart = 0;
         result.newSelectionEnd = state.buffer->Length();
         result.newCursorPos = state.buffer->Length();
+        result.newExtraCarets.emplace();
         return result;
     }
     
     // Cut/Copy/Paste
-    if (ctrl && ImGui::IsKeyPressed(ImGuiKey_X)) {
+    if (ctrl && key == ImGuiKey_X) {
         // Cut
+        if (!state.extraCarets.empty()) {
+            size_t primary = 0;
+            std::vector<Caret> all = SortedCarets(state, primary);
+            const std::string selected = SelectedText(*state.buffer, all);
+            if (selected.empty()) return result;
+            ImGui::SetClipboardText(selected.c_str());
+            return EditCarets(state, std::move(all), primary, [](const Caret& caret, size_t) {
+                return TextEdit{caret.Start(), caret.End() - caret.Start(), ""};
+            });
+        }
         if (state.hasSelection) {
             size_t start = std::min(state.selectionStart, state.selectionEnd);
             size_t end = std::max(state.selectionStart, state.selectionEnd);
@@ -106,8 +213,17 @@ InputResult StandardMode::HandleKeyboard(EditorState& state) {
         return result;
     }
     
-    if (ctrl && ImGui::IsKeyPressed(ImGuiKey_C)) {
+    if (ctrl && key == ImGuiKey_C) {
         // Copy
+        if (!state.extraCarets.empty()) {
+            size_t primary = 0;
+            const std::string selected = SelectedText(*state.buffer, SortedCarets(state, primary));
+            if (!selected.empty()) {
+                ImGui::SetClipboardText(selected.c_str());
+                result.handled = true;
+            }
+            return result;
+        }
         if (state.hasSelection) {
             size_t start = std::min(state.selectionStart, state.selectionEnd);
             size_t end = std::max(state.selectionStart, state.selectionEnd);
@@ -118,9 +234,25 @@ InputResult StandardMode::HandleKeyboard(EditorState& state) {
         return result;
     }
     
-    if (ctrl && ImGui::IsKeyPressed(ImGuiKey_V)) {
+    if (ctrl && key == ImGuiKey_V) {
         // Paste
         const char* clipboard = ImGui::GetClipboardText();
+        if (clipboard && strlen(clipboard) > 0 && !state.extraCarets.empty()) {
+            // As many lines as cursors go one to each, as a multi-cursor copy left them
+            size_t primary = 0;
+            std::vector<Caret> all = SortedCarets(state, primary);
+            std::vector<std::string_view> lines;
+            for (std::string_view rest = clipboard; lines.size() <= all.size();) {
+                const size_t newline = rest.find('\n');
+                lines.push_back(rest.substr(0, newline));
+                if (newline == std::string_view::npos) break;
+                rest.remove_prefix(newline + 1);
+            }
+            const bool spread = lines.size() == all.size();
+            return EditCarets(state, std::move(all), primary, [&](const Caret& caret, size_t index) {
+                return TextEdit{caret.Start(), caret.End() - caret.Start(), std::string(spread ? lines[index] : clipboard)};
+            });
+        }
         if (clipboard && strlen(clipboard) > 0) {
             if (state.hasSelection) {
                 DeleteSelection(state);
@@ -143,31 +275,72 @@ InputResult StandardMode::HandleNavigation(EditorState& state, ImGuiKey key, boo
     InputResult result;
     result.handled = true;
     
-    size_t newPos = state.cursorPos;
+    const std::optional<size_t> moved = Move(state, PrimaryCaret(state), key, shift, ctrl);
+    if (!moved) {
+        result.handled = false;
+        return result;
+    }
+    if (!state.extraCarets.empty()) {
+        // Every cursor moves alike, extending its own selection with shift
+        size_t primary = 0;
+        std::vector<Caret> all = SortedCarets(state, primary);
+        for (Caret& caret : all) {
+            const size_t to = *Move(state, caret, key, shift, ctrl);
+            caret = {shift ? caret.anchor : to, to};
+        }
+        SetCarets(result, std::move(all), primary);
+        return result;
+    }
+    size_t newPos = *moved;
+    
+    result.cursorMoved = (newPos != state.cursorPos);
+    result.newCursorPos = newPos;
+    
+    if (shift) {
+        // Extend selection
+        if (!state.hasSelection) {
+            result.newSelectionStart = state.cursorPos;
+        } else {
+            result.newSelectionStart = state.selectionStart;
+        }
+        result.newSelectionEnd = newPos;
+        result.selectionChanged = true;
+    } else {
+        // Clear selection
+        result.newSelectionStart = newPos;
+        result.newSelectionEnd = newPos;
+        result.selectionChanged = state.hasSelection;
+    }
+    
+    return result;
+}
+
+std::optional<size_t> StandardMode::Move(const EditorState& state, const Caret& caret, ImGuiKey key, bool shift, bool ctrl) const {
+    size_t newPos = caret.pos;
     
     switch (key) {
         case ImGuiKey_LeftArrow:
             if (ctrl) {
-                newPos = TextOps::PrevWord(*state.buffer, state.cursorPos);
-            } else if (state.hasSelection && !shift) {
-                newPos = std::min(state.selectionStart, state.selectionEnd);
-            } else if (state.cursorPos > 0) {
+                newPos = TextOps::PrevWord(*state.buffer, caret.pos);
+            } else if (caret.HasSelection() && !shift) {
+                newPos = caret.Start();
+            } else if (caret.pos > 0) {
                 --newPos;
             }
             break;
             
         case ImGuiKey_RightArrow:
             if (ctrl) {
-                newPos = TextOps::NextWord(*state.buffer, state.cursorPos);
-            } else if (state.hasSelection && !shift) {
-                newPos = std::max(state.selectionStart, state.selectionEnd);
-            } else if (state.cursorPos < state.buffer->Length()) {
+                newPos = TextOps::NextWord(*state.buffer, caret.pos);
+            } else if (caret.HasSelection() && !shift) {
+                newPos = caret.End();
+            } else if (caret.pos < state.buffer->Length()) {
                 ++newPos;
             }
             break;
             
         case ImGuiKey_UpArrow: {
-            auto [line, col] = state.buffer->PosToLineCol(state.cursorPos);
+            auto [line, col] = state.buffer->PosToLineCol(caret.pos);
             if (line > 0) {
                 std::string prevLine = state.buffer->Line(line - 1);
                 size_t newCol = std::min(col, prevLine.length());
@@ -177,7 +350,7 @@ InputResult StandardMode::HandleNavigation(EditorState& state, ImGuiKey key, boo
         }
             
         case ImGuiKey_DownArrow: {
-            auto [line, col] = state.buffer->PosToLineCol(state.cursorPos);
+            auto [line, col] = state.buffer->PosToLineCol(caret.pos);
             if (line < state.buffer->LineCount() - 1) {
                 std::string nextLine = state.buffer->Line(line + 1);
                 size_t newCol = std::min(col, nextLine.length());
@@ -190,7 +363,7 @@ InputResult StandardMode::HandleNavigation(EditorState& state, ImGuiKey key, boo
             if (ctrl) {
                 newPos = 0;
             } else {
-                newPos = TextOps::LineStart(*state.buffer, state.cursorPos);
+                newPos = TextOps::LineStart(*state.buffer, caret.pos);
             }
             break;
             
@@ -198,13 +371,13 @@ InputResult StandardMode::HandleNavigation(EditorState& state, ImGuiKey key, boo
             if (ctrl) {
                 newPos = state.buffer->Length();
             } else {
-                newPos = TextOps::LineEnd(*state.buffer, state.cursorPos);
+                newPos = TextOps::LineEnd(*state.buffer, caret.pos);
             }
             break;
             
         case ImGuiKey_PageUp: {
             size_t visibleLines = state.lastVisibleLine - state.firstVisibleLine;
-            auto [line, col] = state.buffer->PosToLineCol(state.cursorPos);
+            auto [line, col] = state.buffer->PosToLineCol(caret.pos);
             size_t newLine = (line > visibleLines) ? line - visibleLines : 0;
             std::string targetLine = state.buffer->Line(newLine);
             size_t newCol = std::min(col, targetLine.length());
@@ -214,7 +387,7 @@ InputResult StandardMode::HandleNavigation(EditorState& state, ImGuiKey key, boo
             
         case ImGuiKey_PageDown: {
             size_t visibleLines = state.lastVisibleLine - state.firstVisibleLine;
-            auto [line, col] = state.buffer->PosToLineCol(state.cursorPos);
+            auto [line, col] = state.buffer->PosToLineCol(caret.pos);
             size_t lineCount = state.buffer->LineCount();
             size_t newLine = std::min(line + visibleLines, lineCount - 1);
             std::string targetLine = state.buffer->Line(newLine);
@@ -224,33 +397,31 @@ InputResult StandardMode::HandleNavigation(EditorState& state, ImGuiKey key, boo
         }
             
         default:
-            result.handled = false;
-            return result;
-    }
-    
-    result.cursorMoved = (newPos != state.cursorPos);
-    result.newCursorPos = newPos;
-    
-    if (shift) {
-        // Extend selection
-        if (!state.hasSelection) {
-            result.newSelectionStart = state.cursorPos;
-        } else {
-            result.newSelectionStart = state.selectionStart;
-        }
-        result.newSelectionEnd = newPos;
-        result.selectionChanged = true;
-    } else {
-        // Clear selection
-        result.newSelectionStart = newPos;
-        result.newSelectionEnd = newPos;
-        result.selectionChanged = state.hasSelection;
+            return std::nullopt;
     }
     
-    return result;
+    return newPos;
 }
 
-InputResult StandardMode::HandleEditing(EditorState& state, ImGuiKey key, bool ctrl) {
+InputResult StandardMode::HandleEditing(EditorState& state, ImGuiKey key, bool shift, bool ctrl) {
+    if (!state.extraCarets.empty()) {
+        const TextBuffer& buffer = *state.buffer;
+        size_t primary = 0;
+        std::vector<Caret> all = SortedCarets(state, primary);
+        return EditCarets(state, std::move(all), primary, [&](const Caret& caret, size_t) {
+            if (caret.HasSelection() || key == ImGuiKey_Enter || key == ImGuiKey_Tab) {
+                const char* text = key == ImGuiKey_Enter ? "\n" : key == ImGuiKey_Tab ? "    " : "";
+                return TextEdit{caret.Start(), caret.End() - caret.Start(), text};
+            }
+            if (key == ImGuiKey_Backspace) {
+                const size_t from = ctrl ? TextOps::PrevWord(buffer, caret.pos) : caret.pos - std::min<size_t>(caret.pos, 1);
+                return TextEdit{from, caret.pos - from, ""};
+            }
+            const size_t to = ctrl ? TextOps::NextWord(buffer, caret.pos) : std::min(caret.pos + 1, buffer.Length());
+            return TextEdit{caret.pos, to - caret.pos, ""};
+        });
+    }
+    
     InputResult result;
     result.handled = true;
     
@@ -320,9 +491,13 @@ InputResult StandardMode::HandleEditing(EditorState& state, ImGuiKey key, bool c
             result.newSelectionEnd = result.newCursorPos;
             break;
             
-        case ImGuiKey_Tab:
+        case ImGuiKey_Tab: {
+            size_t start = std::min(state.selectionStart, state.selectionEnd);
+            size_t end = std::max(state.selectionStart, state.selectionEnd);
+            if (state.hasSelection && state.buffer->PosToLineCol(start).first != state.buffer->PosToLineCol(end).first) {
+                return IndentLines(state, start, end, shift);
+            }
             if (state.hasSelection) {
-                // TODO: Indent selection
                 DeleteSelection(state);
             }
             InsertText(state, "    ");  // 4 spaces
@@ -332,6 +507,7 @@ InputResult StandardMode::HandleEditing(EditorState& state, ImGuiKey key, bool c
             result.newSelectionStart = result.newCursorPos;
             result.newSelectionEnd = result.newCursorPos;
             break;
+        }
             
         default:
             result.handled = false;
@@ -346,13 +522,6 @@ InputResult StandardMode::HandleTextInput(EditorState& state, const ImWchar* cha
     
     if (count == 0) return result;
     
-    // Delete selection first
-    if (state.hasSelection) {
-        size_t start = std::min(state.selectionStart, state.selectionEnd);
-        DeleteSelection(state);
-        state.cursorPos = start;
-    }
-    
     // Convert ImWchar to UTF-8
     std::string text;
     for (int i = 0; i < count; ++i) {
@@ -371,6 +540,21 @@ InputResult StandardMode::HandleTextInput(EditorState& state, const ImWchar* cha
         }
     }
     
+    if (!state.extraCarets.empty()) {
+        size_t primary = 0;
+        std::vector<Caret> all = SortedCarets(state, primary);
+        return EditCarets(state, std::move(all), primary, [&](const Caret& caret, size_t) {
+            return TextEdit{caret.Start(), caret.End() - caret.Start(), text};
+        });
+    }
+    
+    // Delete selection first
+    if (state.hasSelection) {
+        size_t start = std::min(state.selectionStart, state.selectionEnd);
+        DeleteSelection(state);
+        state.cursorPos = start;
+    }
+    
     InsertText(state, text);
     
     result.handled = true;
@@ -392,6 +576,116 @@ InputResult StandardMode::HandleMouse(EditorState& state, ImVec2 mousePos, bool
     return result;
 }
 
+// Ctrl+D selects the word at the cursor, then adds a cursor on the next
+// occurrence of the selection; Ctrl+Shift+L adds one on every occurrence;
+// Ctrl+Alt+Up/Down adds one on the line above or below. The added cursor
+// becomes the primary one. The mode key in Command mode drops all but it.
+InputResult StandardMode::HandleCarets(EditorState& state, const InputEvent& event) {
+    InputResult result;
+    const TextBuffer& buffer = *state.buffer;
+    if (!state.extraCarets.empty() && event.commandMode && !event.ctrl && !event.alt &&
+        event.key == EditorSettings::Get().GetKeybinds().modeKey) {
+        result.handled = true;
+        result.newExtraCarets.emplace();
+        return result;
+    }
+    if (!event.ctrl) return result;
+    
+    std::vector<Caret> carets;
+    carets.push_back(PrimaryCaret(state));
+    carets.insert(carets.end(), state.extraCarets.begin(), state.extraCarets.end());
+    
+    const bool up = event.key == ImGuiKey_UpArrow;
+    if (event.alt && (up || event.key == ImGuiKey_DownArrow)) {
+        result.handled = true;
+        auto [line, col] = buffer.PosToLineCol(state.cursorPos);
+        if (up ? line == 0 : line + 1 >= buffer.LineCount()) return result;
+        const size_t target = up ? line - 1 : line + 1;
+        const size_t pos = buffer.LineColToPos(target, std::min(col, buffer.LineEnd(target) - buffer.LineStart(target)));
+        carets.push_back({pos, pos});
+        const size_t added = carets.size() - 1;
+        SetCarets(result, std::move(carets), added);
+        return result;
+    }
+    
+    const bool next = !event.shift && event.key == ImGuiKey_D;
+    const bool every = event.shift && event.key == ImGuiKey_L;
+    if (!next && !every) return result;
+    result.handled = true;
+    if (!carets[0].HasSelection()) {
+        const size_t start = TextOps::WordStart(buffer, state.cursorPos);
+        const size_t end = TextOps::WordEnd(buffer, state.cursorPos);
+        if (start == end) return result;
+        carets[0] = {start, end};
+        if (next) {
+            SetCarets(result, std::move(carets), 0);
+            return result;
+        }
+    }
+    
+    const Caret selected = carets[0];
+    const std::string needle = buffer.Substring(selected.Start(), selected.End() - selected.Start());
+    size_t primary = 0;
+    if (next) {
+        size_t at = TextOps::FindNext(buffer, selected.End(), needle);
+        if (at == SIZE_MAX) at = TextOps::FindNext(buffer, 0, needle);
+        carets.push_back({at, at + needle.length()});
+        primary = carets.size() - 1;
+    } else {
+        for (size_t at = TextOps::FindNext(buffer, 0, needle); at != SIZE_MAX;
+             at = TextOps::FindNext(buffer, at + needle.length(), needle)) {
+            carets.push_back({at, at + needle.length()});
+        }
+    }
+    SetCarets(result, std::move(carets), primary);
+    return result;
+}
+
+// Indents or outdents every line the selection touches as one edit batch
+InputResult StandardMode::IndentLines(EditorState& state, size_t start, size_t end, bool outdent) {
+    TextBuffer& buffer = *state.buffer;
+    size_t firstLine = buffer.PosToLineCol(start).first;
+    size_t lastLine = buffer.PosToLineCol(end).first;
+    // A selection ending at the start of a line leaves that line alone
+    if (lastLine > firstLine && buffer.LineStart(lastLine) == end) --lastLine;
+    
+    std::vector<TextEdit> edits;
+    size_t added = 0;
+    size_t removed = 0;
+    for (size_t line = firstLine; line <= lastLine; ++line) {
+        size_t lineStart = buffer.LineStart(line);
+        if (outdent) {
+            size_t n = 0;
+            while (n < 4 && buffer.At(lineStart + n) == ' ') ++n;
+            if (n == 0 && buffer.At(lineStart) == '\t') n = 1;
+            if (n > 0) {
+                edits.push_back({lineStart, n, ""});
+                removed += n;
+            }
+        } else if (buffer.LineEnd(line) > lineStart) {
+            edits.push_back({lineStart, 0, "    "});
+            added += 4;
+        }
+    }
+    
+    InputResult result;
+    result.handled = true;
+    if (edits.empty()) return result;
+    
+    size_t selectionEnd = buffer.LineEnd(lastLine) + added - removed;
+    if (state.undoTree) {
+        TextOps::ApplyEdits(buffer, *state.undoTree, std::move(edits), state.cursorPos, selectionEnd);
+    } else {
+        buffer.ApplyEdits(edits);
+    }
+    result.textChanged = true;
+    result.newCursorPos = selectionEnd;
+    result.selectionChanged = true;
+    result.newSelectionStart = buffer.LineStart(firstLine);
+    result.newSelectionEnd = selectionEnd;
+    return result;
+}
+
 void StandardMode::DeleteSelection(EditorState& state) {
     if (!state.hasSelection) return;
     
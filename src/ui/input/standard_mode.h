@@ -10,7 +10,8 @@ public:
     const char* GetName() const override { return "Standard"; }
     const char* GetIndicator() const override { return ""; }
     
-    InputResult HandleKeyboard(EditorState& state) override;
+    std::optional<InputEvent> PollKeyboard(const EditorState& state) override;
+    InputResult HandleKey(EditorState& state, const InputEvent& event) override;
     InputResult HandleTextInput(EditorState& state, const ImWchar* chars, int count) override;
     InputResult HandleMouse(EditorState& state, ImVec2 mousePos, bool clicked, bool dragging, bool released) override;
     
@@ -19,7 +20,13 @@ public:
 private:
     // Helper methods
     InputResult HandleNavigation(EditorState& state, ImGuiKey key, bool shift, bool ctrl);
-    InputResult HandleEditing(EditorState& state, ImGuiKey key, bool ctrl);
+    InputResult HandleEditing(EditorState& state, ImGuiKey key, bool shift, bool ctrl);
+    // Where key moves caret to; nullopt for keys that are not motions
+    std::optional<size_t> Move(const EditorState& state, const Caret& caret, ImGuiKey key, bool shift, bool ctrl) const;
+    // Adding and dropping cursors
+    InputResult HandleCarets(EditorState& state, const InputEvent& event);
+    
+    InputResult IndentLines(EditorState& state, size_t start, size_t end, bool outdent);
     
     void DeleteSelection(EditorState& state);
     void InsertText(EditorState& state, const std::string& text);
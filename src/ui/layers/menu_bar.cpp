@@ -1,6 +1,7 @@
 #include "menu_bar.h"
 #include "ui/ui_system.h"
 #include "core/resource_system.h"
+#include "core/event_bus.h"
 #include "ui/editor_settings.h"
 #include <imgui.h>
 
@@ -21,7 +22,7 @@ MenuBar::MenuBar(UISystem* uiSystem)
 void MenuBar::Render() {
     if (ImGui::BeginMenu("Sol")) {
         if (ImGui::MenuItem("Settings", GetShortcut("toggle_settings"))) {
-            EventSystem::Execute("toggle_window", {{"window_id", std::string("Settings")}});
+            EventBus::Publish(ToggleWindowEvent{"Settings"});
         }
         ImGui::Separator();
         if (ImGui::MenuItem("Exit", GetShortcut("exit"))) {
@@ -77,11 +78,17 @@ void MenuBar::RenderViewMenu() {
             EventSystem::Execute("split_horizontal");
         }
 
-        auto settings = m_UISystem->GetLayer("Settings");
-        if (settings) {
-            bool enabled = settings->IsEnabled();
+        if (m_UISystem->HasLayer("Settings")) {
+            bool enabled = m_UISystem->IsLayerEnabled("Settings");
             if (ImGui::MenuItem("Settings", GetShortcut("toggle_settings"), &enabled)) {
-                EventSystem::Execute("toggle_window", {{"window_id", std::string("Settings")}});
+                EventBus::Publish(ToggleWindowEvent{"Settings"});
+            }
+        }
+
+        if (m_UISystem->HasLayer("PerfHud")) {
+            bool enabled = m_UISystem->IsLayerEnabled("PerfHud");
+            if (ImGui::MenuItem("Performance HUD", GetShortcut("toggle_perf_hud"), &enabled)) {
+                EventBus::Publish(ToggleWindowEvent{"PerfHud"});
             }
         }
         
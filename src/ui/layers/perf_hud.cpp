@@ -0,0 +1,203 @@
+#include "perf_hud.h"
+#include "core/frame_scheduler.h"
+#include "core/job_system.h"
+#include "core/resource_system.h"
+#include "core/terminal/terminal_emulator.h"
+#include "core/text/parser_pool.h"
+#include <imgui.h>
+#include <algorithm>
+#include <cstdio>
+
+namespace sol {
+
+namespace {
+
+void FormatBytes(char* out, size_t size, double bytes) {
+    if (bytes >= 1024.0 * 1024.0) {
+        snprintf(out, size, "%.1f MB", bytes / (1024.0 * 1024.0));
+    } else if (bytes >= 1024.0) {
+        snprintf(out, size, "%.1f KB", bytes / 1024.0);
+    } else {
+        snprintf(out, size, "%.0f B", bytes);
+    }
+}
+
+double Milliseconds(std::chrono::microseconds time) {
+    return static_cast<double>(time.count()) / 1000.0;
+}
+
+const char* ResidencyName(TextResource::Residency residency) {
+    switch (residency) {
+        case TextResource::Residency::Full:      return "";
+        case TextResource::Residency::NoSyntax:  return " (no syntax)";
+        case TextResource::Residency::NoCaches:  return " (no caches)";
+        case TextResource::Residency::NoContent: return " (unloaded)";
+        case TextResource::Residency::Unread:    return " (unread)";
+    }
+    return "";
+}
+
+} // namespace
+
+PerfHud::PerfHud(const Id& id)
+    : UILayer(id) {
+}
+
+void PerfHud::OnUI() {
+    m_FrameTimes[m_FrameIndex] = ImGui::GetIO().DeltaTime * 1000.0f;
+    m_FrameIndex = (m_FrameIndex + 1) % FRAME_HISTORY;
+
+    if (std::chrono::steady_clock::now() - m_LastSample >= SAMPLE_INTERVAL) {
+        Sample();
+    }
+    FrameScheduler::GetInstance().RequestFrameAt(m_LastSample + SAMPLE_INTERVAL);
+
+    bool open = true;
+    ImGuiViewport* viewport = ImGui::GetMainViewport();
+    const float scale = ImGui::GetIO().FontGlobalScale;
+    ImGui::SetNextWindowPos(ImVec2(viewport->WorkPos.x + viewport->WorkSize.x - 16.0f * scale,
+                                   viewport->WorkPos.y + 16.0f * scale),
+                            ImGuiCond_FirstUseEver, ImVec2(1.0f, 0.0f));
+    ImGui::SetNextWindowSize(ImVec2(420.0f * scale, 0.0f), ImGuiCond_FirstUseEver);
+    ImGui::SetNextWindowBgAlpha(0.9f);
+
+    ImGuiWindowFlags flags = ImGuiWindowFlags_NoDocking | ImGuiWindowFlags_NoFocusOnAppearing | ImGuiWindowFlags_NoNav;
+    if (ImGui::Begin("Performance", &open, flags)) {
+        RenderFrameTimes();
+
+        ImGui::Text("Jobs queued: %zu interactive, %zu background, %zu idle",
+                    JobSystem::GetQueueDepth(JobPriority::Interactive),
+                    JobSystem::GetQueueDepth(JobPriority::Background),
+                    JobSystem::GetQueueDepth(JobPriority::Idle));
+        char rate[32];
+        FormatBytes(rate, sizeof(rate), m_TerminalRate);
+        ImGui::Text("Terminal output: %s/s", rate);
+
+        RenderBuffers();
+        RenderLanguageServers();
+    }
+    ImGui::End();
+
+    if (!open) {
+        SetEnabled(false);
+    }
+}
+
+void PerfHud::Sample() {
+    const auto now = std::chrono::steady_clock::now();
+    const uint64_t bytes = TerminalEmulator::GetBytesReceived();
+    if (m_LastSample != std::chrono::steady_clock::time_point()) {
+        const double seconds = std::chrono::duration<double>(now - m_LastSample).count();
+        m_TerminalRate = static_cast<float>(static_cast<double>(bytes - m_TerminalBytes) / seconds);
+    }
+    m_TerminalBytes = bytes;
+    m_LastSample = now;
+    m_Servers = LSPManager::GetInstance().GetServerStats();
+}
+
+void PerfHud::RenderFrameTimes() {
+    float total = 0.0f;
+    float worst = 0.0f;
+    for (float time : m_FrameTimes) {
+        total += time;
+        worst = std::max(worst, time);
+    }
+    const float average = total / static_cast<float>(FRAME_HISTORY);
+
+    char overlay[64];
+    snprintf(overlay, sizeof(overlay), "%.2f ms avg, %.2f ms max", average, worst);
+    ImGui::PlotHistogram("##FrameTimes", m_FrameTimes.data(), static_cast<int>(FRAME_HISTORY),
+                         static_cast<int>(m_FrameIndex), overlay, 0.0f, std::max(worst, 1000.0f / 30.0f),
+                         ImVec2(-1.0f, 48.0f * ImGui::GetIO().FontGlobalScale));
+}
+
+void PerfHud::RenderBuffers() {
+    if (!ImGui::CollapsingHeader("Buffers", ImGuiTreeNodeFlags_DefaultOpen)) return;
+    const auto& buffers = ResourceSystem::GetInstance().GetBuffers();
+    if (buffers.empty()) {
+        ImGui::TextDisabled("No buffers open");
+        return;
+    }
+    if (!ImGui::BeginTable("##PerfBuffers", 5, ImGuiTableFlags_RowBg | ImGuiTableFlags_SizingStretchProp)) return;
+
+    ImGui::TableSetupColumn("Buffer");
+    ImGui::TableSetupColumn("Parse");
+    ImGui::TableSetupColumn("Highlight hits");
+    ImGui::TableSetupColumn("Tree");
+    ImGui::TableSetupColumn("Memory");
+    ImGui::TableHeadersRow();
+    size_t treeBytes = 0;
+    size_t trees = 0;
+    for (const auto& buffer : buffers) {
+        auto text = std::dynamic_pointer_cast<TextResource>(buffer->GetResource());
+        if (!text) continue;
+        const TextBuffer& textBuffer = text->GetBuffer();
+
+        ImGui::TableNextRow();
+        ImGui::TableNextColumn();
+        ImGui::TextUnformatted(buffer->GetName().c_str());
+
+        ImGui::TableNextColumn();
+        if (textBuffer.IsParsed()) {
+            ImGui::Text("%.2f ms", Milliseconds(textBuffer.GetLastParseTime()));
+        } else {
+            ImGui::TextDisabled("-");
+        }
+
+        ImGui::TableNextColumn();
+        const TextBuffer::HighlightStats& highlights = textBuffer.GetHighlightStats();
+        const uint64_t lookups = highlights.hits + highlights.misses;
+        if (lookups > 0) {
+            ImGui::Text("%.1f%%", 100.0 * static_cast<double>(highlights.hits) / static_cast<double>(lookups));
+        } else {
+            ImGui::TextDisabled("-");
+        }
+
+        ImGui::TableNextColumn();
+        char memory[32];
+        if (const size_t bytes = textBuffer.GetTreeMemory()) {
+            FormatBytes(memory, sizeof(memory), static_cast<double>(bytes));
+            ImGui::TextUnformatted(memory);
+            treeBytes += bytes;
+            ++trees;
+        } else {
+            ImGui::TextDisabled("-");
+        }
+
+        ImGui::TableNextColumn();
+        FormatBytes(memory, sizeof(memory), static_cast<double>(text->GetMemoryUsage()));
+        ImGui::Text("%s%s", memory, ResidencyName(text->GetResidency()));
+    }
+    ImGui::EndTable();
+
+    char total[32];
+    FormatBytes(total, sizeof(total), static_cast<double>(treeBytes));
+    const ParserPool::Stats parsers = ParserPool::GetInstance().GetStats();
+    ImGui::Text("Syntax trees: %s in %zu buffers, %zu parsers (%zu idle)", total, trees, parsers.parsers,
+                parsers.idle);
+}
+
+void PerfHud::RenderLanguageServers() {
+    if (!ImGui::CollapsingHeader("Language servers", ImGuiTreeNodeFlags_DefaultOpen)) return;
+    if (m_Servers.empty()) {
+        ImGui::TextDisabled("No servers running");
+        return;
+    }
+    for (const LSPManager::ServerStats& server : m_Servers) {
+        ImGui::TextUnformatted(server.name.c_str());
+        if (server.requests.empty()) {
+            ImGui::TextDisabled("  No requests answered");
+            continue;
+        }
+        std::vector<std::pair<std::string, LSPClient::RequestStats>> requests(server.requests.begin(),
+                                                                               server.requests.end());
+        std::sort(requests.begin(), requests.end(), [](const auto& a, const auto& b) { return a.first < b.first; });
+        for (const auto& [method, stats] : requests) {
+            const double average = Milliseconds(stats.total) / static_cast<double>(stats.count);
+            ImGui::Text("  %s: %.1f ms last, %.1f avg, %.1f max (%zu)", method.c_str(), Milliseconds(stats.last),
+                        average, Milliseconds(stats.max), stats.count);
+        }
+    }
+}
+
+} // namespace sol
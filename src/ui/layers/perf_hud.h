@@ -0,0 +1,42 @@
+#pragma once
+
+#include "ui/ui_system.h"
+#include "core/lsp/lsp_manager.h"
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <vector>
+
+namespace sol {
+
+// Overlay of the editor's own measurements: frame times, each buffer's
+// parse time, highlight cache hit rate, tree and total memory, the parsers
+// shared by all of them, language server round trips, JobSystem queues and
+// terminal throughput. Numbers that take locks to collect are sampled a few
+// times a second.
+class PerfHud : public UILayer {
+public:
+    explicit PerfHud(const Id& id = "PerfHud");
+    ~PerfHud() override = default;
+
+    void OnUI() override;
+
+private:
+    static constexpr size_t FRAME_HISTORY = 240;
+    static constexpr auto SAMPLE_INTERVAL = std::chrono::milliseconds(500);
+
+    void Sample();
+    void RenderFrameTimes();
+    void RenderBuffers();
+    void RenderLanguageServers();
+
+    std::array<float, FRAME_HISTORY> m_FrameTimes{};  // Milliseconds, a ring
+    size_t m_FrameIndex = 0;
+
+    std::chrono::steady_clock::time_point m_LastSample;
+    uint64_t m_TerminalBytes = 0;
+    float m_TerminalRate = 0.0f;  // Bytes per second over the last interval
+    std::vector<LSPManager::ServerStats> m_Servers;
+};
+
+} // namespace sol
@@ -61,6 +61,9 @@ void SettingsWindow::OnUI() {
     }
     ImGui::End();
 
+    // Edits are written once they settle, not on every frame of a drag
+    if (!ImGui::IsAnyItemActive()) EditorSettings::Get().SaveDirty();
+
     if (!open) {
         SetEnabled(false);
     }
@@ -90,7 +93,7 @@ void SettingsWindow::RenderFontSection() {
                 m_SelectedFont = i;
                 font.fontId = fonts[i].id;
                 settings.SetFontDirty(true);
-                settings.Save();
+                settings.MarkDirty(EditorSettings::File::Theme);
             }
             if (selected) ImGui::SetItemDefaultFocus();
         }
@@ -100,13 +103,13 @@ void SettingsWindow::RenderFontSection() {
     // Font size
     if (ImGui::DragFloat("Font Size", &font.fontSize, 0.5f, 8.0f, 32.0f, "%.1f")) {
         settings.SetFontDirty(true);
-        settings.Save();
+        settings.MarkDirty(EditorSettings::File::Theme);
     }
 
     // Font scale
     if (ImGui::DragFloat("UI Scale", &font.fontScale, 0.01f, 0.5f, 2.0f, "%.2f")) {
         ImGui::GetIO().FontGlobalScale = font.fontScale;
-        settings.Save();
+        settings.MarkDirty(EditorSettings::File::Theme);
     }
 
     // Apply font button (font reload is expensive so we do it on demand)
@@ -136,7 +139,7 @@ void SettingsWindow::RenderColorSection() {
             if (ImGui::Selectable(s_PresetNames[i], selected)) {
                 m_SelectedPreset = i;
                 settings.SetPreset(s_PresetNames[i]);
-                settings.Save();
+                settings.MarkDirty(EditorSettings::File::Theme);
             }
             if (selected) ImGui::SetItemDefaultFocus();
         }
@@ -223,7 +226,7 @@ void SettingsWindow::RenderColorSection() {
 
     if (changed) {
         settings.ApplyTheme();
-        settings.Save();
+        settings.MarkDirty(EditorSettings::File::Theme);
     }
 }
 
@@ -266,7 +269,7 @@ void SettingsWindow::RenderStyleSection() {
 
     if (changed) {
         settings.ApplyTheme();
-        settings.Save();
+        settings.MarkDirty(EditorSettings::File::Theme);
     }
 }
 
@@ -562,7 +565,7 @@ void SettingsWindow::RenderKeybindingsTab() {
     
     // Save and rebuild keymap if needed
     if (settingsChanged) {
-        settings.SaveKeybinds();
+        settings.MarkDirty(EditorSettings::File::Keybinds);
     }
     if (rebindNeeded) {
         inputSystem.SetupDefaultBindings();
@@ -594,8 +597,97 @@ void SettingsWindow::RenderBehaviorTab() {
                           "bottom/top 10%% of the viewport (VSCode default).");
     }
 
+    if (ImGui::Checkbox("Soft wrap", &behavior.softWrap)) {
+        changed = true;
+    }
+
+    if (ImGui::Checkbox("Minimap", &behavior.minimap)) {
+        changed = true;
+    }
+
+    ImGui::Spacing();
+    ImGui::TextUnformatted("History");
+    ImGui::Spacing();
+
+    ImGui::SetNextItemWidth(200.0f);
+    if (ImGui::SliderInt("Undo memory limit (MB)", &behavior.undoMemoryMB, 0, 1024)) {
+        behavior.undoMemoryMB = std::clamp(behavior.undoMemoryMB, 0, 4096);
+        changed = true;
+    }
+    ImGui::SameLine();
+    ImGui::TextDisabled("(?)");
+    if (ImGui::IsItemHovered()) {
+        ImGui::SetTooltip("Undo history kept per editor. Once exceeded, the\n"
+                          "oldest branches and then the oldest edits are\n"
+                          "dropped. 0 = unlimited.");
+    }
+
+    ImGui::SetNextItemWidth(200.0f);
+    if (ImGui::SliderInt("Buffer memory limit (MB)", &behavior.bufferMemoryMB, 0, 8192)) {
+        behavior.bufferMemoryMB = std::clamp(behavior.bufferMemoryMB, 0, 65536);
+        changed = true;
+    }
+    ImGui::SameLine();
+    ImGui::TextDisabled("(?)");
+    if (ImGui::IsItemHovered()) {
+        ImGui::SetTooltip("Memory of all open buffers. Once exceeded, buffers\n"
+                          "not on screen drop their syntax trees, then their\n"
+                          "caches, and unmodified ones their text, which is\n"
+                          "read back when shown again. 0 = unlimited.");
+    }
+
+    ImGui::SetNextItemWidth(200.0f);
+    if (ImGui::SliderInt("Drop idle syntax trees (min)", &behavior.syntaxIdleMinutes, 0, 120)) {
+        behavior.syntaxIdleMinutes = std::clamp(behavior.syntaxIdleMinutes, 0, 1440);
+        changed = true;
+    }
+    ImGui::SameLine();
+    ImGui::TextDisabled("(?)");
+    if (ImGui::IsItemHovered()) {
+        ImGui::SetTooltip("Buffers not on screen for this long drop their\n"
+                          "syntax trees, which are rebuilt in the background\n"
+                          "when shown again. 0 = never.");
+    }
+
+    ImGui::Spacing();
+    ImGui::TextUnformatted("Terminal");
+    ImGui::Spacing();
+
+    ImGui::SetNextItemWidth(200.0f);
+    if (ImGui::SliderInt("Scrollback lines", &behavior.terminalScrollback, 0, 100000)) {
+        behavior.terminalScrollback = std::clamp(behavior.terminalScrollback, 0, 1000000);
+        changed = true;
+    }
+    ImGui::SameLine();
+    ImGui::TextDisabled("(?)");
+    if (ImGui::IsItemHovered()) {
+        ImGui::SetTooltip("Lines above the screen kept in memory by each\n"
+                          "new terminal.");
+    }
+
+    ImGui::SetNextItemWidth(200.0f);
+    if (ImGui::SliderInt("Scrollback on disk (MB)", &behavior.terminalHistoryMB, 0, 4096)) {
+        behavior.terminalHistoryMB = std::clamp(behavior.terminalHistoryMB, 0, 65536);
+        changed = true;
+    }
+    ImGui::SameLine();
+    ImGui::TextDisabled("(?)");
+    if (ImGui::IsItemHovered()) {
+        ImGui::SetTooltip("Older scrollback of each new terminal, compressed\n"
+                          "into temporary files. Once exceeded, the oldest\n"
+                          "lines are dropped. 0 = none.");
+    }
+
+    ImGui::Spacing();
+    ImGui::TextUnformatted("Telescope");
+    ImGui::Spacing();
+
+    if (ImGui::Checkbox("Highlight previews", &behavior.previewHighlighting)) {
+        changed = true;
+    }
+
     if (changed) {
-        settings.SaveBehavior();
+        settings.MarkDirty(EditorSettings::File::Behavior);
     }
 }
 
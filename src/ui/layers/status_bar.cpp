@@ -1,6 +1,7 @@
 #include "status_bar.h"
 #include "ui/ui_system.h"
 #include "ui/editor_settings.h"
+#include "core/resource_system.h"
 #include "ui/input/command.h"
 #include "ui/input/keybinding.h"
 #include <imgui.h>
@@ -104,13 +105,13 @@ void StatusBar::OnUI() {
             int cur = settings.GetSearchCurrent();
             int total = settings.GetSearchTotal();
 
+            // Regex searches are marked "/.*"
+            const char* prompt = settings.IsSearchRegex() ? "/.*" : "/";
             char searchStr[320];
-            if (total > 0) {
-                snprintf(searchStr, sizeof(searchStr), "/ %s", query.c_str());
-            } else if (!query.empty()) {
-                snprintf(searchStr, sizeof(searchStr), "/ %s", query.c_str());
+            if (!query.empty()) {
+                snprintf(searchStr, sizeof(searchStr), "%s %s", prompt, query.c_str());
             } else {
-                snprintf(searchStr, sizeof(searchStr), "/");
+                snprintf(searchStr, sizeof(searchStr), "%s", prompt);
             }
 
             float textY = (windowHeight - ImGui::GetTextLineHeight()) * 0.5f;
@@ -124,9 +125,11 @@ void StatusBar::OnUI() {
                 drawList->AddText(ImVec2(barPos.x + afterBadgeX + qw, barPos.y + textY),
                                   IM_COL32(130, 180, 255, 255), countStr);
             } else if (!query.empty()) {
+                const std::string& error = settings.GetSearchError();
+                const std::string note = error.empty() ? "  no matches" : "  " + error;
                 float qw = ImGui::CalcTextSize(searchStr).x;
                 drawList->AddText(ImVec2(barPos.x + afterBadgeX + qw, barPos.y + textY),
-                                  IM_COL32(200, 80, 80, 220), "  no matches");
+                                  IM_COL32(200, 80, 80, 220), note.c_str());
             }
         } else if (inputSystem.HasPendingSequence()) {
             std::string pendingStr = inputSystem.GetPendingSequence().ToString();
@@ -147,6 +150,43 @@ void StatusBar::OnUI() {
             ImGui::ColorConvertFloat4ToU32(colors.textDisabled),
             posStr
         );
+        
+        // Indexing progress of a large file, left of the cursor position
+        float statusX = rightX - rightMargin * 2.0f;
+        float indexing = settings.GetIndexingProgress();
+        if (indexing >= 0.0f) {
+            char indexStr[32];
+            snprintf(indexStr, sizeof(indexStr), "Indexing %d%%", static_cast<int>(indexing * 100.0f));
+            statusX -= ImGui::CalcTextSize(indexStr).x;
+            drawList->AddText(
+                ImVec2(barPos.x + statusX, barPos.y + posTextY),
+                IM_COL32(130, 180, 255, 255),
+                indexStr
+            );
+            statusX -= rightMargin * 2.0f;
+        }
+        
+        if (settings.IsMacroRecording()) {
+            const char* recordingStr = "recording";
+            statusX -= ImGui::CalcTextSize(recordingStr).x;
+            drawList->AddText(
+                ImVec2(barPos.x + statusX, barPos.y + posTextY),
+                IM_COL32(255, 200, 100, 255),
+                recordingStr
+            );
+            statusX -= rightMargin * 2.0f;
+        }
+        
+        // Shown until every save in flight is on disk
+        if (ResourceSystem::GetInstance().IsSaving()) {
+            const char* savingStr = "Saving...";
+            statusX -= ImGui::CalcTextSize(savingStr).x;
+            drawList->AddText(
+                ImVec2(barPos.x + statusX, barPos.y + posTextY),
+                ImGui::ColorConvertFloat4ToU32(colors.textDisabled),
+                savingStr
+            );
+        }
     }
     ImGui::End();
     ImGui::PopStyleVar(3);
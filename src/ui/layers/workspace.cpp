@@ -1,4 +1,5 @@
 #include "workspace.h"
+#include "core/logger.h"
 #include "core/resource_system.h"
 #include "core/text/text_buffer.h"
 #include "ui/input/input_mode.h"
@@ -6,28 +7,40 @@
 #include <imgui_internal.h>
 #include <algorithm>
 #include <filesystem>
+#include <set>
+#include <tuple>
 
 namespace sol {
 
 Workspace::Workspace(const Id& id)
-    : UILayer(id) {
-    m_Telescope.SetOpenCallback([this](const std::filesystem::path& path) {
+    : UILayer(id), m_Telescope(m_FileIndex) {
+    m_Telescope.SetOpenCallback([this](const std::filesystem::path& path, size_t line, size_t column) {
         auto buffer = ResourceSystem::GetInstance().OpenFile(path);
         if (buffer) {
             auto* win = m_WindowTree.GetActiveWindow();
-            if (win) win->ShowBuffer(buffer->GetId());
+            if (win) {
+                win->ShowBuffer(buffer->GetId());
+                auto text = std::dynamic_pointer_cast<TextResource>(buffer->GetResource());
+                if (line != SIZE_MAX && text && win->GetEditor()) {
+                    win->GetEditor()->JumpTo(text->GetBuffer(), line, column);
+                }
+            }
             Focus();
         }
     });
 }
 
 void Workspace::OnUI() {
+    // Index the working directory as soon as it is known so the first Telescope opens warm
+    const std::filesystem::path& workingDirectory = ResourceSystem::GetInstance().GetWorkingDirectory();
+    if (workingDirectory != m_IndexedDirectory) {
+        m_IndexedDirectory = workingDirectory;
+        if (!workingDirectory.empty()) m_FileIndex.SetRoot(workingDirectory);
+    }
+
     ProcessPendingCloses();
     ProcessPendingDiagnostics();
 
-    // Process terminal PTY reads every frame regardless of visibility
-    m_TerminalPanel.ProcessAllInputs();
-
     m_DockspaceID = ImGui::GetID(UISystem::MainDockSpaceId);
 
     ImGuiWindowClass windowClass;
@@ -142,6 +155,95 @@ void Workspace::SyncActiveBuffer() {
     }
 }
 
+void Workspace::RestoreSession(const std::filesystem::path& root) {
+    SaveSession();
+    // Relative and absolute spellings of the folder share one session
+    std::error_code ec;
+    m_SessionRoot = std::filesystem::weakly_canonical(root, ec);
+    if (ec) m_SessionRoot = root;
+    auto session = Session::Load(m_SessionRoot);
+    if (!session) return;
+
+    auto& rs = ResourceSystem::GetInstance();
+    for (const auto& path : session->buffers) rs.OpenFileDeferred(path);
+
+    m_WindowTree.Reset();
+    std::vector<std::pair<Window*, const SessionLayout*>> views;
+    ApplyLayout(session->layout, m_WindowTree.GetActiveWindow(), views);
+
+    auto textOf = [&rs](Window* window) {
+        auto buffer = rs.GetBuffer(window->GetBufferId());
+        return buffer ? std::dynamic_pointer_cast<TextResource>(buffer->GetResource()) : nullptr;
+    };
+    // Every visible file streams in at once; each view places its cursor as
+    // its line arrives and folds once the buffer is parsed
+    for (const auto& [window, view] : views) {
+        auto text = textOf(window);
+        if (!text) continue;
+        text->Restore();
+        if (!window->GetEditor()) continue;
+        window->GetEditor()->JumpTo(text->GetBuffer(), view->line, view->column);
+        window->GetEditor()->SetFoldedLines(std::set<size_t>(view->foldedLines.begin(), view->foldedLines.end()));
+    }
+
+    const auto windows = m_WindowTree.GetAllWindows();
+    m_WindowTree.SetActiveWindow(windows[std::min(session->activeWindow, windows.size() - 1)]);
+    Logger::Info("Restored session for ", m_SessionRoot);
+}
+
+void Workspace::SaveSession() {
+    if (m_SessionRoot.empty()) return;
+
+    Session session;
+    for (const auto& buffer : ResourceSystem::GetInstance().GetBuffers()) {
+        if (!buffer->GetResource()->IsUntitled()) session.buffers.push_back(buffer->GetResource()->GetPath());
+    }
+    CaptureLayout(*m_WindowTree.GetRoot(), session.layout);
+    const auto windows = m_WindowTree.GetAllWindows();
+    session.activeWindow = std::find(windows.begin(), windows.end(), m_WindowTree.GetActiveWindow()) - windows.begin();
+    session.Save(m_SessionRoot);
+}
+
+void Workspace::CaptureLayout(const SplitNode& node, SessionLayout& layout) {
+    layout.isLeaf = node.isLeaf;
+    if (!node.isLeaf) {
+        layout.direction = node.direction;
+        layout.ratio = node.ratio;
+        layout.first = std::make_unique<SessionLayout>();
+        layout.second = std::make_unique<SessionLayout>();
+        CaptureLayout(*node.first, *layout.first);
+        CaptureLayout(*node.second, *layout.second);
+        return;
+    }
+
+    Window* window = node.window.get();
+    if (!window || window->GetContentType() != WindowContent::Buffer || !window->GetEditor()) return;
+    auto buffer = ResourceSystem::GetInstance().GetBuffer(window->GetBufferId());
+    auto text = buffer ? std::dynamic_pointer_cast<TextResource>(buffer->GetResource()) : nullptr;
+    if (!text || text->IsUntitled()) return;
+
+    layout.path = text->GetPath();
+    std::tie(layout.line, layout.column) = window->GetEditor()->GetCursorLineCol(text->GetBuffer());
+    const std::set<size_t>& folded = window->GetEditor()->GetFoldedLines();
+    layout.foldedLines.assign(folded.begin(), folded.end());
+}
+
+void Workspace::ApplyLayout(const SessionLayout& layout, Window* window,
+                            std::vector<std::pair<Window*, const SessionLayout*>>& views) {
+    if (!layout.isLeaf) {
+        m_WindowTree.SetActiveWindow(window);
+        Window* second = m_WindowTree.SplitActive(layout.direction, layout.ratio);
+        ApplyLayout(*layout.first, window, views);
+        ApplyLayout(*layout.second, second, views);
+        return;
+    }
+    if (layout.path.empty()) return;
+    if (auto buffer = ResourceSystem::GetInstance().OpenFileDeferred(layout.path)) {
+        window->ShowBuffer(buffer->GetId());
+        views.emplace_back(window, &layout);
+    }
+}
+
 void Workspace::UpdateDiagnostics(const std::string& path, const std::vector<LSPDiagnostic>& diagnostics) {
     std::lock_guard<std::mutex> lock(m_DiagnosticsMutex);
     m_PendingDiagnostics.emplace_back(path, diagnostics);
@@ -172,13 +274,9 @@ void Workspace::ProcessPendingDiagnostics() {
                 match = (bufPath.string() == targetPath.string());
             }
             if (match) {
-                // Push diagnostics to all windows showing this buffer
-                for (auto* win : m_WindowTree.GetAllWindows()) {
-                    if (win->GetContentType() == WindowContent::Buffer &&
-                        win->GetBufferId() == buffer->GetId()) {
-                        if (auto* ed = win->GetEditor())
-                            ed->UpdateDiagnostics(path, diagnostics);
-                    }
+                // Every window showing the buffer reads them from it
+                if (auto textResource = std::dynamic_pointer_cast<TextResource>(buffer->GetResource())) {
+                    textResource->GetBuffer().SetDiagnostics(diagnostics);
                 }
                 break;
             }
@@ -525,7 +623,7 @@ bool Workspace::Undo() {
     if (!textResource) return false;
 
     TextBuffer& textBuf = textResource->GetBuffer();
-    auto newPos = TextOps::Undo(textBuf, editor->GetUndoTree());
+    auto newPos = TextOps::Undo(textBuf, textBuf.GetUndoTree());
     if (newPos) {
         size_t pos = std::min(*newPos, textBuf.Length());
         editor->SetCursorPos(pos);
@@ -553,7 +651,7 @@ bool Workspace::Redo() {
     if (!textResource) return false;
 
     TextBuffer& textBuf = textResource->GetBuffer();
-    auto newPos = TextOps::Redo(textBuf, editor->GetUndoTree());
+    auto newPos = TextOps::Redo(textBuf, textBuf.GetUndoTree());
     if (newPos) {
         size_t pos = std::min(*newPos, textBuf.Length());
         editor->SetCursorPos(pos);
@@ -2,6 +2,7 @@
 
 #include "ui/ui_system.h"
 #include "ui/window_tree.h"
+#include "ui/session.h"
 #include "ui/widgets/explorer.h"
 #include "ui/widgets/terminal_panel.h"
 #include "ui/widgets/telescope.h"
@@ -55,6 +56,12 @@ public:
     void CloseTelescope();
     bool IsTelescopeOpen() const { return m_Telescope.IsOpen(); }
 
+    // Reopens the buffers and layout last saved for root and keeps its session
+    // current. Only buffers a window shows are loaded; the other tabs read
+    // their files when first activated.
+    void RestoreSession(const std::filesystem::path& root);
+    void SaveSession();
+
 private:
     void RenderTabBar();
     void RenderMainArea(const ImVec2& pos, const ImVec2& size);
@@ -63,6 +70,8 @@ private:
     void ProcessPendingCloses();
     void ProcessPendingDiagnostics();
     void SyncActiveBuffer();
+    void CaptureLayout(const SplitNode& node, SessionLayout& layout);
+    void ApplyLayout(const SessionLayout& layout, Window* window, std::vector<std::pair<Window*, const SessionLayout*>>& views);
 
     uint32_t m_DockspaceID = 0;
     WindowTree m_WindowTree;
@@ -95,8 +104,12 @@ private:
     bool m_IsFocused = false;
     bool m_WantsFocus = false;
 
-    // Telescope
+    // Telescope, over a file index kept for the whole session
+    FileIndex m_FileIndex;
+    std::filesystem::path m_IndexedDirectory;
     TelescopeWidget m_Telescope;
+
+    std::filesystem::path m_SessionRoot;
 };
 
 } // namespace sol
@@ -0,0 +1,115 @@
+#include "session.h"
+#include "core/logger.h"
+#include "core/platform/atomic_file.h"
+#include "core/utils/hash.h"
+#include "core/utils/json.h"
+#include "ui/editor_settings.h"
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+
+namespace sol {
+
+namespace {
+
+constexpr int SESSION_VERSION = 1;
+
+void SaveLayout(JsonWriter& writer, const SessionLayout& node) {
+    writer.BeginObject();
+    if (node.isLeaf) {
+        if (!node.path.empty()) {
+            writer.Key("path").String(node.path.string());
+            writer.Key("line").Int(static_cast<int64_t>(node.line));
+            writer.Key("column").Int(static_cast<int64_t>(node.column));
+            writer.Key("folds").BeginArray();
+            for (size_t line : node.foldedLines) writer.Int(static_cast<int64_t>(line));
+            writer.EndArray();
+        }
+    } else {
+        writer.Key("split").String(node.direction == SplitDir::Vertical ? "vertical" : "horizontal");
+        writer.Key("ratio").Number(node.ratio);
+        writer.Key("first");
+        SaveLayout(writer, *node.first);
+        writer.Key("second");
+        SaveLayout(writer, *node.second);
+    }
+    writer.EndObject();
+}
+
+size_t ToSize(const JsonNode& value) {
+    const double number = value.AsNumber();
+    return number > 0 ? static_cast<size_t>(number) : 0;
+}
+
+void LoadLayout(const JsonNode& value, SessionLayout& node) {
+    if (value.Has("split") && value.Has("first") && value.Has("second")) {
+        node.isLeaf = false;
+        node.direction = value["split"].AsString() == "vertical" ? SplitDir::Vertical : SplitDir::Horizontal;
+        if (value["ratio"].IsNumber()) {
+            node.ratio = std::clamp(static_cast<float>(value["ratio"].AsNumber()), 0.05f, 0.95f);
+        }
+        node.first = std::make_unique<SessionLayout>();
+        node.second = std::make_unique<SessionLayout>();
+        LoadLayout(value["first"], *node.first);
+        LoadLayout(value["second"], *node.second);
+        return;
+    }
+    node.path = value["path"].AsString();
+    node.line = ToSize(value["line"]);
+    node.column = ToSize(value["column"]);
+    for (const JsonNode& line : value["folds"].Items()) node.foldedLines.push_back(ToSize(line));
+}
+
+} // namespace
+
+std::filesystem::path Session::PathFor(const std::filesystem::path& root) {
+    char name[32];
+    std::snprintf(name, sizeof(name), "%016llx.json", static_cast<unsigned long long>(StreamHash::Of(root.string())));
+    return EditorSettings::GetConfigDir() / "sessions" / name;
+}
+
+std::optional<Session> Session::Load(const std::filesystem::path& root) {
+    std::ifstream file(PathFor(root), std::ios::binary);
+    if (!file) return std::nullopt;
+    const std::string text((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+
+    JsonDocument document;
+    if (!document.Parse(text) || document.Root()["version"].AsInt() != SESSION_VERSION) {
+        Logger::Warning("Ignoring unreadable session for ", root);
+        return std::nullopt;
+    }
+
+    const JsonNode& json = document.Root();
+    Session session;
+    for (const JsonNode& path : json["buffers"].Items()) session.buffers.emplace_back(path.AsString());
+    LoadLayout(json["layout"], session.layout);
+    session.activeWindow = ToSize(json["activeWindow"]);
+    return session;
+}
+
+bool Session::Save(const std::filesystem::path& root) const {
+    const std::filesystem::path path = PathFor(root);
+    std::error_code ec;
+    std::filesystem::create_directories(path.parent_path(), ec);
+
+    JsonWriter writer;
+    writer.BeginObject();
+    writer.Key("version").Int(SESSION_VERSION);
+    writer.Key("buffers").BeginArray();
+    for (const auto& buffer : buffers) writer.String(buffer.string());
+    writer.EndArray();
+    writer.Key("layout");
+    SaveLayout(writer, layout);
+    writer.Key("activeWindow").Int(static_cast<int64_t>(activeWindow));
+    writer.EndObject();
+
+    auto file = AtomicFile::Create(path);
+    if (!file || !file->Write(writer.Str()) || !file->Commit()) {
+        Logger::Error("Failed to save session: ", path);
+        return false;
+    }
+    return true;
+}
+
+} // namespace sol
@@ -0,0 +1,42 @@
+#pragma once
+
+#include "ui/window_tree.h"
+#include <cstddef>
+#include <filesystem>
+#include <memory>
+#include <optional>
+#include <vector>
+
+namespace sol {
+
+// One node of a saved window layout, mirroring SplitNode
+struct SessionLayout {
+    bool isLeaf = true;
+
+    // Leaf; an empty path is a window that showed no buffer
+    std::filesystem::path path;
+    size_t line = 0;
+    size_t column = 0;
+    std::vector<size_t> foldedLines;
+
+    // Non-leaf
+    SplitDir direction = SplitDir::Horizontal;
+    float ratio = 0.5f;
+    std::unique_ptr<SessionLayout> first;
+    std::unique_ptr<SessionLayout> second;
+};
+
+// The open buffers and window layout of a working directory, kept in
+// ~/.sol/sessions so the folder reopens the way it was left
+struct Session {
+    std::vector<std::filesystem::path> buffers;  // Tab order
+    SessionLayout layout;
+    size_t activeWindow = 0;  // Index into WindowTree::GetAllWindows
+
+    static std::optional<Session> Load(const std::filesystem::path& root);
+    bool Save(const std::filesystem::path& root) const;
+
+    static std::filesystem::path PathFor(const std::filesystem::path& root);
+};
+
+} // namespace sol
@@ -16,7 +16,16 @@ void UISystem::RegisterLayer(std::shared_ptr<UILayer> layer) {
     m_LayersMap[layer->GetId()] = layer;
 }
 
+void UISystem::RegisterLazyLayer(const UILayer::Id& id, LayerFactory factory) {
+    if (!factory) {
+        return;
+    }
+
+    m_LazyLayers[id] = std::move(factory);
+}
+
 void UISystem::UnregisterLayer(const UILayer::Id& id) {
+    m_LazyLayers.erase(id);
     auto it = m_LayersMap.find(id);
     if (it != m_LayersMap.end()) {
         m_LayersMap.erase(it);
@@ -46,4 +55,33 @@ std::shared_ptr<UILayer> UISystem::GetLayer(const UILayer::Id& id) {
     return nullptr;
 }
 
+bool UISystem::HasLayer(const UILayer::Id& id) const {
+    return m_LayersMap.count(id) > 0 || m_LazyLayers.count(id) > 0;
+}
+
+bool UISystem::IsLayerEnabled(const UILayer::Id& id) const {
+    auto it = m_LayersMap.find(id);
+    return it != m_LayersMap.end() && it->second->IsEnabled();
+}
+
+bool UISystem::ToggleLayer(const UILayer::Id& id) {
+    if (auto layer = GetLayer(id)) {
+        layer->SetEnabled(!layer->IsEnabled());
+        return true;
+    }
+
+    auto lazy = m_LazyLayers.find(id);
+    if (lazy == m_LazyLayers.end()) {
+        return false;
+    }
+    std::shared_ptr<UILayer> layer = lazy->second();
+    m_LazyLayers.erase(lazy);
+    if (!layer) {
+        return false;
+    }
+    layer->SetEnabled(true);
+    RegisterLayer(std::move(layer));
+    return true;
+}
+
 } // namespace sol
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <functional>
 #include <string>
 #include <memory>
 #include <map>
@@ -25,6 +26,11 @@ private:
     bool m_Enabled = true;
 };
 
+// Shows or hides a layer; published on the EventBus on the main thread
+struct ToggleWindowEvent {
+    UILayer::Id windowId;
+};
+
 class UISystem {
 public:
     // Layout constants
@@ -42,15 +48,27 @@ public:
     UISystem(UISystem&&) = delete;
     UISystem& operator=(UISystem&&) = delete;
 
+    using LayerFactory = std::function<std::shared_ptr<UILayer>()>;
+
     void RegisterLayer(std::shared_ptr<UILayer> layer);
+    // A layer that starts hidden and is built the first time it is shown,
+    // so startup pays nothing for it
+    void RegisterLazyLayer(const UILayer::Id& id, LayerFactory factory);
     void UnregisterLayer(const UILayer::Id& id);
     void RenderLayers();
 
+    // Null for a lazy layer not yet shown
     std::shared_ptr<UILayer> GetLayer(const UILayer::Id& id);
+    bool HasLayer(const UILayer::Id& id) const;
+    bool IsLayerEnabled(const UILayer::Id& id) const;
+    // Shows or hides the layer, building a lazy one first; false when no
+    // layer has the id
+    bool ToggleLayer(const UILayer::Id& id);
 
 private:
     std::vector<std::shared_ptr<UILayer>> m_Layers;
     std::map<UILayer::Id, std::shared_ptr<UILayer>> m_LayersMap;
+    std::map<UILayer::Id, LayerFactory> m_LazyLayers;  // Not yet built
 };
 
 } // namespace sol
@@ -1,6 +1,7 @@
 #include "explorer.h"
 #include "core/resource_system.h"
 #include "core/event_system.h"
+#include "core/job_system.h"
 #include "ui/icons_nerd.h"
 #include "ui/input/command.h"
 #include <imgui.h>
@@ -51,6 +52,14 @@ std::string GetIconForFile(const std::filesystem::path& path) {
 
 } // anonymous namespace
 
+ExplorerWidget::ExplorerWidget() : m_Loads(std::make_shared<Loads>()) {
+    m_Subscription = FileWatcher::GetInstance().Subscribe([this](const FileChanges& changes) { OnFilesChanged(changes); });
+}
+
+ExplorerWidget::~ExplorerWidget() {
+    FileWatcher::GetInstance().Unsubscribe(m_Subscription);
+}
+
 void ExplorerWidget::Render(const char* label, const ImVec2& size) {
     m_IsFocused = ImGui::IsWindowFocused(ImGuiFocusedFlags_ChildWindows);
 
@@ -68,21 +77,19 @@ void ExplorerWidget::Render(const char* label, const ImVec2& size) {
     ImGui::Separator();
 
     if (m_NeedsRefresh) {
-        m_Root.children.clear();
+        // Canonical like the paths the FileWatcher reports
+        std::error_code ec;
+        auto canonical = std::filesystem::weakly_canonical(rs.GetWorkingDirectory(), ec);
+        m_Root = FileNode();
         m_Root.name = rs.GetWorkingDirectory().filename().string();
-        m_Root.path = rs.GetWorkingDirectory();
+        m_Root.path = ec ? rs.GetWorkingDirectory() : canonical;
         m_Root.isDirectory = true;
         m_Root.isExpanded = true;
-        BuildTree(m_Root, rs.GetWorkingDirectory());
+        m_FlatList.clear();
+        RequestChildren(m_Root);
         m_NeedsRefresh = false;
-        m_FlatListDirty = true;
-    }
-
-    // Build flat visible list for rendering and navigation
-    if (m_FlatListDirty) {
-        BuildFlatList();
-        m_FlatListDirty = false;
     }
+    CollectListings();
 
     // Handle keyboard nav when focused
     if (m_IsWindowActive) {
@@ -95,6 +102,10 @@ void ExplorerWidget::Render(const char* label, const ImVec2& size) {
 
     ImGui::BeginChild("##explorer_tree", avail, false, ImGuiWindowFlags_None);
 
+    if (m_Root.isLoading) {
+        ImGui::TextDisabled("Loading...");
+    }
+
     // Clamp selected index
     if (!m_FlatList.empty()) {
         m_SelectedIndex = std::clamp(m_SelectedIndex, 0, (int)m_FlatList.size() - 1);
@@ -114,53 +125,64 @@ void ExplorerWidget::Render(const char* label, const ImVec2& size) {
 
     ImDrawList* drawList = ImGui::GetWindowDrawList();
     ImVec2 windowPos = ImGui::GetCursorScreenPos();
+    int clicked = -1;
+
+    ImGuiListClipper clipper;
+    clipper.Begin((int)m_FlatList.size(), lineHeight);
+    while (clipper.Step()) {
+        for (int i = clipper.DisplayStart; i < clipper.DisplayEnd; ++i) {
+            const FlatEntry& entry = m_FlatList[i];
+            const FileNode* node = entry.node;
+            float indent = entry.depth * 10.0f;
+
+            ImVec2 rowMin(windowPos.x, windowPos.y + i * lineHeight);
+            ImVec2 rowMax(windowPos.x + avail.x, rowMin.y + lineHeight);
+
+            // Selected highlight
+            bool isSelected = (i == m_SelectedIndex) && m_IsWindowActive;
+            if (isSelected) {
+                drawList->AddRectFilled(rowMin, rowMax, IM_COL32(38, 79, 120, 200));
+            }
 
-    for (int i = 0; i < (int)m_FlatList.size(); ++i) {
-        auto& entry = m_FlatList[i];
-        FileNode* node = entry.node;
-        float indent = entry.depth * 10.0f;
-
-        ImVec2 rowMin(windowPos.x, windowPos.y + i * lineHeight);
-        ImVec2 rowMax(windowPos.x + avail.x, rowMin.y + lineHeight);
-
-        // Selected highlight
-        bool isSelected = (i == m_SelectedIndex) && m_IsWindowActive;
-        if (isSelected) {
-            drawList->AddRectFilled(rowMin, rowMax, IM_COL32(38, 79, 120, 200));
-        }
+            // Hover highlight
+            ImGui::SetCursorScreenPos(rowMin);
+            char btnId[64];
+            snprintf(btnId, sizeof(btnId), "##row_%d", i);
+            if (ImGui::InvisibleButton(btnId, ImVec2(avail.x, lineHeight))) {
+                clicked = i;
+            }
+            if (ImGui::IsItemHovered() && !isSelected) {
+                drawList->AddRectFilled(rowMin, rowMax, IM_COL32(255, 255, 255, 20));
+            }
 
-        // Hover highlight
-        ImGui::SetCursorScreenPos(rowMin);
-        char btnId[64];
-        snprintf(btnId, sizeof(btnId), "##row_%d", i);
-        if (ImGui::InvisibleButton(btnId, ImVec2(avail.x, lineHeight))) {
-            m_SelectedIndex = i;
+            // Icon and label
+            std::string text;
             if (node->isDirectory) {
-                node->isExpanded = !node->isExpanded;
-                m_FlatListDirty = true;
+                text = node->isExpanded ? ICON_NF_FOLDER_OPEN : ICON_NF_FOLDER;
             } else {
-                ResourceSystem::GetInstance().OpenFile(node->path);
+                text = GetIconForFile(node->path);
+            }
+            text += ' ';
+            text += node->name;
+
+            ImVec2 textPos(rowMin.x + indent + 2.0f, rowMin.y);
+            drawList->AddText(textPos, IM_COL32(200, 200, 200, 255), text.c_str());
+            if (node->isLoading) {
+                textPos.x += ImGui::CalcTextSize(text.c_str()).x;
+                drawList->AddText(textPos, IM_COL32(120, 120, 120, 255), " ...");
             }
         }
-        if (ImGui::IsItemHovered() && !isSelected) {
-            drawList->AddRectFilled(rowMin, rowMax, IM_COL32(255, 255, 255, 20));
-        }
+    }
+    clipper.End();
 
-        // Icon and label
-        std::string icon;
-        if (node->isDirectory) {
-            icon = node->isExpanded ? ICON_NF_FOLDER_OPEN : ICON_NF_FOLDER;
+    // Rows change only after the loop so the clipper's range stays valid
+    if (clicked >= 0) {
+        m_SelectedIndex = clicked;
+        if (m_FlatList[clicked].node->isDirectory) {
+            Toggle(clicked);
         } else {
-            icon = GetIconForFile(node->path);
+            ResourceSystem::GetInstance().OpenFile(m_FlatList[clicked].node->path);
         }
-
-        ImVec2 textPos(rowMin.x + indent + 2.0f, rowMin.y);
-        drawList->AddText(textPos, IM_COL32(200, 200, 200, 255), (icon + " " + node->name).c_str());
-    }
-
-    // Dummy to set content size for scrolling
-    if (!m_FlatList.empty()) {
-        ImGui::Dummy(ImVec2(avail.x, m_FlatList.size() * lineHeight));
     }
 
     ImGui::EndChild();
@@ -186,11 +208,10 @@ void ExplorerWidget::HandleInput() {
         case ImGuiKey_RightArrow: {
             auto* node = m_FlatList[m_SelectedIndex].node;
             if (node->isDirectory && !node->isExpanded) {
-                node->isExpanded = true;
-                m_FlatListDirty = true;
+                Expand(m_SelectedIndex);
             } else if (node->isDirectory && node->isExpanded) {
                 // Move into the directory (select first child)
-                if (m_SelectedIndex + 1 <= maxIdx)
+                if (m_SelectedIndex + 1 <= maxIdx && m_FlatList[m_SelectedIndex + 1].depth > m_FlatList[m_SelectedIndex].depth)
                     m_SelectedIndex++;
                 m_ScrollToSelected = true;
             }
@@ -199,8 +220,7 @@ void ExplorerWidget::HandleInput() {
         case ImGuiKey_LeftArrow: {
             auto* node = m_FlatList[m_SelectedIndex].node;
             if (node->isDirectory && node->isExpanded) {
-                node->isExpanded = false;
-                m_FlatListDirty = true;
+                Collapse(m_SelectedIndex);
             } else {
                 // Go to parent (find node at depth-1 above)
                 int targetDepth = m_FlatList[m_SelectedIndex].depth - 1;
@@ -222,67 +242,188 @@ void ExplorerWidget::HandleInput() {
     if (ImGui::IsKeyPressed(ImGuiKey_Enter, false)) {
         auto* node = m_FlatList[m_SelectedIndex].node;
         if (node->isDirectory) {
-            node->isExpanded = !node->isExpanded;
-            m_FlatListDirty = true;
+            Toggle(m_SelectedIndex);
         } else {
             ResourceSystem::GetInstance().OpenFile(node->path);
         }
     }
 }
 
-void ExplorerWidget::BuildFlatList() {
-    m_FlatList.clear();
-    for (auto& child : m_Root.children) {
-        BuildFlatListRecursive(child, 0);
+void ExplorerWidget::Toggle(int index) {
+    if (m_FlatList[index].node->isExpanded) {
+        Collapse(index);
+    } else {
+        Expand(index);
+    }
+}
+
+void ExplorerWidget::Expand(int index) {
+    FileNode& node = *m_FlatList[index].node;
+    node.isExpanded = true;
+    if (!node.isLoaded) {
+        RequestChildren(node);
+        return;
+    }
+
+    std::vector<FlatEntry> rows;
+    for (auto& child : node.children) {
+        AppendVisible(child, m_FlatList[index].depth + 1, rows);
     }
+    m_FlatList.insert(m_FlatList.begin() + index + 1, rows.begin(), rows.end());
+    if (m_SelectedIndex > index) m_SelectedIndex += (int)rows.size();
 }
 
-void ExplorerWidget::BuildFlatListRecursive(FileNode& node, int depth) {
-    m_FlatList.push_back({&node, depth});
+void ExplorerWidget::Collapse(int index) {
+    m_FlatList[index].node->isExpanded = false;
+    const int depth = m_FlatList[index].depth;
+    int end = index + 1;
+    while (end < (int)m_FlatList.size() && m_FlatList[end].depth > depth) ++end;
+    m_FlatList.erase(m_FlatList.begin() + index + 1, m_FlatList.begin() + end);
+    if (m_SelectedIndex >= end) {
+        m_SelectedIndex -= end - index - 1;
+    } else if (m_SelectedIndex > index) {
+        m_SelectedIndex = index;
+    }
+}
+
+void ExplorerWidget::AppendVisible(FileNode& node, int depth, std::vector<FlatEntry>& out) {
+    out.push_back({&node, depth});
     if (node.isDirectory && node.isExpanded) {
         for (auto& child : node.children) {
-            BuildFlatListRecursive(child, depth + 1);
+            AppendVisible(child, depth + 1, out);
         }
     }
 }
 
-void ExplorerWidget::BuildTree(FileNode& parent, const std::filesystem::path& path) {
-    try {
-        std::vector<FileNode> dirs;
-        std::vector<FileNode> files;
+void ExplorerWidget::RequestChildren(FileNode& node) {
+    // Only a first listing shows as loading; a reload keeps the old children until it lands
+    node.isLoading = !node.isLoaded;
+    node.listing = m_NextListing++;
+    JobSystem::Submit(JobPriority::Interactive, [loads = m_Loads, path = node.path, serial = node.listing] {
+        Listing listing{path, ReadChildren(path), serial};
+        std::lock_guard<std::mutex> lock(loads->mutex);
+        loads->finished.push_back(std::move(listing));
+    });
+}
 
-        for (const auto& entry : std::filesystem::directory_iterator(path)) {
-            auto filename = entry.path().filename().string();
+void ExplorerWidget::CollectListings() {
+    std::vector<Listing> finished;
+    {
+        std::lock_guard<std::mutex> lock(m_Loads->mutex);
+        finished.swap(m_Loads->finished);
+    }
+    if (finished.empty()) return;
 
-            FileNode node;
-            node.name = filename;
-            node.path = entry.path();
-            node.isDirectory = entry.is_directory();
+    const bool hasSelection = m_SelectedIndex >= 0 && m_SelectedIndex < (int)m_FlatList.size();
+    const std::filesystem::path selected = hasSelection ? m_FlatList[m_SelectedIndex].node->path : std::filesystem::path();
+    for (Listing& listing : finished) {
+        FileNode* node = FindNode(listing.path);
+        if (node && node->listing == listing.serial) ReplaceChildren(*node, std::move(listing.children));
+    }
 
-            if (node.isDirectory) {
-                BuildTree(node, entry.path());
-                dirs.push_back(std::move(node));
-            } else {
-                files.push_back(std::move(node));
-            }
+    // Keep the selection on the same entry as rows move around it
+    if (selected.empty()) return;
+    if (m_SelectedIndex < (int)m_FlatList.size() && m_FlatList[m_SelectedIndex].node->path == selected) return;
+    auto row = std::find_if(m_FlatList.begin(), m_FlatList.end(), [&](const FlatEntry& entry) { return entry.node->path == selected; });
+    if (row != m_FlatList.end()) m_SelectedIndex = (int)(row - m_FlatList.begin());
+}
+
+void ExplorerWidget::ReplaceChildren(FileNode& node, std::vector<FileNode> children) {
+    // Directories still present keep their expansion and what was read below them
+    for (FileNode& child : children) {
+        if (!child.isDirectory) continue;
+        auto old = std::lower_bound(node.children.begin(), node.children.end(), child, IsListedBefore);
+        if (old != node.children.end() && old->isDirectory && old->name == child.name) child = std::move(*old);
+    }
+    node.isLoading = false;
+
+    if (&node == &m_Root) {
+        m_Root.children = std::move(children);
+        m_Root.isLoaded = true;
+        m_FlatList.clear();
+        for (auto& child : m_Root.children) {
+            AppendVisible(child, 0, m_FlatList);
         }
+        return;
+    }
 
-        std::sort(dirs.begin(), dirs.end(),
-            [](const FileNode& a, const FileNode& b) { return a.name < b.name; });
-        std::sort(files.begin(), files.end(),
-            [](const FileNode& a, const FileNode& b) { return a.name < b.name; });
+    // Rows below a visible node point into the old children, so they are rebuilt
+    auto row = m_FlatList.end();
+    if (node.isExpanded) {
+        row = std::find_if(m_FlatList.begin(), m_FlatList.end(), [&node](const FlatEntry& entry) { return entry.node == &node; });
+    }
+    if (row == m_FlatList.end()) {
+        node.children = std::move(children);
+        node.isLoaded = true;
+        return;
+    }
+    const int index = (int)(row - m_FlatList.begin());
+    Collapse(index);
+    node.children = std::move(children);
+    node.isLoaded = true;
+    Expand(index);
+}
 
-        parent.children.reserve(dirs.size() + files.size());
-        for (auto& dir : dirs) {
-            parent.children.push_back(std::move(dir));
+void ExplorerWidget::OnFilesChanged(const FileChanges& changes) {
+    std::vector<FileNode*> directories;
+    if (changes.rescan) {
+        // Re-read every directory already read, deepest state kept by ReplaceChildren
+        std::vector<FileNode*> stack = {&m_Root};
+        while (!stack.empty()) {
+            FileNode* node = stack.back();
+            stack.pop_back();
+            if (!node->isLoaded) continue;
+            directories.push_back(node);
+            for (auto& child : node->children) {
+                if (child.isDirectory) stack.push_back(&child);
+            }
         }
-        for (auto& file : files) {
-            parent.children.push_back(std::move(file));
+    } else {
+        for (const auto& path : changes.paths) {
+            FileNode* parent = FindNode(path.parent_path());
+            if (parent && parent->isLoaded) directories.push_back(parent);
         }
+        std::sort(directories.begin(), directories.end());
+        directories.erase(std::unique(directories.begin(), directories.end()), directories.end());
+    }
+    for (FileNode* directory : directories) {
+        RequestChildren(*directory);
+    }
+}
 
-    } catch (const std::exception&) {
-        // Silently ignore filesystem errors
+ExplorerWidget::FileNode* ExplorerWidget::FindNode(const std::filesystem::path& path) {
+    FileNode* node = &m_Root;
+    for (const auto& part : path.lexically_relative(m_Root.path)) {
+        if (part == ".") continue;
+        const std::string name = part.string();
+        auto child = std::find_if(node->children.begin(), node->children.end(),
+                                  [&](const FileNode& c) { return c.isDirectory && c.name == name; });
+        if (child == node->children.end()) return nullptr;
+        node = &*child;
     }
+    return node;
+}
+
+bool ExplorerWidget::IsListedBefore(const FileNode& a, const FileNode& b) {
+    if (a.isDirectory != b.isDirectory) return a.isDirectory;
+    return a.name < b.name;
+}
+
+std::vector<ExplorerWidget::FileNode> ExplorerWidget::ReadChildren(const std::filesystem::path& path) {
+    std::vector<FileNode> children;
+    std::error_code ec;
+    std::filesystem::directory_iterator it(path, std::filesystem::directory_options::skip_permission_denied, ec);
+    for (const std::filesystem::directory_iterator end; !ec && it != end; it.increment(ec)) {
+        FileNode node;
+        node.name = it->path().filename().string();
+        node.path = it->path();
+        std::error_code typeError;
+        node.isDirectory = it->is_directory(typeError);
+        children.push_back(std::move(node));
+    }
+
+    std::sort(children.begin(), children.end(), IsListedBefore);
+    return children;
 }
 
 } // namespace sol
@@ -1,16 +1,27 @@
 #pragma once
 
+#include "core/file_watcher.h"
 #include <imgui.h>
+#include <cstdint>
 #include <filesystem>
+#include <memory>
+#include <mutex>
 #include <vector>
 #include <string>
 
 namespace sol {
 
-// File tree widget rendered as a left sidebar panel (like NvimTree)
+// File tree widget rendered as a left sidebar panel (like NvimTree).
+// Directories are read on the JobSystem the first time they are expanded,
+// and read again when the FileWatcher reports changes in them; only the rows
+// in view are drawn.
 class ExplorerWidget {
 public:
-    ExplorerWidget() = default;
+    ExplorerWidget();
+    ~ExplorerWidget();
+
+    ExplorerWidget(const ExplorerWidget&) = delete;
+    ExplorerWidget& operator=(const ExplorerWidget&) = delete;
 
     // Render the explorer tree into the current ImGui context
     void Render(const char* label, const ImVec2& size);
@@ -26,27 +37,55 @@ private:
     struct FileNode {
         std::string name;
         std::filesystem::path path;
-        bool isDirectory;
+        bool isDirectory = false;
         bool isExpanded = false;
+        bool isLoaded = false;
+        bool isLoading = false;
+        uint32_t listing = 0;  // Newest listing requested; older ones are stale
         std::vector<FileNode> children;
     };
 
-    void BuildFlatList();
-    void BuildFlatListRecursive(FileNode& node, int depth);
-    void HandleInput();
-    void BuildTree(FileNode& node, const std::filesystem::path& path);
-
     // Flat visible entry for keyboard navigation
     struct FlatEntry {
         FileNode* node;
         int depth;
     };
 
+    // Children read on a worker
+    struct Listing {
+        std::filesystem::path path;
+        std::vector<FileNode> children;
+        uint32_t serial;
+    };
+
+    struct Loads {
+        std::mutex mutex;
+        std::vector<Listing> finished;
+    };
+
+    // Directories first, each group by name
+    static bool IsListedBefore(const FileNode& a, const FileNode& b);
+    static std::vector<FileNode> ReadChildren(const std::filesystem::path& path);
+
+    void RequestChildren(FileNode& node);
+    void CollectListings();
+    void ReplaceChildren(FileNode& node, std::vector<FileNode> children);
+    void OnFilesChanged(const FileChanges& changes);
+    FileNode* FindNode(const std::filesystem::path& path);
+    void AppendVisible(FileNode& node, int depth, std::vector<FlatEntry>& out);
+    // Flat list rows are inserted or erased below the toggled row only
+    void Toggle(int index);
+    void Expand(int index);
+    void Collapse(int index);
+    void HandleInput();
+
     FileNode m_Root;
     std::vector<FlatEntry> m_FlatList;
+    uint32_t m_NextListing = 1;
+    std::shared_ptr<Loads> m_Loads;
+    FileWatcher::SubscriptionId m_Subscription = 0;
     int m_SelectedIndex = 0;
     bool m_NeedsRefresh = true;
-    bool m_FlatListDirty = true;
     bool m_IsFocused = false;
     bool m_IsWindowActive = false;
     bool m_WantsFocus = false;
@@ -2,11 +2,16 @@
 #include "ui/editor_settings.h"
 #include "ui/icons_nerd.h"
 #include "ui/input/command.h"
+#include "core/frame_scheduler.h"
+#include "core/job_system.h"
 #include "core/lsp/lsp_manager.h"
+#include "core/profiler.h"
+#include "core/symbol_index.h"
 #include <imgui_internal.h>
 #include <algorithm>
 #include <cmath>
 #include <cctype>
+#include <unordered_set>
 
 namespace sol {
 
@@ -33,12 +38,69 @@ SyntaxEditor::SyntaxEditor() {
     };
 }
 
-void SyntaxEditor::UpdateDiagnostics(const std::string& path, const std::vector<LSPDiagnostic>& diagnostics) {
-    m_Diagnostics.clear();
-    for (const auto& diag : diagnostics) {
-        // Group by line for easier rendering
-        m_Diagnostics[diag.range.start.line].push_back(diag);
+namespace {
+
+constexpr size_t MAX_WORKSPACE_COMPLETIONS = 50;
+
+// Narrower editors let lines run past the edge rather than wrap every few
+// characters
+constexpr size_t MIN_WRAP_COLUMNS = 20;
+
+// Row of a column among a line's row breaks
+size_t RowOf(const std::vector<size_t>& breaks, size_t col) {
+    return static_cast<size_t>(std::upper_bound(breaks.begin(), breaks.end(), col) - breaks.begin());
+}
+
+// LSP CompletionItemKind of a definition
+int CompletionKindOf(SymbolKind kind) {
+    switch (kind) {
+        case SymbolKind::Function:  return 3;
+        case SymbolKind::Method:    return 2;
+        case SymbolKind::Class:     return 7;
+        case SymbolKind::Interface: return 8;
+        case SymbolKind::Module:    return 9;
+        case SymbolKind::Type:      return 22;
+        case SymbolKind::Constant:
+        case SymbolKind::Macro:     return 21;
+        case SymbolKind::Variable:  return 6;
+        case SymbolKind::Other:     break;
     }
+    return 1;
+}
+
+} // namespace
+
+std::vector<LSPCompletionItem> SyntaxEditor::BuiltinCompletions(TextBuffer& buffer, const std::string& prefix, bool withKeywords) const {
+    std::vector<LSPCompletionItem> items;
+    std::unordered_set<std::string> seen;
+    auto add = [&](std::string label, int kind, const char* detail) {
+        if (!seen.insert(label).second) return;
+        LSPCompletionItem item;
+        item.label = label;
+        item.kind = kind;
+        item.insertText = std::move(label);
+        item.detail = detail;
+        items.push_back(std::move(item));
+    };
+
+    for (std::string& word : buffer.GetWordCompletions(prefix, m_CursorPos)) add(std::move(word), 1, "Buffer");
+
+    const auto* langPtr = buffer.GetLanguage();
+    if (withKeywords && langPtr) {
+        for (const auto& mapping : langPtr->highlightMappings) {
+            if (mapping.second == HighlightGroup::Keyword || mapping.second == HighlightGroup::Type) {
+                if (mapping.first.length() > prefix.length() && 
+                    mapping.first.substr(0, prefix.length()) == prefix) {
+                    add(mapping.first, 1, "Buffer");
+                }
+            }
+        }
+    }
+
+    for (WorkspaceSymbol& symbol : SymbolIndex::GetInstance().Complete(prefix, MAX_WORKSPACE_COMPLETIONS)) {
+        if (symbol.name != prefix) add(std::move(symbol.name), CompletionKindOf(symbol.kind), "Workspace");
+    }
+    return items;
 }
 
 float SyntaxEditor::GetCharWidth() const {
@@ -62,6 +124,17 @@ float SyntaxEditor::GetFoldGutterWidth() const {
 bool SyntaxEditor::Render(const char* label, TextBuffer& buffer, const ImVec2& size) {
     ImGuiWindow* window = ImGui::GetCurrentWindow();
     if (window->SkipItems) return false;
+    SOL_PROFILE_ZONE("SyntaxEditor::Render");
+    
+    buffer.PollIndexing();
+    buffer.PollParsing();
+    if (m_PendingJump) ApplyPendingJump(buffer);
+    // Another view's edits may have shortened the text under the extra cursors
+    for (Caret& caret : m_ExtraCarets) {
+        caret.anchor = std::min(caret.anchor, buffer.Length());
+        caret.pos = std::min(caret.pos, buffer.Length());
+    }
+    buffer.GetUndoTree().SetMemoryBudget(static_cast<size_t>(EditorSettings::Get().GetBehavior().undoMemoryMB) * 1024 * 1024);
 
     // Sync theme from EditorSettings
     {
@@ -90,21 +163,6 @@ bool SyntaxEditor::Render(const char* label, TextBuffer& buffer, const ImVec2& s
         m_Theme.popupSelected = ImGui::ColorConvertFloat4ToU32(e.popupSelected);
     }
     
-    // Process any pending completion items from LSP (thread-safe)
-    {
-        std::lock_guard<std::mutex> lock(m_PendingCompletionMutex);
-        if (m_PendingCompletionItems.has_value()) {
-            if (!m_PendingCompletionItems->empty()) {
-                m_CompletionItems = std::move(*m_PendingCompletionItems);
-                m_ShowCompletion = true;
-                m_SelectedCompletionIndex = 0;
-            } else if (m_CompletionItems.empty()) {
-                m_ShowCompletion = false;
-            }
-            m_PendingCompletionItems.reset();
-        }
-    }
-    
     ImGuiContext& g = *GImGui;
     const ImGuiStyle& style = g.Style;
     const ImGuiID id = window->GetID(label);
@@ -121,6 +179,7 @@ bool SyntaxEditor::Render(const char* label, TextBuffer& buffer, const ImVec2& s
     const float lineNumberWidth = GetLineNumberWidth(lineCount);
     const float foldGutterWidth = GetFoldGutterWidth();
     const float totalGutterWidth = lineNumberWidth + foldGutterWidth;
+    const float minimapWidth = EditorSettings::Get().GetBehavior().minimap ? MINIMAP_WIDTH : 0.0f;
     const float textAreaWidth = contentSize.x - totalGutterWidth;
     
     // Begin child region for scrolling
@@ -157,18 +216,23 @@ bool SyntaxEditor::Render(const char* label, TextBuffer& buffer, const ImVec2& s
         }
     }
     
-    // Ensure buffer is parsed first (needed for fold ranges)
-    if (!buffer.IsParsed() && buffer.HasLanguage()) {
-        buffer.Parse();
-        m_FoldRangesDirty = true;
-    }
-    
     // Update fold ranges from tree-sitter (must be before any fold-related calculations)
     UpdateFoldRanges(buffer);
     
-    // Calculate total visible lines (total - hidden from folds)
+    // Soft wrap measures lines at the width between the gutter and the
+    // minimap, which the vertical scrollbar narrows
+    m_Wrapping = EditorSettings::Get().GetBehavior().softWrap;
+    if (m_Wrapping) {
+        const float wrapWidth = std::max(0.0f, ImGui::GetContentRegionAvail().x - totalGutterWidth - minimapWidth);
+        m_WrapColumns = std::max(MIN_WRAP_COLUMNS, static_cast<size_t>(wrapWidth / m_CharWidth));
+        m_WrapTabSize = static_cast<size_t>(std::max(m_TabSize, 1));
+        m_Wrap.Update(buffer, m_WrapColumns, m_WrapTabSize, m_FoldMap);
+    }
+    
+    // Calculate total visible rows (total - hidden from folds, plus wrapped rows)
     const size_t hiddenLineCount = GetHiddenLineCount();
-    const size_t visibleTotalLines = lineCount > hiddenLineCount ? lineCount - hiddenLineCount : lineCount;
+    const size_t visibleTotalLines = m_Wrapping ? m_Wrap.GetRowCount()
+                                   : lineCount > hiddenLineCount ? lineCount - hiddenLineCount : lineCount;
 
     // Auto-scroll to cursor only when cursor moved (not every frame)
     // Use m_IsActive in addition to m_IsFocused to handle scroll after mode switches
@@ -181,18 +245,9 @@ bool SyntaxEditor::Render(const char* label, TextBuffer& buffer, const ImVec2& s
 
         // Vertical scrolling - use screen line (accounting for folds)
         // If cursor is hidden, scroll to the fold start line instead
-        size_t targetLine = cursorLine;
-        if (IsLineHidden(cursorLine)) {
-            // Find the fold containing this line
-            for (const auto& [foldStart, foldEnd] : m_FoldEndLines) {
-                if (cursorLine > foldStart && cursorLine <= foldEnd && m_FoldedLines.count(foldStart)) {
-                    targetLine = foldStart;
-                    break;
-                }
-            }
-        }
-        
+        size_t targetLine = m_FoldMap.VisibleOwner(cursorLine);
         size_t screenLine = BufferLineToScreenLine(targetLine);
+        if (targetLine == cursorLine) screenLine += GetWrapPosition(buffer, cursorLine, cursorCol).first;
         float cursorY = screenLine * lineHeight;
         float currentScrollY = ImGui::GetScrollY();
         float displayHeight = region.y;
@@ -207,16 +262,18 @@ bool SyntaxEditor::Render(const char* label, TextBuffer& buffer, const ImVec2& s
             ImGui::SetScrollY(cursorY + lineHeight - displayHeight + scrollOffY);
         }
         
-        // Horizontal scrolling
-        float cursorX = cursorCol * m_CharWidth;
-        float currentScrollX = ImGui::GetScrollX();
-        float displayWidth = region.x - totalGutterWidth;
-        float scrollMargin = std::max(displayWidth * 0.1f, m_CharWidth * 4.0f); 
-
-        if (cursorX < currentScrollX + scrollMargin) {
-            ImGui::SetScrollX(std::max(0.0f, cursorX - scrollMargin));
-        } else if (cursorX > currentScrollX + displayWidth - scrollMargin) {
-            ImGui::SetScrollX(cursorX - displayWidth + scrollMargin);
+        // Horizontal scrolling, which wrapped lines never need
+        if (!m_Wrapping) {
+            float cursorX = cursorCol * m_CharWidth;
+            float currentScrollX = ImGui::GetScrollX();
+            float displayWidth = region.x - totalGutterWidth - minimapWidth;
+            float scrollMargin = std::max(displayWidth * 0.1f, m_CharWidth * 4.0f); 
+
+            if (cursorX < currentScrollX + scrollMargin) {
+                ImGui::SetScrollX(std::max(0.0f, cursorX - scrollMargin));
+            } else if (cursorX > currentScrollX + displayWidth - scrollMargin) {
+                ImGui::SetScrollX(cursorX - displayWidth + scrollMargin);
+            }
         }
     }
     
@@ -228,34 +285,33 @@ bool SyntaxEditor::Render(const char* label, TextBuffer& buffer, const ImVec2& s
     const size_t firstScreenLine = static_cast<size_t>(m_ScrollY / lineHeight);
     const size_t screenLineCount = static_cast<size_t>(contentSize.y / lineHeight) + 2;
     
-    // Convert screen lines to buffer lines
+    // Convert screen lines to buffer lines; the top row may be one of the
+    // first line's wrapped rows, with those above it scrolled out of view
     const size_t firstVisibleLine = ScreenLineToBufferLine(firstScreenLine, lineCount);
-    
-    // Calculate last visible buffer line by counting visible screen rows
-    size_t lastVisibleLine = firstVisibleLine;
-    size_t visibleCount = 0;
-    while (lastVisibleLine < lineCount && visibleCount < screenLineCount) {
-        if (!IsLineHidden(lastVisibleLine)) {
-            visibleCount++;
-        }
-        lastVisibleLine++;
+    const size_t rowsAbove = m_Wrapping ? m_Wrap.RowToLine(firstScreenLine).second : 0;
+    
+    // Last visible buffer line, just past the last row shown
+    const size_t lastScreenLine = BufferLineToScreenLine(firstVisibleLine) + rowsAbove + screenLineCount - 1;
+    const size_t lastRowLine = m_Wrapping ? m_Wrap.RowToLine(lastScreenLine).first : m_FoldMap.RowToLine(lastScreenLine);
+    size_t lastVisibleLine = std::min(lastRowLine + 1, lineCount);
+    m_FirstVisibleLine = firstVisibleLine;
+    m_LastVisibleLine = lastVisibleLine;
+    if (m_RowBreaks.firstLine != firstVisibleLine || m_RowBreaks.lines.size() != lastVisibleLine - firstVisibleLine) {
+        m_RowBreaks.firstLine = firstVisibleLine;
+        m_RowBreaks.lines.assign(lastVisibleLine - firstVisibleLine, std::nullopt);
     }
-    lastVisibleLine = std::min(lastVisibleLine, lineCount);
     
-    // Prepare visible range for large file optimizations
-    buffer.PrepareVisibleRange(firstVisibleLine, lastVisibleLine);
+    // This view's copy of the lines it draws, apart from other views of the buffer
+    buffer.PrepareLineWindow(m_LineWindow, firstVisibleLine, lastVisibleLine);
     
-    // Calculate max line width for horizontal scrollbar (use cached line lengths)
-    float maxLineWidth = 0.0f;
-    for (size_t i = firstVisibleLine; i < lastVisibleLine; ++i) {
-        if (IsLineHidden(i)) continue;
-        size_t lineLen = buffer.LineEnd(i) - buffer.LineStart(i);
-        maxLineWidth = std::max(maxLineWidth, lineLen * m_CharWidth);
-    }
+    // Content width for the horizontal scrollbar from the longest line in the
+    // buffer, so it stays put while scrolling; wrapped lines need none
+    const float maxLineWidth = m_Wrapping ? 0.0f : buffer.MaxLineLength() * m_CharWidth;
     
-    // Set total content size for scrolling (using visible line count)
+    // Set total content size for scrolling (using visible line count), with
+    // room to scroll the longest line clear of the minimap
     float totalHeight = visibleTotalLines * lineHeight;
-    ImGui::Dummy(ImVec2(maxLineWidth + totalGutterWidth, totalHeight));
+    ImGui::Dummy(ImVec2(maxLineWidth + totalGutterWidth + minimapWidth, totalHeight));
     
     // Get window position for drawing (not affected by scroll, we handle scroll ourselves)
     ImVec2 windowPos = ImGui::GetWindowPos();
@@ -264,9 +320,10 @@ bool SyntaxEditor::Render(const char* label, TextBuffer& buffer, const ImVec2& s
     // Calculate the offset within the first visible line due to partial scroll
     float scrollOffset = m_ScrollY - (firstScreenLine * lineHeight);
     
-    // Base position for drawing: window position + padding - partial line offset
+    // Base position for drawing: window position + padding - partial line offset,
+    // at the first visible line's first row
     ImVec2 cursorPos = ImVec2(windowPos.x + windowPadding.x - m_ScrollX, 
-                               windowPos.y + windowPadding.y - scrollOffset);
+                               windowPos.y + windowPadding.y - scrollOffset - rowsAbove * lineHeight);
     ImDrawList* drawList = ImGui::GetWindowDrawList();
     
     // Fold gutter position (between line numbers and text)
@@ -282,13 +339,9 @@ bool SyntaxEditor::Render(const char* label, TextBuffer& buffer, const ImVec2& s
     if (m_IsWindowActive && (m_IsFocused || m_IsActive || m_ShowCompletion) && !m_HasSelection) {
         auto [cursorLine, cursorCol] = buffer.PosToLineCol(m_CursorPos);
         if (cursorLine >= firstVisibleLine && cursorLine < lastVisibleLine && !IsLineHidden(cursorLine)) {
-            // Calculate screen row for cursor line
-            size_t screenRow = 0;
-            for (size_t i = firstVisibleLine; i < cursorLine; ++i) {
-                if (!IsLineHidden(i)) screenRow++;
-            }
+            size_t screenRow = GetRowsBetween(firstVisibleLine, cursorLine);
             float y = textPos.y + screenRow * lineHeight;
-            float textHeight = ImGui::GetTextLineHeight();
+            float textHeight = ImGui::GetTextLineHeight() + (GetLineRows(cursorLine) - 1) * lineHeight;
             drawList->AddRectFilled(
                 ImVec2(cursorPos.x, y),
                 ImVec2(cursorPos.x + contentSize.x, y + textHeight),
@@ -306,7 +359,11 @@ bool SyntaxEditor::Render(const char* label, TextBuffer& buffer, const ImVec2& s
     
     // Render selection background
     if (m_HasSelection) {
-        RenderSelection(buffer, textPos, lineHeight, firstVisibleLine, lastVisibleLine);
+        RenderSelection(buffer, textPos, lineHeight, firstVisibleLine, lastVisibleLine,
+                        std::min(m_SelectionStart, m_SelectionEnd), std::max(m_SelectionStart, m_SelectionEnd));
+    }
+    for (const Caret& caret : m_ExtraCarets) {
+        if (caret.HasSelection()) RenderSelection(buffer, textPos, lineHeight, firstVisibleLine, lastVisibleLine, caret.Start(), caret.End());
     }
     
     // Render indent guides (Rainbow Indents)
@@ -323,73 +380,134 @@ bool SyntaxEditor::Render(const char* label, TextBuffer& buffer, const ImVec2& s
     // Render diagnostics (squiggles)
     RenderDiagnostics(buffer, textPos, lineHeight, firstVisibleLine, lastVisibleLine);
     
+    // Merge background search results, keeping the current match
+    if (!m_Search.IsComplete()) {
+        const std::vector<size_t>& matches = m_Search.Matches();
+        const size_t current = m_SearchCurrentMatch >= 0 ? matches[m_SearchCurrentMatch] : SIZE_MAX;
+        if (m_Search.Poll()) {
+            if (current == SIZE_MAX || (m_SearchActive && current < m_SearchOrigin)) {
+                SelectSearchMatch(m_SearchOrigin);
+            } else {
+                m_SearchCurrentMatch = static_cast<int>(std::lower_bound(matches.begin(), matches.end(), current) - matches.begin());
+            }
+        }
+    }
+
     // Render search highlights
-    if (m_SearchActive && !m_SearchMatches.empty()) {
+    if (m_SearchActive && !m_Search.Matches().empty()) {
         RenderSearchHighlights(buffer, drawList, textPos, lineHeight, firstVisibleLine, lastVisibleLine);
     }
 
     // Render cursor only in the active window
     if (m_IsWindowActive && (m_IsFocused || m_IsActive || m_ShowCompletion) && !m_ReadOnly) {
-        auto [cursorLine, cursorCol] = buffer.PosToLineCol(m_CursorPos);
-        if (cursorLine >= firstVisibleLine && cursorLine < lastVisibleLine) {
-            RenderCursor(buffer, textPos, lineHeight, firstVisibleLine);
-        }
+        RenderCursor(buffer, textPos, lineHeight, firstVisibleLine, lastVisibleLine);
+    }
+    
+    // Minimap over the right edge of the text, clear of the scrollbars
+    bool minimapConsumed = false;
+    if (minimapWidth > 0.0f) {
+        const ImRect& inner = ImGui::GetCurrentWindow()->InnerRect;
+        minimapConsumed = RenderMinimap(buffer, ImVec2(std::max(inner.Min.x, inner.Max.x - minimapWidth), inner.Min.y), inner.Max,
+                                        lineHeight, firstVisibleLine, lastVisibleLine);
+    } else {
+        m_MinimapDragging = false;
     }
     
     // Handle mouse input for clicking and dragging
     ImVec2 mousePos = ImGui::GetMousePos();
     
-    // Helper lambda to convert mouse position to buffer position (accounting for folds)
-    auto mouseToBufPos = [&](ImVec2 pos) -> size_t {
+    // Helper lambdas to convert mouse position to a line and column, then to a
+    // buffer position (accounting for folds); unclamped columns may lie past
+    // the end of the line
+    auto mouseToLineCol = [&](ImVec2 pos, bool clamp) -> std::pair<size_t, size_t> {
         float relX = pos.x - textPos.x;
         float relY = pos.y - textPos.y;
         
-        // Convert screen row to buffer line (account for folded lines)
-        size_t targetScreenRow = static_cast<size_t>(std::max(0.0f, relY) / lineHeight);
-        size_t clickedLine = firstVisibleLine;
-        size_t screenRow = 0;
-        
-        while (clickedLine < lineCount && screenRow < targetScreenRow) {
-            if (!IsLineHidden(clickedLine)) {
-                screenRow++;
-            }
-            clickedLine++;
-        }
-        
-        // Skip any hidden lines at the click position
-        while (clickedLine < lineCount && IsLineHidden(clickedLine)) {
-            clickedLine++;
-        }
-        
+        // Convert screen row to buffer line (account for folded and wrapped lines)
+        size_t targetScreenRow = BufferLineToScreenLine(firstVisibleLine) + static_cast<size_t>(std::max(0.0f, relY) / lineHeight);
+        size_t clickedLine = ScreenLineToBufferLine(targetScreenRow, lineCount);
         clickedLine = std::min(clickedLine, lineCount > 0 ? lineCount - 1 : 0);
         
         size_t clickedCol = static_cast<size_t>(std::max(0.0f, relX) / m_CharWidth);
         size_t lineLen = buffer.LineEnd(clickedLine) - buffer.LineStart(clickedLine);
-        clickedCol = std::min(clickedCol, lineLen);
-        
-        return buffer.LineColToPos(clickedLine, clickedCol);
+        if (m_Wrapping) {
+            // Past the end of a row that wraps is its last column
+            const std::vector<size_t>& breaks = GetRowBreaks(buffer, clickedLine);
+            const size_t row = std::min(targetScreenRow - std::min(targetScreenRow, BufferLineToScreenLine(clickedLine)), breaks.size());
+            const size_t rowStart = row > 0 ? breaks[row - 1] : 0;
+            clickedCol += rowStart;
+            if (row < breaks.size()) lineLen = breaks[row] - 1;
+        }
+        if (clamp) clickedCol = std::min(clickedCol, lineLen);
+        return {clickedLine, clickedCol};
+    };
+    auto mouseToBufPos = [&](ImVec2 pos) -> size_t {
+        auto [line, col] = mouseToLineCol(pos, true);
+        return buffer.LineColToPos(line, col);
+    };
+    
+    // Column selection: a cursor on each shown line between the anchor and
+    // the mouse, selecting the same cells of each as far as the line reaches
+    auto selectColumns = [&](size_t toLine, size_t toCol) {
+        const size_t first = std::min(m_ColumnAnchorLine, toLine);
+        const size_t last = std::max(m_ColumnAnchorLine, toLine);
+        m_ExtraCarets.clear();
+        for (size_t line = m_FoldMap.NextVisible(first); line <= last; line = m_FoldMap.NextVisible(line + 1)) {
+            const size_t lineStart = buffer.LineStart(line);
+            const size_t lineLen = buffer.LineEnd(line) - lineStart;
+            const Caret caret{lineStart + std::min(m_ColumnAnchorCol, lineLen), lineStart + std::min(toCol, lineLen)};
+            if (line == toLine) {
+                m_SelectionStart = caret.anchor;
+                m_CursorPos = m_SelectionEnd = caret.pos;
+                m_HasSelection = caret.HasSelection();
+            } else {
+                m_ExtraCarets.push_back(caret);
+            }
+        }
     };
     
     // Mouse click - start selection or set cursor (skip if fold gutter consumed the click)
-    if (ImGui::IsWindowHovered() && ImGui::IsMouseClicked(0) && !foldClickConsumed) {
-        m_CursorPos = mouseToBufPos(mousePos);
+    if (ImGui::IsWindowHovered() && ImGui::IsMouseClicked(0) && !foldClickConsumed && !minimapConsumed) {
+        const ImGuiIO& io = ImGui::GetIO();
+        const size_t clickedPos = mouseToBufPos(mousePos);
         m_NeedsScrollToCursor = true;
         m_IsActive = true;  // User clicked in editor, mark as active
         
         // Close completion on mouse click navigation
         m_ShowCompletion = false;
+        m_ColumnSelecting = false;
         
-        // Handle selection with shift
-        if (ImGui::GetIO().KeyShift) {
-            m_SelectionEnd = m_CursorPos;
-            m_HasSelection = m_SelectionStart != m_SelectionEnd;
-        } else {
-            m_SelectionStart = m_CursorPos;
-            m_SelectionEnd = m_CursorPos;
+        if (io.KeyAlt && io.KeyShift) {
+            std::tie(m_ColumnAnchorLine, m_ColumnAnchorCol) = mouseToLineCol(mousePos, false);
+            m_ColumnSelecting = true;
+            selectColumns(m_ColumnAnchorLine, m_ColumnAnchorCol);
+        } else if (io.KeyAlt) {
+            // Alt+click adds a cursor, which becomes the primary one
+            std::vector<Caret> carets = m_ExtraCarets;
+            carets.push_back({m_HasSelection ? m_SelectionStart : m_CursorPos, m_CursorPos});
+            carets.push_back({clickedPos, clickedPos});
+            size_t primary = carets.size() - 1;
+            TextOps::NormalizeCarets(carets, primary);
+            m_CursorPos = m_SelectionStart = m_SelectionEnd = carets[primary].pos;
             m_HasSelection = false;
+            carets.erase(carets.begin() + primary);
+            m_ExtraCarets = std::move(carets);
+        } else {
+            m_CursorPos = clickedPos;
+            m_ExtraCarets.clear();
+            
+            // Handle selection with shift
+            if (io.KeyShift) {
+                m_SelectionEnd = m_CursorPos;
+                m_HasSelection = m_SelectionStart != m_SelectionEnd;
+            } else {
+                m_SelectionStart = m_CursorPos;
+                m_SelectionEnd = m_CursorPos;
+                m_HasSelection = false;
+            }
         }
         
-        m_IsDragging = true;
+        m_IsDragging = !io.KeyAlt || io.KeyShift;
         m_CursorBlinkTimer = 0.0f;
     }
     // Clear active state if user clicks outside this editor
@@ -399,19 +517,30 @@ bool SyntaxEditor::Render(const char* label, TextBuffer& buffer, const ImVec2& s
     
     // Mouse drag - extend selection
     if (m_IsDragging && ImGui::IsMouseDown(0)) {
-        size_t newPos = mouseToBufPos(mousePos);
-        if (newPos != m_CursorPos) {
-            m_CursorPos = newPos;
-            m_SelectionEnd = m_CursorPos;
-            m_HasSelection = m_SelectionStart != m_SelectionEnd;
-            m_CursorBlinkTimer = 0.0f;
-            m_NeedsScrollToCursor = true;
+        if (m_ColumnSelecting) {
+            auto [line, col] = mouseToLineCol(mousePos, false);
+            const size_t previous = m_CursorPos;
+            selectColumns(line, col);
+            if (m_CursorPos != previous) {
+                m_CursorBlinkTimer = 0.0f;
+                m_NeedsScrollToCursor = true;
+            }
+        } else {
+            size_t newPos = mouseToBufPos(mousePos);
+            if (newPos != m_CursorPos) {
+                m_CursorPos = newPos;
+                m_SelectionEnd = m_CursorPos;
+                m_HasSelection = m_SelectionStart != m_SelectionEnd;
+                m_CursorBlinkTimer = 0.0f;
+                m_NeedsScrollToCursor = true;
+            }
         }
     }
     
     // Mouse release - stop dragging
     if (ImGui::IsMouseReleased(0)) {
         m_IsDragging = false;
+        m_ColumnSelecting = false;
     }
     
     // Handle keyboard input (Navigation and State Control)
@@ -423,6 +552,8 @@ bool SyntaxEditor::Render(const char* label, TextBuffer& buffer, const ImVec2& s
         auto& settings = EditorSettings::Get();
         auto [line, col] = buffer.PosToLineCol(m_CursorPos);
         settings.SetCursorPos(line + 1, col + 1);  // 1-based for display
+        settings.SetIndexingProgress(buffer.IsIndexing() ? buffer.GetIndexingProgress() : -1.0f);
+        settings.SetMacroRecording(m_InputManager.IsRecording());
 
         // Process Text Input (Typing)
         if (!inputHandled) {
@@ -435,15 +566,14 @@ bool SyntaxEditor::Render(const char* label, TextBuffer& buffer, const ImVec2& s
     ImVec4 bufferRect; // x, y, x+w, y+h
     {
         auto [cursorLine, cursorCol] = buffer.PosToLineCol(m_CursorPos);
-        size_t firstVisibleLine = static_cast<size_t>(m_ScrollY / lineHeight);
+        const size_t topScreenLine = BufferLineToScreenLine(firstVisibleLine);  // Row textPos is at
         
-        // Calculate screen row for cursor (accounting for folds)
-        size_t screenRow = 0;
-        for (size_t i = firstVisibleLine; i < cursorLine; ++i) {
-            if (!IsLineHidden(i)) screenRow++;
-        }
+        // Calculate screen row for cursor (accounting for folds and wrapping)
+        const auto [wrapRow, wrapCol] = GetWrapPosition(buffer, cursorLine, cursorCol);
+        const size_t cursorScreenLine = BufferLineToScreenLine(cursorLine) + wrapRow;
+        size_t screenRow = cursorScreenLine > topScreenLine ? cursorScreenLine - topScreenLine : 0;
         
-        cursorScreenPos.x = textPos.x + cursorCol * m_CharWidth;
+        cursorScreenPos.x = textPos.x + wrapCol * m_CharWidth;
         cursorScreenPos.y = textPos.y + screenRow * lineHeight;
         
         // Get buffer region bounds (child window bounds)
@@ -478,11 +608,12 @@ void SyntaxEditor::HandleTextInput(TextBuffer& buffer) {
      // Build editor state for input mode
     EditorState state;
     state.buffer = &buffer;
-    state.undoTree = &m_UndoTree;
+    state.undoTree = &buffer.GetUndoTree();
     state.cursorPos = m_CursorPos;
     state.selectionStart = m_SelectionStart;
     state.selectionEnd = m_SelectionEnd;
     state.hasSelection = m_HasSelection;
+    state.extraCarets = m_ExtraCarets;
 
     InputResult textResult = m_InputManager.HandleTextInput(
         state, 
@@ -498,9 +629,18 @@ void SyntaxEditor::HandleTextInput(TextBuffer& buffer) {
             m_CursorBlinkTimer = 0.0f;
             m_NeedsScrollToCursor = true;
         }
-        if (textResult.textChanged) {
+        if (textResult.selectionChanged) {
+            if (textResult.newSelectionStart) m_SelectionStart = *textResult.newSelectionStart;
+            if (textResult.newSelectionEnd) m_SelectionEnd = *textResult.newSelectionEnd;
+            m_HasSelection = m_SelectionStart != m_SelectionEnd;
+        }
+        if (textResult.newExtraCarets) m_ExtraCarets = std::move(*textResult.newExtraCarets);
+        // Completion follows a single cursor only
+        if (textResult.textChanged && !m_ExtraCarets.empty()) {
+            buffer.MarkModified();
+            m_ShowCompletion = false;
+        } else if (textResult.textChanged) {
              buffer.MarkModified();
-             m_FoldRangesDirty = true;  // Recalculate fold ranges after edit
 
             // Auto-trigger and Update Completion
             // We run this even if completion is already shown to update/filter the list
@@ -514,7 +654,7 @@ void SyntaxEditor::HandleTextInput(TextBuffer& buffer) {
                     m_ShowCompletion = false;
                 }
                 else if (isTriggerChar || isWordChar) {
-                    auto [line, col] = buffer.PosToLineCol(m_CursorPos);
+                    auto [line, col] = buffer.PosToLineUtf16Col(m_CursorPos);
                     const auto* langPtr = buffer.GetLanguage();
                     std::string lang = langPtr ? langPtr->name : "";
                     
@@ -533,29 +673,10 @@ void SyntaxEditor::HandleTextInput(TextBuffer& buffer) {
                         // Optimistically show local completions FIRST
                         if (m_CursorPos - start >= 1) {
                             std::string prefix = buffer.Substring(start, m_CursorPos - start);
-                            std::vector<std::string> words = buffer.GetWordCompletions(prefix);
-                            
-                            if (langPtr) {
-                                for(const auto& mapping : langPtr->highlightMappings) {
-                                    if (mapping.second == HighlightGroup::Keyword || mapping.second == HighlightGroup::Type) {
-                                        if (mapping.first.length() > prefix.length() && 
-                                            mapping.first.substr(0, prefix.length()) == prefix) {
-                                            words.push_back(mapping.first);
-                                        }
-                                    }
-                                }
-                            }
+                            std::vector<LSPCompletionItem> items = BuiltinCompletions(buffer, prefix, true);
 
-                            if (!words.empty()) {
-                                m_CompletionItems.clear();
-                                for(const auto& w : words) {
-                                    LSPCompletionItem item;
-                                    item.label = w;
-                                    item.kind = 1; // Text
-                                    item.insertText = w;
-                                    item.detail = "Buffer";
-                                    m_CompletionItems.push_back(item);
-                                }
+                            if (!items.empty()) {
+                                m_CompletionItems = std::move(items);
                                 m_ShowCompletion = true;
                                 m_SelectedCompletionIndex = 0;
                             }
@@ -565,15 +686,16 @@ void SyntaxEditor::HandleTextInput(TextBuffer& buffer) {
                     if (hasServerConfig) {
                         // LSP Mode - Attempt to fetch smarter results
                         if (isTriggerChar || (isWordChar && m_CursorPos - start >= 1)) {
+                             m_CompletionCancel.Cancel();
+                             m_CompletionCancel = CancellationSource();
                              LSPManager::GetInstance().RequestCompletion(
                                 buffer.GetFilePath().string(), 
-                                lang, 
+                                [&buffer] { return buffer.ToString(); },
                                 line, col, 
-                                [this](const std::vector<LSPCompletionItem>& items) {
-                                    // Thread-safe: queue items for main thread processing
-                                    std::lock_guard<std::mutex> lock(m_PendingCompletionMutex);
-                                    m_PendingCompletionItems = items;
-                                }
+                                [this, cancel = m_CompletionCancel.Token()](const std::vector<LSPCompletionItem>& items) {
+                                    JobSystem::DispatchToMain(cancel, [this, items] { ShowCompletionItems(items); });
+                                },
+                                m_CompletionCancel.Token()
                             );
                         }
                     } 
@@ -595,10 +717,7 @@ void SyntaxEditor::RenderLineNumbers(TextBuffer& buffer, const ImVec2& pos, floa
     auto [cursorLine, cursorCol] = buffer.PosToLineCol(m_CursorPos);
     
     size_t screenRow = 0;
-    for (size_t i = firstLine; i < lastLine; ++i) {
-        // Skip hidden (folded) lines
-        if (IsLineHidden(i)) continue;
-        
+    for (size_t i = m_FoldMap.NextVisible(firstLine); i < lastLine; i = m_FoldMap.NextVisible(i + 1)) {
         float y = pos.y + screenRow * lineHeight;
         
         // Highlight current line number
@@ -625,7 +744,7 @@ void SyntaxEditor::RenderLineNumbers(TextBuffer& buffer, const ImVec2& pos, floa
             }
         }
         
-        screenRow++;
+        screenRow += GetLineRows(i);
     }
     
     // Draw separator line
@@ -641,45 +760,14 @@ void SyntaxEditor::RenderText(TextBuffer& buffer, const ImVec2& pos, float lineH
                                size_t firstLine, size_t lastLine) {
     ImDrawList* drawList = ImGui::GetWindowDrawList();
     
-    // Get syntax tokens for visible range
-    std::vector<SyntaxToken> tokens = buffer.GetSyntaxTokens(firstLine, lastLine);
-    
-    // Build a flat list of color changes sorted by position for O(log n) lookup
-    struct ColorChange {
-        size_t pos;
-        ImU32 color;
-        bool isStart;  // true = token start, false = token end
-    };
-    std::vector<ColorChange> colorChanges;
-    colorChanges.reserve(tokens.size() * 2);
-    
-    for (const auto& token : tokens) {
-        ImU32 color = m_Theme.GetColor(static_cast<HighlightGroup>(token.highlightId));
-        
-        if (token.depth > 0 && !m_Theme.rainbowBrackets.empty()) {
-             std::string_view type = token.type;
-             if (type == "{" || type == "}" || type == "(" || type == ")" || type == "[" || type == "]") {
-                 color = m_Theme.rainbowBrackets[(token.depth - 1) % m_Theme.rainbowBrackets.size()];
-             }
-        }
-        
-        colorChanges.push_back({token.startByte, color, true});
-        colorChanges.push_back({token.endByte, m_Theme.text, false});
-    }
-    
-    std::sort(colorChanges.begin(), colorChanges.end(), [](const ColorChange& a, const ColorChange& b) {
-        if (a.pos != b.pos) return a.pos < b.pos;
-        // Ends come before Starts at same position
-        return a.isStart < b.isStart;
-    });
+    buffer.UpdateSemanticTokens(firstLine, lastLine);
+    buffer.UpdateHighlights(firstLine, lastLine);
+    ValidateGlyphCache();
     
     // Render each visible line
     size_t screenRow = 0;
-    for (size_t lineIdx = firstLine; lineIdx < lastLine; ++lineIdx) {
-        // Skip hidden (folded) lines
-        if (IsLineHidden(lineIdx)) continue;
-        
-        std::string_view lineText = buffer.LineView(lineIdx);
+    for (size_t lineIdx = m_FoldMap.NextVisible(firstLine); lineIdx < lastLine; lineIdx = m_FoldMap.NextVisible(lineIdx + 1)) {
+        std::string_view lineText = buffer.LineView(m_LineWindow, lineIdx);
         
         // Strip trailing newlines/CR to prevent whitespace rendering issues
         while (!lineText.empty() && (lineText.back() == '\n' || lineText.back() == '\r')) {
@@ -703,69 +791,67 @@ void SyntaxEditor::RenderText(TextBuffer& buffer, const ImVec2& pos, float lineH
             continue;
         }
         
-        size_t lineStart = buffer.LineStart(lineIdx);
-        size_t lineEnd = lineStart + lineText.length();
-        
-        // Binary search to find first color change at or before lineStart
-        auto it = std::upper_bound(colorChanges.begin(), colorChanges.end(), lineStart,
-            [](size_t pos, const ColorChange& cc) { return pos < cc.pos; });
-        
-        // Find the active color at lineStart by scanning backwards
-        ImU32 currentColor = m_Theme.text;
-        for (const auto& token : tokens) {
-            if (token.startByte <= lineStart && token.endByte > lineStart) {
-                currentColor = m_Theme.GetColor(static_cast<HighlightGroup>(token.highlightId));
-                // Check if this token should have rainbow color (re-apply logic for initial state)
-                 if (token.depth > 0 && !m_Theme.rainbowBrackets.empty()) {
-                    std::string_view type = token.type;
-                    if (type == "{" || type == "}" || type == "(" || type == ")" || type == "[" || type == "]") {
-                        currentColor = m_Theme.rainbowBrackets[(token.depth - 1) % m_Theme.rainbowBrackets.size()];
-                    }
-                }
-                break;
+        const std::span<const HighlightSpan> spans = buffer.GetLineHighlights(lineIdx);
+        const bool printable = m_Glyphs.monospace && std::all_of(lineText.begin(), lineText.end(), [](char c) {
+            return (c >= ' ' && c <= '~') || c == '\t';
+        });
+        const std::vector<size_t>& breaks = GetRowBreaks(buffer, lineIdx);
+        const ImVec4& clipRect = drawList->_ClipRectStack.back();
+        for (size_t row = 0; row <= breaks.size(); ++row) {
+            const size_t rowStart = row > 0 ? breaks[row - 1] : 0;
+            const size_t rowEnd = row < breaks.size() ? breaks[row] : lineText.length();
+            x = pos.x;
+            y = pos.y + (screenRow + row) * lineHeight;
+            // Rows of a long wrapped line mostly lie outside the view
+            if (y + lineHeight < clipRect.y && row < breaks.size()) continue;
+            if (y > clipRect.w) break;
+            
+            // The spans reaching into the row
+            auto first = std::partition_point(spans.begin(), spans.end(), [rowStart](const HighlightSpan& span) {
+                return span.end <= rowStart;
+            });
+            auto last = std::partition_point(first, spans.end(), [rowEnd](const HighlightSpan& span) {
+                return span.start < rowEnd;
+            });
+            const std::span<const HighlightSpan> rowSpans(first, last);
+            if (printable) {
+                RenderGlyphs(drawList, lineText, rowStart, rowEnd, rowSpans, x, y);
+                continue;
             }
-        }
-        
-        // Process color changes within this line
-        size_t charIdx = 0;
-        size_t spanStart = 0;
-        ImU32 spanColor = currentColor;
-        
-        while (charIdx < lineText.length()) {
-            size_t bytePos = lineStart + charIdx;
             
-            // Check if there's a color change at this position
-             while (it != colorChanges.end() && it->pos == bytePos) {
-                if (charIdx > spanStart) {
-                    RenderSpan(drawList, lineText, spanStart, charIdx, x, y, spanColor);
+            // Spans are sorted by start; text between them keeps the default
+            // color. Neighbours of one color, and spaces whatever their color,
+            // join the pending run so each color change costs one draw call.
+            size_t runStart = rowStart;
+            size_t runEnd = rowStart;
+            ImU32 runColor = m_Theme.text;
+            bool runBlank = true;
+            auto paint = [&](size_t start, size_t end, ImU32 color) {
+                if (lineText.substr(start, end - start).find_first_not_of(' ') == std::string_view::npos) {
+                    runEnd = end;
+                    return;
                 }
-                spanStart = charIdx;
-
-                if (it->isStart) {
-                    spanColor = it->color;
-                } else {
-                    // Revert to text
-                    spanColor = m_Theme.text;
+                if (!runBlank && color != runColor) {
+                    RenderSpan(drawList, lineText, runStart, runEnd, x, y, runColor);
+                    runStart = start;
                 }
-                ++it;
-            }
-            
-            ++charIdx;
-            
-            // Advance iterator past positions we've passed (should not be needed if step-by-step logic is correct)
-            while (it != colorChanges.end() && it->pos < lineStart + charIdx) {
-                 if (it->isStart) {
-                    spanColor = it->color;
-                } else {
-                    spanColor = m_Theme.text;
+                runColor = color;
+                runBlank = false;
+                runEnd = end;
+            };
+            for (const HighlightSpan& span : rowSpans) {
+                size_t start = std::max<size_t>(span.start, runEnd);
+                size_t end = std::min<size_t>(span.end, rowEnd);
+                if (start >= end) continue;
+                if (start > runEnd) {
+                    paint(runEnd, start, m_Theme.text);
                 }
-                ++it;
+                paint(start, end, SpanColor(span));
             }
-        }
-        
-        // Render final span
-        if (lineText.length() > spanStart) {
-            RenderSpan(drawList, lineText, spanStart, lineText.length(), x, y, spanColor);
+            if (rowEnd > runEnd) {
+                paint(runEnd, rowEnd, m_Theme.text);
+            }
+            RenderSpan(drawList, lineText, runStart, runEnd, x, y, runColor);
         }
         
         // Draw fold indicator "..." after the line if folded
@@ -779,7 +865,7 @@ void SyntaxEditor::RenderText(TextBuffer& buffer, const ImVec2& pos, float lineH
             }
         }
         
-        screenRow++;
+        screenRow += breaks.size() + 1;
     }
 }
 
@@ -829,7 +915,165 @@ void SyntaxEditor::RenderSpan(ImDrawList* drawList, std::string_view lineText,
     }
 }
 
-void SyntaxEditor::RenderCursor(TextBuffer& buffer, const ImVec2& textPos, float lineHeight, size_t firstLine) {
+void SyntaxEditor::RenderGlyphs(ImDrawList* drawList, std::string_view lineText, size_t begin, size_t end,
+                                std::span<const HighlightSpan> spans, float& x, float y) {
+    const ImVec4& clipRect = drawList->_ClipRectStack.back();
+    const float tabWidth = m_CharWidth * m_TabSize;
+    const float scale = m_Glyphs.scale;
+    const size_t tabs = std::count(lineText.begin() + begin, lineText.begin() + end, '\t');
+    // Pixel aligned at the start as AddText is, then advancing unrounded
+    const float originX = std::floor(x);
+    y = std::floor(y);
+    x = originX + (end - begin - tabs) * m_CharWidth + tabs * tabWidth;
+
+    // Without tabs the first visible column is found without walking to it
+    float cellX = originX;
+    if (tabs == 0 && clipRect.x > originX + m_CharWidth) {
+        const size_t skipped = std::min(end - begin, static_cast<size_t>((clipRect.x - originX) / m_CharWidth) - 1);
+        begin += skipped;
+        cellX += skipped * m_CharWidth;
+    }
+    if (begin == end || cellX > clipRect.z) return;
+
+    // Each byte takes at least one cell, which bounds the glyphs in view
+    const size_t reserved = std::min(end - begin,
+                                     static_cast<size_t>((clipRect.z - cellX) / m_CharWidth) + 1);
+    drawList->PrimReserve(static_cast<int>(reserved * 6), static_cast<int>(reserved * 4));
+    size_t drawn = 0;
+
+    auto span = spans.begin();
+    const HighlightSpan* colored = nullptr;
+    ImU32 spanColor = m_Theme.text;
+    for (size_t i = begin; i < end && cellX <= clipRect.z; ++i) {
+        const char c = lineText[i];
+        if (c == '\t') {
+            cellX += tabWidth;
+            continue;
+        }
+        while (span != spans.end() && span->end <= i) ++span;
+        const bool inSpan = span != spans.end() && span->start <= i;
+        if (inSpan && colored != &*span) {
+            colored = &*span;
+            spanColor = SpanColor(*span);
+        }
+
+        const ImFontGlyph& glyph = m_Glyphs.glyphs[static_cast<unsigned char>(c)];
+        if (glyph.Visible && cellX + m_CharWidth >= clipRect.x) {
+            drawList->PrimRectUV(ImVec2(cellX + glyph.X0 * scale, y + glyph.Y0 * scale),
+                                 ImVec2(cellX + glyph.X1 * scale, y + glyph.Y1 * scale),
+                                 ImVec2(glyph.U0, glyph.V0), ImVec2(glyph.U1, glyph.V1),
+                                 inSpan ? spanColor : m_Theme.text);
+            ++drawn;
+        }
+        cellX += m_CharWidth;
+    }
+    drawList->PrimUnreserve(static_cast<int>((reserved - drawn) * 6), static_cast<int>((reserved - drawn) * 4));
+}
+
+// Rows of the map stand for bands of lines, drawn from the cache at up to
+// MINIMAP_MAX_ROW_HEIGHT each; the band under the mouse while dragging is
+// scrolled to the middle of the view
+std::pair<size_t, size_t> SyntaxEditor::GetCursorLineCol(const TextBuffer& buffer) const {
+    if (m_PendingJump && m_PendingJump->buffer == &buffer && m_PendingJump->cursor == m_CursorPos) {
+        return {m_PendingJump->line, m_PendingJump->column};
+    }
+    return buffer.PosToLineCol(m_CursorPos);
+}
+
+// While indexing, a line is whole once the next one has begun
+void SyntaxEditor::ApplyPendingJump(const TextBuffer& buffer) {
+    if (m_PendingJump->buffer != &buffer || m_PendingJump->cursor != m_CursorPos) {
+        m_PendingJump.reset();
+        return;
+    }
+    if (buffer.IsIndexing() && m_PendingJump->line + 1 >= buffer.LineCount()) return;
+    SetCursorPos(buffer.LineColToPos(m_PendingJump->line, m_PendingJump->column));
+    m_PendingJump.reset();
+}
+
+bool SyntaxEditor::RenderMinimap(TextBuffer& buffer, const ImVec2& min, const ImVec2& max, float lineHeight,
+                                 size_t firstLine, size_t lastLine) {
+    const float height = max.y - min.y;
+    if (height < 1.0f || max.x <= min.x) {
+        m_MinimapDragging = false;
+        return false;
+    }
+    if (!m_Minimap.Update(buffer, static_cast<size_t>(height), static_cast<size_t>(max.x - min.x),
+                          static_cast<size_t>(std::max(m_TabSize, 1)), MINIMAP_ROWS_PER_FRAME)) {
+        FrameScheduler::GetInstance().RequestFrame();
+    }
+    
+    ImDrawList* drawList = ImGui::GetWindowDrawList();
+    drawList->AddRectFilled(min, max, m_Theme.background);
+    const size_t linesPerRow = m_Minimap.GetLinesPerRow();
+    const float rowHeight = std::min(MINIMAP_MAX_ROW_HEIGHT, height / std::max<size_t>(m_Minimap.GetRowCount(), 1));
+    for (size_t row = 0; row < m_Minimap.GetRowCount(); ++row) {
+        const float y = min.y + row * rowHeight;
+        for (const MinimapCache::Run& run : m_Minimap.GetRow(row)) {
+            drawList->AddRectFilled(ImVec2(min.x + run.first, y), ImVec2(min.x + run.last, y + rowHeight),
+                                    m_Theme.GetColor(static_cast<HighlightGroup>(run.group)));
+        }
+    }
+    
+    const ImVec2 mouse = ImGui::GetMousePos();
+    const bool hovered = ImGui::IsWindowHovered() && mouse.x >= min.x && mouse.x < max.x && mouse.y >= min.y && mouse.y < max.y;
+    if (hovered && ImGui::IsMouseClicked(0)) m_MinimapDragging = true;
+    if (!ImGui::IsMouseDown(0)) m_MinimapDragging = false;
+    
+    // The lines in view
+    const float viewTop = min.y + static_cast<float>(firstLine) / linesPerRow * rowHeight;
+    const float viewBottom = min.y + static_cast<float>(lastLine) / linesPerRow * rowHeight;
+    drawList->AddRectFilled(ImVec2(min.x, viewTop), ImVec2(max.x, std::max(viewBottom, viewTop + rowHeight)),
+                            (hovered || m_MinimapDragging) ? IM_COL32(255, 255, 255, 40) : IM_COL32(255, 255, 255, 24));
+    
+    if (m_MinimapDragging) {
+        const size_t row = static_cast<size_t>(std::max(0.0f, mouse.y - min.y) / rowHeight);
+        const size_t line = std::min(row * linesPerRow, buffer.LineCount() - 1);
+        const float lineY = BufferLineToScreenLine(m_FoldMap.VisibleOwner(line)) * lineHeight;
+        ImGui::SetScrollY(std::max(0.0f, lineY - height * 0.5f));
+        FrameScheduler::GetInstance().RequestFrame();
+    }
+    return hovered || m_MinimapDragging;
+}
+
+ImU32 SyntaxEditor::SpanColor(const HighlightSpan& span) const {
+    if (span.bracket && span.depth > 0 && !m_Theme.rainbowBrackets.empty()) {
+        return m_Theme.rainbowBrackets[(span.depth - 1) % m_Theme.rainbowBrackets.size()];
+    }
+    return m_Theme.GetColor(static_cast<HighlightGroup>(span.highlightId));
+}
+
+void SyntaxEditor::ValidateGlyphCache() {
+    ImFont* font = ImGui::GetFont();
+    const float size = ImGui::GetFontSize();
+    if (font == m_Glyphs.font && font->Glyphs.Data == m_Glyphs.glyphData && size == m_Glyphs.size) return;
+
+    m_Glyphs.font = font;
+    m_Glyphs.glyphData = font->Glyphs.Data;
+    m_Glyphs.size = size;
+    m_Glyphs.scale = size / font->FontSize;
+    m_Glyphs.monospace = true;
+    for (int c = ' '; c <= '~'; ++c) {
+        const ImFontGlyph* glyph = font->FindGlyph(static_cast<ImWchar>(c));
+        if (!glyph || std::fabs(glyph->AdvanceX * m_Glyphs.scale - m_CharWidth) > 0.01f) {
+            m_Glyphs.monospace = false;
+            return;
+        }
+        m_Glyphs.glyphs[c] = *glyph;
+    }
+}
+
+void SyntaxEditor::RenderCursor(TextBuffer& buffer, const ImVec2& textPos, float lineHeight, size_t firstLine, size_t lastLine) {
+    // Cursors in view as (line, col); with none the blink asks for no frames
+    std::vector<std::pair<size_t, size_t>> visible;
+    auto addVisible = [&](size_t pos) {
+        auto lineCol = buffer.PosToLineCol(pos);
+        if (lineCol.first >= firstLine && lineCol.first < lastLine) visible.push_back(lineCol);
+    };
+    addVisible(m_CursorPos);
+    for (const Caret& caret : m_ExtraCarets) addVisible(caret.pos);
+    if (visible.empty()) return;
+    
     // Update blink timer
     m_CursorBlinkTimer += ImGui::GetIO().DeltaTime;
     if (m_CursorBlinkTimer > CURSOR_BLINK_RATE * 2) {
@@ -838,77 +1082,77 @@ void SyntaxEditor::RenderCursor(TextBuffer& buffer, const ImVec2& textPos, float
     
     // Only show cursor half the time (blinking)
     if (m_CursorBlinkTimer > CURSOR_BLINK_RATE) {
+        FrameScheduler::GetInstance().RequestFrameIn(CURSOR_BLINK_RATE * 2 - m_CursorBlinkTimer);
         return;
     }
+    FrameScheduler::GetInstance().RequestFrameIn(CURSOR_BLINK_RATE - m_CursorBlinkTimer);
     
     ImDrawList* drawList = ImGui::GetWindowDrawList();
     
-    // Get cursor line/col from buffer
-    auto [cursorLine, cursorCol] = buffer.PosToLineCol(m_CursorPos);
-    
-    // Calculate screen row for cursor (accounting for folds)
-    size_t screenRow = 0;
-    for (size_t i = firstLine; i < cursorLine; ++i) {
-        if (!IsLineHidden(i)) screenRow++;
-    }
-    
-    // Calculate cursor screen position
-    float x = textPos.x + cursorCol * m_CharWidth;
-    float y = textPos.y + screenRow * lineHeight;
-    
     // Draw cursor based on input mode
     // Insert mode: thin vertical bar | Command mode: horizontal underscore
     bool isInsertMode = InputSystem::GetInstance().GetInputMode() == EditorInputMode::Insert;
     float textHeight = ImGui::GetTextLineHeight();
     
-    if (isInsertMode) {
-        // Thin vertical bar cursor for Insert mode
-        drawList->AddRectFilled(
-            ImVec2(x, y),
-            ImVec2(x + 2, y + textHeight),
-            m_Theme.cursor
-        );
-    } else {
-        // Horizontal underscore cursor for Command mode
-        float underscoreHeight = 2.0f;
-        drawList->AddRectFilled(
-            ImVec2(x, y + textHeight - underscoreHeight),
-            ImVec2(x + m_CharWidth, y + textHeight),
-            m_Theme.cursor
-        );
+    for (const auto& [cursorLine, cursorCol] : visible) {
+        // Calculate screen row for cursor (accounting for folds and wrapping)
+        const auto [wrapRow, wrapCol] = GetWrapPosition(buffer, cursorLine, cursorCol);
+        size_t screenRow = GetRowsBetween(firstLine, cursorLine) + wrapRow;
+        
+        // Calculate cursor screen position
+        float x = textPos.x + wrapCol * m_CharWidth;
+        float y = textPos.y + screenRow * lineHeight;
+        
+        if (isInsertMode) {
+            // Thin vertical bar cursor for Insert mode
+            drawList->AddRectFilled(
+                ImVec2(x, y),
+                ImVec2(x + 2, y + textHeight),
+                m_Theme.cursor
+            );
+        } else {
+            // Horizontal underscore cursor for Command mode
+            float underscoreHeight = 2.0f;
+            drawList->AddRectFilled(
+                ImVec2(x, y + textHeight - underscoreHeight),
+                ImVec2(x + m_CharWidth, y + textHeight),
+                m_Theme.cursor
+            );
+        }
     }
 }
 
 void SyntaxEditor::RenderSelection(TextBuffer& buffer, const ImVec2& textPos, float lineHeight,
-                                    size_t firstLine, size_t lastLine) {
-    if (!m_HasSelection) return;
-    
+                                    size_t firstLine, size_t lastLine, size_t selStart, size_t selEnd) {
     ImDrawList* drawList = ImGui::GetWindowDrawList();
     
-    size_t selStart = std::min(m_SelectionStart, m_SelectionEnd);
-    size_t selEnd = std::max(m_SelectionStart, m_SelectionEnd);
-    
     auto [startLine, startCol] = buffer.PosToLineCol(selStart);
     auto [endLine, endCol] = buffer.PosToLineCol(selEnd);
+    if (endLine < firstLine || startLine >= lastLine) return;
 
     // Use text height instead of line height (which includes spacing)
     // to avoid selection looking "larger" than the text line
     float textHeight = ImGui::GetTextLineHeight();
     
-    // Build screen row mapping
-    size_t screenRow = 0;
-    for (size_t line = firstLine; line <= endLine && line < lastLine; ++line) {
-        if (IsLineHidden(line)) continue;
+    // Rows from the first line in view the selection touches
+    const size_t fromLine = m_FoldMap.NextVisible(std::max(firstLine, startLine));
+    size_t screenRow = GetRowsBetween(firstLine, fromLine);
+    for (size_t line = fromLine; line <= endLine && line < lastLine;
+         line = m_FoldMap.NextVisible(line + 1)) {
+        const std::vector<size_t>& breaks = GetRowBreaks(buffer, line);
+        size_t lineLen = buffer.LineEnd(line) - buffer.LineStart(line);
         
-        if (line >= startLine) {
-            size_t lineLen = buffer.LineEnd(line) - buffer.LineStart(line);
-            float y = textPos.y + screenRow * lineHeight;
-            
-            size_t colStart = (line == startLine) ? startCol : 0;
-            size_t colEnd = (line == endLine) ? endCol : lineLen;
-            
-            float xStart = textPos.x + colStart * m_CharWidth;
-            float xEnd = textPos.x + colEnd * m_CharWidth;
+        size_t colStart = (line == startLine) ? startCol : 0;
+        size_t colEnd = (line == endLine) ? endCol : lineLen;
+        
+        // One rectangle per wrapped row the selection reaches into
+        for (size_t row = 0; row <= breaks.size(); ++row) {
+            const size_t rowStart = row > 0 ? breaks[row - 1] : 0;
+            const size_t rowEnd = row < breaks.size() ? breaks[row] : lineLen;
+            if (colStart > rowEnd || colEnd < rowStart) continue;
+            float y = textPos.y + (screenRow + row) * lineHeight;
+            float xStart = textPos.x + (std::max(colStart, rowStart) - rowStart) * m_CharWidth;
+            float xEnd = textPos.x + (std::min(colEnd, rowEnd) - rowStart) * m_CharWidth;
             
             drawList->AddRectFilled(
                 ImVec2(xStart, y),
@@ -917,7 +1161,7 @@ void SyntaxEditor::RenderSelection(TextBuffer& buffer, const ImVec2& textPos, fl
             );
         }
         
-        screenRow++;
+        screenRow += breaks.size() + 1;
     }
 }
 
@@ -936,26 +1180,35 @@ void SyntaxEditor::RenderScope(TextBuffer& buffer, const ImVec2& textPos, float
     
     // Build screen row mapping for the render range
     size_t screenRow = 0;
-    for (size_t i = firstLine; i <= drawEndLine; ++i) {
-        if (IsLineHidden(i)) continue;
-        
+    for (size_t i = m_FoldMap.NextVisible(firstLine); i <= drawEndLine; i = m_FoldMap.NextVisible(i + 1)) {
+        const size_t rows = GetLineRows(i);
         if (i >= drawStartLine) {
             float y = textPos.y + screenRow * lineHeight;
+            float yEnd = y + rows * lineHeight;
             
             float xStart = textPos.x;
             float xEnd = textPos.x + ImGui::GetContentRegionAvail().x;
             
-            // Only constrain width on first and last lines for block effect
-            if (i == startLine) xStart += startCol * m_CharWidth;
-            if (i == endLine) xEnd = textPos.x + endCol * m_CharWidth;
+            // Only constrain width on first and last lines for block effect,
+            // and height to the rows they start and end on
+            if (i == startLine) {
+                const auto [row, col] = GetWrapPosition(buffer, i, startCol);
+                xStart += col * m_CharWidth;
+                y += row * lineHeight;
+            }
+            if (i == endLine) {
+                const auto [row, col] = GetWrapPosition(buffer, i, endCol);
+                xEnd = textPos.x + col * m_CharWidth;
+                yEnd = textPos.y + (screenRow + row + 1) * lineHeight;
+            }
             
             // Ensure min width for empty scope or cursor
             if (xEnd <= xStart) xEnd = xStart + m_CharWidth;
             
-            drawList->AddRectFilled(ImVec2(xStart, y), ImVec2(xEnd, y + lineHeight), m_Theme.scopeBackground);
+            drawList->AddRectFilled(ImVec2(xStart, y), ImVec2(xEnd, yEnd), m_Theme.scopeBackground);
         }
         
-        screenRow++;
+        screenRow += rows;
     }
 }
 
@@ -968,11 +1221,8 @@ void SyntaxEditor::RenderIndentGuides(TextBuffer& buffer, const ImVec2& textPos,
     // textPos already includes line number width from Render()
     
     size_t screenRow = 0;
-    for (size_t i = firstLine; i < lastLine; ++i) {
-        // Skip hidden (folded) lines
-        if (IsLineHidden(i)) continue;
-        
-        std::string_view line = buffer.LineView(i);
+    for (size_t i = m_FoldMap.NextVisible(firstLine); i < lastLine; i = m_FoldMap.NextVisible(i + 1)) {
+        std::string_view line = buffer.LineView(m_LineWindow, i);
         size_t indentLevel = 0;
         size_t spaces = 0;
         
@@ -1004,7 +1254,7 @@ void SyntaxEditor::RenderIndentGuides(TextBuffer& buffer, const ImVec2& textPos,
             drawList->AddLine(ImVec2(x, y), ImVec2(x, y + lineHeight), color, 1.0f);
         }
         
-        screenRow++;
+        screenRow += GetLineRows(i);
     }
 }
 
@@ -1026,13 +1276,11 @@ void SyntaxEditor::RenderMatchingBracket(TextBuffer& buffer, const ImVec2& textP
             auto [line, col] = buffer.PosToLineCol(pos);
             if (line < firstLine || IsLineHidden(line)) return;
             
-            // Calculate screen row (accounting for folds)
-            size_t screenRow = 0;
-            for (size_t i = firstLine; i < line; ++i) {
-                if (!IsLineHidden(i)) screenRow++;
-            }
+            // Calculate screen row (accounting for folds and wrapping)
+            const auto [wrapRow, wrapCol] = GetWrapPosition(buffer, line, col);
+            size_t screenRow = GetRowsBetween(firstLine, line) + wrapRow;
             
-            float x = textPos.x + col * m_CharWidth;
+            float x = textPos.x + wrapCol * m_CharWidth;
             float y = textPos.y + screenRow * lineHeight;
             
             drawList->AddRect(
@@ -1050,16 +1298,26 @@ void SyntaxEditor::RenderMatchingBracket(TextBuffer& buffer, const ImVec2& textP
 // Code Folding Implementation
 
 void SyntaxEditor::UpdateFoldRanges(TextBuffer& buffer) {
-    if (!m_FoldRangesDirty) return;
+    const std::vector<FoldRange>& ranges = buffer.GetFoldRanges();
+    if (buffer.GetFoldVersion() == m_FoldVersion) return;
     
-    m_FoldRanges = buffer.GetFoldRanges();
+    m_FoldRanges = ranges;
     m_FoldEndLines.clear();
+    m_FoldedLines.clear();
     
+    // Folded state follows the fold ids, so it survives edits that move a fold
+    std::set<uint32_t> folded;
     for (const auto& range : m_FoldRanges) {
         m_FoldEndLines[range.startLine] = range.endLine;
+        if (m_FoldedIds.count(range.id) || m_PendingFolds.count(range.startLine)) {
+            m_FoldedLines.insert(range.startLine);
+            folded.insert(range.id);
+        }
     }
-    
-    m_FoldRangesDirty = false;
+    m_FoldedIds = std::move(folded);
+    m_FoldMap.Build(m_FoldedLines, m_FoldEndLines);
+    if (buffer.IsParsed()) m_PendingFolds.clear();
+    m_FoldVersion = buffer.GetFoldVersion();
 }
 
 bool SyntaxEditor::IsLineFolded(size_t line) const {
@@ -1067,70 +1325,61 @@ bool SyntaxEditor::IsLineFolded(size_t line) const {
 }
 
 bool SyntaxEditor::IsLineHidden(size_t line) const {
-    // A line is hidden if it's inside any actively folded region (but not the start line)
-    for (size_t foldStart : m_FoldedLines) {
-        auto it = m_FoldEndLines.find(foldStart);
-        if (it != m_FoldEndLines.end()) {
-            // Hidden if: after fold start AND at or before fold end
-            if (line > foldStart && line <= it->second) {
-                return true;
-            }
-        }
-    }
-    return false;
+    return m_FoldMap.IsHidden(line);
 }
 
 size_t SyntaxEditor::ScreenLineToBufferLine(size_t screenLine, size_t maxLine) const {
-    if (m_FoldedLines.empty()) {
-        return screenLine; // No folds, direct mapping
-    }
-    
-    size_t bufferLine = 0;
-    size_t visibleCount = 0;
-    
-    while (bufferLine < maxLine && visibleCount < screenLine) {
-        if (!IsLineHidden(bufferLine)) {
-            visibleCount++;
-        }
-        bufferLine++;
+    if (m_Wrapping) {
+        return std::min(m_Wrap.RowToLine(screenLine).first, maxLine > 0 ? maxLine - 1 : 0);
     }
-    
-    // Find the next visible line at this screen position
-    while (bufferLine < maxLine && IsLineHidden(bufferLine)) {
-        bufferLine++;
+    if (m_FoldMap.Empty()) {
+        return screenLine; // No folds, direct mapping
     }
-    
-    return std::min(bufferLine, maxLine > 0 ? maxLine - 1 : 0);
+    return std::min(m_FoldMap.RowToLine(screenLine), maxLine > 0 ? maxLine - 1 : 0);
 }
 
 size_t SyntaxEditor::BufferLineToScreenLine(size_t bufferLine) const {
-    if (m_FoldedLines.empty()) {
-        return bufferLine; // No folds, direct mapping
-    }
-    
-    size_t screenLine = 0;
-    for (size_t i = 0; i < bufferLine; ++i) {
-        if (!IsLineHidden(i)) {
-            screenLine++;
-        }
-    }
-    return screenLine;
+    return m_Wrapping ? m_Wrap.LineToRow(bufferLine) : m_FoldMap.LineToRow(bufferLine);
 }
 
 size_t SyntaxEditor::GetHiddenLineCount() const {
-    if (m_FoldedLines.empty()) {
-        return 0;
-    }
+    return m_FoldMap.GetHiddenCount();
+}
+
+size_t SyntaxEditor::GetRowsBetween(size_t firstLine, size_t line) const {
+    return line > firstLine ? BufferLineToScreenLine(line) - BufferLineToScreenLine(firstLine) : 0;
+}
+
+size_t SyntaxEditor::GetLineRows(size_t line) const {
+    return m_Wrapping ? m_Wrap.GetLineRows(line) : 1;
+}
+
+const std::vector<size_t>& SyntaxEditor::GetRowBreaks(TextBuffer& buffer, size_t line) {
+    static const std::vector<size_t> NONE;
+    if (GetLineRows(line) <= 1) return NONE;
     
-    size_t hidden = 0;
-    for (size_t foldStart : m_FoldedLines) {
-        auto it = m_FoldEndLines.find(foldStart);
-        if (it != m_FoldEndLines.end()) {
-            // Count lines from (foldStart+1) to foldEnd inclusive
-            hidden += (it->second - foldStart);
-        }
+    RowBreaks& cache = m_RowBreaks;
+    if (cache.lineVersion != buffer.GetLineVersion() || cache.columns != m_WrapColumns || cache.tabSize != m_WrapTabSize) {
+        cache.lineVersion = buffer.GetLineVersion();
+        cache.columns = m_WrapColumns;
+        cache.tabSize = m_WrapTabSize;
+        std::fill(cache.lines.begin(), cache.lines.end(), std::nullopt);
     }
-    return hidden;
+    const bool inView = line >= cache.firstLine && line - cache.firstLine < cache.lines.size();
+    if (inView && cache.lines[line - cache.firstLine]) return *cache.lines[line - cache.firstLine];
+    
+    // Measured as the wrap index and RenderText see the line
+    std::string text = buffer.Line(line);
+    while (!text.empty() && (text.back() == '\n' || text.back() == '\r')) text.pop_back();
+    std::vector<size_t>& breaks = inView ? cache.lines[line - cache.firstLine].emplace() : cache.scratch;
+    WrapIndex::FindBreaks(text, m_WrapColumns, m_WrapTabSize, breaks);
+    return breaks;
+}
+
+std::pair<size_t, size_t> SyntaxEditor::GetWrapPosition(TextBuffer& buffer, size_t line, size_t col) {
+    const std::vector<size_t>& breaks = GetRowBreaks(buffer, line);
+    const size_t row = RowOf(breaks, col);
+    return {row, col - (row > 0 ? breaks[row - 1] : 0)};
 }
 
 bool SyntaxEditor::RenderFoldIndicators(TextBuffer& buffer, const ImVec2& pos, float lineHeight, 
@@ -1144,10 +1393,7 @@ bool SyntaxEditor::RenderFoldIndicators(TextBuffer& buffer, const ImVec2& pos, f
     
     bool clickConsumed = false;
     size_t screenRow = 0;
-    for (size_t i = firstLine; i < lastLine; ++i) {
-        // Skip hidden lines
-        if (IsLineHidden(i)) continue;
-        
+    for (size_t i = m_FoldMap.NextVisible(firstLine); i < lastLine; i = m_FoldMap.NextVisible(i + 1)) {
         // Check if this line starts a foldable region
         auto it = m_FoldEndLines.find(i);
         if (it != m_FoldEndLines.end()) {
@@ -1167,11 +1413,17 @@ bool SyntaxEditor::RenderFoldIndicators(TextBuffer& buffer, const ImVec2& pos, f
                 
                 // Handle click to toggle fold
                 if (ImGui::IsMouseClicked(0)) {
+                    auto range = std::lower_bound(m_FoldRanges.begin(), m_FoldRanges.end(), i, [](const FoldRange& r, size_t line) {
+                        return r.startLine < line;
+                    });
                     if (isFolded) {
                         m_FoldedLines.erase(i);
+                        m_FoldedIds.erase(range->id);
                     } else {
                         m_FoldedLines.insert(i);
+                        m_FoldedIds.insert(range->id);
                     }
+                    m_FoldMap.Build(m_FoldedLines, m_FoldEndLines);
                     clickConsumed = true;  // Prevent text area from also handling this click
                 }
             }
@@ -1188,7 +1440,7 @@ bool SyntaxEditor::RenderFoldIndicators(TextBuffer& buffer, const ImVec2& pos, f
             drawList->AddText(font, fontSize, ImVec2(iconX, iconY), color, icon);
         }
         
-        screenRow++;
+        screenRow += GetLineRows(i);
     }
     
     return clickConsumed;
@@ -1204,7 +1456,7 @@ bool SyntaxEditor::HandleInput(TextBuffer& buffer) {
     if (m_SearchActive) {
         EditorSettings::Get().SetSearch(m_SearchBuf,
             m_SearchCurrentMatch >= 0 ? m_SearchCurrentMatch + 1 : 0,
-            (int)m_SearchMatches.size());
+            (int)m_Search.Matches().size(), m_SearchRegex, m_Search.Error());
     } else {
         EditorSettings::Get().ClearSearch();
     }
@@ -1213,7 +1465,7 @@ bool SyntaxEditor::HandleInput(TextBuffer& buffer) {
     if (isSearchMode) {
         if (ImGui::IsKeyPressed(ImGuiKey_Escape)) {
             m_SearchActive = false;
-            m_SearchMatches.clear();
+            m_Search.Clear();
             m_SearchCurrentMatch = -1;
             inputSystem.SwitchToCommandMode();
             io.InputQueueCharacters.resize(0);
@@ -1231,21 +1483,28 @@ bool SyntaxEditor::HandleInput(TextBuffer& buffer) {
                         (ImGui::IsKeyPressed(ImGuiKey_Tab) && !io.KeyShift);
         bool wantPrev = ImGui::IsKeyPressed(ImGuiKey_UpArrow) ||
                         (ImGui::IsKeyPressed(ImGuiKey_Tab) && io.KeyShift);
-        if (wantNext && !m_SearchMatches.empty()) {
-            m_SearchCurrentMatch = (m_SearchCurrentMatch + 1) % (int)m_SearchMatches.size();
-            m_CursorPos = m_SearchMatches[m_SearchCurrentMatch];
+        if (wantNext && !m_Search.Matches().empty()) {
+            m_SearchCurrentMatch = (m_SearchCurrentMatch + 1) % (int)m_Search.Matches().size();
+            m_CursorPos = m_Search.Matches()[m_SearchCurrentMatch];
             m_NeedsScrollToCursor = true;
             io.InputQueueCharacters.resize(0);
             return true;
         }
-        if (wantPrev && !m_SearchMatches.empty()) {
-            int sz = (int)m_SearchMatches.size();
+        if (wantPrev && !m_Search.Matches().empty()) {
+            int sz = (int)m_Search.Matches().size();
             m_SearchCurrentMatch = (m_SearchCurrentMatch - 1 + sz) % sz;
-            m_CursorPos = m_SearchMatches[m_SearchCurrentMatch];
+            m_CursorPos = m_Search.Matches()[m_SearchCurrentMatch];
             m_NeedsScrollToCursor = true;
             io.InputQueueCharacters.resize(0);
             return true;
         }
+        // Ctrl+R: toggle between literal and regex search
+        if (io.KeyCtrl && ImGui::IsKeyPressed(ImGuiKey_R)) {
+            m_SearchRegex = !m_SearchRegex;
+            UpdateSearchMatches(buffer);
+            io.InputQueueCharacters.resize(0);
+            return true;
+        }
         // Backspace: delete last char from query
         if (ImGui::IsKeyPressed(ImGuiKey_Backspace)) {
             size_t len = strlen(m_SearchBuf);
@@ -1278,7 +1537,7 @@ bool SyntaxEditor::HandleInput(TextBuffer& buffer) {
             if (io.InputQueueCharacters[i] == '/') {
                 m_SearchActive = true;
                 memset(m_SearchBuf, 0, sizeof(m_SearchBuf));
-                m_SearchMatches.clear();
+                m_Search.Clear();
                 m_SearchCurrentMatch = -1;
                 inputSystem.SwitchToSearchMode();
                 io.InputQueueCharacters.resize(0);
@@ -1287,18 +1546,26 @@ bool SyntaxEditor::HandleInput(TextBuffer& buffer) {
         }
     }
 
+    // A count typed in command mode goes to the next macro replay
+    if (isCommandMode) {
+        for (int i = 0; i < io.InputQueueCharacters.Size; ++i) {
+            const ImWchar c = io.InputQueueCharacters[i];
+            if (c >= '0' && c <= '9') m_MacroCount = std::min(m_MacroCount * 10 + (c - '0'), MACRO_MAX_COUNT);
+        }
+    }
+
     // After closing search, navigate with n/N in command mode
-    if (isCommandMode && !m_SearchMatches.empty()) {
+    if (isCommandMode && !m_Search.Matches().empty()) {
         if (ImGui::IsKeyPressed(ImGuiKey_N) && !io.KeyShift) {
-            m_SearchCurrentMatch = (m_SearchCurrentMatch + 1) % (int)m_SearchMatches.size();
-            m_CursorPos = m_SearchMatches[m_SearchCurrentMatch];
+            m_SearchCurrentMatch = (m_SearchCurrentMatch + 1) % (int)m_Search.Matches().size();
+            m_CursorPos = m_Search.Matches()[m_SearchCurrentMatch];
             m_NeedsScrollToCursor = true;
             return true;
         }
         if (ImGui::IsKeyPressed(ImGuiKey_N) && io.KeyShift) {
-            int sz = (int)m_SearchMatches.size();
+            int sz = (int)m_Search.Matches().size();
             m_SearchCurrentMatch = (m_SearchCurrentMatch - 1 + sz) % sz;
-            m_CursorPos = m_SearchMatches[m_SearchCurrentMatch];
+            m_CursorPos = m_Search.Matches()[m_SearchCurrentMatch];
             m_NeedsScrollToCursor = true;
             return true;
         }
@@ -1347,7 +1614,7 @@ bool SyntaxEditor::HandleInput(TextBuffer& buffer) {
     } else {
         // Trigger completion manually
         if (io.KeyCtrl && ImGui::IsKeyPressed(ImGuiKey_Space)) {
-            auto [line, col] = buffer.PosToLineCol(m_CursorPos);
+            auto [line, col] = buffer.PosToLineUtf16Col(m_CursorPos);
             std::string lang = buffer.GetLanguage() ? buffer.GetLanguage()->name : "";
             
             bool hasLSP = LSPManager::GetInstance().HasServerFor(lang);
@@ -1357,7 +1624,7 @@ bool SyntaxEditor::HandleInput(TextBuffer& buffer) {
             if (hasLSP) {
                 reqSent = LSPManager::GetInstance().RequestCompletion(
                     buffer.GetFilePath().string(), 
-                    lang, 
+                    [&buffer] { return buffer.ToString(); },
                     line, col, 
                     [this](const std::vector<LSPCompletionItem>& items) {
                         if (!items.empty()) {
@@ -1380,18 +1647,10 @@ bool SyntaxEditor::HandleInput(TextBuffer& buffer) {
                 }
                 std::string prefix = buffer.Substring(start, m_CursorPos - start);
                 
-                std::vector<std::string> words = buffer.GetWordCompletions(prefix);
+                std::vector<LSPCompletionItem> items = BuiltinCompletions(buffer, prefix, false);
                 
-                if (!words.empty()) {
-                    m_CompletionItems.clear();
-                    for(const auto& w : words) {
-                         LSPCompletionItem item;
-                         item.label = w;
-                         item.kind = 1; // Text
-                         item.insertText = w;
-                         item.detail = "Buffer";
-                         m_CompletionItems.push_back(item);
-                    }
+                if (!items.empty()) {
+                    m_CompletionItems = std::move(items);
                     m_ShowCompletion = true;
                     m_SelectedCompletionIndex = 0;
                 }
@@ -1404,16 +1663,36 @@ bool SyntaxEditor::HandleInput(TextBuffer& buffer) {
     // Build editor state for input mode
     EditorState state;
     state.buffer = &buffer;
-    state.undoTree = &m_UndoTree;
+    state.undoTree = &buffer.GetUndoTree();
     state.cursorPos = m_CursorPos;
     state.selectionStart = m_SelectionStart;
     state.selectionEnd = m_SelectionEnd;
     state.hasSelection = m_HasSelection;
+    state.extraCarets = m_ExtraCarets;
     
     bool modified = false;
     
-    // Handle keyboard input through input manager
-    InputResult result = m_InputManager.HandleKeyboard(state);
+    // Macro keys arrive through keybindings, like command mode navigation
+    InputResult result;
+    const MacroAction macro = inputSystem.ConsumePendingMacro();
+    if (macro == MacroAction::ToggleRecording) {
+        if (m_InputManager.IsRecording()) {
+            m_InputManager.StopRecording();
+        } else {
+            m_InputManager.StartRecording();
+        }
+        m_MacroCount = 0;
+        return true;
+    }
+    if (macro == MacroAction::Replay) {
+        result = m_InputManager.ReplayMacro(state, std::max<size_t>(m_MacroCount, 1));
+        m_MacroCount = 0;
+        m_ShowCompletion = false;
+    } else {
+        // Handle keyboard input through input manager
+        result = m_InputManager.HandleKeyboard(state);
+        if (result.handled) m_MacroCount = 0;
+    }
     
     if (result.handled) {
         if (result.cursorMoved || result.textChanged) {
@@ -1433,11 +1712,14 @@ bool SyntaxEditor::HandleInput(TextBuffer& buffer) {
             if (result.newSelectionEnd) m_SelectionEnd = *result.newSelectionEnd;
             m_HasSelection = m_SelectionStart != m_SelectionEnd;
         }
+        if (result.newExtraCarets) m_ExtraCarets = std::move(*result.newExtraCarets);
         if (result.textChanged) {
             modified = true;
             
             // Update completion when text changed (e.g., backspace)
-            if (m_ShowCompletion && m_CursorPos > 0) {
+            if (m_ShowCompletion && !m_ExtraCarets.empty()) {
+                m_ShowCompletion = false;
+            } else if (m_ShowCompletion && m_CursorPos > 0) {
                 // Find current word prefix at cursor
                 size_t start = m_CursorPos;
                 while (start > 0) {
@@ -1449,30 +1731,10 @@ bool SyntaxEditor::HandleInput(TextBuffer& buffer) {
                 if (m_CursorPos > start) {
                     // Still in a word, update suggestions
                     std::string prefix = buffer.Substring(start, m_CursorPos - start);
-                    std::vector<std::string> words = buffer.GetWordCompletions(prefix);
+                    std::vector<LSPCompletionItem> items = BuiltinCompletions(buffer, prefix, true);
                     
-                    const auto* langPtr = buffer.GetLanguage();
-                    if (langPtr) {
-                        for (const auto& mapping : langPtr->highlightMappings) {
-                            if (mapping.second == HighlightGroup::Keyword || mapping.second == HighlightGroup::Type) {
-                                if (mapping.first.length() > prefix.length() && 
-                                    mapping.first.substr(0, prefix.length()) == prefix) {
-                                    words.push_back(mapping.first);
-                                }
-                            }
-                        }
-                    }
-                    
-                    if (!words.empty()) {
-                        m_CompletionItems.clear();
-                        for (const auto& w : words) {
-                            LSPCompletionItem item;
-                            item.label = w;
-                            item.kind = 1;
-                            item.insertText = w;
-                            item.detail = "Buffer";
-                            m_CompletionItems.push_back(item);
-                        }
+                    if (!items.empty()) {
+                        m_CompletionItems = std::move(items);
                         m_SelectedCompletionIndex = 0;
                     } else {
                         m_ShowCompletion = false;
@@ -1491,7 +1753,6 @@ bool SyntaxEditor::HandleInput(TextBuffer& buffer) {
     
     if (modified) {
         buffer.MarkModified();
-        m_FoldRangesDirty = true;  // Recalculate fold ranges after edit
     }
     return result.handled;
 }
@@ -1505,76 +1766,88 @@ void SyntaxEditor::RenderDiagnostics(TextBuffer& buffer, const ImVec2& textPos,
     // Simple squiggly line rendering
     // A real implementation would use a sine wave or texture
     
+    const DiagnosticStore& diagnostics = buffer.GetDiagnostics();
+    lastLine = std::min(lastLine, buffer.LineCount());
+    if (diagnostics.Empty() || firstLine >= lastLine) return;
+    
+    std::vector<const Diagnostic*> visible;
+    diagnostics.ForRange(buffer.LineStart(firstLine), buffer.LineEnd(lastLine - 1) + 1,
+                         [&visible](const Diagnostic& diag) { visible.push_back(&diag); });
+    
     size_t screenRow = 0;
-    for (size_t line = firstLine; line < lastLine; ++line) {
-        // Skip hidden (folded) lines
-        if (IsLineHidden(line)) continue;
+    for (size_t line = m_FoldMap.NextVisible(firstLine); line < lastLine; line = m_FoldMap.NextVisible(line + 1)) {
+        const size_t lineStart = buffer.LineStart(line);
+        const size_t lineEnd = buffer.LineEnd(line);
+        const std::vector<size_t>& breaks = GetRowBreaks(buffer, line);
         
-        // Since diagnostics are mapped by 0-based line index in syntax_editor
-        if (m_Diagnostics.count(line) > 0) {
-            float y = textPos.y + screenRow * lineHeight + lineHeight; // Bottom of line
+        // Diagnostics spanning lines are underlined on each of them, and on
+        // the row they start on of a wrapped line
+        for (const Diagnostic* diagnostic : visible) {
+            const Diagnostic& diag = *diagnostic;
+            if (diag.start > lineEnd || (diag.end <= lineStart && diag.start < lineStart)) continue;
+            // Calculate X start/end; an empty range marks the character at it
+            size_t startCol = std::max(diag.start, lineStart) - lineStart;
+            size_t endCol = std::max(std::min(diag.end, lineEnd) - lineStart, startCol + 1);
+            const size_t row = RowOf(breaks, startCol);
+            const size_t rowStart = row > 0 ? breaks[row - 1] : 0;
+            if (row < breaks.size()) endCol = std::max(std::min(endCol, breaks[row]), startCol + 1);
             
-            for (const auto& diag : m_Diagnostics[line]) {
-                // Calculate X start/end
-                size_t startCol = diag.range.start.character;
-                size_t endCol = diag.range.end.character;
-                
-                float x1 = textPos.x + startCol * m_CharWidth;
-                float x2 = textPos.x + endCol * m_CharWidth;
-                
-                ImU32 color = m_Theme.error; // Default error
-                if (diag.severity == 2) color = IM_COL32(255, 180, 0, 255); // Warning
-                else if (diag.severity > 2) color = IM_COL32(0, 200, 255, 255); // Info/Hint
+            float x1 = textPos.x + (startCol - rowStart) * m_CharWidth;
+            float x2 = textPos.x + (endCol - rowStart) * m_CharWidth;
+            float y = textPos.y + (screenRow + row) * lineHeight + lineHeight; // Bottom of row
+            
+            ImU32 color = m_Theme.error; // Default error
+            if (diag.severity == 2) color = IM_COL32(255, 180, 0, 255); // Warning
+            else if (diag.severity > 2) color = IM_COL32(0, 200, 255, 255); // Info/Hint
+            
+            // Draw zigzag
+            float x = x1;
+            float zigLen = 3.0f;
+            bool up = true;
+            while (x < x2) {
+                float nextX = std::min(x + zigLen, x2);
+                float yOffset = up ? -2.0f : 0.0f;
+                drawList->AddLine(ImVec2(x, y + (up ? 0 : -2)), ImVec2(nextX, y + (up ? -2 : 0)), color, 1.0f);
+                x = nextX;
+                up = !up;
+            }
+
+            // Hover check
+            if (ImGui::IsWindowHovered() && 
+                mousePos.x >= x1 && mousePos.x <= x2 &&
+                mousePos.y >= y - lineHeight && mousePos.y <= y) {
                 
-                // Draw zigzag
-                float x = x1;
-                float zigLen = 3.0f;
-                bool up = true;
-                while (x < x2) {
-                    float nextX = std::min(x + zigLen, x2);
-                    float yOffset = up ? -2.0f : 0.0f;
-                    drawList->AddLine(ImVec2(x, y + (up ? 0 : -2)), ImVec2(nextX, y + (up ? -2 : 0)), color, 1.0f);
-                    x = nextX;
-                    up = !up;
+                if (!tooltipShown) {
+                    ImGui::BeginTooltip();
+                    ImGui::PushTextWrapPos(ImGui::GetFontSize() * 16.0f);
+                    tooltipShown = true;
+                } else {
+                    ImGui::Separator();
                 }
 
-                // Hover check
-                if (ImGui::IsWindowHovered() && 
-                    mousePos.x >= x1 && mousePos.x <= x2 &&
-                    mousePos.y >= y - lineHeight && mousePos.y <= y) {
-                    
-                    if (!tooltipShown) {
-                        ImGui::BeginTooltip();
-                        ImGui::PushTextWrapPos(ImGui::GetFontSize() * 16.0f);
-                        tooltipShown = true;
-                    } else {
-                        ImGui::Separator();
-                    }
-
-                    ImVec4 titleColor = ImVec4(1, 1, 1, 1);
-                    const char* title = "Diagnostic";
-                    
-                    if (diag.severity == 1) {
-                        title = "Error";
-                        titleColor = ImVec4(1.0f, 0.4f, 0.4f, 1.0f);
-                    } else if (diag.severity == 2) {
-                        title = "Warning";
-                        titleColor = ImVec4(1.0f, 0.8f, 0.2f, 1.0f);
-                    } else if (diag.severity == 3) {
-                        title = "Info";
-                        titleColor = ImVec4(0.4f, 0.8f, 1.0f, 1.0f);
-                    } else {
-                        title = "Hint";
-                        titleColor = ImVec4(0.6f, 0.6f, 0.6f, 1.0f);
-                    }
-                    
-                    ImGui::TextColored(titleColor, "%s", title);
-                    ImGui::TextWrapped("%s", diag.message.c_str());
+                ImVec4 titleColor = ImVec4(1, 1, 1, 1);
+                const char* title = "Diagnostic";
+                
+                if (diag.severity == 1) {
+                    title = "Error";
+                    titleColor = ImVec4(1.0f, 0.4f, 0.4f, 1.0f);
+                } else if (diag.severity == 2) {
+                    title = "Warning";
+                    titleColor = ImVec4(1.0f, 0.8f, 0.2f, 1.0f);
+                } else if (diag.severity == 3) {
+                    title = "Info";
+                    titleColor = ImVec4(0.4f, 0.8f, 1.0f, 1.0f);
+                } else {
+                    title = "Hint";
+                    titleColor = ImVec4(0.6f, 0.6f, 0.6f, 1.0f);
                 }
+                
+                ImGui::TextColored(titleColor, "%s", title);
+                ImGui::TextWrapped("%s", diag.message.c_str());
             }
         }
         
-        screenRow++;
+        screenRow += breaks.size() + 1;
     }
 
     if (tooltipShown) {
@@ -1583,6 +1856,16 @@ void SyntaxEditor::RenderDiagnostics(TextBuffer& buffer, const ImVec2& textPos,
     }
 }
 
+void SyntaxEditor::ShowCompletionItems(std::vector<LSPCompletionItem> items) {
+    if (!items.empty()) {
+        m_CompletionItems = std::move(items);
+        m_ShowCompletion = true;
+        m_SelectedCompletionIndex = 0;
+    } else if (m_CompletionItems.empty()) {
+        m_ShowCompletion = false;
+    }
+}
+
 void SyntaxEditor::RenderCompletion(TextBuffer& buffer, const ImVec2& cursorScreenPos, const ImVec4& bufferRect, float lineHeight) {
     if (m_CompletionItems.empty()) return;
 
@@ -1692,68 +1975,68 @@ void SyntaxEditor::RenderCompletion(TextBuffer& buffer, const ImVec2& cursorScre
 }
 
 void SyntaxEditor::UpdateSearchMatches(TextBuffer& buffer) {
-    m_SearchMatches.clear();
     m_SearchCurrentMatch = -1;
+    m_SearchOrigin = m_CursorPos;
 
-    const size_t queryLen = strlen(m_SearchBuf);
-    if (queryLen == 0) return;
-
-    std::string content = buffer.Substring(0, buffer.Length());
-    std::string lowerContent = content;
-    std::string lowerQuery(m_SearchBuf, queryLen);
-    std::transform(lowerContent.begin(), lowerContent.end(), lowerContent.begin(), ::tolower);
-    std::transform(lowerQuery.begin(), lowerQuery.end(), lowerQuery.begin(), ::tolower);
-
-    size_t pos = 0;
-    while ((pos = lowerContent.find(lowerQuery, pos)) != std::string::npos) {
-        m_SearchMatches.push_back(pos);
-        pos += queryLen;
-    }
+    // Matches on screen are found now, the rest of the buffer in the background
+    const size_t lineCount = buffer.LineCount();
+    const size_t windowStart = buffer.LineStart(std::min(m_FirstVisibleLine, lineCount - 1));
+    const size_t windowEnd = m_LastVisibleLine < lineCount ? buffer.LineStart(m_LastVisibleLine) : buffer.Length();
+    m_Search.Start(buffer.Snapshot(), m_SearchBuf, m_SearchRegex, windowStart, windowEnd);
+    SelectSearchMatch(m_SearchOrigin);
+}
 
-    if (!m_SearchMatches.empty()) {
-        // Jump to first match at or after cursor
-        m_SearchCurrentMatch = 0;
-        for (int i = 0; i < (int)m_SearchMatches.size(); ++i) {
-            if (m_SearchMatches[i] >= m_CursorPos) {
-                m_SearchCurrentMatch = i;
-                break;
-            }
-        }
-        m_CursorPos = m_SearchMatches[m_SearchCurrentMatch];
-        m_NeedsScrollToCursor = true;
-    }
+// Jumps to the first match at or after from, wrapping to the first one
+void SyntaxEditor::SelectSearchMatch(size_t from) {
+    const std::vector<size_t>& matches = m_Search.Matches();
+    if (matches.empty()) return;
+    auto it = std::lower_bound(matches.begin(), matches.end(), from);
+    m_SearchCurrentMatch = it == matches.end() ? 0 : static_cast<int>(it - matches.begin());
+    m_CursorPos = matches[m_SearchCurrentMatch];
+    m_NeedsScrollToCursor = true;
 }
 
 void SyntaxEditor::RenderSearchHighlights(TextBuffer& buffer, ImDrawList* drawList,
     ImVec2 textPos, float lineHeight, size_t firstLine, size_t lastLine) {
-    const size_t queryLen = strlen(m_SearchBuf);
-    if (queryLen == 0) return;
+    if (firstLine >= lastLine) return;
 
     const ImU32 hlColor      = IM_COL32(255, 200, 0, 60);   // all matches
     const ImU32 hlColorCur   = IM_COL32(255, 180, 0, 140);  // current match
 
-    for (int i = 0; i < (int)m_SearchMatches.size(); ++i) {
-        size_t matchPos = m_SearchMatches[i];
-        auto [matchLine, matchCol] = buffer.PosToLineCol(matchPos);
-        if (matchLine < firstLine || matchLine >= lastLine) continue;
-        if (IsLineHidden(matchLine)) continue;
-
-        // Calculate screen row (accounting for folds)
-        size_t screenRow = 0;
-        for (size_t l = firstLine; l < matchLine; ++l) {
-            if (!IsLineHidden(l)) screenRow++;
+    const std::vector<size_t>& matches = m_Search.Matches();
+    const size_t rangeEnd = lastLine < buffer.LineCount() ? buffer.LineStart(lastLine) : buffer.Length();
+    size_t line = firstLine;
+    size_t lineStart = buffer.LineStart(firstLine);
+    size_t lineEnd = buffer.LineEnd(firstLine);
+    size_t screenRow = 0;  // Row of line, accounting for folds
+    for (auto it = std::lower_bound(matches.begin(), matches.end(), lineStart);
+         it != matches.end() && *it < rangeEnd; ++it) {
+        const size_t matchPos = *it;
+        while (matchPos > lineEnd) {
+            if (!IsLineHidden(line)) screenRow += GetLineRows(line);
+            ++line;
+            lineStart = buffer.LineStart(line);
+            lineEnd = buffer.LineEnd(line);
         }
+        if (IsLineHidden(line)) continue;
 
-        float x = textPos.x + matchCol * m_CharWidth;
-        float y = textPos.y + screenRow * lineHeight;
-        float w = queryLen * m_CharWidth;
+        const size_t index = static_cast<size_t>(it - matches.begin());
+        const bool current = static_cast<int>(index) == m_SearchCurrentMatch;
+        // Matches spanning lines or wrapped rows are marked on their first one
+        const std::vector<size_t>& breaks = GetRowBreaks(buffer, line);
+        const size_t row = RowOf(breaks, matchPos - lineStart);
+        const size_t rowStart = lineStart + (row > 0 ? breaks[row - 1] : 0);
+        const size_t rowEnd = row < breaks.size() ? lineStart + breaks[row] : lineEnd;
+        const size_t matchEnd = std::max(std::min(m_Search.MatchEnd(index), rowEnd), matchPos + 1);
+        float x = textPos.x + (matchPos - rowStart) * m_CharWidth;
+        float y = textPos.y + (screenRow + row) * lineHeight;
+        float w = (matchEnd - matchPos) * m_CharWidth;
         float h = ImGui::GetTextLineHeight();
 
-        ImU32 color = (i == m_SearchCurrentMatch) ? hlColorCur : hlColor;
-        drawList->AddRectFilled(ImVec2(x, y), ImVec2(x + w, y + h), color);
+        drawList->AddRectFilled(ImVec2(x, y), ImVec2(x + w, y + h), current ? hlColorCur : hlColor);
 
         // Current match: draw an outline
-        if (i == m_SearchCurrentMatch) {
+        if (current) {
             drawList->AddRect(ImVec2(x, y), ImVec2(x + w, y + h),
                               IM_COL32(255, 200, 60, 220), 0.f, 0, 1.5f);
         }
@@ -1,18 +1,24 @@
 #pragma once
 
 #include "core/text/text_buffer.h"
-#include "core/text/undo_tree.h"
+#include "core/text/fold_map.h"
+#include "core/text/wrap_index.h"
+#include "core/text/line_window.h"
+#include "core/text/minimap_cache.h"
+#include "core/text/text_search.h"
 #include "ui/input/input_manager.h"
 #include "core/lsp/lsp_types.h"
+#include "core/cancellation.h"
 #include <imgui.h>
+#include <array>
 #include <memory>
 #include <string>
 #include <vector>
 #include <unordered_map>
 #include <map>
-#include <set>
-#include <mutex>
 #include <optional>
+#include <set>
+#include <span>
 
 namespace sol {
 
@@ -68,7 +74,7 @@ struct SyntaxTheme {
 class SyntaxEditor {
 public:
     SyntaxEditor();
-    ~SyntaxEditor() = default;
+    ~SyntaxEditor() { m_CompletionCancel.Cancel(); }
     
     // Render the editor - returns true if content was modified
     bool Render(const char* label, TextBuffer& buffer, const ImVec2& size = ImVec2(0, 0));
@@ -82,34 +88,55 @@ public:
     // Input mode
     InputManager& GetInputManager() { return m_InputManager; }
     
-    // Undo/Redo tree
-    UndoTree& GetUndoTree() { return m_UndoTree; }
-    
     // State
     size_t GetCursorPos() const { return m_CursorPos; }
-    void SetCursorPos(size_t pos) { m_CursorPos = pos; }
+    void SetCursorPos(size_t pos) { m_CursorPos = pos; m_ExtraCarets.clear(); m_NeedsScrollToCursor = true; }
+    // Places the cursor once the buffer has loaded the line, without waiting
+    // for the rest of the file; moving the cursor or showing another buffer
+    // first drops the jump
+    void JumpTo(const TextBuffer& buffer, size_t line, size_t column) {
+        m_PendingJump = PendingJump{&buffer, line, column, m_CursorPos};
+    }
+    // Line and column of the cursor, or of the jump still waiting for its line
+    std::pair<size_t, size_t> GetCursorLineCol(const TextBuffer& buffer) const;
+    // Start lines of the folded regions; regions set before the buffer is
+    // parsed fold once its fold ranges arrive
+    const std::set<size_t>& GetFoldedLines() const { return m_FoldedLines; }
+    void SetFoldedLines(std::set<size_t> lines) { m_PendingFolds = std::move(lines); m_FoldVersion = 0; }
     
     void Focus() { m_WantsFocus = true; }
     void SetWindowActive(bool active) { m_IsWindowActive = active; }
-
-    void UpdateDiagnostics(const std::string& path, const std::vector<LSPDiagnostic>& diagnostics);
     
 private:
+    void ApplyPendingJump(const TextBuffer& buffer);
     bool HandleInput(TextBuffer& buffer);
     void HandleTextInput(TextBuffer& buffer);
     void RenderCompletion(TextBuffer& buffer, const ImVec2& cursorScreenPos, const ImVec4& bufferRect, float lineHeight);
+    // Server results replace the shown items; an empty answer keeps local ones
+    void ShowCompletionItems(std::vector<LSPCompletionItem> items);
+    // Buffer words, then optionally language keywords, then workspace symbols
+    std::vector<LSPCompletionItem> BuiltinCompletions(TextBuffer& buffer, const std::string& prefix, bool withKeywords) const;
     void RenderDiagnostics(TextBuffer& buffer, const ImVec2& textPos, float lineHeight, size_t firstLine, size_t lastLine);
 
     void RenderLineNumbers(TextBuffer& buffer, const ImVec2& pos, float lineHeight, size_t firstLine, size_t lastLine);
     void RenderText(TextBuffer& buffer, const ImVec2& pos, float lineHeight, size_t firstLine, size_t lastLine);
     void RenderSpan(ImDrawList* drawList, std::string_view lineText, size_t start, size_t end, float& x, float y, ImU32 color);
-    void RenderCursor(TextBuffer& buffer, const ImVec2& textPos, float lineHeight, size_t firstLine);
-    void RenderSelection(TextBuffer& buffer, const ImVec2& textPos, float lineHeight, size_t firstLine, size_t lastLine);
+    // Quads straight from the glyph cache for a printable ASCII line
+    void RenderGlyphs(ImDrawList* drawList, std::string_view lineText, size_t begin, size_t end,
+                      std::span<const HighlightSpan> spans, float& x, float y);
+    ImU32 SpanColor(const HighlightSpan& span) const;
+    void ValidateGlyphCache();
+    // Every cursor on the lines in view
+    void RenderCursor(TextBuffer& buffer, const ImVec2& textPos, float lineHeight, size_t firstLine, size_t lastLine);
+    void RenderSelection(TextBuffer& buffer, const ImVec2& textPos, float lineHeight, size_t firstLine, size_t lastLine,
+                         size_t selStart, size_t selEnd);
     
     // New features
     void RenderScope(TextBuffer& buffer, const ImVec2& pos, float lineHeight, size_t firstLine, size_t lastLine);
     void RenderIndentGuides(TextBuffer& buffer, const ImVec2& pos, float lineHeight, size_t firstLine, size_t lastLine);
     void RenderMatchingBracket(TextBuffer& buffer, const ImVec2& pos, float lineHeight, size_t firstLine);
+    // Returns true while the minimap has the mouse
+    bool RenderMinimap(TextBuffer& buffer, const ImVec2& min, const ImVec2& max, float lineHeight, size_t firstLine, size_t lastLine);
     
     // Code folding
     bool RenderFoldIndicators(TextBuffer& buffer, const ImVec2& pos, float lineHeight, size_t firstLine, size_t lastLine);  // Returns true if click was consumed
@@ -119,6 +146,14 @@ private:
     size_t ScreenLineToBufferLine(size_t screenLine, size_t maxLine) const;  // Convert visible row to buffer line
     size_t BufferLineToScreenLine(size_t bufferLine) const;  // Convert buffer line to visible row
     size_t GetHiddenLineCount() const;          // Count of lines hidden by folds
+    size_t GetRowsBetween(size_t firstLine, size_t line) const;  // Visible rows from firstLine up to line
+    
+    // Soft wrap
+    size_t GetLineRows(size_t line) const;      // Rows line takes, 1 unless it wraps
+    // Byte offsets where the rows of line after the first start; empty unless it wraps
+    const std::vector<size_t>& GetRowBreaks(TextBuffer& buffer, size_t line);
+    // Row of col within line, and the column within that row
+    std::pair<size_t, size_t> GetWrapPosition(TextBuffer& buffer, size_t line, size_t col);
 
     void RenderStatusLine(TextBuffer& buffer, const ImVec2& pos, float width);
     
@@ -133,7 +168,6 @@ private:
     
     // Input handling
     InputManager m_InputManager;
-    UndoTree m_UndoTree;
     
     // Cursor and selection state
     size_t m_CursorPos = 0;
@@ -141,6 +175,10 @@ private:
     size_t m_SelectionEnd = 0;
     bool m_HasSelection = false;
     bool m_IsDragging = false;
+    std::vector<Caret> m_ExtraCarets;    // Cursors besides m_CursorPos, each with its own selection
+    bool m_ColumnSelecting = false;      // Alt+Shift drag: one cursor per line from the anchor cell
+    size_t m_ColumnAnchorLine = 0;
+    size_t m_ColumnAnchorCol = 0;
     
     // Scroll state
     float m_ScrollX = 0.0f;
@@ -153,25 +191,69 @@ private:
     bool m_IsWindowActive = false;  // Set by WindowTree - only active window shows cursor
     bool m_WantsFocus = false;
     float m_CharWidth = 0.0f;
+
+    // Printable ASCII glyphs of the current font; monospace when each
+    // advances exactly m_CharWidth, so a column maps straight to its x
+    struct GlyphCache {
+        const ImFont* font = nullptr;
+        const void* glyphData = nullptr;  // Changes when the atlas is rebuilt
+        float size = 0.0f;
+        float scale = 1.0f;
+        bool monospace = false;
+        std::array<ImFontGlyph, 128> glyphs{};
+    };
+    GlyphCache m_Glyphs;
     
     // Completion state
     bool m_ShowCompletion = false;
     std::vector<LSPCompletionItem> m_CompletionItems;
     int m_SelectedCompletionIndex = 0;
-    
-    // Thread-safe pending completion from LSP (written from background, read on main)
-    std::mutex m_PendingCompletionMutex;
-    std::optional<std::vector<LSPCompletionItem>> m_PendingCompletionItems;
-    
-    // Diagnostics state
-    std::string m_LastDiagnosticsPath;
-    std::map<size_t, std::vector<LSPDiagnostic>> m_Diagnostics;
+    CancellationSource m_CompletionCancel;  // Of the server request in flight
     
     // Code folding state
     std::set<size_t> m_FoldedLines;              // Set of start lines that are folded
     std::vector<FoldRange> m_FoldRanges;         // Cached fold ranges from tree-sitter
     std::map<size_t, size_t> m_FoldEndLines;     // Map: startLine -> endLine for quick lookup
-    bool m_FoldRangesDirty = true;               // Flag to recalculate fold ranges
+    std::set<uint32_t> m_FoldedIds;              // FoldRange ids of the folded lines
+    std::set<size_t> m_PendingFolds;             // Start lines to fold once ranges exist
+    
+    struct PendingJump {
+        const TextBuffer* buffer;
+        size_t line;
+        size_t column;
+        size_t cursor;  // Where the cursor was when the jump was asked for
+    };
+    std::optional<PendingJump> m_PendingJump;
+    uint64_t m_FoldVersion = 0;                  // Buffer fold version the caches above reflect
+    FoldMap m_FoldMap;                           // Lines m_FoldedLines hides
+    
+    // Soft wrap state; the index maps lines to rows whenever wrapping, folds
+    // included, and the breaks of the lines in view are kept until they change
+    bool m_Wrapping = false;
+    size_t m_WrapColumns = 0;
+    size_t m_WrapTabSize = 0;
+    WrapIndex m_Wrap;
+    struct RowBreaks {
+        uint64_t lineVersion = UINT64_MAX;
+        size_t columns = 0;
+        size_t tabSize = 0;
+        size_t firstLine = 0;
+        std::vector<std::optional<std::vector<size_t>>> lines;  // From firstLine, each once measured
+        std::vector<size_t> scratch;                             // For a line out of view
+    };
+    RowBreaks m_RowBreaks;
+    LineWindow m_LineWindow;  // Lines around the view of a large buffer
+    
+    // Minimap, a cell per pixel across and rows rebuilt a budget per frame
+    MinimapCache m_Minimap;
+    bool m_MinimapDragging = false;
+    static constexpr float MINIMAP_WIDTH = 100.0f;
+    static constexpr float MINIMAP_MAX_ROW_HEIGHT = 2.0f;
+    static constexpr size_t MINIMAP_ROWS_PER_FRAME = 256;
+    
+    // Count typed in Command mode before a macro replay
+    size_t m_MacroCount = 0;
+    static constexpr size_t MACRO_MAX_COUNT = 1000000;
 
     // Blink timer for cursor
     float m_CursorBlinkTimer = 0.0f;
@@ -180,10 +262,15 @@ private:
     // In-buffer search state
     bool m_SearchActive = false;
     char m_SearchBuf[256] = {};
-    std::vector<size_t> m_SearchMatches;
+    bool m_SearchRegex = false;
+    TextSearch m_Search;
     int m_SearchCurrentMatch = -1;
+    size_t m_FirstVisibleLine = 0;  // Buffer lines drawn last frame
+    size_t m_LastVisibleLine = 0;
+    size_t m_SearchOrigin = 0;      // Cursor when the query last changed
 
     void UpdateSearchMatches(TextBuffer& buffer);
+    void SelectSearchMatch(size_t from);
     void RenderSearchHighlights(TextBuffer& buffer, ImDrawList* drawList, ImVec2 textPos, float lineHeight, size_t firstLine, size_t lastLine);
 };
 
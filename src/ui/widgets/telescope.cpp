@@ -1,19 +1,26 @@
 #include "telescope.h"
 #include "core/logger.h"
 #include "core/job_system.h"
+#include "core/parallel.h"
+#include "core/file_watcher.h"
+#include "core/symbol_index.h"
+#include "core/platform/mapped_file.h"
+#include "core/text/text_scan.h"
+#include "core/fuzzy_match.h"
+#include "core/text/text_buffer.h"
+#include "ui/editor_settings.h"
+#include "ui/widgets/syntax_editor.h"
 #include <imgui.h>
 #include <imgui_internal.h>
 #include <algorithm>
-#include <fstream>
-#include <cctype>
+#include <optional>
 
 namespace sol {
 
-TelescopeWidget::TelescopeWidget() = default;
+TelescopeWidget::TelescopeWidget(FileIndex& fileIndex)
+    : m_FileIndex(fileIndex) {}
 
-TelescopeWidget::~TelescopeWidget() {
-    CancelScan();
-}
+TelescopeWidget::~TelescopeWidget() = default;
 
 void TelescopeWidget::Open(const std::filesystem::path& rootDir) {
     m_Open = true;
@@ -22,9 +29,9 @@ void TelescopeWidget::Open(const std::filesystem::path& rootDir) {
     m_LastQuery.clear();
     m_SelectedIdx = 0;
     m_Results.clear();
-    m_PreviewPath.clear();
-    m_PreviewLines.clear();
-    m_PreviewIsBinary = false;
+    m_PreviewKey.clear();
+    m_Preview.reset();
+    m_PreviewCache.clear();  // Files may have changed since the last session
     m_FilterDirty = true;
 
     // Normalize to avoid trailing-slash / symlink mismatches
@@ -35,307 +42,432 @@ void TelescopeWidget::Open(const std::filesystem::path& rootDir) {
         canonical = rootDir;
     }
 
-    if (canonical != m_RootDir || m_AllFiles.empty()) {
-        m_RootDir = canonical;
-        StartScan(canonical);
+    m_RootDir = canonical;
+    m_FileIndex.SetRoot(canonical);
+    // Without change notifications the indexes only learn about edits by rescanning
+    if (!FileWatcher::GetInstance().IsWatching()) {
+        m_FileIndex.Refresh();
+        SymbolIndex::GetInstance().Refresh();
     }
 }
 
 void TelescopeWidget::Close() {
     m_Open = false;
+    m_QueryCancel.Cancel();
+    m_PreviewCancel.Cancel();
 }
 
-void TelescopeWidget::CancelScan() {
-    m_ScanCancelled.store(true);
-    if (m_ScanThread.joinable())
-        m_ScanThread.join();
-    m_ScanCancelled.store(false);
-}
-
-void TelescopeWidget::StartScan(const std::filesystem::path& rootDir) {
-    CancelScan();
-
-    {
-        std::lock_guard<std::mutex> lk(m_FilesMutex);
-        m_AllFiles.clear();
+using Ranked = std::pair<int, size_t>;  // (score, file index), smaller ranks first
+
+// Keeps the limit best items as a max-heap so the worst is the one replaced
+static void PushBounded(std::vector<Ranked>& heap, Ranked item, size_t limit) {
+    if (heap.size() < limit) {
+        heap.push_back(item);
+        std::push_heap(heap.begin(), heap.end());
+    } else if (item < heap.front()) {
+        std::pop_heap(heap.begin(), heap.end());
+        heap.back() = item;
+        std::push_heap(heap.begin(), heap.end());
     }
-
-    m_Scanning.store(true);
-    m_ScanThread = std::thread([this, rootDir]() {
-        static const std::vector<std::string> s_IgnoreDirs = {
-            ".git", ".svn", ".hg", "node_modules", ".cache", "__pycache__",
-            "build", "out", "dist", ".idea", ".vscode",
-        };
-
-        std::vector<std::filesystem::path> collected;
-        collected.reserve(4096);
-
-        try {
-            std::filesystem::recursive_directory_iterator it(
-                rootDir,
-                std::filesystem::directory_options::skip_permission_denied
-            );
-            std::filesystem::recursive_directory_iterator end;
-
-            for (; it != end && !m_ScanCancelled.load(); ++it) {
-                const auto& entry = *it;
-
-                if (entry.is_directory()) {
-                    const std::string name = entry.path().filename().string();
-                    if (!name.empty() && name[0] == '.') {
-                        it.disable_recursion_pending();
-                        continue;
-                    }
-                    for (const auto& ig : s_IgnoreDirs) {
-                        if (name == ig) {
-                            it.disable_recursion_pending();
-                            break;
-                        }
-                    }
-                    continue;
-                }
-
-                if (entry.is_regular_file()) {
-                    const std::string fname = entry.path().filename().string();
-                    if (!fname.empty() && fname[0] == '.') continue;
-                    collected.push_back(entry.path());
-                    if ((int)collected.size() >= MAX_FILES) break;
-                }
-            }
-        } catch (...) {}
-
-        if (!m_ScanCancelled.load()) {
-            std::lock_guard<std::mutex> lk(m_FilesMutex);
-            m_AllFiles = std::move(collected);
-            m_FilterDirty = true;  // re-run filter now that files are available
-        }
-        m_Scanning.store(false);
-    });
 }
 
-// Tiered score (lower = better, INT_MAX = no match).
-// Tiers for filename matches:
-//   0        : exact
-//   1000+    : prefix
-//   2000+    : substring (position + length)
-//   3000+    : fuzzy (all chars in order, scored by gap penalty & consecutive bonus)
-// Path-only matches start at 10000 with the same sub-tiers.
-int TelescopeWidget::ScoreMatch(const std::string& fname, const std::string& relPath,
-                                const std::string& lowerQuery) {
-    if (lowerQuery.empty()) return 0;
-
-    auto makeLower = [](const std::string& s) {
-        std::string r = s;
-        for (char& c : r) c = (char)std::tolower((unsigned char)c);
-        return r;
-    };
-
-    const std::string lf   = makeLower(fname);
-    const std::string lrel = makeLower(relPath);
-    const int qlen = (int)lowerQuery.size();
-
-    // Fuzzy score helper: greedy match all query chars in order.
-    // Rewards consecutive runs heavily, penalizes gaps.
-    // Returns INT_MAX if not all chars matched.
-    auto fuzzyScore = [&](const std::string& text) -> int {
-        const int tlen = (int)text.size();
-        int qi = 0, last = -1;
-        int gap = 0, consecutive = 0;
-        for (int ti = 0; ti < tlen && qi < qlen; ++ti) {
-            if (text[ti] == lowerQuery[qi]) {
-                if (last != -1 && ti == last + 1)
-                    ++consecutive;
-                else if (last != -1)
-                    gap += ti - last - 1;
-                last = ti;
-                ++qi;
-            }
-        }
-        if (qi < qlen) return INT_MAX;
-        // Lower is better: penalize gaps, reward consecutive runs
-        return gap * 8 - consecutive * 12 + (tlen - qlen);
-    };
-
-    // --- filename tiers ---
-    if (lf == lowerQuery)                                return 0;
-    if (qlen < (int)lf.size() && lf.substr(0, qlen) == lowerQuery)
-        return 1000 + (int)lf.size();
-    {
-        auto pos = lf.find(lowerQuery);
-        if (pos != std::string::npos)
-            return 2000 + (int)pos + (int)lf.size();
-    }
-    {
-        int s = fuzzyScore(lf);
-        if (s != INT_MAX) return 3000 + s;
-    }
-
-    // --- path tiers (only reached when no filename match) ---
-    if (lrel == lowerQuery)                              return 10000;
-    if (qlen < (int)lrel.size() && lrel.substr(0, qlen) == lowerQuery)
-        return 11000 + (int)lrel.size();
-    {
-        auto pos = lrel.find(lowerQuery);
-        if (pos != std::string::npos)
-            return 12000 + (int)pos + (int)lrel.size();
-    }
-    {
-        int s = fuzzyScore(lrel);
-        if (s != INT_MAX) return 13000 + s;
-    }
-
-    return INT_MAX;
+struct TelescopeWidget::FilterPass {
+    std::shared_ptr<const FileList> files;
+    std::string query;
+    uint32_t generation = 0;
+    CancellationToken cancel;
+};
+
+uint32_t TelescopeWidget::BeginQuery() {
+    m_QueryCancel.Cancel();
+    m_QueryCancel = CancellationSource();
+    return ++m_FilterGeneration;
 }
 
-void TelescopeWidget::SwapPendingResults() {
-    if (!m_PendingReady.load(std::memory_order_acquire)) return;
-    std::lock_guard<std::mutex> lk(m_PendingMutex);
-    // Only accept if this is still the latest generation
-    if (m_PendingGeneration == m_FilterGeneration.load()) {
-        m_Results = std::move(m_PendingResults);
+void TelescopeWidget::ShowResults(uint32_t generation, std::vector<TelescopeEntry> results) {
+    if (generation == m_ResultsGeneration) {
+        // Another streamed batch of the grep already on screen
+        m_Results.insert(m_Results.end(), std::make_move_iterator(results.begin()),
+                         std::make_move_iterator(results.end()));
+    } else {
+        m_Results = std::move(results);
+        m_ResultsGeneration = generation;
         m_SelectedIdx = 0;
     }
-    m_PendingResults.clear();
-    m_PendingReady.store(false, std::memory_order_release);
 }
 
 void TelescopeWidget::SubmitFilterJob() {
+    std::shared_ptr<const FileList> files = m_FileIndex.Files();
+    if (files && files->Root() != m_RootDir) files.reset();
+    if (files != m_Files) {
+        m_Files = files;
+        m_FilterDirty.store(true, std::memory_order_relaxed);
+    }
+
     std::string query(m_QueryBuf);
     if (query == m_LastQuery && !m_FilterDirty.load(std::memory_order_relaxed)) return;
     m_LastQuery  = query;
     m_FilterDirty.store(false, std::memory_order_relaxed);
+    m_Grep.reset();
 
-    // Snapshot files under lock — cheap, just copies pointers
-    std::vector<std::filesystem::path> files;
-    {
-        std::lock_guard<std::mutex> lk(m_FilesMutex);
-        files = m_AllFiles;
+    if (query.starts_with('#')) {
+        SubmitSymbolJob(query.substr(1));
+        return;
+    }
+    if (query.starts_with('>')) {
+        SubmitGrepJob(query.substr(1));
+        return;
     }
 
-    if (files.empty() && m_Scanning.load()) return;  // not ready yet, will retry when scan finishes
+    if (!files) return;  // not ready yet, will retry when the index publishes
 
-    const uint32_t gen    = m_FilterGeneration.fetch_add(1) + 1;
-    const std::filesystem::path rootDir = m_RootDir;
+    FilterPass pass{std::move(files), query, BeginQuery(), m_QueryCancel.Token()};
+    JobSystem::Submit(JobPriority::Interactive, pass.cancel, [this, pass = std::move(pass)] {
+        FilterFiles(pass);
+    });
+}
 
-    std::string lowerQuery = query;
-    for (char& c : lowerQuery) c = (char)std::tolower((unsigned char)c);
+// Chunks of the list keep their own top MAX_RESULTS, merged into one;
+// entries are built only for those shown
+void TelescopeWidget::FilterFiles(const FilterPass& pass) {
+    const FileList& files = *pass.files;
+    auto rank = [&](size_t begin, size_t end) {
+        std::vector<Ranked> best;
+        if (pass.cancel.IsCancelled()) return best;
+        FuzzyMatcher matcher(pass.query);
+        for (size_t i = begin; i < end; ++i) {
+            const int score = matcher.Score(files.FoldedName(i), files.FoldedDirectory(i), files.Mask(i));
+            if (score != INT_MAX) PushBounded(best, {score, i}, MAX_RESULTS);
+        }
+        return best;
+    };
+    auto merge = [](std::vector<Ranked> best, std::vector<Ranked> chunk) {
+        for (Ranked item : chunk) PushBounded(best, item, MAX_RESULTS);
+        return best;
+    };
+    std::vector<Ranked> best = ParallelReduce(0, files.Size(), FILTER_CHUNK, std::vector<Ranked>(), rank, merge);
+    if (pass.cancel.IsCancelled()) return;
 
-    auto job = std::make_shared<Job>([this, files = std::move(files), lowerQuery, rootDir, gen](const JobData&) -> bool {
-        std::vector<TelescopeEntry> results;
-        results.reserve(std::min((int)files.size(), MAX_RESULTS * 2));
-
-        for (const auto& path : files) {
-            std::string rel;
-            try {
-                rel = std::filesystem::relative(path, rootDir).string();
-            } catch (...) {
-                rel = path.filename().string();
-            }
+    std::sort(best.begin(), best.end());
+    std::vector<TelescopeEntry> results;
+    results.reserve(best.size());
+    for (const auto& [score, i] : best)
+        results.push_back({files.FullPath(i), files.RelativePath(i), score});
 
-            int score;
-            if (lowerQuery.empty()) {
-                score = 0;
-            } else {
-                score = ScoreMatch(path.filename().string(), rel, lowerQuery);
-                if (score == INT_MAX) continue;
-            }
+    JobSystem::DispatchToMain(pass.cancel, [this, gen = pass.generation, results = std::move(results)]() mutable {
+        ShowResults(gen, std::move(results));
+    });
+}
 
-            results.push_back({path, rel, score});
-        }
+static const char* SymbolKindName(SymbolKind kind) {
+    switch (kind) {
+        case SymbolKind::Function:  return "function";
+        case SymbolKind::Method:    return "method";
+        case SymbolKind::Class:     return "class";
+        case SymbolKind::Interface: return "interface";
+        case SymbolKind::Module:    return "module";
+        case SymbolKind::Macro:     return "macro";
+        case SymbolKind::Type:      return "type";
+        case SymbolKind::Constant:  return "constant";
+        case SymbolKind::Variable:  return "variable";
+        case SymbolKind::Other:     break;
+    }
+    return "symbol";
+}
 
-        std::sort(results.begin(), results.end(), [](const TelescopeEntry& a, const TelescopeEntry& b) {
-            return a.score < b.score;
-        });
-        if ((int)results.size() > MAX_RESULTS)
-            results.resize(MAX_RESULTS);
+// "#name" searches definitions in the workspace symbol index
+void TelescopeWidget::SubmitSymbolJob(const std::string& query) {
+    const uint32_t gen = BeginQuery();
+    const std::filesystem::path rootDir = m_RootDir;
 
-        {
-            std::lock_guard<std::mutex> lk(m_PendingMutex);
-            m_PendingResults   = std::move(results);
-            m_PendingGeneration = gen;
+    JobSystem::Async(JobPriority::Interactive, m_QueryCancel.Token(), [query, rootDir] {
+        std::vector<TelescopeEntry> results;
+        if (!query.empty()) {
+            for (WorkspaceSymbol& symbol : SymbolIndex::GetInstance().Find(query, MAX_RESULTS)) {
+                std::string display = symbol.name + "  " + SymbolKindName(symbol.kind) + "  " +
+                                      symbol.path.lexically_relative(rootDir).generic_string() + ":" +
+                                      std::to_string(symbol.line + 1);
+                results.push_back({std::move(symbol.path), std::move(display), 0, symbol.line, symbol.column});
+            }
         }
-        m_PendingReady.store(true, std::memory_order_release);
-        return true;
+        return results;
+    }).ThenOnMain([this, gen](std::vector<TelescopeEntry> results) {
+        ShowResults(gen, std::move(results));
     });
-
-    JobSystem::Submit(job);
 }
 
-static bool IsBinaryFile(const std::filesystem::path& path) {
-    std::ifstream f(path, std::ios::binary);
-    if (!f) return true;
-    char buf[512];
-    f.read(buf, sizeof(buf));
-    std::streamsize n = f.gcount();
-    for (std::streamsize i = 0; i < n; ++i) {
-        unsigned char c = (unsigned char)buf[i];
-        if (c == 0) return true;
+struct TelescopeWidget::GrepPass {
+    std::shared_ptr<const FileList> files;
+    std::string query;  // Folded
+    uint32_t generation = 0;
+    CancellationToken cancel;
+    std::atomic<size_t> next{0};  // Index of the next file to claim
+    std::atomic<int> found{0};
+    std::atomic<uint32_t> running{0};
+};
+
+// ">text" searches file contents on every worker; workers claim files one at
+// a time and stream each file's matches as soon as it is done
+void TelescopeWidget::SubmitGrepJob(const std::string& query) {
+    const uint32_t gen = BeginQuery();
+    m_Results.clear();
+    m_ResultsGeneration = gen;
+    m_SelectedIdx = 0;
+    if (query.empty()) return;
+
+    if (!m_Files) return;  // Retried once the index publishes
+    auto pass = std::make_shared<GrepPass>();
+    pass->files = m_Files;
+    for (char c : query) pass->query.push_back(FoldAscii(c));
+    pass->generation = gen;
+    pass->cancel = m_QueryCancel.Token();
+
+    const uint32_t workers = std::max(1u, JobSystem::GetWorkerCount());
+    pass->running.store(workers);
+    m_Grep = pass;
+    for (uint32_t i = 0; i < workers; ++i) {
+        JobSystem::Submit(JobPriority::Interactive, pass->cancel, [this, pass] {
+            GrepFiles(*pass);
+            pass->running.fetch_sub(1, std::memory_order_release);
+        });
     }
-    return false;
 }
 
-void TelescopeWidget::LoadPreview(const std::filesystem::path& path) {
-    std::string pathStr = path.string();
-    if (pathStr == m_PreviewPath) return;
-    m_PreviewPath = pathStr;
-    m_PreviewLines.clear();
-    m_PreviewIsBinary = false;
+void TelescopeWidget::GrepFiles(GrepPass& pass) {
+    constexpr size_t npos = std::string_view::npos;
+    const FileList& files = *pass.files;
+    std::vector<TelescopeEntry> batch;
+
+    for (size_t index; (index = pass.next.fetch_add(1, std::memory_order_relaxed)) < files.Size();) {
+        if (pass.cancel.IsCancelled()) return;
+        if (pass.found.load(std::memory_order_relaxed) >= MAX_RESULTS) return;
+
+        const std::filesystem::path path = files.FullPath(index);
+        auto file = MappedFile::Open(path);
+        if (!file) continue;
+        const std::string_view text(file->Data(), file->Size());
+        if (text.substr(0, BINARY_PROBE).find('\0') != npos) continue;
+
+        std::string rel;
+        size_t line = 0;
+        size_t counted = 0;
+        for (size_t from = 0; from < text.size();) {
+            size_t hit = FindFolded(text.substr(from), pass.query);
+            if (hit == npos) break;
+            hit += from;
+            if (pass.found.fetch_add(1, std::memory_order_relaxed) >= MAX_RESULTS) break;
+
+            line += CountNewlines(text.substr(counted, hit - counted));
+            counted = hit;
+            size_t lineStart = text.rfind('\n', hit);
+            lineStart = lineStart == npos ? 0 : lineStart + 1;
+            size_t lineEnd = text.find('\n', hit);
+            if (lineEnd == npos) lineEnd = text.size();
+
+            std::string_view content = text.substr(lineStart, lineEnd - lineStart);
+            while (!content.empty() && (content.front() == ' ' || content.front() == '\t')) content.remove_prefix(1);
+            if (content.size() > MAX_GREP_LINE) {
+                size_t cut = MAX_GREP_LINE;
+                while (cut > 0 && ((unsigned char)content[cut] & 0xC0) == 0x80) --cut;
+                content = content.substr(0, cut);
+            }
 
-    if (!std::filesystem::is_regular_file(path)) return;
+            if (rel.empty()) rel = files.RelativePath(index);
+            std::string display = rel + ":" + std::to_string(line + 1) + ": ";
+            for (char c : content) display.push_back((unsigned char)c < 32 ? ' ' : c);
+            batch.push_back({path, std::move(display), 0, line, hit - lineStart});
+            from = lineEnd + 1;
+        }
 
-    auto fileSize = std::filesystem::file_size(path);
-    if (fileSize > 1024 * 1024) {
-        m_PreviewLines.push_back("[File too large to preview]");
-        return;
+        if (batch.empty()) continue;
+        JobSystem::DispatchToMain(pass.cancel, [this, gen = pass.generation, batch = std::move(batch)]() mutable {
+            ShowResults(gen, std::move(batch));
+        });
+        batch.clear();
     }
+}
 
-    if (IsBinaryFile(path)) {
-        m_PreviewIsBinary = true;
-        m_PreviewLines.push_back("[Binary file]");
-        return;
+struct TelescopeWidget::Preview {
+    struct Span {
+        uint32_t start;  // Display columns
+        uint32_t end;
+        HighlightGroup group;
+    };
+
+    std::vector<std::string> lines;  // Tabs expanded
+    std::vector<std::vector<Span>> spans;
+    size_t firstLine = 0;            // File line of lines[0]
+    size_t focusLine = SIZE_MAX;     // Index into lines of the picked line
+    std::string message;             // Shown instead of lines when set
+};
+
+// Maps only the window shown: the MAX_PREVIEW_LINES after the first line, or
+// around the picked line. Highlighting parses that window on its own.
+std::shared_ptr<const TelescopeWidget::Preview> TelescopeWidget::BuildPreview(const std::filesystem::path& path,
+                                                                              size_t line, bool highlight) {
+    constexpr size_t npos = std::string_view::npos;
+    auto preview = std::make_shared<Preview>();
+    auto file = MappedFile::Open(path);
+    if (!file) {
+        preview->message = "[Cannot open file]";
+        return preview;
+    }
+    const std::string_view text(file->Data(), file->Size());
+    if (text.substr(0, BINARY_PROBE).find('\0') != npos) {
+        preview->message = "[Binary file]";
+        return preview;
     }
 
-    std::ifstream f(path);
-    if (!f) {
-        m_PreviewLines.push_back("[Cannot open file]");
-        return;
+    size_t begin = 0;
+    if (line != SIZE_MAX) {
+        const size_t first = line - std::min<size_t>(line, MAX_PREVIEW_LINES / 3);
+        const size_t newline = first > 0 ? FindNthNewline(text, first) : npos;
+        if (first == 0 || newline != npos) {
+            preview->firstLine = first;
+            preview->focusLine = line - first;
+            begin = first > 0 ? newline + 1 : 0;
+        }
     }
+    std::string_view window = text.substr(begin);
+    const size_t end = FindNthNewline(window, MAX_PREVIEW_LINES);
+    if (end != npos) window = window.substr(0, end);
+
+    std::optional<TextBuffer> buffer;
+    const Language* language = highlight && window.size() <= PREVIEW_HIGHLIGHT_LIMIT
+                                   ? LanguageRegistry::GetInstance().GetLanguageForFile(path)
+                                   : nullptr;
+    if (language) {
+        buffer.emplace(window);
+        buffer->SetLanguage(language);
+        buffer->FinishParsing();
+        buffer->UpdateHighlights(0, MAX_PREVIEW_LINES);
+    }
+
+    std::vector<uint32_t> columns;
+    for (size_t start = 0, index = 0; start <= window.size(); ++index) {
+        size_t stop = window.find('\n', start);
+        if (stop == npos) stop = window.size();
+        std::string_view raw = window.substr(start, stop - start);
+        if (!raw.empty() && raw.back() == '\r') raw.remove_suffix(1);
+        raw = raw.substr(0, MAX_PREVIEW_COLUMNS);
 
-    std::string line;
-    int count = 0;
-    while (std::getline(f, line) && count < MAX_PREVIEW_LINES) {
-        // Replace tabs with spaces for display
+        // Tabs become four spaces and control bytes are dropped
         std::string display;
-        display.reserve(line.size());
-        for (char c : line) {
-            if (c == '\t') display += "    ";
-            else if ((unsigned char)c >= 32 || c == '\0') display += c;
+        display.reserve(raw.size());
+        columns.assign(raw.size() + 1, 0);
+        for (size_t i = 0; i < raw.size(); ++i) {
+            columns[i] = static_cast<uint32_t>(display.size());
+            if (raw[i] == '\t') display += "    ";
+            else if ((unsigned char)raw[i] >= 32) display += raw[i];
         }
-        m_PreviewLines.push_back(std::move(display));
-        ++count;
+        columns[raw.size()] = static_cast<uint32_t>(display.size());
+
+        std::vector<Preview::Span> spans;
+        if (buffer) {
+            for (const HighlightSpan& span : buffer->GetLineHighlights(index)) {
+                const size_t from = std::min<size_t>(span.start, raw.size());
+                const size_t to = std::min<size_t>(span.end, raw.size());
+                if (from < to) spans.push_back({columns[from], columns[to], static_cast<HighlightGroup>(span.highlightId)});
+            }
+        }
+        preview->lines.push_back(std::move(display));
+        preview->spans.push_back(std::move(spans));
+        start = stop + 1;
+    }
+    return preview;
+}
+
+void TelescopeWidget::AddPreview(std::string key, std::shared_ptr<const Preview> preview) {
+    if (key == m_PreviewKey) {
+        m_Preview = preview;
+        m_PreviewScrollPending = true;
+    }
+    if (m_PreviewCache.size() >= PREVIEW_CACHE_SIZE) m_PreviewCache.erase(m_PreviewCache.begin());
+    m_PreviewCache.emplace_back(std::move(key), std::move(preview));
+}
+
+void TelescopeWidget::ShowPreview(const TelescopeEntry& entry) {
+    const bool highlight = EditorSettings::Get().GetBehavior().previewHighlighting;
+    std::string key = entry.fullPath.string();
+    key += '\0';
+    key += std::to_string(entry.line);
+    if (highlight) key += 'h';
+    if (key == m_PreviewKey) return;
+
+    m_PreviewKey = key;
+    m_PreviewScrollPending = true;
+    auto cached = std::find_if(m_PreviewCache.begin(), m_PreviewCache.end(),
+                               [&](const CachedPreview& item) { return item.first == key; });
+    if (cached != m_PreviewCache.end()) {
+        m_Preview = cached->second;
+        std::rotate(cached, cached + 1, m_PreviewCache.end());
+        return;
     }
+
+    // Moving the selection again before a worker picks this up skips it
+    m_Preview.reset();
+    m_PreviewCancel.Cancel();
+    m_PreviewCancel = CancellationSource();
+    JobSystem::Async(JobPriority::Interactive, m_PreviewCancel.Token(), [path = entry.fullPath, line = entry.line, highlight] {
+        return BuildPreview(path, line, highlight);
+    }).ThenOnMain([this, key = std::move(key)](std::shared_ptr<const Preview> preview) mutable {
+        AddPreview(std::move(key), std::move(preview));
+    });
 }
 
 void TelescopeWidget::RenderPreview(const ImVec2& size) {
+    static const SyntaxTheme theme;
     ImGui::PushStyleColor(ImGuiCol_ChildBg, ImVec4(0.08f, 0.08f, 0.09f, 1.0f));
     ImGui::BeginChild("##tele_preview", size, false,
                       ImGuiWindowFlags_HorizontalScrollbar);
 
-    if (m_PreviewLines.empty()) {
+    const Preview* preview = m_Preview.get();
+    if (!preview) {
+        // Still loading; leave the pane empty rather than flash a placeholder
+    } else if (!preview->message.empty() || preview->lines.empty()) {
+        const char* message = preview->message.empty() ? "No preview" : preview->message.c_str();
         float pad = (size.y - ImGui::GetTextLineHeightWithSpacing()) * 0.45f;
         if (pad > 0.0f) ImGui::Dummy(ImVec2(0, pad));
-        float textW = ImGui::CalcTextSize("No preview").x;
+        float textW = ImGui::CalcTextSize(message).x;
         ImGui::SetCursorPosX((size.x - textW) * 0.5f);
-        ImGui::TextDisabled("No preview");
+        ImGui::TextDisabled("%s", message);
     } else {
+        const float lineH = ImGui::GetTextLineHeightWithSpacing();
+        if (m_PreviewScrollPending) {
+            const float target = preview->focusLine == SIZE_MAX ? 0.0f : preview->focusLine * lineH - size.y / 3.0f;
+            ImGui::SetScrollY(std::max(0.0f, target));
+            m_PreviewScrollPending = false;
+        }
+
         ImGuiListClipper clipper;
-        clipper.Begin((int)m_PreviewLines.size());
+        clipper.Begin((int)preview->lines.size(), lineH);
         while (clipper.Step()) {
             for (int i = clipper.DisplayStart; i < clipper.DisplayEnd; ++i) {
+                if ((size_t)i == preview->focusLine) {
+                    ImVec2 rowMin = ImGui::GetCursorScreenPos();
+                    ImGui::GetWindowDrawList()->AddRectFilled(
+                        rowMin, ImVec2(rowMin.x + ImGui::GetContentRegionAvail().x, rowMin.y + lineH),
+                        IM_COL32(40, 55, 90, 160));
+                }
                 // Line number gutter
-                ImGui::TextDisabled("%4d ", i + 1);
+                ImGui::TextDisabled("%4zu ", preview->firstLine + i + 1);
                 ImGui::SameLine();
-                ImGui::TextUnformatted(m_PreviewLines[i].c_str());
+
+                const std::string& line = preview->lines[i];
+                size_t col = 0;
+                auto emit = [&](size_t end, ImU32 color) {
+                    if (col > 0) ImGui::SameLine(0.0f, 0.0f);
+                    ImGui::PushStyleColor(ImGuiCol_Text, color);
+                    ImGui::TextUnformatted(line.data() + col, line.data() + end);
+                    ImGui::PopStyleColor();
+                    col = end;
+                };
+                for (const Preview::Span& span : preview->spans[i]) {
+                    if (span.start < col) continue;
+                    if (span.start > col) emit(span.start, theme.text);
+                    emit(span.end, theme.GetColor(span.group));
+                }
+                if (col < line.size() || col == 0) emit(line.size(), theme.text);
             }
         }
     }
@@ -347,8 +479,7 @@ void TelescopeWidget::RenderPreview(const ImVec2& size) {
 void TelescopeWidget::Render() {
     if (!m_Open) return;
 
-    // Swap in completed filter job results, then submit a new job if query changed
-    SwapPendingResults();
+    // Results and previews arrive through main thread jobs; submit a new filter if the query changed
     SubmitFilterJob();
 
     ImVec2 displaySize = ImGui::GetIO().DisplaySize;
@@ -436,7 +567,10 @@ void TelescopeWidget::Render() {
         m_SelectedIdx = std::max(m_SelectedIdx - 1, 0);
 
     if (doOpen && (int)m_SelectedIdx < (int)m_Results.size()) {
-        if (m_OnOpen) m_OnOpen(m_Results[m_SelectedIdx].fullPath);
+        if (m_OnOpen) {
+            const TelescopeEntry& entry = m_Results[m_SelectedIdx];
+            m_OnOpen(entry.fullPath, entry.line, entry.column);
+        }
         Close();
         ImGui::End();
         ImGui::PopStyleVar(3);
@@ -456,12 +590,14 @@ void TelescopeWidget::Render() {
     ImGui::BeginChild("##tele_list", ImVec2(listW, bodyH), false,
                       ImGuiWindowFlags_NoScrollbar);
 
-    if (m_Scanning.load() && m_Results.empty()) {
+    const bool grepping = m_Grep && m_Grep->running.load(std::memory_order_acquire) > 0;
+    if ((!m_Files || grepping) && m_Results.empty() && m_QueryBuf[0] != '#') {
+        const char* status = grepping ? "Searching..." : "Scanning...";
         float pad = (bodyH - ImGui::GetTextLineHeightWithSpacing()) * 0.45f;
         if (pad > 0.0f) ImGui::Dummy(ImVec2(0, pad));
-        float tw = ImGui::CalcTextSize("Scanning...").x;
+        float tw = ImGui::CalcTextSize(status).x;
         ImGui::SetCursorPosX((listW - tw) * 0.5f);
-        ImGui::TextDisabled("Scanning...");
+        ImGui::TextDisabled("%s", status);
     } else if (m_Results.empty()) {
         float pad = (bodyH - ImGui::GetTextLineHeightWithSpacing()) * 0.45f;
         if (pad > 0.0f) ImGui::Dummy(ImVec2(0, pad));
@@ -490,7 +626,7 @@ void TelescopeWidget::Render() {
                                       ImVec2(listW - 8.0f, 0))) {
                     m_SelectedIdx = i;
                     if (ImGui::IsMouseDoubleClicked(0)) {
-                        if (m_OnOpen) m_OnOpen(m_Results[i].fullPath);
+                        if (m_OnOpen) m_OnOpen(m_Results[i].fullPath, m_Results[i].line, m_Results[i].column);
                         Close();
                     }
                 }
@@ -512,7 +648,7 @@ void TelescopeWidget::Render() {
 
     // Preview pane — load preview for currently selected entry
     if (!m_Results.empty() && m_SelectedIdx < (int)m_Results.size()) {
-        LoadPreview(m_Results[m_SelectedIdx].fullPath);
+        ShowPreview(m_Results[m_SelectedIdx]);
         RenderPreview(ImVec2(previewW, bodyH));
     } else {
         ImGui::PushStyleColor(ImGuiCol_ChildBg, ImVec4(0.08f, 0.08f, 0.09f, 1.0f));
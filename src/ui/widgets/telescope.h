@@ -1,12 +1,13 @@
 #pragma once
 
+#include "core/cancellation.h"
+#include "core/file_index.h"
 #include <string>
 #include <vector>
 #include <filesystem>
 #include <functional>
 #include <atomic>
-#include <thread>
-#include <mutex>
+#include <memory>
 #include <imgui.h>
 
 namespace sol {
@@ -15,13 +16,16 @@ struct TelescopeEntry {
     std::filesystem::path fullPath;
     std::string display;  // path relative to root
     int score = 0;
+    size_t line = SIZE_MAX;  // Set for symbol and grep results
+    size_t column = 0;
 };
 
 class TelescopeWidget {
 public:
-    using OpenCallback = std::function<void(const std::filesystem::path&)>;
+    // line is SIZE_MAX when no position was picked
+    using OpenCallback = std::function<void(const std::filesystem::path&, size_t line, size_t column)>;
 
-    TelescopeWidget();
+    explicit TelescopeWidget(FileIndex& fileIndex);
     ~TelescopeWidget();
 
     TelescopeWidget(const TelescopeWidget&) = delete;
@@ -37,15 +41,24 @@ public:
     void Render();
 
 private:
-    void StartScan(const std::filesystem::path& rootDir);
-    void CancelScan();
     void SubmitFilterJob();
-    void SwapPendingResults();
-    void LoadPreview(const std::filesystem::path& path);
+    void SubmitSymbolJob(const std::string& query);
+    void SubmitGrepJob(const std::string& query);
+    // Cancels the jobs of the previous query; returns the new generation
+    uint32_t BeginQuery();
+    // Main thread; results of the query on screen are appended
+    void ShowResults(uint32_t generation, std::vector<TelescopeEntry> results);
+    void ShowPreview(const TelescopeEntry& entry);
     void RenderPreview(const ImVec2& size);
 
-    static int ScoreMatch(const std::string& fname, const std::string& relPath,
-                          const std::string& lowerQuery);
+    struct Preview;
+    void AddPreview(std::string key, std::shared_ptr<const Preview> preview);
+    static std::shared_ptr<const Preview> BuildPreview(const std::filesystem::path& path, size_t line, bool highlight);
+
+    struct FilterPass;
+    struct GrepPass;
+    void FilterFiles(const FilterPass& pass);
+    void GrepFiles(GrepPass& pass);
 
     bool m_Open = false;
     bool m_WantsFocus = false;
@@ -55,33 +68,37 @@ private:
     char m_QueryBuf[256] = {};
     std::string m_LastQuery;
 
-    // File scan (background thread)
+    // Workspace files, shared with the workspace across sessions
+    FileIndex& m_FileIndex;
     std::filesystem::path m_RootDir;
-    std::mutex m_FilesMutex;
-    std::vector<std::filesystem::path> m_AllFiles;
-    std::thread m_ScanThread;
-    std::atomic<bool> m_ScanCancelled{false};
-    std::atomic<bool> m_Scanning{false};
+    std::shared_ptr<const FileList> m_Files;  // Snapshot the results were filtered from
 
-    static constexpr int MAX_FILES         = 50000;
     static constexpr int MAX_RESULTS       = 500;
+    static constexpr size_t FILTER_CHUNK   = 16384; // Fewest files a filter chunk scores
     static constexpr int MAX_PREVIEW_LINES = 120;
-
-    // Parallel filter results (written by job thread, read by main thread)
-    std::atomic<uint32_t> m_FilterGeneration{0};
-    std::mutex m_PendingMutex;
-    std::vector<TelescopeEntry> m_PendingResults;
-    uint32_t m_PendingGeneration = 0;
-    std::atomic<bool> m_PendingReady{false};
-
-    // Active filtered results (main-thread only after swap)
+    static constexpr size_t MAX_PREVIEW_COLUMNS = 512;          // Bytes kept of a long line
+    static constexpr size_t PREVIEW_HIGHLIGHT_LIMIT = 256 * 1024; // Larger windows stay plain
+    static constexpr size_t PREVIEW_CACHE_SIZE = 32;
+    static constexpr size_t MAX_GREP_LINE  = 160;   // Bytes of a matching line shown
+    static constexpr size_t BINARY_PROBE   = 8192;  // Leading bytes checked for NUL
+
+    // Bumped by every query (main thread only); jobs of older ones are cancelled
+    uint32_t m_FilterGeneration = 0;
+    CancellationSource m_QueryCancel;
+    std::shared_ptr<GrepPass> m_Grep;  // Latest live grep, streams batches to the main thread
+
+    // Active filtered results (main thread only)
     std::vector<TelescopeEntry> m_Results;
+    uint32_t m_ResultsGeneration = 0;
     int m_SelectedIdx = 0;
 
-    // Preview
-    std::string m_PreviewPath;
-    std::vector<std::string> m_PreviewLines;
-    bool m_PreviewIsBinary = false;
+    // Preview, built on a worker; the cache keeps the most recent last
+    using CachedPreview = std::pair<std::string, std::shared_ptr<const Preview>>;
+    std::string m_PreviewKey;                  // Of the selected entry
+    std::shared_ptr<const Preview> m_Preview;  // Null while loading
+    bool m_PreviewScrollPending = false;
+    std::vector<CachedPreview> m_PreviewCache;
+    CancellationSource m_PreviewCancel;
 
     OpenCallback m_OnOpen;
 };
@@ -2,6 +2,7 @@
 #include "ui/input/command.h"
 #include "ui/editor_settings.h"
 #include "core/event_system.h"
+#include "core/frame_scheduler.h"
 #include <imgui_internal.h>
 #include <algorithm>
 #include <cmath>
@@ -33,7 +34,8 @@ bool TerminalWidget::Spawn(const TerminalConfig& config) {
         return false;
     }
     
-    m_Emulator = std::make_unique<TerminalEmulator>(config.defaultRows, config.defaultCols);
+    m_Emulator = std::make_unique<TerminalEmulator>(config.defaultRows, config.defaultCols, config.scrollbackLines,
+                                                    config.historyBytes);
     m_Emulator->AttachPty(m_Pty);
     
     m_VisibleRows = config.defaultRows;
@@ -45,9 +47,13 @@ bool TerminalWidget::Spawn(const TerminalConfig& config) {
 }
 
 void TerminalWidget::Close() {
+    m_Search.Clear();
+    m_SearchCurrentMatch = -1;
     if (m_Emulator) {
         m_Emulator.reset();
     }
+    // Generations are only unique within one emulator
+    m_Lines.clear();
     if (m_Pty) {
         m_Pty->Close();
         m_Pty.reset();
@@ -62,17 +68,14 @@ int TerminalWidget::GetExitCode() const {
     return m_Emulator ? m_Emulator->GetExitCode() : 0;
 }
 
-const std::string& TerminalWidget::GetTitle() const {
-    if (m_Emulator && !m_Emulator->GetTitle().empty()) {
-        return m_Emulator->GetTitle();
-    }
-    return m_DefaultTitle;
-}
-
-void TerminalWidget::ProcessInput() {
+std::string TerminalWidget::GetTitle() const {
     if (m_Emulator) {
-        m_Emulator->ProcessInput();
+        auto lock = m_Emulator->Lock();
+        if (!m_Emulator->GetTitle().empty()) {
+            return m_Emulator->GetTitle();
+        }
     }
+    return m_DefaultTitle;
 }
 
 void TerminalWidget::CalculateDimensions(const ImVec2& size) {
@@ -94,15 +97,15 @@ void TerminalWidget::CalculateDimensions(const ImVec2& size) {
         m_VisibleRows = newRows;
         m_VisibleCols = newCols;
         m_Emulator->Resize(newRows, newCols);
+        // Rewrapping renumbers the lines matched
+        m_Search.Clear();
+        m_SearchCurrentMatch = -1;
     }
 }
 
 bool TerminalWidget::Render(const char* label, const ImVec2& size) {
     if (!m_Emulator) return false;
     
-    // Process PTY input
-    m_Emulator->ProcessInput();
-    
     ImGuiWindow* window = ImGui::GetCurrentWindow();
     if (window->SkipItems) return false;
     
@@ -113,6 +116,9 @@ bool TerminalWidget::Render(const char* label, const ImVec2& size) {
     if (contentSize.x <= 0.0f) contentSize.x = ImGui::GetContentRegionAvail().x;
     if (contentSize.y <= 0.0f) contentSize.y = ImGui::GetContentRegionAvail().y;
     
+    // The reader thread waits while the screen is resized and drawn
+    auto lock = m_Emulator->Lock();
+    
     // Calculate character dimensions
     CalculateDimensions(contentSize);
     
@@ -142,6 +148,11 @@ bool TerminalWidget::Render(const char* label, const ImVec2& size) {
     
     // Also update emulator's default attributes to match
     m_Emulator->UpdateDefaultColors(themeFg, themeBg);
+    ValidateLineCache(themeFg, themeBg);
+    
+    if (m_Search.Poll()) {
+        SelectSearchMatch();
+    }
     
     ImU32 bgColor = themeBg;
     
@@ -179,7 +190,9 @@ bool TerminalWidget::Render(const char* label, const ImVec2& size) {
         
         // Handle keyboard input only in the active window
         if (m_IsFocused && m_IsWindowActive) {
+            lock.unlock();
             HandleInput();
+            lock.lock();
         }
         
         // Render terminal content
@@ -219,6 +232,9 @@ bool TerminalWidget::Render(const char* label, const ImVec2& size) {
             m_CursorBlinkTime = 0.0f;
             m_CursorVisible = !m_CursorVisible;
         }
+        if (m_IsFocused && m_IsWindowActive) {
+            FrameScheduler::GetInstance().RequestFrameIn(0.5f - m_CursorBlinkTime);
+        }
     }
     
     ImGui::EndChild();
@@ -231,6 +247,10 @@ bool TerminalWidget::Render(const char* label, const ImVec2& size) {
 void TerminalWidget::HandleInput() {
     ImGuiIO& io = ImGui::GetIO();
     
+    if (HandleSearchInput()) {
+        return;
+    }
+    
     // Handle Command/Search mode - terminal does not process text input
     if (InputSystem::GetInstance().GetInputMode() != EditorInputMode::Insert) {
         io.InputQueueCharacters.resize(0);  // Clear input queue
@@ -376,129 +396,322 @@ void TerminalWidget::HandleInput() {
     }
 }
 
+bool TerminalWidget::HandleSearchInput() {
+    ImGuiIO& io = ImGui::GetIO();
+    auto& inputSystem = InputSystem::GetInstance();
+    
+    // Sync search state with status bar every frame
+    if (m_SearchActive) {
+        EditorSettings::Get().SetSearch(m_SearchQuery.c_str(), m_SearchCurrentMatch >= 0 ? m_SearchCurrentMatch + 1 : 0,
+            static_cast<int>(m_Search.Matches().size()), m_SearchRegex, m_Search.Error());
+    } else {
+        EditorSettings::Get().ClearSearch();
+    }
+    
+    if (inputSystem.GetInputMode() == EditorInputMode::Search) {
+        if (ImGui::IsKeyPressed(ImGuiKey_Escape)) {
+            m_SearchActive = false;
+            m_Search.Clear();
+            m_SearchCurrentMatch = -1;
+            inputSystem.SwitchToCommandMode();
+        } else if (ImGui::IsKeyPressed(ImGuiKey_Enter)) {
+            // Confirm, keeping the matches for n/N
+            m_SearchActive = false;
+            inputSystem.SwitchToCommandMode();
+        } else if (ImGui::IsKeyPressed(ImGuiKey_DownArrow) || (ImGui::IsKeyPressed(ImGuiKey_Tab) && !io.KeyShift)) {
+            StepSearchMatch(1);
+        } else if (ImGui::IsKeyPressed(ImGuiKey_UpArrow) || (ImGui::IsKeyPressed(ImGuiKey_Tab) && io.KeyShift)) {
+            StepSearchMatch(-1);
+        } else if (io.KeyCtrl && ImGui::IsKeyPressed(ImGuiKey_R)) {
+            // Toggle between literal and regex search
+            m_SearchRegex = !m_SearchRegex;
+            StartSearch();
+        } else if (ImGui::IsKeyPressed(ImGuiKey_Backspace)) {
+            if (!m_SearchQuery.empty()) {
+                m_SearchQuery.pop_back();
+                StartSearch();
+            }
+        } else {
+            const size_t length = m_SearchQuery.size();
+            for (int i = 0; i < io.InputQueueCharacters.Size; ++i) {
+                ImWchar c = io.InputQueueCharacters[i];
+                if (c >= 32 && c < 127) m_SearchQuery.push_back(static_cast<char>(c));
+            }
+            if (m_SearchQuery.size() != length) StartSearch();
+        }
+        io.InputQueueCharacters.resize(0);
+        return true;
+    }
+    
+    if (inputSystem.GetInputMode() != EditorInputMode::Command) return false;
+    for (int i = 0; i < io.InputQueueCharacters.Size; ++i) {
+        if (io.InputQueueCharacters[i] == '/') {
+            m_SearchActive = true;
+            m_SearchQuery.clear();
+            m_Search.Clear();
+            m_SearchCurrentMatch = -1;
+            inputSystem.SwitchToSearchMode();
+            io.InputQueueCharacters.resize(0);
+            return true;
+        }
+    }
+    // After closing search, navigate with n/N
+    if (!m_Search.Matches().empty() && ImGui::IsKeyPressed(ImGuiKey_N)) {
+        StepSearchMatch(io.KeyShift ? -1 : 1);
+        io.InputQueueCharacters.resize(0);
+        return true;
+    }
+    return false;
+}
+
+void TerminalWidget::StartSearch() {
+    auto lock = m_Emulator->Lock();
+    m_SearchOrigin = GetBottomLine();
+    m_SearchCurrentMatch = -1;
+    m_Search.Start(*m_Emulator, m_SearchQuery, m_SearchRegex);
+}
+
+void TerminalWidget::SelectSearchMatch() {
+    const auto& matches = m_Search.Matches();
+    if (matches.empty()) return;
+    auto it = std::upper_bound(matches.begin(), matches.end(), m_SearchOrigin,
+                               [](uint64_t line, const TerminalSearch::Match& match) { return line < match.line; });
+    m_SearchCurrentMatch = static_cast<int>(it == matches.begin() ? matches.size() : it - matches.begin()) - 1;
+    ScrollToMatch();
+}
+
+void TerminalWidget::StepSearchMatch(int step) {
+    const int count = static_cast<int>(m_Search.Matches().size());
+    if (count == 0) return;
+    m_SearchCurrentMatch = (m_SearchCurrentMatch + step + count) % count;
+    auto lock = m_Emulator->Lock();
+    ScrollToMatch();
+}
+
+void TerminalWidget::ScrollToMatch() {
+    const TerminalSearch::Match& match = m_Search.Matches()[static_cast<size_t>(m_SearchCurrentMatch)];
+    const uint64_t start = m_Emulator->GetScrollbackStart();
+    if (match.line < start) return;  // Dropped from the scrollback since
+    const uint64_t index = match.line - start;
+    const uint64_t scrollback = m_Emulator->GetScrollbackSize();
+    if (index >= scrollback) {
+        m_ScrollOffset = 0;
+        return;
+    }
+    // The match's line lands mid-screen
+    m_ScrollOffset = static_cast<int>(std::min<uint64_t>(scrollback, scrollback - index + m_Emulator->GetRows() / 2));
+}
+
+uint64_t TerminalWidget::GetBottomLine() const {
+    return m_Emulator->GetScrollbackStart() + m_Emulator->GetScrollbackSize() + m_Emulator->GetRows() - 1 -
+           static_cast<uint64_t>(m_ScrollOffset);
+}
+
+void TerminalWidget::ValidateLineCache(ImU32 defaultFg, ImU32 defaultBg) {
+    ImFont* font = ImGui::GetFont();
+    if (font == m_CacheFont && m_CharWidth == m_CacheCharWidth && defaultFg == m_CacheFg && defaultBg == m_CacheBg) {
+        return;
+    }
+    m_CacheFont = font;
+    m_CacheCharWidth = m_CharWidth;
+    m_CacheFg = defaultFg;
+    m_CacheBg = defaultBg;
+    for (LineCache& cache : m_Lines) cache.generation = 0;
+    
+    for (int c = 0; c < 128; c++) {
+        const char glyph[2] = {static_cast<char>(c), 0};
+        m_FitsCell[c] = c >= 32 && c < 127 && std::abs(ImGui::CalcTextSize(glyph).x - m_CharWidth) < 0.01f;
+    }
+}
+
+void TerminalWidget::BuildLine(const TerminalLine& line, LineCache& cache) const {
+    cache.generation = line.generation;
+    cache.backgrounds.clear();
+    cache.texts.clear();
+    cache.text.clear();
+    
+    const ImU32 defaultBg = m_Emulator->GetPalette().GetColor(0);
+    const int cols = std::min(m_Emulator->GetCols(), static_cast<int>(line.size()));
+    // Whether the last text run ends in a glyph one cell wide
+    bool runOpen = false;
+    
+    for (int col = 0; col < cols; col++) {
+        const auto& cell = line[static_cast<size_t>(col)];
+        
+        // Determine colors (handle inverse)
+        const TerminalAttr& attr = m_Emulator->GetStyle(cell.style);
+        uint32_t fg = attr.fg;
+        uint32_t bg = attr.bg;
+        
+        if (attr.inverse) {
+            std::swap(fg, bg);
+        }
+        
+        if (attr.dim) {
+            // Reduce brightness
+            int r = (fg >> 16) & 0xFF;
+            int g = (fg >> 8) & 0xFF;
+            int b = fg & 0xFF;
+            r = r * 2 / 3;
+            g = g * 2 / 3;
+            b = b * 2 / 3;
+            fg = (fg & 0xFF000000) | (r << 16) | (g << 8) | b;
+        }
+        
+        if (attr.bold) {
+            // Make color brighter for bold
+            int r = std::min(255, static_cast<int>(((fg >> 16) & 0xFF) * 5 / 4));
+            int g = std::min(255, static_cast<int>(((fg >> 8) & 0xFF) * 5 / 4));
+            int b = std::min(255, static_cast<int>((fg & 0xFF) * 5 / 4));
+            fg = (fg & 0xFF000000) | (static_cast<uint32_t>(r) << 16) | (static_cast<uint32_t>(g) << 8) | static_cast<uint32_t>(b);
+        }
+        
+        // Background if not default, extending the run on its left
+        if (bg != defaultBg) {
+            if (!cache.backgrounds.empty() && cache.backgrounds.back().col + cache.backgrounds.back().count == col &&
+                cache.backgrounds.back().color == bg) {
+                cache.backgrounds.back().count++;
+            } else {
+                cache.backgrounds.push_back({col, 1, bg});
+            }
+        }
+        
+        // Blanks only space out text, unless decorated
+        const char32_t cp = cell.codepoint > 32 ? cell.codepoint : U' ';
+        const bool decorated = attr.underline || attr.strikethrough;
+        if (cp == U' ' && !decorated) continue;
+        
+        // Glyphs of another width are drawn alone at their cell
+        const bool fits = cp < 0x80 && m_FitsCell[cp] && m_FitsCell[' '];
+        TextRun* run = cache.texts.empty() ? nullptr : &cache.texts.back();
+        // Decorations are not drawn across the blanks skipped
+        const bool adjacent = run && run->col + run->count == col;
+        if (fits && runOpen && run->color == fg && run->underline == attr.underline &&
+            run->strikethrough == attr.strikethrough && (adjacent || !decorated)) {
+            // Blanks skipped inside the run are spaced out again
+            cache.text.append(static_cast<size_t>(col - run->col - run->count), ' ');
+        } else {
+            cache.texts.push_back({col, 0, static_cast<uint32_t>(cache.text.size()), 0, fg, attr.underline,
+                                   attr.strikethrough});
+            run = &cache.texts.back();
+        }
+        
+        if (cp < 0x80) {
+            cache.text += static_cast<char>(cp);
+        } else if (cp < 0x800) {
+            cache.text += static_cast<char>(0xC0 | (cp >> 6));
+            cache.text += static_cast<char>(0x80 | (cp & 0x3F));
+        } else if (cp < 0x10000) {
+            cache.text += static_cast<char>(0xE0 | (cp >> 12));
+            cache.text += static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+            cache.text += static_cast<char>(0x80 | (cp & 0x3F));
+        } else {
+            cache.text += static_cast<char>(0xF0 | (cp >> 18));
+            cache.text += static_cast<char>(0x80 | ((cp >> 12) & 0x3F));
+            cache.text += static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+            cache.text += static_cast<char>(0x80 | (cp & 0x3F));
+        }
+        run->count = col + 1 - run->col;
+        run->end = static_cast<uint32_t>(cache.text.size());
+        runOpen = fits;
+    }
+}
+
+void TerminalWidget::DrawLine(ImDrawList* drawList, const LineCache& cache, const ImVec2& pos) const {
+    for (const BackgroundRun& run : cache.backgrounds) {
+        drawList->AddRectFilled(
+            ImVec2(pos.x + run.col * m_CharWidth, pos.y),
+            ImVec2(pos.x + (run.col + run.count) * m_CharWidth, pos.y + m_CharHeight),
+            run.color
+        );
+    }
+    
+    const char* text = cache.text.data();
+    for (const TextRun& run : cache.texts) {
+        const float x = pos.x + run.col * m_CharWidth;
+        const float endX = x + run.count * m_CharWidth;
+        drawList->AddText(ImVec2(x, pos.y), run.color, text + run.begin, text + run.end);
+        
+        // Draw underline
+        if (run.underline) {
+            drawList->AddLine(ImVec2(x, pos.y + m_CharHeight - 1), ImVec2(endX, pos.y + m_CharHeight - 1), run.color);
+        }
+        
+        // Draw strikethrough
+        if (run.strikethrough) {
+            drawList->AddLine(ImVec2(x, pos.y + m_CharHeight / 2), ImVec2(endX, pos.y + m_CharHeight / 2), run.color);
+        }
+    }
+}
+
 void TerminalWidget::RenderContent(const ImVec2& pos, const ImVec2& size) {
     if (!m_Emulator) return;
     
     ImDrawList* drawList = ImGui::GetWindowDrawList();
     
     int rows = m_Emulator->GetRows();
-    int cols = m_Emulator->GetCols();
     int scrollbackSize = static_cast<int>(m_Emulator->GetScrollbackSize());
     
-    // When new output arrives, auto-scroll to bottom if already at bottom
-    if (m_ScrollOffset == 0) {
-        // Already at bottom, will show latest
+    // Last frame's lines by generation, to be moved to wherever they are now
+    m_LineSlots.clear();
+    for (size_t slot = 0; slot < m_Lines.size(); slot++) {
+        if (m_Lines[slot].generation != 0) m_LineSlots.emplace(m_Lines[slot].generation, slot);
     }
+    m_NextLines.resize(static_cast<size_t>(rows));
+    
+    const std::vector<TerminalSearch::Match>& matches = m_Search.Matches();
+    const uint64_t firstLine = m_Emulator->GetScrollbackStart();
     
     // Render each visible row
     for (int visibleRow = 0; visibleRow < rows; visibleRow++) {
-        const TerminalLine* line = nullptr;
+        TerminalLine line;
         
         // Calculate which line to render based on scroll offset
         // scrollOffset = 0 means show current screen
         // scrollOffset > 0 means we're scrolled up into scrollback
         int lineIndex = visibleRow - m_ScrollOffset;
+        const uint64_t number = firstLine + static_cast<uint64_t>(scrollbackSize + lineIndex);
         
         if (lineIndex < 0) {
             // This row is in the scrollback buffer
             int scrollbackIndex = scrollbackSize + lineIndex;
             if (scrollbackIndex >= 0 && scrollbackIndex < scrollbackSize) {
-                line = &m_Emulator->GetScrollbackLine(static_cast<size_t>(scrollbackIndex));
+                line = m_Emulator->GetScrollbackLine(static_cast<size_t>(scrollbackIndex));
             }
         } else if (lineIndex < rows) {
             // This row is in the current screen
-            line = &m_Emulator->GetLine(lineIndex);
+            line = m_Emulator->GetLine(lineIndex);
         }
         
-        if (!line) continue;
+        LineCache& cache = m_NextLines[static_cast<size_t>(visibleRow)];
+        if (line.empty()) {
+            cache.generation = 0;
+            continue;
+        }
         
-        for (int col = 0; col < cols && col < static_cast<int>(line->size()); col++) {
-            const auto& cell = (*line)[static_cast<size_t>(col)];
-            
-            float x = pos.x + col * m_CharWidth;
-            float y = pos.y + visibleRow * m_CharHeight;
-            
-            // Determine colors (handle inverse)
-            uint32_t fg = cell.attr.fg;
-            uint32_t bg = cell.attr.bg;
-            
-            if (cell.attr.inverse) {
-                std::swap(fg, bg);
-            }
-            
-            if (cell.attr.dim) {
-                // Reduce brightness
-                int r = (fg >> 16) & 0xFF;
-                int g = (fg >> 8) & 0xFF;
-                int b = fg & 0xFF;
-                r = r * 2 / 3;
-                g = g * 2 / 3;
-                b = b * 2 / 3;
-                fg = (fg & 0xFF000000) | (r << 16) | (g << 8) | b;
-            }
-            
-            // Draw background if not default
-            ImU32 defaultBg = m_Emulator->GetPalette().GetColor(0);
-            if (bg != defaultBg) {
-                drawList->AddRectFilled(
-                    ImVec2(x, y),
-                    ImVec2(x + m_CharWidth, y + m_CharHeight),
-                    bg
-                );
-            }
-            
-            // Draw character
-            if (cell.codepoint > 32) {
-                char utf8[5] = {0};
-                char32_t cp = cell.codepoint;
-                
-                if (cp < 0x80) {
-                    utf8[0] = static_cast<char>(cp);
-                } else if (cp < 0x800) {
-                    utf8[0] = static_cast<char>(0xC0 | (cp >> 6));
-                    utf8[1] = static_cast<char>(0x80 | (cp & 0x3F));
-                } else if (cp < 0x10000) {
-                    utf8[0] = static_cast<char>(0xE0 | (cp >> 12));
-                    utf8[1] = static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
-                    utf8[2] = static_cast<char>(0x80 | (cp & 0x3F));
-                } else {
-                    utf8[0] = static_cast<char>(0xF0 | (cp >> 18));
-                    utf8[1] = static_cast<char>(0x80 | ((cp >> 12) & 0x3F));
-                    utf8[2] = static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
-                    utf8[3] = static_cast<char>(0x80 | (cp & 0x3F));
-                }
-                
-                ImU32 textColor = fg;
-                if (cell.attr.bold) {
-                    // Make color brighter for bold
-                    int r = std::min(255, static_cast<int>(((fg >> 16) & 0xFF) * 5 / 4));
-                    int g = std::min(255, static_cast<int>(((fg >> 8) & 0xFF) * 5 / 4));
-                    int b = std::min(255, static_cast<int>((fg & 0xFF) * 5 / 4));
-                    textColor = (fg & 0xFF000000) | (static_cast<uint32_t>(r) << 16) | (static_cast<uint32_t>(g) << 8) | static_cast<uint32_t>(b);
-                }
-                
-                drawList->AddText(ImVec2(x, y), textColor, utf8);
-                
-                // Draw underline
-                if (cell.attr.underline) {
-                    drawList->AddLine(
-                        ImVec2(x, y + m_CharHeight - 1),
-                        ImVec2(x + m_CharWidth, y + m_CharHeight - 1),
-                        textColor
-                    );
-                }
-                
-                // Draw strikethrough
-                if (cell.attr.strikethrough) {
-                    drawList->AddLine(
-                        ImVec2(x, y + m_CharHeight / 2),
-                        ImVec2(x + m_CharWidth, y + m_CharHeight / 2),
-                        textColor
-                    );
-                }
-            }
+        auto slot = m_LineSlots.find(line.generation);
+        if (slot != m_LineSlots.end() && m_Lines[slot->second].generation == line.generation) {
+            std::swap(cache, m_Lines[slot->second]);
+            m_Lines[slot->second].generation = 0;
+        } else {
+            BuildLine(line, cache);
+        }
+        const ImVec2 linePos(pos.x, pos.y + visibleRow * m_CharHeight);
+        DrawLine(drawList, cache, linePos);
+        
+        // Search matches on the line, over its text
+        auto match = std::lower_bound(matches.begin(), matches.end(), number,
+                                      [](const TerminalSearch::Match& m, uint64_t n) { return m.line < n; });
+        for (; match != matches.end() && match->line == number; ++match) {
+            const bool current = match - matches.begin() == m_SearchCurrentMatch;
+            drawList->AddRectFilled(
+                ImVec2(linePos.x + match->col * m_CharWidth, linePos.y),
+                ImVec2(linePos.x + (match->col + match->length) * m_CharWidth, linePos.y + m_CharHeight),
+                current ? IM_COL32(255, 180, 0, 140) : IM_COL32(255, 200, 0, 60)
+            );
         }
     }
+    std::swap(m_Lines, m_NextLines);
     
     // Draw cursor only when at bottom (not scrolled)
     if (m_ScrollOffset == 0 && m_IsWindowActive && m_IsFocused && m_Emulator->IsCursorVisible() && m_CursorVisible) {
@@ -534,7 +747,7 @@ void TerminalWidget::RenderContent(const ImVec2& pos, const ImVec2& size) {
             if (cursorCell.codepoint > 32) {
                 char utf8[5] = {0};
                 utf8[0] = static_cast<char>(cursorCell.codepoint);
-                drawList->AddText(ImVec2(cursorX, cursorY), cursorCell.attr.bg, utf8);
+                drawList->AddText(ImVec2(cursorX, cursorY), m_Emulator->GetStyle(cursorCell.style).bg, utf8);
             }
         }
     }
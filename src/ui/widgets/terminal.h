@@ -1,9 +1,13 @@
 #pragma once
 
 #include "core/terminal/terminal_emulator.h"
+#include "core/terminal/terminal_search.h"
 #include <imgui.h>
+#include <array>
 #include <memory>
 #include <string>
+#include <unordered_map>
+#include <vector>
 
 namespace sol {
 
@@ -15,6 +19,8 @@ struct TerminalConfig {
     std::string workingDir;  // Empty = use current directory
     bool showScrollbar = true;
     float fontSize = 0.0f;  // 0 = use default
+    size_t scrollbackLines = TerminalEmulator::DefaultScrollback;  // In memory
+    size_t historyBytes = 0;  // Older scrollback on disk, 0 = none
 };
 
 // Terminal widget that renders a TerminalEmulator
@@ -29,9 +35,6 @@ public:
     // Close the terminal
     void Close();
     
-    // Process input from PTY without rendering (for background terminals)
-    void ProcessInput();
-    
     // Render the terminal widget
     // Returns true if the terminal has output to display
     bool Render(const char* label, const ImVec2& size = ImVec2(0, 0));
@@ -53,7 +56,7 @@ public:
     void SetWindowActive(bool active) { m_IsWindowActive = active; }
     
     // Get terminal title
-    const std::string& GetTitle() const;
+    std::string GetTitle() const;
     
     // Get the terminal emulator (for advanced access)
     TerminalEmulator* GetEmulator() { return m_Emulator.get(); }
@@ -63,8 +66,45 @@ public:
     void SetShowScrollbar(bool show) { m_ShowScrollbar = show; }
 
 private:
+    // A line's draw commands, positioned in columns. Each merges the cells
+    // of one style, so a line costs a call per style change, not per cell.
+    struct BackgroundRun {
+        int col = 0;
+        int count = 0;
+        ImU32 color = 0;
+    };
+    struct TextRun {
+        int col = 0;
+        int count = 0;
+        uint32_t begin = 0;  // Into LineCache::text
+        uint32_t end = 0;
+        ImU32 color = 0;
+        bool underline = false;
+        bool strikethrough = false;
+    };
+    struct LineCache {
+        uint64_t generation = 0;  // Of the line drawn, 0 for none
+        std::vector<BackgroundRun> backgrounds;
+        std::vector<TextRun> texts;
+        std::string text;
+    };
+    
     void HandleInput();
+    // '/' in Command mode searches the scrollback; true when it took the input
+    bool HandleSearchInput();
+    void StartSearch();
+    // Selects the match nearest above the search's origin; under the lock
+    void SelectSearchMatch();
+    void StepSearchMatch(int step);
+    // Scrolls the current match into view; under the lock
+    void ScrollToMatch();
+    // Number, as GetScrollbackStart counts, of the line at the bottom of the view
+    uint64_t GetBottomLine() const;
     void RenderContent(const ImVec2& pos, const ImVec2& size);
+    void BuildLine(const TerminalLine& line, LineCache& cache) const;
+    void DrawLine(ImDrawList* drawList, const LineCache& cache, const ImVec2& pos) const;
+    // Drops every cached line when the font or theme colors change
+    void ValidateLineCache(ImU32 defaultFg, ImU32 defaultBg);
     void RenderScrollbar(const ImVec2& pos, const ImVec2& size);
     void CalculateDimensions(const ImVec2& size);
     
@@ -77,6 +117,18 @@ private:
     int m_VisibleRows = 24;
     int m_VisibleCols = 80;
     
+    // Lines drawn last frame by visible row. Lines are matched to them by
+    // generation, so unchanged lines are not rebuilt wherever they scroll.
+    std::vector<LineCache> m_Lines;
+    std::vector<LineCache> m_NextLines;
+    std::unordered_map<uint64_t, size_t> m_LineSlots;
+    ImFont* m_CacheFont = nullptr;
+    float m_CacheCharWidth = 0.0f;
+    ImU32 m_CacheFg = 0;
+    ImU32 m_CacheBg = 0;
+    // ASCII glyphs exactly one cell wide, which can share a text run
+    std::array<bool, 128> m_FitsCell{};
+    
     // Scroll state
     int m_ScrollOffset = 0;  // Offset into scrollback (0 = bottom)
     bool m_ShowScrollbar = true;
@@ -94,6 +146,14 @@ private:
     float m_CursorBlinkTime = 0.0f;
     bool m_CursorVisible = true;
     
+    // Search
+    TerminalSearch m_Search;
+    bool m_SearchActive = false;
+    bool m_SearchRegex = false;
+    std::string m_SearchQuery;
+    int m_SearchCurrentMatch = -1;
+    uint64_t m_SearchOrigin = 0;  // Line at the bottom of the view when started
+    
     // Selection
     bool m_Selecting = false;
     ImVec2 m_SelectStart;
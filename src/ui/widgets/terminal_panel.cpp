@@ -2,6 +2,7 @@
 #include "core/resource_system.h"
 #include "core/event_system.h"
 #include "ui/input/command.h"
+#include "ui/editor_settings.h"
 #include "ui/icons_nerd.h"
 #include <imgui.h>
 #include <imgui_internal.h>
@@ -90,6 +91,9 @@ void TerminalPanel::NewTab() {
     auto& rs = ResourceSystem::GetInstance();
     if (rs.HasWorkingDirectory())
         cfg.workingDir = rs.GetWorkingDirectory().string();
+    const auto& behavior = EditorSettings::Get().GetBehavior();
+    cfg.scrollbackLines = static_cast<size_t>(behavior.terminalScrollback);
+    cfg.historyBytes = static_cast<size_t>(behavior.terminalHistoryMB) * 1024 * 1024;
 
     tab.terminal->Spawn(cfg);
     tab.title = "Terminal";
@@ -117,11 +121,4 @@ void TerminalPanel::PrevTab() {
     m_TabChanged = true;
 }
 
-void TerminalPanel::ProcessAllInputs() {
-    for (auto& tab : m_Tabs) {
-        if (tab.terminal)
-            tab.terminal->ProcessInput();
-    }
-}
-
 } // namespace sol
@@ -34,9 +34,6 @@ public:
     bool HasTabs() const { return !m_Tabs.empty(); }
     int GetTabCount() const { return (int)m_Tabs.size(); }
 
-    // Process PTY input for all terminals (call every frame)
-    void ProcessAllInputs();
-
 private:
     struct Tab {
         std::unique_ptr<TerminalWidget> terminal;
@@ -54,6 +54,7 @@ bool Window::Render(const char* label, const ImVec2& size, bool isActiveWindow)
                         m_Editor->Focus();
                         m_WantsFocus = false;
                     }
+                    ResourceSystem::GetInstance().MarkShown(*textResource);
                     TextBuffer& textBuf = textResource->GetBuffer();
                     if (m_Editor->Render(label, textBuf, size)) {
                         textResource->SetModified(true);
@@ -90,6 +91,11 @@ WindowTree::WindowTree() {
     m_ActiveWindow = m_Root->window.get();
 }
 
+void WindowTree::Reset() {
+    m_Root = std::make_unique<SplitNode>();
+    m_ActiveWindow = m_Root->window.get();
+}
+
 void WindowTree::Render(const ImVec2& pos, const ImVec2& size) {
     RenderNode(m_Root.get(), pos, size);
 }
@@ -87,6 +87,10 @@ public:
 
     Window* FindWindowWithBuffer(size_t bufferId);
 
+    // Layout access for sessions; Reset leaves a single empty window
+    const SplitNode* GetRoot() const { return m_Root.get(); }
+    void Reset();
+
     // Set whether the tree itself (vs explorer/sidebar) has focus
     void SetTreeFocused(bool focused) { m_TreeFocused = focused; }
 
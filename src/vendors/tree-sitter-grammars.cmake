@@ -94,3 +94,69 @@ target_link_libraries(tree-sitter-grammars INTERFACE
     tree-sitter-markdown
     tree-sitter-typescript
 )
+
+# Bundled query files, embedded into sol_core as byte arrays. Each entry is
+# language:query[,query...] relative to src/vendors; a grammar extending another
+# lists its own query first so its patterns take precedence. Missing files are
+# skipped, so a grammar without tags.scm simply has no symbols.
+set(SOL_HIGHLIGHT_QUERIES
+    "c:tree-sitter-c/queries/highlights.scm"
+    "cpp:tree-sitter-cpp/queries/highlights.scm,tree-sitter-c/queries/highlights.scm"
+    "python:tree-sitter-python/queries/highlights.scm"
+    "cmake:tree-sitter-cmake/queries/highlights.scm"
+    "css:tree-sitter-css/queries/highlights.scm"
+    "html:tree-sitter-html/queries/highlights.scm"
+    "javascript:tree-sitter-javascript/queries/highlights.scm"
+    "json:tree-sitter-json/queries/highlights.scm"
+    "markdown:tree-sitter-markdown/tree-sitter-markdown/queries/highlights.scm"
+    "typescript:tree-sitter-typescript/queries/highlights.scm,tree-sitter-javascript/queries/highlights.scm"
+)
+
+set(SOL_TAGS_QUERIES
+    "c:tree-sitter-c/queries/tags.scm"
+    "cpp:tree-sitter-cpp/queries/tags.scm,tree-sitter-c/queries/tags.scm"
+    "python:tree-sitter-python/queries/tags.scm"
+    "javascript:tree-sitter-javascript/queries/tags.scm"
+    "typescript:tree-sitter-typescript/queries/tags.scm,tree-sitter-javascript/queries/tags.scm"
+)
+
+set(SOL_QUERY_ARRAYS "")
+
+# Appends the arrays of one query list to SOL_QUERY_ARRAYS and sets
+# <lookup_var> to the lookup statements for them
+function(sol_embed_queries kind lookup_var)
+    set(arrays "${SOL_QUERY_ARRAYS}")
+    set(lookup "")
+    foreach(entry ${ARGN})
+        string(FIND ${entry} ":" colon)
+        string(SUBSTRING ${entry} 0 ${colon} language)
+        math(EXPR colon "${colon} + 1")
+        string(SUBSTRING ${entry} ${colon} -1 files)
+        string(REPLACE "," ";" files ${files})
+
+        set(hex "")
+        foreach(file ${files})
+            set(path ${CMAKE_CURRENT_SOURCE_DIR}/src/vendors/${file})
+            if(EXISTS ${path})
+                file(READ ${path} content HEX)
+                string(APPEND hex "${content}0a")
+                set_property(DIRECTORY APPEND PROPERTY CMAKE_CONFIGURE_DEPENDS ${path})
+            endif()
+        endforeach()
+
+        if(hex)
+            set(name ${kind}_${language})
+            string(REGEX REPLACE "([0-9a-f][0-9a-f])" "0x\\1," bytes ${hex})
+            string(APPEND arrays "constexpr unsigned char ${name}[] = {${bytes}};\n")
+            string(APPEND lookup "    if (language == \"${language}\") return {reinterpret_cast<const char*>(${name}), sizeof(${name})};\n")
+        endif()
+    endforeach()
+    set(SOL_QUERY_ARRAYS "${arrays}" PARENT_SCOPE)
+    set(${lookup_var} "${lookup}" PARENT_SCOPE)
+endfunction()
+
+sol_embed_queries(HIGHLIGHTS SOL_HIGHLIGHTS_LOOKUP ${SOL_HIGHLIGHT_QUERIES})
+sol_embed_queries(TAGS SOL_TAGS_LOOKUP ${SOL_TAGS_QUERIES})
+
+set(TREE_SITTER_QUERIES_SRC ${CMAKE_CURRENT_BINARY_DIR}/generated/bundled_queries.cpp)
+configure_file(${CMAKE_CURRENT_SOURCE_DIR}/src/core/text/bundled_queries.cpp.in ${TREE_SITTER_QUERIES_SRC} @ONLY)